@@ -121,15 +121,24 @@ export class ProtocolService {
     }
   }
 
+  // 与STM32硬件CRC一致：数据按32位小端字输入（末尾不足4字节补0），
+  // 每个字从最高位开始处理，初值0xFFFFFFFF，无最终异或
   private calculateCRC32(data: Uint8Array): number {
     let crc = 0xFFFFFFFF;
 
-    for (let i = 0; i < data.length; i++) {
-      const index = ((crc >>> 24) ^ data[i]) & 0xFF;
-      crc = ((crc << 8) ^ this.crc32Table[index]) >>> 0;
+    for (let i = 0; i < data.length; i += 4) {
+      let word = 0;
+      for (let k = 0; k < 4 && i + k < data.length; k++) {
+        word |= data[i + k] << (8 * k);
+      }
+
+      crc = (crc ^ word) >>> 0;
+      for (let k = 0; k < 4; k++) {
+        crc = ((crc << 8) ^ this.crc32Table[crc >>> 24]) >>> 0;
+      }
     }
 
-    return crc ^ 0xFFFFFFFF;
+    return crc >>> 0;
   }
 
   private getNextPacketNumber(): number {
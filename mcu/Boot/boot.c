@@ -0,0 +1,61 @@
+#include "boot_slots.h"
+#include "stm32f1xx.h"
+#include <stddef.h>
+
+// 引导程序：上电后以HSI运行，不配置时钟、不开中断、不初始化.data/.bss，
+// 读出引导记录、校验所选槽的向量表后直接跳转，耗时为几微秒
+
+// 备份寄存器：DR1 - DR4由固件使用（rtc_clock.c、watchdog.c）
+#define BOOT_BKP_SEQUENCE  (BKP->DR5) // 已试运行的记录序号
+#define BOOT_BKP_MAGIC     (BKP->DR6)
+
+extern uint32_t _estack;
+void boot_reset(void);
+
+// 只有初始栈指针和复位向量，其余异常在跳转前不会发生
+__attribute__((section(".isr_vector"), used))
+static const uintptr_t boot_vectors[] = {
+    (uintptr_t)&_estack,
+    (uintptr_t)boot_reset,
+};
+
+static __attribute__((noreturn)) void boot_jump(uint32_t base) {
+    const volatile uint32_t *vectors = (const volatile uint32_t *)base;
+    SCB->VTOR = base;
+    __DSB();
+    __set_MSP(vectors[0]);
+    ((void (*)(void))vectors[1])();
+    for (;;) {
+    }
+}
+
+void boot_reset(void) {
+    RCC->APB1ENR |= RCC_APB1ENR_PWREN | RCC_APB1ENR_BKPEN;
+
+    BootRecord record;
+    uint32_t append;
+    bool found = boot_record_find((const uint8_t *)BOOT_STATE_BASE, &record, &append);
+    bool attempted = found && BOOT_BKP_MAGIC == BOOT_RECORD_MAGIC && BOOT_BKP_SEQUENCE == record.sequence;
+    uint8_t slot = boot_select(found ? &record : NULL, attempted);
+
+    // 所选槽的映像无效（如未写完）时引导另一个槽
+    if (!boot_image_valid((const uint8_t *)boot_slot_base(slot), boot_slot_base(slot), BOOT_SLOT_SIZE)) {
+        slot ^= 1U;
+        if (!boot_image_valid((const uint8_t *)boot_slot_base(slot), boot_slot_base(slot), BOOT_SLOT_SIZE)) {
+            for (;;) {
+                // 两个槽都没有映像：等待ST-Link烧写
+            }
+        }
+    }
+
+    // 第一次试运行：记下序号，确认前复位时回退
+    if (found && slot == record.trial && !attempted) {
+        PWR->CR |= PWR_CR_DBP;
+        BOOT_BKP_SEQUENCE = record.sequence;
+        BOOT_BKP_MAGIC = BOOT_RECORD_MAGIC;
+        PWR->CR &= ~PWR_CR_DBP;
+    }
+    RCC->APB1ENR &= ~(RCC_APB1ENR_PWREN | RCC_APB1ENR_BKPEN);
+
+    boot_jump(boot_slot_base(slot));
+}
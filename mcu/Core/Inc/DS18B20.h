@@ -3,19 +3,58 @@
 
 #include <stdint.h>
 
-// 时间系统函数声明
-uint32_t micros(void);
-void delay_us(uint32_t delay_time);
+// 时隙产生方式：1由TIM6中断产生（onewire.c，不关中断忙等），0为关中断忙等的位操作
+#ifndef DS18B20_USE_TIMER
+#define DS18B20_USE_TIMER 1
+#endif
+
+// 时间系统函数（micros()、delay_us()）
+#include "timebase.h"
+
+// 暂存器与配置寄存器：分辨率位于配置寄存器bit6~5（R1 R0），其余位固定为1
+#define DS18B20_SCRATCHPAD_SIZE 9
+#define DS18B20_CONFIG(bits)        ((uint8_t)((((bits) - 9) << 5) | 0x1F))
+#define DS18B20_CONFIG_BITS(config) ((uint8_t)((((config) >> 5) & 0x03) + 9))
+
+// 64位ROM码：家族码、48位序列号、CRC，LSB先行
+#define DS18B20_ROM_SIZE     8
+#define DS18B20_MAX_CMD_SIZE 4 // 寻址之后的最长命令（写暂存器）
+
+// 原始温度：1/16°C的补码（12位分辨率下的LSB），换算只用整数乘法和移位，
+// 结果四舍五入（远离0），不经过软件浮点
+#define DS18B20_TEMP_INVALID_RAW INT16_MIN
+
+// 换算为0.1°C（×10/16）
+static inline int16_t DS18B20_Raw_To_Deci(int16_t raw) {
+    int32_t scaled = (int32_t)raw * 5;             // raw × 10/16 = raw × 5/8
+    return (int16_t)((scaled + (scaled < 0 ? -4 : 4)) / 8);
+}
+
+// 换算为0.01°C（×100/16）
+static inline int16_t DS18B20_Raw_To_Centi(int16_t raw) {
+    int32_t scaled = (int32_t)raw * 25;            // raw × 100/16 = raw × 25/4
+    return (int16_t)((scaled + (scaled < 0 ? -2 : 2)) / 4);
+}
+
+// Dallas/Maxim CRC8，对含CRC字节的整个ROM码或暂存器计算结果为0表示正确
+uint8_t DS18B20_CRC8(const uint8_t *data, uint8_t length);
 
 // DS18B20函数声明
 uint8_t DS18B20_Init(void);
 short DS18B20_Get_Temp(void);
-void DS18B20_Start(void);
+int16_t DS18B20_Get_Temp_Raw(const uint8_t *rom);
+uint8_t DS18B20_Start(void);
+uint8_t DS18B20_Search(uint8_t (*roms)[DS18B20_ROM_SIZE], uint8_t max_count);
+void DS18B20_Write_Bit(uint8_t bit);
 void DS18B20_Write_Byte(uint8_t dat);
 uint8_t DS18B20_Read_Byte(void);
 uint8_t DS18B20_Read_Bit(void);
 uint8_t DS18B20_Check(void);
 void DS18B20_Rst(void);
 void DS18B20_Tem_Transfer(void);
+// 以下rom为NULL时跳过ROM（总线上只有一个传感器），否则匹配该ROM码
+uint8_t DS18B20_Read_Scratchpad(const uint8_t *rom, uint8_t *data);
+uint8_t DS18B20_Set_Resolution(const uint8_t *rom, uint8_t bits);
+uint8_t DS18B20_Get_Resolution(const uint8_t *rom);
 
 #endif
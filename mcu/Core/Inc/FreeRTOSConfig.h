@@ -50,6 +50,8 @@
 #if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
   #include <stdint.h>
   extern uint32_t SystemCoreClock;
+  void configureTimerForRunTimeStats(void);
+  unsigned long getRunTimeCounterValue(void);
 #endif
 #ifndef CMSIS_device_header
 #define CMSIS_device_header "stm32f1xx.h"
@@ -58,15 +60,16 @@
 #define configUSE_PREEMPTION                     1
 #define configSUPPORT_STATIC_ALLOCATION          1
 #define configSUPPORT_DYNAMIC_ALLOCATION         1
-#define configUSE_IDLE_HOOK                      0
+#define configUSE_IDLE_HOOK                      1
 #define configUSE_TICK_HOOK                      0
 #define configCPU_CLOCK_HZ                       ( SystemCoreClock )
 #define configTICK_RATE_HZ                       ((TickType_t)1000)
 #define configMAX_PRIORITIES                     ( 56 )
 #define configMINIMAL_STACK_SIZE                 ((uint16_t)128)
-#define configTOTAL_HEAP_SIZE                    ((size_t)3072)
+#define configTOTAL_HEAP_SIZE                    ((size_t)256)
 #define configMAX_TASK_NAME_LEN                  ( 16 )
 #define configUSE_TRACE_FACILITY                 1
+#define configGENERATE_RUN_TIME_STATS            1
 #define configUSE_16_BIT_TICKS                   0
 #define configUSE_MUTEXES                        1
 #define configQUEUE_REGISTRY_SIZE                8
@@ -78,9 +81,14 @@
 #define configUSE_CO_ROUTINES                    0
 #define configMAX_CO_ROUTINE_PRIORITIES          ( 2 )
 
+/* Run time and task stats gathering related definitions. */
+/* Definitions needed when configGENERATE_RUN_TIME_STATS is on */
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS configureTimerForRunTimeStats
+#define portGET_RUN_TIME_COUNTER_VALUE getRunTimeCounterValue
+
 /* Software timer definitions. */
 #define configUSE_TIMERS                         1
-#define configTIMER_TASK_PRIORITY                ( 2 )
+#define configTIMER_TASK_PRIORITY                ( 40 )
 #define configTIMER_QUEUE_LENGTH                 10
 #define configTIMER_TASK_STACK_DEPTH             256
 
@@ -148,6 +156,16 @@ standard names. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+// tickless空闲：空闲时停掉节拍，按下一个超时进入睡眠或STOP模式（low_power.h）
+#define configUSE_TICKLESS_IDLE                  1
+// SysTick用HCLK/8（72MHz时为9MHz）；降频后改用处理器时钟，频率不变（clock_scale.h）
+#define configSYSTICK_CLOCK_HZ                   ( 72000000UL / 8UL )
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+  void low_power_suppress_ticks(uint32_t expected_ticks);
+  void low_power_pre_sleep(void);
+#endif
+#define portSUPPRESS_TICKS_AND_SLEEP(xExpectedIdleTime) low_power_suppress_ticks(xExpectedIdleTime)
+#define configPRE_SLEEP_PROCESSING(xExpectedIdleTime)   low_power_pre_sleep()
 /* USER CODE END Defines */
 
 #endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,41 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 请求准入：每条链路一个令牌桶。命令执行任务的优先级高于记录和存储任务，
+// 主机不停发送请求时命令执行会占满CPU，日志写入闪存一直得不到运行；
+// 超出速率的请求不执行，以STATUS_BUSY应答，DA带"RA"（至少等待的毫秒数）。
+// - 每条命令消耗一个令牌，批量类（COMMAND_CLASS_BULK）消耗ADMISSION_BULK_COST个
+// - 令牌不足时先拒绝批量类；交互类可以透支ADMISSION_RESERVE个，持续轮询temp的主机不受影响
+// - 重发请求的缓存应答和分片确认（fack）不消耗令牌
+// 只在执行任务中访问，不加锁
+#ifndef COMMAND_ADMISSION
+#define COMMAND_ADMISSION 1 // 0：不限流（主机测试连续发送请求而不推进时钟）
+#endif
+#define ADMISSION_BURST      16    // 桶容量（令牌）
+#define ADMISSION_REFILL_MS  50U   // 每隔这么久补充一个令牌（持续每秒20条）
+#define ADMISSION_BULK_COST  4
+#define ADMISSION_RESERVE    8
+
+typedef struct {
+    int16_t tokens;
+    uint32_t refill_tick;  // 上一次补充的时刻
+} AdmissionBucket;
+
+void admission_reset(AdmissionBucket *bucket, uint32_t now);
+
+// 申请执行一条命令（bulk为批量类），now为HAL_GetTick()：
+// 允许时扣除令牌并返回0，否则不扣除，返回到桶中令牌足够时的毫秒数（至少1）
+uint32_t admission_request(AdmissionBucket *bucket, bool bulk, uint32_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADMISSION_H
@@ -0,0 +1,71 @@
+#ifndef ANALOG_TEMP_H
+#define ANALOG_TEMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "temp_driver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 模拟温度通道（TEMP_ANALOG时编译硬件部分，analog_temp_adc.c）：ADC1连续扫描
+// NTC0（PC0，IN10）、NTC1（PC1，IN11）、片内温度传感器（IN16）和内部参考电压（IN17），
+// DMA循环写入双缓冲，半满和全满中断中把这半个缓冲累加到各输入的和中，CPU不参与每次转换。
+// 采样任务每次采样时取走上次采样以来的平均值（约每秒数千次转换的平均，同时平均掉工频干扰），
+// 平均值按1/16 LSB保存（65520为满量程），再用定点查表换算为温度。
+// 作为驱动注册在DS18B20之后（temp_driver.h），转换一直在进行，启动后不需要等待。
+// STOP模式期间（low_power.h）ADC停止，平均值只包含运行期间的转换
+#ifndef TEMP_ANALOG
+#define TEMP_ANALOG 0 // 1：启用模拟温度通道
+#endif
+
+// 扫描顺序
+enum {
+    ANALOG_INPUT_NTC0 = 0,
+    ANALOG_INPUT_NTC1,
+    ANALOG_INPUT_INTERNAL,
+    ANALOG_INPUT_VREFINT,
+    ANALOG_INPUT_COUNT
+};
+#define ANALOG_TEMP_CHANNELS   3       // 作为传感器的通道：NTC0、NTC1、片内传感器
+#define ANALOG_TEMP_FULL_SCALE 65520U  // 4095 × 16
+#define ANALOG_TEMP_FRAMES     64U     // 半个DMA缓冲的扫描次数
+#define ANALOG_TEMP_MAX_FRAMES 65536U  // 长时间没有采样时从头累加，和不会溢出
+
+// NTC：10kΩ上拉到VDDA，NTC（10kΩ@25°C，B=3950）接地，读数与VDDA无关。
+// 查表范围-40~125°C，每5°C一点，之间线性插值（误差小于0.2°C）；
+// 超出[ANALOG_NTC_SHORT, ANALOG_NTC_OPEN]视为短路或开路
+#define ANALOG_NTC_SHORT 1032U   // 约160Ω
+#define ANALOG_NTC_OPEN  64512U  // 约640kΩ
+// 片内传感器：V25=1.43V、4.3mV/°C（典型值，个体偏差约±1.5°C，可用scal校准），
+// 电压按内部参考（1.20V）的读数换算，与VDDA无关；参考读数异常时视为失败
+#define ANALOG_VREFINT_MV 1200
+#define ANALOG_VREFINT_MIN 20000U  // 1/16 LSB，对应VDDA约3.9V
+#define ANALOG_VREFINT_MAX 32000U  // 对应VDDA约2.5V
+
+void analog_temp_reset(void);
+// DMA中断中调用：frames为count次扫描，每次ANALOG_INPUT_COUNT个12位读数
+void analog_temp_accumulate(const uint16_t *frames, uint16_t count);
+// 采样任务中调用：锁存上次调用以来的平均值，没有新的转换时返回false（之后的读数都视为失败）
+bool analog_temp_snapshot(void);
+uint16_t analog_temp_average(uint8_t input); // 锁存的平均值（1/16 LSB）
+
+// 换算（0.1°C），超出范围时返回TEMP_INVALID
+int16_t analog_temp_ntc_deci(uint16_t average);
+int16_t analog_temp_internal_deci(uint16_t sensor, uint16_t vrefint);
+
+// 锁存的读数：channel为0~ANALOG_TEMP_CHANNELS-1
+bool analog_temp_channel_ok(uint8_t channel);
+int16_t analog_temp_read(uint8_t channel);
+
+#if TEMP_ANALOG
+extern const TempDriver analog_temp_driver;
+void analog_temp_dma_irq_handler(void); // DMA1_Channel1_IRQHandler
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ANALOG_TEMP_H
@@ -0,0 +1,43 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 协议编解码微基准：组帧/解析、转义/反转义、CRC32、TLV读写和utils/下的C++读写器，
+// 每项分别用两种载荷测量：
+// - 最坏载荷：0xAA/0x55交替，每个字节都构成或延续帧标记，都要转义
+// - 典型载荷：差分编码的温度日志（glog的DA，每分钟一条、温度缓变）
+// 每项重复iterations次取最小耗时，排除中断和缓存造成的偏大值。
+// 计时函数由调用方提供：目标板为DWT周期计数（timebase_cycles），主机为单调时钟
+#define BENCH_PAYLOAD_MAX 256
+#define BENCH_CASES_MAX   24
+
+// 定义BENCH_AT_BOOT时，main()在启动调度器之前运行一次并输出结果
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 16
+#endif
+
+typedef uint32_t (*BenchClock)(void);
+
+typedef struct {
+    const char *name;    // 被测函数
+    const char *payload; // "worst"或"log"
+    uint16_t bytes;      // 载荷字节数（转义前）
+    uint32_t ticks;      // 处理一次的最小耗时（计时函数的单位）
+} BenchResult;
+
+// 运行全部测量项，返回写入results的项数（不超过max）
+uint8_t bench_run(BenchClock clock, uint16_t iterations, BenchResult *results, uint8_t max);
+
+// 运行并用printf()逐项输出耗时和每字节耗时（目标板经ITM文本端口输出）
+void bench_report(BenchClock clock, uint16_t iterations);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BENCH_H
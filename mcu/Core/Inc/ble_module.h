@@ -0,0 +1,63 @@
+#ifndef BLE_MODULE_H
+#define BLE_MODULE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// BLE串口透传模块的上电配置：在communication_init()之前，USART1还没有启动DMA接收时
+// 用AT指令轮询方式配置模块，使链路不受模块出厂设置的限制：
+// - 依次在BLE_MODULE_BAUD_MAX及以下的各链路波特率（communication.h的COMM_BAUD_RATES）上发送AT，
+//   收到OK即找到模块当前的波特率；模块保存设置，下次上电直接在新波特率上找到
+// - 设置连接间隔为BLE_MODULE_INTERVAL_MIN..MAX（由手机端在范围内选择），模块不支持时忽略
+// - 从最高的波特率开始发送设置波特率的指令，模块接受后切换USART1并用AT确认，
+//   确认失败时回到原波特率，再试下一档
+// 没有找到模块（未焊接，或已连接手机、处于透传状态）时保持COMM_DEFAULT_BAUD_RATE不变；
+// 透传状态下发出的AT指令会到达手机，App按无效帧丢弃。
+// 指令集因模块型号而异，BLE_MODULE_CMD_*按所用模块修改。
+// 配置逻辑不访问外设，通过BleModulePort收发，固件中为uart_transport.h的USART1轮询收发，主机测试中为模拟模块
+#ifndef BLE_MODULE_CONFIG
+#define BLE_MODULE_CONFIG 1 // 0：不配置模块，BLE链路固定为COMM_DEFAULT_BAUD_RATE
+#endif
+
+#define BLE_MODULE_BAUD_MAX      230400U // 最短连接间隔下空中吞吐量不到115200，更高的波特率不再提高吞吐量，且不能降频（clock_scale.h）
+#define BLE_MODULE_INTERVAL_MIN  12U     // 连接间隔，单位1.25ms：15ms为iOS允许的最小值
+#define BLE_MODULE_INTERVAL_MAX  24U     // 30ms，iOS要求比最小值至少大15ms
+#define BLE_MODULE_REPLY_MS      100U    // 等待应答的第一个字节
+#define BLE_MODULE_GAP_MS        5U      // 应答字节之间超过该间隔视为应答结束
+#define BLE_MODULE_PROBE_ROUNDS  2U      // 模块与本机同时上电时可能还未就绪，探测若干轮
+#define BLE_MODULE_REPLY_MAX     32U
+
+#define BLE_MODULE_CMD_PROBE     "AT"
+#define BLE_MODULE_CMD_BAUD      "AT+BAUD="  // 后接十进制波特率
+#define BLE_MODULE_CMD_INTERVAL  "AT+CINT="  // 后接"最小值,最大值"
+
+// 模块的收发接口
+typedef struct {
+    bool (*set_baud)(void *context, uint32_t baud_rate);
+    void (*send)(void *context, const uint8_t *data, uint16_t length);
+    // 收到第一个字节前最多等待first_ms，之后字节间隔超过gap_ms即返回，返回收到的字节数
+    uint16_t (*receive)(void *context, uint8_t *buffer, uint16_t size, uint32_t first_ms, uint32_t gap_ms);
+    void *context;
+} BleModulePort;
+
+// 配置结果
+typedef struct {
+    bool found;              // 模块应答了AT
+    bool interval_set;       // 模块接受了连接间隔
+    uint32_t found_baud;     // 找到模块时的波特率
+    uint32_t baud_rate;      // 配置后的波特率，没有找到模块时为COMM_DEFAULT_BAUD_RATE
+} BleModuleResult;
+
+// 探测并配置模块（阻塞，最长约BLE_MODULE_PROBE_ROUNDS × 波特率档数 × BLE_MODULE_REPLY_MS），
+// 返回后串口已设为result->baud_rate
+void ble_module_configure(const BleModulePort *port, BleModuleResult *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLE_MODULE_H
@@ -0,0 +1,56 @@
+#ifndef BLOCK_POOL_H
+#define BLOCK_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 定长块内存池：存储区静态分配，空闲块串成单链表（链接指针放在空闲块自身中），
+// 分配和释放都是O(1)，不产生碎片。任务和中断中都可调用（短暂屏蔽可屏蔽中断）。
+// RTOS对象全部静态创建，FreeRTOS堆不再用于运行时分配；需要动态分配的缓冲区从内存池取，
+// 用量和分配失败次数由gtsk报告
+typedef struct BlockPool {
+    const char *name;
+    uint8_t *storage;
+    void *free_list;
+    uint16_t block_size;
+    uint16_t block_count;
+    uint16_t used;
+    uint16_t peak;           // 同时使用的最大块数
+    uint32_t failures;       // 没有空闲块而分配失败的次数
+    struct BlockPool *next;  // 已初始化的内存池链表，供统计遍历
+} BlockPool;
+
+typedef struct {
+    const char *name;
+    uint16_t block_size;
+    uint16_t block_count;
+    uint16_t used;
+    uint16_t peak;
+    uint32_t failures;
+} BlockPoolStats;
+
+// 存储区：按4字节对齐，block_size向上取整到4的倍数
+#define BLOCK_POOL_WORDS(block_size, block_count) ((((block_size) + 3U) / 4U) * (block_count))
+
+// 初始化内存池（调度器启动前调用），block_size不小于一个指针，
+// storage至少BLOCK_POOL_WORDS(block_size, block_count)个字
+void block_pool_init(BlockPool *pool, const char *name, uint32_t *storage,
+                     uint16_t block_size, uint16_t block_count);
+
+// 分配一个块，没有空闲块时返回NULL
+void *block_pool_alloc(BlockPool *pool);
+// 归还block_pool_alloc()取得的块
+void block_pool_free(BlockPool *pool, void *block);
+
+// 第index个已初始化的内存池的用量（按初始化顺序），index超出时返回false
+bool block_pool_get_stats(uint8_t index, BlockPoolStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLOCK_POOL_H
@@ -0,0 +1,73 @@
+#ifndef BOOT_SLOTS_H
+#define BOOT_SLOTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A/B程序槽（FW_SLOTS）：片内闪存分为引导程序、两个程序槽和引导记录页，引导程序按最后一条
+// 引导记录选择槽后直接跳转，不复制映像。
+// - 固件升级（fw_update.h）把新映像写入另一个槽，fwcm追加一条试运行记录后复位
+// - 引导程序第一次试运行新槽时把该记录的序号记在备份寄存器中；新固件确认前复位（看门狗等）时
+//   序号已记下，改为引导已确认的槽（回退）。备份域掉电（没有VBAT）时重新试运行
+// - 新固件正常运行BOOT_CONFIRM_MS后由存储任务追加确认记录
+// - 映像须按所在槽的地址链接（CMake的FIRMWARE_SLOT=A/B），槽占用片内日志区，因此日志流须放在外置闪存
+// 记录的查找和引导选择不依赖HAL，引导程序（Boot/）、固件和主机测试共用
+#ifndef FW_SLOTS
+#define FW_SLOTS 0  // 1：A/B程序槽和引导程序
+#endif
+#ifndef FW_SLOT_ID
+#define FW_SLOT_ID 0 // 本映像链接的槽（BOOT_SLOT_A/B）
+#endif
+
+#define BOOT_PAGE_SIZE     2048U
+#define BOOT_LOADER_BASE   0x08000000U
+#define BOOT_LOADER_SIZE   (8U * 1024U)
+#define BOOT_SLOT_SIZE     (248U * 1024U)
+#define BOOT_SLOT_A_BASE   (BOOT_LOADER_BASE + BOOT_LOADER_SIZE)  // 0x08002000
+#define BOOT_SLOT_B_BASE   (BOOT_SLOT_A_BASE + BOOT_SLOT_SIZE)    // 0x08040000
+#define BOOT_STATE_BASE    (BOOT_SLOT_B_BASE + BOOT_SLOT_SIZE)    // 0x0807E000，之后为设置存储页
+#define BOOT_STATE_PAGES   2U
+#define BOOT_STATE_SIZE    (BOOT_STATE_PAGES * BOOT_PAGE_SIZE)
+#define BOOT_RAM_BASE      0x20000000U // 映像向量表中初始栈指针的合理范围
+#define BOOT_RAM_SIZE      (64U * 1024U)
+#define BOOT_CONFIRM_MS    30000U      // 新固件运行这么久（期间看门狗未复位）后确认
+
+#define BOOT_SLOT_A        0U
+#define BOOT_SLOT_B        1U
+#define BOOT_SLOT_NONE     0xFFU
+#define BOOT_RECORD_MAGIC  0xB007U
+
+// 引导记录：在两页中依次追加，序号最大的有效记录为当前状态；一页写满后擦除另一页继续
+typedef struct {
+    uint16_t magic;
+    uint16_t sequence;
+    uint8_t confirmed;  // 正常引导的槽
+    uint8_t trial;      // 试运行一次的槽，没有时为BOOT_SLOT_NONE
+    uint16_t check;     // boot_record_check()
+} BootRecord;
+
+static inline uint32_t boot_slot_base(uint8_t slot) {
+    return slot == BOOT_SLOT_B ? BOOT_SLOT_B_BASE : BOOT_SLOT_A_BASE;
+}
+
+uint16_t boot_record_check(const BootRecord *record);
+
+// 在引导记录页（BOOT_STATE_SIZE字节）中查找序号最大的有效记录，没有时返回false；
+// *append为下一条记录的偏移，位于页首时须先擦除该页
+bool boot_record_find(const uint8_t *state, BootRecord *record, uint32_t *append);
+
+// 选择要引导的槽：没有记录时为A；有试运行的槽且本次记录还未试运行过时为该槽，否则为已确认的槽
+uint8_t boot_select(const BootRecord *record, bool trial_attempted);
+
+// 映像的向量表是否合理：初始栈指针在SRAM内，复位向量为[link_base, link_base + size)内的Thumb地址
+bool boot_image_valid(const uint8_t *image, uint32_t link_base, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_SLOTS_H
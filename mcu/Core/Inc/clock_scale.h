@@ -0,0 +1,57 @@
+#ifndef CLOCK_SCALE_H
+#define CLOCK_SCALE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "DS18B20.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 动态降频：PLL（72MHz）保持运行，只改AHB分频。串口空闲、输出关闭、没有1-Wire传输时，
+// 空闲任务在睡眠之前把HCLK降到72MHz / CLOCK_SCALE_DIVIDER，之后的睡眠和只有采样、记录等
+// 后台任务运行的时段都在低频下；串口收到数据或开始1-Wire传输时立即恢复全速。
+// 切换时按新时钟重新设置：
+// - SystemCoreClock和DWT的每微秒周期数（timebase.h）
+// - SysTick：全速时用HCLK/8（configSYSTICK_CLOCK_HZ），降频后改用处理器时钟，计数频率都是9MHz，
+//   FreeRTOS的节拍不受影响；降频期间睡眠不停节拍（port.c的tickless会改回HCLK/8）
+// - 定时器：APB1全速时2分频（定时器时钟为PCLK1的2倍），降频后不分频，各定时器的时钟都等于HCLK，
+//   HAL时基（TIM7）和1-Wire（TIM6）的预分频按同一比例缩放，计数频率仍为1MHz
+// - 串口的波特率寄存器（uart_transport.h）；降频后PCLK只有9MHz，链路波特率不超过CLOCK_SCALE_BAUD_MAX时才降频
+// TIM4（LED/蜂鸣器PWM）不缩放，只在输出全部关闭时降频。1-Wire时隙中断需要全速，
+// 因此要求时隙由TIM6产生（DS18B20_USE_TIMER），逐位忙等的实现不降频
+#ifndef CLOCK_SCALE
+#define CLOCK_SCALE DS18B20_USE_TIMER // 1：空闲时降频
+#endif
+
+#define CLOCK_SCALE_DIVIDER  8U      // 降频后HCLK = 9MHz
+#define CLOCK_SCALE_QUIET_MS 20U     // 收发后至少这么久才降频，一次请求和应答都在全速下完成
+#define CLOCK_SCALE_BAUD_MAX 230400U // 9MHz下误差在0.2%以内的最高波特率
+
+#if CLOCK_SCALE
+// 恢复全速（任务或中断中调用，已是全速时直接返回）
+void clock_scale_full(void);
+
+// 保持全速直到clock_scale_release()（任务中调用，可嵌套），用于时序要求严格的外设操作
+void clock_scale_hold(void);
+void clock_scale_release(void);
+
+// 空闲任务睡眠之前调用（调度器已挂起）：可以降频时降频并返回true，否则恢复全速
+bool clock_scale_idle(void);
+
+// 当前是否降频
+bool clock_scale_low(void);
+#else
+static inline void clock_scale_full(void) {}
+static inline void clock_scale_hold(void) {}
+static inline void clock_scale_release(void) {}
+static inline bool clock_scale_idle(void) { return false; }
+static inline bool clock_scale_low(void) { return false; }
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CLOCK_SCALE_H
@@ -14,19 +14,75 @@ typedef int (*CommandHandler)(const uint8_t *request_data, uint16_t request_len,
                              uint8_t *response_data, uint16_t *response_len, 
                              uint8_t *status);
 
+// 处理函数返回COMMAND_DEFERRED表示已通过command_defer()挂起，响应稍后发送
+#define COMMAND_DEFERRED      1
+#define MAX_PENDING_COMMANDS  4
+
+// 批量请求：数据部分包含多组 IN[+DA]，响应按顺序包含多组 IN/ST/DA
+#define MAX_BATCH_COMMANDS    8
+
+// 温度推送：订阅后按间隔主动发送PKT_TYPE_SLAVE_REQUEST温度帧，报警状态变化时立即发送
+#define SUBSCRIBE_MIN_INTERVAL_MS 1000
+
+// glog分片传输的窗口模式：每发送WN片等待主机"fack"确认，只重发丢失的分片
+#define LOG_MAX_WINDOW        16
+#define LOG_ACK_TIMEOUT_MS    1000  // 超时未确认时重发窗口最后一片
+#define LOG_ACK_MAX_RETRIES   3     // 超过次数放弃传输
+
+// 延迟命令的完成函数，到期后调用以生成响应数据；可再次command_defer()并返回COMMAND_DEFERRED
+typedef int (*CommandCompleter)(uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+
+// 命令的优先级类别：执行任务先处理交互类请求，批量类（日志导出、多传感器扫描）
+// 在其间隙执行，正在进行的glog分片传输每发一片就让出一次
+#define COMMAND_CLASS_INTERACTIVE 0
+#define COMMAND_CLASS_BULK        1
+
 // 命令处理器结构
 typedef struct {
     char command[5];              // 4字符命令 + 结束符
     CommandHandler handler;       // 处理函数
+    uint8_t command_class;        // COMMAND_CLASS_*，省略时为交互类
 } CommandEntry;
 
 // 初始化命令处理系统
 void command_handler_init(void);
 
-// 处理收到的命令数据包
+// 单条命令响应的IN(8) + ST(5) + DA头(4)，就地写在DA之前
+#define RESPONSE_PREFIX_SIZE 17
+
+// 命令流水线的工作缓冲区：由调用者持有（执行任务一份，初始化时静态分配），
+// 逐条命令复用，命令处理函数不在栈上分配DA缓冲区。单条命令的IN/ST/DA头
+// 写在response_prefix的末尾，与DA连成一段直接编码进response_packet
+typedef struct {
+    uint8_t response_prefix[RESPONSE_PREFIX_SIZE];
+    uint8_t response_data[MAX_DATA_SIZE]; // 处理函数和完成函数生成的DA
+    uint8_t batch_data[MAX_DATA_SIZE];    // 批量请求汇总的各组IN/ST/DA
+} CommandScratch;
+
+// 处理收到的命令数据包，响应帧直接构建到response_packet（容量response_size）
+// 返回0表示响应已构建，COMMAND_DEFERRED表示命令挂起（无响应），-1表示失败。
+// 请求按communication_current_link()所在链路的会话（订阅、温度表示）处理
 int process_command_packet(const uint8_t *packet_data, uint16_t packet_len,
-                          uint8_t *response_packet, uint16_t *response_len,
-                          uint16_t response_id);
+                          uint8_t *response_packet, uint16_t response_size,
+                          uint16_t *response_len, uint16_t response_id,
+                          CommandScratch *scratch);
+
+// 请求数据包的优先级类别（COMMAND_CLASS_*），只读命令表，可在接收任务中调用；
+// 批量请求中任一条为批量类即为批量类，未知命令按交互类处理以便尽快回复错误。
+// *opcode为单条请求的指令编号，批量请求和未知指令为0（用于command_stats.h）
+uint8_t command_handler_request_class(const uint8_t *packet_data, uint16_t packet_len, uint8_t *opcode);
+
+// 在处理函数中调用：挂起当前命令，delay_ms后由completer生成响应
+bool command_defer(CommandCompleter completer, uint32_t delay_ms);
+
+// 距最早一个挂起命令到期的毫秒数，0表示已到期或有新的温度采样待处理，无挂起命令返回UINT32_MAX
+uint32_t command_handler_next_due_ms(void);
+
+// 完成一个已到期的挂起命令或温度推送，并构建发送帧，*link为帧要发往的链路
+// （发起命令或订阅推送的链路，帧已按该链路的组帧方式构建）
+// 返回1表示响应已构建，0表示没有到期命令，-1表示构建失败（命令已移除）
+int command_handler_poll(uint8_t *response_packet, uint16_t response_size, uint16_t *response_len,
+                         uint8_t *link, CommandScratch *scratch);
 
 // 各个命令的处理函数
 int handle_ping(const uint8_t *request_data, uint16_t request_len, 
@@ -56,6 +112,9 @@ int handle_set_alarms(const uint8_t *request_data, uint16_t request_len,
 int handle_get_log(const uint8_t *request_data, uint16_t request_len, 
                   uint8_t *response_data, uint16_t *response_len, uint8_t *status);
 
+int handle_fragment_ack(const uint8_t *request_data, uint16_t request_len, 
+                       uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+
 int handle_set_led(const uint8_t *request_data, uint16_t request_len, 
                   uint8_t *response_data, uint16_t *response_len, uint8_t *status);
 
@@ -68,6 +127,74 @@ int handle_set_buzzer(const uint8_t *request_data, uint16_t request_len,
 int handle_reset_buzzer(const uint8_t *request_data, uint16_t request_len, 
                        uint8_t *response_data, uint16_t *response_len, uint8_t *status);
 
+int handle_set_baud(const uint8_t *request_data, uint16_t request_len, 
+                   uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+
+int handle_subscribe(const uint8_t *request_data, uint16_t request_len, 
+                    uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+int handle_set_resolution(const uint8_t *request_data, uint16_t request_len, 
+                         uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+int handle_set_filter(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+int handle_get_sensors(const uint8_t *request_data, uint16_t request_len, 
+                      uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+int handle_set_log_interval(const uint8_t *request_data, uint16_t request_len, 
+                           uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+int handle_get_events(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+int handle_set_datetime(const uint8_t *request_data, uint16_t request_len, 
+                       uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+int handle_get_datetime(const uint8_t *request_data, uint16_t request_len, 
+                       uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+int handle_clock_sync(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+int handle_get_stats(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+
+int handle_get_comm_stats(const uint8_t *request_data, uint16_t request_len, 
+                          uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+
+int handle_get_trace(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+// 链路吞吐测试：回显PD或生成SZ字节的载荷，CT大于1时连续发送CT帧
+int handle_bench(const uint8_t *request_data, uint16_t request_len, 
+                 uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+// 设置/查询从机地址（有线链路的多点总线），设置保存在闪存中
+int handle_set_address(const uint8_t *request_data, uint16_t request_len, 
+                       uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+// 网关角色（COMM_GATEWAY，gateway.h）：设置下游地址表、读取缓存的读数、转发请求给下游设备；
+// 非网关固件返回STATUS_NOT_INITIALIZED
+int handle_gateway_config(const uint8_t *request_data, uint16_t request_len, 
+                          uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+int handle_gateway_read(const uint8_t *request_data, uint16_t request_len, 
+                        uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+int handle_forward(const uint8_t *request_data, uint16_t request_len, 
+                   uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+// 获取报警前后的逐秒温度记录
+int handle_get_bursts(const uint8_t *request_data, uint16_t request_len, 
+                      uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+// 固件升级（FW_UPDATE，fw_update.h）：开始、写入一块、校验、安装；不支持时返回STATUS_NOT_INITIALIZED
+int handle_fw_begin(const uint8_t *request_data, uint16_t request_len, 
+                    uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+int handle_fw_chunk(const uint8_t *request_data, uint16_t request_len, 
+                    uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+int handle_fw_verify(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+int handle_fw_commit(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+// 设置 / 查询传感器校准点
+int handle_set_calibration(const uint8_t *request_data, uint16_t request_len, 
+                           uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+// 获取传感器读数的运行统计
+int handle_get_temp_stats(const uint8_t *request_data, uint16_t request_len, 
+                          uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+// 一次返回所有传感器的缓存读数和健康状态
+int handle_get_all_temps(const uint8_t *request_data, uint16_t request_len, 
+                         uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+
+int handle_get_tasks(const uint8_t *request_data, uint16_t request_len, 
+                    uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+
 #ifdef __cplusplus
 }
 #endif
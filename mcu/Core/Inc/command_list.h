@@ -0,0 +1,62 @@
+#ifndef COMMAND_LIST_H
+#define COMMAND_LIST_H
+
+#include "protocol.h"
+
+// 命令清单：每条命令一行
+//   X(编号, 名称, 处理函数, 类别, 请求DA字段表, 响应DA字段表)
+// 编号和名称为protocol.h中的OP_*、CMD_*；类别为COMMAND_CLASS_*的后缀；
+// 字段表写tlv_schema.c中字段表对象的地址，没有DA字段时写NULL
+// 各模块只展开自己需要的列：command_handler.c的命令表和名称散列表、
+// tlv_schema.c的请求/响应字段表索引、command_stats.h的统计槽数，
+// 以及主机端由host/schema_gen.c生成的TypeScript和C++绑定。
+// 新增命令：在protocol.h中定义编号和名称，在tlv_schema.c中定义字段表，再在末尾追加一行，
+// 编号须连续
+#define COMMAND_LIST(X) \
+    X(OP_PING,            CMD_PING,            handle_ping,             INTERACTIVE, &ping_request,       &ping_response)      \
+    X(OP_GET_TEMP,        CMD_GET_TEMP,        handle_get_temp,         INTERACTIVE, &temp_request,       &temp_response)      \
+    X(OP_GET_RTC_DATE,    CMD_GET_RTC_DATE,    handle_get_rtc_date,     INTERACTIVE, NULL,                &rtc_date_schema)    \
+    X(OP_GET_RTC_TIME,    CMD_GET_RTC_TIME,    handle_get_rtc_time,     INTERACTIVE, NULL,                &rtc_time_schema)    \
+    X(OP_SET_RTC_DATE,    CMD_SET_RTC_DATE,    handle_set_rtc_date,     INTERACTIVE, &rtc_date_schema,    NULL)                \
+    X(OP_SET_RTC_TIME,    CMD_SET_RTC_TIME,    handle_set_rtc_time,     INTERACTIVE, &rtc_time_schema,    NULL)                \
+    X(OP_GET_ALARMS,      CMD_GET_ALARMS,      handle_get_alarms,       INTERACTIVE, &galm_request,       &galm_response)      \
+    X(OP_SET_ALARMS,      CMD_SET_ALARMS,      handle_set_alarms,       INTERACTIVE, &alarm_list_schema,  NULL)                \
+    X(OP_GET_LOG,         CMD_GET_LOG,         handle_get_log,          BULK,        &glog_request,       &glog_response)      \
+    X(OP_SET_LED,         CMD_SET_LED,         handle_set_led,          INTERACTIVE, &pattern_schema,     NULL)                \
+    X(OP_RESET_LED,       CMD_RESET_LED,       handle_reset_led,        INTERACTIVE, NULL,                NULL)                \
+    X(OP_SET_BUZZER,      CMD_SET_BUZZER,      handle_set_buzzer,       INTERACTIVE, &pattern_schema,     NULL)                \
+    X(OP_RESET_BUZZER,    CMD_RESET_BUZZER,    handle_reset_buzzer,     INTERACTIVE, NULL,                NULL)                \
+    X(OP_SET_BAUD,        CMD_SET_BAUD,        handle_set_baud,         INTERACTIVE, &baud_request,       NULL)                \
+    X(OP_SUBSCRIBE,       CMD_SUBSCRIBE,       handle_subscribe,        INTERACTIVE, &subscribe_request,  NULL)                \
+    X(OP_FRAGMENT_ACK,    CMD_FRAGMENT_ACK,    handle_fragment_ack,     INTERACTIVE, &fack_request,       NULL)                \
+    X(OP_SET_RESOLUTION,  CMD_SET_RESOLUTION,  handle_set_resolution,   INTERACTIVE, &sres_schema,        &sres_schema)        \
+    X(OP_SET_FILTER,      CMD_SET_FILTER,      handle_set_filter,       INTERACTIVE, &sflt_schema,        &sflt_schema)        \
+    X(OP_GET_SENSORS,     CMD_GET_SENSORS,     handle_get_sensors,      BULK,        NULL,                &sensor_list_schema) \
+    X(OP_SET_LOG_INTERVAL, CMD_SET_LOG_INTERVAL, handle_set_log_interval, INTERACTIVE, &slog_schema,      &slog_schema)        \
+    X(OP_GET_EVENTS,      CMD_GET_EVENTS,      handle_get_events,       BULK,        &gevt_request,       &gevt_response)      \
+    X(OP_SET_DATETIME,    CMD_SET_DATETIME,    handle_set_datetime,     INTERACTIVE, &datetime_schema,    NULL)                \
+    X(OP_GET_DATETIME,    CMD_GET_DATETIME,    handle_get_datetime,     INTERACTIVE, NULL,                &datetime_schema)    \
+    X(OP_CLOCK_SYNC,      CMD_CLOCK_SYNC,      handle_clock_sync,       INTERACTIVE, &csyn_request,       &csyn_response)      \
+    X(OP_GET_TASKS,       CMD_GET_TASKS,       handle_get_tasks,        INTERACTIVE, NULL,                &gtsk_response)      \
+    X(OP_GET_STATS,       CMD_GET_STATS,       handle_get_stats,        INTERACTIVE, &stat_request,       &stat_response)      \
+    X(OP_GET_COMM_STATS,  CMD_GET_COMM_STATS,  handle_get_comm_stats,   INTERACTIVE, &gcom_request,       &gcom_response)      \
+    X(OP_GET_TRACE,       CMD_GET_TRACE,       handle_get_trace,        BULK,        &gtrc_request,       &gtrc_response)      \
+    X(OP_BENCH,           CMD_BENCH,           handle_bench,            BULK,        &bnch_request,       &bnch_response)      \
+    X(OP_SET_ADDRESS,     CMD_SET_ADDRESS,     handle_set_address,      INTERACTIVE, &sadr_schema,        &sadr_schema)        \
+    X(OP_GATEWAY_CONFIG,  CMD_GATEWAY_CONFIG,  handle_gateway_config,   INTERACTIVE, &sgwy_schema,        &sgwy_schema)        \
+    X(OP_GATEWAY_READ,    CMD_GATEWAY_READ,    handle_gateway_read,     INTERACTIVE, &ggwy_request,       &ggwy_response)      \
+    X(OP_FORWARD,         CMD_FORWARD,         handle_forward,          INTERACTIVE, &fwrd_schema,        &fwrd_schema)        \
+    X(OP_GET_BURSTS,      CMD_GET_BURSTS,      handle_get_bursts,       BULK,        &gbst_request,       &gbst_response)      \
+    X(OP_FW_BEGIN,        CMD_FW_BEGIN,        handle_fw_begin,         INTERACTIVE, &fwbg_request,       &fwbg_response)      \
+    X(OP_FW_CHUNK,        CMD_FW_CHUNK,        handle_fw_chunk,         INTERACTIVE, &fwch_request,       &fwch_response)      \
+    X(OP_FW_VERIFY,       CMD_FW_VERIFY,       handle_fw_verify,        INTERACTIVE, NULL,                &fwvf_response)      \
+    X(OP_FW_COMMIT,       CMD_FW_COMMIT,       handle_fw_commit,        INTERACTIVE, NULL,                NULL)                \
+    X(OP_SET_CALIBRATION, CMD_SET_CALIBRATION, handle_set_calibration,  INTERACTIVE, &scal_schema,        &scal_schema)        \
+    X(OP_GET_TEMP_STATS,  CMD_GET_TEMP_STATS,  handle_get_temp_stats,   INTERACTIVE, &tsta_request,       &tsta_response)      \
+    X(OP_GET_ALL_TEMPS,   CMD_GET_ALL_TEMPS,   handle_get_all_temps,    INTERACTIVE, NULL,                &tall_response)
+
+// 命令数（不含保留的编号0）
+#define COMMAND_LIST_COUNT_ONE(op, name, handler, cls, request, response) + 1
+enum { COMMAND_COUNT = 0 COMMAND_LIST(COMMAND_LIST_COUNT_ONE) };
+
+#endif // COMMAND_LIST_H
@@ -0,0 +1,55 @@
+#ifndef COMMAND_STATS_H
+#define COMMAND_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "protocol.h"
+#include "command_list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 按指令编号统计请求数和两段耗时（DWT周期计数，换算为微秒）：
+// - 排队和执行：接收任务收完请求帧到执行任务把响应帧提交到发送队列
+// - 发送：响应帧提交到发送队列到DMA发送完成（发送完成中断中记录）
+// 耗时按2的幂分桶：桶0为16微秒以下，桶i为[2^(i+3), 2^(i+4))微秒，最后一桶不封顶。
+// 挂起的命令（带FR的temp、sres、glog的后续分片）只计请求数，完成时间不计入；
+// 编号0统计批量请求和未知指令
+#define COMMAND_STATS_BUCKETS  16
+#define COMMAND_STATS_OPCODES  (COMMAND_COUNT + 1)
+#define COMMAND_STATS_NONE     0xFFU // 发送槽中的帧不属于需要计时的请求
+#define COMMAND_STATS_WARM_MAGIC 0x434D5354UL // 热复位保留块（warm_state.h）
+
+typedef struct {
+    uint32_t count;                              // 执行的请求数
+    uint32_t queued_max_us;
+    uint32_t transmit_max_us;
+    uint16_t queued_hist[COMMAND_STATS_BUCKETS]; // 各桶计数，到65535后不再增加
+    uint16_t transmit_hist[COMMAND_STATS_BUCKETS];
+} CommandStats;
+
+// 启动时调用（调度器启动前）：热复位且保留的统计校验通过时沿用，否则清零
+void command_stats_warm_restore(void);
+
+// 执行任务开始执行一个请求
+void command_stats_record_request(uint8_t opcode);
+// 响应已提交，cycles为收完请求帧以来的周期数
+void command_stats_record_queued(uint8_t opcode, uint32_t cycles);
+// 响应发送完成（中断中调用），cycles为提交以来的周期数
+void command_stats_record_transmit(uint8_t opcode, uint32_t cycles);
+
+// 读取opcode的统计，编号超出范围返回false
+bool command_stats_get(uint8_t opcode, CommandStats *stats);
+// 清零opcode的统计
+void command_stats_reset(uint8_t opcode);
+
+// 直方图中percent%的样本不超过的耗时（微秒）：取所在桶的上界，不超过最大值max_us；
+// 没有样本时返回0
+uint32_t command_stats_percentile_us(const uint16_t *hist, uint32_t max_us, uint8_t percent);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMAND_STATS_H
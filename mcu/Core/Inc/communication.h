@@ -9,9 +9,60 @@
 extern "C" {
 #endif
 
+// 通信分为两个任务：接收任务（main.c中的commRxTask，优先级高于采样任务）
+// 只做DMA接收、逐字节解析和波特率切换，收完的帧连同缓冲区交给命令执行任务；
+// 执行任务（优先级低于采样任务）执行命令、完成挂起命令和推送。慢命令不会耽误接收，
+// 交互类请求（command_handler.h的COMMAND_CLASS_*）先于批量类请求和glog分片执行，
+// 执行任务积压时新请求回复ERROR_CODE_BUSY。
+// 每条链路（COMM_LINK_*）是一个独立的会话：各自的环形缓冲区、解析器、发送队列、
+// 组帧方式、波特率和统计；接收任务轮流处理各链路，执行任务按请求所属的链路回复，
+// 挂起命令和订阅推送发回发起它们的链路（command_handler.h）。发送槽和请求缓冲区各链路共用
+
+// 链路：USART1接BLE模块，UART4（PC10/PC11）为维护用的有线串口，
+// USB虚拟串口（usb_cdc.h）用于现场批量导出日志。
+// 网关角色（COMM_GATEWAY=1，gateway.h）中UART4是下游RS-485总线，由总线主机使用，不是协议链路
+#ifndef COMM_GATEWAY
+#define COMM_GATEWAY 0
+#endif
+#ifndef COMM_WIRED_LINK
+#define COMM_WIRED_LINK (!COMM_GATEWAY)
+#endif
+#ifndef COMM_USB_LINK
+#define COMM_USB_LINK 1
+#endif
+#define COMM_LINK_BLE   0
+#define COMM_LINK_WIRED 1
+#define COMM_LINK_USB   (1 + COMM_WIRED_LINK)
+#define COMM_LINK_COUNT (1 + COMM_WIRED_LINK + COMM_USB_LINK)
+#define COMM_LINK_BUS   0xFE // 传输层回调中的下游总线（网关角色），事件转给gateway.h
+
 // 通信缓冲区大小
-#define COMM_RX_BUFFER_SIZE 1024
-#define COMM_TX_BUFFER_SIZE 1024
+#define COMM_RX_BUFFER_SIZE 1024   // 每个请求缓冲区的大小
+#define COMM_REQUEST_SLOTS  (COMM_LINK_COUNT + 3) // 请求缓冲区数量：每个解析器占用一个，其余排队等待执行
+#define COMM_EXECUTOR_STACK_WORDS 512
+#define COMM_TX_BUFFER_SIZE 1024 // 每个发送槽的大小
+#define COMM_TX_SLOT_COUNT  4    // 发送槽数量（必须为2的幂），同时也是发送队列深度
+#define COMM_TX_ACQUIRE_TIMEOUT_MS 200 // 无空闲发送槽时等待DMA发送完成的最长时间
+#define COMM_RX_RING_SIZE   512 // 每条链路的接收环形缓冲区，必须为2的幂
+
+// 波特率协商：切换后COMM_BAUD_FALLBACK_MS内未收到有效帧则回退到链路的默认波特率
+// （BLE链路为上电配置模块后的波特率，见ble_module.h）
+#define COMM_DEFAULT_BAUD_RATE  115200
+#define COMM_BAUD_FALLBACK_MS   3000
+// 可协商的波特率，从低到高（ping的能力列表按此顺序列出）
+#define COMM_BAUD_RATES         {115200, 230400, 460800, 921600}
+#define COMM_BAUD_RATE_COUNT    4
+
+// 收发后COMM_STOP_HOLDOFF_MS内不进入STOP模式（low_power.h），连续的命令不会因唤醒而丢字节
+#define COMM_STOP_HOLDOFF_MS    5000
+
+// 通信任务事件标志（由UART回调置位）
+#define COMM_EVENT_RX    0x0001U
+#define COMM_EVENT_TX    0x0002U
+#define COMM_EVENT_ERROR 0x0004U
+#define COMM_EVENT_WAKE  0x0008U  // 其他任务请求处理（如新的温度采样、待切换的波特率）
+#define COMM_EVENT_ALL   (COMM_EVENT_RX | COMM_EVENT_TX | COMM_EVENT_ERROR | COMM_EVENT_WAKE)
+#define COMM_EVENT_REQUEST 0x0010U // 执行任务：接收任务提交了新请求
 
 // 通信状态
 typedef enum {
@@ -21,41 +72,126 @@ typedef enum {
     COMM_STATE_TRANSMITTING
 } CommState;
 
-// 通信统计信息
+// 链路的传输层接口：communication.c只经过这些函数访问收发硬件（实现见uart_transport.h），
+// context为具体实现的端口对象
+typedef struct {
+    void (*start_rx)(void *context, uint8_t *buffer, uint16_t size); // 从buffer开头循环接收
+    void (*stop_rx)(void *context);
+    uint16_t (*rx_position)(void *context);                          // 当前写入位置
+    bool (*send)(void *context, const uint8_t *data, uint16_t length); // 上一帧未完成时返回false
+    bool (*set_baud)(void *context, uint32_t baud_rate);           // 收发都停止时调用
+} CommTransportOps;
+
+typedef struct {
+    const CommTransportOps *ops;
+    void *context;
+} CommTransport;
+
+// 通信统计信息（每条链路一份）
 typedef struct {
     uint32_t packets_received;
     uint32_t packets_sent;
     uint32_t crc_errors;
     uint32_t format_errors;
     uint32_t timeout_errors;
+    uint32_t tx_queue_depth;   // 当前排队等待发送的帧数（不含正在发送的帧）
+    uint32_t tx_queue_peak;    // 发送队列历史最大深度
+    uint32_t tx_dropped;       // 等待发送槽超时而丢弃的帧数（丢弃的响应）
+    uint32_t rx_dropped;       // 没有空闲请求缓冲区而丢弃的请求数
+    uint32_t rx_bytes;         // 串口收到的字节数（含帧外的噪声）
+    uint32_t tx_bytes;         // 发送完成的字节数
+    uint32_t rx_unstuffed;     // 解析时去掉的转义字节和COBS编码开销
+    uint32_t tx_stuffed;       // 组帧时加入的转义字节和COBS编码开销（各链路合计）
+    uint32_t resyncs;          // 放弃未完成的帧、重新寻找起始符的次数
+    uint32_t rx_ring_peak;     // 接收环形缓冲区的最大已用字节数
+    uint32_t rx_overflows;     // 接收环形缓冲区溢出次数
 } CommStats;
 
 // 初始化通信模块
 void communication_init(void);
 
-// 通信任务（在RTOS任务中调用）
-void communication_task(void);
+// 创建命令执行任务（在osKernelInitialize()之后、osKernelStart()之前调用）
+void communication_start(void);
 
-// UART接收完成回调
-void communication_rx_complete_callback(void);
+// 接收任务：阻塞等待通信事件（接收数据、发送完成或UART错误），最多等待timeout_ms
+void communication_wait_event(uint32_t timeout_ms);
 
-// UART发送完成回调
-void communication_tx_complete_callback(void);
+// 由其他任务唤醒命令执行任务（新的温度采样等）
+void communication_wake(void);
 
-// UART错误回调
-void communication_error_callback(void);
+// 由其他任务唤醒接收任务（网关的转发请求、新的地址表）
+void communication_wake_rx(void);
+
+// 接收任务的处理（在communication_wait_event()返回后调用）
+void communication_task(void);
 
-// 获取通信状态
+// 以下回调由传输层在串口/DMA中断（抢占优先级5）中调用，link为链路编号，只做常数时间的工作，
+// 分帧、转义和溢出处理都在接收任务中完成，不影响TIM6（1-Wire时隙）的中断延迟：
+// - 接收：只推进环形缓冲区的head并唤醒接收任务
+// - 发送完成：记录发送耗时（command_stats.h），归还槽并启动队列中的下一帧DMA（不复制数据）
+// - 错误：计数；接收已停止时置位重启标志并唤醒接收任务
+// UART接收事件回调（DMA半满/全满/空闲线），dma_pos为DMA当前写入位置
+void communication_rx_event_callback(uint8_t link, uint16_t dma_pos);
+
+// UART发送完成回调
+void communication_tx_complete_callback(uint8_t link);
+
+// UART错误回调，rx_stopped为true表示接收DMA已停止
+void communication_error_callback(uint8_t link, bool rx_stopped);
+
+// 执行任务正在为其构建帧的链路（处理请求时为请求到达的链路）
+uint8_t communication_current_link(void);
+
+// 正在执行的请求收完以来的微秒数（DWT周期计数），只在处理请求时有效
+uint32_t communication_request_age_us(void);
+
+// 切换到link构建帧（挂起命令的完成和推送）：之后的帧按该链路主机所用的组帧方式构建，
+// 统计、波特率协商等接口也作用于该链路。只由执行任务调用
+void communication_select_link(uint8_t link);
+
+// 分配从机数据包编号（最高位固定为1）
+uint16_t communication_next_packet_id(void);
+
+// 波特率协商（当前链路）
+bool communication_is_baud_supported(uint32_t baud_rate);
+bool communication_request_baud_rate(uint32_t baud_rate); // 当前响应发送完成后切换
+// 设置链路的回退波特率并立即切换（communication_init()之后、调度器启动前调用）
+void communication_set_base_baud_rate(uint8_t link_id, uint32_t baud_rate);
+uint32_t communication_get_baud_rate(void);
+
+// 从机地址：有线链路接RS-485多点总线时只接受发给本机地址的带地址帧，
+// PROTOCOL_ADDRESS_NONE为不过滤；其他链路是点对点的，不过滤。
+// 上电后到存储任务载入地址之前，有线链路不接受任何帧，避免总线上的多台设备同时应答
+void communication_set_address(uint8_t address);
+uint8_t communication_get_address(void);
+// 载入保存的地址（存储任务在设置扫描完成后调用），没有保存时为PROTOCOL_ADDRESS_NONE
+void communication_load_address(void);
+// 保存设置时读取当前地址（config_store.c）
+void communication_get_address_item(uint16_t index, void *item);
+
+// 记录串口活动（收发、STOP期间RX线上的唤醒），推迟进入STOP模式
+void communication_mark_activity(void);
+// 所有链路都没有待发送、待处理的数据，网关的总线上也没有进行中的事务，且已有quiet_ms没有收发
+bool communication_quiet(uint32_t quiet_ms);
+// 同时没有进行中的波特率切换，且已有COMM_STOP_HOLDOFF_MS没有收发
+bool communication_stop_allowed(void);
+// 没有进行中的波特率切换，各链路的波特率降频后仍可用，且已有CLOCK_SCALE_QUIET_MS没有收发（clock_scale.h）
+bool communication_low_clock_allowed(void);
+
+// 获取当前链路的通信状态
 CommState communication_get_state(void);
 
-// 获取通信统计信息
+// 获取当前链路的通信统计信息
 void communication_get_stats(CommStats *stats);
 
-// 重置通信统计信息
+// 获取指定链路的通信统计信息
+void communication_get_link_stats(uint8_t link, CommStats *stats);
+
+// 重置当前链路的通信统计信息
 void communication_reset_stats(void);
 
-// 发送错误响应
-int send_error_response(uint16_t response_id, uint8_t error_code, const char *error_desc);
+// 在link上发送错误响应
+int send_error_response(uint8_t link, uint16_t response_id, uint8_t error_code, const char *error_desc);
 
 #ifdef __cplusplus
 }
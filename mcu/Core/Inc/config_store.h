@@ -0,0 +1,44 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 设置存储：日志区末尾的两页（见log_store.h），按键保存报警规则表等设置，复位和掉电后恢复。
+// 每次保存在当前页追加一条带CRC的记录，同一个键以最后一条完整的记录为准；
+// 当前页写满时把其他键的最新记录搬到另一页再写入，两页轮流擦除。
+// 与日志一样只由存储任务（storage_task.h）在1-Wire总线空闲时擦写闪存
+#define CONFIG_STORE_PAGES 2U
+
+// 设置的键
+#define CONFIG_KEY_ALARMS  0  // 报警规则表：MAX_ALARMS个AlarmConfig
+#define CONFIG_KEY_CLOCK   1  // RTC频率校准值（rtc_clock.h）
+#define CONFIG_KEY_ADDRESS 2  // 从机地址（communication.h）
+#define CONFIG_KEY_GATEWAY 3  // 网关的下游地址表和轮询间隔（gateway.h），只在网关角色中保存
+#define CONFIG_KEY_SAMPLING 4 // 记录间隔、分辨率和滤波（sampling_settings.h）
+#define CONFIG_KEY_COMPRESS 5 // 各传感器的日志压缩配置：TEMP_MAX_SENSORS个LogCompressConfig
+#define CONFIG_KEY_CALIB  6  // 各传感器的校准点：TEMP_MAX_SENSORS个TempCalibration（temp_calib.h）
+#define CONFIG_KEY_COUNT   7
+
+// 扫描两页，找到当前页和写入位置（存储任务启动时调用，可重复调用）
+void config_store_init(void);
+
+// 取key最新的记录：返回指向闪存中内容的指针（可能不对齐，用memcpy读取），
+// 没有记录、CRC错误或内容格式已变化时返回NULL
+const void *config_store_find(uint8_t key, uint16_t *length);
+
+// 标记key需要保存并唤醒存储任务，由它在下一次config_store_service()中读取当前设置并写入
+void config_store_request_save(uint8_t key);
+
+// 写入标记过的设置，只由存储任务在取得1-Wire总线锁后调用
+void config_store_service(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CONFIG_STORE_H
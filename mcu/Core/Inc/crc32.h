@@ -0,0 +1,57 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 协议CRC32：与STM32F1硬件CRC单元一致
+// - 多项式0x04C11DB7，初值0xFFFFFFFF，MSB优先，无输入/输出反射，无最终异或
+// - 数据按32位小端字依次输入；末尾不足4字节时高位补0组成最后一个字
+// 软件实现不依赖HAL，可在主机上编译作为参考实现
+
+// 增量计算上下文：数据可分多次、任意长度输入，凑满4字节即折算一个字
+// F1的CRC单元无法恢复中间状态，而收发两个方向的帧会交错计算，
+// 因此增量接口使用软件查表实现
+typedef struct {
+    uint32_t crc;          // 已折算字的CRC
+    uint32_t pending;      // 未满一个字的字节（小端拼接）
+    uint8_t pending_len;   // pending中的字节数（0~3）
+} Crc32Context;
+
+void crc32_init(Crc32Context *ctx);
+void crc32_update(Crc32Context *ctx, const uint8_t *data, size_t length);
+void crc32_update_byte(Crc32Context *ctx, uint8_t byte);
+uint32_t crc32_final(const Crc32Context *ctx); // 不改变上下文，可继续输入
+
+// 计算CRC32：CRC硬件已初始化时使用硬件，否则使用查表软件实现。
+// 调度器启动后（crc32_dma_init()之后），按4字节对齐的连续整字不少于CRC32_DMA_MIN_LENGTH字节时
+// 由DMA写入CRC单元，调用任务在传输期间阻塞，CPU运行其他任务；更短的开始和唤醒的开销超过逐字写入
+#define CRC32_DMA_MIN_LENGTH 256U
+uint32_t crc32_compute(const uint8_t *data, size_t length);
+
+// 分段计算：结果与各段首尾拼接后crc32_compute()的结果相同，用于跳过中间的字段（如数据块自身的CRC）。
+// 硬件CRC按字输入，除最后一段外各段长度须为4的倍数
+typedef struct {
+    const void *data;
+    size_t length;
+} Crc32Segment;
+uint32_t crc32_compute_segments(const Crc32Segment *segments, size_t count);
+
+#if defined(USE_HAL_DRIVER)
+// 创建硬件CRC的互斥量（各任务共用CRC单元）并开启DMA中断，osKernelInitialize()之后调用
+void crc32_dma_init(void);
+void crc32_dma_irq_handler(void); // DMA1_Channel7_IRQHandler
+#endif
+
+// 软件实现（slice-by-4查表）
+uint32_t crc32_compute_sw(const uint8_t *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CRC32_H
@@ -4,59 +4,207 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "protocol.h"
+#include "log_store.h"
+#include "rtc_clock.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// LED（TIM4 CH4，PB9）和蜂鸣器（TIM4 CH3，PB8）各用一个PWM通道，互不影响。
+// 节拍：打开on_ms、关闭off_ms为一次，重复count次（0为一直重复）后关闭，
+// 由软件定时器切换，调用方不需要轮询。play播放output_sequencer.h中的预置序列
+// （OUTPUT_SEQUENCE_*，由DMA逐步写占空比），loop为false时播放一次，编号无效时返回false。
+// on/off/toggle、新的节拍和新的序列都会取消进行中的节拍或序列。
+// 启动节拍时on_ms不能为0，count不为1时off_ms也不能为0。
+// duty为打开时的占空比（0~OUTPUT_DUTY_MAX，见output_sequencer.h），on()为50%
+#define OUTPUT_PATTERN_FOREVER 0U
+bool output_pattern_valid(uint16_t on_ms, uint16_t off_ms, uint16_t count);
+uint8_t output_duty_from_percent(uint8_t percent); // 0~100%换算为占空比
+
+// PWM载波频率（Hz）：两个输出共用TIM4的计数器，主要决定蜂鸣器的音调，
+// 默认约1000 Hz，修改后保持到复位；超出范围时返回false
+#define OUTPUT_FREQUENCY_MIN 200U
+#define OUTPUT_FREQUENCY_MAX 8000U
+bool output_set_frequency(uint16_t hz);
+uint16_t output_get_frequency(void);
+
+// 两个输出都关闭且没有序列在播放（TIM4停止时输出保持低电平，可以进入STOP模式）
+bool output_all_off(void);
+
 // LED控制
 void led_init(void);
 void led_on(void);
 void led_off(void);
+void led_set_duty(uint8_t duty);  // 以duty常亮，0为熄灭
 void led_toggle(void);
+void led_blink(uint16_t on_ms, uint16_t off_ms, uint16_t count, uint8_t duty);
+bool led_play(uint8_t sequence, bool loop);
 bool led_get_state(void);
 
 // 蜂鸣器控制
 void buzzer_init(void);
 void buzzer_on(void);
 void buzzer_off(void);
-void buzzer_beep(uint32_t duration_ms);
+void buzzer_set_duty(uint8_t duty);
+void buzzer_beep(uint16_t duration_ms);
+void buzzer_pattern(uint16_t on_ms, uint16_t off_ms, uint16_t count, uint8_t duty);
+bool buzzer_play(uint8_t sequence, bool loop);
 bool buzzer_get_state(void);
 
-// 温度传感器
-float temperature_get_current(void);
-bool temperature_sensor_init(void);
-bool temperature_is_sensor_ok(void);
-
-// RTC功能
-bool rtc_get_date(RTCDate *date);
-bool rtc_set_date(const RTCDate *date);
-bool rtc_get_time(RTCTime *time);
-bool rtc_set_time(const RTCTime *time);
-bool rtc_is_initialized(void);
-uint64_t rtc_get_timestamp(void);
-
-// 报警系统
-#define MAX_ALARMS 2
-extern AlarmConfig g_alarm_configs[MAX_ALARMS];
-
-void alarm_init(void);
-void alarm_set_config(uint8_t alarm_id, float low_temp, float high_temp);
+// 温度传感器（温度单位0.1°C，失败返回TEMP_INVALID）
+// 启动后只由温度采样任务访问总线，其他模块通过temp_sampler_get()取值
+// 总线上可挂多个DS18B20，初始化时搜索ROM，传感器按搜索顺序编号0~count-1；
+// 其他类型的传感器作为驱动（temp_driver.h）注册，编号排在DS18B20之后
+#define TEMP_MAX_SENSORS 4
+uint8_t temperature_sample_all(int16_t *temperatures); // 所有驱动同时转换后读取，返回传感器数
+int16_t temperature_get_current(void);                  // 同上，只返回0号传感器
+// DS18B20驱动的操作：sensor为总线上的编号
+bool temperature_start_conversion(uint32_t *remaining_ms); // remaining_ms为最长剩余时间
+bool temperature_conversion_done(void);  // 轮询转换是否完成（读时隙回1或超时）
+int16_t temperature_read_conversion(uint8_t sensor);
+bool temperature_sensor_init(void);      // 注册驱动并发现传感器，没有任何传感器时返回false
+uint8_t temperature_sensor_count(void);  // 所有驱动的传感器总数
+
+// 传感器健康状态：采样任务每次采样后更新，其他任务只读取缓存，不访问总线
+typedef struct {
+    bool present;                // 最近一次读取成功
+    uint16_t consecutive_faults; // 连续失败次数
+    uint32_t fault_count;        // 累计失败次数（无存在脉冲、CRC错误、转换超时）
+    uint32_t last_seen_tick;     // 最近一次读取成功时的HAL_GetTick()
+    uint32_t seen_count;         // 累计成功次数，0表示从未读取成功
+} TempSensorHealth;
+bool temperature_get_health(uint8_t sensor, TempSensorHealth *health);
+bool temperature_is_sensor_ok(void); // 任一传感器最近一次读取成功
+// 分辨率9~12位，对应0.5/0.25/0.125/0.0625°C，最长转换时间94/188/375/750ms
+#define TEMP_RESOLUTION_MIN     9
+#define TEMP_RESOLUTION_MAX     12
+#define TEMP_RESOLUTION_DEFAULT 12
+bool temperature_set_resolution(uint8_t bits); // 写入传感器EEPROM并读回确认
+uint8_t temperature_get_resolution(void);
+
+
+// 报警系统：规则表，每条规则针对一个或任一传感器，检查上下限、变化速率和按速率预测的温度，
+// 报警期间执行actions中的动作。默认规则0（蜂鸣器）和规则1（LED）启用，其余停用
+#ifndef MAX_ALARMS
+#define MAX_ALARMS 32 // 规则数，不超过32（状态按位保存）
+#endif
+
+void alarm_init(void); // 加载保存的规则表（config_store.h），没有时使用默认规则
+bool alarm_config_valid(const AlarmConfig *config); // 检查规则的取值范围
+void alarm_set_config(const AlarmConfig *config); // 按config->id修改，调用方检查取值，不保存
 void alarm_get_config(uint8_t alarm_id, AlarmConfig *config);
-void alarm_check_temperature(float temperature);
+// 规则超限并持续delay_s秒后进入报警，回到回差范围内且速率不超限后解除；
+// 触发报警的传感器读取失败时保持报警，重新读到范围内的温度后才解除；
+// 只在进入和解除时更新蜂鸣器/LED并记入事件日志；由采样任务在每次转换后调用
+void alarm_check_temperatures(const int16_t *temperatures, uint8_t count);
+uint32_t alarm_get_active_mask(void); // 处于报警状态的规则（bit i = 规则i）
 void alarm_reset_all(void);
 
-// 温度日志系统
-#define MAX_LOG_ENTRIES 100
-extern TempLogEntry g_temp_log[MAX_LOG_ENTRIES];
-extern uint32_t g_log_count;
-extern uint32_t g_log_write_index;
+// 报警通知：事件记入日志的同时放入队列（采样任务），由通信任务取出推送给主机；
+// 队列满时丢弃新的通知，事件仍可用gevt查询。通知的sequence为0（入日志前还没有序号）
+#define ALARM_NOTIFY_QUEUE_LEN 8
+bool alarm_notify_pending(void);
+bool alarm_notify_pop(AlarmEvent *event);
+
+// 报警前后记录：采样任务每次报警检查后调用alarm_burst_sample()，把滤波后的读数放入RAM中的
+// 环形缓冲（最近ALARM_BURST_PRE_SAMPLES次）。规则进入或离开报警时冻结触发传感器的这段读数，
+// 再收集之后ALARM_BURST_POST_SAMPLES次，合为一条记录写入日志流LOG_STREAM_BURSTS，
+// 采样和温度日志的间隔都不变。记录分块，每次采样最多追加一块，不占满待写队列；
+// 缺块（写入中途复位）的记录读取时跳过。收集期间的其他事件不再触发
+void alarm_burst_sample(const int16_t *temperatures, uint8_t count);
+#define ALARM_BURST_CHUNKS (ALARM_BURST_SAMPLES / LOG_BURST_CHUNK_SAMPLES) // 每条记录的块数
+
+// 温度日志系统（闪存存储，见log_store.h）
+#define MAX_LOG_ENTRIES 100 // 一次查询默认最多返回的条数
+
+// 日志查询：sensor号传感器在时间范围内的日志，按时间顺序逐条读取，
+// 不复制到中间数组；保存iter即可从同一位置继续
+typedef struct {
+    LogStoreIter iter;
+    uint32_t start_time;
+    uint32_t end_time;
+    uint8_t sensor;
+    bool filter_raw;     // 温度筛选按滤波前的温度判断
+    int16_t low;         // 温度筛选（temp_log_query_filter()），默认不筛选
+    int16_t high;
+    bool gap;            // 上一次temp_log_query_next()越过了该传感器范围外的记录（或整页跳过）
+} TempLogQuery;
+
+// 一段时间内的统计：按桶聚合时的中间结果，也是每小时汇总在RAM中的累加器
+#define TEMP_LOG_ROLLUP_SECONDS 3600
+typedef struct {
+    uint32_t time;       // 起点
+    int16_t min;
+    int16_t max;
+    uint32_t count;
+    int32_t sum;         // 温度之和（0.1°C）
+} TempLogSummary;
+
+// 一个时间桶的统计结果
+typedef struct {
+    uint32_t start;      // 桶起点（时间戳按桶宽对齐）
+    int16_t min;
+    int16_t max;
+    int16_t mean;        // 四舍五入
+    uint32_t count;
+} TempLogBucket;
+
+// 按桶聚合查询：桶宽为整小时时读每小时汇总（时间范围按小时取整），
+// 否则逐条读取记录；按桶顺序逐个读取，保存整个结构即可从同一位置继续
+typedef struct {
+    TempLogQuery query;
+    uint32_t width;
+    bool rollups;        // query读取的是每小时汇总流
+    bool raw;            // 统计滤波前的温度（只能逐条读取记录）
+    bool live_pending;   // 当前小时的累加器还未计入
+    bool has_carry;      // carry为已读出、属于下一个桶的统计
+    TempLogSummary carry;
+} TempLogAggregate;
 
 void temp_log_init(void);
-void temp_log_add_entry(float temperature);
-uint32_t temp_log_get_entries(uint64_t start_time, uint64_t end_time, 
-                             TempLogEntry *entries, uint32_t max_entries);
-void temp_log_clear(void);
+void temp_log_add_entry(uint8_t sensor, int16_t temperature, int16_t raw); // 滤波后与原始温度，同时更新每小时汇总
+// 复位后由记录任务在第一次记录前调用：从原始记录补齐最后一条汇总之后各小时的汇总，
+// 并恢复当前小时的累加器，原始记录被覆盖前对应的汇总都已写入
+void temp_log_recover_rollups(void);
+// 开始查询，二分查找定位起点
+void temp_log_query_begin(TempLogQuery *query, uint8_t sensor, uint64_t start_time, uint64_t end_time);
+// 从游标（log_store_iter_position()）处继续查询，到end_time为止
+void temp_log_query_resume(TempLogQuery *query, uint8_t sensor, uint32_t cursor, uint64_t end_time);
+// 最新的count条：从写入位置往前找到该传感器时间不晚于end_time的第count条（不足时为最旧的一条），
+// 再从那里按时间顺序查询，耗时与count成正比，与日志总量无关
+void temp_log_query_latest(TempLogQuery *query, uint8_t sensor, uint16_t count, uint64_t end_time);
+// 从SD卡上的长期归档（log_archive.h）查询，参数与temp_log_query_begin()/resume()相同，
+// 游标为归档中的位置；没有归档（LOG_ARCHIVE_SD为0、没有插卡或挂载失败）时ready返回false
+bool temp_log_archive_ready(void);
+void temp_log_archive_begin(TempLogQuery *query, uint8_t sensor, uint64_t start_time, uint64_t end_time);
+void temp_log_archive_resume(TempLogQuery *query, uint8_t sensor, uint32_t cursor, uint64_t end_time);
+// 只返回温度（raw为true时为滤波前的温度）在[low, high]内的条目，在begin/resume之后调用；
+// 按日志页的摘要整页跳过没有这样的记录的页，如“高于X℃的时段”只读取候选页
+void temp_log_query_filter(TempLogQuery *query, int16_t low, int16_t high, bool raw);
+// 读取下一条，没有更多条目时返回false
+bool temp_log_query_next(TempLogQuery *query, TempLogEntry *entry);
+// 下一条要读取的记录的游标
+static inline uint32_t temp_log_query_cursor(const TempLogQuery *query) {
+    return log_store_iter_position(&query->iter);
+}
+// 下一条写入闪存的记录的日志序号（已有记录的序号都小于它）
+uint32_t temp_log_next_sequence(void);
+// 报警事件查询：与温度日志共用查询结构和游标，不按传感器筛选
+void alarm_event_query_begin(TempLogQuery *query, uint64_t start_time, uint64_t end_time);
+void alarm_event_query_resume(TempLogQuery *query, uint32_t cursor, uint64_t end_time);
+bool alarm_event_query_next(TempLogQuery *query, AlarmEvent *event);
+uint32_t alarm_event_next_sequence(void);
+// 报警前后记录查询：按触发时间，游标用法同报警事件
+void alarm_burst_query_begin(TempLogQuery *query, uint64_t start_time, uint64_t end_time);
+void alarm_burst_query_resume(TempLogQuery *query, uint32_t cursor, uint64_t end_time);
+bool alarm_burst_query_next(TempLogQuery *query, AlarmBurst *burst);
+// 开始按桶聚合的查询，width为桶宽（秒）
+void temp_log_aggregate_begin(TempLogAggregate *aggregate, uint8_t sensor, uint64_t start_time,
+                              uint64_t end_time, uint32_t width, bool raw);
+// 读取下一个非空的桶，没有更多时返回false
+bool temp_log_aggregate_next(TempLogAggregate *aggregate, TempLogBucket *bucket);
+void temp_log_clear(void); // 由存储任务异步擦除
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,123 @@
+#ifndef FRAME_PARSER_H
+#define FRAME_PARSER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "protocol.h"
+#include "crc32.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 流式帧解析结果
+typedef enum {
+    FRAME_RESULT_NONE = 0,     // 帧未完成，继续输入
+    FRAME_RESULT_OK,           // 收到完整且校验通过的数据包
+    FRAME_RESULT_CRC_ERROR,    // 帧完整但CRC校验失败
+    FRAME_RESULT_FORMAT_ERROR, // 转义错误、版本/长度不符或缓冲区溢出
+    FRAME_RESULT_STREAM        // 收到校验通过的流帧（只在frame_parser_accept_streams()之后出现）
+} FrameResult;
+
+// 解析器状态
+typedef enum {
+    FRAME_STATE_HUNT = 0,      // 寻找起始符第1字节
+    FRAME_STATE_START,         // 已收到0xAA，等待0x55
+    FRAME_STATE_OPEN,          // 已收到起始符，帧体的第一个字节到达时才清除上一帧
+    FRAME_STATE_BODY,          // 帧体：逐字节去转义写入缓冲区
+    FRAME_STATE_COBS_OPEN,     // 已收到0x00分隔符，等待第一个编码字节
+    FRAME_STATE_COBS,          // COBS帧体：逐字节解码写入缓冲区
+    FRAME_STATE_SKIP,          // 地址不符的转义帧：只寻找结束符，不去转义、不计算CRC
+    FRAME_STATE_COBS_SKIP      // 地址不符的COBS帧：只寻找分隔符
+} FrameState;
+
+// 跳过所有帧（本机地址尚未加载时），不是有效的从机地址
+#define FRAME_ADDRESS_BLOCKED 0xFF
+
+// 帧体中0xAA/0x55与其后一字节组合的含义
+// 流式解析器与缓冲区扫描(find_packet_boundaries)共用这一条判定规则
+typedef enum {
+    FRAME_PAIR_ESCAPED = 0,    // 0xAA 00 / 0x55 00：转义的数据字节
+    FRAME_PAIR_END,            // 0x55 0xAA：结束符
+    FRAME_PAIR_START,          // 0xAA 0x55：起始符（帧体中出现说明前一帧不完整）
+    FRAME_PAIR_INVALID         // 其他：帧损坏
+} FramePair;
+
+static inline FramePair frame_classify_pair(uint8_t mark, uint8_t next) {
+    if (next == ESCAPE_BYTE) {
+        return FRAME_PAIR_ESCAPED;
+    }
+    if (mark == END_MARK_1 && next == END_MARK_2) {
+        return FRAME_PAIR_END;
+    }
+    if (mark == START_MARK_1 && next == START_MARK_2) {
+        return FRAME_PAIR_START;
+    }
+    return FRAME_PAIR_INVALID;
+}
+
+// 推送式帧解析器：数据从环形缓冲区逐字节输入，同时完成去转义、长度检查
+// 和CRC累加，结束符到达时立即给出结果。缓冲区中保存去转义后的 包头+数据+CRC，
+// 处理函数直接引用其中的数据，无需再次扫描或拷贝。
+// 两种组帧方式同时识别：0xAA 0x55开头为转义帧（版本0x02），
+// 0x00开头为COBS帧（版本0x03），帧内版本号必须与组帧方式一致。
+// 设置了地址时，包头的前两个字节（版本、地址）到达后即判断是否发给本机：
+// 不带地址或地址不符的帧不再解码和校验，只寻找帧尾，也不作为错误。
+typedef struct {
+    uint8_t *buffer;           // 去转义后的帧内容
+    uint16_t capacity;         // 缓冲区容量
+    uint16_t pos;              // 已写入字节数
+    uint16_t expected;         // 包头解析后得到的完整长度，0表示包头未收齐
+    uint8_t state;             // FrameState
+    uint8_t pending;           // 帧体中待定的0xAA/0x55（0表示无）
+    uint8_t cobs_code;         // 当前COBS块的编码字节（0表示尚未开始）
+    uint8_t cobs_left;         // 当前COBS块剩余的数据字节数
+    uint8_t address;           // 只接受发给该地址的带地址帧，PROTOCOL_ADDRESS_NONE为不过滤
+    bool accept_streams;       // 接受流帧（主机侧），从机收到流帧视为格式错误
+    bool stream;               // 当前帧是流帧
+    Crc32Context crc;          // 包头+数据的CRC，随字节到达增量计算
+    uint32_t unstuffed;        // 累计去掉的转义字节和COBS编码开销（不含起始、结束符）
+    uint32_t resyncs;          // 累计放弃未完成的帧、重新寻找起始符的次数
+    uint32_t skipped;          // 累计因地址不符跳过的帧
+} FrameParser;
+
+// 初始化解析器（同时清零累计计数，不过滤地址），buffer至少应容纳 包头+最大数据长度+CRC
+void frame_parser_init(FrameParser *parser, uint8_t *buffer, uint16_t capacity);
+
+// 设置本机地址：PROTOCOL_ADDRESS_NONE不过滤，FRAME_ADDRESS_BLOCKED跳过所有帧，
+// 其他值只接受地址相同的带地址帧；从下一帧开始生效
+void frame_parser_set_address(FrameParser *parser, uint8_t address);
+
+// 接受版本0x04的流帧（只可能以COBS组帧到达），结果为FRAME_RESULT_STREAM；init后为不接受
+void frame_parser_accept_streams(FrameParser *parser, bool accept);
+
+// 丢弃当前帧，重新寻找起始符
+void frame_parser_reset(FrameParser *parser);
+
+// 换用同样大小的buffer接收下一帧（FRAME_RESULT_OK后调用），原缓冲区中的帧交给调用者处理，
+// 包头和数据不必拷贝
+void frame_parser_set_buffer(FrameParser *parser, uint8_t *buffer);
+
+// 输入一个接收字节
+FrameResult frame_parser_feed(FrameParser *parser, uint8_t byte);
+
+// 包头是否已收齐（出错时可据此决定是否回复错误帧）
+// 出错后解析器立即从出错字节重新寻找起始符，但在下一帧的数据到达前，
+// 包头和缓冲区内容仍保留出错的那一帧
+bool frame_parser_has_header(const FrameParser *parser);
+
+// 当前帧的包头（frame_parser_has_header()为true时有效）
+const PacketHeader *frame_parser_header(const FrameParser *parser);
+
+// 当前帧的数据部分（FRAME_RESULT_OK后有效，长度为header->data_length）
+const uint8_t *frame_parser_payload(const FrameParser *parser);
+
+// 流帧的编号、序号和载荷（FRAME_RESULT_STREAM后有效）
+const uint8_t *frame_parser_stream(const FrameParser *parser, uint8_t *stream_id, uint8_t *sequence,
+                                   uint16_t *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FRAME_PARSER_H
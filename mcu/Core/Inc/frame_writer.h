@@ -0,0 +1,59 @@
+#ifndef FRAME_WRITER_H
+#define FRAME_WRITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "protocol.h"
+#include "crc32.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 单遍帧写入器：起始符之后的每个字节在写入时同时完成转义和CRC累加，
+// 直接输出到目标缓冲区（如DMA发送槽），输出长度即实际转义后的长度。
+// 包头版本为PROTOCOL_VERSION_COBS（或其带地址的版本）时改用COBS编码，编码字节在块结束时回填；
+// 包头的地址字段只在带地址的版本中写出。
+typedef struct {
+    uint8_t *buffer;       // 输出缓冲区
+    uint16_t capacity;     // 缓冲区容量
+    uint16_t pos;          // 已写入字节数
+    bool overflow;         // 空间不足，帧无效
+    bool cobs;             // 使用COBS组帧
+    uint16_t code_pos;     // 当前COBS块编码字节的位置
+    uint8_t code;          // 当前COBS块的编码值（数据字节数+1）
+    uint16_t stuffed;      // 本帧加入的转义字节和COBS编码开销
+    Crc32Context crc;      // 包头+数据的CRC
+} FrameWriter;
+
+// 写入起始符（或COBS分隔符）和包头
+void frame_writer_begin(FrameWriter *writer, uint8_t *buffer, uint16_t capacity,
+                        const PacketHeader *header);
+
+// 写入数据部分（可多次调用，总长度应等于包头的data_length）
+void frame_writer_write(FrameWriter *writer, const uint8_t *data, uint16_t length);
+
+// 写入CRC和结束符（或COBS分隔符），返回帧总长度，空间不足返回-1
+int frame_writer_finish(FrameWriter *writer);
+
+// 组成一个流帧（COBS组帧，见PROTOCOL_VERSION_STREAM）：CRC16按小端写在载荷之后，
+// 载荷至多STREAM_FRAME_MAX_PAYLOAD字节；返回帧总长度，空间不足返回-1
+int frame_writer_stream(uint8_t *buffer, uint16_t capacity, uint8_t stream_id, uint8_t sequence,
+                        const uint8_t *payload, uint16_t length);
+
+// 所有写入器累计加入的转义字节和COBS编码开销（不含起始、结束符），只计成功完成的帧
+uint32_t frame_writer_stuffed_total(void);
+void frame_writer_reset_stats(void);
+
+// 数据转义后的精确长度
+uint16_t frame_escaped_length(const uint8_t *data, uint16_t length);
+
+// 指定长度数据组成的帧在COBS组帧下的最大长度（含分隔符、带地址的包头和CRC）
+#define FRAME_COBS_MAX_LENGTH(data_len) \
+    (COBS_MAX_ENCODED_LENGTH(sizeof(PacketHeader) + (data_len) + sizeof(uint32_t)) + 2)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FRAME_WRITER_H
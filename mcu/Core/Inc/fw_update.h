@@ -0,0 +1,110 @@
+#ifndef FW_UPDATE_H
+#define FW_UPDATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "log_store.h"
+#include "boot_slots.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 经通信协议升级固件（fwbg/fwch/fwvf/fwcm）：新固件按块写入暂存区，校验整个映像的CRC后
+// 由RAM中的复制程序写入程序区并复位，不需要ST-Link。
+// - 暂存区为片内闪存的日志区（设置存储页以外），因此只在日志流放在外置闪存时可用（LOG_STORE_SPI_NOR）
+// - 每块带CRC和偏移，只接受从下一个偏移开始的块（已收到的块重发时直接确认），
+//   链路中断后重新fwbg同一映像（长度和CRC相同）即从已收到的位置继续；复位后从头开始
+// - 收到的块先放入RAM中的两页缓冲，写满一页后由存储任务在取得1-Wire总线锁后擦写闪存，
+//   命令执行任务不等待闪存，主机可以不等应答连续发送（缓冲满时返回STATUS_BUSY，从应答的偏移重发）
+// - 复制期间关中断，只喂狗，约10秒；期间掉电程序区不完整，需要用ST-Link恢复
+#ifndef FW_UPDATE
+#define FW_UPDATE LOG_STORE_SPI_NOR // 1：启用固件升级
+#endif
+
+#define FW_UPDATE_APP_BASE   0x08000000U // 程序区，须与链接脚本中的FLASH区域一致
+#define FW_UPDATE_APP_SIZE   (256U * 1024U)
+#define FW_UPDATE_PAGE_SIZE  2048U       // 暂存区和程序区的擦除单位
+#define FW_UPDATE_CHUNK_MAX  448U        // 一块的最大字节数（放得进一个请求帧）
+#define FW_UPDATE_INSTALL_DELAY_MS 200U  // fwcm应答发出后再开始复制
+
+// 差分升级的补丁：依次排列的操作，多字节数均为小端。由存储任务逐个执行，从当前固件和补丁数据
+// 依次生成新映像，RAM只用一页的输出缓冲和一页的补丁缓冲
+// - FW_PATCH_COPY：偏移(4B) 长度(4B)，复制当前固件中的一段
+// - FW_PATCH_COPY_REBASE：同上，并把其中指向当前固件所在区域的字改为指向新映像的区域
+//   （A/B程序槽的映像按各自的槽链接）；偏移、长度和新映像中的位置须为4的倍数
+// - FW_PATCH_DATA：长度(2B) 数据，新映像中的一段
+#define FW_PATCH_COPY        0x01U
+#define FW_PATCH_COPY_REBASE 0x02U
+#define FW_PATCH_DATA        0x03U
+
+// 暂存区：按页擦除、按半字编程，内容可直接读取（片内闪存的映射地址）；link_base为映像运行的地址
+// （校验向量表用）。install把暂存区的前image_size字节复制到程序区（A/B程序槽时改为切换到暂存区所在的槽）
+// 后复位，不返回
+typedef struct {
+    bool (*erase)(void *context, uint32_t offset);
+    bool (*program)(void *context, uint32_t offset, const void *data, uint32_t size);
+    void (*install)(void *context, uint32_t image_size);
+    void *context;
+    const uint8_t *base;
+    uint32_t size;       // 暂存区字节数，页的整数倍
+    uint32_t link_base;
+    const uint8_t *old_base; // 当前固件所在的区域（差分升级的旧映像），不支持差分升级时为NULL
+    uint32_t old_size;
+    uint32_t old_link;
+} FwUpdateDevice;
+
+// 命令的结果（由command_handler.c映射为协议状态码）
+typedef enum {
+    FW_UPDATE_OK = 0,
+    FW_UPDATE_INVALID,   // 参数错误、偏移不连续、块CRC错误或映像校验失败
+    FW_UPDATE_BUSY,      // 缓冲的页还未写入闪存
+    FW_UPDATE_NO_IMAGE,  // 没有进行中的升级（未fwbg或未通过fwvf）
+    FW_UPDATE_FLASH_ERROR,
+} FwUpdateResult;
+
+// 设置暂存区（存储任务启动时调用），device为NULL时不可升级
+void fw_update_init(const FwUpdateDevice *device);
+bool fw_update_ready(void);
+
+// 下一块应有的偏移，没有进行中的升级时为0
+uint32_t fw_update_received(void);
+
+// 开始升级长度为image_size、CRC32（crc32.h）为image_crc的映像；与进行中的映像相同时继续，
+// *offset为下一块应有的偏移
+FwUpdateResult fw_update_begin(uint32_t image_size, uint32_t image_crc, uint32_t *offset);
+
+// 差分升级：补丁长度为patch_size，生成长度为image_size、CRC为image_crc的映像；当前固件的前base_size字节的
+// CRC须为base_crc（生成补丁时的旧映像）。之后的fw_update_chunk()写入的是补丁，偏移为补丁中的偏移
+FwUpdateResult fw_update_begin_delta(uint32_t image_size, uint32_t image_crc, uint32_t patch_size,
+                                     uint32_t base_size, uint32_t base_crc, uint32_t *offset);
+
+// 写入从offset开始的一块，chunk_crc为该块的CRC32；*next为下一块应有的偏移（失败时也返回）
+FwUpdateResult fw_update_chunk(uint32_t offset, const uint8_t *data, uint16_t length, uint32_t chunk_crc,
+                               uint32_t *next);
+
+// 全部写入闪存后校验暂存区中映像的CRC和向量表，*crc为计算得到的CRC
+FwUpdateResult fw_update_verify(uint32_t *crc);
+
+// 校验通过后安装：由存储任务在FW_UPDATE_INSTALL_DELAY_MS后复制并复位
+FwUpdateResult fw_update_commit(void);
+
+// 把写满的页写入暂存区，到期后安装；只由存储任务在取得1-Wire总线锁后调用。
+// 返回距下一次需要调用的毫秒数，没有待写的页时返回UINT32_MAX
+uint32_t fw_update_service(uint32_t now_ms);
+
+// 片内闪存的暂存区和复制程序（fw_install.c，只在固件中编译）
+const FwUpdateDevice *fw_install_device(void);
+
+// A/B程序槽（FW_SLOTS，boot_slots.h）时暂存区为另一个槽，安装只追加试运行记录后复位。
+// fw_slots_service()由存储任务在取得1-Wire总线锁后调用：试运行的新固件运行BOOT_CONFIRM_MS后确认，
+// 回退后记下当前槽；返回距下一次需要调用的毫秒数。确认前不接受新的升级（另一个槽是回退用的映像）
+uint32_t fw_slots_service(uint32_t now_ms);
+bool fw_slots_confirmed(void);
+bool fw_slots_rolled_back(void); // 本次启动是试运行失败后的回退
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FW_UPDATE_H
@@ -0,0 +1,103 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "communication.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 网关角色（COMM_GATEWAY=1）：有线串口（UART4 + RS-485收发器，uart_transport.h）不再是协议链路，
+// 本机作为下游总线的主机，按地址表轮询各下游设备（用sadr设置了地址的从机）并缓存最新读数；
+// App只连接网关，一次ggwy取得所有下游设备的读数，日志等其他命令用fwrd转发给指定设备。
+// 总线是半双工的，同一时刻只有一个请求在等待应答，轮询按流水线方式进行：
+// - 发出一个请求后立即在另一块发送缓冲区中构建下一个请求
+// - 收到应答（或超时）后先发出已构建好的下一个请求，再解码刚收到的应答，
+//   解码与下一帧的总线传输、下游处理时间重叠，各轮询之间没有空闲间隔
+// - fwrd转发的请求插在两次轮询之间，优先于本轮剩余的轮询
+// 请求用带地址的COBS帧（PROTOCOL_VERSION_COBS_ADDR），只接受地址与包编号都对应的应答。
+// 总线主机在接收任务中运行（communication_task()），不单独占用任务和栈；
+// 缓存和设置由执行任务在临界区中读写
+
+// 下游设备数上限：ggwy一帧放得下全部设备的读数
+#define GATEWAY_MAX_DEVICES          12
+#define GATEWAY_DEFAULT_INTERVAL_MS  5000   // 每轮轮询的开始间隔
+#define GATEWAY_MIN_INTERVAL_MS      1000
+#define GATEWAY_RESPONSE_TIMEOUT_MS  50     // 轮询（temp）的应答超时，含请求的发送时间
+#define GATEWAY_FORWARD_TIMEOUT_MS   500    // 转发请求的应答超时（glog等需要读闪存）
+#define GATEWAY_FORWARD_HOLD_MS      1000   // 转发的应答未被取走时，超过该时间后丢弃并恢复轮询
+#define GATEWAY_FORWARD_MAX          128    // 转发请求的最大长度（下游请求的数据部分）
+#define GATEWAY_RX_RING_SIZE         256    // 总线接收环形缓冲区，必须为2的幂
+
+// 转发的结果（gateway_forward_result()）
+#define GATEWAY_FORWARD_PENDING 1
+
+// 保存的设置（config_store.h的CONFIG_KEY_GATEWAY）
+typedef struct {
+    uint32_t interval_ms;
+    uint8_t count;
+    uint8_t addresses[GATEWAY_MAX_DEVICES];
+} GatewayConfig;
+
+// 一个下游设备的缓存
+typedef struct {
+    uint8_t address;
+    uint8_t status;              // 最近一次应答的ST
+    uint8_t consecutive_misses;  // 最近一次应答之后连续未应答的轮询次数
+    bool answered;               // 设置地址表以来应答过
+    bool has_reading;            // 取得过读数（之后ST不为OK时保留上一次的读数）
+    int16_t temperature;         // 最近一次读数（0.1°C）
+    uint32_t sample_age_ms;      // 应答时下游读数的时效
+    uint32_t reading_tick;       // 收到该读数的时刻
+    uint32_t responses;
+    uint32_t misses;
+} GatewayDevice;
+
+// 启动总线接收（communication_init()中调用），地址表在gateway_load_config()之前为空
+void gateway_init(const CommTransport *bus);
+
+// 以下由传输层的回调（communication.c）在串口/DMA中断中转发，只做常数时间的工作
+void gateway_rx_event(uint16_t dma_pos);
+void gateway_tx_complete(void);
+void gateway_error(bool rx_stopped);
+
+// 接收任务中调用：解析收到的字节、处理超时并发出下一个请求
+void gateway_service(void);
+
+// 距下一次需要调用gateway_service()的毫秒数，0为立即，没有下游设备时为UINT32_MAX
+uint32_t gateway_next_due_ms(void);
+
+// 没有进行中的总线事务（请求已发出但尚未应答或超时），可以进入STOP模式
+bool gateway_idle(void);
+
+// 设置地址表（各地址1~247，不重复）和轮询间隔，清空缓存并立即开始新一轮轮询；
+// 参数无效时返回false，原设置不变
+bool gateway_configure(const GatewayConfig *config);
+void gateway_get_config(GatewayConfig *config);
+
+// 载入保存的设置（存储任务在设置扫描完成后调用），没有保存时地址表为空
+void gateway_load_config(void);
+// 保存设置时读取当前设置（config_store.c）
+void gateway_get_config_item(uint16_t index, void *item);
+
+// 取第index个下游设备（按地址表顺序）的缓存，超出设备数时返回false
+bool gateway_get_device(uint8_t index, GatewayDevice *device);
+
+// 把request（下游请求的数据部分，IN[+DA]）转发给address，上一个转发尚未完成或参数无效时返回false
+bool gateway_forward(uint8_t address, const uint8_t *request, uint16_t length);
+
+// 转发的结果：0为已应答，*payload指向应答的数据部分（在gateway_forward_release()之前有效），
+// *type为应答的包类型（PKT_TYPE_SLAVE_RESPONSE、PKT_TYPE_SLAVE_COMPACT或PKT_TYPE_SLAVE_ERROR）；
+// GATEWAY_FORWARD_PENDING为尚未应答，-1为超时或没有进行中的转发
+int gateway_forward_result(const uint8_t **payload, uint16_t *length, uint8_t *type);
+
+// 结束转发（取走结果或放弃等待），之后恢复轮询
+void gateway_forward_release(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GATEWAY_H
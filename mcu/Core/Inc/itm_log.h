@@ -0,0 +1,46 @@
+#ifndef ITM_LOG_H
+#define ITM_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// SWO/ITM诊断输出：调试器打开ITM和对应的激励端口后，数据经SWO引脚（PB3）按调试器设定的
+// 速率输出，不占用与主机通信的USART1。printf()经__io_putchar()输出到文本端口。
+// 没有调试器或端口未打开时写入立即返回；端口FIFO满时丢弃整条消息并计入itm_dropped()，
+// 开始写入后逐字等待FIFO（按SWO速率排空），一条消息不会只输出一半
+#define ITM_PORT_TEXT   0  // 文本：printf()、itm_puts()和周期统计
+#define ITM_PORT_TRACE  1  // 二进制：跟踪记录（TraceRecord，每条8字节，见trace.h）
+
+// 周期输出统计和新的跟踪记录的间隔，0为不输出；发布版本默认不启动，不额外从STOP唤醒
+#ifndef ITM_STATS_PERIOD_MS
+#ifdef DEBUG
+#define ITM_STATS_PERIOD_MS 1000U
+#else
+#define ITM_STATS_PERIOD_MS 0U
+#endif
+#endif
+
+// 启动周期输出（创建任务之后、启动调度器之前调用），调试版本同时把PB3设为SWO输出
+// （外置SPI NOR闪存时PB3为SPI3的SCK，不输出SWO，见spi_nor.h）
+void itm_start(void);
+
+// 调试器是否打开了端口port
+bool itm_port_enabled(uint8_t port);
+
+// 写入len字节，返回len，端口未打开或FIFO满时返回0（任务中调用）
+uint16_t itm_write(uint8_t port, const void *data, uint16_t len);
+// 向文本端口写入字符串
+void itm_puts(const char *text);
+
+// 端口已打开但FIFO满而丢弃的消息数
+uint32_t itm_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ITM_LOG_H
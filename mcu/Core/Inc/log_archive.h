@@ -0,0 +1,79 @@
+#ifndef LOG_ARCHIVE_H
+#define LOG_ARCHIVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "log_store.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 温度记录的长期归档：片内闪存只保留约10小时的逐秒记录（log_store.h），
+// 归档把写入闪存的每条采样记录再追加到块设备（SD卡，sd_card.h）上，按块轮转、只追加写入，
+// 不经过文件系统。块0为超级块，之后每块512字节：块头（块序号、时间基准、温度最小最大值、CRC）
+// 之后是定长记录。块序号递增，块i存放在数据区的第(i % 数据块数)块，写满后覆盖最旧的块。
+// 1GB可存放约1.2亿条，每秒记录4个传感器约保留一年。
+// - 写入闪存的采样记录由存储任务在释放1-Wire总线锁后读出，放入RAM中的暂存块
+//  （log_store_archive_sync()、log_archive_stage()），闪存即归档的待写队列，
+//   SD卡写入即使等待数百毫秒也不推迟采样和闪存写入
+// - log_archive_service()把暂存块一次多块写入（SD卡为DMA多块写），未写满的块之后原位重写
+// - 复位时暂存块中未写入的记录仍在闪存中，挂载后从最后一条归档记录之后继续读取
+// 读取沿用日志流的游标（LogStoreIter，日志流LOG_STREAM_ARCHIVE），位置为块序号 × 每块记录数 + 块内编号
+#ifndef LOG_ARCHIVE_SD
+#define LOG_ARCHIVE_SD 0 // 1：启用SD卡归档（SDIO 1位总线，sd_card.h）
+#endif
+
+#define LOG_ARCHIVE_BLOCK_SIZE   512U
+#define LOG_ARCHIVE_STAGE_BLOCKS 4U      // RAM暂存块数，也是一次写入的最大块数
+#define LOG_ARCHIVE_FLUSH_MS     60000U  // 暂存的记录最迟多久写入块设备
+#define LOG_ARCHIVE_MIN_BLOCKS   8U      // 数据块少于该数时不挂载
+
+// 块设备：按512字节块读写，锁用于归档的写入方（存储任务）和读取方（命令执行任务）互斥，
+// 同时保护暂存块
+typedef struct {
+    bool (*read)(void *context, uint32_t block, uint32_t count, void *data);
+    bool (*write)(void *context, uint32_t block, uint32_t count, const void *data);
+    void (*lock)(void *context);
+    void (*unlock)(void *context);
+} LogArchiveOps;
+
+typedef struct {
+    const LogArchiveOps *ops;
+    void *context;
+    uint32_t block_count; // 含超级块
+} LogArchiveDevice;
+
+// 挂载device（存储任务启动时调用）：超级块无效时格式化（写入新的超级块，原有数据不再读取），
+// 从上次清除后的第一块起二分查找最新的块，与归档的记录数无关；块设备读写失败时返回false。
+// 格式化时以format_id（当前RTC时间）作为新的一代，与超级块损坏的卡上残留的数据块区分
+bool log_archive_mount(const LogArchiveDevice *device, uint32_t format_id);
+bool log_archive_ready(void);
+
+// 最后一条归档记录（含暂存的）的时间，没有记录时返回false
+bool log_archive_last_time(uint64_t *timestamp_ms);
+
+// 追加一条采样记录（只由存储任务调用），未挂载或暂存块已满时返回false（先写入再追加）
+bool log_archive_stage(uint64_t timestamp_ms, const LogSamplePayload *sample);
+
+// 到期或暂存块将满时写入块设备（只由存储任务调用），force时立即写入暂存的全部记录。
+// 返回距下一次需要写入的毫秒数，没有暂存的记录时返回UINT32_MAX
+uint32_t log_archive_service(uint32_t now_ms, bool force);
+
+// 清除全部归档（只由存储任务调用，新的超级块在下一次log_archive_service()中写入），
+// 之后的块序号继续递增
+void log_archive_clear(void);
+
+// 按时间顺序读取归档，接口与log_store_iter_*()相同（由它们按日志流转发）；
+// 正在读取的块被覆盖时从仍保留的最旧的块继续。按温度筛选时据块头整块跳过
+void log_archive_iter_begin(LogStoreIter *iter);
+bool log_archive_iter_next(LogStoreIter *iter, uint64_t *timestamp_ms, LogSamplePayload *sample);
+void log_archive_seek(LogStoreIter *iter, uint64_t timestamp_ms);
+uint32_t log_archive_iter_position(const LogStoreIter *iter);
+void log_archive_iter_resume(LogStoreIter *iter, uint32_t position);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOG_ARCHIVE_H
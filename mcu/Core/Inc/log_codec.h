@@ -0,0 +1,65 @@
+#ifndef LOG_CODEC_H
+#define LOG_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 温度日志压缩编码，用于批量下载日志
+// 格式：| 条目数 uint16 (LE) | 首条 | 后续条目... |
+// - 首条：时间戳 varint，温度 zigzag varint
+// - 后续：时间戳二阶差分 zigzag varint，温度一阶差分 zigzag varint
+// 温度为日志中的0.1°C整数，不再量化；采样间隔固定、温度缓变时每条约2字节
+// 定长打包格式：| 条目数 uint16 (LE) | 条目 × n |，每条8字节：时间戳 uint32（秒）、
+// 毫秒 uint16、温度 int16（0.1°C），均为小端；不需要逐条解码，可以按下标直接取
+#define LOG_CODEC_TEMP_SCALE TEMP_SCALE
+
+// 日志压缩格式
+#define LOG_FORMAT_TLV    0x00  // 每条一个IT{TS, T}
+#define LOG_FORMAT_DELTA  0x01  // 差分变长编码
+#define LOG_FORMAT_PACKED 0x02  // 定长打包
+#define LOG_PACKED_ENTRY_SIZE 8U
+
+// 逐条编码：不需要先把条目复制到数组，可以边读日志边写入响应
+typedef struct {
+    uint8_t *output;
+    size_t size;
+    size_t pos;
+    uint32_t count;
+    uint8_t format;     // LOG_FORMAT_DELTA或LOG_FORMAT_PACKED
+    uint64_t prev_ts;
+    int64_t prev_delta;
+    int32_t prev_temp;
+} LogCodecEncoder;
+
+// 开始编码，缓冲区连条目数都放不下时返回false
+bool log_codec_begin(LogCodecEncoder *encoder, uint8_t *output, size_t output_size);
+// 开始定长打包，之后同样用log_codec_put()和log_codec_finish()
+bool log_codec_begin_packed(LogCodecEncoder *encoder, uint8_t *output, size_t output_size);
+// 追加一条，放不下时返回false且不改变已编码内容
+bool log_codec_put(LogCodecEncoder *encoder, const TempLogEntry *entry);
+// 写入条目数，返回编码长度
+int log_codec_finish(LogCodecEncoder *encoder);
+
+// 编码日志条目，空间不足时只编码能放下的前若干条
+// 返回编码长度，*encoded为实际编码的条目数；缓冲区连条目数都放不下时返回-1
+int log_codec_encode(const TempLogEntry *entries, uint32_t count,
+                     uint8_t *output, size_t output_size, uint32_t *encoded);
+
+// 解码日志条目，返回条目数，数据损坏或超过max_entries返回-1
+int log_codec_decode(const uint8_t *input, size_t input_len,
+                     TempLogEntry *entries, uint32_t max_entries);
+// 解码定长打包的条目（含毫秒），长度与条目数不符或超过max_entries返回-1
+int log_codec_decode_packed(const uint8_t *input, size_t input_len,
+                            TempLogEntry *entries, uint32_t max_entries);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOG_CODEC_H
@@ -0,0 +1,60 @@
+#ifndef LOG_COMPRESS_H
+#define LOG_COMPRESS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "device_control.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 日志压缩：记录任务每个记录间隔的读数先经过这里（按传感器），只保存重建曲线所需的点，
+// 温度平稳时保留时长成倍增加，闪存擦写和日志下载量减少（单位均为0.1°C）。
+// - 死区：与上次保存的温度相差超过容差时才保存，按阶梯重建
+// - 旋转门：保存的相邻两点之间线性插值，中间各点的误差都不超过容差；
+//   每个点要等到后面的点越出“门”时才能确定是否保存，最新的保存点会滞后
+// 间隔心跳（heartbeat_ms）到期时无论变化与否都保存一点，掉电最多丢失一个心跳内的曲线。
+// 每小时汇总仍按每个记录间隔的读数统计，不受压缩影响
+#define LOG_COMPRESS_NONE          0x00  // 每个记录间隔都保存（默认）
+#define LOG_COMPRESS_DEADBAND      0x01
+#define LOG_COMPRESS_SWINGING_DOOR 0x02
+
+#define LOG_COMPRESS_MAX_TOLERANCE       100      // 10.0°C
+#define LOG_COMPRESS_DEFAULT_TOLERANCE   1        // 0.1°C，即传感器12位分辨率附近的抖动
+#define LOG_COMPRESS_DEFAULT_HEARTBEAT_MS 3600000 // 至少每小时保存一点
+#define LOG_COMPRESS_MIN_HEARTBEAT_MS    1000
+
+// 一次读数最多产生的保存点：配置修改或心跳到期时先保存旋转门暂存的点
+#define LOG_COMPRESS_MAX_POINTS 2
+
+typedef struct {
+    uint8_t mode;          // LOG_COMPRESS_*
+    int16_t tolerance;     // 容差（0.1°C），0~LOG_COMPRESS_MAX_TOLERANCE
+    uint32_t heartbeat_ms; // 0为不强制保存，否则不小于LOG_COMPRESS_MIN_HEARTBEAT_MS
+} LogCompressConfig;
+
+typedef struct {
+    uint64_t timestamp_ms;
+    int16_t temperature;   // 滤波后，压缩按它判断
+    int16_t raw;           // 随保存点一起保存
+} LogCompressPoint;
+
+bool log_compress_config_valid(const LogCompressConfig *config);
+
+// 修改sensor号传感器的配置（任意任务调用），记录任务在下一次读数时保存暂存的点并重新开始
+void log_compress_configure(uint8_t sensor, const LogCompressConfig *config);
+void log_compress_get_config(uint8_t sensor, LogCompressConfig *config);
+
+// 恢复默认配置（不压缩）并清空状态
+void log_compress_reset(void);
+
+// 送入sensor号传感器的一个读数（只在记录任务中调用），需要保存的点按时间顺序写入points，
+// 返回点数（0~LOG_COMPRESS_MAX_POINTS）；sensor超出TEMP_MAX_SENSORS时原样保存
+uint8_t log_compress_feed(uint8_t sensor, const LogCompressPoint *point, LogCompressPoint *points);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOG_COMPRESS_H
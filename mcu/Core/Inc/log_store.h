@@ -0,0 +1,194 @@
+#ifndef LOG_STORE_H
+#define LOG_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 温度日志的闪存存储：片内闪存后256KB分为若干日志流，各流按页轮转、只追加写入。
+// 每页以递增的页序号开头，写满后转到下一页，回绕时擦除流内最旧的一页，
+// 各页擦写次数相同。页头保存该页的起始时间（秒），记录只存相对它的偏移和定长载荷；
+// 采样记录按列存放（秒偏移、温度差值、毫秒各一列），温度存为相对页内该传感器基准的差值，
+// 每条6字节，一页336条，按时间查找只读时间列。写满的页另有摘要（最后一条的时间、温度的最小最大值、
+// 记录数），按温度筛选的查询据此整页跳过，不必逐条读取。F103单存储体擦写期间取指会暂停，因此：
+// - 追加只把记录放入RAM待写队列并唤醒存储任务（storage_task.h），不等待闪存
+// - 编程和擦除由存储任务在取得1-Wire总线锁后完成，只落在两次总线传输之间
+//  （擦写暂停期间TIM6时隙中断无法执行），下一页总是提前擦除，
+//   翻页时不需要等待擦除；擦除尽量推迟到串口链路空闲时，不打断正在收发的帧
+//
+// 日志流也可以放在外置SPI NOR闪存上（LOG_STORE_SPI_NOR，spi_nor.h），页格式相同，一页为4KB扇区：
+// 片内闪存只保留设置存储页，其余可用于程序和A/B镜像；8MB可存放约130万条采样记录。
+// 外置闪存擦写不暂停取指，存储任务不取总线锁、不推迟擦除；读取经SPI复制，不直接访问地址
+#ifndef LOG_STORE_SPI_NOR
+#define LOG_STORE_SPI_NOR 0 // 1：日志流存放在外置SPI NOR闪存
+#endif
+
+// 片内闪存的日志区（不使用外置闪存时存放日志流，末尾为设置存储页）
+#ifndef LOG_STORE_BASE
+#define LOG_STORE_BASE       0x08040000U // 须与链接脚本中的LOGSTORE区域一致
+#endif
+#define LOG_STORE_PAGE_SIZE  2048U       // 大容量产品的页大小
+#define LOG_STORE_PAGES      128U        // 含末尾的设置存储页（config_store.h）
+
+// 外置闪存上日志流的区域（片内时为LOG_STORE_BASE起除设置存储页以外的各页）
+#if LOG_STORE_SPI_NOR
+#define LOG_STORE_STREAM_BASE      0U      // 外置闪存内的地址
+#define LOG_STORE_STREAM_PAGE_SIZE 4096U   // 擦除扇区（SPI_NOR_SECTOR_SIZE）
+#ifndef LOG_STORE_STREAM_PAGES
+#define LOG_STORE_STREAM_PAGES     2048U   // W25Q64（8MB），挂载时检查芯片容量
+#endif
+#endif
+#define LOG_STORE_PENDING    16U         // 待写队列长度（记录数，各流共用）
+#define LOG_STORE_WARM_MAGIC 0x4C505144UL // 待写队列的热复位保留块（warm_state.h）
+#define LOG_STORE_ERASE_MARGIN LOG_STORE_PENDING // 活动页剩余不足该条数时不再推迟擦除
+#define LOG_STORE_MAX_PAYLOAD 11U
+#define LOG_STORE_MAX_SENSORS 4U         // 采样记录的传感器编号上限（TEMP_MAX_SENSORS）
+
+// 各日志流的页数，合计不超过LOG_STORE_STREAM_PAGES，按需要的保留时长分配：
+// 原始记录每页336条（每个传感器每个记录间隔一条），每小时汇总每页126条，
+// 报警事件每页202条，报警前后记录每页126块（外置闪存的4KB页分别为678、254、407、254条）。
+// 修改分配后原有记录可能部分无法读取，需要清除日志
+#if LOG_STORE_SPI_NOR
+#ifndef LOG_STORE_SAMPLE_PAGES
+#define LOG_STORE_SAMPLE_PAGES 1868U
+#endif
+#ifndef LOG_STORE_ROLLUP_PAGES
+#define LOG_STORE_ROLLUP_PAGES 100U
+#endif
+#ifndef LOG_STORE_EVENT_PAGES
+#define LOG_STORE_EVENT_PAGES  48U
+#endif
+#ifndef LOG_STORE_BURST_PAGES
+#define LOG_STORE_BURST_PAGES  32U
+#endif
+#else
+#ifndef LOG_STORE_SAMPLE_PAGES
+#define LOG_STORE_SAMPLE_PAGES 106U
+#endif
+#ifndef LOG_STORE_ROLLUP_PAGES
+#define LOG_STORE_ROLLUP_PAGES 12U
+#endif
+#ifndef LOG_STORE_EVENT_PAGES
+#define LOG_STORE_EVENT_PAGES  4U
+#endif
+#ifndef LOG_STORE_BURST_PAGES
+#define LOG_STORE_BURST_PAGES  4U
+#endif
+#endif
+
+// 日志流
+#define LOG_STREAM_SAMPLES   0  // 温度记录，LogSamplePayload
+#define LOG_STREAM_ROLLUPS   1  // 每小时汇总，LogRollupPayload
+#define LOG_STREAM_EVENTS    2  // 报警事件，LogEventPayload
+#define LOG_STREAM_BURSTS    3  // 报警前后的逐秒温度，LogBurstPayload
+#define LOG_STREAM_COUNT     4
+#define LOG_STREAM_ARCHIVE   4  // SD卡上的温度记录归档（log_archive.h），只读，LogSamplePayload
+
+// 滤波前后相差超过12.7°C时，保存的滤波前温度按差值截断
+typedef struct {
+    int16_t temperature; // 0.1°C，滤波后
+    int16_t raw;         // 0.1°C，滤波前
+    uint8_t sensor;
+} __attribute__((packed)) LogSamplePayload;
+
+// 一个传感器一小时内记录的汇总，时间戳为该小时的起点
+typedef struct {
+    int16_t min;
+    int16_t max;
+    uint16_t count;
+    int32_t sum;         // 温度之和（0.1°C），平均值为sum / count
+    uint8_t sensor;
+} __attribute__((packed)) LogRollupPayload;
+
+// 报警规则进入或离开报警状态
+typedef struct {
+    uint8_t channel;
+    uint8_t type;        // ALARM_EVENT_ENTER / ALARM_EVENT_LEAVE
+    uint8_t sensor;
+    int16_t temperature; // 0.1°C
+} __attribute__((packed)) LogEventPayload;
+
+// 报警前后记录（device_control.h中的AlarmBurst）的一块：一次记录分为若干块连续追加，
+// 各块的时间戳均为触发时间，块号从0起，缺块的记录读取时跳过
+#define LOG_BURST_CHUNK_SAMPLES 4U
+#define LOG_BURST_CHUNK_MASK    0x1FU // chunk的低5位为块号
+#define LOG_BURST_ENTER         0x40U // 由进入报警触发（否则为解除报警）
+#define LOG_BURST_LAST          0x80U // 最后一块
+typedef struct {
+    uint8_t channel;
+    uint8_t sensor;
+    uint8_t chunk;
+    int16_t temperatures[LOG_BURST_CHUNK_SAMPLES]; // 0.1°C，每秒一个
+} __attribute__((packed)) LogBurstPayload;
+
+// 按时间顺序读取记录的游标，可与存储任务的写入并发使用（读到的页被覆盖时跳过该页）
+typedef struct {
+    uint8_t stream;
+    uint32_t sequence;   // 当前页应有的页序号，页头不符时说明该页已被擦除或覆盖
+    uint16_t page;       // 当前页（流内编号）
+    uint16_t slot;       // 页内下一条记录
+    uint16_t pages_left; // 还未读完的页数
+    int16_t low;         // 温度筛选（log_store_iter_filter()），默认不筛选
+    int16_t high;
+    uint16_t skipped;    // 按筛选整页跳过的页数
+} LogStoreIter;
+
+// 找到各流的活动页和写入位置（存储任务启动时调用）：按页头的页序号二分查找活动页，
+// 页内二分查找第一条空白记录，只逐条读取活动页以重建其摘要，与日志的记录数无关
+void log_store_init(void);
+
+// 启动时调用（调度器启动前）：热复位且保留的待写队列校验通过时，队列中的记录在log_store_init()之后写入
+void log_store_warm_restore(void);
+
+// 向stream追加一条记录（放入待写队列），队列满或采样记录的传感器超出上限时丢弃并返回false；
+// 时间戳均为毫秒（rtc_get_timestamp_ms()），同一秒内的记录也按时间排序
+bool log_store_append(uint8_t stream, uint64_t timestamp_ms, const void *payload);
+
+// 把待写记录连续写入闪存并提前擦除下一页，只由存储任务在取得1-Wire总线锁后调用
+// （外置闪存时不取总线锁，idle总为true）。
+// idle为false时（串口链路正在收发）推迟擦除，直到活动页剩余不足LOG_STORE_ERASE_MARGIN条；
+// 返回是否有推迟的擦除（稍后再调用；外置闪存整片擦除清除日志期间也返回true，记录留在待写队列）
+bool log_store_service(bool idle);
+
+// 清除全部记录（由存储任务在下一次log_store_service()中擦除）
+void log_store_clear(void);
+
+// 从stream最旧的记录开始遍历，payload为该流的载荷结构
+void log_store_iter_begin(LogStoreIter *iter, uint8_t stream);
+bool log_store_iter_next(LogStoreIter *iter, uint64_t *timestamp_ms, void *payload);
+// 之后的log_store_iter_next()跳过摘要表明没有温度值（采样的滤波前后温度、汇总的最小最大值、
+// 事件的温度）落在[low, high]内的整页；不跳过的页仍逐条返回，由调用方判断各条记录。
+// 在begin/seek/resume之后调用（它们清除筛选）
+void log_store_iter_filter(LogStoreIter *iter, int16_t low, int16_t high);
+// 二分查找定位到第一条时间戳不早于timestamp_ms的记录，O(log n)；
+// 依赖记录按时间追加，RTC回拨后时间戳不再单调，回拨前的部分记录可能查不到
+void log_store_seek(LogStoreIter *iter, uint8_t stream, uint64_t timestamp_ms);
+
+// 从写入位置往前（从最新的记录起按时间倒序）遍历，读到的条数与日志总量无关；
+// log_store_iter_prev()之后log_store_iter_position()为刚读出的记录的位置，
+// 可用log_store_iter_resume()从该条起按时间顺序读取。不支持LOG_STREAM_ARCHIVE
+void log_store_iter_end(LogStoreIter *iter, uint8_t stream);
+bool log_store_iter_prev(LogStoreIter *iter, uint64_t *timestamp_ms, void *payload);
+
+// 记录的位置：页序号 × 每页记录数 + 页内编号，按写入顺序递增（换页时不连续），
+// 可用作续传的游标；清除日志后继续递增，但清除后复位会从头开始编号
+// 下一条要读取的记录的位置，log_store_iter_next()之后减1即为刚读出的记录的位置
+uint32_t log_store_iter_position(const LogStoreIter *iter);
+// 定位到位置不小于position的第一条记录，已被覆盖时从最旧的记录开始
+void log_store_iter_resume(LogStoreIter *iter, uint8_t stream, uint32_t position);
+
+// SD卡归档（LOG_ARCHIVE_SD）：挂载归档后调用一次log_store_archive_start()，
+// 从最后一条归档记录之后的采样记录开始；之后存储任务在释放1-Wire总线锁后调用
+// log_store_archive_sync()，把新写入闪存的采样记录追加到归档，返回距下一次需要调用的毫秒数
+// （UINT32_MAX为等到下一次唤醒）。同一毫秒内复位前未写入归档的记录可能丢失
+void log_store_archive_start(void);
+uint32_t log_store_archive_sync(uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOG_STORE_H
@@ -0,0 +1,39 @@
+#ifndef LOW_POWER_H
+#define LOW_POWER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 低功耗空闲：FreeRTOS的tickless空闲（FreeRTOSConfig.h中portSUPPRESS_TICKS_AND_SLEEP指向这里），
+// 所有任务都在等待时停掉内核节拍（SysTick）和HAL时基（TIM7），按下一个超时计算睡眠时长：
+// - 预计空闲不少于LOW_POWER_STOP_MIN_MS、串口和输出都空闲时进入STOP模式，
+//   HSE、PLL和所有定时器停止，只有LSE和RTC运行。RTC闹钟只能在整秒触发，
+//   设置在下一个超时之前的最后一个整秒，余下的不到1秒在睡眠模式中等待；
+//   串口RX线（PA10/PC11，EXTI10/11下降沿）或其他中断提前唤醒，唤醒后恢复PLL时钟，
+//   按RTC测得的时长补齐内核节拍和HAL_GetTick()
+// - 其余情况在睡眠模式（WFI）中等待，由FreeRTOS按预计空闲时间重装SysTick；
+//   可以降频时（clock_scale.h）先降频，节拍不停
+// 从STOP唤醒并恢复时钟约需2毫秒，期间收到的字节会丢失：主机在空闲一段时间
+// （COMM_STOP_HOLDOFF_MS）后应先发送一个帧分隔符（0x00）再发送命令，或超时后重发
+#define LOW_POWER_STOP_MIN_MS 20U
+
+// 配置唤醒用的EXTI线和RTC闹钟（RTC初始化之后、调度器启动前调用）
+void low_power_init(void);
+
+// tickless空闲入口，由空闲任务在调度器挂起时调用，expected_ticks为到下一个超时的节拍数
+void low_power_suppress_ticks(uint32_t expected_ticks);
+// 进入睡眠模式之前挂起HAL时基（configPRE_SLEEP_PROCESSING）
+void low_power_pre_sleep(void);
+
+// STOP期间RX线的唤醒中断（EXTI15_10_IRQHandler）
+void low_power_exti_irq_handler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOW_POWER_H
@@ -0,0 +1,40 @@
+#ifndef ONEWIRE_H
+#define ONEWIRE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 1-Wire时隙引擎：TIM6单脉冲模式按时隙各阶段定时，中断中驱动/采样总线，
+// 一次传输（复位 + 写 + 读）全部在中断中完成，调用方只等待结果，不关中断忙等。
+// TIM6抢占优先级高于configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY，
+// 不受FreeRTOS临界段和UART中断影响，采样点抖动只有中断进入时间；
+// 因此中断中不能调用RTOS接口，调用方以1ms节拍查询完成标志。
+#define ONEWIRE_TIM_IRQ_PRIORITY 4
+
+// 配置总线引脚（开漏输出）和TIM6
+void onewire_init(void);
+
+// 一次传输：reset为true时先发复位脉冲并检测存在脉冲，
+// 然后按LSB先行写tx的tx_bits位，再读rx_bits位到rx
+// 返回1:未检测到存在脉冲（只在reset时判断）
+// 返回0:成功
+uint8_t onewire_transfer(bool reset, const uint8_t *tx, uint16_t tx_bits,
+                         uint8_t *rx, uint16_t rx_bits);
+
+// 总线锁：闪存擦写期间取指暂停，TIM6中断无法按时执行，擦写闪存的任务先取得总线锁，
+// 保证擦写不落在一次传输之中（两次传输之间的间隔没有上限）。onewire_transfer()自行加锁
+void onewire_lock(void);
+void onewire_unlock(void);
+
+// TIM6中断处理（在TIM6_IRQHandler中调用）
+void onewire_timer_irq_handler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ONEWIRE_H
@@ -0,0 +1,25 @@
+#ifndef ONEWIRE_PIN_H
+#define ONEWIRE_PIN_H
+
+#include <stdbool.h>
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 1-Wire总线引脚：始终为开漏输出（MX_GPIO_Init()和onewire_pin_init()配置），
+// 输出1即释放总线，由上拉电阻拉高，释放后IDR就是总线电平，收发之间不切换引脚方向。
+// 直接写BRR/BSRR、读IDR，每次操作只有一次寄存器访问，可在时隙中断和关中断的时序中使用
+#define ONEWIRE_PIN_LOW()     (DS18B20_GPIO_Port->BRR = DS18B20_Pin)
+#define ONEWIRE_PIN_RELEASE() (DS18B20_GPIO_Port->BSRR = DS18B20_Pin)
+#define ONEWIRE_PIN_READ()    ((DS18B20_GPIO_Port->IDR & DS18B20_Pin) != 0)
+
+// 先释放总线再配置为开漏输出（高速），配置后不再调用HAL_GPIO_Init()
+void onewire_pin_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ONEWIRE_PIN_H
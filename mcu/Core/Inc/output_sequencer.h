@@ -0,0 +1,47 @@
+#ifndef OUTPUT_SEQUENCER_H
+#define OUTPUT_SEQUENCER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 输出序列：序列表的每一项是一步（OUTPUT_SEQUENCE_STEP_MS）的占空比，
+// TIM3每步产生一次DMA请求，由DMA把下一项写入TIM4的比较寄存器，播放期间不占用CPU：
+// TIM3更新 -> DMA1通道3 -> TIM4 CCR3（蜂鸣器），TIM3 CC1 -> DMA1通道6 -> TIM4 CCR4（LED）。
+// TIM4周期为OUTPUT_DUTY_MAX个计数，占空比0为关闭，OUTPUT_DUTY_MAX为常开。
+// 只循环播放或播放一次：播放一次时停在最后一项，序列表应以0结尾
+#define OUTPUT_SEQUENCE_STEP_MS 20U
+#define OUTPUT_DUTY_MAX         255U
+#define OUTPUT_DUTY_HALF        128U  // 50%，蜂鸣器音量最大
+
+// 输出（对应TIM4的通道）
+#define OUTPUT_BUZZER  0  // CH3，PB8
+#define OUTPUT_LED     1  // CH4，PB9
+#define OUTPUT_COUNT   2
+
+// 预置序列，编号0保留（不播放）
+#define OUTPUT_SEQUENCE_NONE    0
+#define OUTPUT_SEQUENCE_BEEP3   1  // 三短一停，1.3秒
+#define OUTPUT_SEQUENCE_DOUBLE  2  // 两短一停，1秒
+#define OUTPUT_SEQUENCE_BREATHE 3  // 渐亮渐暗，2秒
+#define OUTPUT_SEQUENCE_COUNT   4
+
+// 配置TIM3和两个DMA通道（调度器启动前调用，可重复调用）
+void output_sequencer_init(void);
+
+// 在output上播放steps（须在闪存或静态内存中，播放期间保持有效），替换正在播放的序列
+void output_sequencer_play(uint8_t output, const uint8_t *steps, uint16_t length, bool loop);
+// 播放预置序列，编号无效时返回false
+bool output_sequencer_play_preset(uint8_t output, uint8_t sequence, bool loop);
+// 停止播放，比较寄存器保持最后写入的值
+void output_sequencer_stop(uint8_t output);
+bool output_sequencer_playing(uint8_t output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OUTPUT_SEQUENCER_H
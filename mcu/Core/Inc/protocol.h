@@ -10,7 +10,29 @@ extern "C" {
 #endif
 
 // 协议版本
-#define PROTOCOL_VERSION 0x02
+#define PROTOCOL_VERSION      0x02  // 起始符/结束符 + 0x00填充转义
+#define PROTOCOL_VERSION_COBS 0x03  // 0x00分隔 + COBS编码
+
+// 版本号最高位为1：包头在版本之后带1字节从机地址（RS-485多点总线），组帧方式由其余位决定
+#define PROTOCOL_VERSION_ADDRESSED 0x80
+#define PROTOCOL_VERSION_ADDR      (PROTOCOL_VERSION | PROTOCOL_VERSION_ADDRESSED)      // 0x82
+#define PROTOCOL_VERSION_COBS_ADDR (PROTOCOL_VERSION_COBS | PROTOCOL_VERSION_ADDRESSED) // 0x83
+#define PROTOCOL_FRAMING(version)  ((uint8_t)((version) & ~PROTOCOL_VERSION_ADDRESSED))
+
+// 流帧（版本0x04）：只由从机以COBS组帧发出，用于subt的SF流推送，没有包头的其余字段和TLV
+// | 0x04 | 流编号 | 序号 | 载荷 | CRC16 |，帧长由分隔符确定，CRC16覆盖之前的全部字节
+#define PROTOCOL_VERSION_STREAM   0x04
+#define STREAM_FRAME_HEADER_SIZE  3
+#define STREAM_FRAME_CRC_SIZE     2
+#define STREAM_FRAME_MAX_PAYLOAD  64
+
+// 从机地址：有线链路接多点总线时只接受发给本机地址的带地址帧
+#define PROTOCOL_ADDRESS_NONE 0x00  // 未设置：不过滤，不带地址的帧照常接受
+#define PROTOCOL_ADDRESS_MIN  1
+#define PROTOCOL_ADDRESS_MAX  247
+
+// COBS编码后的最大长度（每254字节至多1字节开销），不含前后分隔符
+#define COBS_MAX_ENCODED_LENGTH(n) ((n) + (n) / 254 + 1)
 
 // 数据包类型
 #define PKT_TYPE_HOST_REQUEST  0x00
@@ -18,6 +40,7 @@ extern "C" {
 #define PKT_TYPE_HOST_ERROR    0x0F
 #define PKT_TYPE_SLAVE_REQUEST 0x10  
 #define PKT_TYPE_SLAVE_RESPONSE 0x11
+#define PKT_TYPE_SLAVE_COMPACT 0x12  // 紧凑响应：数据部分为ST(1字节) + DA的值，不回显IN
 #define PKT_TYPE_SLAVE_ERROR   0x1F
 
 // 起始符和结束符
@@ -29,6 +52,9 @@ extern "C" {
 // 转义填充字节
 #define ESCAPE_BYTE  0x00
 
+// COBS帧分隔符
+#define COBS_DELIMITER 0x00
+
 // 最大数据包大小
 #define MAX_PACKET_SIZE 512
 #define MAX_DATA_SIZE   (MAX_PACKET_SIZE - 16) // 减去头部和尾部
@@ -36,6 +62,7 @@ extern "C" {
 // 错误码定义
 #define ERROR_CODE_CORRUPT           0x01
 #define ERROR_CODE_UNEXPECTED_RESP   0x02
+#define ERROR_CODE_BUSY              0x03
 #define ERROR_CODE_UNKNOWN           0xFF
 
 // 状态码定义
@@ -44,6 +71,8 @@ extern "C" {
 #define STATUS_NOT_INITIALIZED   0x02
 #define STATUS_SENSOR_ERROR      0x03
 #define STATUS_STORAGE_ERROR     0x04
+#define STATUS_BUSY              0x05
+#define STATUS_TIMEOUT           0x06  // 下游设备未应答（网关转发）
 #define STATUS_INTERNAL_ERROR    0xFF
 
 // 指令定义
@@ -60,6 +89,78 @@ extern "C" {
 #define CMD_RESET_LED   "rled"
 #define CMD_SET_BUZZER  "sbzr"
 #define CMD_RESET_BUZZER "rbzr"
+#define CMD_SET_BAUD    "baud"
+#define CMD_SUBSCRIBE   "subt"
+#define CMD_FRAGMENT_ACK "fack"
+#define CMD_SET_RESOLUTION "sres"
+#define CMD_SET_FILTER  "sflt"
+#define CMD_GET_SENSORS "gsen"
+#define CMD_SET_LOG_INTERVAL "slog"
+#define CMD_GET_EVENTS  "gevt"
+#define CMD_SET_DATETIME "sdtm"
+#define CMD_GET_DATETIME "gdtm"
+#define CMD_CLOCK_SYNC  "csyn"
+#define CMD_GET_TASKS   "gtsk"
+#define CMD_GET_STATS   "stat"
+#define CMD_GET_COMM_STATS "gcom"
+#define CMD_GET_TRACE   "gtrc"
+#define CMD_BENCH       "bnch"
+#define CMD_SET_ADDRESS "sadr"
+#define CMD_GATEWAY_CONFIG "sgwy"
+#define CMD_GATEWAY_READ "ggwy"
+#define CMD_FORWARD     "fwrd"
+#define CMD_GET_BURSTS  "gbst"
+#define CMD_FW_BEGIN    "fwbg"
+#define CMD_FW_CHUNK    "fwch"
+#define CMD_FW_VERIFY   "fwvf"
+#define CMD_FW_COMMIT   "fwcm"
+#define CMD_SET_CALIBRATION "scal"
+#define CMD_GET_TEMP_STATS "tsta"
+#define CMD_GET_ALL_TEMPS "tall"
+
+// 指令编号：IN也可以是1字节编号，直接索引命令表，响应中的IN与请求形式相同
+// 编号从1开始（0保留），已分配的编号不再改变，新命令只追加在末尾
+#define OP_PING          0x01
+#define OP_GET_TEMP      0x02
+#define OP_GET_RTC_DATE  0x03
+#define OP_GET_RTC_TIME  0x04
+#define OP_SET_RTC_DATE  0x05
+#define OP_SET_RTC_TIME  0x06
+#define OP_GET_ALARMS    0x07
+#define OP_SET_ALARMS    0x08
+#define OP_GET_LOG       0x09
+#define OP_SET_LED       0x0A
+#define OP_RESET_LED     0x0B
+#define OP_SET_BUZZER    0x0C
+#define OP_RESET_BUZZER  0x0D
+#define OP_SET_BAUD      0x0E
+#define OP_SUBSCRIBE     0x0F
+#define OP_FRAGMENT_ACK  0x10
+#define OP_SET_RESOLUTION 0x11
+#define OP_SET_FILTER    0x12
+#define OP_GET_SENSORS   0x13
+#define OP_SET_LOG_INTERVAL 0x14
+#define OP_GET_EVENTS    0x15
+#define OP_SET_DATETIME  0x16
+#define OP_GET_DATETIME  0x17
+#define OP_CLOCK_SYNC    0x18
+#define OP_GET_TASKS     0x19
+#define OP_GET_STATS     0x1A
+#define OP_GET_COMM_STATS 0x1B
+#define OP_GET_TRACE     0x1C
+#define OP_BENCH         0x1D
+#define OP_SET_ADDRESS   0x1E
+#define OP_GATEWAY_CONFIG 0x1F
+#define OP_GATEWAY_READ  0x20
+#define OP_FORWARD       0x21
+#define OP_GET_BURSTS    0x22
+#define OP_FW_BEGIN      0x23
+#define OP_FW_CHUNK      0x24
+#define OP_FW_VERIFY     0x25
+#define OP_FW_COMMIT     0x26
+#define OP_SET_CALIBRATION 0x27
+#define OP_GET_TEMP_STATS 0x28
+#define OP_GET_ALL_TEMPS 0x29
 
 // TLV标签定义
 #define TAG_INSTRUCTION  "IN"
@@ -80,15 +181,189 @@ extern "C" {
 #define TAG_ALARM_ID     "ID"
 #define TAG_ALARM_LOW    "L"
 #define TAG_ALARM_HIGH   "H"
+#define TAG_ALARM_HYSTERESIS "HY"
+#define TAG_ALARM_DELAY  "DL"
+#define TAG_ALARM_LATENCY "AW"
+#define TAG_ALARM_RATE   "RT"
+#define TAG_ALARM_ACTIONS "AC"
+#define TAG_ALARM_ENABLED "EN"
+#define TAG_ALARM_WINDOW "WS"
+#define TAG_ALARM_HORIZON "PH"
+#define TAG_ALARM_NEXT   "NX"
 #define TAG_LOG_LIST     "LG"
 #define TAG_TIMESTAMP    "TS"
 #define TAG_TIME_START   "T1"
 #define TAG_TIME_END     "T2"
 #define TAG_MAX_COUNT    "MX"
+#define TAG_BAUD_RATE    "BR"
+#define TAG_INTERVAL     "IV"
+#define TAG_ALARM_MASK   "AM"
+#define TAG_ALARM_MASK_ALL "AX"
+#define TAG_LOG_FORMAT   "CP"
+#define TAG_LOG_COMPRESSED "LZ"
+#define TAG_LOG_PACKED   "LP"  // glog定长打包的日志条目（log_codec.h）
+#define TAG_FRAGMENTED   "FG"
+#define TAG_SEQUENCE     "SQ"
+#define TAG_MORE_FRAGMENTS "MF"
+#define TAG_WINDOW       "WN"
+#define TAG_BITMAP       "BM"
+#define TAG_TEMP_FORMAT  "TF"
+#define TAG_SCHEMA_VERSION "SV"
+#define TAG_FRESH        "FR"
+#define TAG_SAMPLE_AGE   "AG"
+#define TAG_RESOLUTION   "RS"
+#define TAG_SENSOR       "SN"
+#define TAG_SENSOR_COUNT "SC"
+#define TAG_FILTER_MODE  "FM"
+#define TAG_FILTER_PARAM "FN"
+#define TAG_RAW_TEMPERATURE "TR"
+#define TAG_LOG_RAW      "RW"
+#define TAG_BUCKET_WIDTH "BW"
+#define TAG_BUCKET_LIST  "BK"
+#define TAG_BUCKET_MIN   "LO"
+#define TAG_BUCKET_MAX   "HI"
+#define TAG_BUCKET_MEAN  "AV"
+#define TAG_BUCKET_COUNT "CN"
+#define TAG_LOG_CURSOR   "CU"
+#define TAG_LOG_SINCE    "SI"
+#define TAG_LOG_LAST     "LN"
+#define TAG_LOG_INTERVALS "IR"  // glog按区间返回：请求中为开关，响应中为区间列表
+#define TAG_ALARM_STATE  "AS"
+#define TAG_ARCHIVE      "AR"  // glog从SD卡归档读取
+#define TAG_PEAK         "PK"
+#define TAG_ONGOING      "OG"
+#define TAG_LOG_COMPRESSION "LC"  // slog的日志压缩方式（log_compress.h）
+#define TAG_TOLERANCE    "TO"
+#define TAG_HEARTBEAT    "HB"
+#define TAG_EVENT_LIST   "EV"
+#define TAG_EVENT_TYPE   "ET"
+#define TAG_SENSOR_LIST  "SL"
+#define TAG_PRESENT      "PR"
+#define TAG_FAULT_COUNT  "FC"
+#define TAG_CONSECUTIVE_FAULTS "CF"
+#define TAG_LAST_SEEN    "LS"
+#define TAG_PATTERN_ON   "ON"
+#define TAG_PATTERN_OFF  "OF"
+#define TAG_PATTERN_REPEAT "RP"
+#define TAG_PATTERN_SEQUENCE "PT"
+#define TAG_OUTPUT_DUTY  "DU"
+#define TAG_OUTPUT_FREQUENCY "FQ"
+#define TAG_EVENT_PUSH   "AE"
+#define TAG_MILLISECOND  "MS"
+#define TAG_SYNC_ORIGIN  "T0"  // csyn中T0/T1/T2为一次往返的时间，与glog的T1/T2无关
+#define TAG_SYNC_RECEIVE "T1"
+#define TAG_SYNC_TRANSMIT "T2"
+#define TAG_CLOCK_OFFSET "CO"
+#define TAG_CLOCK_CORRECTION "CA"
+#define TAG_TASK_LIST    "TK"
+#define TAG_TASK_NAME    "NM"
+#define TAG_TASK_PRIORITY "PI"
+#define TAG_STACK_FREE   "SW"
+#define TAG_TASK_LOAD    "LD"
+#define TAG_LOAD_WINDOW  "LW"
+#define TAG_HEAP_FREE    "HF"
+#define TAG_HEAP_MIN     "HM"
+#define TAG_POOL_LIST    "PL"
+#define TAG_BLOCK_SIZE   "BS"
+#define TAG_BLOCK_COUNT  "BN"
+#define TAG_BLOCK_USED   "BU"
+#define TAG_BLOCK_PEAK   "BP"
+#define TAG_BLOCK_FAILURES "BF"
+#define TAG_RESET_REASON "RR"
+#define TAG_STALLED_TASK "WT"
+#define TAG_STATS_LIST   "CS"
+#define TAG_STATS_COUNT  "NR"
+#define TAG_QUEUED_MAX   "QX"
+#define TAG_QUEUED_HIST  "QH"
+#define TAG_TRANSMIT_MAX "TX"
+#define TAG_TRANSMIT_HIST "TH"
+#define TAG_STATS_CLEAR  "CL"
+#define TAG_PACKETS_IN   "NI"
+#define TAG_PACKETS_OUT  "NO"
+#define TAG_BYTES_IN     "BI"
+#define TAG_BYTES_OUT    "BO"
+#define TAG_CRC_ERRORS   "CE"
+#define TAG_FORMAT_ERRORS "FE"
+#define TAG_UART_ERRORS  "UE"
+#define TAG_UNSTUFFED    "XR"
+#define TAG_STUFFED      "XA"
+#define TAG_RESYNCS      "RY"
+#define TAG_RING_PEAK    "RH"
+#define TAG_RING_OVERFLOWS "RO"
+#define TAG_TX_QUEUE_PEAK "QP"
+#define TAG_TX_DROPPED   "QD"
+#define TAG_RX_DROPPED   "RD"
+#define TAG_REPLAYED     "DR"
+#define TAG_TRACE_RECORDS "TE"
+#define TAG_TRACE_LOST   "TL"
+#define TAG_CYCLES_PER_US "MH"
+#define TAG_LATENCY      "LT"
+#define TAG_BENCH_PAYLOAD "PD"
+#define TAG_BENCH_SIZE   "SZ"
+#define TAG_BENCH_COUNT  "CT"
+#define TAG_ADDRESS      "AD"
+#define TAG_GATEWAY_LIST "GW"
+#define TAG_CAPABILITIES "CB"
+#define TAG_PROTOCOL_VERSIONS "PV"
+#define TAG_MAX_PACKET   "MP"
+#define TAG_OPCODE_MAX   "OP"
+#define TAG_LOG_FORMATS  "LF"
+#define TAG_PUSH_MODES   "PM"
+#define TAG_FEATURES     "FT"
+#define TAG_COMPACT      "CM"
+#define TAG_BURST_LIST   "BL"
+#define TAG_BURST_PRE    "PB"
+#define TAG_BURST_SAMPLES "BT"
+#define TAG_FW_SIZE      "FS"
+#define TAG_FW_OFFSET    "FO"
+#define TAG_FW_CRC       "CK"
+#define TAG_FW_DATA      "FD"
+#define TAG_FW_SLOT      "FA"
+#define TAG_FW_ROLLED_BACK "FB"
+#define TAG_FW_PATCH     "FP"
+#define TAG_FW_BASE_SIZE "OL"
+#define TAG_FW_BASE_CRC  "OC"
+#define TAG_CALIB_POINTS "KP"
+#define TAG_STATS_VARIANCE "VA"
+#define TAG_ABOVE_TIME   "TA"
+#define TAG_ABOVE_THRESHOLD "AT"
+#define TAG_TEMP_PACKED  "TP"
+#define TAG_SCHED_SAMPLES "JN"
+#define TAG_SCHED_MISSED "JM"
+#define TAG_SCHED_ERROR_MAX "JX"
+#define TAG_SCHED_ERROR_HIST "JH"
+#define TAG_SCHED_LEAD   "JL"
+#define TAG_MAX_AGE      "MA"
+#define TAG_LOG_LATEST   "LA"  // glog只返回最新的若干条
+#define TAG_RETRY_AFTER  "RA"  // BUSY应答：限流时至少等待的毫秒数（admission.h）
+#define TAG_STREAM_ID    "SF"  // subt：周期推送改用流帧，值为流编号
+#define TAG_HOST_TIME    "HT"  // ping：主机时间戳，原样返回
+#define TAG_DEVICE_RX    "RX"  // ping：从机收完请求的时刻（微秒）
+#define TAG_DEVICE_TX    "TT"  // ping：从机构建完响应的时刻（微秒）
+
+// ping能力列表的PM（推送方式）和FT（可选功能）位
+#define CAP_PUSH_PERIODIC      0x01  // subt的周期温度推送
+#define CAP_PUSH_ALARM_EVENTS  0x02  // subt的AE报警事件推送
+#define CAP_PUSH_LOG_FRAGMENTS 0x04  // glog的分片传输和窗口确认（fack）
+#define CAP_PUSH_STREAM        0x08  // subt的SF流帧推送（COBS组帧时）
+#define CAP_FEATURE_GATEWAY    0x01  // 网关角色：sgwy/ggwy/fwrd可用
+#define CAP_FEATURE_COMPACT    0x02  // 紧凑响应（ping的CM）
+#define CAP_FEATURE_FW_UPDATE  0x04  // 固件升级：fwbg/fwch/fwvf/fwcm可用
+
+// 温度在设备内部为int16_t，单位0.1°C（DS18B20的分辨率），报警比较和日志都不经过浮点运算
+#define TEMP_SCALE       10
+#define TEMP_INVALID     INT16_MIN  // 读取失败
+
+// 温度在线路上的表示，由ping的TF字段按会话协商，接收方可按字段长度区分
+#define TEMP_FORMAT_FLOAT32 0x00  // float32，°C（默认）
+#define TEMP_FORMAT_INT16   0x01  // int16，0.1°C
 
 // 数据包头结构（不包括起始符和结束符）
+// address只有带地址的版本在线路上传输，其余版本接收时为PROTOCOL_ADDRESS_NONE，发送时不写出，
+// 因此解析后的包头和数据在缓冲区中的位置与版本无关
 typedef struct {
     uint8_t version;      // 版本
+    uint8_t address;      // 从机地址（主机发出时为目标地址，从机发出时为本机地址）
     uint8_t type;         // 类别
     uint16_t packet_id;   // 数据包编号
     uint16_t response_id; // 响应编号
@@ -102,19 +377,64 @@ typedef struct {
     uint8_t *value;   // 值指针
 } TLVField;
 
-// 报警配置结构
+// 报警规则的动作（可组合）
+#define ALARM_ACTION_BUZZER 0x01
+#define ALARM_ACTION_LED    0x02
+#define ALARM_ACTIONS_ALL   (ALARM_ACTION_BUZZER | ALARM_ACTION_LED)
+#define ALARM_SENSOR_ANY    0xFF // 规则适用于任一传感器
+
+// 报警规则
 typedef struct {
-    uint8_t id;       // 报警通道ID（0=蜂鸣器，1=LED）
-    float low_temp;   // 下限温度
-    float high_temp;  // 上限温度
+    uint8_t id;        // 规则编号
+    int16_t low_temp;  // 下限温度（0.1°C）
+    int16_t high_temp; // 上限温度（0.1°C）
+    int16_t hysteresis; // 回差（0.1°C）：回到[low_temp + hysteresis, high_temp - hysteresis]内才解除
+    uint16_t delay_s;  // 持续超限delay_s秒后才进入报警，0为立即
+    uint8_t sensor;    // 传感器编号，ALARM_SENSOR_ANY为任一传感器
+    int16_t rate;      // 变化速率上限（0.1°C/分钟，按绝对值），0为不检查
+    uint16_t window_s; // 估计变化速率的平均窗口（秒），0为相邻两次读数
+    uint16_t horizon_s; // 按当前速率预测horizon_s秒后的温度也检查上下限，0为不预测
+    uint8_t actions;   // 报警期间的动作，ALARM_ACTION_*
+    uint8_t enabled;   // 0为停用
 } AlarmConfig;
 
-// 温度日志条目
+// 温度日志条目（16字节；闪存中按页压缩为10字节，见log_store.c）
 typedef struct {
-    uint64_t timestamp;  // 时间戳（秒）
-    float temperature;   // 温度值
+    uint32_t timestamp;  // 时间戳（秒），协议中仍按uint64发送
+    uint32_t sequence;   // 日志序号（记录在闪存中的位置），按写入顺序递增
+    int16_t temperature; // 温度（0.1°C，滤波后）
+    int16_t raw;         // 滤波前的原始温度（0.1°C）
+    uint16_t millisecond; // 时间戳的毫秒部分
+    uint8_t sensor;      // 传感器编号
 } TempLogEntry;
 
+// 报警事件（与温度日志一样保存在闪存中）
+#define ALARM_EVENT_LEAVE 0
+#define ALARM_EVENT_ENTER 1
+typedef struct {
+    uint32_t timestamp;  // 时间戳（秒）
+    uint32_t sequence;   // 日志序号（事件日志内递增）
+    uint16_t millisecond; // 时间戳的毫秒部分
+    uint8_t channel;     // 报警规则编号
+    uint8_t type;        // ALARM_EVENT_ENTER / ALARM_EVENT_LEAVE
+    uint8_t sensor;      // 超限的传感器（离开时为进入时超限的传感器）
+    int16_t temperature; // 该传感器的温度（0.1°C）
+} AlarmEvent;
+
+// 报警前后的逐秒温度（gbst）：触发时冻结触发传感器此前的读数，再收集之后的读数
+#define ALARM_BURST_PRE_SAMPLES  32  // 含触发时的一次
+#define ALARM_BURST_POST_SAMPLES 32
+#define ALARM_BURST_SAMPLES (ALARM_BURST_PRE_SAMPLES + ALARM_BURST_POST_SAMPLES)
+typedef struct {
+    uint32_t timestamp;  // 触发时间（秒），与对应的报警事件相同
+    uint16_t millisecond;
+    uint8_t channel;     // 报警规则编号
+    uint8_t type;        // ALARM_EVENT_ENTER / ALARM_EVENT_LEAVE
+    uint8_t sensor;
+    int16_t temperatures[ALARM_BURST_SAMPLES]; // 每秒一个，第ALARM_BURST_PRE_SAMPLES - 1个为触发时的读数，
+                                                // 读取失败（或上电后不足）为TEMP_INVALID
+} AlarmBurst;
+
 // RTC日期结构
 typedef struct {
     uint8_t year;     // 年（0-99）
@@ -132,9 +452,21 @@ typedef struct {
 
 // 函数声明
 uint32_t calculate_crc32(const uint8_t *data, size_t length);
+// CRC-16/CCITT-FALSE（多项式0x1021，初值0xFFFF），可分段累加：首段传入CRC16_INIT
+#define CRC16_INIT 0xFFFFU
+uint16_t calculate_crc16(uint16_t crc, const uint8_t *data, size_t length);
+size_t find_escape_byte(const uint8_t *data, size_t length);
 int escape_data(const uint8_t *input, size_t input_len, uint8_t *output, size_t output_size);
 int unescape_data(const uint8_t *input, size_t input_len, uint8_t *output, size_t output_size);
 bool find_packet_boundaries(const uint8_t *buffer, size_t buffer_len, size_t *start_pos, size_t *end_pos);
+// 发送帧使用的协议版本（决定组帧方式），收到有效请求后随主机所用版本切换
+void protocol_set_tx_version(uint8_t version);
+uint8_t protocol_get_tx_version(void);
+bool protocol_is_version_supported(uint8_t version);
+// 从机发出的带地址帧包头中的本机地址（PROTOCOL_ADDRESS_NONE或MIN~MAX）
+void protocol_set_address(uint8_t address);
+uint8_t protocol_get_address(void);
+
 int build_packet(uint8_t type, uint16_t packet_id, uint16_t response_id, 
                 const uint8_t *data, uint16_t data_len, uint8_t *output, size_t output_size);
 int parse_packet(const uint8_t *buffer, size_t buffer_len, PacketHeader *header, uint8_t *data, size_t data_size);
@@ -142,17 +474,72 @@ int parse_packet(const uint8_t *buffer, size_t buffer_len, PacketHeader *header,
 // TLV操作函数
 int write_tlv_uint8(uint8_t *buffer, size_t buffer_size, const char *tag, uint8_t value);
 int write_tlv_uint16(uint8_t *buffer, size_t buffer_size, const char *tag, uint16_t value);
+int write_tlv_uint32(uint8_t *buffer, size_t buffer_size, const char *tag, uint32_t value);
 int write_tlv_uint64(uint8_t *buffer, size_t buffer_size, const char *tag, uint64_t value);
 int write_tlv_float32(uint8_t *buffer, size_t buffer_size, const char *tag, float value);
 int write_tlv_string(uint8_t *buffer, size_t buffer_size, const char *tag, const char *str);
 int write_tlv_raw(uint8_t *buffer, size_t buffer_size, const char *tag, const uint8_t *data, uint16_t length);
+// 嵌套字段：begin写入标签并预留长度，子字段直接写在其后，end回填长度
+// begin返回字段头长度4，空间不足返回-1；end返回整个字段长度，超长返回-1
+int write_tlv_begin(uint8_t *buffer, size_t buffer_size, const char *tag);
+int write_tlv_end(uint8_t *field, size_t value_length);
 
 int read_tlv_uint8(const uint8_t *buffer, size_t buffer_size, const char *tag, uint8_t *value);
 int read_tlv_uint16(const uint8_t *buffer, size_t buffer_size, const char *tag, uint16_t *value);
+int read_tlv_uint32(const uint8_t *buffer, size_t buffer_size, const char *tag, uint32_t *value);
 int read_tlv_uint64(const uint8_t *buffer, size_t buffer_size, const char *tag, uint64_t *value);
 int read_tlv_float32(const uint8_t *buffer, size_t buffer_size, const char *tag, float *value);
 int read_tlv_string(const uint8_t *buffer, size_t buffer_size, const char *tag, char *str, size_t str_size);
 int read_tlv_raw(const uint8_t *buffer, size_t buffer_size, const char *tag, uint8_t *data, uint16_t *length);
+// 温度：按协商的表示写入int16（0.1°C）或float32（°C）
+int write_tlv_temperature(uint8_t *buffer, size_t buffer_size, const char *tag, int16_t value, uint8_t format);
+// 不拷贝：*value指向buffer中的值，返回值长度，未找到返回-1
+int read_tlv_view(const uint8_t *buffer, size_t buffer_size, const char *tag, const uint8_t **value, uint16_t *length);
+
+// TLV索引：一次扫描记录各字段的位置，之后按标签查找无需重新扫描数据
+// 只索引同一层的字段，嵌套TLV需对其值另建索引；重复标签时查找返回第一个
+#define TLV_INDEX_MAX_FIELDS 16
+
+typedef struct {
+    uint8_t tag[2];
+    uint16_t offset;   // 值在缓冲区中的偏移
+    uint16_t length;   // 值长度
+} TlvField;
+
+typedef struct {
+    const uint8_t *buffer;
+    uint8_t count;
+    TlvField fields[TLV_INDEX_MAX_FIELDS];
+} TlvIndex;
+
+// 建立索引，返回字段数；遇到不完整的字段或超过TLV_INDEX_MAX_FIELDS时停止
+int tlv_index_build(TlvIndex *index, const uint8_t *buffer, size_t buffer_size);
+const TlvField *tlv_index_find(const TlvIndex *index, const char *tag);
+
+// TLV游标：按顺序逐个访问同一层的字段，不限字段数，不建索引也不拷贝
+typedef struct {
+    const uint8_t *buffer;
+    size_t size;
+    size_t offset;
+} TlvCursor;
+
+void tlv_cursor_init(TlvCursor *cursor, const uint8_t *buffer, size_t buffer_size);
+// 取下一个字段（offset相对buffer）：成功返回1，没有更多字段返回0，字段不完整返回-1
+int tlv_cursor_next(TlvCursor *cursor, TlvField *field);
+
+// 与read_tlv_*返回值相同：定长类型成功返回1，字符串和原始数据返回长度，失败返回-1
+int tlv_index_get_uint8(const TlvIndex *index, const char *tag, uint8_t *value);
+int tlv_index_get_uint16(const TlvIndex *index, const char *tag, uint16_t *value);
+int tlv_index_get_uint32(const TlvIndex *index, const char *tag, uint32_t *value);
+int tlv_index_get_uint64(const TlvIndex *index, const char *tag, uint64_t *value);
+int tlv_index_get_float32(const TlvIndex *index, const char *tag, float *value);
+int tlv_index_get_string(const TlvIndex *index, const char *tag, char *str, size_t str_size);
+int tlv_index_get_raw(const TlvIndex *index, const char *tag, uint8_t *data, uint16_t *length);
+// 温度：按长度接受int16（0.1°C）或float32（°C），超出int16范围返回-1
+int tlv_decode_temperature(const uint8_t *value, uint16_t length, int16_t *temperature);
+int tlv_index_get_temperature(const TlvIndex *index, const char *tag, int16_t *value);
+// 不拷贝：*value指向原缓冲区中的值，缓冲区须在使用期间保持有效
+int tlv_index_get_view(const TlvIndex *index, const char *tag, const uint8_t **value, uint16_t *length);
 
 #ifdef __cplusplus
 }
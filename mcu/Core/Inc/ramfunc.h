@@ -0,0 +1,16 @@
+#ifndef RAMFUNC_H
+#define RAMFUNC_H
+
+// 放在SRAM中执行的函数
+// 72MHz下闪存读取要插2个等待周期。预取缓冲只能覆盖顺序取指，跳转后仍会停顿，
+// 所以闪存中的代码执行时间随分支走向变化。这里的函数放进.RamFunc段，链接脚本把该段放在.data中，
+// 启动代码复制初始化数据时一并复制到SRAM，从SRAM取指没有等待周期。
+// 闪存中的调用方经链接器生成的长跳转桩进入。中断向量表和HAL仍在闪存中
+// 主机构建中为空
+#if defined(USE_HAL_DRIVER)
+#define RAMFUNC __attribute__((section(".RamFunc")))
+#else
+#define RAMFUNC
+#endif
+
+#endif // RAMFUNC_H
@@ -0,0 +1,48 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 重复请求的应答缓存：主机因丢失应答而重发请求（包编号和内容都不变）时，
+// 重放已发出的应答帧，不再执行一次命令（带FR的temp不再等待一次温度转换，salm等不重复生效）。
+// 按链路、包编号和请求数据部分的CRC32匹配，只缓存RESPONSE_CACHE_FRAME_MAX以内的应答帧，
+// 更长的应答（glog等只读命令）重新执行。原请求挂起尚未应答时重发的请求被丢弃，
+// 挂起的命令完成后照常应答。只在执行任务中访问，不加锁
+#define RESPONSE_CACHE_ENTRIES   4
+#define RESPONSE_CACHE_FRAME_MAX 96     // temp、ping、salm等的应答帧都在此以内
+#define RESPONSE_CACHE_TTL_MS    10000  // 超过该时间的应答不再重放，覆盖主机的超时加重试间隔
+
+// response_cache_lookup()的结果
+#define RESPONSE_CACHE_MISS    0
+#define RESPONSE_CACHE_HIT     1   // 应答帧已拷入frame
+#define RESPONSE_CACHE_PENDING 2   // 原请求已挂起，尚未应答
+
+void response_cache_reset(void);
+
+// 查找同一请求之前的应答，命中时把应答帧拷入frame（长度*length）
+int response_cache_lookup(uint8_t link, uint16_t packet_id, uint32_t request_crc,
+                          uint8_t *frame, uint16_t frame_size, uint16_t *length);
+
+// 开始执行一个请求：占用一项（替换最早的一项），应答前为挂起状态
+void response_cache_begin(uint8_t link, uint16_t packet_id, uint32_t request_crc);
+
+// 请求已应答：保存应答帧，帧过长时删除该项
+void response_cache_store(uint8_t link, uint16_t packet_id, const uint8_t *frame, uint16_t length);
+
+// 请求失败或应答不止一帧（分片传输等）：删除该项，重发的请求重新执行
+void response_cache_drop(uint8_t link, uint16_t packet_id);
+
+// 重放的应答数（各链路合计，gcom的DR）
+uint32_t response_cache_replays(void);
+void response_cache_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RESPONSE_CACHE_H
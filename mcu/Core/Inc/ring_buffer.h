@@ -0,0 +1,57 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 单生产者/单消费者无锁字节环形缓冲区
+// - 容量必须为2的幂，索引通过掩码取模
+// - head只由生产者（ISR/DMA）写入，tail只由消费者（任务）写入，互不加锁
+// - head/tail为自由递增的16位计数，已用字节数 = head - tail
+typedef struct {
+    uint8_t *buffer;           // 存储区
+    uint16_t size;             // 容量（2的幂，不超过16384）
+    uint16_t mask;             // size - 1
+    volatile uint16_t head;    // 生产者写入计数
+    volatile uint16_t tail;    // 消费者读取计数
+    uint32_t overflows;        // 溢出次数（由消费者检测并记录）
+    uint16_t peak;             // 消费者读取时见到的最大已用字节数
+} RingBuffer;
+
+// 初始化环形缓冲区，size不是2的幂时返回false
+bool ring_buffer_init(RingBuffer *rb, uint8_t *storage, uint16_t size);
+
+// 清空缓冲区（仅在生产者停止时调用）
+void ring_buffer_reset(RingBuffer *rb);
+
+// 生产者：写入数据，返回实际写入字节数（空间不足时截断）
+uint16_t ring_buffer_push(RingBuffer *rb, const uint8_t *data, uint16_t length);
+
+// 生产者：存储区已由DMA直接写入，将head推进到DMA写入位置write_pos（0~size）
+// 若推进后超出容量（DMA覆盖了未读数据）返回false，由消费者在读取时丢弃
+bool ring_buffer_commit_to(RingBuffer *rb, uint16_t write_pos);
+
+// 消费者：获取可连续读取的数据块，返回其长度，无数据返回0
+uint16_t ring_buffer_peek(RingBuffer *rb, const uint8_t **data);
+
+// 消费者：丢弃已处理的length字节
+void ring_buffer_consume(RingBuffer *rb, uint16_t length);
+
+// 消费者：读取数据，返回实际读取字节数
+uint16_t ring_buffer_pop(RingBuffer *rb, uint8_t *data, uint16_t length);
+
+// 当前已用字节数
+uint16_t ring_buffer_count(const RingBuffer *rb);
+
+// 当前剩余空间
+uint16_t ring_buffer_space(const RingBuffer *rb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RING_BUFFER_H
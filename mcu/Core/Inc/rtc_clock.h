@@ -0,0 +1,83 @@
+#ifndef RTC_CLOCK_H
+#define RTC_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// RTC时钟：F1的RTC是一个32位秒计数器，直接保存Unix时间戳（1970-01-01 00:00:00起的秒数），
+// 读取时间戳只读两次计数器寄存器；日期和时间（年份2000~2099）只在gdat/gtim/sdat/stim时换算，
+// 闰年按公历计算。不使用HAL的日期接口（F1的HAL只把计数器当作一天内的秒数）
+#define RTC_TIMESTAMP_2000 946684800U  // 2000-01-01 00:00:00
+#define RTC_TIMESTAMP_2100 4102444800U // 2100-01-01 00:00:00，可设置的时间戳上限（不含）
+
+bool rtc_is_initialized(void);
+// RTC由VBAT供电时复位后仍在计时：设置过时间的标记和亚秒部分保存在备份寄存器中，
+// 标记有效时恢复亚秒部分并返回true，MX_RTC_Init()据此跳过设置默认时间
+bool rtc_restore(void);
+uint64_t rtc_get_timestamp(void);
+bool rtc_set_timestamp(uint32_t timestamp);
+// 毫秒时间戳：秒取自计数器，毫秒由RTC预分频器的余数换算（分辨率1/32768秒）。
+// F1的预分频器不能置位，按毫秒设置时计数器按整秒写入，差值保存在RAM中加在读数上
+uint64_t rtc_get_timestamp_ms(void);
+bool rtc_set_timestamp_ms(uint64_t timestamp_ms);
+// 按RTC时间等待span_ms时内核超时的节拍数：通常相同，测试模式（test_mode.h）下按虚拟时钟的倍速缩短
+uint32_t rtc_wait_ticks(uint64_t span_ms);
+
+// 频率校准：correction为2^-20（约0.954 ppm）的步数，正值使时钟变慢。
+// F1的校准寄存器只能每2^20个周期跳过CAL个周期（变慢），需要变快时把预分频值减1
+// （约快32步）再用CAL调回，因此范围不对称
+#define RTC_CORRECTION_MIN (-32)
+#define RTC_CORRECTION_MAX 127
+int16_t rtc_get_correction(void);
+bool rtc_set_correction(int16_t steps);
+// 恢复保存的校准值（设置存储初始化之后由存储任务调用）
+void rtc_load_correction(void);
+// 设置存储读取当前校准值（CONFIG_KEY_CLOCK的条目，int16_t）
+void rtc_get_correction_item(uint16_t index, void *item);
+
+// 校时：offset_ms为主机测得的主机时间减设备时间，按它调整时钟。
+// 与起点相隔RTC_DRIFT_MIN_INTERVAL_MS以上时，用期间累计调整的时间估计频率误差并修改校准值；
+// 偏差超过RTC_SYNC_STEP_MAX_MS或用其他方式设置过时间时重新开始估计
+#define RTC_DRIFT_MIN_INTERVAL_MS (6UL * 3600UL * 1000UL) // 往返时延的误差（约10毫秒）折合不到0.5 ppm
+#define RTC_SYNC_STEP_MAX_MS      60000L
+bool rtc_sync(int32_t offset_ms);
+
+// RTC闹钟：可从STOP模式唤醒（EXTI17），只在整秒（计数器进位）触发，同时只有一个。
+// 定时唤醒：各槽在不晚于timestamp_ms的最后一个整秒调用callback（在闹钟中断中），
+// 内核节拍停止（low_power.h）时同样准时。返回触发时刻，该整秒已经过去时不设置并返回0。
+// 槽触发一次后清除；设置时间后所有已设置的槽都立即触发（在设置时间的任务中调用）
+#define RTC_WAKE_SAMPLER 0  // 采样任务的下一次转换
+#define RTC_WAKE_LOGGER  1  // 记录任务的下一条记录
+#define RTC_WAKE_COUNT   2
+typedef void (*RtcWakeCallback)(void);
+void rtc_alarm_init(void);
+uint64_t rtc_wake_schedule(uint8_t slot, uint64_t timestamp_ms, RtcWakeCallback callback);
+void rtc_wake_cancel(uint8_t slot);
+// 空闲时进入STOP前使用：闹钟临时设为timestamp_ms之前的最后一个整秒和各槽中较早的一个，
+// 返回触发时刻，早于earliest_ms时不设置并返回0；唤醒后用rtc_alarm_restore()恢复为各槽的闹钟
+uint64_t rtc_alarm_arm(uint64_t timestamp_ms, uint64_t earliest_ms);
+void rtc_alarm_restore(void);
+void rtc_alarm_irq_handler(void);
+// STOP唤醒后读取时间之前调用
+void rtc_resync(void);
+
+// 日期和时间：设置日期时保持当天的时刻，设置时间时保持日期；星期由日期计算，设置时忽略
+bool rtc_get_date(RTCDate *date);
+bool rtc_set_date(const RTCDate *date);
+bool rtc_get_time(RTCTime *time);
+bool rtc_set_time(const RTCTime *time);
+
+// 公历换算：days为1970-01-01起的天数
+uint32_t rtc_days_from_civil(uint16_t year, uint8_t month, uint8_t day);
+void rtc_civil_from_days(uint32_t days, uint16_t *year, uint8_t *month, uint8_t *day);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RTC_CLOCK_H
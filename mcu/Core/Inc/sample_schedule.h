@@ -0,0 +1,47 @@
+#ifndef SAMPLE_SCHEDULE_H
+#define SAMPLE_SCHEDULE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 采样计划：采样完成（发布读数）的时刻对齐到RTC时间的整周期（1秒周期即每个整秒，
+// 整分也是整秒），转换按最近一次的转换耗时加余量提前开始，提前完成时等到计划时刻再发布。
+// 每次按计划的采样记录发布时刻与计划时刻之差（误差），供stat查询：
+// - 误差超过SAMPLE_SCHEDULE_TOLERANCE_MS，或整个周期没有采样（转换耗时超过一个周期），记为错过
+// - 设置时间使计划时刻与当前时间相差过大时重新对齐，不计为错过
+// 主机请求的立即采样（temp_sampler_request_fresh()）不在计划内，不计入
+#define SAMPLE_SCHEDULE_MARGIN_MS    20U     // 提前量中转换耗时之外的余量（唤醒和调度延迟）
+#define SAMPLE_SCHEDULE_TOLERANCE_MS 50U
+#define SAMPLE_SCHEDULE_RESYNC_MS    60000U  // 落后超过这么久时重新对齐
+// 误差按2的幂分桶（毫秒）：桶0为不到1毫秒，桶i为[2^(i-1), 2^i)，最后一桶不封顶
+#define SAMPLE_SCHEDULE_BUCKETS      8
+
+typedef struct {
+    uint32_t samples;          // 按计划完成的采样数
+    uint32_t missed;           // 错过的计划时刻
+    uint32_t error_max_ms;     // 误差绝对值的最大值
+    uint32_t lead_ms;          // 当前提前量
+    uint16_t error_hist[SAMPLE_SCHEDULE_BUCKETS]; // 到65535后不再增加
+} SampleScheduleStats;
+
+// 采样任务启动时调用，period_ms为采样周期
+void sample_schedule_reset(uint32_t period_ms);
+// 下一次按计划的转换的开始时刻；第一次调用或重新对齐时从now_ms之后的整周期开始
+uint64_t sample_schedule_next_start(uint64_t now_ms);
+// 本周期的计划完成时刻（sample_schedule_next_start()之后有效）
+uint64_t sample_schedule_due(void);
+// 按计划的采样发布时调用：记录误差，按本次转换耗时更新提前量，推进到下一个周期
+void sample_schedule_complete(uint64_t publish_ms, uint32_t conversion_ms);
+
+void sample_schedule_get_stats(SampleScheduleStats *stats);
+void sample_schedule_clear_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLE_SCHEDULE_H
@@ -0,0 +1,34 @@
+#ifndef SAMPLING_SETTINGS_H
+#define SAMPLING_SETTINGS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 采样设置：记录间隔（slog）、分辨率（sres）、滤波（sflt）、各传感器的日志压缩配置（slog的"LC"）和校准点（scal），
+// 保存在设置存储中（config_store.h），复位后由存储任务加载一次。
+// 设置的当前值仍在各模块的变量中，命令直接读取；修改后由命令处理请求保存，存储任务合并写入
+typedef struct {
+    uint32_t log_interval_ms;
+    uint8_t resolution;
+    uint8_t filter_mode;
+    uint8_t filter_param;
+    uint8_t reserved;
+} SamplingSettings;
+
+// 加载保存的设置（存储任务启动时调用）；没有保存过或内容不合法的部分保持默认值
+void sampling_settings_load(void);
+
+// 设置存储读取当前设置
+void sampling_settings_get_item(uint16_t index, void *item);
+void sampling_settings_get_compress_item(uint16_t index, void *item);
+void sampling_settings_get_calib_item(uint16_t index, void *item);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLING_SETTINGS_H
@@ -0,0 +1,45 @@
+#ifndef SD_CARD_H
+#define SD_CARD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "log_archive.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// microSD卡驱动（寄存器级，LOG_ARCHIVE_SD时编译），只用作日志归档的块设备（log_archive.h）。
+// SDIO使用1位总线：D0 PC8、CK PC12、CMD PD2；D2、D3所在的PC10/PC11是有线链路的UART4，
+// 不使用4位总线（1位总线24MHz约3MB/s，归档每秒只写几十字节）。D0、CMD需要上拉（卡座模块通常自带）。
+// 只支持2.0及以上的卡（SDSC、SDHC、SDXC），按512字节块寻址。
+// 数据经DMA2通道4传输，等待完成时查询状态并让出CPU（osDelay()），不使用中断；
+// 写入后等卡编程完成（可能数百毫秒）才返回，只在存储任务释放1-Wire总线锁后调用
+#define SD_CARD_BLOCK_SIZE      512U
+#define SD_CARD_INIT_CLKDIV     178U    // SDIO_CK = 72MHz / (CLKDIV + 2)，识别阶段不超过400kHz
+#define SD_CARD_TRANSFER_CLKDIV 1U      // 24MHz
+#define SD_CARD_INIT_TIMEOUT_MS 1000U   // 等待卡上电完成（ACMD41）
+#define SD_CARD_TIMEOUT_MS      500U    // 一次读写（含卡编程）
+#define SD_CARD_MAX_BLOCKS      127U    // 一次读写的最大块数（DMA计数为16位）
+
+// 上电并识别卡（存储任务启动时调用），没有插卡或卡不支持时返回false并关闭SDIO
+bool sd_card_init(void);
+bool sd_card_ready(void);
+uint32_t sd_card_block_count(void);
+
+// 读写count块（1~SD_CARD_MAX_BLOCKS），data须32位对齐；调用方持有sd_card_lock()
+bool sd_card_read(uint32_t block, uint32_t count, void *data);
+bool sd_card_write(uint32_t block, uint32_t count, const void *data);
+
+// 存储任务的写入与命令执行任务的读取互斥（调度器启动前不加锁）
+void sd_card_lock(void);
+void sd_card_unlock(void);
+
+// 归档使用的块设备（sd_card_init()成功后有效）
+const LogArchiveDevice *sd_card_archive_device(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SD_CARD_H
@@ -1,15 +1,313 @@
 #ifndef SERDES_HPP
 #define SERDES_HPP
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <type_traits>
 #include "utils/tlv.hpp"
 #include "utils/buffer.hpp"
+#include "protocol.h"
 
+/**
+ * @brief 编译期TLV标签
+ * @details 作为非类型模板参数使用，如 serializer.write<"TP">(value)，
+ *          标签值在编译期确定，单字符标签（如"L"）第二字节为0。
+ */
+struct TLVTag
+{
+    uint16_t value; ///< 与TLV::tag相同的编码
+
+    template <size_t N>
+    constexpr TLVTag(const char (&name)[N])
+        : value(TLV::make_tag(name))
+    {
+        static_assert(N == 2 || N == 3, "TLV标签为1或2个字符");
+    }
+};
+
+/**
+ * @brief TLV编码器
+ * @details 在BufferWriter上顺序写入TLV字段，定长值按类型经BufferWriter::write<T>写入。
+ *          嵌套字段用begin()预留4字节字段头，子字段直接写在其后，end()时回填长度，
+ *          整个响应一次写成，无需中间缓冲区。
+ *          任一写入失败后编码器进入失败状态，后续写入全部忽略，
+ *          调用方只需在最后检查一次ok()。
+ */
 class TLVSerializer
 {
 public:
-    TLVSerializer(BufferWriter& writer);
+    /**
+     * @brief 嵌套字段范围，由begin()返回、交给end()关闭
+     */
+    struct Scope
+    {
+        size_t start; ///< 字段头在writer中的位置
+    };
+
+    /**
+     * @brief 构造函数
+     * @param writer 目标写入器，从其当前位置开始写
+     */
+    TLVSerializer(BufferWriter &writer)
+        : writer_(writer), start_(writer.tell()), failed_(false)
+    {
+    }
+
+    /**
+     * @brief 写入定长字段
+     * @tparam Tag 标签
+     * @tparam T 值类型，按小端写入sizeof(T)字节
+     * @return 成功返回字段总长度，失败返回-1
+     */
+    template <TLVTag Tag, typename T>
+    int write(const T &value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "TLV值必须可按字节拷贝");
+        if (!reserve(4 + sizeof(T)))
+            return -1;
+        write_header(Tag.value, sizeof(T));
+        writer_.write(value);
+        return 4 + sizeof(T);
+    }
+
+    /**
+     * @brief 写入原始字节字段
+     * @return 成功返回字段总长度，失败返回-1
+     */
+    template <TLVTag Tag>
+    int write_raw(const void *data, uint16_t length)
+    {
+        if (!reserve(4 + static_cast<size_t>(length)))
+            return -1;
+        write_header(Tag.value, length);
+        if (length > 0)
+            writer_.write_raw(data, length);
+        return 4 + length;
+    }
+
+    /**
+     * @brief 写入字符串字段（不含结尾的'\0'）
+     * @return 成功返回字段总长度，失败返回-1
+     */
+    template <TLVTag Tag>
+    int write_string(const char *str)
+    {
+        size_t length = std::strlen(str);
+        if (length > UINT16_MAX)
+        {
+            failed_ = true;
+            return -1;
+        }
+        return write_raw<Tag>(str, static_cast<uint16_t>(length));
+    }
+
+    /**
+     * @brief 开始一个嵌套字段，预留字段头
+     * @return 嵌套范围，失败时后续end()同样失败
+     */
+    template <TLVTag Tag>
+    Scope begin()
+    {
+        Scope scope{writer_.tell()};
+        if (reserve(4))
+            write_header(Tag.value, 0);
+        return scope;
+    }
+
+    /**
+     * @brief 关闭嵌套字段，回填其长度
+     * @return 成功返回字段总长度，失败返回-1
+     */
+    int end(const Scope &scope)
+    {
+        if (failed_)
+            return -1;
+        size_t length = writer_.tell() - scope.start - 4;
+        if (length > UINT16_MAX)
+        {
+            failed_ = true;
+            return -1;
+        }
+        size_t current = writer_.tell();
+        writer_.seek(scope.start + 2);
+        writer_.write(static_cast<uint16_t>(length));
+        writer_.seek(current);
+        return static_cast<int>(4 + length);
+    }
 
+    /**
+     * @brief 目前为止是否全部写入成功
+     */
+    bool ok() const { return !failed_; }
+
+    /**
+     * @brief 自构造以来写入的字节数
+     */
+    size_t size() const { return writer_.tell() - start_; }
+
+private:
+    bool reserve(size_t length)
+    {
+        if (failed_ || writer_.available() < length)
+        {
+            failed_ = true;
+            return false;
+        }
+        return true;
+    }
+
+    void write_header(uint16_t tag, uint16_t length)
+    {
+        writer_.write(tag);
+        writer_.write(length);
+    }
+
+    BufferWriter &writer_; ///< 目标写入器
+    size_t start_;         ///< 构造时的写入位置
+    bool failed_;          ///< 是否发生过写入失败
+};
+
+/**
+ * @brief 结构体成员指针的成员类型
+ */
+template <typename M>
+struct TLVMemberTraits;
+
+template <typename S, typename T>
+struct TLVMemberTraits<T S::*>
+{
+    using struct_type = S;
+    using value_type = T;
 };
 
-#endif // SERDES_HPP
\ No newline at end of file
+/**
+ * @brief 字段绑定：标签 -> 结构体成员
+ * @details 如 TLVBind<TAG_YEAR, &RTCDate::year>，字段长度必须等于成员大小
+ */
+template <TLVTag Tag, auto Member>
+struct TLVBind
+{
+    using struct_type = typename TLVMemberTraits<decltype(Member)>::struct_type;
+    using value_type = typename TLVMemberTraits<decltype(Member)>::value_type;
+    static_assert(std::is_trivially_copyable_v<value_type>, "TLV值必须可按字节拷贝");
+
+    static constexpr uint16_t tag = Tag.value;
+    static constexpr auto member = Member;
+};
+
+/**
+ * @brief 编译期字段表，列出结构体各成员对应的标签
+ * @details 字段顺序与固件字段表（tlv_schema.c）相同，tags供测试逐项比对
+ */
+template <typename S, typename... Binds>
+struct TLVSchema
+{
+    using struct_type = S;
+    static constexpr std::array<uint16_t, sizeof...(Binds)> tags{Binds::tag...};
+    static_assert(sizeof...(Binds) <= 32, "字段数不能超过32");
+    static_assert((std::is_same_v<typename Binds::struct_type, S> && ...), "成员必须属于同一结构体");
+};
+
+/**
+ * @brief TLV解码器
+ * @details 按字段表从BufferReader顺序读取TLV字段，一次正向扫描填充结构体全部成员。
+ *          未列出的标签被跳过；重复标签以第一个为准；长度与成员类型不符视为缺失。
+ */
+class TLVDeserializer
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param reader 数据来源，从其当前位置读到末尾
+     */
+    TLVDeserializer(BufferReader &reader)
+        : reader_(reader)
+    {
+    }
+
+    /**
+     * @brief 按字段表解码
+     * @tparam Schema TLVSchema
+     * @param out 输出结构体，只有全部字段都找到时才算成功
+     * @return 成功返回1；字段缺失或数据不完整返回-1
+     */
+    template <typename Schema>
+    int read(typename Schema::struct_type &out)
+    {
+        return read_fields(out, static_cast<Schema *>(nullptr));
+    }
+
+private:
+    template <typename S, typename... Binds>
+    int read_fields(S &out, TLVSchema<S, Binds...> *)
+    {
+        constexpr uint32_t all = (sizeof...(Binds) == 32) ? 0xFFFFFFFFu
+                                                          : ((1u << sizeof...(Binds)) - 1);
+        uint32_t found = 0;
+
+        while (found != all && !reader_.is_end())
+        {
+            uint16_t tag, length;
+            if (reader_.read(tag) < 0 || reader_.read(length) < 0 ||
+                reader_.available() < length)
+                return -1; // 字段不完整
+
+            const char *value = reader_.current();
+            uint32_t index = 0;
+            ((bind_field<Binds>(out, tag, length, value, index++, found)) || ...);
+            reader_.shift(length);
+        }
+
+        return found == all ? 1 : -1;
+    }
+
+    template <typename Bind, typename S>
+    static bool bind_field(S &out, uint16_t tag, uint16_t length, const char *value,
+                           uint32_t index, uint32_t &found)
+    {
+        using T = typename Bind::value_type;
+        uint32_t bit = 1u << index;
+        if (tag != Bind::tag || length != sizeof(T) || (found & bit))
+            return false;
+        std::memcpy(&(out.*Bind::member), value, sizeof(T));
+        found |= bit;
+        return true;
+    }
+
+    BufferReader &reader_; ///< 数据来源
+};
+
+/** @brief SetRTCDate请求 */
+using RTCDateSchema = TLVSchema<RTCDate,
+                                TLVBind<TAG_YEAR, &RTCDate::year>,
+                                TLVBind<TAG_MONTH, &RTCDate::month>,
+                                TLVBind<TAG_DAY, &RTCDate::day>,
+                                TLVBind<TAG_WEEKDAY, &RTCDate::weekday>>;
+
+/** @brief SetRTCTime请求 */
+using RTCTimeSchema = TLVSchema<RTCTime,
+                                TLVBind<TAG_HOUR, &RTCTime::hour>,
+                                TLVBind<TAG_MINUTE, &RTCTime::minute>,
+                                TLVBind<TAG_SECOND, &RTCTime::second>>;
+
+/**
+ * @brief SetAlarms/GetAlarms中的单个IT项，AlarmConfig的全部成员
+ * @details 温度（L/H/HY/RT）为int16（0.1°C，TEMP_FORMAT_INT16）；
+ *          各字段都必须存在，版本较早、省略了部分字段的项由固件字段表处理
+ */
+using AlarmConfigSchema = TLVSchema<AlarmConfig,
+                                    TLVBind<TAG_ALARM_ID, &AlarmConfig::id>,
+                                    TLVBind<TAG_ALARM_LOW, &AlarmConfig::low_temp>,
+                                    TLVBind<TAG_ALARM_HIGH, &AlarmConfig::high_temp>,
+                                    TLVBind<TAG_ALARM_HYSTERESIS, &AlarmConfig::hysteresis>,
+                                    TLVBind<TAG_ALARM_DELAY, &AlarmConfig::delay_s>,
+                                    TLVBind<TAG_SENSOR, &AlarmConfig::sensor>,
+                                    TLVBind<TAG_ALARM_RATE, &AlarmConfig::rate>,
+                                    TLVBind<TAG_ALARM_ACTIONS, &AlarmConfig::actions>,
+                                    TLVBind<TAG_ALARM_ENABLED, &AlarmConfig::enabled>,
+                                    TLVBind<TAG_ALARM_WINDOW, &AlarmConfig::window_s>,
+                                    TLVBind<TAG_ALARM_HORIZON, &AlarmConfig::horizon_s>>;
+
+#endif // SERDES_HPP
@@ -0,0 +1,44 @@
+#ifndef SPI_NOR_H
+#define SPI_NOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "log_store.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 外置SPI NOR闪存驱动（W25Qxx系列，寄存器级，LOG_STORE_SPI_NOR时编译），只用作日志区（log_store.h）。
+// SPI3：SCK PB3、MISO PB4、MOSI PB5，片选PA15（GPIO）；这几个引脚在关闭JTAG（保留SWD）后空闲，
+// PB3不再输出SWO。SPI1、SPI2的DMA请求与蜂鸣器（TIM3_UP）、USART1冲突，因此用SPI3（DMA2通道1、2）。
+// 模式0，APB1 36MHz二分频为18MHz；按3字节地址寻址，最大16MB。
+// 较长的读写经DMA传输，几个字节的命令和读写直接收发；编程、擦除后查询状态寄存器等待完成，
+// 擦除期间让出CPU（osDelay()）。擦写期间CPU照常取指，不需要1-Wire总线锁
+#define SPI_NOR_SECTOR_SIZE       4096U   // 最小擦除单位，即日志页
+#define SPI_NOR_PROGRAM_PAGE      256U    // 一次编程不能跨过的边界
+#define SPI_NOR_DMA_MIN           16U     // 不少于该字节数的读写经DMA传输
+#define SPI_NOR_PROGRAM_TIMEOUT_MS 5U
+#define SPI_NOR_ERASE_TIMEOUT_MS  500U
+
+// 唤醒芯片、读取JEDEC ID并清除写保护（挂载日志时调用），没有应答或容量超出3字节地址时返回false
+bool spi_nor_init(void);
+bool spi_nor_ready(void);
+uint32_t spi_nor_capacity(void); // 字节
+
+// 读写由驱动内部加锁（存储任务写入与命令执行任务读取互斥，调度器启动前不加锁），
+// 每次调用等待上一次编程或擦除完成；编程只能把1改为0，须在擦除后进行
+bool spi_nor_read(uint32_t address, void *data, uint32_t size);
+bool spi_nor_program(uint32_t address, const void *data, uint32_t size);
+bool spi_nor_erase_sector(uint32_t address);
+
+// 整片擦除（清除日志，数十秒）：发出命令后立即返回，由spi_nor_busy()查询是否完成，
+// 完成前其他读写失败
+bool spi_nor_erase_chip(void);
+bool spi_nor_busy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPI_NOR_H
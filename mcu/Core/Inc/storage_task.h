@@ -0,0 +1,39 @@
+#ifndef STORAGE_TASK_H
+#define STORAGE_TASK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 存储任务：优先级最低，把日志待写队列和标记过的设置写入闪存（log_store、config_store）。
+// 擦写期间取指暂停，会打乱1-Wire时隙中断，每次写入前取得总线锁（onewire_lock()），
+// 擦写只落在两次总线传输之间。被唤醒后稍等STORAGE_BATCH_MS再写，
+// 同一时刻前后的记录和设置一次写完
+// 日志页的提前擦除（约20ms，期间中断无法执行）等到各串口链路已有STORAGE_ERASE_QUIET_MS没有收发，
+// 不打断正在收发的帧；链路一直忙时每STORAGE_ERASE_RETRY_MS再看一次，活动页快写满时不再等待
+#define STORAGE_BATCH_MS 100U
+#define STORAGE_ERASE_QUIET_MS 50U
+#define STORAGE_ERASE_RETRY_MS 200U
+#define STORAGE_READY_POLL_MS 1U // 等待加载完成时的查询间隔
+
+// 创建存储任务（在osKernelInitialize()之后、osKernelStart()之前调用）
+void storage_task_start(void);
+
+// 设置和日志是否已加载：任务启动后先扫描闪存（alarm_init()、rtc_load_correction()、
+// temp_log_init()），完成前报警、日志相关的命令返回NOT_INITIALIZED
+bool storage_task_ready(void);
+
+// 等到设置和日志加载完成（采样和记录任务开始检查报警、写日志前调用）
+void storage_task_wait_ready(void);
+
+// 有新的待写内容（任意任务调用，任务尚未创建时忽略，启动后第一次运行时写入）
+void storage_task_wake(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STORAGE_TASK_H
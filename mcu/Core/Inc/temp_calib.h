@@ -0,0 +1,45 @@
+#ifndef TEMP_CALIB_H
+#define TEMP_CALIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "device_control.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 传感器校准：每个传感器最多TEMP_CALIB_MAX_POINTS个校准点（读数 → 参考温度，单位均为0.1°C），
+// 采样任务在滤波前按校准点分段线性修正读数，原始值和滤波值都是修正后的温度。
+// 一个点只修正偏移，多个点在相邻两点之间插值，两端以最外侧一段外推。
+// 每段的斜率在配置时算好（16位小数的定点数），修正一个读数只需一次比较、一次乘法和移位
+#define TEMP_CALIB_MAX_POINTS 4
+#define TEMP_CALIB_MIN   -600  // 校准点的取值范围（DS18B20量程-55~125°C，留出修正余量）
+#define TEMP_CALIB_MAX   1300
+#define TEMP_CALIB_SLOPE_SHIFT 16
+
+typedef struct {
+    uint8_t count;                              // 校准点数，0为不修正（默认）
+    uint8_t reserved;
+    int16_t measured[TEMP_CALIB_MAX_POINTS];    // 传感器读数，严格递增
+    int16_t reference[TEMP_CALIB_MAX_POINTS];   // 对应的参考温度，严格递增
+} TempCalibration;
+
+// 检查校准点是否合法：点数不超过上限，读数和参考温度都在范围内且严格递增，相邻两点的斜率在1/4~4之间
+bool temp_calib_valid(const TempCalibration *calibration);
+
+// 修改sensor号传感器的校准（任意任务调用），下一次采样开始生效
+void temp_calib_configure(uint8_t sensor, const TempCalibration *calibration);
+void temp_calib_get(uint8_t sensor, TempCalibration *calibration);
+
+// 清除所有校准
+void temp_calib_reset(void);
+
+// 修正一次采样的count个读数（只在采样任务中调用），TEMP_INVALID保持不变
+void temp_calib_apply(int16_t *temperatures, uint8_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEMP_CALIB_H
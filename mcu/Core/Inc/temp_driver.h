@@ -0,0 +1,48 @@
+#ifndef TEMP_DRIVER_H
+#define TEMP_DRIVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "device_control.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 温度传感器驱动：每个驱动管理一组通道（一条1-Wire总线上的DS18B20、ADC上的热敏电阻、
+// SPI热电偶放大器等），操作都不阻塞。采样时先启动所有驱动的转换，再按各自的剩余时间
+// 等待和轮询，先完成的先读取，一次采样的耗时为最慢的驱动而不是各驱动之和。
+// 驱动按注册顺序编号，各驱动的通道依次占用传感器编号0~TEMP_MAX_SENSORS-1
+typedef struct {
+    const char *name;
+    // 发现通道，返回通道数（0为没有可用的传感器）；在采样任务中调用，可以访问总线
+    uint8_t (*probe)(void *context);
+    // 开始一次转换，remaining_ms为完成前的最长时间；总线无应答等失败时返回false
+    bool (*start)(void *context, uint32_t *remaining_ms);
+    // 转换是否完成；驱动自行处理超时（超时后返回true，由read判断结果）
+    bool (*poll)(void *context);
+    // 读取一个通道的结果（0.1°C），失败返回TEMP_INVALID
+    int16_t (*read)(void *context, uint8_t channel);
+    // 可选：通道是否可用（热敏电阻开路或短路、热电偶开路），为false时不读取，记为失败
+    bool (*healthy)(void *context, uint8_t channel);
+} TempDriver;
+
+#define TEMP_DRIVER_MAX        4
+#define TEMP_DRIVER_POLL_MS    5U    // 到达最长时间仍未完成时的轮询间隔
+#define TEMP_DRIVER_TIMEOUT_MS 1000U // 超过最长时间这么久仍未完成时放弃，本次各通道记为失败
+
+void temp_driver_reset(void); // 清除已注册的驱动
+// 在temperature_sensor_init()中调用；驱动表满时返回false
+bool temp_driver_register(const TempDriver *driver, void *context);
+// 依次调用各驱动的probe并分配传感器编号，返回传感器总数；超出TEMP_MAX_SENSORS的通道不使用
+uint8_t temp_driver_probe(void);
+uint8_t temp_driver_sensor_count(void);
+// 一次采样：所有驱动同时转换，在采样任务中调用，等待时只阻塞本任务；返回传感器数。
+// temperatures至少TEMP_MAX_SENSORS个，失败的通道为TEMP_INVALID
+uint8_t temp_driver_sample(int16_t *temperatures);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEMP_DRIVER_H
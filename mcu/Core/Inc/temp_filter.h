@@ -0,0 +1,42 @@
+#ifndef TEMP_FILTER_H
+#define TEMP_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "device_control.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 温度滤波：在采样任务中对每个传感器的原始读数做定点滤波（单位均为0.1°C），
+// 原始值和滤波值同时发布，可用较低分辨率的快速转换加滤波代替12位转换
+#define TEMP_FILTER_NONE     0x00  // 不滤波，滤波值等于原始值（默认）
+#define TEMP_FILTER_AVERAGE  0x01  // 最近N次的滑动平均
+#define TEMP_FILTER_MEDIAN   0x02  // 最近N次的中值
+#define TEMP_FILTER_EMA      0x03  // 指数滑动平均，系数1/2^N
+
+#define TEMP_FILTER_MAX_WINDOW 8   // 滑动平均、中值的最大窗口
+#define TEMP_FILTER_MAX_SHIFT  6   // EMA的最大N（系数1/64）
+
+typedef struct {
+    uint8_t mode;    // TEMP_FILTER_*
+    uint8_t param;   // 窗口大小（平均、中值）或系数位移（EMA）
+} TempFilterConfig;
+
+// 检查配置是否合法
+bool temp_filter_config_valid(const TempFilterConfig *config);
+
+// 修改配置（任意任务调用），采样任务在下一次滤波前清空历史
+void temp_filter_configure(const TempFilterConfig *config);
+void temp_filter_get_config(TempFilterConfig *config);
+
+// 对一个传感器的新读数滤波（只在采样任务中调用），
+// 原始值为TEMP_INVALID时不计入历史，返回TEMP_INVALID
+int16_t temp_filter_apply(uint8_t sensor, int16_t raw);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEMP_FILTER_H
@@ -0,0 +1,28 @@
+#ifndef TEMP_LOGGER_H
+#define TEMP_LOGGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 温度记录任务：按固定间隔把采样任务的最近一次读数写入温度日志，
+// 与主机是否连接、是否查询无关，日志条目间隔均匀。间隔按RTC计时，由RTC闹钟唤醒（rtc_clock.h）
+#define TEMP_LOG_INTERVAL_DEFAULT_MS 60000  // 默认每分钟记录一次
+#define TEMP_LOG_INTERVAL_MIN_MS     1000   // 不短于采样间隔
+
+// 创建记录任务（在osKernelInitialize()之后、osKernelStart()之前调用）
+void temp_logger_start(void);
+
+// 设置记录间隔，0表示停止记录；间隔非法返回false
+// 新间隔从设置时开始计时
+bool temp_logger_set_interval(uint32_t interval_ms);
+uint32_t temp_logger_get_interval(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEMP_LOGGER_H
@@ -0,0 +1,52 @@
+#ifndef TEMP_SAMPLER_H
+#define TEMP_SAMPLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "device_control.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 温度采样任务：独占DS18B20总线，连续转换并发布最近一次读数，
+// 命令执行任务从缓存取值，不再等待转换。存储任务在转换等待期间擦写闪存（onewire_lock()）
+#define TEMP_SAMPLE_INTERVAL_MS   1000  // 采样周期，读数在RTC时间的整秒发布（sample_schedule.h）
+#define TEMP_SAMPLE_TIMEOUT_MS    2000  // 等待新采样的最长时间（含一次转换）
+
+// 一次采样结果：总线上所有传感器共享一次广播转换
+typedef struct {
+    int16_t temperatures[TEMP_MAX_SENSORS]; // 滤波后的读数，按传感器编号，0.1°C，读取失败为TEMP_INVALID
+    int16_t raw[TEMP_MAX_SENSORS];          // 滤波前的原始读数
+    uint8_t sensor_count;  // temperatures中有效的个数
+    uint32_t tick;         // 发布时的HAL_GetTick()（按计划的采样为RTC的整秒）
+    uint32_t sequence;     // 采样序号，从1开始递增，0表示尚无采样
+} TempSample;
+
+// 创建采样任务（在osKernelInitialize()之后、osKernelStart()之前调用）
+void temp_sampler_start(void);
+
+// 取最近一次采样，尚无采样返回false
+bool temp_sampler_get(TempSample *sample);
+
+// 请求立即开始一次新的转换，返回当前已开始的转换序号；
+// 序号大于返回值的采样都是在请求之后开始转换的
+uint32_t temp_sampler_request_fresh(void);
+
+// 请求修改分辨率（由采样任务在下一次转换前写入传感器），返回值同temp_sampler_request_fresh()；
+// 序号更大的采样完成后可用temperature_get_resolution()确认是否生效
+uint32_t temp_sampler_request_resolution(uint8_t bits);
+
+// 转换完成到报警检查（含蜂鸣器/LED输出）结束的最长耗时（微秒），复位后清零
+uint32_t temp_sampler_alarm_latency_max_us(void);
+
+// 采样距今的毫秒数
+static inline uint32_t temp_sample_age_ms(const TempSample *sample, uint32_t now) {
+    return now - sample->tick;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEMP_SAMPLER_H
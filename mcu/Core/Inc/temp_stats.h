@@ -0,0 +1,63 @@
+#ifndef TEMP_STATS_H
+#define TEMP_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "device_control.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 逐次采样的运行统计：采样任务每次转换后按传感器更新（滤波后的温度，单位0.1°C），
+// 命令直接读取结果，主机不必下载日志再计算最小、最大、平均值和方差。
+// 统计窗口：复位（或清零）以来、最近一小时（12个5分钟的桶）、最近一天（24个1小时的桶）；
+// 时间窗按桶对齐，当前的桶未满，最近一小时实际覆盖55~60分钟。
+// 每个窗口只保存条数、和、平方和（整数，精确），方差在查询时按整数均值展开计算，
+// 多年的逐秒读数也不溢出，桶之间直接相加合并；更新为O(1)，查询最多合并24个桶。
+// 超过阈值的时长按采样间隔累计（读数高于阈值时计入与上一次采样的间隔），阈值修改后从下一次采样开始生效
+#define TEMP_STATS_SINCE_BOOT 0
+#define TEMP_STATS_HOUR       1
+#define TEMP_STATS_DAY        2
+#define TEMP_STATS_WINDOWS    3
+
+#define TEMP_STATS_HOUR_BINS    12
+#define TEMP_STATS_HOUR_BIN_MS  300000U
+#define TEMP_STATS_DAY_BINS     24
+#define TEMP_STATS_DAY_BIN_MS   3600000U
+#define TEMP_STATS_MAX_GAP_MS   5000U   // 两次采样的间隔超过它时（传感器失败、任务停顿）不计入超限时长
+#define TEMP_STATS_WARM_MAGIC   0x53545354UL // 热复位保留块（warm_state.h）
+
+typedef struct {
+    uint32_t count;
+    int16_t min;           // count为0时无意义
+    int16_t max;
+    int16_t mean;          // 四舍五入
+    uint32_t variance;     // 样本方差（除以count - 1），单位(0.1°C)²；少于两条为0
+    uint32_t above_ms;     // 高于阈值的时长
+    int16_t threshold;     // TEMP_INVALID为未设置
+} TempStatsResult;
+
+// 清空所有传感器的统计和阈值（复位时）
+void temp_stats_reset(void);
+
+// 启动时调用（调度器启动前）：热复位且保留的统计校验通过时沿用，否则同temp_stats_reset()
+void temp_stats_warm_restore(void);
+
+// 清空sensor号传感器的统计，阈值保留
+void temp_stats_clear(uint8_t sensor);
+
+// 设置超限时长的阈值，TEMP_INVALID为不统计
+void temp_stats_set_threshold(uint8_t sensor, int16_t threshold);
+
+// 送入一次采样的count个读数（只在采样任务中调用），TEMP_INVALID不计入；tick为转换完成时的HAL_GetTick()
+void temp_stats_update(const int16_t *temperatures, uint8_t count, uint32_t tick);
+
+// 取sensor号传感器在window（TEMP_STATS_*）内的统计，now为当前的HAL_GetTick()；参数非法返回false
+bool temp_stats_query(uint8_t sensor, uint8_t window, uint32_t now, TempStatsResult *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEMP_STATS_H
@@ -0,0 +1,74 @@
+#ifndef TEST_MODE_H
+#define TEST_MODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "temp_driver.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 测试模式（TEST_MODE时启用）：脚本传感器代替DS18B20，倍速的虚拟时钟代替RTC，
+// 采样、报警、记录、每小时汇总和压缩、推送整条流水线按倍速运行，读数只由种子和采样序号决定，
+// 每次启动的结果相同，与环境温度和RTC状态无关。
+// 虚拟时钟启动时为2000-01-01（与没有设置过时间的RTC相同），按内核节拍推进，
+// 每个节拍前进TEST_MODE_SPEED毫秒；sdat/stim/sdtm/csyn只修改虚拟时钟，不写入RTC。
+// RTC闹钟按硬件的整秒触发，测试模式下不使用，采样和记录任务只用内核超时等待（rtc_wait_ticks()），
+// 也不进入STOP模式。链路超时、订阅推送间隔等按内核节拍的计时不加速
+#ifndef TEST_MODE
+#define TEST_MODE 0 // 1：启用测试模式
+#endif
+#ifndef TEST_MODE_SPEED
+#define TEST_MODE_SPEED 10U // 虚拟时钟的倍速
+#endif
+#ifndef TEST_MODE_SEED
+#define TEST_MODE_SEED 1U
+#endif
+#ifndef TEST_MODE_SENSORS
+#define TEST_MODE_SENSORS 4U
+#endif
+
+// 脚本（0.1°C）：传感器i的基准为BASE + i × STEP，叠加周期PERIOD次采样、幅度AMPLITUDE的三角波
+// （各传感器相位错开PERIOD/8）和±NOISE的伪随机噪声；0号传感器在每SPIKE_EVERY次采样的
+// 最后SPIKE_LENGTH次升高SPIKE（触发报警和报警前后记录），最后一个传感器每DROP_EVERY次采样
+// 失败一次（传感器健康统计和记录的缺失值）
+#define TEST_SCRIPT_BASE         250
+#define TEST_SCRIPT_STEP         15
+#define TEST_SCRIPT_AMPLITUDE    100
+#define TEST_SCRIPT_PERIOD       600U
+#define TEST_SCRIPT_NOISE        3
+#define TEST_SCRIPT_SPIKE        400
+#define TEST_SCRIPT_SPIKE_EVERY  300U
+#define TEST_SCRIPT_SPIKE_LENGTH 5U
+#define TEST_SCRIPT_DROP_EVERY   97U
+
+typedef struct {
+    uint32_t seed;
+    uint8_t sensors;
+    uint32_t index;   // 下一次转换的采样序号
+    uint32_t current; // 本次转换的采样序号，读取时使用
+} TestScript;
+
+void test_script_init(TestScript *script, uint32_t seed, uint8_t sensors);
+// 第index次采样时sensor的读数，失败时返回TEMP_INVALID
+int16_t test_script_value(const TestScript *script, uint8_t sensor, uint32_t index);
+// 温度驱动（temp_driver.h），context为TestScript；转换立即完成
+extern const TempDriver test_script_driver;
+
+// 倍速换算：ticks个内核节拍对应的虚拟毫秒数；等待span_ms虚拟毫秒需要的节拍数（向上取整）
+uint64_t test_clock_elapsed_ms(uint32_t ticks, uint32_t speed);
+uint32_t test_clock_wait_ticks(uint64_t span_ms, uint32_t speed);
+
+#if TEST_MODE
+extern TestScript test_mode_script; // temperature_sensor_init()注册
+// 虚拟时钟，rtc_clock.c使用；不阻塞，可在调度器挂起时调用
+uint64_t test_mode_clock_ms(void);
+void test_mode_clock_set_ms(uint64_t timestamp_ms);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEST_MODE_H
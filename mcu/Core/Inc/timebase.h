@@ -0,0 +1,46 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 微秒时间系统：
+// - 短延时和耗时测量用DWT周期计数器（CYCCNT，每个CPU时钟加1），读取只需一次总线访问，
+//   周期数差值在2^32个周期（72MHz下约59.6s）内有效
+// - micros()由HAL时基（TIM7，1MHz计数，1ms溢出）拼接毫秒和计数值，按32位微秒回绕
+void timebase_init(void); // 使能DWT计数器（SystemClock_Config()之后调用）
+
+extern uint32_t timebase_cycles_per_us;
+
+// 当前周期计数
+static inline uint32_t timebase_cycles(void) {
+    return DWT->CYCCNT;
+}
+
+// 周期数换算为微秒（用于测量结果，不在延时循环中使用）
+static inline uint32_t timebase_cycles_to_us(uint32_t cycles) {
+    return cycles / timebase_cycles_per_us;
+}
+
+// 忙等cycles个CPU周期（误差为几个周期的读取开销）
+static inline void delay_cycles(uint32_t cycles) {
+    uint32_t start = DWT->CYCCNT;
+    while ((DWT->CYCCNT - start) < cycles) {
+    }
+}
+
+//获取系统时间，单位us
+uint32_t micros(void);
+
+// 微秒延时函数（忙等，基于DWT周期计数）
+void delay_us(uint32_t delay_time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TIMEBASE_H
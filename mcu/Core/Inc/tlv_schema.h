@@ -0,0 +1,132 @@
+#ifndef TLV_SCHEMA_H
+#define TLV_SCHEMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// TLV字段注册表：按 指令 + 嵌套层级 定义每一层允许的字段
+// 同一标签在不同指令或不同层级可以有不同含义（如sdat的"MM"为月、stim的"MM"为分），
+// 解码时按所在层级的字段表解析，不会混淆；表中没有的标签按长度一步跳过，
+// 因此新增字段不影响旧的解析器。
+// 字段只能追加，不能修改或删除已有字段；追加字段时增加TLV_SCHEMA_VERSION，
+// 并在字段的since中记录引入它的版本，主机可据ping返回的SV判断设备支持哪些字段。
+#define TLV_SCHEMA_VERSION        53
+#define TLV_SCHEMA_MAX_FIELDS     20  // 每层最多字段数（绑定结果用位图记录，glog请求最多）
+
+// 字段值类型
+typedef enum {
+    TLV_TYPE_RAW = 0,      // 任意字节
+    TLV_TYPE_UINT8,
+    TLV_TYPE_UINT16,
+    TLV_TYPE_UINT32,
+    TLV_TYPE_UINT64,
+    TLV_TYPE_FLOAT32,
+    TLV_TYPE_STRING,
+    TLV_TYPE_TEMPERATURE,  // int16（0.1°C）或float32（°C），见TEMP_FORMAT_*
+    TLV_TYPE_LIST          // 嵌套TLV，子字段见children
+} TlvType;
+
+typedef struct TlvSchema TlvSchema;
+
+// 字段定义
+typedef struct {
+    char tag[2];
+    uint8_t type;                 // TlvType
+    uint8_t since;                // 引入该字段的TLV_SCHEMA_VERSION
+    const TlvSchema *children;    // TLV_TYPE_LIST的下一层
+} TlvFieldDef;
+
+// 一层字段表
+struct TlvSchema {
+    const TlvFieldDef *fields;
+    uint8_t count;
+};
+
+// 按字段表绑定的结果：第i个字段对应schema->fields[i]，由下标取值无需再比较标签
+typedef struct {
+    const TlvSchema *schema;
+    const uint8_t *buffer;
+    uint32_t present;                         // bit i：第i个字段存在
+    uint16_t offset[TLV_SCHEMA_MAX_FIELDS];   // 值在buffer中的偏移
+    uint16_t length[TLV_SCHEMA_MAX_FIELDS];   // 值长度
+} TlvBinding;
+
+// 指令的请求/响应DA字段表，opcode为OP_*；未定义的指令返回NULL
+const TlvSchema *tlv_schema_request(uint8_t opcode);
+const TlvSchema *tlv_schema_response(uint8_t opcode);
+
+// 在一层字段表中查找标签，返回字段下标，未定义返回-1
+int tlv_schema_find(const TlvSchema *schema, const char *tag);
+
+// 一次扫描buffer，把字段表中的字段绑定到下标，未定义的标签按长度跳过
+// 定长类型的长度不符视为格式错误；重复标签以第一个为准
+// 返回绑定的字段数，数据不完整或长度不符返回-1
+int tlv_schema_bind(const TlvSchema *schema, const uint8_t *buffer, size_t buffer_size,
+                    TlvBinding *binding);
+
+// 第index个字段是否存在
+static inline bool tlv_binding_has(const TlvBinding *binding, uint8_t index) {
+    return (binding->present >> index) & 1U;
+}
+
+// 按下标取值（绑定时已检查长度），字段不存在返回-1
+int tlv_binding_get_uint8(const TlvBinding *binding, uint8_t index, uint8_t *value);
+int tlv_binding_get_uint16(const TlvBinding *binding, uint8_t index, uint16_t *value);
+int tlv_binding_get_uint32(const TlvBinding *binding, uint8_t index, uint32_t *value);
+int tlv_binding_get_uint64(const TlvBinding *binding, uint8_t index, uint64_t *value);
+int tlv_binding_get_temperature(const TlvBinding *binding, uint8_t index, int16_t *value);
+// 不拷贝：*value指向原缓冲区，返回值长度
+int tlv_binding_get_view(const TlvBinding *binding, uint8_t index, const uint8_t **value, uint16_t *length);
+
+// 各指令字段下标，与tlv_schema.c中的字段表顺序一致
+enum { PING_REQ_TF = 0, PING_REQ_LT, PING_REQ_CB, PING_REQ_CM, PING_REQ_HT };
+enum { PING_RSP_TF = 0, PING_RSP_SV, PING_RSP_SC, PING_RSP_LT, PING_RSP_CB, PING_RSP_CM, PING_RSP_HT, PING_RSP_RX, PING_RSP_TT };
+enum { TEMP_REQ_FR = 0, TEMP_REQ_SN, TEMP_REQ_MA };
+enum { RTC_DATE_YY = 0, RTC_DATE_MM, RTC_DATE_DD, RTC_DATE_WK };
+enum { RTC_TIME_HH = 0, RTC_TIME_MM, RTC_TIME_SS };
+enum { ALARM_LIST_AL = 0 };
+enum { ALARM_ITEMS_IT = 0 };
+enum { ALARM_ITEM_ID = 0, ALARM_ITEM_L, ALARM_ITEM_H, ALARM_ITEM_HY, ALARM_ITEM_DL,
+       ALARM_ITEM_SN, ALARM_ITEM_RT, ALARM_ITEM_AC, ALARM_ITEM_EN, ALARM_ITEM_WS, ALARM_ITEM_PH };
+enum { GALM_REQ_ID = 0 };
+enum { GLOG_REQ_T1 = 0, GLOG_REQ_T2, GLOG_REQ_MX, GLOG_REQ_CP, GLOG_REQ_FG, GLOG_REQ_WN, GLOG_REQ_SN, GLOG_REQ_RW, GLOG_REQ_BW, GLOG_REQ_CU, GLOG_REQ_SI, GLOG_REQ_L, GLOG_REQ_H,
+       GLOG_REQ_IR, GLOG_REQ_AS, GLOG_REQ_AR, GLOG_REQ_LA };
+enum { BAUD_REQ_BR = 0 };
+enum { SUBT_IV = 0, SUBT_AE, SUBT_SF };
+enum { FACK_REQ_SQ = 0, FACK_REQ_BM };
+enum { SRES_REQ_RS = 0 };
+enum { SFLT_FM = 0, SFLT_FN };
+enum { SLOG_IV = 0, SLOG_SN, SLOG_LC, SLOG_TO, SLOG_HB };
+enum { PATTERN_ON = 0, PATTERN_OF, PATTERN_RP, PATTERN_PT, PATTERN_DU, PATTERN_FQ };
+enum { GEVT_REQ_T1 = 0, GEVT_REQ_T2, GEVT_REQ_MX, GEVT_REQ_CU, GEVT_REQ_SI };
+enum { DATETIME_TS = 0, DATETIME_MS };
+enum { CSYN_REQ_T0 = 0, CSYN_REQ_CO };
+enum { STAT_REQ_ID = 0, STAT_REQ_CL };
+enum { GCOM_REQ_CL = 0 };
+enum { GTRC_REQ_ID = 0 };
+enum { BNCH_REQ_PD = 0, BNCH_REQ_SZ, BNCH_REQ_CT };
+enum { SADR_AD = 0 };
+enum { SGWY_AD = 0, SGWY_IV };
+enum { GGWY_REQ_AD = 0 };
+enum { FWRD_AD = 0, FWRD_DA };
+enum { GBST_REQ_T1 = 0, GBST_REQ_T2, GBST_REQ_MX, GBST_REQ_CU };
+enum { FWBG_REQ_FS = 0, FWBG_REQ_CK, FWBG_REQ_FP, FWBG_REQ_OL, FWBG_REQ_OC };
+enum { FWCH_REQ_FO = 0, FWCH_REQ_FD, FWCH_REQ_CK };
+enum { SCAL_SN = 0, SCAL_KP };
+enum { TSTA_REQ_SN = 0, TSTA_REQ_WN, TSTA_REQ_AT, TSTA_REQ_CL };
+
+// 嵌套层级的字段表（AL的值、AL中IT的值）
+extern const TlvSchema tlv_schema_alarm_items;
+extern const TlvSchema tlv_schema_alarm_item;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TLV_SCHEMA_H
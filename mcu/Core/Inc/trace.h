@@ -0,0 +1,70 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 热路径事件跟踪：RAM中的定长环形记录，满后覆盖最旧的记录。
+// 每条记录为DWT周期计数、事件编号、所在异常号（0为任务）和一个16位参数，
+// 写入只需屏蔽中断后几次存储，任务和任意优先级的中断中都可调用，不格式化、不阻塞。
+// 周期计数在STOP期间停止，跨越STOP的两条记录之间的间隔不可用。
+// 记录按写入序号编号，gtrc从给定序号开始读出，读出不影响写入
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+#define TRACE_RECORDS 256U // 2的幂
+
+// 事件编号及各自的参数
+#define TRACE_UART_RX       1  // 串口接收事件中断（半满/全满/空闲线），参数为DMA写入位置
+#define TRACE_FRAME_RX      2  // 解析完一帧，参数为FrameResult
+#define TRACE_DISPATCH      3  // 执行任务开始执行请求，参数为指令编号（0为批量请求或未知指令）
+#define TRACE_RESPONSE      4  // 响应帧提交到发送队列，参数为帧长度
+#define TRACE_TX_START      5  // 启动DMA发送，参数为帧长度
+#define TRACE_TX_DONE       6  // 发送完成中断，参数为帧长度
+#define TRACE_UART_ERROR    7  // 串口错误中断
+#define TRACE_ONEWIRE_START 8  // 1-Wire传输开始，参数为收发总位数
+#define TRACE_ONEWIRE_END   9  // 1-Wire传输结束，参数为0（有应答）或1（无应答）
+
+typedef struct {
+    uint32_t cycles;  // DWT->CYCCNT
+    uint8_t event;    // TRACE_*
+    uint8_t context;  // IPSR异常号，0为任务
+    uint16_t arg;
+} TraceRecord;
+
+extern TraceRecord trace_ring[TRACE_RECORDS];
+extern uint32_t trace_head; // 下一条记录的序号
+
+static inline void trace_event(uint8_t event, uint16_t arg) {
+#if TRACE_ENABLED
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    TraceRecord *record = &trace_ring[trace_head++ & (TRACE_RECORDS - 1)];
+    record->cycles = DWT->CYCCNT;
+    record->event = event;
+    record->context = (uint8_t)__get_IPSR();
+    record->arg = arg;
+    __set_PRIMASK(primask);
+#else
+    (void)event;
+    (void)arg;
+#endif
+}
+
+// 仍保留的最旧一条记录的序号
+uint32_t trace_oldest(void);
+
+// 从*sequence开始读出最多max_records条记录到out（按TraceRecord布局，小端，可不对齐），
+// *sequence更新为下一条的序号。*sequence早于最旧的记录时从最旧的记录开始，
+// 被覆盖的条数加到*lost；晚于最新的记录（如从机已复位）时也从最旧的记录开始。返回读出条数
+uint16_t trace_read(uint32_t *sequence, uint8_t *out, uint16_t max_records, uint32_t *lost);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_H
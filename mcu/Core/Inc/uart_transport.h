@@ -0,0 +1,77 @@
+#ifndef UART_TRANSPORT_H
+#define UART_TRANSPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "communication.h"
+#include "ble_module.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 串口传输层：直接控制USART和DMA通道的寄存器（LL），不经过HAL_UART的句柄锁、
+// 状态检查和回调分发。每个端口对象对应一条链路（COMM_LINK_*），通过uart_transport_ops
+// 作为CommTransport交给communication.c：
+// - uart_ble_port：USART1 + DMA1通道5（接收，循环模式）/通道4（发送），接BLE模块。
+//   引脚、时钟、帧格式和DMA通道的基本配置由MX_USART1_UART_Init()/HAL_UART_MspInit()完成
+// - uart_wired_port：UART4（PC10 TX/PC11 RX）+ DMA2通道3（接收）/通道5（发送），
+//   维护用的有线串口，由uart_transport_wired_init()配置。可接RS-485收发器组成多点总线：
+//   PC12接DE/RE，发送前拉高，USART TC（最后一个停止位移出）时在中断中立即拉低，
+//   RE与DE相连，本机发送期间不接收自己的回波。网关角色（COMM_GATEWAY）中同一端口是下游总线，
+//   回调的链路编号为COMM_LINK_BUS，本机作为总线主机（gateway.h）
+// 之后只由本层访问这些外设。中断中直接调用communication.h的回调：
+// - DMA半满/全满、空闲线：communication_rx_event_callback(链路, 当前写入位置)
+// - 最后一个字节移出移位寄存器（USART TC）：communication_tx_complete_callback(链路)
+// - 帧错误/噪声/溢出：DMA继续循环接收，只计数，丢失的字节由帧CRC发现；
+//   DMA传输错误时通道被硬件关闭，需要重新启动接收
+// 中断优先级都为抢占优先级5
+
+typedef struct UartPort UartPort;
+
+// UART4用作有线链路或网关的下游总线
+#define UART_WIRED_PORT (COMM_WIRED_LINK || COMM_GATEWAY)
+
+extern UartPort uart_ble_port;
+#if UART_WIRED_PORT
+extern UartPort uart_wired_port;
+#endif
+
+// 各端口共用的操作表，context为UartPort*
+extern const CommTransportOps uart_transport_ops;
+
+// 配置UART4、PC10/PC11/PC12和DMA2通道的时钟、引脚、帧格式（8N1，默认波特率）及中断
+void uart_transport_wired_init(void);
+
+// 设置波特率（接收和发送都已停止时调用），波特率超出范围时返回false，原设置不变
+bool uart_transport_set_baud(UartPort *port, uint32_t baud_rate);
+
+// 系统时钟改变后按各端口的波特率重新设置分频（clock_scale.c，中断屏蔽下调用）
+void uart_transport_clock_changed(void);
+
+// 从buffer开头启动循环接收，覆盖之前的接收状态
+void uart_transport_start_rx(UartPort *port, uint8_t *buffer, uint16_t size);
+
+// 停止接收
+void uart_transport_stop_rx(UartPort *port);
+
+// DMA在接收缓冲区中的当前写入位置（0..size）
+uint16_t uart_transport_rx_position(UartPort *port);
+
+// 启动一帧DMA发送，上一帧尚未发送完时返回false；data在完成回调前必须保持有效
+bool uart_transport_send(UartPort *port, const uint8_t *data, uint16_t length);
+
+// BLE模块的上电配置（ble_module.h）用的USART1轮询收发，只在communication_init()之前、
+// 接收DMA启动前使用
+const BleModulePort *uart_transport_ble_module_port(void);
+
+// 中断处理：串口中断、接收DMA通道中断、发送DMA通道中断分别调用（stm32f1xx_it.c）
+void uart_transport_irq_handler(UartPort *port);
+void uart_transport_rx_dma_irq_handler(UartPort *port);
+void uart_transport_tx_dma_irq_handler(UartPort *port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UART_TRANSPORT_H
@@ -0,0 +1,43 @@
+#ifndef USB_CDC_H
+#define USB_CDC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "communication.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// USB CDC-ACM传输层（COMM_LINK_USB）：直接控制全速USB设备外设的寄存器和包存储区（PMA），
+// 不使用USB中间件。主机看到一个虚拟串口，其上承载与串口链路相同的组帧协议，
+// 用于现场批量导出日志；波特率等线路设置被接受但不起作用。
+// 端点：EP0控制、EP1批量IN、EP2批量OUT（各64字节）、EP3中断IN（通知，未使用）。
+// 主机打开串口（DTR=1）后才发送；未枚举、总线挂起或主机关闭串口时send()返回false，
+// 正在发送的帧作为已完成结束，不会占住共用的发送槽。
+// 中断中直接调用communication.h的回调：
+// - 收到OUT包：数据拷入接收缓冲区后communication_rx_event_callback(COMM_LINK_USB, 写入位置)
+// - 一帧的最后一个IN包（需要时加零长度包）被主机取走：communication_tx_complete_callback()
+// OUT方向没有流控，接收缓冲区满时与串口DMA一样覆盖未读数据，由帧CRC发现。
+// 中断优先级为抢占优先级5（USB_LP_CAN1_RX0_IRQn）
+
+extern const CommTransportOps usb_cdc_ops;
+
+// 配置USB时钟（PLL 72MHz / 1.5 = 48MHz）和PA12，拉低D+约10毫秒让主机重新枚举后
+// 启动外设（communication_init()之后、调度器启动前调用）
+void usb_cdc_init(void);
+
+// 已枚举且总线未挂起：此时USB时钟不能停，不进入STOP模式
+bool usb_cdc_active(void);
+
+// 中断处理（在USB_LP_CAN1_RX0_IRQHandler中调用）
+void usb_cdc_irq_handler(void);
+
+// 挂起期间从STOP唤醒（在USBWakeUp_IRQHandler中调用），只清除EXTI18标志
+void usb_cdc_wakeup_irq_handler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // USB_CDC_H
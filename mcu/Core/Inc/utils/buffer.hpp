@@ -5,6 +5,8 @@
 #include <cstdint>
 #include <bit>
 #include <algorithm>
+#include <cstring>
+#include <type_traits>
 
 /**
  * @file buffer_normal.hpp
@@ -87,12 +89,28 @@ public:
     template <typename T>
     int peek(T &value) const;
     
+    /**
+     * @brief 批量读取类型化数据
+     * @tparam T 元素类型
+     * @param data 输出数组
+     * @param count 元素个数
+     * @return 成功返回读取字节数，剩余数据不足时不读取并返回-1
+     */
+    template <typename T>
+    int read_span(T *data, size_t count);
+    
     /**
      * @brief 获取当前读取位置
      * @return 相对于缓冲区起始位置的偏移量
      */
     size_t tell() const;
     
+    /**
+     * @brief 获取当前读取位置指针，可直接引用其后的数据而不拷贝
+     * @return 当前读取位置
+     */
+    const char *current() const;
+    
     /**
      * @brief 获取可用（剩余）字节数
      * @return 剩余可读取的字节数
@@ -185,6 +203,16 @@ public:
     template <typename T>
     int write(const T &value);
     
+    /**
+     * @brief 批量写入类型化数据
+     * @tparam T 元素类型
+     * @param data 源数组
+     * @param count 元素个数
+     * @return 成功返回写入字节数，剩余空间不足时不写入并返回-1
+     */
+    template <typename T>
+    int write_span(const T *data, size_t count);
+    
     /**
      * @brief 获取当前写入位置
      * @return 相对于缓冲区起始位置的偏移量
@@ -227,20 +255,78 @@ private:
 };
 
 // Template implementations
+namespace buffer_detail
+{
+/**
+ * @brief 在线路字节序与本机字节序之间拷贝一个值
+ * @details 字节序相同时为一次memcpy（Cortex-M3上编译为单条非对齐读写）；
+ *          不同且大小为2/4/8字节时用__builtin_bswap（编译为REV指令），其余逐字节反转。
+ */
 template <typename T>
-int BufferReader::peek(T &value) const
+inline void copy_value(void *dst, const void *src)
 {
-    if (sizeof(T) > available())
-        return -1; // Not enough data
+    static_assert(std::is_trivially_copyable_v<T>, "类型必须可按字节拷贝");
 
-    if constexpr (std::endian::native == endian)
+    if constexpr (std::endian::native == BufferWriter::endian || sizeof(T) == 1)
+    {
+        std::memcpy(dst, src, sizeof(T));
+    }
+    else if constexpr (sizeof(T) == 2)
+    {
+        uint16_t v;
+        std::memcpy(&v, src, sizeof(v));
+        v = __builtin_bswap16(v);
+        std::memcpy(dst, &v, sizeof(v));
+    }
+    else if constexpr (sizeof(T) == 4)
+    {
+        uint32_t v;
+        std::memcpy(&v, src, sizeof(v));
+        v = __builtin_bswap32(v);
+        std::memcpy(dst, &v, sizeof(v));
+    }
+    else if constexpr (sizeof(T) == 8)
     {
-        std::copy(current_, current_ + sizeof(T), reinterpret_cast<char *>(&value));
+        uint64_t v;
+        std::memcpy(&v, src, sizeof(v));
+        v = __builtin_bswap64(v);
+        std::memcpy(dst, &v, sizeof(v));
     }
     else
     {
-        std::reverse_copy(current_, current_ + sizeof(T), reinterpret_cast<char *>(&value));
+        const char *s = static_cast<const char *>(src);
+        std::reverse_copy(s, s + sizeof(T), static_cast<char *>(dst));
     }
+}
+
+/**
+ * @brief 拷贝count个值，字节序相同时为一次memcpy
+ */
+template <typename T>
+inline void copy_span(void *dst, const void *src, size_t count)
+{
+    if constexpr (std::endian::native == BufferWriter::endian || sizeof(T) == 1)
+    {
+        std::memcpy(dst, src, count * sizeof(T));
+    }
+    else
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            copy_value<T>(static_cast<char *>(dst) + i * sizeof(T),
+                          static_cast<const char *>(src) + i * sizeof(T));
+        }
+    }
+}
+} // namespace buffer_detail
+
+template <typename T>
+int BufferReader::peek(T &value) const
+{
+    if (sizeof(T) > available())
+        return -1; // Not enough data
+
+    buffer_detail::copy_value<T>(&value, current_);
     return sizeof(T);
 }
 
@@ -255,25 +341,37 @@ int BufferReader::read(T &value)
     return len;
 }
 
+template <typename T>
+int BufferReader::read_span(T *data, size_t count)
+{
+    if (count > available() / sizeof(T))
+        return -1; // Not enough data
+
+    buffer_detail::copy_span<T>(data, current_, count);
+    current_ += count * sizeof(T);
+    return static_cast<int>(count * sizeof(T));
+}
+
 template <typename T>
 int BufferWriter::write(const T &value)
 {
     if (sizeof(T) > available())
         return -1; // Not enough space
-        
-    if constexpr (std::endian::native == endian)
-    {
-        std::copy(reinterpret_cast<const char *>(&value),
-                  reinterpret_cast<const char *>(&value) + sizeof(T), current_);
-    }
-    else
-    {
-        std::reverse_copy(reinterpret_cast<const char *>(&value),
-                          reinterpret_cast<const char *>(&value) + sizeof(T), current_);
-    }
 
+    buffer_detail::copy_value<T>(current_, &value);
     current_ += sizeof(T);
     return sizeof(T);
 }
 
+template <typename T>
+int BufferWriter::write_span(const T *data, size_t count)
+{
+    if (count > available() / sizeof(T))
+        return -1; // Not enough space
+
+    buffer_detail::copy_span<T>(current_, data, count);
+    current_ += count * sizeof(T);
+    return static_cast<int>(count * sizeof(T));
+}
+
 #endif // BUFFER_NORMAL_HPP
\ No newline at end of file
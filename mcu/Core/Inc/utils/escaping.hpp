@@ -3,12 +3,15 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 /**
  * @brief 带转义功能的缓冲区读取器
  * 
  * 提供带转义处理的缓冲区读取功能，能够识别和处理转义序列，
  * 支持查找起始和结束标记。适用于需要转义的协议数据解析。
+ * 查找标记时按字扫描，跳过不含0xAA/0x55的整段数据；没有找到时记下停止的位置，
+ * 数据追加到缓冲区末尾（append()）后再次查找从该位置继续，已检查的字节不再扫描。
  */
 class EscapingReader
 {
@@ -56,17 +59,32 @@ public:
     
     /**
      * @brief 查找起始标记 (0xAA55)
-     * @return true 如果找到起始标记
+     * @return true 如果找到起始标记，读取位置移到标记之后
+     * @note 没有找到时读取位置停在末尾（末字节为0xAA时停在该字节上），
+     *       追加数据后再次调用从该位置继续
      */
     bool find_start();
     
     /**
      * @brief 查找结束标记 (0x55AA)
-     * @return true 如果找到结束标记
-     * @note 在查找过程中会正确处理转义序列
+     * @return true 如果找到结束标记，读取位置移到标记之后
+     * @note 在查找过程中会正确处理转义序列；没有找到时读取位置不变，
+     *       停止的位置记在scan_offset()，追加数据后再次调用从该位置继续
      */
     bool find_end();
     
+    /**
+     * @brief 缓冲区末尾追加了数据
+     * @param length 追加的字节数，追加后的数据必须与原缓冲区连续
+     */
+    void append(size_t length) { end_ += length; }
+    
+    /**
+     * @brief 下一次find_end()开始检查的位置
+     * @return 相对于起始位置的偏移量
+     */
+    size_t scan_offset() const;
+    
     /**
      * @brief 获取可读字节数
      * @return 剩余可读的字节数
@@ -93,6 +111,7 @@ private:
     const char* begin_;     ///< 起始位置指针
     const char* end_;       ///< 结束位置指针
     const char* current_;   ///< 当前读取位置指针
+    const char* scan_;      ///< find_end()上次停止的位置，不在当前位置之后时从当前位置开始
     bool has_error_;        ///< 异常状态标志
     
     static constexpr uint8_t START_MARK1 = 0xAA;
@@ -100,6 +119,13 @@ private:
     static constexpr uint8_t END_MARK1 = 0x55;
     static constexpr uint8_t END_MARK2 = 0xAA;
     static constexpr uint8_t STUFF_BYTE = 0x00;
+    
+    /**
+     * @brief 查找[pos, end_)中第一个0xAA（marks为false）或0xAA/0x55（marks为true）
+     * @return 该字节的位置，没有时返回end_
+     * @note 按4字节一组检查，对齐不做要求
+     */
+    const char* find_mark(const char* pos, bool marks) const;
 };
 
 /**
@@ -215,12 +241,12 @@ private:
 
 // EscapingReader 实现
 inline EscapingReader::EscapingReader(const char* buffer, size_t length)
-    : begin_(buffer), end_(buffer + length), current_(buffer), has_error_(false)
+    : begin_(buffer), end_(buffer + length), current_(buffer), scan_(buffer), has_error_(false)
 {
 }
 
 inline EscapingReader::EscapingReader(const char* begin, const char* end)
-    : begin_(begin), end_(end), current_(begin), has_error_(false)
+    : begin_(begin), end_(end), current_(begin), scan_(begin), has_error_(false)
 {
 }
 
@@ -265,6 +291,7 @@ inline bool EscapingReader::seek(size_t offset)
     const char* new_pos = begin_ + offset;
     if (new_pos <= end_) {
         current_ = new_pos;
+        scan_ = new_pos; // 字节对的划分随起点改变，重新检查
         has_error_ = false;
         return true;
     }
@@ -281,11 +308,40 @@ inline bool EscapingReader::is_empty() const
     return current_ >= end_;
 }
 
+inline const char* EscapingReader::find_mark(const char* pos, bool marks) const
+{
+    // SWAR：字中等于0xAA（和0x55）的字节对应的最高位置1，最低的置位字节是准确的
+    while (end_ - pos >= 4) {
+        uint32_t word;
+        memcpy(&word, pos, sizeof(word));
+        uint32_t a = word ^ 0xAAAAAAAAU;
+        uint32_t mask = (a - 0x01010101U) & ~a;
+        if (marks) {
+            uint32_t b = word ^ 0x55555555U;
+            mask |= (b - 0x01010101U) & ~b;
+        }
+        mask &= 0x80808080U;
+        if (mask != 0) {
+            return pos + (__builtin_ctz(mask) >> 3); // 小端：低字节在前
+        }
+        pos += 4;
+    }
+    
+    while (pos < end_) {
+        uint8_t byte = static_cast<uint8_t>(*pos);
+        if (byte == START_MARK1 || (marks && byte == END_MARK1)) {
+            break;
+        }
+        ++pos;
+    }
+    return pos;
+}
+
 inline bool EscapingReader::find_start()
 {
-    while (current_ + 1 < end_) {
-        if (static_cast<uint8_t>(*current_) == START_MARK1 && 
-            static_cast<uint8_t>(*(current_ + 1)) == START_MARK2) {
+    // 0xAA之前的字节不可能是起始标记的第一个字节，直接跳过
+    while ((current_ = find_mark(current_, false)) + 1 < end_) {
+        if (static_cast<uint8_t>(*(current_ + 1)) == START_MARK2) {
             current_ += 2;
             has_error_ = false;
             return true;
@@ -298,25 +354,28 @@ inline bool EscapingReader::find_start()
 
 inline bool EscapingReader::find_end()
 {
-    const char* search_pos = current_;
+    const char* search_pos = scan_ > current_ ? scan_ : current_;
     
-    while (search_pos + 1 < end_) {
+    // 不是0xAA/0x55的字节只前进1字节，批量跳过；标记字节按字节对判断
+    while ((search_pos = find_mark(search_pos, true)) + 1 < end_) {
         uint8_t byte1 = static_cast<uint8_t>(*search_pos);
         uint8_t byte2 = static_cast<uint8_t>(*(search_pos + 1));
         
         if (byte1 == END_MARK1 && byte2 == END_MARK2) {
             current_ = search_pos + 2;
+            scan_ = current_;
             return true;
         }
         
         // 跳过转义字节
-        if (byte2 == STUFF_BYTE && (byte1 == 0xAA || byte1 == 0x55)) {
+        if (byte2 == STUFF_BYTE) {
             search_pos += 2; // 跳过原字节和转义字节
         } else {
             search_pos += 1;
         }
     }
     
+    scan_ = search_pos;
     return false;
 }
 
@@ -325,9 +384,15 @@ inline size_t EscapingReader::available() const
     return static_cast<size_t>(end_ - current_);
 }
 
+inline size_t EscapingReader::scan_offset() const
+{
+    return static_cast<size_t>((scan_ > current_ ? scan_ : current_) - begin_);
+}
+
 inline void EscapingReader::reset()
 {
     current_ = begin_;
+    scan_ = begin_;
     has_error_ = false;
 }
 
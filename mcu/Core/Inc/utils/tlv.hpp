@@ -1,18 +1,301 @@
 #ifndef TLV_HPP
 #define TLV_HPP
 
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include "utils/buffer.hpp"
 
+/**
+ * @brief TLV字段
+ * @details 格式为 | Tag (2B) | Length (2B, 小端) | Value |，
+ *          从缓冲区解析时value直接指向缓冲区中的值，不拷贝数据。
+ */
 class TLV
 {
 public:
-    uint16_t tag;
-    uint16_t length;
-    void *value;
+    uint16_t tag;    ///< 两个标签字符，tag[0]在低字节
+    uint16_t length; ///< 值长度
+    void *value;     ///< 值
 
+    TLV();
+
+    /**
+     * @brief 从缓冲区解析字段头，buf至少应有4字节
+     */
     TLV(char *buf);
     TLV(uint16_t tag, uint16_t length, void *value);
+
+    /**
+     * @brief 重新从缓冲区解析字段头，value指向buf + 4
+     */
     void read(char *buf);
+
+    /**
+     * @brief 由标签字符串得到tag值，单字符标签（如"L"）第二字节为0
+     */
+    static constexpr uint16_t make_tag(const char *name)
+    {
+        return static_cast<uint16_t>(static_cast<uint8_t>(name[0]) |
+                                     (static_cast<uint8_t>(name[0] ? name[1] : 0) << 8));
+    }
+};
+
+/**
+ * @brief TLV索引
+ * @details 构造时一次扫描缓冲区，记录同一层各字段的位置，之后按标签查找
+ *          只需遍历索引而无需重新扫描数据。嵌套TLV需对其值另建索引；
+ *          重复标签时返回第一个；字段不完整或超过MaxFields时停止索引。
+ * @tparam MaxFields 最多索引的字段数
+ */
+template <size_t MaxFields = 16>
+class TLVIndex
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param buf 缓冲区起始指针
+     * @param len 缓冲区长度
+     */
+    TLVIndex(const char *buf, size_t len)
+        : count_(0), complete_(true)
+    {
+        size_t offset = 0;
+        while (offset < len)
+        {
+            uint16_t length;
+            if (offset + 4 > len || count_ >= MaxFields)
+            {
+                complete_ = false;
+                break;
+            }
+            std::memcpy(&length, buf + offset + 2, sizeof(length));
+            if (offset + 4 + length > len)
+            {
+                complete_ = false;
+                break;
+            }
+            fields_[count_++].read(const_cast<char *>(buf + offset));
+            offset += 4 + length;
+        }
+    }
+
+    /**
+     * @brief 已索引的字段数
+     */
+    size_t size() const { return count_; }
+
+    /**
+     * @brief 是否整个缓冲区都已索引
+     */
+    bool complete() const { return complete_; }
+
+    const TLV *begin() const { return fields_; }
+    const TLV *end() const { return fields_ + count_; }
+
+    /**
+     * @brief 按标签查找字段
+     * @return 找到返回字段指针，否则返回nullptr
+     */
+    const TLV *find(uint16_t tag) const
+    {
+        for (size_t i = 0; i < count_; i++)
+        {
+            if (fields_[i].tag == tag)
+                return &fields_[i];
+        }
+        return nullptr;
+    }
+
+    const TLV *find(const char *tag) const { return find(TLV::make_tag(tag)); }
+
+    /**
+     * @brief 读取定长字段
+     * @tparam T 数据类型，字段长度必须等于sizeof(T)
+     * @return 成功返回1，失败返回-1
+     */
+    template <typename T>
+    int get(const char *tag, T &value) const
+    {
+        const uint16_t key = TLV::make_tag(tag);
+        for (size_t i = 0; i < count_; i++)
+        {
+            if (fields_[i].tag == key && fields_[i].length == sizeof(T))
+            {
+                std::memcpy(&value, fields_[i].value, sizeof(T));
+                return 1;
+            }
+        }
+        return -1;
+    }
+
+private:
+    TLV fields_[MaxFields]; ///< 已索引的字段
+    size_t count_;          ///< 字段数
+    bool complete_;         ///< 缓冲区是否全部索引
+};
+
+/**
+ * @brief 可续传的TLV解码器
+ * @details 消息分多次输入（如跨越多帧的分片），字段可以跨越输入块的边界，
+ *          不完整的字段头和短字段的值暂存在解码器中，下一块到达后继续，
+ *          不需要先把整个消息拼接在RAM中。
+ *          - 值不超过Capacity字节的字段凑齐后一次交给回调（offset为0、size等于length），
+ *            整个落在一个输入块内时直接指向输入，不拷贝；
+ *          - 更长的值（如固件数据块、规则表、校准表）按到达的片段依次交给回调，
+ *            offset为片段在值中的位置，最后一段满足offset + size == length，调用方边收边处理。
+ *          与TLVIndex相同只解码同一层的字段，嵌套TLV由回调对值另行解码。
+ * @tparam Capacity 整体交付的最大值长度
+ */
+template <size_t Capacity = 64>
+class TLVStreamDecoder
+{
+    static_assert(Capacity > 0 && Capacity <= 0xFFFF, "Capacity超出字段长度范围");
+
+public:
+    /**
+     * @brief 字段回调
+     * @param context 构造时传入的上下文
+     * @param tag 标签
+     * @param length 值的总长度
+     * @param offset 本段在值中的位置
+     * @param data 本段数据，length为0时为nullptr
+     * @param size 本段长度
+     * @return 继续解码返回true；返回false时停止，之后feed()返回-1直到reset()
+     */
+    using Handler = bool (*)(void *context, uint16_t tag, uint16_t length, uint16_t offset,
+                             const char *data, size_t size);
+
+    TLVStreamDecoder(Handler handler, void *context)
+        : handler_(handler), context_(context)
+    {
+        reset();
+    }
+
+    /**
+     * @brief 丢弃未完成的字段，从下一个字段头开始
+     */
+    void reset()
+    {
+        header_len_ = 0;
+        tag_ = 0;
+        length_ = 0;
+        offset_ = 0;
+        failed_ = false;
+    }
+
+    /**
+     * @brief 输入一块数据
+     * @return 本块中完成的字段数；回调要求停止（本次或之前）返回-1
+     */
+    int feed(const char *data, size_t len)
+    {
+        if (failed_)
+            return -1;
+
+        int fields = 0;
+        while (len > 0)
+        {
+            if (header_len_ < sizeof(header_))
+            {
+                size_t n = len < sizeof(header_) - header_len_ ? len : sizeof(header_) - header_len_;
+                std::memcpy(header_ + header_len_, data, n);
+                header_len_ += n;
+                data += n;
+                len -= n;
+                if (header_len_ < sizeof(header_))
+                    break;
+                tag_ = static_cast<uint16_t>(header_[0] | (header_[1] << 8));
+                length_ = static_cast<uint16_t>(header_[2] | (header_[3] << 8));
+                offset_ = 0;
+                if (length_ == 0)
+                {
+                    if (!finish(nullptr, 0, 0))
+                        return -1;
+                    fields++;
+                }
+                continue;
+            }
+
+            size_t n = len < static_cast<size_t>(length_ - offset_) ? len : length_ - offset_;
+            bool ok = true;
+            if (length_ > Capacity)
+            {
+                // 长字段：每段直接交给回调
+                uint16_t offset = offset_;
+                offset_ = static_cast<uint16_t>(offset_ + n);
+                ok = offset_ == length_ ? finish(data, offset, n) : emit(data, offset, n);
+            }
+            else if (offset_ == 0 && n == length_)
+            {
+                ok = finish(data, 0, n);
+            }
+            else
+            {
+                std::memcpy(value_ + offset_, data, n);
+                offset_ = static_cast<uint16_t>(offset_ + n);
+                if (offset_ == length_)
+                    ok = finish(value_, 0, length_);
+            }
+            if (!ok)
+                return -1;
+            if (header_len_ == 0)
+                fields++;
+            data += n;
+            len -= n;
+        }
+        return fields;
+    }
+
+    /**
+     * @brief 输入读取器从当前位置到末尾的全部数据，读取位置移到末尾
+     */
+    int feed(BufferReader &reader)
+    {
+        size_t available = reader.available();
+        int fields = feed(reader.current(), available);
+        reader.shift(static_cast<signed long>(available));
+        return fields;
+    }
+
+    /**
+     * @brief 是否停在字段边界（没有未完成的字段），消息结束时为false表示最后一个字段不完整
+     */
+    bool idle() const { return header_len_ == 0 && !failed_; }
+
+    /**
+     * @brief 正在接收的字段的标签和已接收的值长度（idle()为false时有效）
+     */
+    uint16_t pending_tag() const { return tag_; }
+    uint16_t pending_offset() const { return offset_; }
+
+private:
+    bool emit(const char *data, uint16_t offset, size_t size)
+    {
+        if (!handler_(context_, tag_, length_, offset, data, size))
+        {
+            failed_ = true;
+            return false;
+        }
+        return true;
+    }
+
+    // 交付字段的最后一段，回到字段边界
+    bool finish(const char *data, uint16_t offset, size_t size)
+    {
+        header_len_ = 0;
+        return emit(data, offset, size);
+    }
+
+    Handler handler_;
+    void *context_;
+    uint8_t header_[4];      ///< 未完成的字段头
+    size_t header_len_;      ///< 字段头已接收的字节数，4表示正在接收值
+    uint16_t tag_;
+    uint16_t length_;
+    uint16_t offset_;        ///< 值已接收的字节数
+    bool failed_;            ///< 回调要求停止
+    char value_[Capacity];   ///< 跨块的短字段
 };
 
-#endif // TLV_HPP
\ No newline at end of file
+#endif // TLV_HPP
@@ -0,0 +1,51 @@
+#ifndef WARM_STATE_H
+#define WARM_STATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 热复位保留的状态：放在.noinit段（链接脚本中位于.bss之后，启动代码不清零），
+// 看门狗、软件复位和NRST复位后SRAM内容不变，校验通过即沿用，采样缓存、运行统计、
+// 待写队列和通信统计不因一次复位而清空。上电（掉电）复位或校验失败时由各模块重新初始化。
+// 每块保留数据以WarmState开头，CRC覆盖其后的部分；magic按模块区分，结构改变时修改magic。
+// 新固件的.bss大小不同时保留段的地址随之改变，旧内容校验失败后丢弃
+#if defined(USE_HAL_DRIVER)
+#define WARM_STATE __attribute__((section(".noinit")))
+#else
+#define WARM_STATE
+#endif
+
+#define WARM_STATE_MAX_BLOCKS 4
+
+typedef struct {
+    uint32_t magic;
+    uint32_t size;   // 含本头部的整块大小
+    uint32_t crc;
+} WarmState;
+
+// 启动时调用一次（watchdog_init()之后、各模块恢复之前）：warm为本次复位保留了SRAM
+void warm_state_init(bool warm);
+bool warm_state_is_warm(void);
+
+// 校验size字节的保留块：热复位且magic、大小和CRC都相符时返回true，内容可以沿用；
+// 否则写入新的头部并返回false，调用方初始化其后的数据并封装
+bool warm_state_restore(WarmState *state, uint32_t magic, uint32_t size);
+
+// 按当前内容重新计算CRC（软件查表，可在临界段中调用）。
+// 封装与修改交错时CRC与内容不符，复位后该块丢弃，不会沿用半更新的内容
+void warm_state_seal(WarmState *state);
+
+// 登记由warm_state_seal_all()定期封装的块（最多WARM_STATE_MAX_BLOCKS个），
+// 用于修改频繁或在中断中修改、不便逐次封装的数据；失败返回false
+bool warm_state_register(WarmState *state);
+void warm_state_seal_all(void); // 采样任务每次采样后调用
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WARM_STATE_H
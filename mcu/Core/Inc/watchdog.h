@@ -0,0 +1,56 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 独立看门狗（IWDG，LSI时钟）监督：各任务登记签到期限，工作期间至少每个期限调用一次
+// watchdog_checkin()，阻塞等待外部事件之前调用watchdog_wait()，等待期间不检查期限。
+// 监督由软件定时器（定时器任务优先级高于所有应用任务）每WATCHDOG_KICK_MS执行一次，
+// 只在所有登记任务都按时签到时喂狗；任务卡死（死循环、1-Wire传输挂起）或
+// Error_Handler()关中断死循环后，最迟约WATCHDOG_TIMEOUT_MS系统复位。
+// 签到只是写一次时间戳，不在任务的处理路径上增加轮询。
+// F1的IWDG在STOP期间也在计数，喂狗定时器按周期把系统从STOP唤醒
+#define WATCHDOG_MAX_TASKS    8
+#define WATCHDOG_KICK_MS      2000U
+#define WATCHDOG_TIMEOUT_MS   6500U  // LSI标称40kHz时；LSI为30~60kHz，实际为4.4~8.7秒
+#define WATCHDOG_TASK_DEADLINE_MS 3000U // 各任务默认的签到期限，含一次温度转换和闪存擦除
+
+// 复位原因（RCC_CSR，启动时读取后清除）
+#define RESET_REASON_UNKNOWN    0
+#define RESET_REASON_POWER_ON   1  // 上电或掉电复位
+#define RESET_REASON_PIN        2  // NRST引脚
+#define RESET_REASON_SOFTWARE   3  // NVIC_SystemReset()
+#define RESET_REASON_WATCHDOG   4  // IWDG超时
+#define RESET_REASON_WINDOW_WATCHDOG 5
+#define RESET_REASON_LOW_POWER  6  // 非法进入待机或停止模式
+
+// 读取并清除复位原因（HAL_Init()之后、其他初始化之前调用）
+void watchdog_init(void);
+
+// 启动IWDG和监督定时器（创建任务之后、启动调度器之前调用），启动后不能停止
+void watchdog_start(void);
+
+// 登记一个任务，工作期间签到间隔不超过deadline_ms；name最多取前4个字符
+// 用于记录超时的任务。返回编号，登记已满返回-1（该任务不受监督）
+int8_t watchdog_register(const char *name, uint32_t deadline_ms);
+
+// 任务签到，同时结束等待状态；id为-1时什么也不做
+void watchdog_checkin(int8_t id);
+// 任务即将阻塞等待外部事件（不限时），下一次签到前不检查期限
+void watchdog_wait(int8_t id);
+
+// 本次启动的复位原因（RESET_REASON_*）
+uint8_t watchdog_reset_reason(void);
+// 看门狗复位前超时的任务名称，不是看门狗复位或未记录时返回false
+bool watchdog_stalled_task(char name[5]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WATCHDOG_H
@@ -1,77 +1,96 @@
 #include "DS18B20.h"
+#include "onewire.h"
+#include "onewire_pin.h"
 
 #include "stm32f1xx_hal.h"
 #include "FreeRTOS.h"
 #include "task.h"
+#include <string.h>
+#include <stdbool.h>
 
-// GPIO引脚定义
-#define DS18B20_GPIO_Port   GPIOG
-#define DS18B20_GPIO_Pin    GPIO_PIN_11
+// IO操作宏：引脚保持开漏输出（onewire_pin.h），释放总线后直接读取
+#define DS18B20_DQ_OUT_HIGH()   ONEWIRE_PIN_RELEASE()
+#define DS18B20_DQ_OUT_LOW()    ONEWIRE_PIN_LOW()
+#define DS18B20_DQ_IN()         ONEWIRE_PIN_READ()
 
-// IO操作宏
-#define DS18B20_DQ_OUT_HIGH()   HAL_GPIO_WritePin(DS18B20_GPIO_Port, DS18B20_GPIO_Pin, GPIO_PIN_SET)
-#define DS18B20_DQ_OUT_LOW()    HAL_GPIO_WritePin(DS18B20_GPIO_Port, DS18B20_GPIO_Pin, GPIO_PIN_RESET)
-#define DS18B20_DQ_IN()         HAL_GPIO_ReadPin(DS18B20_GPIO_Port, DS18B20_GPIO_Pin)
+// Dallas/Maxim CRC8（多项式x^8+x^5+x^4+1，LSB优先，即反射多项式0x8C，初值0）的单字节查找表
+// ds18b20_crc8_table[i]为单字节i的CRC
+static const uint8_t ds18b20_crc8_table[256] = {
+    0x00, 0x5E, 0xBC, 0xE2, 0x61, 0x3F, 0xDD, 0x83, 0xC2, 0x9C, 0x7E, 0x20,
+    0xA3, 0xFD, 0x1F, 0x41, 0x9D, 0xC3, 0x21, 0x7F, 0xFC, 0xA2, 0x40, 0x1E,
+    0x5F, 0x01, 0xE3, 0xBD, 0x3E, 0x60, 0x82, 0xDC, 0x23, 0x7D, 0x9F, 0xC1,
+    0x42, 0x1C, 0xFE, 0xA0, 0xE1, 0xBF, 0x5D, 0x03, 0x80, 0xDE, 0x3C, 0x62,
+    0xBE, 0xE0, 0x02, 0x5C, 0xDF, 0x81, 0x63, 0x3D, 0x7C, 0x22, 0xC0, 0x9E,
+    0x1D, 0x43, 0xA1, 0xFF, 0x46, 0x18, 0xFA, 0xA4, 0x27, 0x79, 0x9B, 0xC5,
+    0x84, 0xDA, 0x38, 0x66, 0xE5, 0xBB, 0x59, 0x07, 0xDB, 0x85, 0x67, 0x39,
+    0xBA, 0xE4, 0x06, 0x58, 0x19, 0x47, 0xA5, 0xFB, 0x78, 0x26, 0xC4, 0x9A,
+    0x65, 0x3B, 0xD9, 0x87, 0x04, 0x5A, 0xB8, 0xE6, 0xA7, 0xF9, 0x1B, 0x45,
+    0xC6, 0x98, 0x7A, 0x24, 0xF8, 0xA6, 0x44, 0x1A, 0x99, 0xC7, 0x25, 0x7B,
+    0x3A, 0x64, 0x86, 0xD8, 0x5B, 0x05, 0xE7, 0xB9, 0x8C, 0xD2, 0x30, 0x6E,
+    0xED, 0xB3, 0x51, 0x0F, 0x4E, 0x10, 0xF2, 0xAC, 0x2F, 0x71, 0x93, 0xCD,
+    0x11, 0x4F, 0xAD, 0xF3, 0x70, 0x2E, 0xCC, 0x92, 0xD3, 0x8D, 0x6F, 0x31,
+    0xB2, 0xEC, 0x0E, 0x50, 0xAF, 0xF1, 0x13, 0x4D, 0xCE, 0x90, 0x72, 0x2C,
+    0x6D, 0x33, 0xD1, 0x8F, 0x0C, 0x52, 0xB0, 0xEE, 0x32, 0x6C, 0x8E, 0xD0,
+    0x53, 0x0D, 0xEF, 0xB1, 0xF0, 0xAE, 0x4C, 0x12, 0x91, 0xCF, 0x2D, 0x73,
+    0xCA, 0x94, 0x76, 0x28, 0xAB, 0xF5, 0x17, 0x49, 0x08, 0x56, 0xB4, 0xEA,
+    0x69, 0x37, 0xD5, 0x8B, 0x57, 0x09, 0xEB, 0xB5, 0x36, 0x68, 0x8A, 0xD4,
+    0x95, 0xCB, 0x29, 0x77, 0xF4, 0xAA, 0x48, 0x16, 0xE9, 0xB7, 0x55, 0x0B,
+    0x88, 0xD6, 0x34, 0x6A, 0x2B, 0x75, 0x97, 0xC9, 0x4A, 0x14, 0xF6, 0xA8,
+    0x74, 0x2A, 0xC8, 0x96, 0x15, 0x4B, 0xA9, 0xF7, 0xB6, 0xE8, 0x0A, 0x54,
+    0xD7, 0x89, 0x6B, 0x35,
+};
 
-// 微秒时间系统实现
-__STATIC_INLINE uint32_t GXT_SYSTICK_IsActiveCounterFlag(void)
-{
-  return ((SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) == (SysTick_CTRL_COUNTFLAG_Msk));
+uint8_t DS18B20_CRC8(const uint8_t *data, uint8_t length) {
+    uint8_t crc = 0;
+    while (length--) {
+        crc = ds18b20_crc8_table[crc ^ *data++];
+    }
+    return crc;
 }
 
-static uint32_t getCurrentMicros(void)
-{
-  /* Ensure COUNTFLAG is reset by reading SysTick control and status register */
-  GXT_SYSTICK_IsActiveCounterFlag();
-  uint32_t m = HAL_GetTick();
-  const uint32_t tms = SysTick->LOAD + 1;
-  __IO uint32_t u = tms - SysTick->VAL;
-  if (GXT_SYSTICK_IsActiveCounterFlag()) {
-    m = HAL_GetTick();
-    u = tms - SysTick->VAL;
-  }
-  return (m * 1000 + (u * 1000) / tms);
+#if DS18B20_USE_TIMER
+
+// 时隙由TIM6中断产生（onewire.c），以下函数各为一次传输
+static uint8_t last_presence = 1;
+
+void DS18B20_Rst(void) {
+    last_presence = onewire_transfer(true, NULL, 0, NULL, 0);
 }
 
-//获取系统时间，单位us
-uint32_t micros(void)
-{
-  return getCurrentMicros();
+// 返回最近一次复位的存在检测结果
+// 返回1:未检测到DS18B20的存在
+// 返回0:存在
+uint8_t DS18B20_Check(void) {
+    return last_presence;
 }
 
-// 微秒延时函数（基于系统微秒计时器）
-void delay_us(uint32_t delay_time)
-{
-	uint32_t start_time = micros();
-	while((micros() - start_time) < delay_time);
+uint8_t DS18B20_Read_Bit(void) {
+    uint8_t data = 0;
+    onewire_transfer(false, NULL, 0, &data, 1);
+    return data;
 }
-// GPIO方向配置函数 - 使用HAL库方式
-static void DS18B20_IO_IN(void) {
-    GPIO_InitTypeDef GPIO_InitStruct = {0};
-    GPIO_InitStruct.Pin = DS18B20_GPIO_Pin;
-    GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
-    GPIO_InitStruct.Pull = GPIO_PULLUP;
-    HAL_GPIO_Init(DS18B20_GPIO_Port, &GPIO_InitStruct);
+
+uint8_t DS18B20_Read_Byte(void) {
+    uint8_t data = 0;
+    onewire_transfer(false, NULL, 0, &data, 8);
+    return data;
 }
 
-static void DS18B20_IO_OUT(void) {
-    GPIO_InitTypeDef GPIO_InitStruct = {0};
-    GPIO_InitStruct.Pin = DS18B20_GPIO_Pin;
-    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
-    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
-    HAL_GPIO_Init(DS18B20_GPIO_Port, &GPIO_InitStruct);
+void DS18B20_Write_Bit(uint8_t bit) {
+    uint8_t data = bit ? 1 : 0;
+    onewire_transfer(false, &data, 1, NULL, 0);
 }
 
-// 使用头文件中已定义的IO操作宏
-// #define DS18B20_DQ_OUT(x) HAL_GPIO_WritePin(DS18B20_GPIO_Port, DS18B20_GPIO_Pin, (x) ? GPIO_PIN_SET : GPIO_PIN_RESET)
-// #define DS18B20_DQ_IN()   HAL_GPIO_ReadPin(DS18B20_GPIO_Port, DS18B20_GPIO_Pin)
+void DS18B20_Write_Byte(uint8_t dat) {
+    onewire_transfer(false, &dat, 8, NULL, 0);
+}
+
+#else
 
 // 复位DS18B20
 void DS18B20_Rst(void) {
     UBaseType_t uxSavedInterruptStatus;
     
-    DS18B20_IO_OUT();           // 设置为输出模式
-    
     // 进入临界段，禁止中断和任务切换
     uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
     
@@ -91,8 +110,6 @@ uint8_t DS18B20_Check(void) {
     uint8_t retry = 0;
     UBaseType_t uxSavedInterruptStatus;
     
-    DS18B20_IO_IN(); // 设置为输入模式
-    
     // 进入临界段保护检测时序
     uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
     
@@ -127,15 +144,12 @@ uint8_t DS18B20_Read_Bit(void) {
     uint8_t data;
     UBaseType_t uxSavedInterruptStatus;
     
-    DS18B20_IO_OUT();           // 设置为输出模式
-    
     // 进入临界段保护读时序
     uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
     
     DS18B20_DQ_OUT_LOW();       // 拉低总线开始读时序
     delay_us(2);                // 延时2us
-    DS18B20_DQ_OUT_HIGH();      // 释放总线
-    DS18B20_IO_IN();            // 设置为输入模式
+    DS18B20_DQ_OUT_HIGH();      // 释放总线，之后读到的是从机驱动的电平
     delay_us(11);               // 延时12us后读取数据
     
     if (DS18B20_DQ_IN()) data = 1;
@@ -161,58 +175,149 @@ uint8_t DS18B20_Read_Byte(void) {
     return dat;
 }
 
-// 写一个字节到DS18B20
-// dat：要写入的字节
-void DS18B20_Write_Byte(uint8_t dat) {
-    uint8_t j;
-    uint8_t testb;
+// 写一个位到DS18B20
+// bit：1/0
+void DS18B20_Write_Bit(uint8_t bit) {
     UBaseType_t uxSavedInterruptStatus;
     
-    DS18B20_IO_OUT(); // 设置为输出模式
+    // 每个位的写入都需要临界段保护
+    uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
     
-    for (j = 1; j <= 8; j++) {
-        testb = dat & 0x01;
+    if (bit) {                  // 写1
+        DS18B20_DQ_OUT_LOW();   // 拉低总线
+        delay_us(2);            // 拉低2us
+        DS18B20_DQ_OUT_HIGH();  // 释放总线
+        delay_us(60);           // 保持60us
+    } else {                    // 写0
+        DS18B20_DQ_OUT_LOW();   // 拉低总线
+        delay_us(60);           // 拉低60us
+        DS18B20_DQ_OUT_HIGH();  // 释放总线
+        delay_us(2);            // 延时2us
+    }
+    
+    // 退出临界段
+    taskEXIT_CRITICAL_FROM_ISR(uxSavedInterruptStatus);
+}
+
+// 写一个字节到DS18B20
+// dat：要写入的字节
+void DS18B20_Write_Byte(uint8_t dat) {
+    for (uint8_t j = 1; j <= 8; j++) {
+        DS18B20_Write_Bit(dat & 0x01); // LSB first
         dat = dat >> 1;
-        
-        // 每个位的写入都需要临界段保护
-        uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
-        
-        if (testb) { // 写1
-            DS18B20_DQ_OUT_LOW();   // 拉低总线
-            delay_us(2);            // 拉低2us
-            DS18B20_DQ_OUT_HIGH();  // 释放总线
-            delay_us(60);           // 保持60us
-        } else {                    // 写0
-            DS18B20_DQ_OUT_LOW();   // 拉低总线
-            delay_us(60);           // 拉低60us
-            DS18B20_DQ_OUT_HIGH();  // 释放总线
-            delay_us(2);            // 延时2us
-        }
-        
-        // 退出临界段
-        taskEXIT_CRITICAL_FROM_ISR(uxSavedInterruptStatus);
     }
 }
 
-// 开始温度转换
-void DS18B20_Start(void) {
-    DS18B20_Rst();              // 复位DS18B20
-    if (DS18B20_Check() == 0) { // 检查DS18B20是否存在
-        DS18B20_Write_Byte(0xCC); // 跳过ROM命令
-        DS18B20_Write_Byte(0x44); // 开始温度转换命令
+#endif // DS18B20_USE_TIMER
+
+// 一条命令：复位并检测存在，寻址（rom为NULL时跳过ROM，否则匹配ROM），
+// 写入cmd_len字节，再读取rx_len字节；定时器后端下整条命令为一次传输
+// 返回1:不存在
+// 返回0:成功
+static uint8_t DS18B20_Command(const uint8_t *rom, const uint8_t *cmd, uint8_t cmd_len,
+                               uint8_t *rx, uint8_t rx_len) {
+    uint8_t tx[1 + DS18B20_ROM_SIZE + DS18B20_MAX_CMD_SIZE];
+    uint8_t tx_len = 0;
+    
+    if (rom == NULL) {
+        tx[tx_len++] = 0xCC;           // 跳过ROM
+    } else {
+        tx[tx_len++] = 0x55;           // 匹配ROM
+        memcpy(tx + tx_len, rom, DS18B20_ROM_SIZE);
+        tx_len += DS18B20_ROM_SIZE;
+    }
+    memcpy(tx + tx_len, cmd, cmd_len);
+    tx_len += cmd_len;
+    
+#if DS18B20_USE_TIMER
+    return onewire_transfer(true, tx, tx_len * 8U, rx, rx_len * 8U);
+#else
+    DS18B20_Rst();
+    if (DS18B20_Check() != 0) {
+        return 1;
+    }
+    for (uint8_t i = 0; i < tx_len; i++) {
+        DS18B20_Write_Byte(tx[i]);
+    }
+    for (uint8_t i = 0; i < rx_len; i++) {
+        rx[i] = DS18B20_Read_Byte();
     }
+    return 0;
+#endif
+}
+
+// 开始温度转换（跳过ROM，总线上所有传感器同时转换）
+// 返回1:不存在
+// 返回0:成功
+uint8_t DS18B20_Start(void) {
+    static const uint8_t cmd[] = { 0x44 }; // 开始温度转换
+    return DS18B20_Command(NULL, cmd, sizeof(cmd), NULL, 0);
+}
+
+// 搜索ROM（Maxim AN187）：每轮复位后发0xF0，逐位读取位与补码，
+// 冲突位按上一轮的分支点选择方向，直到没有未走过的分支
+// 返回值：找到的传感器数（最多max_count个，按ROM码从低位起的二叉树顺序）
+uint8_t DS18B20_Search(uint8_t (*roms)[DS18B20_ROM_SIZE], uint8_t max_count) {
+    uint8_t rom[DS18B20_ROM_SIZE] = {0};
+    int8_t last_discrepancy = -1;      // 上一轮最后一个选0的冲突位，-1表示无
+    uint8_t count = 0;
+    
+    do {
+        DS18B20_Rst();
+        if (DS18B20_Check() != 0) {
+            break;                     // 总线上没有器件
+        }
+        DS18B20_Write_Byte(0xF0);      // 搜索ROM
+        
+        int8_t discrepancy = -1;
+        for (uint8_t bit = 0; bit < DS18B20_ROM_SIZE * 8; bit++) {
+            uint8_t id = DS18B20_Read_Bit();
+            uint8_t cmp = DS18B20_Read_Bit();
+            uint8_t mask = (uint8_t)(1U << (bit & 7));
+            uint8_t dir;
+            
+            if (id && cmp) {
+                return count;          // 无器件应答，搜索中止
+            }
+            if (id != cmp) {
+                dir = id;              // 所有器件该位相同
+            } else if ((int8_t)bit < last_discrepancy) {
+                dir = (rom[bit >> 3] & mask) != 0; // 沿用上一轮的选择
+            } else {
+                dir = ((int8_t)bit == last_discrepancy); // 上一轮分支点这次走1
+            }
+            if (id == cmp && dir == 0) {
+                discrepancy = (int8_t)bit;
+            }
+            
+            if (dir) {
+                rom[bit >> 3] |= mask;
+            } else {
+                rom[bit >> 3] &= (uint8_t)~mask;
+            }
+            DS18B20_Write_Bit(dir);    // 方向不符的器件退出本轮
+        }
+        
+        // ROM码最后一字节为前7字节的CRC，校验失败的不记录，继续搜索其余分支
+        if (DS18B20_CRC8(rom, DS18B20_ROM_SIZE) == 0) {
+            memcpy(roms[count++], rom, DS18B20_ROM_SIZE);
+        }
+        last_discrepancy = discrepancy;
+    } while (last_discrepancy >= 0 && count < max_count);
+    
+    return count;
 }
 
 // 初始化DS18B20的IO口，同时检测DS的存在
 // 返回1:不存在
 // 返回0:存在
 uint8_t DS18B20_Init(void) {
-    // 使能GPIOG时钟
-    __HAL_RCC_GPIOG_CLK_ENABLE();
-    
-    // 初始化GPIO为推挽输出
-    DS18B20_IO_OUT();
-    DS18B20_DQ_OUT_HIGH(); // 初始状态拉高
+#if DS18B20_USE_TIMER
+    onewire_init();
+#else
+    // 开漏输出并释放总线，此后收发都不再重新配置引脚
+    onewire_pin_init();
+#endif
     
     DS18B20_Rst();         // 复位DS18B20
     return DS18B20_Check(); // 检查DS18B20是否存在
@@ -220,39 +325,96 @@ uint8_t DS18B20_Init(void) {
 
 // 从DS18B20得到温度值
 // 精度：0.1°C
-// 返回值：温度值 （-550~1250，单位：0.1°C）
+// 返回值：温度值 （-550~1250，单位：0.1°C），读取失败返回-1000
 short DS18B20_Get_Temp(void) {
-    uint8_t temp;
-    uint8_t TL, TH;
-    short tem;
+    int16_t raw = DS18B20_Get_Temp_Raw(NULL);
+    if (raw == DS18B20_TEMP_INVALID_RAW) {
+        return -1000; // 读取失败返回错误值
+    }
+    return DS18B20_Raw_To_Deci(raw);
+}
+
+// 读取原始温度（1/16°C，二进制补码），rom为NULL时跳过ROM，否则只读取该ROM码的传感器
+// 低于12位分辨率时暂存器中未定义的低位清零
+// 返回值：-880~2000，读取失败返回DS18B20_TEMP_INVALID_RAW
+int16_t DS18B20_Get_Temp_Raw(const uint8_t *rom) {
+    uint8_t data[DS18B20_SCRATCHPAD_SIZE];
     
+    // 读取整个暂存器并校验CRC，总线干扰导致的错误读数不返回
+    if (DS18B20_Read_Scratchpad(rom, data) != 0) {
+        return DS18B20_TEMP_INVALID_RAW;
+    }
     
-    DS18B20_Rst();                     // 复位DS18B20
-    if (DS18B20_Check() == 0) {        // 检查DS18B20是否存在
-        DS18B20_Write_Byte(0xCC);      // 跳过ROM命令
-        DS18B20_Write_Byte(0xBE);      // 读暂存器命令
-        TL = DS18B20_Read_Byte();      // LSB
-        TH = DS18B20_Read_Byte();      // MSB
-        
-        if (TH > 7) {                  // 负温度处理
-            TH = ~TH;
-            TL = ~TL;
-            temp = 0;                  // 标记为负温度
-        } else {
-            temp = 1;                  // 标记为正温度
+    // 温度寄存器本身就是补码，直接拼接即可，负温度无需取反
+    int16_t raw = (int16_t)(((uint16_t)data[1] << 8) | data[0]);
+    uint8_t undefined_bits = 12 - DS18B20_CONFIG_BITS(data[4]);
+    raw &= (int16_t)~((1U << undefined_bits) - 1U);
+    return raw;
+}
+
+// 暂存器是否完整：CRC正确，且配置寄存器的固定位为1
+// （总线被拉低时读到全0，CRC也为0，靠固定位区分）
+static bool DS18B20_Scratchpad_Valid(const uint8_t *data) {
+    return DS18B20_CRC8(data, DS18B20_SCRATCHPAD_SIZE) == 0 &&
+           (data[4] & 0x9F) == 0x1F;
+}
+
+// 读取暂存器全部9字节：温度LSB/MSB、TH、TL、配置、保留×3、CRC
+// rom为NULL时跳过ROM，否则只读取该ROM码的传感器；CRC错误时重读一次
+// 返回1:不存在或CRC错误
+// 返回0:成功
+uint8_t DS18B20_Read_Scratchpad(const uint8_t *rom, uint8_t *data) {
+    static const uint8_t cmd[] = { 0xBE }; // 读暂存器
+    for (uint8_t attempt = 0; attempt < 2; attempt++) {
+        if (DS18B20_Command(rom, cmd, sizeof(cmd), data, DS18B20_SCRATCHPAD_SIZE) != 0) {
+            return 1;
         }
-        
-        tem = TH;                      // 获得高八位
-        tem <<= 8;
-        tem += TL;                     // 获得低八位
-        tem = (float)tem * 0.625;      // 转换为实际温度值（0.1°C精度）
-        
-        if (temp) return tem;          // 返回正温度值
-        else return -tem;              // 返回负温度值
+        if (DS18B20_Scratchpad_Valid(data)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 设置分辨率（9~12位），TH/TL保持不变，写入后复制到EEPROM掉电保存
+// 返回1:不存在或参数错误
+// 返回0:成功
+uint8_t DS18B20_Set_Resolution(const uint8_t *rom, uint8_t bits) {
+    uint8_t scratchpad[DS18B20_SCRATCHPAD_SIZE];
+    
+    if (bits < 9 || bits > 12) {
+        return 1;
+    }
+    if (DS18B20_Read_Scratchpad(rom, scratchpad) != 0) {
+        return 1;
+    }
+    
+    // 写暂存器：TH、TL、配置
+    uint8_t write_cmd[] = { 0x4E, scratchpad[2], scratchpad[3], DS18B20_CONFIG(bits) };
+    if (DS18B20_Command(rom, write_cmd, sizeof(write_cmd), NULL, 0) != 0) {
+        return 1;
+    }
+    
+    // 复制暂存器到EEPROM
+    static const uint8_t copy_cmd[] = { 0x48 };
+    if (DS18B20_Command(rom, copy_cmd, sizeof(copy_cmd), NULL, 0) != 0) {
+        return 1;
     }
+    delay_us(10000);                   // EEPROM写入时间10ms
+    return 0;
+}
+
+// 从配置寄存器读取当前分辨率
+// 返回值：9~12，读取失败返回0
+uint8_t DS18B20_Get_Resolution(const uint8_t *rom) {
+    uint8_t scratchpad[DS18B20_SCRATCHPAD_SIZE];
     
-    return -1000; // 读取失败返回错误值
+    if (DS18B20_Read_Scratchpad(rom, scratchpad) != 0) {
+        return 0;
+    }
+    return DS18B20_CONFIG_BITS(scratchpad[4]);
 }
+
 void DS18B20_Tem_Transfer(void){
     DS18B20_Start();                   // 开始温度转换
     delay_us(750000);                  // 等待转换完成（750ms）
@@ -0,0 +1,31 @@
+#include "admission.h"
+
+static void refill(AdmissionBucket *bucket, uint32_t now) {
+    uint32_t tokens = (now - bucket->refill_tick) / ADMISSION_REFILL_MS;
+    if (tokens >= (uint32_t)(ADMISSION_BURST - bucket->tokens)) {
+        // 桶已满：从现在起重新计时，空闲期间不积攒超过容量的令牌
+        bucket->tokens = ADMISSION_BURST;
+        bucket->refill_tick = now;
+    } else {
+        bucket->tokens = (int16_t)(bucket->tokens + (int16_t)tokens);
+        bucket->refill_tick += tokens * ADMISSION_REFILL_MS;
+    }
+}
+
+void admission_reset(AdmissionBucket *bucket, uint32_t now) {
+    bucket->tokens = ADMISSION_BURST;
+    bucket->refill_tick = now;
+}
+
+uint32_t admission_request(AdmissionBucket *bucket, bool bulk, uint32_t now) {
+    refill(bucket, now);
+    int16_t cost = bulk ? ADMISSION_BULK_COST : 1;
+    int16_t floor = bulk ? 0 : -ADMISSION_RESERVE;
+    if (bucket->tokens - cost >= floor) {
+        bucket->tokens = (int16_t)(bucket->tokens - cost);
+        return 0;
+    }
+    uint32_t needed = (uint32_t)(floor + cost - bucket->tokens);
+    uint32_t wait = needed * ADMISSION_REFILL_MS - (now - bucket->refill_tick);
+    return wait != 0 ? wait : 1;
+}
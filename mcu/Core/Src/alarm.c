@@ -0,0 +1,419 @@
+#include "device_control.h"
+#include "main.h"
+#include "config_store.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <string.h>
+#include <assert.h>
+
+// 报警系统实现（接口见device_control.h），不访问硬件，输出经buzzer_*/led_*，
+// 事件经log_store_append()写入日志，主机测试（host/test_alarm.c）直接编译本文件。
+// 规则按字段分别存放（结构数组），检查时对全部规则和传感器做同样的比较，
+// 不按规则分支；状态按位保存，只有状态变化的规则才逐条处理
+static_assert(MAX_ALARMS <= 32, "报警状态按32位掩码保存");
+static_assert(TEMP_MAX_SENSORS <= 8, "规则的传感器按8位掩码保存");
+static_assert(TEMP_MAX_SENSORS <= LOG_STORE_MAX_SENSORS, "采样记录的传感器编号超出日志格式");
+
+#define ALARM_SLOPE_LIMIT 32767 // 相邻两次读数的斜率按int16范围限幅（0.1°C/分钟）
+// 平均后的斜率比0.1°C/分钟多保留的小数位：每秒采样、窗口长达数分钟时每次的修正远小于0.1°C/分钟，
+// 没有小数位时修正被截断为0，斜率停在0附近；限幅后的斜率加上小数位仍在int32内
+#define ALARM_SLOPE_FRACTION_BITS 10
+#define ALARM_ALPHA_BITS 24 // 指数平均的系数的定点位数：每秒采样、窗口65535秒时系数仍为256
+
+static int16_t alarm_low[MAX_ALARMS];
+static int16_t alarm_high[MAX_ALARMS];
+static int16_t alarm_hysteresis[MAX_ALARMS];
+static int16_t alarm_rate[MAX_ALARMS];
+static uint16_t alarm_delay_s[MAX_ALARMS];
+static uint16_t alarm_window_s[MAX_ALARMS];
+static uint16_t alarm_horizon_s[MAX_ALARMS];
+static uint8_t alarm_sensor_select[MAX_ALARMS]; // 配置的传感器编号或ALARM_SENSOR_ANY
+static uint8_t alarm_sensor_mask[MAX_ALARMS];   // 规则检查的传感器（bit s = 传感器s）
+static uint8_t alarm_actions[MAX_ALARMS];
+static uint32_t alarm_enabled_mask = 0;
+
+static volatile uint32_t alarm_active_mask = 0; // 采样任务修改，通信任务读取
+static uint32_t alarm_pending_mask = 0;         // 已超限、等待持续时间的规则
+static uint32_t alarm_pending_since[MAX_ALARMS];
+static uint8_t alarm_sensor[MAX_ALARMS];        // 各规则进入报警时超限的传感器
+static uint8_t alarm_output_actions = 0;        // 当前执行中的动作
+
+// 各规则对各传感器的温度变化斜率（0.1°C/分钟 << ALARM_SLOPE_FRACTION_BITS）：
+// 相邻两次读数的斜率按规则的窗口做指数平均，每次采样O(1)更新，不保存历史读数
+static int32_t alarm_slope[MAX_ALARMS][TEMP_MAX_SENSORS];
+static int16_t alarm_previous[TEMP_MAX_SENSORS];
+static uint32_t alarm_previous_tick = 0;
+
+static void alarm_store_config(const AlarmConfig *config) {
+    uint8_t i = config->id;
+    alarm_low[i] = config->low_temp;
+    alarm_high[i] = config->high_temp;
+    alarm_hysteresis[i] = config->hysteresis;
+    alarm_rate[i] = config->rate;
+    alarm_delay_s[i] = config->delay_s;
+    alarm_window_s[i] = config->window_s;
+    alarm_horizon_s[i] = config->horizon_s;
+    alarm_sensor_select[i] = config->sensor;
+    alarm_sensor_mask[i] = (config->sensor < TEMP_MAX_SENSORS) ? (uint8_t)(1U << config->sensor)
+                                                               : (uint8_t)((1U << TEMP_MAX_SENSORS) - 1);
+    alarm_actions[i] = config->actions;
+    if (config->enabled) {
+        alarm_enabled_mask |= 1UL << i;
+    } else {
+        alarm_enabled_mask &= ~(1UL << i);
+    }
+}
+
+bool alarm_config_valid(const AlarmConfig *config) {
+    // 回差不能让解除范围为空
+    return config->id < MAX_ALARMS &&
+           config->low_temp < config->high_temp &&
+           config->hysteresis >= 0 &&
+           (int32_t)config->hysteresis * 2 < (int32_t)config->high_temp - config->low_temp &&
+           (config->sensor < TEMP_MAX_SENSORS || config->sensor == ALARM_SENSOR_ANY) &&
+           config->rate >= 0 &&
+           (config->actions & ~ALARM_ACTIONS_ALL) == 0 &&
+           config->enabled <= 1;
+}
+
+// 调度器启动前调用，不进入临界段；有保存的规则表时加载，否则使用默认规则
+void alarm_init(void) {
+    config_store_init();
+    uint16_t saved_length = 0;
+    const uint8_t *saved = config_store_find(CONFIG_KEY_ALARMS, &saved_length);
+    
+    // 默认规则0为蜂鸣器、规则1为LED，任一传感器超出-40.0~80.0°C时报警
+    for (int i = 0; i < MAX_ALARMS; i++) {
+        AlarmConfig config = {
+            .id = (uint8_t)i,
+            .low_temp = -400,
+            .high_temp = 800,
+            .sensor = ALARM_SENSOR_ANY,
+            .actions = (i == 0) ? ALARM_ACTION_BUZZER : (i == 1) ? ALARM_ACTION_LED : 0,
+            .enabled = (i < 2),
+        };
+        if (saved) {
+            AlarmConfig stored;
+            memcpy(&stored, saved + (size_t)i * sizeof(AlarmConfig), sizeof(stored));
+            if (stored.id == i && alarm_config_valid(&stored)) { // 不合法的规则使用默认值
+                config = stored;
+            }
+        }
+        alarm_store_config(&config);
+    }
+    for (int s = 0; s < TEMP_MAX_SENSORS; s++) {
+        alarm_previous[s] = TEMP_INVALID;
+    }
+    memset(alarm_slope, 0, sizeof(alarm_slope));
+}
+
+// 配置由通信任务修改、采样任务检查，复制时进入临界段，检查时不会看到一半的配置
+void alarm_set_config(const AlarmConfig *config) {
+    if (config->id >= MAX_ALARMS) {
+        return;
+    }
+    taskENTER_CRITICAL();
+    alarm_store_config(config);
+    taskEXIT_CRITICAL();
+}
+
+void alarm_get_config(uint8_t alarm_id, AlarmConfig *config) {
+    if (alarm_id >= MAX_ALARMS || !config) {
+        return;
+    }
+    taskENTER_CRITICAL();
+    config->id = alarm_id;
+    config->low_temp = alarm_low[alarm_id];
+    config->high_temp = alarm_high[alarm_id];
+    config->hysteresis = alarm_hysteresis[alarm_id];
+    config->rate = alarm_rate[alarm_id];
+    config->delay_s = alarm_delay_s[alarm_id];
+    config->window_s = alarm_window_s[alarm_id];
+    config->horizon_s = alarm_horizon_s[alarm_id];
+    config->sensor = alarm_sensor_select[alarm_id];
+    config->actions = alarm_actions[alarm_id];
+    config->enabled = (alarm_enabled_mask >> alarm_id) & 1U;
+    taskEXIT_CRITICAL();
+}
+
+// 报警通知队列：采样任务放入、通信任务取出，都在临界段中
+static AlarmEvent alarm_notify_queue[ALARM_NOTIFY_QUEUE_LEN];
+static uint8_t alarm_notify_head = 0;  // 最早的通知
+static uint8_t alarm_notify_count = 0;
+
+static void alarm_notify_push(const AlarmEvent *event) {
+    taskENTER_CRITICAL();
+    if (alarm_notify_count < ALARM_NOTIFY_QUEUE_LEN) {
+        alarm_notify_queue[(alarm_notify_head + alarm_notify_count) % ALARM_NOTIFY_QUEUE_LEN] = *event;
+        alarm_notify_count++;
+    }
+    taskEXIT_CRITICAL();
+}
+
+bool alarm_notify_pending(void) {
+    return alarm_notify_count != 0;
+}
+
+bool alarm_notify_pop(AlarmEvent *event) {
+    bool found = false;
+    taskENTER_CRITICAL();
+    if (alarm_notify_count != 0) {
+        *event = alarm_notify_queue[alarm_notify_head];
+        alarm_notify_head = (alarm_notify_head + 1) % ALARM_NOTIFY_QUEUE_LEN;
+        alarm_notify_count--;
+        found = true;
+    }
+    taskEXIT_CRITICAL();
+    return found;
+}
+
+// 报警前后记录：只由采样任务访问
+static_assert(ALARM_BURST_SAMPLES % LOG_BURST_CHUNK_SAMPLES == 0 && ALARM_BURST_CHUNKS <= LOG_BURST_CHUNK_MASK + 1,
+              "报警前后记录的分块超出块号");
+typedef enum {
+    ALARM_BURST_IDLE,
+    ALARM_BURST_TRIGGERED, // 本次采样放入环形缓冲后冻结
+    ALARM_BURST_CAPTURING, // 收集触发之后的读数，逐块追加
+} AlarmBurstState;
+
+static int16_t alarm_burst_ring[ALARM_BURST_PRE_SAMPLES][TEMP_MAX_SENSORS];
+static uint8_t alarm_burst_head = 0;  // 下一次采样的位置，缓冲已满时即最早的一次
+static uint8_t alarm_burst_fill = 0;
+static AlarmBurstState alarm_burst_state = ALARM_BURST_IDLE;
+static uint64_t alarm_burst_time_ms;
+static LogBurstPayload alarm_burst_header; // channel、sensor和chunk的ENTER标志
+static uint8_t alarm_burst_collected;      // samples中已有的读数
+static uint8_t alarm_burst_appended;       // 已追加的块数
+static int16_t alarm_burst_samples[ALARM_BURST_SAMPLES];
+
+static void alarm_burst_trigger(uint8_t channel, uint8_t type, uint8_t sensor, uint64_t timestamp_ms) {
+    if (alarm_burst_state != ALARM_BURST_IDLE) {
+        return;
+    }
+    alarm_burst_time_ms = timestamp_ms;
+    alarm_burst_header.channel = channel;
+    alarm_burst_header.sensor = sensor;
+    alarm_burst_header.chunk = (type == ALARM_EVENT_ENTER) ? LOG_BURST_ENTER : 0U;
+    alarm_burst_state = ALARM_BURST_TRIGGERED;
+}
+
+void alarm_burst_sample(const int16_t *temperatures, uint8_t count) {
+    int16_t *row = alarm_burst_ring[alarm_burst_head];
+    for (uint8_t s = 0; s < TEMP_MAX_SENSORS; s++) {
+        row[s] = (s < count) ? temperatures[s] : TEMP_INVALID;
+    }
+    alarm_burst_head = (uint8_t)((alarm_burst_head + 1U) % ALARM_BURST_PRE_SAMPLES);
+    if (alarm_burst_fill < ALARM_BURST_PRE_SAMPLES) {
+        alarm_burst_fill++;
+    }
+    
+    uint8_t sensor = alarm_burst_header.sensor;
+    if (alarm_burst_state == ALARM_BURST_TRIGGERED) {
+        // 按时间顺序复制，最后一个为本次（触发时）的读数；上电后不足的部分为TEMP_INVALID
+        for (uint8_t i = 0; i < ALARM_BURST_PRE_SAMPLES; i++) {
+            alarm_burst_samples[i] = (i < ALARM_BURST_PRE_SAMPLES - alarm_burst_fill || sensor >= TEMP_MAX_SENSORS)
+                ? TEMP_INVALID
+                : alarm_burst_ring[(alarm_burst_head + i) % ALARM_BURST_PRE_SAMPLES][sensor];
+        }
+        alarm_burst_collected = ALARM_BURST_PRE_SAMPLES;
+        alarm_burst_appended = 0;
+        alarm_burst_state = ALARM_BURST_CAPTURING;
+    } else if (alarm_burst_state == ALARM_BURST_CAPTURING && alarm_burst_collected < ALARM_BURST_SAMPLES) {
+        alarm_burst_samples[alarm_burst_collected++] = (sensor < count) ? temperatures[sensor] : TEMP_INVALID;
+    }
+    if (alarm_burst_state != ALARM_BURST_CAPTURING ||
+        alarm_burst_appended >= alarm_burst_collected / LOG_BURST_CHUNK_SAMPLES) {
+        return;
+    }
+    
+    // 每次最多追加一块：触发前的各块在收集期间陆续写入，最后一块随最后一个读数写入；
+    // 队列满时下一次采样重试
+    LogBurstPayload chunk = alarm_burst_header;
+    chunk.chunk |= alarm_burst_appended;
+    if (alarm_burst_appended == ALARM_BURST_CHUNKS - 1U) {
+        chunk.chunk |= LOG_BURST_LAST;
+    }
+    memcpy(chunk.temperatures, &alarm_burst_samples[alarm_burst_appended * LOG_BURST_CHUNK_SAMPLES],
+           sizeof(chunk.temperatures));
+    if (log_store_append(LOG_STREAM_BURSTS, alarm_burst_time_ms, &chunk) &&
+        ++alarm_burst_appended == ALARM_BURST_CHUNKS) {
+        alarm_burst_state = ALARM_BURST_IDLE;
+    }
+}
+
+static void alarm_log_event(uint8_t channel, uint8_t type, const int16_t *temperatures, uint8_t count) {
+    uint8_t sensor = alarm_sensor[channel];
+    uint64_t timestamp_ms = rtc_get_timestamp_ms();
+    LogEventPayload event = {
+        .channel = channel,
+        .type = type,
+        .sensor = sensor,
+        .temperature = (sensor < count) ? temperatures[sensor] : TEMP_INVALID,
+    };
+    log_store_append(LOG_STREAM_EVENTS, timestamp_ms, &event);
+    alarm_burst_trigger(channel, type, sensor, timestamp_ms);
+    
+    AlarmEvent notify = {
+        .timestamp = (uint32_t)(timestamp_ms / 1000U),
+        .sequence = 0,
+        .millisecond = (uint16_t)(timestamp_ms % 1000U),
+        .channel = channel,
+        .type = type,
+        .sensor = sensor,
+        .temperature = event.temperature,
+    };
+    alarm_notify_push(&notify);
+}
+
+// 按报警中的规则的动作之和更新输出，只切换有变化的动作
+static void alarm_update_outputs(uint32_t active_mask) {
+    uint8_t actions = 0;
+    for (uint32_t mask = active_mask; mask != 0; mask &= mask - 1) {
+        actions |= alarm_actions[__builtin_ctz(mask)];
+    }
+    
+    uint8_t changed = actions ^ alarm_output_actions;
+    if (changed & ALARM_ACTION_BUZZER) {
+        if (actions & ALARM_ACTION_BUZZER) {
+            buzzer_on();
+        } else {
+            buzzer_off();
+        }
+    }
+    if (changed & ALARM_ACTION_LED) {
+        if (actions & ALARM_ACTION_LED) {
+            led_on();
+        } else {
+            led_off();
+        }
+    }
+    alarm_output_actions = actions;
+}
+
+static inline int32_t alarm_clamp_slope(int64_t slope) {
+    return slope > ALARM_SLOPE_LIMIT ? ALARM_SLOPE_LIMIT : slope < -ALARM_SLOPE_LIMIT ? -ALARM_SLOPE_LIMIT : slope;
+}
+
+void alarm_check_temperatures(const int16_t *temperatures, uint8_t count) {
+    uint32_t now = HAL_GetTick();
+    uint32_t elapsed = now - alarm_previous_tick;
+    alarm_previous_tick = now;
+    
+    // 各传感器相邻两次读数的斜率，读取失败（本次或上次）的传感器不参与检查
+    int16_t value[TEMP_MAX_SENSORS];
+    int32_t step_slope[TEMP_MAX_SENSORS];
+    uint8_t valid = 0;     // 本次读取成功
+    uint8_t has_step = 0;  // 本次和上次都读取成功
+    for (uint8_t s = 0; s < TEMP_MAX_SENSORS; s++) {
+        int16_t t = (s < count) ? temperatures[s] : TEMP_INVALID;
+        value[s] = (t != TEMP_INVALID) ? t : 0;
+        valid |= (uint8_t)((t != TEMP_INVALID) << s);
+        step_slope[s] = 0;
+        if (t != TEMP_INVALID && alarm_previous[s] != TEMP_INVALID && elapsed > 0) {
+            step_slope[s] = alarm_clamp_slope((int64_t)(t - alarm_previous[s]) * 60000 / elapsed);
+            has_step |= (uint8_t)(1U << s);
+        }
+        alarm_previous[s] = t;
+    }
+    
+    // 全部规则对全部传感器的超限和解除条件，结果按位汇总：
+    // 超出[L, H]、预测horizon秒后超出[L, H]、斜率绝对值超过rate都算超限
+    uint32_t exceeded = 0;
+    uint32_t cleared = 0;
+    uint8_t hit[MAX_ALARMS];
+    taskENTER_CRITICAL();
+    uint32_t enabled = alarm_enabled_mask;
+    for (uint8_t i = 0; i < MAX_ALARMS; i++) {
+        int32_t low = alarm_low[i];
+        int32_t high = alarm_high[i];
+        int32_t leave_low = low + alarm_hysteresis[i];
+        int32_t leave_high = high - alarm_hysteresis[i];
+        int32_t rate_limit = alarm_rate[i];
+        uint32_t rate_on = (uint32_t)(rate_limit > 0);
+        int32_t horizon = alarm_horizon_s[i];
+        // 指数平均的系数（ALARM_ALPHA_BITS位定点数）：dt / 窗口，窗口为0或短于采样间隔时直接取相邻两次的斜率
+        uint32_t window_ms = (uint32_t)alarm_window_s[i] * 1000U;
+        int32_t alpha = (window_ms > elapsed) ? (int32_t)(((uint64_t)elapsed << ALARM_ALPHA_BITS) / window_ms)
+                                              : (int32_t)(1L << ALARM_ALPHA_BITS);
+        uint8_t sensors = alarm_sensor_mask[i] & valid;
+        uint8_t outside_mask = 0;
+        uint8_t inside_mask = 0;
+        
+        for (uint8_t s = 0; s < TEMP_MAX_SENSORS; s++) {
+            // 修正量四舍五入（算术右移前加半个单位），上升和下降对称，回到平稳后衰减到0。
+            // 差值不超过2^26、系数不超过2^24，乘积按int64计算
+            int32_t slope = alarm_slope[i][s];
+            int32_t gap = step_slope[s] * (1 << ALARM_SLOPE_FRACTION_BITS) - slope;
+            slope += (int32_t)(((int64_t)gap * alpha + (1LL << (ALARM_ALPHA_BITS - 1))) >> ALARM_ALPHA_BITS);
+            slope = ((has_step >> s) & 1U) ? slope : 0;
+            alarm_slope[i][s] = slope;
+            
+            // 只在预测和比较速率时去掉小数位：预测值不超过32767 × 65535 / 60，在int32内
+            int32_t t = value[s];
+            int32_t predicted = t + (int32_t)((int64_t)slope * horizon / (60 << ALARM_SLOPE_FRACTION_BITS));
+            int32_t magnitude = ((slope < 0 ? -slope : slope) + (1 << (ALARM_SLOPE_FRACTION_BITS - 1))) >>
+                                ALARM_SLOPE_FRACTION_BITS;
+            uint32_t rate_over = rate_on & (uint32_t)(magnitude > rate_limit);
+            uint32_t outside = (uint32_t)(t < low) | (uint32_t)(t > high) |
+                               (uint32_t)(predicted < low) | (uint32_t)(predicted > high) | rate_over;
+            uint32_t inside = (uint32_t)(t >= leave_low) & (uint32_t)(t <= leave_high) &
+                              (uint32_t)(predicted >= leave_low) & (uint32_t)(predicted <= leave_high) &
+                              (rate_over ^ 1U);
+            outside_mask |= (uint8_t)(outside << s);
+            inside_mask |= (uint8_t)(inside << s);
+        }
+        
+        // 解除要求进入报警时超限的传感器读取成功，且规则的全部有效读数都在解除范围内；
+        // 传感器读取失败（掉线）时保持报警，不会因为没有读数而解除
+        uint8_t required = sensors | (uint8_t)(1U << alarm_sensor[i]);
+        hit[i] = outside_mask & sensors;
+        exceeded |= (uint32_t)(hit[i] != 0) << i;
+        cleared |= (uint32_t)((inside_mask & valid & required) == required) << i;
+    }
+    taskEXIT_CRITICAL();
+    
+    uint32_t active = alarm_active_mask;
+    uint32_t leaving = active & (cleared | ~enabled); // 停用的规则立即解除
+    uint32_t candidates = exceeded & enabled & ~active;
+    
+    // 开始超限的规则开始计时，中途回到范围内的规则重新计时
+    for (uint32_t mask = candidates & ~alarm_pending_mask; mask != 0; mask &= mask - 1) {
+        alarm_pending_since[__builtin_ctz(mask)] = now;
+    }
+    alarm_pending_mask = candidates;
+    
+    uint32_t entering = 0;
+    for (uint32_t mask = candidates; mask != 0; mask &= mask - 1) {
+        uint8_t i = (uint8_t)__builtin_ctz(mask);
+        if (now - alarm_pending_since[i] >= (uint32_t)alarm_delay_s[i] * 1000U) {
+            entering |= 1UL << i;
+        }
+    }
+    alarm_pending_mask &= ~entering;
+    
+    if ((leaving | entering) == 0) {
+        return;
+    }
+    
+    for (uint32_t mask = leaving; mask != 0; mask &= mask - 1) {
+        alarm_log_event((uint8_t)__builtin_ctz(mask), ALARM_EVENT_LEAVE, temperatures, count);
+    }
+    for (uint32_t mask = entering; mask != 0; mask &= mask - 1) {
+        uint8_t i = (uint8_t)__builtin_ctz(mask);
+        alarm_sensor[i] = (uint8_t)__builtin_ctz(hit[i]); // 第一个超限的传感器
+        alarm_log_event(i, ALARM_EVENT_ENTER, temperatures, count);
+    }
+    
+    active = (active & ~leaving) | entering;
+    alarm_active_mask = active;
+    alarm_update_outputs(active);
+}
+
+uint32_t alarm_get_active_mask(void) {
+    return alarm_active_mask;
+}
+
+void alarm_reset_all(void) {
+    led_off();
+    buzzer_off();
+}
@@ -0,0 +1,133 @@
+#include "analog_temp.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <string.h>
+
+// NTC分压的读数（1/16 LSB），-40°C起每5°C一点，随温度单调递减
+#define NTC_TABLE_START -400
+#define NTC_TABLE_STEP  50
+static const uint16_t ntc_table[] = {
+    63929, 63273, 62403, 61274, 59842, 58066, 55919, 53393, 50500, 47282, 43806, 40161,
+    36446, 32760, 29195, 25824, 22701, 19856, 17302, 15036, 13046, 11310, 9805, 8505,
+    7385, 6422, 5595, 4883, 4272, 3746, 3293, 2901, 2563, 2270,
+};
+#define NTC_TABLE_SIZE (sizeof(ntc_table) / sizeof(ntc_table[0]))
+
+// DMA中断累加，采样任务锁存，访问时进入临界段
+static uint32_t input_sum[ANALOG_INPUT_COUNT];
+static uint32_t input_frames = 0;
+// 只由采样任务访问
+static uint16_t input_average[ANALOG_INPUT_COUNT];
+static bool average_valid = false;
+
+void analog_temp_reset(void) {
+    memset(input_sum, 0, sizeof(input_sum));
+    input_frames = 0;
+    memset(input_average, 0, sizeof(input_average));
+    average_valid = false;
+}
+
+void analog_temp_accumulate(const uint16_t *frames, uint16_t count) {
+    uint32_t sums[ANALOG_INPUT_COUNT] = { 0 };
+    for (uint16_t f = 0; f < count; f++) {
+        for (uint8_t i = 0; i < ANALOG_INPUT_COUNT; i++) {
+            sums[i] += frames[i];
+        }
+        frames += ANALOG_INPUT_COUNT;
+    }
+    if (input_frames + count > ANALOG_TEMP_MAX_FRAMES) {
+        memset(input_sum, 0, sizeof(input_sum));
+        input_frames = 0;
+    }
+    for (uint8_t i = 0; i < ANALOG_INPUT_COUNT; i++) {
+        input_sum[i] += sums[i];
+    }
+    input_frames += count;
+}
+
+bool analog_temp_snapshot(void) {
+    uint32_t sums[ANALOG_INPUT_COUNT];
+    taskENTER_CRITICAL();
+    uint32_t frames = input_frames;
+    memcpy(sums, input_sum, sizeof(sums));
+    memset(input_sum, 0, sizeof(input_sum));
+    input_frames = 0;
+    taskEXIT_CRITICAL();
+
+    average_valid = frames != 0;
+    if (!average_valid) {
+        return false;
+    }
+    // 和乘以16后除以次数，四舍五入
+    for (uint8_t i = 0; i < ANALOG_INPUT_COUNT; i++) {
+        input_average[i] = (uint16_t)(((uint64_t)sums[i] * 16U + frames / 2U) / frames);
+    }
+    return true;
+}
+
+uint16_t analog_temp_average(uint8_t input) {
+    return input < ANALOG_INPUT_COUNT ? input_average[input] : 0;
+}
+
+// 有符号除法四舍五入（远离0）
+static int32_t divide_round(int64_t numerator, int64_t denominator) {
+    int64_t half = denominator / 2;
+    return (int32_t)((numerator + (numerator < 0 ? -half : half)) / denominator);
+}
+
+int16_t analog_temp_ntc_deci(uint16_t average) {
+    if (average < ANALOG_NTC_SHORT || average > ANALOG_NTC_OPEN) {
+        return TEMP_INVALID;
+    }
+    // 表的两端之外按端点取值
+    if (average >= ntc_table[0]) {
+        return NTC_TABLE_START;
+    }
+    if (average <= ntc_table[NTC_TABLE_SIZE - 1]) {
+        return (int16_t)(NTC_TABLE_START + (NTC_TABLE_SIZE - 1) * NTC_TABLE_STEP);
+    }
+    // 二分查找ntc_table[low] > average >= ntc_table[low + 1]
+    uint8_t low = 0, high = NTC_TABLE_SIZE - 1;
+    while (high - low > 1) {
+        uint8_t middle = (uint8_t)((low + high) / 2);
+        if (ntc_table[middle] > average) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    int32_t span = ntc_table[low] - ntc_table[high];
+    int32_t offset = divide_round((int64_t)(ntc_table[low] - average) * NTC_TABLE_STEP, span);
+    return (int16_t)(NTC_TABLE_START + low * NTC_TABLE_STEP + offset);
+}
+
+int16_t analog_temp_internal_deci(uint16_t sensor, uint16_t vrefint) {
+    if (vrefint < ANALOG_VREFINT_MIN || vrefint > ANALOG_VREFINT_MAX) {
+        return TEMP_INVALID;
+    }
+    // T = 25°C + (1430mV - Vsense) / 4.3mV，Vsense = 1200mV × sensor / vrefint
+    int64_t numerator = ((int64_t)1430 * vrefint - (int64_t)ANALOG_VREFINT_MV * sensor) * 100;
+    return (int16_t)(250 + divide_round(numerator, (int64_t)43 * vrefint));
+}
+
+bool analog_temp_channel_ok(uint8_t channel) {
+    if (!average_valid || channel >= ANALOG_TEMP_CHANNELS) {
+        return false;
+    }
+    if (channel == ANALOG_INPUT_INTERNAL) {
+        uint16_t vrefint = input_average[ANALOG_INPUT_VREFINT];
+        return vrefint >= ANALOG_VREFINT_MIN && vrefint <= ANALOG_VREFINT_MAX;
+    }
+    uint16_t average = input_average[channel];
+    return average >= ANALOG_NTC_SHORT && average <= ANALOG_NTC_OPEN;
+}
+
+int16_t analog_temp_read(uint8_t channel) {
+    if (!analog_temp_channel_ok(channel)) {
+        return TEMP_INVALID;
+    }
+    if (channel == ANALOG_INPUT_INTERNAL) {
+        return analog_temp_internal_deci(input_average[ANALOG_INPUT_INTERNAL], input_average[ANALOG_INPUT_VREFINT]);
+    }
+    return analog_temp_ntc_deci(input_average[channel]);
+}
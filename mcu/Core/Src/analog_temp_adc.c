@@ -0,0 +1,106 @@
+#include "analog_temp.h"
+
+#if TEMP_ANALOG
+#include "main.h"
+#include "timebase.h"
+
+// ADC1的DMA请求固定在DMA1通道1；两半各ANALOG_TEMP_FRAMES次扫描
+#define ANALOG_DMA_IRQ_PRIORITY 6  // 低于串口，受临界段屏蔽
+static uint16_t adc_buffer[2][ANALOG_TEMP_FRAMES][ANALOG_INPUT_COUNT];
+
+// 采样时间239.5个ADC周期（片内传感器要求不少于17.1µs），ADC时钟为PCLK2的1/8（9MHz），
+// 每次转换28µs，一次扫描112µs，约每7ms一次DMA中断
+static void analog_adc_start(void) {
+    __HAL_RCC_GPIOC_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    __HAL_RCC_ADC1_CLK_ENABLE();
+    MODIFY_REG(RCC->CFGR, RCC_CFGR_ADCPRE, RCC_CFGR_ADCPRE_DIV8);
+
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    GPIO_InitStruct.Pin = GPIO_PIN_0 | GPIO_PIN_1;
+    GPIO_InitStruct.Mode = GPIO_MODE_ANALOG;
+    HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
+
+    ADC1->CR2 = 0;
+    ADC1->CR1 = ADC_CR1_SCAN;
+    ADC1->SMPR1 = ADC_SMPR1_SMP10 | ADC_SMPR1_SMP11 | ADC_SMPR1_SMP16 | ADC_SMPR1_SMP17;
+    ADC1->SQR1 = (ANALOG_INPUT_COUNT - 1U) << ADC_SQR1_L_Pos;
+    ADC1->SQR3 = (10U << ADC_SQR3_SQ1_Pos) | (11U << ADC_SQR3_SQ2_Pos) |
+                 (16U << ADC_SQR3_SQ3_Pos) | (17U << ADC_SQR3_SQ4_Pos);
+
+    // 上电后等待稳定，再做自校准
+    ADC1->CR2 = ADC_CR2_ADON;
+    delay_us(2);
+    ADC1->CR2 |= ADC_CR2_RSTCAL;
+    while (ADC1->CR2 & ADC_CR2_RSTCAL) {
+    }
+    ADC1->CR2 |= ADC_CR2_CAL;
+    while (ADC1->CR2 & ADC_CR2_CAL) {
+    }
+
+    analog_temp_reset();
+    DMA1_Channel1->CCR = 0;
+    DMA1_Channel1->CPAR = (uint32_t)&ADC1->DR;
+    DMA1_Channel1->CMAR = (uint32_t)adc_buffer;
+    DMA1_Channel1->CNDTR = sizeof(adc_buffer) / sizeof(uint16_t);
+    DMA1->IFCR = DMA_IFCR_CGIF1;
+    DMA1_Channel1->CCR = DMA_CCR_MINC | DMA_CCR_PSIZE_0 | DMA_CCR_MSIZE_0 | DMA_CCR_CIRC |
+                         DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_EN;
+    HAL_NVIC_SetPriority(DMA1_Channel1_IRQn, ANALOG_DMA_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+
+    // 软件触发的连续扫描，打开温度传感器和内部参考
+    ADC1->CR2 = ADC_CR2_ADON | ADC_CR2_CONT | ADC_CR2_DMA | ADC_CR2_TSVREFE |
+                ADC_CR2_EXTSEL | ADC_CR2_EXTTRIG;
+    ADC1->CR2 |= ADC_CR2_SWSTART;
+}
+
+void analog_temp_dma_irq_handler(void) {
+    uint32_t isr = DMA1->ISR;
+    DMA1->IFCR = isr & (DMA_ISR_GIF1 | DMA_ISR_HTIF1 | DMA_ISR_TCIF1);
+    if (isr & DMA_ISR_HTIF1) {
+        analog_temp_accumulate(&adc_buffer[0][0][0], ANALOG_TEMP_FRAMES);
+    }
+    if (isr & DMA_ISR_TCIF1) {
+        analog_temp_accumulate(&adc_buffer[1][0][0], ANALOG_TEMP_FRAMES);
+    }
+}
+
+// 驱动：转换一直在进行，不需要等待；轮询时锁存平均值，
+// 启动后第一个半缓冲（约7ms）写完之前还没有平均值，稍后再轮询
+static uint8_t analog_probe(void *context) {
+    (void)context;
+    analog_adc_start();
+    return ANALOG_TEMP_CHANNELS;
+}
+
+static bool analog_start(void *context, uint32_t *remaining_ms) {
+    (void)context;
+    *remaining_ms = 0;
+    return true;
+}
+
+static bool analog_poll(void *context) {
+    (void)context;
+    return analog_temp_snapshot();
+}
+
+static int16_t analog_read(void *context, uint8_t channel) {
+    (void)context;
+    return analog_temp_read(channel);
+}
+
+static bool analog_healthy(void *context, uint8_t channel) {
+    (void)context;
+    return analog_temp_channel_ok(channel);
+}
+
+const TempDriver analog_temp_driver = {
+    .name = "adc",
+    .probe = analog_probe,
+    .start = analog_start,
+    .poll = analog_poll,
+    .read = analog_read,
+    .healthy = analog_healthy,
+};
+#endif
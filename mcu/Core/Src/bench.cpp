@@ -0,0 +1,225 @@
+#include "bench.h"
+#include "protocol.h"
+#include "log_codec.h"
+#include "utils/buffer.hpp"
+#include "utils/escaping.hpp"
+#include <cstdio>
+#include <cstring>
+
+#define BENCH_LOG_ENTRIES 96 // 典型载荷的日志条数
+
+namespace {
+
+// 各测量项共用的缓冲区：静态分配，不占用调用任务的栈
+struct BenchBuffers {
+    uint8_t payload[BENCH_PAYLOAD_MAX];
+    uint16_t payload_len;
+    uint8_t escaped[BENCH_PAYLOAD_MAX * 2 + 8];
+    uint16_t escaped_len;
+    uint8_t frame[MAX_PACKET_SIZE * 2];
+    uint16_t frame_len;
+    uint8_t stuffed[BENCH_PAYLOAD_MAX * 2 + 8]; // EscapingWriter的输出
+    uint16_t stuffed_len;
+    uint8_t tlv[BENCH_PAYLOAD_MAX + 64];
+    uint16_t tlv_len;
+    uint8_t out[MAX_PACKET_SIZE * 2];
+};
+
+BenchBuffers buffers;
+volatile uint32_t sink; // 保存结果，防止被测调用被优化掉
+
+void make_worst_payload() {
+    for (uint16_t i = 0; i < BENCH_PAYLOAD_MAX; i++) {
+        buffers.payload[i] = (i & 1U) ? 0x55 : 0xAA;
+    }
+    buffers.payload_len = BENCH_PAYLOAD_MAX;
+}
+
+void make_log_payload() {
+    TempLogEntry entries[BENCH_LOG_ENTRIES] = {};
+    for (uint16_t i = 0; i < BENCH_LOG_ENTRIES; i++) {
+        entries[i].timestamp = 1750689000U + i * 60U;
+        entries[i].sequence = i;
+        entries[i].temperature = static_cast<int16_t>(250 + (i % 16 < 8 ? i % 8 : 8 - i % 8));
+        entries[i].raw = entries[i].temperature;
+    }
+    uint32_t encoded = 0;
+    int len = log_codec_encode(entries, BENCH_LOG_ENTRIES, buffers.payload, sizeof(buffers.payload), &encoded);
+    buffers.payload_len = len > 0 ? static_cast<uint16_t>(len) : 0;
+}
+
+uint32_t run_escaping_writer();
+
+// 为载荷准备解析类测量项的输入：转义后的载荷、完整帧和TLV记录
+void prepare_inputs() {
+    int len = escape_data(buffers.payload, buffers.payload_len, buffers.escaped, sizeof(buffers.escaped));
+    buffers.escaped_len = len > 0 ? static_cast<uint16_t>(len) : 0;
+
+    len = build_packet(PKT_TYPE_SLAVE_RESPONSE, 1, 1, buffers.payload, buffers.payload_len,
+                       buffers.frame, sizeof(buffers.frame));
+    buffers.frame_len = len > 0 ? static_cast<uint16_t>(len) : 0;
+
+    len = write_tlv_string(buffers.tlv, sizeof(buffers.tlv), TAG_INSTRUCTION, CMD_GET_LOG);
+    len += write_tlv_uint8(buffers.tlv + len, sizeof(buffers.tlv) - len, TAG_STATUS, STATUS_OK);
+    len += write_tlv_raw(buffers.tlv + len, sizeof(buffers.tlv) - len, TAG_DATA, buffers.payload,
+                         buffers.payload_len);
+    buffers.tlv_len = static_cast<uint16_t>(len);
+
+    buffers.stuffed_len = static_cast<uint16_t>(run_escaping_writer());
+    memcpy(buffers.stuffed, buffers.out, buffers.stuffed_len);
+}
+
+uint32_t run_crc() {
+    return calculate_crc32(buffers.payload, buffers.payload_len);
+}
+
+uint32_t run_escape() {
+    return escape_data(buffers.payload, buffers.payload_len, buffers.out, sizeof(buffers.out));
+}
+
+uint32_t run_unescape() {
+    return unescape_data(buffers.escaped, buffers.escaped_len, buffers.out, sizeof(buffers.out));
+}
+
+uint32_t run_build() {
+    return build_packet(PKT_TYPE_SLAVE_RESPONSE, 1, 1, buffers.payload, buffers.payload_len,
+                        buffers.out, sizeof(buffers.out));
+}
+
+uint32_t run_parse() {
+    PacketHeader header;
+    return parse_packet(buffers.frame, buffers.frame_len, &header, buffers.out, sizeof(buffers.out));
+}
+
+// 一条响应的IN/ST/DA
+uint32_t run_write_tlv() {
+    int len = write_tlv_string(buffers.out, sizeof(buffers.out), TAG_INSTRUCTION, CMD_GET_LOG);
+    len += write_tlv_uint8(buffers.out + len, sizeof(buffers.out) - len, TAG_STATUS, STATUS_OK);
+    len += write_tlv_raw(buffers.out + len, sizeof(buffers.out) - len, TAG_DATA, buffers.payload,
+                         buffers.payload_len);
+    return static_cast<uint32_t>(len);
+}
+
+uint32_t run_read_tlv() {
+    char instruction[5];
+    uint8_t status = 0;
+    uint16_t length = sizeof(buffers.out);
+    read_tlv_string(buffers.tlv, buffers.tlv_len, TAG_INSTRUCTION, instruction, sizeof(instruction));
+    read_tlv_uint8(buffers.tlv, buffers.tlv_len, TAG_STATUS, &status);
+    read_tlv_raw(buffers.tlv, buffers.tlv_len, TAG_DATA, buffers.out, &length);
+    return length + status;
+}
+
+// BufferWriter/BufferReader按16位字读写载荷
+uint32_t run_buffer_writer() {
+    BufferWriter writer(reinterpret_cast<char *>(buffers.out), sizeof(buffers.out));
+    for (uint16_t i = 0; i + 2 <= buffers.payload_len; i += 2) {
+        uint16_t word;
+        memcpy(&word, buffers.payload + i, sizeof(word));
+        writer.write(word);
+    }
+    return static_cast<uint32_t>(writer.tell());
+}
+
+uint32_t run_buffer_reader() {
+    BufferReader reader(reinterpret_cast<const char *>(buffers.payload), buffers.payload_len);
+    uint32_t sum = 0;
+    uint16_t word;
+    while (reader.read(word) > 0) {
+        sum += word;
+    }
+    return sum;
+}
+
+uint32_t run_escaping_writer() {
+    EscapingWriter writer(reinterpret_cast<char *>(buffers.out), sizeof(buffers.out));
+    writer.write_start();
+    writer.write(reinterpret_cast<const char *>(buffers.payload), buffers.payload_len);
+    writer.write_end();
+    return static_cast<uint32_t>(writer.tell());
+}
+
+// EscapingReader把不跟在0xAA/0x55之后的0x00视为错误并提前返回，
+// 含0x00的日志载荷只测到第一个0x00为止
+uint32_t run_escaping_reader() {
+    EscapingReader reader(reinterpret_cast<const char *>(buffers.stuffed), buffers.stuffed_len);
+    if (!reader.find_start()) {
+        return 0;
+    }
+    return static_cast<uint32_t>(reader.read(reinterpret_cast<char *>(buffers.out), buffers.payload_len));
+}
+
+// 在完整的转义帧中查找起始和结束标记（重新同步时的扫描）
+uint32_t run_escaping_scan() {
+    EscapingReader reader(reinterpret_cast<const char *>(buffers.stuffed), buffers.stuffed_len);
+    if (!reader.find_start() || !reader.find_end()) {
+        return 0;
+    }
+    return static_cast<uint32_t>(reader.tell());
+}
+
+struct BenchCase {
+    const char *name;
+    uint32_t (*run)();
+};
+
+const BenchCase cases[] = {
+    {"calculate_crc32", run_crc},
+    {"escape_data", run_escape},
+    {"unescape_data", run_unescape},
+    {"build_packet", run_build},
+    {"parse_packet", run_parse},
+    {"write_tlv", run_write_tlv},
+    {"read_tlv", run_read_tlv},
+    {"BufferWriter", run_buffer_writer},
+    {"BufferReader", run_buffer_reader},
+    {"EscapingWriter", run_escaping_writer},
+    {"EscapingReader", run_escaping_reader},
+    {"EscapingScan", run_escaping_scan},
+};
+
+uint8_t run_payload(const char *payload, BenchClock clock, uint16_t iterations, BenchResult *results, uint8_t max) {
+    prepare_inputs();
+    uint8_t count = 0;
+    for (const BenchCase &bench : cases) {
+        if (count >= max) {
+            break;
+        }
+        uint32_t best = UINT32_MAX;
+        for (uint16_t i = 0; i < iterations; i++) {
+            uint32_t start = clock();
+            sink = bench.run();
+            uint32_t elapsed = clock() - start;
+            if (elapsed < best) {
+                best = elapsed;
+            }
+        }
+        results[count++] = BenchResult{bench.name, payload, buffers.payload_len, best};
+    }
+    return count;
+}
+
+} // namespace
+
+uint8_t bench_run(BenchClock clock, uint16_t iterations, BenchResult *results, uint8_t max) {
+    if (iterations == 0) {
+        iterations = 1;
+    }
+    make_worst_payload();
+    uint8_t count = run_payload("worst", clock, iterations, results, max);
+    make_log_payload();
+    return count + run_payload("log", clock, iterations, results + count, max - count);
+}
+
+void bench_report(BenchClock clock, uint16_t iterations) {
+    static BenchResult results[BENCH_CASES_MAX];
+    uint8_t count = bench_run(clock, iterations, results, BENCH_CASES_MAX);
+    for (uint8_t i = 0; i < count; i++) {
+        const BenchResult &r = results[i];
+        // 每字节耗时保留两位小数
+        uint32_t per_byte = r.bytes ? static_cast<uint32_t>(static_cast<uint64_t>(r.ticks) * 100U / r.bytes) : 0;
+        printf("bench %-16s %-5s %3uB %8lu %5lu.%02lu/B\n", r.name, r.payload, static_cast<unsigned>(r.bytes),
+               static_cast<unsigned long>(r.ticks), static_cast<unsigned long>(per_byte / 100U),
+               static_cast<unsigned long>(per_byte % 100U));
+    }
+}
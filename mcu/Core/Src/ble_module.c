@@ -0,0 +1,109 @@
+#include "ble_module.h"
+#include "communication.h"
+#include <string.h>
+
+#define BLE_MODULE_COMMAND_MAX 32U
+
+static const uint32_t link_rates[] = COMM_BAUD_RATES;
+
+// 在text末尾追加十进制数
+static uint16_t append_decimal(char *text, uint16_t length, uint32_t value) {
+    char digits[10];
+    uint8_t count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10U);
+        value /= 10U;
+    } while (value != 0);
+    while (count > 0) {
+        text[length++] = digits[--count];
+    }
+    return length;
+}
+
+static bool reply_contains(const uint8_t *reply, uint16_t length, const char *token) {
+    uint16_t token_length = (uint16_t)strlen(token);
+    for (uint16_t i = 0; i + token_length <= length; i++) {
+        if (memcmp(reply + i, token, token_length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 发送一条指令（自动加CRLF），应答中有OK时返回true；ERROR或没有应答时返回false
+static bool at_command(const BleModulePort *port, const char *command, uint16_t length) {
+    uint8_t reply[BLE_MODULE_REPLY_MAX];
+    char line[BLE_MODULE_COMMAND_MAX + 2];
+    memcpy(line, command, length);
+    line[length++] = '\r';
+    line[length++] = '\n';
+    port->send(port->context, (const uint8_t *)line, length);
+    uint16_t received = port->receive(port->context, reply, sizeof(reply), BLE_MODULE_REPLY_MS, BLE_MODULE_GAP_MS);
+    return reply_contains(reply, received, "OK") && !reply_contains(reply, received, "ERROR");
+}
+
+static bool at_probe(const BleModulePort *port) {
+    return at_command(port, BLE_MODULE_CMD_PROBE, sizeof(BLE_MODULE_CMD_PROBE) - 1U);
+}
+
+static bool at_command_value(const BleModulePort *port, const char *prefix, uint32_t first, uint32_t second,
+                             bool pair) {
+    char command[BLE_MODULE_COMMAND_MAX];
+    uint16_t length = (uint16_t)strlen(prefix);
+    memcpy(command, prefix, length);
+    length = append_decimal(command, length, first);
+    if (pair) {
+        command[length++] = ',';
+        length = append_decimal(command, length, second);
+    }
+    return at_command(port, command, length);
+}
+
+void ble_module_configure(const BleModulePort *port, BleModuleResult *result) {
+    memset(result, 0, sizeof(*result));
+    result->baud_rate = COMM_DEFAULT_BAUD_RATE;
+
+    // 先试上次配置的（最高的）波特率，再试较低的各档
+    for (uint8_t round = 0; round < BLE_MODULE_PROBE_ROUNDS && !result->found; round++) {
+        for (uint8_t i = COMM_BAUD_RATE_COUNT; i-- > 0 && !result->found;) {
+            if (link_rates[i] <= BLE_MODULE_BAUD_MAX && port->set_baud(port->context, link_rates[i]) &&
+                at_probe(port)) {
+                result->found = true;
+                result->found_baud = link_rates[i];
+            }
+        }
+    }
+    if (!result->found) {
+        port->set_baud(port->context, COMM_DEFAULT_BAUD_RATE);
+        return;
+    }
+    result->baud_rate = result->found_baud;
+
+    result->interval_set = at_command_value(port, BLE_MODULE_CMD_INTERVAL, BLE_MODULE_INTERVAL_MIN,
+                                            BLE_MODULE_INTERVAL_MAX, true);
+
+    for (uint8_t i = COMM_BAUD_RATE_COUNT; i-- > 0;) {
+        uint32_t target = link_rates[i];
+        if (target > BLE_MODULE_BAUD_MAX) {
+            continue;
+        }
+        if (target <= result->baud_rate) {
+            break;
+        }
+        if (!at_command_value(port, BLE_MODULE_CMD_BAUD, target, 0, false)) {
+            continue;
+        }
+        // 模块应答OK后切换；新波特率上不应答时回到原波特率
+        if (port->set_baud(port->context, target) && at_probe(port)) {
+            result->baud_rate = target;
+            break;
+        }
+        port->set_baud(port->context, result->baud_rate);
+        if (!at_probe(port)) {
+            // 两边都不应答：不知道模块当前的波特率，回到默认波特率，由下次上电重新探测
+            result->baud_rate = COMM_DEFAULT_BAUD_RATE;
+            port->set_baud(port->context, COMM_DEFAULT_BAUD_RATE);
+            break;
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#include "block_pool.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stddef.h>
+
+static BlockPool *pool_list = NULL;
+static BlockPool **pool_tail = &pool_list;
+
+void block_pool_init(BlockPool *pool, const char *name, uint32_t *storage,
+                     uint16_t block_size, uint16_t block_count) {
+    pool->name = name;
+    pool->storage = (uint8_t *)storage;
+    pool->block_size = (uint16_t)((block_size + 3U) & ~3U);
+    pool->block_count = block_count;
+    pool->used = 0;
+    pool->peak = 0;
+    pool->failures = 0;
+
+    // 按地址顺序串起所有块
+    pool->free_list = NULL;
+    for (uint16_t i = block_count; i > 0; i--) {
+        void **block = (void **)(pool->storage + (uint32_t)(i - 1U) * pool->block_size);
+        *block = pool->free_list;
+        pool->free_list = block;
+    }
+
+    pool->next = NULL;
+    *pool_tail = pool;
+    pool_tail = &pool->next;
+}
+
+void *block_pool_alloc(BlockPool *pool) {
+    UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+    void **block = pool->free_list;
+    if (block != NULL) {
+        pool->free_list = *block;
+        pool->used++;
+        if (pool->used > pool->peak) {
+            pool->peak = pool->used;
+        }
+    } else {
+        pool->failures++;
+    }
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+    return block;
+}
+
+void block_pool_free(BlockPool *pool, void *block) {
+    if (block == NULL) {
+        return;
+    }
+    UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+    *(void **)block = pool->free_list;
+    pool->free_list = block;
+    pool->used--;
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+}
+
+bool block_pool_get_stats(uint8_t index, BlockPoolStats *stats) {
+    BlockPool *pool = pool_list;
+    while (pool != NULL && index > 0) {
+        pool = pool->next;
+        index--;
+    }
+    if (pool == NULL) {
+        return false;
+    }
+
+    UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+    stats->name = pool->name;
+    stats->block_size = pool->block_size;
+    stats->block_count = pool->block_count;
+    stats->used = pool->used;
+    stats->peak = pool->peak;
+    stats->failures = pool->failures;
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+    return true;
+}
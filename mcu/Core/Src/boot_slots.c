@@ -0,0 +1,68 @@
+#include "boot_slots.h"
+#include <string.h>
+
+// 不使用静态变量：引导程序不初始化.data/.bss
+
+uint16_t boot_record_check(const BootRecord *record) {
+    return (uint16_t)~(record->magic + record->sequence + (record->confirmed | (record->trial << 8)));
+}
+
+static bool record_valid(const BootRecord *record) {
+    return record->magic == BOOT_RECORD_MAGIC && record->check == boot_record_check(record) &&
+           record->confirmed <= BOOT_SLOT_B && (record->trial <= BOOT_SLOT_B || record->trial == BOOT_SLOT_NONE);
+}
+
+static bool record_erased(const uint8_t *state, uint32_t offset) {
+    for (uint32_t i = 0; i < sizeof(BootRecord); i++) {
+        if (state[offset + i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool boot_record_find(const uint8_t *state, BootRecord *record, uint32_t *append) {
+    bool found = false;
+    uint32_t latest = 0;
+    for (uint32_t offset = 0; offset < BOOT_STATE_SIZE; offset += sizeof(BootRecord)) {
+        BootRecord candidate;
+        memcpy(&candidate, state + offset, sizeof(candidate));
+        if (record_valid(&candidate) && (!found || (int16_t)(candidate.sequence - record->sequence) > 0)) {
+            *record = candidate;
+            latest = offset;
+            found = true;
+        }
+    }
+    if (!found) {
+        *append = 0;
+        return false;
+    }
+
+    // 最新记录之后的第一个空位（跳过写入中断的记录）；该页已满时换到另一页的页首
+    uint32_t page_end = (latest / BOOT_PAGE_SIZE + 1U) * BOOT_PAGE_SIZE;
+    uint32_t next = latest + sizeof(BootRecord);
+    while (next < page_end && !record_erased(state, next)) {
+        next += sizeof(BootRecord);
+    }
+    *append = next < page_end ? next : page_end % BOOT_STATE_SIZE;
+    return true;
+}
+
+uint8_t boot_select(const BootRecord *record, bool trial_attempted) {
+    if (record == NULL) {
+        return BOOT_SLOT_A;
+    }
+    if (record->trial != BOOT_SLOT_NONE && !trial_attempted) {
+        return record->trial;
+    }
+    return record->confirmed;
+}
+
+bool boot_image_valid(const uint8_t *image, uint32_t link_base, uint32_t size) {
+    uint32_t stack, reset;
+    memcpy(&stack, image, sizeof(stack));
+    memcpy(&reset, image + 4, sizeof(reset));
+    uint32_t entry = reset & ~1U;
+    return stack > BOOT_RAM_BASE && stack <= BOOT_RAM_BASE + BOOT_RAM_SIZE && (stack & 3U) == 0 &&
+           (reset & 1U) != 0 && entry >= link_base && entry < link_base + size;
+}
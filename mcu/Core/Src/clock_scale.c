@@ -0,0 +1,88 @@
+#include "clock_scale.h"
+
+#if CLOCK_SCALE
+
+#include "communication.h"
+#include "uart_transport.h"
+#include "device_control.h"
+#include "usb_cdc.h"
+#include "timebase.h"
+#include "main.h"
+
+#if !DS18B20_USE_TIMER
+#error "降频要求1-Wire时隙由TIM6产生（DS18B20_USE_TIMER=1）"
+#endif
+
+static volatile bool scaled = false;
+static volatile uint8_t holds = 0;
+
+// 预分频按比例缩放（各定时器的时钟都等于HCLK），更新事件装载新值，不产生中断；
+// 计数器被更新事件清零后改回原值，HAL时基当前毫秒内的微秒数不丢失
+static void rescale_timer(TIM_TypeDef *tim, bool low) {
+    uint32_t cr1 = tim->CR1;
+    uint32_t count = tim->CNT;
+    uint32_t prescaler = tim->PSC + 1U;
+    tim->PSC = (low ? prescaler / CLOCK_SCALE_DIVIDER : prescaler * CLOCK_SCALE_DIVIDER) - 1U;
+    tim->CR1 = cr1 | TIM_CR1_URS;
+    tim->EGR = TIM_EGR_UG;
+    tim->CNT = count;
+    tim->CR1 = cr1;
+}
+
+// 在中断屏蔽下调用
+static void switch_clock(bool low) {
+    if (scaled == low) {
+        return;
+    }
+    // APB2始终不分频；APB1全速时2分频（不超过36MHz），降频后不分频
+    MODIFY_REG(RCC->CFGR, RCC_CFGR_HPRE | RCC_CFGR_PPRE1,
+               low ? (RCC_CFGR_HPRE_DIV8 | RCC_CFGR_PPRE1_DIV1) : (RCC_CFGR_HPRE_DIV1 | RCC_CFGR_PPRE1_DIV2));
+    SystemCoreClockUpdate();
+    timebase_cycles_per_us = SystemCoreClock / 1000000U;
+    if (low) {
+        SysTick->CTRL |= SysTick_CTRL_CLKSOURCE_Msk;
+    } else {
+        SysTick->CTRL &= ~SysTick_CTRL_CLKSOURCE_Msk;
+    }
+    rescale_timer(TIM7, low);
+    rescale_timer(TIM6, low);
+    uart_transport_clock_changed();
+    scaled = low;
+}
+
+void clock_scale_full(void) {
+    if (!scaled) {
+        return;
+    }
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    switch_clock(false);
+    __set_PRIMASK(primask);
+}
+
+void clock_scale_hold(void) {
+    __atomic_fetch_add(&holds, 1, __ATOMIC_RELAXED);
+    clock_scale_full();
+}
+
+void clock_scale_release(void) {
+    __atomic_fetch_sub(&holds, 1, __ATOMIC_RELAXED);
+}
+
+// 判断和切换在同一段中断屏蔽内，收到数据的中断不会落在两者之间
+bool clock_scale_idle(void) {
+    __disable_irq();
+    bool low = holds == 0 && output_all_off() && communication_low_clock_allowed();
+#if COMM_USB_LINK
+    low = low && !usb_cdc_active();
+#endif
+    switch_clock(low);
+    __enable_irq();
+    return low;
+}
+
+bool clock_scale_low(void) {
+    return scaled;
+}
+
+#endif // CLOCK_SCALE
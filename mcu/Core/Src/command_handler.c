@@ -1,244 +1,3269 @@
 #include "command_handler.h"
 #include "device_control.h"
+#include "communication.h"
+#include "log_codec.h"
+#include "tlv_schema.h"
+#include "command_list.h"
+#include "temp_sampler.h"
+#include "temp_filter.h"
+#include "temp_calib.h"
+#include "temp_stats.h"
+#include "sample_schedule.h"
+#include "log_compress.h"
+#include "temp_logger.h"
+#include "config_store.h"
+#include "storage_task.h"
+#include "output_sequencer.h"
+#include "frame_writer.h"
+#include "block_pool.h"
+#include "watchdog.h"
+#include "command_stats.h"
+#include "gateway.h"
+#include "response_cache.h"
+#include "admission.h"
+#include "crc32.h"
+#include "fw_update.h"
+#include "trace.h"
+#include "timebase.h"
+#include "main.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
 #include <string.h>
 
-// 命令表
-static CommandEntry command_table[] = {
-    {CMD_PING, handle_ping},
-    {CMD_GET_TEMP, handle_get_temp},
-    {CMD_GET_RTC_DATE, handle_get_rtc_date},
-    {CMD_GET_RTC_TIME, handle_get_rtc_time},
-    {CMD_SET_RTC_DATE, handle_set_rtc_date},
-    {CMD_SET_RTC_TIME, handle_set_rtc_time},
-    {CMD_GET_ALARMS, handle_get_alarms},
-    {CMD_SET_ALARMS, handle_set_alarms},
-    {CMD_GET_LOG, handle_get_log},
-    {CMD_SET_LED, handle_set_led},
-    {CMD_RESET_LED, handle_reset_led},
-    {CMD_SET_BUZZER, handle_set_buzzer},
-    {CMD_RESET_BUZZER, handle_reset_buzzer},
+// 挂起的延迟命令
+typedef struct {
+    bool active;
+    char instruction[5];
+    uint16_t response_id;
+    uint32_t due_tick;
+    CommandCompleter completer;
+    uint8_t link;            // 发起命令的链路，响应发回该链路
+} PendingCommand;
+
+static PendingCommand pending_commands[MAX_PENDING_COMMANDS];
+
+// 每条链路（communication.h）的会话状态：订阅和温度表示只作用于设置它们的链路
+typedef struct {
+    uint32_t subscribe_interval_ms;  // 0表示未订阅
+    uint32_t subscribe_next_tick;    // 下一次推送的时刻
+    bool subscribe_alarm_changed;    // 报警状态变化，需立即推送
+    uint32_t subscribe_alarm_mask;
+    bool subscribe_alarm_events;     // 报警事件推送（可不订阅温度单独开启）
+    uint8_t stream_id;               // 周期推送使用流帧时的流编号，0为完整的数据包
+    uint8_t stream_sequence;         // 下一个流帧的序号
+    uint8_t temperature_format;      // 温度表示（TEMP_FORMAT_*），由ping的TF字段设置
+    bool compact;                    // 紧凑响应（PKT_TYPE_SLAVE_COMPACT），由ping的CM字段设置
+    AdmissionBucket admission;       // 请求准入的令牌桶
+} CommandSession;
+
+static CommandSession sessions[COMM_LINK_COUNT];
+static CommandSession *session = &sessions[COMM_LINK_BLE]; // 正在处理的链路的会话
+static uint8_t session_link = COMM_LINK_BLE;
+
+// 本次请求中有命令因准入被拒绝，应答不缓存，主机等待后以同一编号重发时重新执行
+static bool request_refused = false;
+
+// 0号传感器的最近一次读数，报警状态变化时推送
+static int16_t subscribe_last_temperature = 0;
+
+// 正在逐条链路推送的报警事件，event_push_links为尚未推送的链路（bit i = 链路i）
+static AlarmEvent event_push;
+static uint8_t event_push_links = 0;
+
+// 已处理（报警检查）的最近一次采样序号
+static uint32_t sample_sequence_seen = 0;
+
+// 带FR的temp、sres：等待序号大于fresh_after_sequence的采样
+static uint32_t fresh_after_sequence = 0;
+static uint32_t fresh_deadline_tick = 0;
+static uint8_t requested_resolution = 0;     // sres请求的分辨率
+static uint8_t temp_request_sensor = 0;      // temp请求的传感器编号
+
+// 日志分片传输状态（同一时刻只进行一个传输）
+// 窗口模式下每发送window片等待主机用位图确认，只重发丢失的分片
+typedef struct {
+    bool active;
+    bool waiting_ack;            // 窗口已发完，等待确认
+    bool finished;               // 最后一片已生成
+    uint8_t format;              // LOG_FORMAT_*
+    uint8_t window;              // 窗口大小，0表示不等待确认
+    uint8_t window_count;        // 当前窗口已生成的分片数
+    uint8_t retries;             // 确认超时次数
+    uint16_t response_id;        // glog请求的编号
+    char instruction[5];         // glog请求的指令（名称或编号），各分片按同样形式回复
+    uint8_t link;                // glog请求的链路，只接受该链路的确认
+    uint16_t base_sequence;      // 当前窗口第一片的序号
+    uint16_t resend_mask;        // 待重发的分片（bit i = base_sequence + i）
+    bool raw;                    // 传输原始温度而不是滤波后的温度
+    TempLogQuery query;          // 传感器、时间范围和下一个新分片的读取位置
+    uint32_t max_count;          // MX限制
+    uint32_t next_offset;        // 下一个新分片之前已发送的条目数
+    uint32_t offsets[LOG_MAX_WINDOW];        // 当前窗口各分片之前已发送的条目数
+    LogStoreIter positions[LOG_MAX_WINDOW];  // 当前窗口各分片的读取位置，重发时据此重新生成
+} LogTransfer;
+
+static LogTransfer log_transfer;
+
+// 批量请求中等待新采样时的轮询间隔
+#define TEMP_FRESH_POLL_MS 10
+
+// 响应DA字段可用长度：数据部分还需容纳IN(8) + ST(5) + DA头(4)
+#define RESPONSE_DATA_BUDGET (MAX_DATA_SIZE - 17)
+
+// 正在执行的请求，供command_defer()记录
+static const char *current_instruction = NULL;
+static uint16_t current_response_id = 0;
+
+static int complete_get_temp(uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+static int complete_set_resolution(uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+static int complete_log_fragment(uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+static int complete_bench(uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+#if COMM_GATEWAY
+static int complete_forward(uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+#endif
+static int report_temperature(const TempSample *sample, uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+static int await_fresh_sample(CommandCompleter completer, TempSample *sample);
+static int check_fresh_sample(CommandCompleter completer, TempSample *sample);
+static int fail_fresh_sample(int result, uint16_t *response_len, uint8_t *status);
+static int report_resolution(uint8_t expected, uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+static int report_new_resolution(uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+static int report_filter(uint8_t *response_data, uint16_t *response_len, uint8_t *status);
+static const CommandEntry *find_entry(const char *instruction);
+static uint8_t count_instructions(const TlvIndex *index);
+static int append_command_result(uint8_t *buffer, uint16_t buffer_size, uint16_t *offset,
+                                 const char *instruction, uint8_t status,
+                                 const uint8_t *response_data, uint16_t response_data_len);
+static int build_command_response(const char *instruction, uint8_t status,
+                                  uint8_t *response_data, uint16_t response_data_len,
+                                  uint16_t response_id, uint8_t *response_packet,
+                                  uint16_t response_size, uint16_t *response_len);
+static int process_batch_packet(const uint8_t *packet_data, uint16_t packet_len,
+                                uint8_t *response_packet, uint16_t response_size,
+                                uint16_t *response_len, uint16_t response_id,
+                                CommandScratch *scratch);
+static int execute_command_packet(const uint8_t *packet_data, uint16_t packet_len,
+                                  uint8_t *response_packet, uint16_t response_size,
+                                  uint16_t *response_len, uint16_t response_id,
+                                  CommandScratch *scratch);
+
+// 命令表，由command_list.h展开，按指令编号排列（下标0保留）
+#define COMMAND_TABLE_ENTRY(op, name, handler, cls, request, response) \
+    [op] = {name, handler, COMMAND_CLASS_##cls},
+static const CommandEntry command_table[] = {
+    COMMAND_LIST(COMMAND_TABLE_ENTRY)
 };
 
 static const size_t command_table_size = sizeof(command_table) / sizeof(CommandEntry);
+_Static_assert(sizeof(command_table) / sizeof(CommandEntry) == COMMAND_COUNT + 1,
+               "命令编号须从1开始连续");
+
+// 按名称查找的散列表：4字符名称作为uint32_t散列，槽中存指令编号（0为空槽），线性探测
+// 槽数保持在命令数的2倍以上，平均探测不到2次，与命令数量无关
+#define COMMAND_HASH_BITS 7
+#define COMMAND_HASH_SIZE (1u << COMMAND_HASH_BITS)
+_Static_assert(sizeof(command_table) / sizeof(CommandEntry) * 2 <= COMMAND_HASH_SIZE,
+               "命令散列表过满，请增大COMMAND_HASH_BITS");
+
+static uint8_t command_hash[COMMAND_HASH_SIZE];
+
+static inline uint32_t command_key(const char *name) {
+    uint32_t key;
+    memcpy(&key, name, sizeof(key));
+    return key;
+}
+
+static inline uint32_t command_hash_slot(uint32_t key) {
+    return (key * 0x9E3779B1u) >> (32 - COMMAND_HASH_BITS);
+}
+
+static void command_hash_init(void) {
+    memset(command_hash, 0, sizeof(command_hash));
+    for (size_t op = 1; op < command_table_size; op++) {
+        if (!command_table[op].handler) {
+            continue;
+        }
+        uint32_t slot = command_hash_slot(command_key(command_table[op].command));
+        while (command_hash[slot] != 0) {
+            slot = (slot + 1) & (COMMAND_HASH_SIZE - 1);
+        }
+        command_hash[slot] = (uint8_t)op;
+    }
+}
+
+// 切换到link的会话，之后构建的帧按该链路的组帧方式和温度表示生成
+static void select_session(uint8_t link) {
+    if (link >= COMM_LINK_COUNT) {
+        link = COMM_LINK_BLE;
+    }
+    session_link = link;
+    session = &sessions[link];
+    communication_select_link(link);
+}
 
 void command_handler_init(void) {
-    // 初始化设备控制模块
-    led_init();
-    buzzer_init();
-    temperature_sensor_init();
-    alarm_init();
-    temp_log_init();
+    // 设备模块由main()和各任务初始化，这里只复位命令处理的状态
+    memset(pending_commands, 0, sizeof(pending_commands));
+    memset(&log_transfer, 0, sizeof(log_transfer));
+    memset(sessions, 0, sizeof(sessions));
+    for (uint8_t i = 0; i < COMM_LINK_COUNT; i++) {
+        sessions[i].temperature_format = TEMP_FORMAT_FLOAT32;
+        admission_reset(&sessions[i].admission, HAL_GetTick());
+    }
+    select_session(COMM_LINK_BLE);
+    event_push_links = 0;
+    sample_sequence_seen = 0;
+    temp_request_sensor = 0;
+    command_hash_init();
+    response_cache_reset();
+}
+
+// 链路link上编号为response_id的请求还有挂起的命令
+static bool has_pending(uint8_t link, uint16_t response_id) {
+    for (uint8_t i = 0; i < MAX_PENDING_COMMANDS; i++) {
+        if (pending_commands[i].active && pending_commands[i].link == link &&
+            pending_commands[i].response_id == response_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 应答帧已构建：单帧应答保存下来供重发的请求重放；
+// 之后还有挂起的帧（分片传输、连续的bnch）时不缓存，重发的请求重新执行
+static void cache_response(uint8_t link, uint16_t response_id, const uint8_t *frame, uint16_t length) {
+    if (has_pending(link, response_id)) {
+        response_cache_drop(link, response_id);
+    } else {
+        response_cache_store(link, response_id, frame, length);
+    }
 }
 
 int process_command_packet(const uint8_t *packet_data, uint16_t packet_len,
-                          uint8_t *response_packet, uint16_t *response_len,
-                          uint16_t response_id) {
-    if (!packet_data || !response_packet || !response_len) {
+                          uint8_t *response_packet, uint16_t response_size,
+                          uint16_t *response_len, uint16_t response_id,
+                          CommandScratch *scratch) {
+    if (!packet_data || !response_packet || !response_len || !scratch) {
         return -1;
     }
     
+    // 请求按到达的链路的会话处理
+    select_session(communication_current_link());
+    
+    // 重发的请求：重放缓存的应答；原请求仍在挂起时丢弃，挂起的命令完成后应答
+    uint32_t request_crc = crc32_compute(packet_data, packet_len);
+    switch (response_cache_lookup(session_link, response_id, request_crc,
+                                  response_packet, response_size, response_len)) {
+    case RESPONSE_CACHE_HIT:
+        return 0;
+    case RESPONSE_CACHE_PENDING:
+        if (has_pending(session_link, response_id)) {
+            *response_len = 0;
+            return COMMAND_DEFERRED;
+        }
+        break;
+    default:
+        break;
+    }
+    
+    response_cache_begin(session_link, response_id, request_crc);
+    request_refused = false;
+    int result = execute_command_packet(packet_data, packet_len, response_packet, response_size,
+                                        response_len, response_id, scratch);
+    if (result == 0 && !request_refused) {
+        cache_response(session_link, response_id, response_packet, *response_len);
+    } else if (result <= 0) {
+        response_cache_drop(session_link, response_id);
+    }
+    return result;
+}
+
+// 请求准入（admission.h）：超出本链路的速率时不执行，*status为BUSY，DA为"RA"
+static bool admission_refused(const CommandEntry *entry, uint8_t *response_data, uint16_t *response_len,
+                              uint8_t *status) {
+    if (!COMMAND_ADMISSION || entry == &command_table[OP_FRAGMENT_ACK]) {
+        return false; // 确认推进的是已接受的传输
+    }
+    uint32_t retry_ms = admission_request(&session->admission, entry->command_class == COMMAND_CLASS_BULK,
+                                          HAL_GetTick());
+    if (retry_ms == 0) {
+        return false;
+    }
+    int len = write_tlv_uint32(response_data, MAX_DATA_SIZE, TAG_RETRY_AFTER, retry_ms);
+    *response_len = len > 0 ? (uint16_t)len : 0;
+    *status = STATUS_BUSY;
+    request_refused = true;
+    return true;
+}
+
+static int execute_command_packet(const uint8_t *packet_data, uint16_t packet_len,
+                                  uint8_t *response_packet, uint16_t response_size,
+                                  uint16_t *response_len, uint16_t response_id,
+                                  CommandScratch *scratch) {
+    // 一次扫描建立索引，IN和DA直接按索引取出
+    TlvIndex packet_index;
+    tlv_index_build(&packet_index, packet_data, packet_len);
+    
+    // 含多个IN字段的请求为批量请求
+    if (count_instructions(&packet_index) > 1) {
+        return process_batch_packet(packet_data, packet_len, response_packet, response_size,
+                                    response_len, response_id, scratch);
+    }
+    
     // 提取指令字段
     char instruction[5] = {0};
-    if (read_tlv_string(packet_data, packet_len, TAG_INSTRUCTION, instruction, sizeof(instruction)) < 0) {
+    if (tlv_index_get_string(&packet_index, TAG_INSTRUCTION, instruction, sizeof(instruction)) < 0) {
         return -1; // 无法读取指令
     }
     
     // 查找命令处理器
-    CommandHandler handler = NULL;
-    for (size_t i = 0; i < command_table_size; i++) {
-        if (strcmp(instruction, command_table[i].command) == 0) {
-            handler = command_table[i].handler;
-            break;
-        }
-    }
-    
-    if (!handler) {
+    const CommandEntry *entry = find_entry(instruction);
+    if (!entry) {
         return -1; // 未知命令
     }
     
-    // 提取DA字段
-    uint8_t request_data[MAX_DATA_SIZE];
-    uint16_t request_data_len = sizeof(request_data);
-    int da_result = read_tlv_raw(packet_data, packet_len, TAG_DATA, request_data, &request_data_len);
-    if (da_result < 0) {
+    // DA字段直接引用接收缓冲区，不拷贝
+    const uint8_t *request_data = NULL;
+    uint16_t request_data_len = 0;
+    if (tlv_index_get_view(&packet_index, TAG_DATA, &request_data, &request_data_len) < 0) {
         request_data_len = 0; // 没有DA字段
     }
     
-    // 调用命令处理器
-    uint8_t response_data[MAX_DATA_SIZE];
+    // 调用命令处理器，DA生成在调用者的工作缓冲区中
+    uint8_t *response_data = scratch->response_data;
     uint16_t response_data_len = 0;
     uint8_t status = STATUS_INTERNAL_ERROR;
     
-    int result = handler(request_data, request_data_len, response_data, &response_data_len, &status);
+    if (admission_refused(entry, response_data, &response_data_len, &status)) {
+        return build_command_response(instruction, status, response_data, response_data_len,
+                                      response_id, response_packet, response_size, response_len);
+    }
+    
+    current_instruction = instruction;
+    current_response_id = response_id;
+    int result = entry->handler(request_data, request_data_len, response_data, &response_data_len, &status);
+    current_instruction = NULL;
+    
+    if (result == COMMAND_DEFERRED) {
+        *response_len = 0;
+        return COMMAND_DEFERRED;
+    }
     if (result < 0) {
         status = STATUS_INTERNAL_ERROR;
         response_data_len = 0;
     }
     
-    // 构建响应数据包
-    uint8_t temp_buffer[MAX_DATA_SIZE];
-    uint16_t temp_len = 0;
+    return build_command_response(instruction, status, response_data, response_data_len,
+                                  response_id, response_packet, response_size, response_len);
+}
+
+// 挂起表是否有空位
+static bool pending_slot_free(void) {
+    for (uint8_t i = 0; i < MAX_PENDING_COMMANDS; i++) {
+        if (!pending_commands[i].active) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 当前上下文能否挂起命令（批量请求中不能，挂起表需有空位）
+static bool can_defer(void) {
+    return current_instruction && pending_slot_free();
+}
+
+// 挂起一个命令，响应以指定的指令和编号发送
+static bool schedule_pending(const char *instruction, uint16_t response_id,
+                             CommandCompleter completer, uint32_t delay_ms) {
+    for (uint8_t i = 0; i < MAX_PENDING_COMMANDS; i++) {
+        PendingCommand *pending = &pending_commands[i];
+        if (!pending->active) {
+            memcpy(pending->instruction, instruction, sizeof(pending->instruction));
+            pending->response_id = response_id;
+            pending->due_tick = HAL_GetTick() + delay_ms;
+            pending->completer = completer;
+            pending->link = session_link;
+            pending->active = true;
+            return true;
+        }
+    }
     
-    // 添加IN字段
-    int in_len = write_tlv_string(temp_buffer + temp_len, sizeof(temp_buffer) - temp_len, TAG_INSTRUCTION, instruction);
-    if (in_len < 0) return -1;
-    temp_len += in_len;
+    return false; // 挂起表已满
+}
+
+// 取消使用指定完成函数的挂起命令
+static void cancel_pending(CommandCompleter completer) {
+    for (uint8_t i = 0; i < MAX_PENDING_COMMANDS; i++) {
+        if (pending_commands[i].active && pending_commands[i].completer == completer) {
+            pending_commands[i].active = false;
+        }
+    }
+}
+
+// 使用指定完成函数的挂起命令立即到期（如新采样已发布）
+static void wake_pending(CommandCompleter completer) {
+    for (uint8_t i = 0; i < MAX_PENDING_COMMANDS; i++) {
+        if (pending_commands[i].active && pending_commands[i].completer == completer) {
+            pending_commands[i].due_tick = HAL_GetTick();
+        }
+    }
+}
+
+bool command_defer(CommandCompleter completer, uint32_t delay_ms) {
+    if (!completer || !current_instruction) {
+        return false;
+    }
+    return schedule_pending(current_instruction, current_response_id, completer, delay_ms);
+}
+
+// 查找最早到期的挂起命令
+static PendingCommand *find_next_pending(void) {
+    PendingCommand *next = NULL;
+    
+    for (uint8_t i = 0; i < MAX_PENDING_COMMANDS; i++) {
+        PendingCommand *pending = &pending_commands[i];
+        if (pending->active &&
+            (!next || (int32_t)(pending->due_tick - next->due_tick) < 0)) {
+            next = pending;
+        }
+    }
+    return next;
+}
+
+static uint32_t ms_until(uint32_t tick) {
+    int32_t remaining = (int32_t)(tick - HAL_GetTick());
+    return remaining > 0 ? (uint32_t)remaining : 0;
+}
+
+// 距任一链路下一次订阅推送（周期推送/报警推送）的毫秒数
+static uint32_t subscribe_next_due_ms(void) {
+    uint32_t due_ms = UINT32_MAX;
+    for (uint8_t i = 0; i < COMM_LINK_COUNT; i++) {
+        const CommandSession *state = &sessions[i];
+        if (state->subscribe_interval_ms == 0) {
+            continue;
+        }
+        uint32_t ms = state->subscribe_alarm_changed ? 0 : ms_until(state->subscribe_next_tick);
+        if (ms < due_ms) {
+            due_ms = ms;
+        }
+    }
+    return due_ms;
+}
+
+// 采样任务是否发布了尚未处理的读数
+static bool sample_pending(void) {
+    TempSample sample;
+    return temp_sampler_get(&sample) && sample.sequence != sample_sequence_seen;
+}
+
+uint32_t command_handler_next_due_ms(void) {
+    if (sample_pending() || alarm_notify_pending() || event_push_links != 0) {
+        return 0;
+    }
     
-    // 添加ST字段
-    int st_len = write_tlv_uint8(temp_buffer + temp_len, sizeof(temp_buffer) - temp_len, TAG_STATUS, status);
-    if (st_len < 0) return -1;
-    temp_len += st_len;
+    uint32_t due_ms = subscribe_next_due_ms();
     
-    // 添加DA字段（如果有响应数据）
-    if (response_data_len > 0) {
-        int da_len = write_tlv_raw(temp_buffer + temp_len, sizeof(temp_buffer) - temp_len, TAG_DATA, response_data, response_data_len);
-        if (da_len < 0) return -1;
-        temp_len += da_len;
+    PendingCommand *next = find_next_pending();
+    if (next && ms_until(next->due_tick) < due_ms) {
+        due_ms = ms_until(next->due_tick);
     }
+    return due_ms;
+}
+
+// 构建温度推送帧：IN="temp"，DA包含温度、时间戳和报警掩码（AM、AX）
+static int build_temperature_push(int16_t temperature, uint8_t *packet, uint16_t packet_size, uint16_t *packet_len) {
+    uint8_t frame_data[64];
+    uint16_t frame_len = 0;
     
-    // 构建完整的响应数据包
-    int packet_len_result = build_packet(PKT_TYPE_SLAVE_RESPONSE, 0x8000, response_id, temp_buffer, temp_len, response_packet, MAX_PACKET_SIZE);
-    if (packet_len_result < 0) {
+    int len = write_tlv_string(frame_data, sizeof(frame_data), TAG_INSTRUCTION, CMD_GET_TEMP);
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    // DA的子字段直接写在字段头之后
+    uint8_t *da = frame_data + frame_len;
+    len = write_tlv_begin(da, sizeof(frame_data) - frame_len, TAG_DATA);
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    len = write_tlv_temperature(frame_data + frame_len, sizeof(frame_data) - frame_len, TAG_TEMPERATURE, temperature, session->temperature_format);
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    len = write_tlv_uint64(frame_data + frame_len, sizeof(frame_data) - frame_len, TAG_TIMESTAMP, rtc_get_timestamp());
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    // AM只能表示规则0~7，AX为全部规则
+    len = write_tlv_uint8(frame_data + frame_len, sizeof(frame_data) - frame_len, TAG_ALARM_MASK, (uint8_t)session->subscribe_alarm_mask);
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    len = write_tlv_uint32(frame_data + frame_len, sizeof(frame_data) - frame_len, TAG_ALARM_MASK_ALL, session->subscribe_alarm_mask);
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    write_tlv_end(da, frame_data + frame_len - da - 4);
+    
+    int result = build_packet(PKT_TYPE_SLAVE_REQUEST, communication_next_packet_id(), 0, frame_data, frame_len, packet, packet_size);
+    if (result < 0) {
         return -1;
     }
     
-    *response_len = packet_len_result;
-    return 0;
+    *packet_len = result;
+    return 1;
 }
 
-// Ping命令处理
-int handle_ping(const uint8_t *request_data, uint16_t request_len, 
-               uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
-    (void)request_data;
-    (void)request_len;
+// 构建流推送帧：载荷为全部传感器的int16读数（小端，0.1°C，读取失败为TEMP_INVALID），
+// 与会话的温度表示无关；报警掩码只在报警状态变化时以完整的温度推送发出
+static int build_stream_push(const TempSample *sample, uint8_t *packet, uint16_t packet_size, uint16_t *packet_len) {
+    uint8_t readings[TEMP_MAX_SENSORS * 2];
+    uint8_t count = sample->sensor_count < TEMP_MAX_SENSORS ? sample->sensor_count : TEMP_MAX_SENSORS;
+    for (uint8_t i = 0; i < count; i++) {
+        readings[2 * i] = (uint8_t)sample->temperatures[i];
+        readings[2 * i + 1] = (uint8_t)((uint16_t)sample->temperatures[i] >> 8);
+    }
     
-    *status = STATUS_OK;
-    *response_len = 0; // Ping命令无返回数据
-    return 0;
+    int result = frame_writer_stream(packet, packet_size, session->stream_id, session->stream_sequence,
+                                     readings, (uint16_t)(count * 2));
+    if (result < 0) {
+        return -1;
+    }
+    session->stream_sequence++;
+    *packet_len = result;
+    return 1;
 }
 
-// 获取温度命令处理
-int handle_get_temp(const uint8_t *request_data, uint16_t request_len, 
-                   uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
-    (void)request_data;
-    (void)request_len;
+// 构建报警事件推送帧：IN="gevt"，DA为只有一项的EV（结构同gevt）和当前的AX
+static int build_alarm_event_push(const AlarmEvent *event, uint8_t *packet, uint16_t packet_size, uint16_t *packet_len) {
+    uint8_t frame_data[80];
+    uint16_t frame_len = 0;
     
-    if (!temperature_is_sensor_ok()) {
-        *status = STATUS_SENSOR_ERROR;
-        *response_len = 0;
+    int len = write_tlv_string(frame_data, sizeof(frame_data), TAG_INSTRUCTION, CMD_GET_EVENTS);
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    uint8_t *da = frame_data + frame_len;
+    len = write_tlv_begin(da, sizeof(frame_data) - frame_len, TAG_DATA);
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    uint8_t *list = frame_data + frame_len;
+    len = write_tlv_begin(list, sizeof(frame_data) - frame_len, TAG_EVENT_LIST);
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    uint8_t *item = frame_data + frame_len;
+    len = write_tlv_begin(item, sizeof(frame_data) - frame_len, TAG_ALARM_ITEM);
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    len = write_tlv_uint64(frame_data + frame_len, sizeof(frame_data) - frame_len, TAG_TIMESTAMP, event->timestamp);
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    len = write_tlv_uint16(frame_data + frame_len, sizeof(frame_data) - frame_len, TAG_MILLISECOND, event->millisecond);
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    len = write_tlv_uint8(frame_data + frame_len, sizeof(frame_data) - frame_len, TAG_ALARM_ID, event->channel);
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    len = write_tlv_uint8(frame_data + frame_len, sizeof(frame_data) - frame_len, TAG_EVENT_TYPE, event->type);
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    len = write_tlv_uint8(frame_data + frame_len, sizeof(frame_data) - frame_len, TAG_SENSOR, event->sensor);
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    len = write_tlv_temperature(frame_data + frame_len, sizeof(frame_data) - frame_len, TAG_TEMPERATURE, event->temperature, session->temperature_format);
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    write_tlv_end(item, frame_data + frame_len - item - 4);
+    write_tlv_end(list, frame_data + frame_len - list - 4);
+    
+    len = write_tlv_uint32(frame_data + frame_len, sizeof(frame_data) - frame_len, TAG_ALARM_MASK_ALL, alarm_get_active_mask());
+    if (len < 0) return -1;
+    frame_len += len;
+    
+    write_tlv_end(da, frame_data + frame_len - da - 4);
+    
+    int result = build_packet(PKT_TYPE_SLAVE_REQUEST, communication_next_packet_id(), 0, frame_data, frame_len, packet, packet_size);
+    if (result < 0) {
         return -1;
     }
     
-    float temperature = temperature_get_current();
-    if (temperature <= -999.0f) {
-        *status = STATUS_SENSOR_ERROR;
-        *response_len = 0;
-        return -1;
+    *packet_len = result;
+    return 1;
+}
+
+// 向开启了事件推送的链路逐条推送报警通知，每次调用推送一条链路；
+// 没有链路开启事件推送时丢弃队列中的通知
+static int poll_alarm_events(uint8_t *packet, uint16_t packet_size, uint16_t *packet_len, uint8_t *link) {
+    if (event_push_links == 0) {
+        uint8_t links = 0;
+        for (uint8_t i = 0; i < COMM_LINK_COUNT; i++) {
+            if (sessions[i].subscribe_alarm_events) {
+                links |= (uint8_t)(1u << i);
+            }
+        }
+        if (links == 0) {
+            while (alarm_notify_pop(&event_push)) {
+            }
+            return 0;
+        }
+        if (!alarm_notify_pop(&event_push)) {
+            return 0;
+        }
+        event_push_links = links;
+    }
+    
+    uint8_t next = 0;
+    while ((event_push_links & (1u << next)) == 0) {
+        next++;
+    }
+    event_push_links &= (uint8_t)~(1u << next);
+    select_session(next);
+    *link = next;
+    return build_alarm_event_push(&event_push, packet, packet_size, packet_len);
+}
+
+// 记录新的温度读数，报警状态变化时标记各订阅链路立即推送
+static void subscribe_note_temperature(int16_t temperature) {
+    uint32_t mask = alarm_get_active_mask();
+    
+    subscribe_last_temperature = temperature;
+    for (uint8_t i = 0; i < COMM_LINK_COUNT; i++) {
+        CommandSession *state = &sessions[i];
+        if (state->subscribe_interval_ms != 0 && mask != state->subscribe_alarm_mask) {
+            state->subscribe_alarm_changed = true;
+        }
+        state->subscribe_alarm_mask = mask;
+    }
+}
+
+// 处理采样任务发布的新读数（报警已由采样任务检查）
+static void process_sample(void) {
+    TempSample sample;
+    if (!temp_sampler_get(&sample) || sample.sequence == sample_sequence_seen) {
+        return;
     }
+    sample_sequence_seen = sample.sequence;
     
-    // 检查温度报警
-    alarm_check_temperature(temperature);
+    // 订阅推送0号传感器，报警状态变化时立即推送
+    if (sample.sensor_count > 0 && sample.temperatures[0] != TEMP_INVALID) {
+        subscribe_note_temperature(sample.temperatures[0]);
+    }
+    
+    // 等待新采样的请求立即检查
+    wake_pending(complete_get_temp);
+    wake_pending(complete_set_resolution);
+}
+
+// 推送一条链路的订阅，没有到期时返回0
+static int poll_link_subscription(uint8_t *packet, uint16_t packet_size, uint16_t *packet_len) {
+    if (session->subscribe_interval_ms == 0) {
+        return 0;
+    }
     
-    // 记录温度日志
-    temp_log_add_entry(temperature);
+    // 报警状态变化：立即推送最近一次读数
+    if (session->subscribe_alarm_changed) {
+        session->subscribe_alarm_changed = false;
+        return build_temperature_push(subscribe_last_temperature, packet, packet_size, packet_len);
+    }
     
-    // 构建响应数据
-    int temp_len = write_tlv_float32(response_data, MAX_DATA_SIZE, TAG_TEMPERATURE, temperature);
-    if (temp_len < 0) {
-        *status = STATUS_INTERNAL_ERROR;
-        *response_len = 0;
-        return -1;
+    if (ms_until(session->subscribe_next_tick) > 0) {
+        return 0;
     }
     
-    *status = STATUS_OK;
-    *response_len = temp_len;
+    // 落后太多时从当前时刻重新计时
+    session->subscribe_next_tick += session->subscribe_interval_ms;
+    if (ms_until(session->subscribe_next_tick) == 0) {
+        session->subscribe_next_tick = HAL_GetTick() + session->subscribe_interval_ms;
+    }
+    
+    // 流帧推送全部传感器；主机之后换用了转义组帧时改回完整的数据包
+    TempSample sample;
+    if (session->stream_id != 0 && PROTOCOL_FRAMING(protocol_get_tx_version()) == PROTOCOL_VERSION_COBS) {
+        if (!temp_sampler_get(&sample) || sample.sensor_count == 0) {
+            return 0;
+        }
+        return build_stream_push(&sample, packet, packet_size, packet_len);
+    }
+    
+    // 推送采样任务的最近一次读数（0号传感器）
+    if (!temp_sampler_get(&sample) || sample.sensor_count == 0 || sample.temperatures[0] == TEMP_INVALID) {
+        return 0; // 暂无有效读数，本周期不推送
+    }
+    
+    return build_temperature_push(sample.temperatures[0], packet, packet_size, packet_len);
+}
+
+// 按链路顺序推送第一个到期的订阅
+static int poll_subscription(uint8_t *packet, uint16_t packet_size, uint16_t *packet_len, uint8_t *link) {
+    for (uint8_t i = 0; i < COMM_LINK_COUNT; i++) {
+        if (sessions[i].subscribe_interval_ms == 0) {
+            continue;
+        }
+        select_session(i);
+        int result = poll_link_subscription(packet, packet_size, packet_len);
+        if (result != 0) {
+            *link = i;
+            return result;
+        }
+    }
     return 0;
 }
 
-// 获取RTC日期命令处理
-int handle_get_rtc_date(const uint8_t *request_data, uint16_t request_len, 
-                       uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
-    (void)request_data;
-    (void)request_len;
-    
-    if (!rtc_is_initialized()) {
-        *status = STATUS_NOT_INITIALIZED;
-        *response_len = 0;
-        return -1;
+int command_handler_poll(uint8_t *response_packet, uint16_t response_size, uint16_t *response_len,
+                         uint8_t *link, CommandScratch *scratch) {
+    process_sample();
+    
+    // 报警通知先于挂起命令和周期推送发出
+    if (alarm_notify_pending() || event_push_links != 0) {
+        int result = poll_alarm_events(response_packet, response_size, response_len, link);
+        if (result != 0) {
+            return result;
+        }
     }
     
-    RTCDate date;
-    if (!rtc_get_date(&date)) {
-        *status = STATUS_NOT_INITIALIZED;
-        *response_len = 0;
-        return -1;
+    PendingCommand *next = find_next_pending();
+    if (!next || ms_until(next->due_tick) > 0) {
+        return poll_subscription(response_packet, response_size, response_len, link);
     }
     
-    // 构建响应数据
-    uint16_t offset = 0;
+    PendingCommand pending = *next;
+    next->active = false;
+    select_session(pending.link);
+    *link = pending.link;
     
-    int yy_len = write_tlv_uint8(response_data + offset, MAX_DATA_SIZE - offset, TAG_YEAR, date.year);
-    if (yy_len < 0) goto error;
-    offset += yy_len;
+    uint8_t *response_data = scratch->response_data;
+    uint16_t response_data_len = 0;
+    uint8_t status = STATUS_INTERNAL_ERROR;
     
-    int mm_len = write_tlv_uint8(response_data + offset, MAX_DATA_SIZE - offset, TAG_MONTH, date.month);
-    if (mm_len < 0) goto error;
-    offset += mm_len;
+    // 完成函数中可再次挂起（如分片传输的下一片）
+    current_instruction = pending.instruction;
+    current_response_id = pending.response_id;
+    int result = pending.completer(response_data, &response_data_len, &status);
+    current_instruction = NULL;
     
-    int dd_len = write_tlv_uint8(response_data + offset, MAX_DATA_SIZE - offset, TAG_DAY, date.day);
-    if (dd_len < 0) goto error;
-    offset += dd_len;
+    if (result == COMMAND_DEFERRED) {
+        return 0; // 完成函数已重新挂起，响应稍后发送
+    }
     
-    int wk_len = write_tlv_uint8(response_data + offset, MAX_DATA_SIZE - offset, TAG_WEEKDAY, date.weekday);
-    if (wk_len < 0) goto error;
-    offset += wk_len;
+    if (result < 0) {
+        status = STATUS_INTERNAL_ERROR;
+        response_data_len = 0;
+    }
     
-    *status = STATUS_OK;
-    *response_len = offset;
-    return 0;
+    if (build_command_response(pending.instruction, status, response_data, response_data_len,
+                               pending.response_id, response_packet, response_size, response_len) < 0) {
+        response_cache_drop(pending.link, pending.response_id);
+        return -1;
+    }
+    cache_response(pending.link, pending.response_id, response_packet, *response_len);
+    return 1;
+}
+
+// 1字节指令为编号，直接索引命令表；4字符指令按名称散列查找
+static const CommandEntry *find_entry(const char *instruction) {
+    if (instruction[0] != '\0' && instruction[1] == '\0') {
+        uint8_t opcode = (uint8_t)instruction[0];
+        if (opcode < command_table_size && command_table[opcode].handler) {
+            return &command_table[opcode];
+        }
+        return NULL;
+    }
     
-error:
-    *status = STATUS_INTERNAL_ERROR;
-    *response_len = 0;
-    return -1;
+    // instruction至少有5字节（4字符+结束符），不足4字符时后面是'\0'，不会匹配任何名称
+    uint32_t key = command_key(instruction);
+    for (uint32_t slot = command_hash_slot(key); command_hash[slot] != 0;
+         slot = (slot + 1) & (COMMAND_HASH_SIZE - 1)) {
+        const CommandEntry *entry = &command_table[command_hash[slot]];
+        if (command_key(entry->command) == key) {
+            return entry;
+        }
+    }
+    return NULL;
 }
 
-// 获取RTC时间命令处理
-int handle_get_rtc_time(const uint8_t *request_data, uint16_t request_len, 
-                       uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
-    (void)request_data;
-    (void)request_len;
+uint8_t command_handler_request_class(const uint8_t *packet_data, uint16_t packet_len, uint8_t *opcode) {
+    TlvIndex packet_index;
+    tlv_index_build(&packet_index, packet_data, packet_len);
+    
+    uint8_t command_class = COMMAND_CLASS_INTERACTIVE;
+    uint8_t instructions = 0;
+    *opcode = 0;
+    for (uint8_t i = 0; i < packet_index.count; i++) {
+        const TlvField *field = &packet_index.fields[i];
+        if (memcmp(field->tag, TAG_INSTRUCTION, 2) != 0) {
+            continue;
+        }
+        instructions++;
+        
+        char name[5] = {0};
+        if (field->length >= sizeof(name)) {
+            continue;
+        }
+        memcpy(name, packet_data + field->offset, field->length);
+        
+        const CommandEntry *entry = find_entry(name);
+        if (entry) {
+            if (entry->command_class == COMMAND_CLASS_BULK) {
+                command_class = COMMAND_CLASS_BULK;
+            }
+            *opcode = (uint8_t)(entry - command_table);
+        }
+    }
     
-    if (!rtc_is_initialized()) {
-        *status = STATUS_NOT_INITIALIZED;
+    if (instructions != 1) {
+        *opcode = 0;
+    }
+    return command_class;
+}
+
+// 逐个读取顶层TLV，返回false表示已结束或格式错误
+static bool next_tlv(const uint8_t *buffer, uint16_t buffer_size, uint16_t *offset,
+                     const uint8_t **tag, const uint8_t **value, uint16_t *value_len) {
+    if (*offset + 4 > buffer_size) {
+        return false;
+    }
+    
+    uint16_t length;
+    memcpy(&length, buffer + *offset + 2, 2);
+    if (*offset + 4 + length > buffer_size) {
+        return false;
+    }
+    
+    *tag = buffer + *offset;
+    *value = buffer + *offset + 4;
+    *value_len = length;
+    *offset += 4 + length;
+    return true;
+}
+
+static uint8_t count_instructions(const TlvIndex *index) {
+    uint8_t count = 0;
+    
+    for (uint8_t i = 0; i < index->count; i++) {
+        if (memcmp(index->fields[i].tag, TAG_INSTRUCTION, 2) == 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// 执行批量请求中的一条命令，并把IN/ST/DA结果追加到scratch->batch_data
+static int run_batch_command(const uint8_t *instruction, uint16_t instruction_len,
+                             const uint8_t *request_data, uint16_t request_len,
+                             CommandScratch *scratch, uint16_t *batch_len) {
+    char name[5] = {0};
+    uint8_t *response_data = scratch->response_data;
+    uint16_t response_data_len = 0;
+    uint8_t status = STATUS_INVALID_PARAM; // 未知命令
+    
+    if (instruction_len < sizeof(name)) {
+        memcpy(name, instruction, instruction_len);
+        
+        const CommandEntry *entry = find_entry(name);
+        if (entry && !admission_refused(entry, response_data, &response_data_len, &status)) {
+            // 批量请求中不挂起命令（current_instruction为NULL），慢命令会阻塞完成
+            status = STATUS_INTERNAL_ERROR;
+            if (entry->handler(request_data, request_len, response_data, &response_data_len, &status) < 0) {
+                status = STATUS_INTERNAL_ERROR;
+                response_data_len = 0;
+            }
+        }
+    }
+    
+    return append_command_result(scratch->batch_data, sizeof(scratch->batch_data), batch_len, name, status,
+                                 response_data, response_data_len);
+}
+
+// 批量请求：依次执行每组 IN[+DA]，结果按请求顺序放入同一个响应帧
+static int process_batch_packet(const uint8_t *packet_data, uint16_t packet_len,
+                                uint8_t *response_packet, uint16_t response_size,
+                                uint16_t *response_len, uint16_t response_id,
+                                CommandScratch *scratch) {
+    uint16_t batch_len = 0;
+    uint8_t executed = 0;
+    
+    uint16_t offset = 0;
+    const uint8_t *tag, *value;
+    uint16_t value_len;
+    const uint8_t *instruction = NULL;
+    uint16_t instruction_len = 0;
+    
+    while (next_tlv(packet_data, packet_len, &offset, &tag, &value, &value_len)) {
+        if (memcmp(tag, TAG_INSTRUCTION, 2) == 0) {
+            // 上一条命令没有DA字段
+            if (instruction) {
+                if (run_batch_command(instruction, instruction_len, NULL, 0,
+                                      scratch, &batch_len) < 0) {
+                    return -1;
+                }
+                executed++;
+            }
+            instruction = value;
+            instruction_len = value_len;
+        } else if (memcmp(tag, TAG_DATA, 2) == 0 && instruction) {
+            if (run_batch_command(instruction, instruction_len, value, value_len,
+                                  scratch, &batch_len) < 0) {
+                return -1;
+            }
+            executed++;
+            instruction = NULL;
+        }
+        
+        if (executed >= MAX_BATCH_COMMANDS) {
+            break;
+        }
+    }
+    
+    if (instruction && executed < MAX_BATCH_COMMANDS) {
+        if (run_batch_command(instruction, instruction_len, NULL, 0,
+                              scratch, &batch_len) < 0) {
+            return -1;
+        }
+    }
+    
+    int packet_len_result = build_packet(PKT_TYPE_SLAVE_RESPONSE, 0x8000, response_id, scratch->batch_data, batch_len, response_packet, response_size);
+    if (packet_len_result < 0) {
+        return -1;
+    }
+    
+    *response_len = packet_len_result;
+    return 0;
+}
+
+// 追加一组IN/ST/DA字段
+static int append_command_result(uint8_t *buffer, uint16_t buffer_size, uint16_t *offset,
+                                 const char *instruction, uint8_t status,
+                                 const uint8_t *response_data, uint16_t response_data_len) {
+    uint16_t len = *offset;
+    
+    // 添加IN字段
+    int in_len = write_tlv_string(buffer + len, buffer_size - len, TAG_INSTRUCTION, instruction);
+    if (in_len < 0) return -1;
+    len += in_len;
+    
+    // 添加ST字段
+    int st_len = write_tlv_uint8(buffer + len, buffer_size - len, TAG_STATUS, status);
+    if (st_len < 0) return -1;
+    len += st_len;
+    
+    // 添加DA字段（如果有响应数据）
+    if (response_data_len > 0) {
+        int da_len = write_tlv_raw(buffer + len, buffer_size - len, TAG_DATA, response_data, response_data_len);
+        if (da_len < 0) return -1;
+        len += da_len;
+    }
+    
+    *offset = len;
+    return 0;
+}
+
+_Static_assert(offsetof(CommandScratch, response_data) == RESPONSE_PREFIX_SIZE,
+               "response_prefix须紧接在response_data之前");
+
+// 在data之前倒序写入IN、ST和DA头（没有DA时省略），返回写入的长度；
+// 各字段的位置固定，逐字节写入，不经过通用的TLV编码
+static uint16_t write_response_prefix(uint8_t *data, const char *instruction, uint8_t status, uint16_t data_len) {
+    uint8_t *p = data;
+    if (data_len > 0) {
+        *--p = (uint8_t)(data_len >> 8);
+        *--p = (uint8_t)data_len;
+        *--p = TAG_DATA[1];
+        *--p = TAG_DATA[0];
+    }
+    *--p = status;
+    *--p = 0;
+    *--p = 1;
+    *--p = TAG_STATUS[1];
+    *--p = TAG_STATUS[0];
+    // 1字节编号或4字符名称
+    uint8_t name_len = (instruction[0] != '\0' && instruction[1] == '\0') ? 1 : 4;
+    p -= name_len;
+    memcpy(p, instruction, name_len);
+    *--p = 0;
+    *--p = name_len;
+    *--p = TAG_INSTRUCTION[1];
+    *--p = TAG_INSTRUCTION[0];
+    return (uint16_t)(data - p);
+}
+
+// 构建包含IN/ST/DA字段的响应数据包，response_data为scratch->response_data
+// （之前留有RESPONSE_PREFIX_SIZE字节）：IN/ST/DA头就地写在DA之前，整段一次编码和计算CRC。
+// 紧凑会话中只在DA的值之前写1字节ST，主机按response_id对应请求
+static int build_command_response(const char *instruction, uint8_t status,
+                                  uint8_t *response_data, uint16_t response_data_len,
+                                  uint16_t response_id, uint8_t *response_packet,
+                                  uint16_t response_size, uint16_t *response_len) {
+    uint16_t prefix_len = 1;
+    if (session->compact) {
+        response_data[-1] = status;
+    } else {
+        prefix_len = write_response_prefix(response_data, instruction, status, response_data_len);
+    }
+    
+    PacketHeader header = {
+        .version = protocol_get_tx_version(),
+        .address = protocol_get_address(),
+        .type = session->compact ? PKT_TYPE_SLAVE_COMPACT : PKT_TYPE_SLAVE_RESPONSE,
+        .packet_id = 0x8000,
+        .response_id = response_id,
+        .data_length = (uint16_t)(prefix_len + response_data_len),
+    };
+    if (header.data_length > MAX_DATA_SIZE) {
+        return -1;
+    }
+    
+    FrameWriter writer;
+    frame_writer_begin(&writer, response_packet, response_size, &header);
+    frame_writer_write(&writer, response_data - prefix_len, header.data_length);
+    int packet_len_result = frame_writer_finish(&writer);
+    if (packet_len_result < 0) {
+        return -1;
+    }
+    
+    *response_len = packet_len_result;
+    return 0;
+}
+
+// Ping命令处理
+// 可选的TF字段设置本次会话的温度表示，CM字段开关紧凑响应（本次响应起生效），设置后回复当前值；
+// 始终回复字段表版本SV和传感器数SC；
+// CB不为0时另带能力列表，主机一次往返即可选用双方都支持的最快方式
+// 带HT时原样返回，另带RX、TT：从机收完请求帧和构建完响应的时刻（micros()，微秒，约71.6分钟回绕），
+// 往返时间减去TT-RX即为链路上的时间（含发送响应的排队）；
+// 各指令的耗时参考：每条3字节，指令编号和99%的请求在从机上花费的毫秒数（uint16小端，
+// 排队和执行加发送，向上取整）；样本不足PING_LATENCY_MIN_SAMPLES的编号不列出
+#define PING_LATENCY_PERCENT     99
+#define PING_LATENCY_MIN_SAMPLES 8
+
+// 能力列表：包头版本、最大帧长、指令编号上限、glog的CP格式、推送方式、可协商的波特率和可选功能
+static int write_capabilities(uint8_t *buffer, uint16_t buffer_size) {
+    static const uint8_t versions[] = {PROTOCOL_VERSION, PROTOCOL_VERSION_COBS,
+                                       PROTOCOL_VERSION_ADDR, PROTOCOL_VERSION_COBS_ADDR};
+    static const uint8_t log_formats[] = {LOG_FORMAT_TLV, LOG_FORMAT_DELTA, LOG_FORMAT_PACKED};
+    static const uint32_t baud_rates[COMM_BAUD_RATE_COUNT] = COMM_BAUD_RATES;
+    
+    // CB头 + PV、LF、BR三个变长字段 + MP(6)、OP/PM/FT(各5)
+    const uint16_t total_len = 4 + 3 * 4 + sizeof(versions) + sizeof(log_formats) + sizeof(baud_rates) + 6 + 3 * 5;
+    if (buffer_size < total_len) {
+        return -1;
+    }
+    int header_len = write_tlv_begin(buffer, buffer_size, TAG_CAPABILITIES);
+    uint16_t len = (uint16_t)header_len;
+    
+    len += write_tlv_raw(buffer + len, buffer_size - len, TAG_PROTOCOL_VERSIONS, versions, sizeof(versions));
+    len += write_tlv_uint16(buffer + len, buffer_size - len, TAG_MAX_PACKET, MAX_PACKET_SIZE);
+    len += write_tlv_uint8(buffer + len, buffer_size - len, TAG_OPCODE_MAX, COMMAND_COUNT);
+    len += write_tlv_raw(buffer + len, buffer_size - len, TAG_LOG_FORMATS, log_formats, sizeof(log_formats));
+    len += write_tlv_uint8(buffer + len, buffer_size - len, TAG_PUSH_MODES,
+                           CAP_PUSH_PERIODIC | CAP_PUSH_ALARM_EVENTS | CAP_PUSH_LOG_FRAGMENTS | CAP_PUSH_STREAM);
+    
+    uint8_t *br = buffer + len;
+    len += write_tlv_begin(br, buffer_size - len, TAG_BAUD_RATE);
+    for (uint8_t i = 0; i < COMM_BAUD_RATE_COUNT; i++) {
+        for (uint8_t b = 0; b < 4; b++) {
+            buffer[len++] = (uint8_t)(baud_rates[i] >> (8 * b));
+        }
+    }
+    write_tlv_end(br, sizeof(baud_rates));
+    
+    len += write_tlv_uint8(buffer + len, buffer_size - len, TAG_FEATURES, CAP_FEATURE_COMPACT |
+                           (COMM_GATEWAY ? CAP_FEATURE_GATEWAY : 0) | (FW_UPDATE ? CAP_FEATURE_FW_UPDATE : 0));
+    
+    write_tlv_end(buffer, len - header_len);
+    return len;
+}
+
+static int write_latency_table(uint8_t *buffer, uint16_t buffer_size) {
+    int header_len = write_tlv_begin(buffer, buffer_size, TAG_LATENCY);
+    if (header_len < 0) {
+        return -1;
+    }
+    uint16_t len = (uint16_t)header_len;
+    
+    for (uint8_t opcode = 0; opcode < COMMAND_STATS_OPCODES; opcode++) {
+        CommandStats stats;
+        command_stats_get(opcode, &stats);
+        uint32_t samples = 0;
+        for (uint8_t i = 0; i < COMMAND_STATS_BUCKETS; i++) {
+            samples += stats.queued_hist[i];
+        }
+        if (samples < PING_LATENCY_MIN_SAMPLES) {
+            continue;
+        }
+        if (len + 3 > buffer_size) {
+            return -1;
+        }
+        
+        uint32_t us = command_stats_percentile_us(stats.queued_hist, stats.queued_max_us, PING_LATENCY_PERCENT) +
+                      command_stats_percentile_us(stats.transmit_hist, stats.transmit_max_us, PING_LATENCY_PERCENT);
+        uint32_t ms = (us + 999U) / 1000U;
+        if (ms > UINT16_MAX) {
+            ms = UINT16_MAX;
+        }
+        buffer[len++] = opcode;
+        buffer[len++] = (uint8_t)(ms & 0xFF);
+        buffer[len++] = (uint8_t)(ms >> 8);
+    }
+    write_tlv_end(buffer, len - header_len);
+    return len;
+}
+
+int handle_ping(const uint8_t *request_data, uint16_t request_len, 
+               uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    *response_len = 0;
+    
+    TlvBinding fields;
+    if (tlv_schema_bind(tlv_schema_request(OP_PING), request_data, request_len, &fields) < 0) {
+        *status = STATUS_INVALID_PARAM;
+        return -1;
+    }
+    
+    uint16_t len = 0;
+    uint8_t format;
+    if (tlv_binding_get_uint8(&fields, PING_REQ_TF, &format) > 0) {
+        if (format != TEMP_FORMAT_FLOAT32 && format != TEMP_FORMAT_INT16) {
+            *status = STATUS_INVALID_PARAM;
+            return -1;
+        }
+        session->temperature_format = format;
+        
+        int tf_len = write_tlv_uint8(response_data, MAX_DATA_SIZE, TAG_TEMP_FORMAT, session->temperature_format);
+        if (tf_len < 0) goto error;
+        len += tf_len;
+    }
+    
+    uint8_t compact;
+    if (tlv_binding_get_uint8(&fields, PING_REQ_CM, &compact) > 0) {
+        if (compact > 1) {
+            *status = STATUS_INVALID_PARAM;
+            return -1;
+        }
+        session->compact = compact != 0;
+        
+        int cm_len = write_tlv_uint8(response_data + len, MAX_DATA_SIZE - len, TAG_COMPACT, compact);
+        if (cm_len < 0) goto error;
+        len += cm_len;
+    }
+    
+    int sv_len = write_tlv_uint8(response_data + len, MAX_DATA_SIZE - len, TAG_SCHEMA_VERSION, TLV_SCHEMA_VERSION);
+    if (sv_len < 0) goto error;
+    len += sv_len;
+    
+    int sc_len = write_tlv_uint8(response_data + len, MAX_DATA_SIZE - len, TAG_SENSOR_COUNT, temperature_sensor_count());
+    if (sc_len < 0) goto error;
+    len += sc_len;
+    
+    uint8_t latency = 0;
+    if (tlv_binding_get_uint8(&fields, PING_REQ_LT, &latency) > 0 && latency != 0) {
+        int lt_len = write_latency_table(response_data + len, RESPONSE_DATA_BUDGET - len);
+        if (lt_len < 0) goto error;
+        len += lt_len;
+    }
+    
+    uint8_t capabilities = 0;
+    if (tlv_binding_get_uint8(&fields, PING_REQ_CB, &capabilities) > 0 && capabilities != 0) {
+        int cb_len = write_capabilities(response_data + len, RESPONSE_DATA_BUDGET - len);
+        if (cb_len < 0) goto error;
+        len += cb_len;
+    }
+    
+    // 时间戳放在最后，TT尽量接近发送
+    uint64_t host_time;
+    if (tlv_binding_get_uint64(&fields, PING_REQ_HT, &host_time) > 0) {
+        uint32_t now_us = micros();
+        int ht_len = write_tlv_uint64(response_data + len, MAX_DATA_SIZE - len, TAG_HOST_TIME, host_time);
+        if (ht_len < 0) goto error;
+        len += ht_len;
+        int rx_len = write_tlv_uint32(response_data + len, MAX_DATA_SIZE - len, TAG_DEVICE_RX,
+                                      now_us - communication_request_age_us());
+        if (rx_len < 0) goto error;
+        len += rx_len;
+        int tt_len = write_tlv_uint32(response_data + len, MAX_DATA_SIZE - len, TAG_DEVICE_TX, micros());
+        if (tt_len < 0) goto error;
+        len += tt_len;
+    }
+    
+    *status = STATUS_OK;
+    *response_len = len;
+    return 0;
+    
+error:
+    *status = STATUS_INTERNAL_ERROR;
+    *response_len = 0;
+    return -1;
+}
+
+// 获取温度命令处理
+int handle_get_temp(const uint8_t *request_data, uint16_t request_len, 
+                   uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    TlvBinding binding;
+    uint8_t fresh = 0;
+    uint8_t sensor = 0;
+    uint32_t max_age = 0;
+    if (tlv_schema_bind(tlv_schema_request(OP_GET_TEMP), request_data, request_len, &binding) < 0 ||
+        (tlv_binding_has(&binding, TEMP_REQ_FR) &&
+         (tlv_binding_get_uint8(&binding, TEMP_REQ_FR, &fresh) < 0 || fresh > 1)) ||
+        (tlv_binding_has(&binding, TEMP_REQ_SN) &&
+         (tlv_binding_get_uint8(&binding, TEMP_REQ_SN, &sensor) < 0 || sensor >= temperature_sensor_count())) ||
+        (tlv_binding_has(&binding, TEMP_REQ_MA) && tlv_binding_get_uint32(&binding, TEMP_REQ_MA, &max_age) < 0)) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    temp_request_sensor = sensor;
+    
+    // 先处理尚未处理的采样
+    process_sample();
+    
+    // 默认直接返回采样任务缓存的最近一次读数；带MA时缓存不超过MA毫秒才直接返回
+    TempSample sample;
+    bool cached = !fresh && temp_sampler_get(&sample);
+    bool too_old = cached && tlv_binding_has(&binding, TEMP_REQ_MA) &&
+                   temp_sample_age_ms(&sample, HAL_GetTick()) > max_age;
+    if (cached && !too_old) {
+        return report_temperature(&sample, response_data, response_len, status);
+    }
+    
+    // 要求新读数（或上电后尚无采样）：等待请求之后开始的转换完成；
+    // 缓存过旧时正在进行的转换也比缓存新，等待比缓存更新的任一次采样
+    if (fresh) {
+        fresh_after_sequence = temp_sampler_request_fresh();
+    } else if (too_old) {
+        fresh_after_sequence = sample.sequence;
+        temp_sampler_request_fresh();
+    }
+    int result = await_fresh_sample(complete_get_temp, &sample);
+    if (result == 0) {
+        return report_temperature(&sample, response_data, response_len, status);
+    }
+    return fail_fresh_sample(result, response_len, status);
+}
+
+// 开始等待新采样：挂起到超时，新采样发布时由process_sample()提前唤醒completer；
+// 无法挂起（批量请求或挂起表已满）时阻塞等待采样任务
+// 返回0表示*sample为新采样，COMMAND_DEFERRED表示已挂起，-1表示超时
+static int await_fresh_sample(CommandCompleter completer, TempSample *sample) {
+    fresh_deadline_tick = HAL_GetTick() + TEMP_SAMPLE_TIMEOUT_MS;
+    if (command_defer(completer, TEMP_SAMPLE_TIMEOUT_MS)) {
+        return COMMAND_DEFERRED;
+    }
+    
+    while (!(temp_sampler_get(sample) && sample->sequence > fresh_after_sequence)) {
+        if (ms_until(fresh_deadline_tick) == 0) {
+            return -1;
+        }
+        osDelay(TEMP_FRESH_POLL_MS);
+    }
+    return 0;
+}
+
+// 在completer中检查新采样，发布的是请求之前开始的转换时继续挂起
+// 返回值同await_fresh_sample()
+static int check_fresh_sample(CommandCompleter completer, TempSample *sample) {
+    if (temp_sampler_get(sample) && sample->sequence > fresh_after_sequence) {
+        return 0;
+    }
+    
+    uint32_t remaining_ms = ms_until(fresh_deadline_tick);
+    if (remaining_ms > 0 && command_defer(completer, remaining_ms)) {
+        return COMMAND_DEFERRED;
+    }
+    return -1;
+}
+
+// 未拿到新采样时的返回：已挂起则暂无响应，超时则为传感器错误
+static int fail_fresh_sample(int result, uint16_t *response_len, uint8_t *status) {
+    *response_len = 0;
+    if (result == COMMAND_DEFERRED) {
+        return COMMAND_DEFERRED;
+    }
+    *status = STATUS_SENSOR_ERROR;
+    return -1;
+}
+
+// 新采样发布或等待超时后生成temp响应
+static int complete_get_temp(uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    TempSample sample;
+    int result = check_fresh_sample(complete_get_temp, &sample);
+    if (result == 0) {
+        return report_temperature(&sample, response_data, response_len, status);
+    }
+    return fail_fresh_sample(result, response_len, status);
+}
+
+static int report_temperature(const TempSample *sample, uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    uint8_t sensor = temp_request_sensor;
+    if (sensor >= sample->sensor_count || sample->temperatures[sensor] == TEMP_INVALID) {
+        *status = STATUS_SENSOR_ERROR;
+        *response_len = 0;
+        return -1;
+    }
+    int16_t temperature = sample->temperatures[sensor];
+    int16_t raw = sample->raw[sensor];
+    
+    // 报警已由采样任务检查，日志由记录任务按间隔写入
+    // 构建响应数据：滤波后的温度、读数的时效、传感器编号和原始温度
+    uint16_t len = 0;
+    int temp_len = write_tlv_temperature(response_data, MAX_DATA_SIZE, TAG_TEMPERATURE, temperature, session->temperature_format);
+    if (temp_len < 0) goto error;
+    len += temp_len;
+    
+    int age_len = write_tlv_uint32(response_data + len, MAX_DATA_SIZE - len, TAG_SAMPLE_AGE,
+                                   temp_sample_age_ms(sample, HAL_GetTick()));
+    if (age_len < 0) goto error;
+    len += age_len;
+    
+    int sn_len = write_tlv_uint8(response_data + len, MAX_DATA_SIZE - len, TAG_SENSOR, sensor);
+    if (sn_len < 0) goto error;
+    len += sn_len;
+    
+    int tr_len = write_tlv_temperature(response_data + len, MAX_DATA_SIZE - len, TAG_RAW_TEMPERATURE, raw, session->temperature_format);
+    if (tr_len < 0) goto error;
+    len += tr_len;
+    
+    *status = STATUS_OK;
+    *response_len = len;
+    return 0;
+    
+error:
+    *status = STATUS_INTERNAL_ERROR;
+    *response_len = 0;
+    return -1;
+}
+
+// 获取RTC日期命令处理
+int handle_get_rtc_date(const uint8_t *request_data, uint16_t request_len, 
+                       uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)request_data;
+    (void)request_len;
+    
+    if (!rtc_is_initialized()) {
+        *status = STATUS_NOT_INITIALIZED;
+        *response_len = 0;
+        return -1;
+    }
+    
+    RTCDate date;
+    if (!rtc_get_date(&date)) {
+        *status = STATUS_NOT_INITIALIZED;
+        *response_len = 0;
+        return -1;
+    }
+    
+    // 构建响应数据
+    uint16_t offset = 0;
+    
+    int yy_len = write_tlv_uint8(response_data + offset, MAX_DATA_SIZE - offset, TAG_YEAR, date.year);
+    if (yy_len < 0) goto error;
+    offset += yy_len;
+    
+    int mm_len = write_tlv_uint8(response_data + offset, MAX_DATA_SIZE - offset, TAG_MONTH, date.month);
+    if (mm_len < 0) goto error;
+    offset += mm_len;
+    
+    int dd_len = write_tlv_uint8(response_data + offset, MAX_DATA_SIZE - offset, TAG_DAY, date.day);
+    if (dd_len < 0) goto error;
+    offset += dd_len;
+    
+    int wk_len = write_tlv_uint8(response_data + offset, MAX_DATA_SIZE - offset, TAG_WEEKDAY, date.weekday);
+    if (wk_len < 0) goto error;
+    offset += wk_len;
+    
+    *status = STATUS_OK;
+    *response_len = offset;
+    return 0;
+    
+error:
+    *status = STATUS_INTERNAL_ERROR;
+    *response_len = 0;
+    return -1;
+}
+
+// 获取RTC时间命令处理
+int handle_get_rtc_time(const uint8_t *request_data, uint16_t request_len, 
+                       uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)request_data;
+    (void)request_len;
+    
+    if (!rtc_is_initialized()) {
+        *status = STATUS_NOT_INITIALIZED;
+        *response_len = 0;
+        return -1;
+    }
+    
+    RTCTime time;
+    if (!rtc_get_time(&time)) {
+        *status = STATUS_NOT_INITIALIZED;
+        *response_len = 0;
+        return -1;
+    }
+    
+    // 构建响应数据
+    uint16_t offset = 0;
+    
+    int hh_len = write_tlv_uint8(response_data + offset, MAX_DATA_SIZE - offset, TAG_HOUR, time.hour);
+    if (hh_len < 0) goto error;
+    offset += hh_len;
+    
+    int mm_len = write_tlv_uint8(response_data + offset, MAX_DATA_SIZE - offset, TAG_MINUTE, time.minute);
+    if (mm_len < 0) goto error;
+    offset += mm_len;
+    
+    int ss_len = write_tlv_uint8(response_data + offset, MAX_DATA_SIZE - offset, TAG_SECOND, time.second);
+    if (ss_len < 0) goto error;
+    offset += ss_len;
+    
+    *status = STATUS_OK;
+    *response_len = offset;
+    return 0;
+    
+error:
+    *status = STATUS_INTERNAL_ERROR;
+    *response_len = 0;
+    return -1;
+}
+
+// 设置RTC日期命令处理 
+int handle_set_rtc_date(const uint8_t *request_data, uint16_t request_len, 
+                       uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)response_data;
+    
+    if (!rtc_is_initialized()) {
+        *status = STATUS_NOT_INITIALIZED;
+        *response_len = 0;
+        return -1;
+    }
+    
+    RTCDate date;
+    TlvBinding fields;
+    
+    // 读取各个字段（"MM"在这一层为月）
+    if (tlv_schema_bind(tlv_schema_request(OP_SET_RTC_DATE), request_data, request_len, &fields) < 0 ||
+        tlv_binding_get_uint8(&fields, RTC_DATE_YY, &date.year) < 0 ||
+        tlv_binding_get_uint8(&fields, RTC_DATE_MM, &date.month) < 0 ||
+        tlv_binding_get_uint8(&fields, RTC_DATE_DD, &date.day) < 0 ||
+        tlv_binding_get_uint8(&fields, RTC_DATE_WK, &date.weekday) < 0) {
+        
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    // 设置日期
+    if (!rtc_set_date(&date)) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    *status = STATUS_OK;
+    *response_len = 0;
+    return 0;
+}
+
+// 设置RTC时间命令处理
+int handle_set_rtc_time(const uint8_t *request_data, uint16_t request_len, 
+                       uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)response_data;
+    
+    if (!rtc_is_initialized()) {
+        *status = STATUS_NOT_INITIALIZED;
+        *response_len = 0;
+        return -1;
+    }
+    
+    RTCTime time;
+    TlvBinding fields;
+    
+    // 读取各个字段（"MM"在这一层为分）
+    if (tlv_schema_bind(tlv_schema_request(OP_SET_RTC_TIME), request_data, request_len, &fields) < 0 ||
+        tlv_binding_get_uint8(&fields, RTC_TIME_HH, &time.hour) < 0 ||
+        tlv_binding_get_uint8(&fields, RTC_TIME_MM, &time.minute) < 0 ||
+        tlv_binding_get_uint8(&fields, RTC_TIME_SS, &time.second) < 0) {
+        
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    // 设置时间
+    if (!rtc_set_time(&time)) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    *status = STATUS_OK;
+    *response_len = 0;
+    return 0;
+}
+
+// 设置日期时间命令处理：一次写入RTC计数器，TS为Unix时间戳（2000~2099年），MS可选
+int handle_set_datetime(const uint8_t *request_data, uint16_t request_len, 
+                       uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)response_data;
+    
+    if (!rtc_is_initialized()) {
+        *status = STATUS_NOT_INITIALIZED;
+        *response_len = 0;
+        return -1;
+    }
+    
+    TlvBinding fields;
+    uint64_t timestamp;
+    uint16_t millisecond = 0;
+    if (tlv_schema_bind(tlv_schema_request(OP_SET_DATETIME), request_data, request_len, &fields) < 0 ||
+        tlv_binding_get_uint64(&fields, DATETIME_TS, &timestamp) < 0 ||
+        timestamp < RTC_TIMESTAMP_2000 || timestamp >= RTC_TIMESTAMP_2100 ||
+        (tlv_binding_get_uint16(&fields, DATETIME_MS, &millisecond) > 0 && millisecond > 999)) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    if (!rtc_set_timestamp_ms(timestamp * 1000U + millisecond)) {
+        *status = STATUS_NOT_INITIALIZED;
+        *response_len = 0;
+        return -1;
+    }
+    
+    *status = STATUS_OK;
+    *response_len = 0;
+    return 0;
+}
+
+// 获取日期时间命令处理
+int handle_get_datetime(const uint8_t *request_data, uint16_t request_len, 
+                       uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)request_data;
+    (void)request_len;
+    
+    if (!rtc_is_initialized()) {
+        *status = STATUS_NOT_INITIALIZED;
+        *response_len = 0;
+        return -1;
+    }
+    
+    uint64_t now_ms = rtc_get_timestamp_ms();
+    uint16_t offset = 0;
+    
+    int ts_len = write_tlv_uint64(response_data, MAX_DATA_SIZE, TAG_TIMESTAMP, now_ms / 1000U);
+    if (ts_len < 0) goto error;
+    offset += ts_len;
+    
+    int ms_len = write_tlv_uint16(response_data + offset, MAX_DATA_SIZE - offset, TAG_MILLISECOND,
+                                  (uint16_t)(now_ms % 1000U));
+    if (ms_len < 0) goto error;
+    offset += ms_len;
+    
+    *status = STATUS_OK;
+    *response_len = offset;
+    return 0;
+    
+error:
+    *status = STATUS_INTERNAL_ERROR;
+    *response_len = 0;
+    return -1;
+}
+
+// 校时命令处理：NTP式的一次往返，T1为开始处理请求、T2为生成响应时的设备时间（毫秒）；
+// 带CO（int32，主机时间减设备时间）时先调整时钟并更新频率误差的估计，T1、T2为调整后的时间
+// 报警规则、RTC校准值和日志由存储任务在启动后加载，加载完成前相关命令返回NOT_INITIALIZED
+static bool storage_loaded(uint8_t *status, uint16_t *response_len) {
+    if (storage_task_ready()) {
+        return true;
+    }
+    *status = STATUS_NOT_INITIALIZED;
+    *response_len = 0;
+    return false;
+}
+
+int handle_clock_sync(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    uint64_t receive_ms = rtc_get_timestamp_ms();
+    
+    if (!storage_loaded(status, response_len)) {
+        return -1;
+    }
+    if (!rtc_is_initialized()) {
+        *status = STATUS_NOT_INITIALIZED;
+        *response_len = 0;
+        return -1;
+    }
+    
+    TlvBinding fields;
+    uint64_t origin = 0;
+    uint32_t offset = 0;
+    if (tlv_schema_bind(tlv_schema_request(OP_CLOCK_SYNC), request_data, request_len, &fields) < 0 ||
+        (tlv_binding_get_uint32(&fields, CSYN_REQ_CO, &offset) > 0 && !rtc_sync((int32_t)offset))) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    receive_ms += (int32_t)offset;
+    
+    uint16_t len = 0;
+    int field_len;
+    if (tlv_binding_get_uint64(&fields, CSYN_REQ_T0, &origin) > 0) {
+        field_len = write_tlv_uint64(response_data, MAX_DATA_SIZE, TAG_SYNC_ORIGIN, origin);
+        if (field_len < 0) goto error;
+        len += field_len;
+    }
+    
+    field_len = write_tlv_uint64(response_data + len, MAX_DATA_SIZE - len, TAG_SYNC_RECEIVE, receive_ms);
+    if (field_len < 0) goto error;
+    len += field_len;
+    
+    field_len = write_tlv_uint16(response_data + len, MAX_DATA_SIZE - len, TAG_CLOCK_CORRECTION,
+                                 (uint16_t)rtc_get_correction());
+    if (field_len < 0) goto error;
+    len += field_len;
+    
+    // 最后读取发送时间
+    field_len = write_tlv_uint64(response_data + len, MAX_DATA_SIZE - len, TAG_SYNC_TRANSMIT,
+                                 rtc_get_timestamp_ms());
+    if (field_len < 0) goto error;
+    len += field_len;
+    
+    *status = STATUS_OK;
+    *response_len = len;
+    return 0;
+    
+error:
+    *status = STATUS_INTERNAL_ERROR;
+    *response_len = 0;
+    return -1;
+}
+
+// 获取报警配置命令处理：从ID（默认0）开始尽量装满一帧，没有装下的规则由NX给出下一个编号
+int handle_get_alarms(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    if (!storage_loaded(status, response_len)) {
+        return -1;
+    }
+    
+    TlvBinding request;
+    uint8_t first = 0;
+    if (tlv_schema_bind(tlv_schema_request(OP_GET_ALARMS), request_data, request_len, &request) < 0 ||
+        (tlv_binding_get_uint8(&request, GALM_REQ_ID, &first) > 0 && first >= MAX_ALARMS)) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    // IT项及其子字段都直接写在各自的字段头之后，写完再回填长度；AL之后留出AW和NX
+    uint16_t temp_size = (session->temperature_format == TEMP_FORMAT_INT16) ? 6 : 8;
+    uint16_t budget = MAX_DATA_SIZE - 8 - 5;
+    uint16_t len = write_tlv_begin(response_data, budget, TAG_ALARM_LIST);
+    uint8_t next = first;
+    
+    for (; next < MAX_ALARMS; next++) {
+        uint8_t *item = response_data + len;
+        uint16_t item_size = budget - len;
+        if (item_size < 4 + 5 + 4 * temp_size + 3 * 6 + 3 * 5) { // IT + ID + L/H/HY/RT + DL/WS/PH + SN/AC/EN
+            break;
+        }
+        
+        AlarmConfig config;
+        alarm_get_config(next, &config);
+        uint16_t item_len = write_tlv_begin(item, item_size, TAG_ALARM_ITEM);
+        item_len += write_tlv_uint8(item + item_len, item_size - item_len, TAG_ALARM_ID, config.id);
+        item_len += write_tlv_temperature(item + item_len, item_size - item_len, TAG_ALARM_LOW, config.low_temp, session->temperature_format);
+        item_len += write_tlv_temperature(item + item_len, item_size - item_len, TAG_ALARM_HIGH, config.high_temp, session->temperature_format);
+        item_len += write_tlv_temperature(item + item_len, item_size - item_len, TAG_ALARM_HYSTERESIS, config.hysteresis, session->temperature_format);
+        item_len += write_tlv_uint16(item + item_len, item_size - item_len, TAG_ALARM_DELAY, config.delay_s);
+        item_len += write_tlv_uint8(item + item_len, item_size - item_len, TAG_SENSOR, config.sensor);
+        item_len += write_tlv_temperature(item + item_len, item_size - item_len, TAG_ALARM_RATE, config.rate, session->temperature_format);
+        item_len += write_tlv_uint8(item + item_len, item_size - item_len, TAG_ALARM_ACTIONS, config.actions);
+        item_len += write_tlv_uint8(item + item_len, item_size - item_len, TAG_ALARM_ENABLED, config.enabled);
+        item_len += write_tlv_uint16(item + item_len, item_size - item_len, TAG_ALARM_WINDOW, config.window_s);
+        item_len += write_tlv_uint16(item + item_len, item_size - item_len, TAG_ALARM_HORIZON, config.horizon_s);
+        len += write_tlv_end(item, item_len - 4);
+    }
+    
+    write_tlv_end(response_data, len - 4);
+    
+    len += write_tlv_uint32(response_data + len, MAX_DATA_SIZE - len, TAG_ALARM_LATENCY, temp_sampler_alarm_latency_max_us());
+    if (next < MAX_ALARMS) {
+        len += write_tlv_uint8(response_data + len, MAX_DATA_SIZE - len, TAG_ALARM_NEXT, next);
+    }
+    
+    *status = STATUS_OK;
+    *response_len = len;
+    return 0;
+}
+
+// 设置报警配置命令处理
+// AL中的每个IT项包含ID、L、H，其余字段可选，先全部校验再统一生效，任一项无效则不修改配置
+// 解析一个IT项并检查取值范围，未给出的可选字段保持该规则当前的设置
+static bool parse_alarm_item(const uint8_t *value, uint16_t length, AlarmConfig *config) {
+    TlvBinding item;
+    if (tlv_schema_bind(&tlv_schema_alarm_item, value, length, &item) < 0 ||
+        tlv_binding_get_uint8(&item, ALARM_ITEM_ID, &config->id) < 0 ||
+        config->id >= MAX_ALARMS) {
+        return false;
+    }
+    
+    alarm_get_config(config->id, config);
+    if (tlv_binding_get_temperature(&item, ALARM_ITEM_L, &config->low_temp) < 0 ||
+        tlv_binding_get_temperature(&item, ALARM_ITEM_H, &config->high_temp) < 0) {
+        return false;
+    }
+    tlv_binding_get_temperature(&item, ALARM_ITEM_HY, &config->hysteresis);
+    tlv_binding_get_uint16(&item, ALARM_ITEM_DL, &config->delay_s);
+    tlv_binding_get_uint8(&item, ALARM_ITEM_SN, &config->sensor);
+    tlv_binding_get_temperature(&item, ALARM_ITEM_RT, &config->rate);
+    tlv_binding_get_uint8(&item, ALARM_ITEM_AC, &config->actions);
+    tlv_binding_get_uint8(&item, ALARM_ITEM_EN, &config->enabled);
+    tlv_binding_get_uint16(&item, ALARM_ITEM_WS, &config->window_s);
+    tlv_binding_get_uint16(&item, ALARM_ITEM_PH, &config->horizon_s);
+    return alarm_config_valid(config);
+}
+
+int handle_set_alarms(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)response_data;
+    *response_len = 0;
+    if (!storage_loaded(status, response_len)) {
+        return -1;
+    }
+    
+    // AL和IT都以视图方式访问，不拷贝；每一层按各自的字段表解析
+    TlvBinding request;
+    const uint8_t *alarm_list_data;
+    uint16_t alarm_list_len;
+    if (tlv_schema_bind(tlv_schema_request(OP_SET_ALARMS), request_data, request_len, &request) < 0 ||
+        tlv_binding_get_view(&request, ALARM_LIST_AL, &alarm_list_data, &alarm_list_len) < 0) {
+        *status = STATUS_INVALID_PARAM;
+        return -1;
+    }
+    
+    // 游标在原数据上遍历IT项：第一遍只检查，全部合法后第二遍应用，
+    // 任一项非法时不修改任何通道（每个通道的配置整体生效，采样任务不会看到一半的配置）
+    for (int apply = 0; apply < 2; apply++) {
+        TlvCursor cursor;
+        TlvField field;
+        uint8_t alarm_count = 0;
+        int result;
+        
+        tlv_cursor_init(&cursor, alarm_list_data, alarm_list_len);
+        while ((result = tlv_cursor_next(&cursor, &field)) > 0) {
+            if (tlv_schema_find(&tlv_schema_alarm_items, (const char *)field.tag) != ALARM_ITEMS_IT) {
+                continue; // 未定义的字段跳过
+            }
+            
+            AlarmConfig config;
+            if (alarm_count >= MAX_ALARMS ||
+                !parse_alarm_item(alarm_list_data + field.offset, field.length, &config)) {
+                *status = STATUS_INVALID_PARAM;
+                return -1;
+            }
+            if (apply) {
+                alarm_set_config(&config);
+            }
+            alarm_count++;
+        }
+        if (result < 0) {
+            *status = STATUS_INVALID_PARAM; // AL内的字段不完整
+            return -1;
+        }
+    }
+    
+    // 由采样任务写入闪存，复位后保持
+    config_store_request_save(CONFIG_KEY_ALARMS);
+    *status = STATUS_OK;
+    return 0;
+}
+
+// 从查询中逐条读取日志，编码为一个LG（TLV列表）、LZ（压缩）或LP（定长打包）字段，最多max_count条；
+// 放不下的条目留在查询中（*more为true），返回字段长度，*encoded为实际编码的条目数，
+// *last为最后一条的日志序号（*encoded为0时不修改）
+static int encode_log_entries(TempLogQuery *query, uint32_t max_count, bool raw, uint8_t format,
+                              uint8_t *output, uint16_t output_size, uint32_t *encoded, bool *more,
+                              uint32_t *last) {
+    bool codec = (format == LOG_FORMAT_DELTA || format == LOG_FORMAT_PACKED);
+    const char *tag = !codec ? TAG_LOG_LIST : (format == LOG_FORMAT_DELTA) ? TAG_LOG_COMPRESSED : TAG_LOG_PACKED;
+    if (write_tlv_begin(output, output_size, tag) < 0) {
+        return -1;
+    }
+    
+    // 差分变长编码和定长打包直接写在TLV头之后
+    LogCodecEncoder encoder;
+    if (format == LOG_FORMAT_DELTA && !log_codec_begin(&encoder, output + 4, output_size - 4)) {
+        return -1;
+    }
+    if (format == LOG_FORMAT_PACKED && !log_codec_begin_packed(&encoder, output + 4, output_size - 4)) {
+        return -1;
+    }
+    
+    uint16_t temp_size = (session->temperature_format == TEMP_FORMAT_INT16) ? 6 : 8;
+    uint16_t length = 0;
+    uint32_t n = 0;
+    TempLogEntry entry;
+    *more = false;
+    
+    while (n < max_count) {
+        TempLogQuery position = *query;
+        if (!temp_log_query_next(query, &entry)) {
+            break;
+        }
+        if (raw) {
+            entry.temperature = entry.raw; // 请求RW时按原始温度编码
+        }
+        
+        bool fits;
+        if (codec) {
+            fits = log_codec_put(&encoder, &entry);
+        } else {
+            // 日志项的子字段直接写在IT字段头之后
+            uint8_t *item = output + 4 + length;
+            uint16_t item_size = output_size - 4 - length;
+            // 整项放不下时不写入，避免留下半个日志项
+            fits = item_size >= 4 + 12 + 6 + temp_size; // IT + TS + MS + T
+            if (fits) {
+                uint16_t item_len = write_tlv_begin(item, item_size, TAG_ALARM_ITEM);
+                item_len += write_tlv_uint64(item + item_len, item_size - item_len, TAG_TIMESTAMP, entry.timestamp);
+                item_len += write_tlv_uint16(item + item_len, item_size - item_len, TAG_MILLISECOND, entry.millisecond);
+                item_len += write_tlv_temperature(item + item_len, item_size - item_len, TAG_TEMPERATURE, entry.temperature, session->temperature_format);
+                length += write_tlv_end(item, item_len - 4);
+            }
+        }
+        
+        if (!fits) {
+            *query = position; // 该条留到下一片
+            *more = true;
+            break;
+        }
+        *last = entry.sequence;
+        n++;
+    }
+    
+    if (codec) {
+        length = (uint16_t)log_codec_finish(&encoder);
+    }
+    *encoded = n;
+    return write_tlv_end(output, length);
+}
+
+// 按桶聚合的日志编码为一个BK列表，最多max_count个桶，放不下的桶不返回
+static int encode_log_buckets(TempLogAggregate *aggregate, uint32_t max_count,
+                              uint8_t *output, uint16_t output_size) {
+    if (write_tlv_begin(output, output_size, TAG_BUCKET_LIST) < 0) {
+        return -1;
+    }
+    
+    uint16_t temp_size = (session->temperature_format == TEMP_FORMAT_INT16) ? 6 : 8;
+    uint16_t length = 0;
+    TempLogBucket bucket;
+    
+    for (uint32_t n = 0; n < max_count && temp_log_aggregate_next(aggregate, &bucket); n++) {
+        uint8_t *item = output + 4 + length;
+        uint16_t item_size = output_size - 4 - length;
+        if (item_size < 4 + 12 + 3 * temp_size + 8) { // IT + TS + LO/HI/AV + CN
+            break;
+        }
+        uint16_t item_len = write_tlv_begin(item, item_size, TAG_ALARM_ITEM);
+        item_len += write_tlv_uint64(item + item_len, item_size - item_len, TAG_TIMESTAMP, bucket.start);
+        item_len += write_tlv_temperature(item + item_len, item_size - item_len, TAG_BUCKET_MIN, bucket.min, session->temperature_format);
+        item_len += write_tlv_temperature(item + item_len, item_size - item_len, TAG_BUCKET_MAX, bucket.max, session->temperature_format);
+        item_len += write_tlv_temperature(item + item_len, item_size - item_len, TAG_BUCKET_MEAN, bucket.mean, session->temperature_format);
+        item_len += write_tlv_uint32(item + item_len, item_size - item_len, TAG_BUCKET_COUNT, bucket.count);
+        length += write_tlv_end(item, item_len - 4);
+    }
+    
+    return write_tlv_end(output, length);
+}
+
+// 温度日志的一个区间（IR列表的一项）
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint32_t count;
+    int16_t peak;
+    uint8_t sensor;
+    bool ongoing;     // 到查询结束仍在区间内：之后没有范围外的记录，或还没有解除报警
+} LogInterval;
+
+static inline void interval_add(LogInterval *interval, int16_t value, bool peak_min) {
+    if (peak_min ? value < interval->peak : value > interval->peak) {
+        interval->peak = value;
+    }
+    interval->count++;
+}
+
+// 读取下一个温度区间：筛选范围内相邻的记录（之间没有该传感器范围外的记录）合并为一个区间，
+// 结束区间的记录留在query中；peak_min为true时峰值取最低温度，否则取最高温度
+static bool next_value_interval(TempLogQuery *query, bool peak_min, LogInterval *interval) {
+    TempLogEntry entry;
+    if (!temp_log_query_next(query, &entry)) {
+        return false;
+    }
+    int16_t value = query->filter_raw ? entry.raw : entry.temperature;
+    *interval = (LogInterval){ .start = entry.timestamp, .end = entry.timestamp, .count = 1,
+                               .peak = value, .sensor = entry.sensor, .ongoing = true };
+    for (;;) {
+        TempLogQuery position = *query;
+        bool found = temp_log_query_next(query, &entry);
+        if (query->gap) {
+            *query = position;
+            interval->ongoing = false;
+            return true;
+        }
+        if (!found) {
+            return true;
+        }
+        interval->end = entry.timestamp;
+        interval_add(interval, query->filter_raw ? entry.raw : entry.temperature, peak_min);
+    }
+}
+
+// 读取规则alarm_id下一次从进入到解除报警的区间（events为事件日志的查询），
+// 峰值和条数取自超限传感器在区间内的记录：低于下限进入报警时峰值为最低温度，否则为最高温度；
+// 还没有解除时区间到最后一条记录为止
+static bool next_alarm_interval(TempLogQuery *events, uint8_t alarm_id, LogInterval *interval) {
+    AlarmEvent event;
+    do {
+        if (!alarm_event_query_next(events, &event)) {
+            return false;
+        }
+    } while (event.channel != alarm_id || event.type != ALARM_EVENT_ENTER);
+    
+    AlarmConfig config;
+    alarm_get_config(alarm_id, &config);
+    bool peak_min = event.temperature <= config.low_temp;
+    *interval = (LogInterval){ .start = event.timestamp, .end = events->end_time, .peak = event.temperature,
+                               .sensor = event.sensor, .ongoing = true };
+    while (alarm_event_query_next(events, &event)) {
+        if (event.channel == alarm_id && event.type == ALARM_EVENT_LEAVE) {
+            interval->end = event.timestamp;
+            interval->ongoing = false;
+            break;
+        }
+    }
+    
+    TempLogQuery samples;
+    TempLogEntry entry;
+    uint32_t last = interval->start;
+    temp_log_query_begin(&samples, interval->sensor, interval->start, interval->end);
+    while (temp_log_query_next(&samples, &entry)) {
+        interval_add(interval, entry.temperature, peak_min);
+        last = entry.timestamp;
+    }
+    if (interval->ongoing) {
+        interval->end = last;
+    }
+    return true;
+}
+
+// 区间编码为一个IR列表，最多max_count个；by_alarm为true时query为事件日志的查询，
+// 按规则alarm_id的报警状态取区间，否则按query的温度筛选取区间。
+// 放不下的区间留在query中（*more为true），*encoded为实际编码的区间数
+static int encode_log_intervals(TempLogQuery *query, uint32_t max_count, bool by_alarm, uint8_t alarm_id,
+                                bool peak_min, uint8_t *output, uint16_t output_size,
+                                uint32_t *encoded, bool *more) {
+    if (write_tlv_begin(output, output_size, TAG_LOG_INTERVALS) < 0) {
+        return -1;
+    }
+    
+    uint16_t temp_size = (session->temperature_format == TEMP_FORMAT_INT16) ? 6 : 8;
+    uint16_t length = 0;
+    uint32_t n = 0;
+    LogInterval interval;
+    *more = false;
+    
+    while (n < max_count) {
+        TempLogQuery position = *query;
+        if (!(by_alarm ? next_alarm_interval(query, alarm_id, &interval)
+                       : next_value_interval(query, peak_min, &interval))) {
+            break;
+        }
+        uint8_t *item = output + 4 + length;
+        uint16_t item_size = output_size - 4 - length;
+        if (item_size < 4 + 12 + 12 + temp_size + 8 + 5 + 5) { // IT + T1/T2 + PK + CN + SN + OG
+            *query = position; // 该区间留到下一页
+            *more = true;
+            break;
+        }
+        uint16_t item_len = write_tlv_begin(item, item_size, TAG_ALARM_ITEM);
+        item_len += write_tlv_uint64(item + item_len, item_size - item_len, TAG_TIME_START, interval.start);
+        item_len += write_tlv_uint64(item + item_len, item_size - item_len, TAG_TIME_END, interval.end);
+        item_len += write_tlv_temperature(item + item_len, item_size - item_len, TAG_PEAK, interval.peak, session->temperature_format);
+        item_len += write_tlv_uint32(item + item_len, item_size - item_len, TAG_BUCKET_COUNT, interval.count);
+        item_len += write_tlv_uint8(item + item_len, item_size - item_len, TAG_SENSOR, interval.sensor);
+        item_len += write_tlv_uint8(item + item_len, item_size - item_len, TAG_ONGOING, interval.ongoing ? 1 : 0);
+        length += write_tlv_end(item, item_len - 4);
+        n++;
+    }
+    
+    *encoded = n;
+    return write_tlv_end(output, length);
+}
+
+// 构建一个日志分片：SQ + MF + LG/LZ，从query的位置开始尽量装满，sent为之前已发送的条目数
+// allow_more为false时本片即为最后一片（无法挂起后续分片时）
+static int build_log_fragment(uint16_t sequence, TempLogQuery *query, uint32_t sent, bool allow_more,
+                              uint8_t *response_data, uint16_t *response_len,
+                              uint32_t *encoded, bool *more) {
+    uint32_t wanted = log_transfer.max_count > sent ? log_transfer.max_count - sent : 0;
+    
+    uint16_t len = 0;
+    int sq_len = write_tlv_uint16(response_data, RESPONSE_DATA_BUDGET, TAG_SEQUENCE, sequence);
+    if (sq_len < 0) {
+        return -1;
+    }
+    len += sq_len;
+    
+    // MF先写0，确定本片条目数后回填
+    uint16_t mf_offset = len;
+    int mf_len = write_tlv_uint8(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_MORE_FRAGMENTS, 0);
+    if (mf_len < 0) {
+        return -1;
+    }
+    len += mf_len;
+    
+    uint32_t last;
+    int list_len = encode_log_entries(query, wanted, log_transfer.raw, log_transfer.format,
+                                      response_data + len, RESPONSE_DATA_BUDGET - len, encoded, more, &last);
+    if (list_len < 0 || (*encoded == 0 && *more)) {
+        return -1;
+    }
+    len += list_len;
+    
+    *more = allow_more && *more;
+    response_data[mf_offset + 4] = *more ? 1 : 0;
+    *response_len = len;
+    return 0;
+}
+
+static inline bool schedule_log_transfer(uint32_t delay_ms) {
+    return schedule_pending(log_transfer.instruction, log_transfer.response_id, complete_log_fragment, delay_ms);
+}
+
+// 发送下一片：优先重发主机报告丢失的分片，其次生成新分片
+static int send_log_fragment(uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    uint8_t index = log_transfer.window_count;
+    uint32_t offset = log_transfer.next_offset;
+    TempLogQuery query = log_transfer.query;
+    
+    if (log_transfer.resend_mask != 0) {
+        index = 0;
+        while ((log_transfer.resend_mask & (1u << index)) == 0) {
+            index++;
+        }
+        log_transfer.resend_mask &= (uint16_t)~(1u << index);
+        offset = log_transfer.offsets[index];
+        query.iter = log_transfer.positions[index];
+    }
+    LogStoreIter position = query.iter;
+    
+    // 无法挂起后续分片时（批量请求中或挂起表已满）以本片结束传输
+    bool allow_more = can_defer();
+    uint32_t encoded = 0;
+    bool more = false;
+    if (build_log_fragment(log_transfer.base_sequence + index, &query, offset, allow_more,
+                           response_data, response_len, &encoded, &more) < 0) {
+        log_transfer.active = false;
+        return -1;
+    }
+    *status = STATUS_OK;
+    
+    if (index == log_transfer.window_count) {
+        // 新分片
+        if (log_transfer.window != 0) {
+            log_transfer.offsets[index] = offset;
+            log_transfer.positions[index] = position;
+        }
+        log_transfer.query = query;
+        log_transfer.next_offset += encoded;
+        log_transfer.window_count++;
+        log_transfer.finished = !more;
+    }
+    
+    if (log_transfer.window == 0) {
+        // 不等待确认：直接滑动
+        log_transfer.base_sequence += log_transfer.window_count;
+        log_transfer.window_count = 0;
+        log_transfer.active = !log_transfer.finished;
+    } else if (log_transfer.resend_mask == 0 &&
+               (log_transfer.finished || log_transfer.window_count >= log_transfer.window)) {
+        // 窗口已发完，等待确认，超时后重发窗口最后一片
+        log_transfer.waiting_ack = true;
+    }
+    
+    if (log_transfer.active && allow_more) {
+        schedule_log_transfer(log_transfer.waiting_ack ? LOG_ACK_TIMEOUT_MS : 0);
+    } else {
+        log_transfer.active = false;
+    }
+    return 0;
+}
+
+// 分片传输的完成函数：发送下一片，或在确认超时后重发
+static int complete_log_fragment(uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    if (!log_transfer.active) {
+        *status = STATUS_INTERNAL_ERROR;
+        *response_len = 0;
+        return -1;
+    }
+    
+    if (log_transfer.waiting_ack) {
+        if (++log_transfer.retries > LOG_ACK_MAX_RETRIES) {
+            // 主机长时间无确认，放弃传输
+            log_transfer.active = false;
+            *status = STATUS_INTERNAL_ERROR;
+            *response_len = 0;
+            return 0;
+        }
+        // 最后一片可能丢失，重发以促使主机确认
+        log_transfer.waiting_ack = false;
+        log_transfer.resend_mask |= (uint16_t)(1u << (log_transfer.window_count - 1));
+    }
+    
+    return send_log_fragment(response_data, response_len, status);
+}
+
+// 获取温度日志命令处理
+int handle_get_log(const uint8_t *request_data, uint16_t request_len, 
+                  uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    if (!storage_loaded(status, response_len)) {
+        return -1;
+    }
+    
+    uint64_t start_time = 0, end_time = 0;
+    uint16_t max_count = MAX_LOG_ENTRIES;
+    
+    // 读取查询参数（均为可选）
+    TlvBinding fields;
+    if (tlv_schema_bind(tlv_schema_request(OP_GET_LOG), request_data, request_len, &fields) < 0) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    tlv_binding_get_uint64(&fields, GLOG_REQ_T1, &start_time);
+    tlv_binding_get_uint64(&fields, GLOG_REQ_T2, &end_time);
+    tlv_binding_get_uint16(&fields, GLOG_REQ_MX, &max_count);
+    
+    uint8_t format = LOG_FORMAT_TLV;
+    tlv_binding_get_uint8(&fields, GLOG_REQ_CP, &format);
+    
+    uint8_t fragmented = 0;
+    tlv_binding_get_uint8(&fields, GLOG_REQ_FG, &fragmented);
+    
+    uint8_t window = 0;
+    tlv_binding_get_uint8(&fields, GLOG_REQ_WN, &window);
+    
+    // 每次查询一个传感器的日志，默认0号
+    uint8_t sensor = 0;
+    tlv_binding_get_uint8(&fields, GLOG_REQ_SN, &sensor);
+    uint8_t raw = 0;
+    tlv_binding_get_uint8(&fields, GLOG_REQ_RW, &raw);
+    if (sensor >= TEMP_MAX_SENSORS) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    if (window > LOG_MAX_WINDOW) {
+        window = LOG_MAX_WINDOW;
+    }
+    uint32_t bucket_width = 0;
+    tlv_binding_get_uint32(&fields, GLOG_REQ_BW, &bucket_width);
+    
+    // 温度筛选（L、H均可选）：只返回温度在[L, H]内的条目，日志页按摘要整页跳过；
+    // 按桶聚合时不能筛选
+    int16_t low = INT16_MIN, high = INT16_MAX;
+    bool has_low = tlv_binding_has(&fields, GLOG_REQ_L);
+    bool has_high = tlv_binding_has(&fields, GLOG_REQ_H);
+    if ((has_low && tlv_binding_get_temperature(&fields, GLOG_REQ_L, &low) < 0) ||
+        (has_high && tlv_binding_get_temperature(&fields, GLOG_REQ_H, &high) < 0) ||
+        low > high || ((has_low || has_high) && bucket_width != 0)) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return 0;
+    }
+    
+    // 按区间返回（IR）：温度筛选范围内的连续时段，或AS号规则处于报警状态的时段；
+    // 只用单帧响应，主机用CU继续
+    uint8_t intervals = 0;
+    tlv_binding_get_uint8(&fields, GLOG_REQ_IR, &intervals);
+    uint8_t alarm_id = 0;
+    bool by_alarm = tlv_binding_get_uint8(&fields, GLOG_REQ_AS, &alarm_id) > 0;
+    if (by_alarm) {
+        intervals = 1;
+    }
+    if (intervals != 0 &&
+        (bucket_width != 0 || fragmented || window || tlv_binding_has(&fields, GLOG_REQ_SI) ||
+         (by_alarm ? (alarm_id >= MAX_ALARMS || has_low || has_high) : !(has_low || has_high)))) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return 0;
+    }
+    
+    // 从SD卡归档读取（AR）：游标为归档中的位置，不能按桶聚合、按报警区间或增量同步
+    uint8_t archive = 0;
+    tlv_binding_get_uint8(&fields, GLOG_REQ_AR, &archive);
+    if (archive != 0 && (bucket_width != 0 || by_alarm || tlv_binding_has(&fields, GLOG_REQ_SI))) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return 0;
+    }
+    
+    // 最新的LA条（LA）：从写入位置往前定位，只用单帧响应，不能与筛选、游标或归档同时使用
+    uint16_t latest = 0;
+    bool by_latest = tlv_binding_get_uint16(&fields, GLOG_REQ_LA, &latest) > 0;
+    if (by_latest &&
+        (latest == 0 || bucket_width != 0 || intervals != 0 || fragmented || window || archive != 0 || has_low || has_high ||
+         tlv_binding_has(&fields, GLOG_REQ_CU) || tlv_binding_has(&fields, GLOG_REQ_SI))) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return 0;
+    }
+    if (archive != 0 && !temp_log_archive_ready()) {
+        *status = STATUS_NOT_INITIALIZED; // 没有插卡或不是归档固件
+        *response_len = 0;
+        return 0;
+    }
+    
+    // 如果未指定时间范围，使用默认值
+    if (end_time == 0) {
+        end_time = rtc_get_timestamp();
+    }
+    if (start_time == 0) {
+        start_time = end_time - 24 * 3600; // 默认查询最近24小时
+    }
+    
+    if (intervals != 0) {
+        TempLogQuery query;
+        uint32_t cursor = 0;
+        bool resume = tlv_binding_get_uint32(&fields, GLOG_REQ_CU, &cursor) > 0;
+        if (by_alarm) {
+            if (resume) {
+                alarm_event_query_resume(&query, cursor, end_time);
+            } else {
+                alarm_event_query_begin(&query, start_time, end_time);
+            }
+        } else {
+            if (resume) {
+                (archive ? temp_log_archive_resume : temp_log_query_resume)(&query, sensor, cursor, end_time);
+            } else {
+                (archive ? temp_log_archive_begin : temp_log_query_begin)(&query, sensor, start_time, end_time);
+            }
+            temp_log_query_filter(&query, low, high, raw != 0);
+        }
+        
+        bool peak_min = has_high && !has_low;
+        uint32_t encoded = 0;
+        bool more = false;
+        int list_len = encode_log_intervals(&query, max_count, by_alarm, alarm_id, peak_min,
+                                            response_data, RESPONSE_DATA_BUDGET - 8, &encoded, &more);
+        if (list_len < 0) {
+            *status = STATUS_INTERNAL_ERROR;
+            *response_len = 0;
+            return -1;
+        }
+        cursor = temp_log_query_cursor(&query);
+        if (!more && encoded == max_count) {
+            LogInterval next;
+            more = by_alarm ? next_alarm_interval(&query, alarm_id, &next)
+                            : next_value_interval(&query, peak_min, &next);
+        }
+        if (more) {
+            list_len += write_tlv_uint32(response_data + list_len, RESPONSE_DATA_BUDGET - list_len,
+                                         TAG_LOG_CURSOR, cursor);
+        }
+        *status = STATUS_OK;
+        *response_len = list_len;
+        return 0;
+    }
+    
+    // 按桶聚合：只用单帧响应，主机从最后一个桶之后继续查询
+    if (bucket_width != 0) {
+        TempLogAggregate aggregate;
+        temp_log_aggregate_begin(&aggregate, sensor, start_time, end_time, bucket_width, raw != 0);
+        int list_len = encode_log_buckets(&aggregate, max_count, response_data, RESPONSE_DATA_BUDGET);
+        if (list_len < 0) {
+            *status = STATUS_INTERNAL_ERROR;
+            *response_len = 0;
+            return -1;
+        }
+        *status = STATUS_OK;
+        *response_len = list_len;
+        return 0;
+    }
+    
+    // 分片传输：本响应为第0片，其余分片依次挂起发送
+    if (fragmented || window) {
+        if (log_transfer.active) {
+            *status = STATUS_BUSY; // 上一次分片传输尚未结束
+            *response_len = 0;
+            return 0;
+        }
+        
+        memset(&log_transfer, 0, sizeof(log_transfer));
+        log_transfer.active = true;
+        log_transfer.format = format;
+        log_transfer.window = window;
+        log_transfer.response_id = current_response_id;
+        log_transfer.link = session_link;
+        strncpy(log_transfer.instruction, current_instruction ? current_instruction : CMD_GET_LOG,
+                sizeof(log_transfer.instruction) - 1);
+        log_transfer.raw = (raw != 0);
+        (archive ? temp_log_archive_begin : temp_log_query_begin)(&log_transfer.query, sensor, start_time, end_time);
+        temp_log_query_filter(&log_transfer.query, low, high, raw != 0);
+        log_transfer.max_count = max_count;
+        return send_log_fragment(response_data, response_len, status);
+    }
+    
+    // 单帧响应：边读边编码，放不下的条目留给下一页；带CU时从游标处继续，
+    // 带SI时只返回日志序号大于SI的条目，带LA时只返回最新的LA条（均忽略T1）
+    TempLogQuery query;
+    uint32_t cursor = 0;
+    uint32_t since = 0;
+    if (by_latest) {
+        temp_log_query_latest(&query, sensor, latest, end_time);
+        if (max_count > latest) {
+            max_count = latest;
+        }
+    } else if (tlv_binding_get_uint32(&fields, GLOG_REQ_CU, &cursor) > 0) {
+        (archive ? temp_log_archive_resume : temp_log_query_resume)(&query, sensor, cursor, end_time);
+    } else if (tlv_binding_get_uint32(&fields, GLOG_REQ_SI, &since) > 0) {
+        if (since >= temp_log_next_sequence()) {
+            *status = STATUS_INVALID_PARAM; // 日志已清除后重新编号，主机需要重新同步
+            *response_len = 0;
+            return -1;
+        }
+        temp_log_query_resume(&query, sensor, since + 1, end_time);
+    } else {
+        (archive ? temp_log_archive_begin : temp_log_query_begin)(&query, sensor, start_time, end_time);
+    }
+    temp_log_query_filter(&query, low, high, raw != 0);
+    
+    // CU和LN字段预留在列表之后
+    uint16_t budget = RESPONSE_DATA_BUDGET - 16;
+    uint32_t encoded = 0;
+    bool more = false;
+    uint32_t last = 0;
+    int list_len = encode_log_entries(&query, max_count, raw != 0, format,
+                                      response_data, budget, &encoded, &more, &last);
+    if (list_len < 0) {
+        *status = STATUS_INTERNAL_ERROR;
+        *response_len = 0;
+        return -1;
+    }
+    
+    // 还有记录时返回下一页的游标（达到MX时先确认后面确实还有）
+    cursor = temp_log_query_cursor(&query);
+    if (!more && encoded == max_count) {
+        TempLogEntry next;
+        more = temp_log_query_next(&query, &next);
+    }
+    if (more) {
+        list_len += write_tlv_uint32(response_data + list_len, RESPONSE_DATA_BUDGET - list_len,
+                                     TAG_LOG_CURSOR, cursor);
+    }
+    if (encoded > 0) {
+        list_len += write_tlv_uint32(response_data + list_len, RESPONSE_DATA_BUDGET - list_len,
+                                     TAG_LOG_LAST, last);
+    }
+    
+    *status = STATUS_OK;
+    *response_len = list_len;
+    return 0;
+}
+
+// 分片确认：SQ为窗口第一片的序号，BM位图bit i表示第SQ+i片已收到
+int handle_fragment_ack(const uint8_t *request_data, uint16_t request_len, 
+                       uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)response_data;
+    *response_len = 0;
+    
+    uint16_t base = 0;
+    uint32_t bitmap = 0;
+    TlvBinding fields;
+    if (tlv_schema_bind(tlv_schema_request(OP_FRAGMENT_ACK), request_data, request_len, &fields) < 0 ||
+        tlv_binding_get_uint16(&fields, FACK_REQ_SQ, &base) < 0 ||
+        tlv_binding_get_uint32(&fields, FACK_REQ_BM, &bitmap) < 0) {
+        *status = STATUS_INVALID_PARAM;
+        return 0;
+    }
+    
+    // 只接受发起传输的链路对当前窗口的确认，重复或过期的确认忽略
+    if (!log_transfer.active || log_transfer.window == 0 || log_transfer.link != session_link ||
+        base != log_transfer.base_sequence) {
+        *status = STATUS_INVALID_PARAM;
+        return 0;
+    }
+    
+    cancel_pending(complete_log_fragment);
+    log_transfer.waiting_ack = false;
+    log_transfer.retries = 0;
+    
+    uint16_t window_mask = (uint16_t)((1u << log_transfer.window_count) - 1);
+    uint16_t missing = (uint16_t)~bitmap & window_mask;
+    
+    if (missing == 0) {
+        if (log_transfer.finished) {
+            log_transfer.active = false; // 全部分片已确认
+            *status = STATUS_OK;
+            return 0;
+        }
+        // 滑动到下一个窗口
+        log_transfer.base_sequence += log_transfer.window_count;
+        log_transfer.window_count = 0;
+        log_transfer.resend_mask = 0;
+    } else {
+        log_transfer.resend_mask = missing;
+    }
+    
+    // 取消后挂起表必有空位
+    schedule_log_transfer(0);
+    
+    *status = STATUS_OK;
+    return 0;
+}
+
+// sled/sbzr的请求：PT为预置序列，ON/OF/RP为节拍，都不带时执行各指令原来的动作；
+// DU为常亮或节拍的占空比（序列自带占空比，不能同时使用），FQ为共用的载波频率
+typedef struct {
+    uint8_t sequence;  // OUTPUT_SEQUENCE_NONE表示没有PT
+    uint16_t on_ms;    // 0表示没有ON
+    uint16_t off_ms;   // 省略为0
+    uint16_t count;    // 省略为一直重复；序列只能为0（循环）或1（播放一次）
+    uint8_t duty;      // 省略为50%
+    uint16_t frequency; // 0表示没有FQ
+} OutputRequest;
+
+static int parse_output_request(uint8_t opcode, const uint8_t *request_data, uint16_t request_len,
+                                OutputRequest *request) {
+    TlvBinding binding;
+    if (tlv_schema_bind(tlv_schema_request(opcode), request_data, request_len, &binding) < 0) {
+        return -1;
+    }
+    request->sequence = OUTPUT_SEQUENCE_NONE;
+    request->on_ms = 0;
+    request->off_ms = 0;
+    request->count = OUTPUT_PATTERN_FOREVER;
+    request->duty = OUTPUT_DUTY_HALF;
+    request->frequency = 0;
+    uint8_t percent = 0;
+    if ((tlv_binding_has(&binding, PATTERN_DU) && tlv_binding_get_uint8(&binding, PATTERN_DU, &percent) < 0) ||
+        (tlv_binding_has(&binding, PATTERN_FQ) && tlv_binding_get_uint16(&binding, PATTERN_FQ, &request->frequency) < 0) ||
+        (tlv_binding_has(&binding, PATTERN_PT) && tlv_binding_get_uint8(&binding, PATTERN_PT, &request->sequence) < 0) ||
+        (tlv_binding_has(&binding, PATTERN_ON) && tlv_binding_get_uint16(&binding, PATTERN_ON, &request->on_ms) < 0) ||
+        (tlv_binding_has(&binding, PATTERN_OF) && tlv_binding_get_uint16(&binding, PATTERN_OF, &request->off_ms) < 0) ||
+        (tlv_binding_has(&binding, PATTERN_RP) && tlv_binding_get_uint16(&binding, PATTERN_RP, &request->count) < 0)) {
+        return -1;
+    }
+    if (tlv_binding_has(&binding, PATTERN_DU)) {
+        if (percent == 0 || percent > 100) {
+            return -1;
+        }
+        request->duty = output_duty_from_percent(percent);
+    }
+    if (tlv_binding_has(&binding, PATTERN_FQ) &&
+        (request->frequency < OUTPUT_FREQUENCY_MIN || request->frequency > OUTPUT_FREQUENCY_MAX)) {
+        return -1;
+    }
+
+    if (tlv_binding_has(&binding, PATTERN_PT)) {
+        return (request->sequence != OUTPUT_SEQUENCE_NONE && request->sequence < OUTPUT_SEQUENCE_COUNT &&
+                !tlv_binding_has(&binding, PATTERN_ON) && !tlv_binding_has(&binding, PATTERN_DU) &&
+                request->count <= 1) ? 0 : -1;
+    }
+    if (tlv_binding_has(&binding, PATTERN_ON)) {
+        return output_pattern_valid(request->on_ms, request->off_ms, request->count) ? 0 : -1;
+    }
+    return 0;
+}
+
+// 按请求的FQ修改载波频率（已检查范围）
+static void apply_output_frequency(const OutputRequest *request) {
+    if (request->frequency != 0) {
+        output_set_frequency(request->frequency);
+    }
+}
+
+// LED控制命令处理：不带PT和ON时常亮
+int handle_set_led(const uint8_t *request_data, uint16_t request_len, 
+                  uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)response_data;
+    
+    OutputRequest request;
+    *response_len = 0;
+    if (parse_output_request(OP_SET_LED, request_data, request_len, &request) < 0) {
+        *status = STATUS_INVALID_PARAM;
+        return -1;
+    }
+    
+    apply_output_frequency(&request);
+    if (request.sequence != OUTPUT_SEQUENCE_NONE) {
+        led_play(request.sequence, request.count == OUTPUT_PATTERN_FOREVER);
+    } else if (request.on_ms != 0) {
+        led_blink(request.on_ms, request.off_ms, request.count, request.duty);
+    } else {
+        led_set_duty(request.duty);
+    }
+    
+    *status = STATUS_OK;
+    return 0;
+}
+
+int handle_reset_led(const uint8_t *request_data, uint16_t request_len, 
+                    uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)request_data;
+    (void)request_len;
+    (void)response_data;
+    
+    led_off();
+    
+    *status = STATUS_OK;
+    *response_len = 0;
+    return 0;
+}
+
+// 蜂鸣器控制命令处理：不带PT和ON时蜂鸣1秒
+int handle_set_buzzer(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)response_data;
+    
+    OutputRequest request;
+    *response_len = 0;
+    if (parse_output_request(OP_SET_BUZZER, request_data, request_len, &request) < 0) {
+        *status = STATUS_INVALID_PARAM;
+        return -1;
+    }
+    
+    apply_output_frequency(&request);
+    if (request.sequence != OUTPUT_SEQUENCE_NONE) {
+        buzzer_play(request.sequence, request.count == OUTPUT_PATTERN_FOREVER);
+    } else if (request.on_ms != 0) {
+        buzzer_pattern(request.on_ms, request.off_ms, request.count, request.duty);
+    } else {
+        buzzer_pattern(1000, 0, 1, request.duty);
+    }
+    
+    *status = STATUS_OK;
+    return 0;
+}
+
+int handle_reset_buzzer(const uint8_t *request_data, uint16_t request_len, 
+                       uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)request_data;
+    (void)request_len;
+    (void)response_data;
+    
+    buzzer_off();
+    
+    *status = STATUS_OK;
+    *response_len = 0;
+    return 0;
+}
+
+// 波特率协商命令处理：响应以当前波特率发出，发送完成后切换
+int handle_set_baud(const uint8_t *request_data, uint16_t request_len, 
+                   uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)response_data;
+    
+    TlvBinding request;
+    uint32_t baud_rate;
+    if (tlv_schema_bind(tlv_schema_request(OP_SET_BAUD), request_data, request_len, &request) < 0 ||
+        tlv_binding_get_uint32(&request, BAUD_REQ_BR, &baud_rate) < 0 ||
+        !communication_request_baud_rate(baud_rate)) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    *status = STATUS_OK;
+    *response_len = 0;
+    return 0;
+}
+
+// 温度推送订阅命令处理：IV为推送间隔（毫秒），0表示取消订阅；
+// AE为报警事件推送，省略时随温度订阅开启或关闭；
+// SF不为0时周期推送改用流帧（只在COBS组帧的会话中可用），序号从0开始
+int handle_subscribe(const uint8_t *request_data, uint16_t request_len, 
+                    uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)response_data;
+    
+    TlvBinding binding;
+    uint32_t interval_ms;
+    uint8_t alarm_events = 0;
+    uint8_t stream_id = 0;
+    if (tlv_schema_bind(tlv_schema_request(OP_SUBSCRIBE), request_data, request_len, &binding) < 0 ||
+        tlv_binding_get_uint32(&binding, SUBT_IV, &interval_ms) < 0 ||
+        (interval_ms != 0 && interval_ms < SUBSCRIBE_MIN_INTERVAL_MS) ||
+        (tlv_binding_has(&binding, SUBT_AE) &&
+         (tlv_binding_get_uint8(&binding, SUBT_AE, &alarm_events) < 0 || alarm_events > 1)) ||
+        (tlv_binding_has(&binding, SUBT_SF) && tlv_binding_get_uint8(&binding, SUBT_SF, &stream_id) < 0)) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    // 转义组帧的会话不能使用流帧：回复INVALID_PARAM，订阅不变，主机可不带SF重新订阅
+    if (stream_id != 0 && PROTOCOL_FRAMING(protocol_get_tx_version()) != PROTOCOL_VERSION_COBS) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return 0;
+    }
+    
+    session->subscribe_alarm_events = tlv_binding_has(&binding, SUBT_AE) ? alarm_events != 0 : interval_ms != 0;
+    session->subscribe_interval_ms = interval_ms;
+    session->subscribe_next_tick = HAL_GetTick(); // 订阅后立即推送一次
+    session->subscribe_alarm_changed = false;
+    session->subscribe_alarm_mask = alarm_get_active_mask();
+    session->stream_id = stream_id;
+    session->stream_sequence = 0;
+    
+    *status = STATUS_OK;
+    *response_len = 0;
+    return 0;
+}
+
+// 设置温度分辨率命令处理：RS缺省时只返回当前分辨率
+// 分辨率由采样任务在下一次转换前写入传感器，写入并读回确认后再响应
+int handle_set_resolution(const uint8_t *request_data, uint16_t request_len, 
+                         uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    TlvBinding binding;
+    if (tlv_schema_bind(tlv_schema_request(OP_SET_RESOLUTION), request_data, request_len, &binding) < 0) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    if (!tlv_binding_has(&binding, SRES_REQ_RS)) {
+        return report_resolution(temperature_get_resolution(), response_data, response_len, status);
+    }
+    
+    uint8_t bits;
+    if (tlv_binding_get_uint8(&binding, SRES_REQ_RS, &bits) < 0 ||
+        bits < TEMP_RESOLUTION_MIN || bits > TEMP_RESOLUTION_MAX) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    requested_resolution = bits;
+    fresh_after_sequence = temp_sampler_request_resolution(bits);
+    
+    TempSample sample;
+    int result = await_fresh_sample(complete_set_resolution, &sample);
+    if (result == 0) {
+        return report_new_resolution(response_data, response_len, status);
+    }
+    return fail_fresh_sample(result, response_len, status);
+}
+
+// 采样任务应用新分辨率后的第一次采样完成时生成sres响应
+static int complete_set_resolution(uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    TempSample sample;
+    int result = check_fresh_sample(complete_set_resolution, &sample);
+    if (result == 0) {
+        return report_new_resolution(response_data, response_len, status);
+    }
+    return fail_fresh_sample(result, response_len, status);
+}
+
+// 新分辨率生效后保存（采样设置）
+static int report_new_resolution(uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    int result = report_resolution(requested_resolution, response_data, response_len, status);
+    if (result == 0) {
+        config_store_request_save(CONFIG_KEY_SAMPLING);
+    }
+    return result;
+}
+
+// 生效的分辨率与期望不一致（写入或读回失败）时为传感器错误
+static int report_resolution(uint8_t expected, uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    uint8_t bits = temperature_get_resolution();
+    if (bits != expected) {
+        *status = STATUS_SENSOR_ERROR;
+        *response_len = 0;
+        return -1;
+    }
+    
+    int len = write_tlv_uint8(response_data, MAX_DATA_SIZE, TAG_RESOLUTION, bits);
+    if (len < 0) {
+        *status = STATUS_INTERNAL_ERROR;
+        *response_len = 0;
+        return -1;
+    }
+    
+    *status = STATUS_OK;
+    *response_len = len;
+    return 0;
+}
+
+// 设置温度滤波命令处理：FM缺省时只返回当前配置
+// 滤波在采样任务中进行，新配置从下一次采样开始生效（历史清空）
+int handle_set_filter(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    TlvBinding binding;
+    if (tlv_schema_bind(tlv_schema_request(OP_SET_FILTER), request_data, request_len, &binding) < 0) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    if (tlv_binding_has(&binding, SFLT_FM)) {
+        TempFilterConfig config = { TEMP_FILTER_NONE, 0 };
+        if (tlv_binding_get_uint8(&binding, SFLT_FM, &config.mode) < 0 ||
+            (tlv_binding_has(&binding, SFLT_FN) && tlv_binding_get_uint8(&binding, SFLT_FN, &config.param) < 0) ||
+            !temp_filter_config_valid(&config)) {
+            *status = STATUS_INVALID_PARAM;
+            *response_len = 0;
+            return -1;
+        }
+        temp_filter_configure(&config);
+        config_store_request_save(CONFIG_KEY_SAMPLING);
+    }
+    
+    return report_filter(response_data, response_len, status);
+}
+
+static int report_filter(uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    TempFilterConfig config;
+    temp_filter_get_config(&config);
+    
+    uint16_t len = 0;
+    int fm_len = write_tlv_uint8(response_data, MAX_DATA_SIZE, TAG_FILTER_MODE, config.mode);
+    if (fm_len < 0) goto error;
+    len += fm_len;
+    
+    int fn_len = write_tlv_uint8(response_data + len, MAX_DATA_SIZE - len, TAG_FILTER_PARAM, config.param);
+    if (fn_len < 0) goto error;
+    len += fn_len;
+    
+    *status = STATUS_OK;
+    *response_len = len;
+    return 0;
+    
+error:
+    *status = STATUS_INTERNAL_ERROR;
+    *response_len = 0;
+    return -1;
+}
+
+// 获取传感器状态命令处理：返回采样任务记录的健康状态，不访问总线
+int handle_get_sensors(const uint8_t *request_data, uint16_t request_len, 
+                      uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)request_data;
+    (void)request_len;
+    
+    uint32_t now = HAL_GetTick();
+    uint16_t len = 0;
+    
+    int sl_len = write_tlv_begin(response_data, MAX_DATA_SIZE, TAG_SENSOR_LIST);
+    if (sl_len < 0) goto error;
+    len += sl_len;
+    
+    TempSensorHealth health;
+    for (uint8_t i = 0; temperature_get_health(i, &health); i++) {
+        uint8_t *item = response_data + len;
+        int it_len = write_tlv_begin(item, MAX_DATA_SIZE - len, TAG_ALARM_ITEM);
+        if (it_len < 0) goto error;
+        len += it_len;
+        
+        int sn_len = write_tlv_uint8(response_data + len, MAX_DATA_SIZE - len, TAG_SENSOR, i);
+        if (sn_len < 0) goto error;
+        len += sn_len;
+        
+        int pr_len = write_tlv_uint8(response_data + len, MAX_DATA_SIZE - len, TAG_PRESENT, health.present ? 1 : 0);
+        if (pr_len < 0) goto error;
+        len += pr_len;
+        
+        int fc_len = write_tlv_uint32(response_data + len, MAX_DATA_SIZE - len, TAG_FAULT_COUNT, health.fault_count);
+        if (fc_len < 0) goto error;
+        len += fc_len;
+        
+        int cf_len = write_tlv_uint16(response_data + len, MAX_DATA_SIZE - len, TAG_CONSECUTIVE_FAULTS, health.consecutive_faults);
+        if (cf_len < 0) goto error;
+        len += cf_len;
+        
+        // 从未读取成功时不返回LS
+        if (health.seen_count != 0) {
+            int ls_len = write_tlv_uint32(response_data + len, MAX_DATA_SIZE - len, TAG_LAST_SEEN, now - health.last_seen_tick);
+            if (ls_len < 0) goto error;
+            len += ls_len;
+        }
+        
+        write_tlv_end(item, response_data + len - item - 4);
+    }
+    
+    write_tlv_end(response_data, len - 4);
+    
+    *status = STATUS_OK;
+    *response_len = len;
+    return 0;
+    
+error:
+    *status = STATUS_INTERNAL_ERROR;
+    *response_len = 0;
+    return -1;
+}
+
+// 任务状态命令处理：各任务按创建顺序返回名称、优先级和栈的历史最小剩余（字节），
+// FreeRTOS堆的当前和历史最小剩余，以及各内存池的用量；
+// uxTaskGetSystemState()在调度器挂起时逐个扫描各任务的栈。
+// 各任务的CPU占用按上次gtsk以来（首次为启动以来）的运行时间计算，单位0.01%；
+// 运行时间计数（micros()）约71.6分钟回绕，间隔更长时不返回LD
+#define TASK_REPORT_MAX 12
+#define TASK_LOAD_WINDOW_MAX_MS (UINT32_MAX / 1000U)
+static TaskStatus_t task_status[TASK_REPORT_MAX];
+static uint32_t task_last_run_time[TASK_REPORT_MAX + 1]; // 按任务编号（从1开始）
+static uint32_t task_last_total_run_time = 0;
+static TickType_t task_last_load_tick = 0;
+
+int handle_get_tasks(const uint8_t *request_data, uint16_t request_len, 
+                    uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)request_data;
+    (void)request_len;
+    
+    uint32_t total_run_time = 0;
+    UBaseType_t count = uxTaskGetSystemState(task_status, TASK_REPORT_MAX, &total_run_time);
+    TickType_t now = xTaskGetTickCount();
+    uint32_t window_ms = (uint32_t)(now - task_last_load_tick) * portTICK_PERIOD_MS;
+    uint32_t window = total_run_time - task_last_total_run_time;
+    bool load_valid = window_ms < TASK_LOAD_WINDOW_MAX_MS && window != 0;
+    task_last_load_tick = now;
+    task_last_total_run_time = total_run_time;
+    
+    for (UBaseType_t i = 1; i < count; i++) {
+        TaskStatus_t task = task_status[i];
+        UBaseType_t j = i;
+        while (j > 0 && task_status[j - 1].xTaskNumber > task.xTaskNumber) {
+            task_status[j] = task_status[j - 1];
+            j--;
+        }
+        task_status[j] = task;
+    }
+    
+    uint16_t len = 0;
+    int tk_len = write_tlv_begin(response_data, RESPONSE_DATA_BUDGET, TAG_TASK_LIST);
+    if (tk_len < 0) goto error;
+    len += tk_len;
+    
+    for (UBaseType_t i = 0; i < count; i++) {
+        uint8_t *item = response_data + len;
+        int it_len = write_tlv_begin(item, RESPONSE_DATA_BUDGET - len, TAG_ALARM_ITEM);
+        if (it_len < 0) goto error;
+        len += it_len;
+        
+        int nm_len = write_tlv_string(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_TASK_NAME, task_status[i].pcTaskName);
+        if (nm_len < 0) goto error;
+        len += nm_len;
+        
+        int pi_len = write_tlv_uint8(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_TASK_PRIORITY, (uint8_t)task_status[i].uxCurrentPriority);
+        if (pi_len < 0) goto error;
+        len += pi_len;
+        
+        uint32_t stack_free = (uint32_t)task_status[i].usStackHighWaterMark * sizeof(StackType_t);
+        int sw_len = write_tlv_uint16(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_STACK_FREE, (uint16_t)stack_free);
+        if (sw_len < 0) goto error;
+        len += sw_len;
+        
+        UBaseType_t number = task_status[i].xTaskNumber;
+        if (number <= TASK_REPORT_MAX) {
+            uint32_t run_time = task_status[i].ulRunTimeCounter - task_last_run_time[number];
+            task_last_run_time[number] = task_status[i].ulRunTimeCounter;
+            if (load_valid) {
+                uint64_t load = (uint64_t)run_time * 10000U / window;
+                int ld_len = write_tlv_uint16(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_TASK_LOAD,
+                                              load > 10000U ? 10000U : (uint16_t)load);
+                if (ld_len < 0) goto error;
+                len += ld_len;
+            }
+        }
+        
+        write_tlv_end(item, response_data + len - item - 4);
+    }
+    write_tlv_end(response_data, len - 4);
+    
+    int hf_len = write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_HEAP_FREE, xPortGetFreeHeapSize());
+    if (hf_len < 0) goto error;
+    len += hf_len;
+    
+    int hm_len = write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_HEAP_MIN, xPortGetMinimumEverFreeHeapSize());
+    if (hm_len < 0) goto error;
+    len += hm_len;
+    
+    uint8_t *pools = response_data + len;
+    int pl_len = write_tlv_begin(pools, RESPONSE_DATA_BUDGET - len, TAG_POOL_LIST);
+    if (pl_len < 0) goto error;
+    len += pl_len;
+    
+    BlockPoolStats pool;
+    for (uint8_t i = 0; block_pool_get_stats(i, &pool); i++) {
+        uint8_t *item = response_data + len;
+        int it_len = write_tlv_begin(item, RESPONSE_DATA_BUDGET - len, TAG_ALARM_ITEM);
+        if (it_len < 0) goto error;
+        len += it_len;
+        
+        int nm_len = write_tlv_string(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_TASK_NAME, pool.name);
+        if (nm_len < 0) goto error;
+        len += nm_len;
+        
+        int bs_len = write_tlv_uint16(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_BLOCK_SIZE, pool.block_size);
+        if (bs_len < 0) goto error;
+        len += bs_len;
+        
+        int bn_len = write_tlv_uint16(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_BLOCK_COUNT, pool.block_count);
+        if (bn_len < 0) goto error;
+        len += bn_len;
+        
+        int bu_len = write_tlv_uint16(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_BLOCK_USED, pool.used);
+        if (bu_len < 0) goto error;
+        len += bu_len;
+        
+        int bp_len = write_tlv_uint16(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_BLOCK_PEAK, pool.peak);
+        if (bp_len < 0) goto error;
+        len += bp_len;
+        
+        int bf_len = write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_BLOCK_FAILURES, pool.failures);
+        if (bf_len < 0) goto error;
+        len += bf_len;
+        
+        write_tlv_end(item, response_data + len - item - 4);
+    }
+    write_tlv_end(pools, response_data + len - pools - 4);
+    
+    int rr_len = write_tlv_uint8(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_RESET_REASON, watchdog_reset_reason());
+    if (rr_len < 0) goto error;
+    len += rr_len;
+    
+    char stalled[5];
+    if (watchdog_stalled_task(stalled)) {
+        int wt_len = write_tlv_string(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_STALLED_TASK, stalled);
+        if (wt_len < 0) goto error;
+        len += wt_len;
+    }
+    
+    int lw_len = write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_LOAD_WINDOW, window_ms);
+    if (lw_len < 0) goto error;
+    len += lw_len;
+    
+    *status = STATUS_OK;
+    *response_len = len;
+    return 0;
+    
+error:
+    *status = STATUS_INTERNAL_ERROR;
+    *response_len = 0;
+    return -1;
+}
+
+// 直方图按uint16小端编码，省去末尾的空桶
+static int write_histogram(uint8_t *buffer, uint16_t buffer_size, const char *tag, const uint16_t *hist,
+                           uint8_t buckets) {
+    while (buckets > 0 && hist[buckets - 1] == 0) {
+        buckets--;
+    }
+    return write_tlv_raw(buffer, buffer_size, tag, (const uint8_t *)hist, (uint16_t)(buckets * sizeof(uint16_t)));
+}
+
+// 命令统计：从ID（默认0）开始列出有请求的指令编号，没有装下的由NX给出下一个编号；
+// 之后是采样计划的统计（JN/JM/JX/JH/JL）。CL为1时清零本次返回的各项和采样计划的统计
+#define SCHED_STATS_SIZE (4 * 8 + 4 + SAMPLE_SCHEDULE_BUCKETS * 2)
+int handle_get_stats(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    TlvBinding request;
+    uint8_t first = 0;
+    uint8_t clear = 0;
+    if (tlv_schema_bind(tlv_schema_request(OP_GET_STATS), request_data, request_len, &request) < 0 ||
+        (tlv_binding_get_uint8(&request, STAT_REQ_ID, &first) > 0 && first >= COMMAND_STATS_OPCODES) ||
+        (tlv_binding_get_uint8(&request, STAT_REQ_CL, &clear) > 0 && clear > 1)) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    // CS之后留出NX和采样计划的统计
+    uint16_t budget = RESPONSE_DATA_BUDGET - 5 - SCHED_STATS_SIZE;
+    uint16_t len = write_tlv_begin(response_data, budget, TAG_STATS_LIST);
+    uint8_t next = first;
+    
+    for (; next < COMMAND_STATS_OPCODES; next++) {
+        CommandStats stats;
+        command_stats_get(next, &stats);
+        if (stats.count == 0) {
+            continue;
+        }
+        
+        uint8_t *item = response_data + len;
+        uint16_t item_size = budget - len;
+        if (item_size < 4 + 5 + 3 * 8 + 2 * (4 + COMMAND_STATS_BUCKETS * 2)) { // IT + ID + NR/QX/TX + QH/TH
+            break;
+        }
+        
+        uint16_t item_len = write_tlv_begin(item, item_size, TAG_ALARM_ITEM);
+        item_len += write_tlv_uint8(item + item_len, item_size - item_len, TAG_ALARM_ID, next);
+        item_len += write_tlv_uint32(item + item_len, item_size - item_len, TAG_STATS_COUNT, stats.count);
+        item_len += write_tlv_uint32(item + item_len, item_size - item_len, TAG_QUEUED_MAX, stats.queued_max_us);
+        item_len += write_histogram(item + item_len, item_size - item_len, TAG_QUEUED_HIST, stats.queued_hist, COMMAND_STATS_BUCKETS);
+        item_len += write_tlv_uint32(item + item_len, item_size - item_len, TAG_TRANSMIT_MAX, stats.transmit_max_us);
+        item_len += write_histogram(item + item_len, item_size - item_len, TAG_TRANSMIT_HIST, stats.transmit_hist, COMMAND_STATS_BUCKETS);
+        len += write_tlv_end(item, item_len - 4);
+        
+        if (clear) {
+            command_stats_reset(next);
+        }
+    }
+    
+    write_tlv_end(response_data, len - 4);
+    
+    if (next < COMMAND_STATS_OPCODES) {
+        len += write_tlv_uint8(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_ALARM_NEXT, next);
+    }
+    
+    SampleScheduleStats schedule;
+    sample_schedule_get_stats(&schedule);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_SCHED_SAMPLES, schedule.samples);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_SCHED_MISSED, schedule.missed);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_SCHED_ERROR_MAX, schedule.error_max_ms);
+    len += write_histogram(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_SCHED_ERROR_HIST, schedule.error_hist,
+                           SAMPLE_SCHEDULE_BUCKETS);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_SCHED_LEAD, schedule.lead_ms);
+    if (clear) {
+        sample_schedule_clear_stats();
+    }
+    
+    *status = STATUS_OK;
+    *response_len = len;
+    return 0;
+}
+
+// 链路统计：CL为1时返回后清零
+int handle_get_comm_stats(const uint8_t *request_data, uint16_t request_len, 
+                          uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    TlvBinding request;
+    uint8_t clear = 0;
+    if (tlv_schema_bind(tlv_schema_request(OP_GET_COMM_STATS), request_data, request_len, &request) < 0 ||
+        (tlv_binding_get_uint8(&request, GCOM_REQ_CL, &clear) > 0 && clear > 1)) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    CommStats stats;
+    communication_get_stats(&stats);
+    uint32_t replays = response_cache_replays();
+    if (clear) {
+        communication_reset_stats();
+        response_cache_reset_stats();
+    }
+    
+    // 16个定长字段共约140字节，不会超出RESPONSE_DATA_BUDGET
+    uint16_t len = 0;
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_PACKETS_IN, stats.packets_received);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_PACKETS_OUT, stats.packets_sent);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_BYTES_IN, stats.rx_bytes);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_BYTES_OUT, stats.tx_bytes);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_CRC_ERRORS, stats.crc_errors);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_FORMAT_ERRORS, stats.format_errors);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_UART_ERRORS, stats.timeout_errors);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_UNSTUFFED, stats.rx_unstuffed);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_STUFFED, stats.tx_stuffed);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_RESYNCS, stats.resyncs);
+    len += write_tlv_uint16(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_RING_PEAK, (uint16_t)stats.rx_ring_peak);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_RING_OVERFLOWS, stats.rx_overflows);
+    len += write_tlv_uint8(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_TX_QUEUE_PEAK, (uint8_t)stats.tx_queue_peak);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_TX_DROPPED, stats.tx_dropped);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_RX_DROPPED, stats.rx_dropped);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_REPLAYED, replays);
+    
+    *status = STATUS_OK;
+    *response_len = len;
+    return 0;
+}
+
+// 跟踪记录：从ID（默认最旧的一条）开始按TraceRecord布局原样返回，NX为下一条的序号，
+// TL为ID之后已被覆盖的条数；TE为空表示已读到最新
+#define TRACE_READ_MAX ((RESPONSE_DATA_BUDGET - 4 - 8 - 8 - 5) / sizeof(TraceRecord))
+
+int handle_get_trace(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    TlvBinding request;
+    uint32_t sequence = 0;
+    if (tlv_schema_bind(tlv_schema_request(OP_GET_TRACE), request_data, request_len, &request) < 0) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    if (tlv_binding_get_uint32(&request, GTRC_REQ_ID, &sequence) <= 0) {
+        sequence = trace_oldest();
+    }
+    
+    uint32_t lost = 0;
+    uint16_t len = write_tlv_begin(response_data, RESPONSE_DATA_BUDGET, TAG_TRACE_RECORDS);
+    uint16_t count = trace_read(&sequence, response_data + len, TRACE_READ_MAX, &lost);
+    len += count * sizeof(TraceRecord);
+    write_tlv_end(response_data, len - 4);
+    
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_ALARM_NEXT, sequence);
+    len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_TRACE_LOST, lost);
+    len += write_tlv_uint8(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_CYCLES_PER_US, (uint8_t)timebase_cycles_per_us);
+    
+    *status = STATUS_OK;
+    *response_len = len;
+    return 0;
+}
+
+// 链路吞吐测试：SQ(6) + PD头(4)之外的响应空间都可用于载荷
+#define BENCH_PAYLOAD_MAX (RESPONSE_DATA_BUDGET - 6 - 4)
+
+// 连续发送的生成载荷（同一时刻只进行一组，新的bnch请求取代未发完的一组）
+static uint16_t bench_size = 0;
+static uint16_t bench_count = 0;
+static uint16_t bench_sequence = 0;
+
+// 第sequence帧的载荷：字节i为(sequence + i)的低8位，包含需要转义的0xAA/0x55
+static int write_bench_frame(uint16_t sequence, const uint8_t *payload, uint16_t size,
+                             uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    uint16_t len = write_tlv_uint16(response_data, RESPONSE_DATA_BUDGET, TAG_SEQUENCE, sequence);
+    if (payload) {
+        len += write_tlv_raw(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_BENCH_PAYLOAD, payload, size);
+    } else {
+        uint8_t *field = response_data + len;
+        len += write_tlv_begin(field, RESPONSE_DATA_BUDGET - len, TAG_BENCH_PAYLOAD);
+        for (uint16_t i = 0; i < size; i++) {
+            response_data[len++] = (uint8_t)(sequence + i);
+        }
+        write_tlv_end(field, size);
+    }
+    
+    *status = STATUS_OK;
+    *response_len = len;
+    return 0;
+}
+
+// 生成下一帧，未发完时立即再挂起；由执行任务的轮询随发送槽空出逐帧发送
+static int complete_bench(uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    uint16_t sequence = bench_sequence++;
+    if (bench_sequence < bench_count) {
+        command_defer(complete_bench, 0);
+    }
+    return write_bench_frame(sequence, NULL, bench_size, response_data, response_len, status);
+}
+
+int handle_bench(const uint8_t *request_data, uint16_t request_len, 
+                 uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    TlvBinding request;
+    const uint8_t *payload = NULL;
+    uint16_t size = 0;
+    uint16_t count = 1;
+    if (tlv_schema_bind(tlv_schema_request(OP_BENCH), request_data, request_len, &request) < 0) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    tlv_binding_get_uint16(&request, BNCH_REQ_SZ, &size);
+    tlv_binding_get_uint16(&request, BNCH_REQ_CT, &count);
+    bool echo = tlv_binding_get_view(&request, BNCH_REQ_PD, &payload, &size) >= 0;
+    
+    // 回显的载荷只在本次请求期间有效，只能回复一帧；PD与SZ不能同时出现
+    if (size > BENCH_PAYLOAD_MAX || count == 0 ||
+        (echo && (count != 1 || tlv_binding_has(&request, BNCH_REQ_SZ)))) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    // 连续发送须在当前上下文能挂起（批量请求中不能）
+    cancel_pending(complete_bench);
+    bench_size = size;
+    bench_count = count;
+    bench_sequence = 1;
+    if (count > 1 && !command_defer(complete_bench, 0)) {
+        *status = STATUS_BUSY;
+        *response_len = 0;
+        return -1;
+    }
+    return write_bench_frame(0, payload, size, response_data, response_len, status);
+}
+
+// 设置日志间隔命令处理：IV为0停止记录，否则不小于TEMP_LOG_INTERVAL_MIN_MS；
+// 不带IV时只查询当前间隔。LC/TO/HB设置SN号传感器的日志压缩（log_compress.h），不保存
+int handle_set_log_interval(const uint8_t *request_data, uint16_t request_len, 
+                           uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    TlvBinding binding;
+    if (tlv_schema_bind(tlv_schema_request(OP_SET_LOG_INTERVAL), request_data, request_len, &binding) < 0) {
+        *status = STATUS_INVALID_PARAM;
         *response_len = 0;
         return -1;
     }
     
-    RTCTime time;
-    if (!rtc_get_time(&time)) {
-        *status = STATUS_NOT_INITIALIZED;
+    if (tlv_binding_has(&binding, SLOG_IV)) {
+        uint32_t interval_ms;
+        if (tlv_binding_get_uint32(&binding, SLOG_IV, &interval_ms) < 0 ||
+            !temp_logger_set_interval(interval_ms)) {
+            *status = STATUS_INVALID_PARAM;
+            *response_len = 0;
+            return -1;
+        }
+        config_store_request_save(CONFIG_KEY_SAMPLING);
+    }
+    
+    // SN选择压缩配置所属的传感器（缺省为0）；带LC时修改配置，TO、HB缺省时取默认值
+    uint8_t sensor = 0;
+    LogCompressConfig compress;
+    if (tlv_binding_has(&binding, SLOG_SN) &&
+        (tlv_binding_get_uint8(&binding, SLOG_SN, &sensor) < 0 || sensor >= TEMP_MAX_SENSORS)) {
+        *status = STATUS_INVALID_PARAM;
         *response_len = 0;
-        return -1;
+        return 0;
+    }
+    if (tlv_binding_has(&binding, SLOG_LC)) {
+        compress.tolerance = LOG_COMPRESS_DEFAULT_TOLERANCE;
+        compress.heartbeat_ms = LOG_COMPRESS_DEFAULT_HEARTBEAT_MS;
+        if (tlv_binding_get_uint8(&binding, SLOG_LC, &compress.mode) < 0 ||
+            (tlv_binding_has(&binding, SLOG_TO) &&
+             tlv_binding_get_temperature(&binding, SLOG_TO, &compress.tolerance) < 0) ||
+            (tlv_binding_has(&binding, SLOG_HB) &&
+             tlv_binding_get_uint32(&binding, SLOG_HB, &compress.heartbeat_ms) < 0) ||
+            !log_compress_config_valid(&compress)) {
+            *status = STATUS_INVALID_PARAM;
+            *response_len = 0;
+            return 0;
+        }
+        log_compress_configure(sensor, &compress);
+        config_store_request_save(CONFIG_KEY_COMPRESS);
     }
+    log_compress_get_config(sensor, &compress);
     
-    // 构建响应数据
-    uint16_t offset = 0;
+    uint16_t len = 0;
+    int field_len = write_tlv_uint32(response_data, MAX_DATA_SIZE, TAG_INTERVAL, temp_logger_get_interval());
+    if (field_len < 0) goto error;
+    len += field_len;
     
-    int hh_len = write_tlv_uint8(response_data + offset, MAX_DATA_SIZE - offset, TAG_HOUR, time.hour);
-    if (hh_len < 0) goto error;
-    offset += hh_len;
+    field_len = write_tlv_uint8(response_data + len, MAX_DATA_SIZE - len, TAG_SENSOR, sensor);
+    if (field_len < 0) goto error;
+    len += field_len;
     
-    int mm_len = write_tlv_uint8(response_data + offset, MAX_DATA_SIZE - offset, TAG_MINUTE, time.minute);
-    if (mm_len < 0) goto error;
-    offset += mm_len;
+    field_len = write_tlv_uint8(response_data + len, MAX_DATA_SIZE - len, TAG_LOG_COMPRESSION, compress.mode);
+    if (field_len < 0) goto error;
+    len += field_len;
     
-    int ss_len = write_tlv_uint8(response_data + offset, MAX_DATA_SIZE - offset, TAG_SECOND, time.second);
-    if (ss_len < 0) goto error;
-    offset += ss_len;
+    field_len = write_tlv_temperature(response_data + len, MAX_DATA_SIZE - len, TAG_TOLERANCE,
+                                      compress.tolerance, session->temperature_format);
+    if (field_len < 0) goto error;
+    len += field_len;
+    
+    field_len = write_tlv_uint32(response_data + len, MAX_DATA_SIZE - len, TAG_HEARTBEAT, compress.heartbeat_ms);
+    if (field_len < 0) goto error;
+    len += field_len;
     
     *status = STATUS_OK;
-    *response_len = offset;
+    *response_len = len;
     return 0;
     
 error:
@@ -247,261 +3272,736 @@ error:
     return -1;
 }
 
-// 设置RTC日期命令处理 
-int handle_set_rtc_date(const uint8_t *request_data, uint16_t request_len, 
+// 设置从机地址命令处理：AD为0取消地址（有线链路不过滤），否则为1~247；
+// 不带AD时只查询。新地址立即生效，响应的包头已带新地址
+int handle_set_address(const uint8_t *request_data, uint16_t request_len, 
                        uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
-    (void)response_data;
-    
-    if (!rtc_is_initialized()) {
-        *status = STATUS_NOT_INITIALIZED;
+    TlvBinding binding;
+    if (tlv_schema_bind(tlv_schema_request(OP_SET_ADDRESS), request_data, request_len, &binding) < 0) {
+        *status = STATUS_INVALID_PARAM;
         *response_len = 0;
         return -1;
     }
     
-    RTCDate date;
+    uint8_t address = communication_get_address();
+    if (tlv_binding_has(&binding, SADR_AD)) {
+        if (tlv_binding_get_uint8(&binding, SADR_AD, &address) < 0 ||
+            (address != PROTOCOL_ADDRESS_NONE && (address < PROTOCOL_ADDRESS_MIN || address > PROTOCOL_ADDRESS_MAX))) {
+            *status = STATUS_INVALID_PARAM;
+            *response_len = 0;
+            return -1;
+        }
+    }
     
-    // 读取各个字段
-    if (read_tlv_uint8(request_data, request_len, TAG_YEAR, &date.year) < 0 ||
-        read_tlv_uint8(request_data, request_len, TAG_MONTH, &date.month) < 0 ||
-        read_tlv_uint8(request_data, request_len, TAG_DAY, &date.day) < 0 ||
-        read_tlv_uint8(request_data, request_len, TAG_WEEKDAY, &date.weekday) < 0) {
-        
-        *status = STATUS_INVALID_PARAM;
+    int ad_len = write_tlv_uint8(response_data, MAX_DATA_SIZE, TAG_ADDRESS, address);
+    if (ad_len < 0) {
+        *status = STATUS_INTERNAL_ERROR;
         *response_len = 0;
         return -1;
     }
     
-    // 设置日期
-    if (!rtc_set_date(&date)) {
-        *status = STATUS_INVALID_PARAM;
-        *response_len = 0;
-        return -1;
+    if (address != communication_get_address()) {
+        communication_set_address(address);
+        config_store_request_save(CONFIG_KEY_ADDRESS);
     }
     
     *status = STATUS_OK;
-    *response_len = 0;
+    *response_len = (uint16_t)ad_len;
     return 0;
 }
 
-// 设置RTC时间命令处理
-int handle_set_rtc_time(const uint8_t *request_data, uint16_t request_len, 
-                       uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
-    (void)response_data;
-    
-    if (!rtc_is_initialized()) {
-        *status = STATUS_NOT_INITIALIZED;
+// 网关设置命令处理：AD为下游设备的地址表（每字节一个地址，空为停止轮询），IV为每轮轮询的间隔；
+// 不带的字段保持不变，都不带时只查询。新设置立即生效并保存在闪存中
+int handle_gateway_config(const uint8_t *request_data, uint16_t request_len, 
+                          uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+#if COMM_GATEWAY
+    TlvBinding binding;
+    if (tlv_schema_bind(tlv_schema_request(OP_GATEWAY_CONFIG), request_data, request_len, &binding) < 0) {
+        *status = STATUS_INVALID_PARAM;
         *response_len = 0;
         return -1;
     }
     
-    RTCTime time;
-    
-    // 读取各个字段
-    if (read_tlv_uint8(request_data, request_len, TAG_HOUR, &time.hour) < 0 ||
-        read_tlv_uint8(request_data, request_len, TAG_MINUTE, &time.minute) < 0 ||
-        read_tlv_uint8(request_data, request_len, TAG_SECOND, &time.second) < 0) {
-        
-        *status = STATUS_INVALID_PARAM;
-        *response_len = 0;
-        return -1;
+    GatewayConfig current, requested;
+    gateway_get_config(&current);
+    requested = current;
+    const uint8_t *addresses;
+    uint16_t count;
+    if (tlv_binding_get_view(&binding, SGWY_AD, &addresses, &count) >= 0) {
+        if (count > GATEWAY_MAX_DEVICES) {
+            *status = STATUS_INVALID_PARAM;
+            *response_len = 0;
+            return -1;
+        }
+        memset(requested.addresses, 0, sizeof(requested.addresses));
+        memcpy(requested.addresses, addresses, count);
+        requested.count = (uint8_t)count;
     }
+    tlv_binding_get_uint32(&binding, SGWY_IV, &requested.interval_ms);
     
-    // 设置时间
-    if (!rtc_set_time(&time)) {
-        *status = STATUS_INVALID_PARAM;
-        *response_len = 0;
-        return -1;
+    if (memcmp(&requested, &current, sizeof(current)) != 0) {
+        if (!gateway_configure(&requested)) {
+            *status = STATUS_INVALID_PARAM;
+            *response_len = 0;
+            return -1;
+        }
+        config_store_request_save(CONFIG_KEY_GATEWAY);
     }
     
+    uint16_t len = write_tlv_raw(response_data, MAX_DATA_SIZE, TAG_ADDRESS, requested.addresses, requested.count);
+    len += write_tlv_uint32(response_data + len, MAX_DATA_SIZE - len, TAG_INTERVAL, requested.interval_ms);
     *status = STATUS_OK;
-    *response_len = 0;
+    *response_len = len;
     return 0;
-}
-
-// 获取报警配置命令处理
-int handle_get_alarms(const uint8_t *request_data, uint16_t request_len, 
-                     uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+#else
     (void)request_data;
     (void)request_len;
-    
-    uint8_t alarm_list_data[MAX_DATA_SIZE];
-    uint16_t alarm_list_len = 0;
-    
-    // 构建报警列表
-    for (int i = 0; i < MAX_ALARMS; i++) {
-        AlarmConfig config;
-        alarm_get_config(i, &config);
+    (void)response_data;
+    *status = STATUS_NOT_INITIALIZED;
+    *response_len = 0;
+    return -1;
+#endif
+}
+
+// 网关读数命令处理：按地址表顺序返回各下游设备的缓存，带AD时只返回该设备；
+// 从未应答的设备只有AD和CF，取得过读数的设备带T和AG（读数的时效加上缓存以来的时间）
+int handle_gateway_read(const uint8_t *request_data, uint16_t request_len, 
+                        uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+#if COMM_GATEWAY
+    TlvBinding binding;
+    uint8_t filter = PROTOCOL_ADDRESS_NONE;
+    if (tlv_schema_bind(tlv_schema_request(OP_GATEWAY_READ), request_data, request_len, &binding) < 0) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    tlv_binding_get_uint8(&binding, GGWY_REQ_AD, &filter);
+    
+    uint32_t now = HAL_GetTick();
+    uint16_t len = 0;
+    int gw_len = write_tlv_begin(response_data, RESPONSE_DATA_BUDGET, TAG_GATEWAY_LIST);
+    if (gw_len < 0) goto error;
+    len += gw_len;
+    
+    GatewayDevice device;
+    for (uint8_t i = 0; gateway_get_device(i, &device); i++) {
+        if (filter != PROTOCOL_ADDRESS_NONE && device.address != filter) {
+            continue;
+        }
+        uint8_t *item = response_data + len;
+        int it_len = write_tlv_begin(item, RESPONSE_DATA_BUDGET - len, TAG_ALARM_ITEM);
+        if (it_len < 0) goto error;
+        len += it_len;
         
-        // 构建单个报警项
-        uint8_t alarm_item_data[64];
-        uint16_t alarm_item_len = 0;
+        int ad_len = write_tlv_uint8(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_ADDRESS, device.address);
+        if (ad_len < 0) goto error;
+        len += ad_len;
         
-        int id_len = write_tlv_uint8(alarm_item_data + alarm_item_len, sizeof(alarm_item_data) - alarm_item_len, TAG_ALARM_ID, config.id);
-        if (id_len < 0) goto error;
-        alarm_item_len += id_len;
+        if (device.answered) {
+            int st_len = write_tlv_uint8(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_STATUS, device.status);
+            if (st_len < 0) goto error;
+            len += st_len;
+        }
         
-        int low_len = write_tlv_float32(alarm_item_data + alarm_item_len, sizeof(alarm_item_data) - alarm_item_len, TAG_ALARM_LOW, config.low_temp);
-        if (low_len < 0) goto error;
-        alarm_item_len += low_len;
+        if (device.has_reading) {
+            int t_len = write_tlv_temperature(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_TEMPERATURE,
+                                              device.temperature, session->temperature_format);
+            if (t_len < 0) goto error;
+            len += t_len;
+            
+            int ag_len = write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_SAMPLE_AGE,
+                                          device.sample_age_ms + (now - device.reading_tick));
+            if (ag_len < 0) goto error;
+            len += ag_len;
+        }
         
-        int high_len = write_tlv_float32(alarm_item_data + alarm_item_len, sizeof(alarm_item_data) - alarm_item_len, TAG_ALARM_HIGH, config.high_temp);
-        if (high_len < 0) goto error;
-        alarm_item_len += high_len;
+        int cf_len = write_tlv_uint16(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_CONSECUTIVE_FAULTS, device.consecutive_misses);
+        if (cf_len < 0) goto error;
+        len += cf_len;
         
-        // 添加到报警列表
-        int item_len = write_tlv_raw(alarm_list_data + alarm_list_len, sizeof(alarm_list_data) - alarm_list_len, TAG_ALARM_ITEM, alarm_item_data, alarm_item_len);
-        if (item_len < 0) goto error;
-        alarm_list_len += item_len;
+        write_tlv_end(item, response_data + len - item - 4);
     }
     
-    // 构建最终响应
-    int al_len = write_tlv_raw(response_data, MAX_DATA_SIZE, TAG_ALARM_LIST, alarm_list_data, alarm_list_len);
-    if (al_len < 0) goto error;
+    write_tlv_end(response_data, len - 4);
     
     *status = STATUS_OK;
-    *response_len = al_len;
+    *response_len = len;
     return 0;
     
 error:
     *status = STATUS_INTERNAL_ERROR;
     *response_len = 0;
     return -1;
+#else
+    (void)request_data;
+    (void)request_len;
+    (void)response_data;
+    *status = STATUS_NOT_INITIALIZED;
+    *response_len = 0;
+    return -1;
+#endif
 }
 
-// 设置报警配置命令处理
-int handle_set_alarms(const uint8_t *request_data, uint16_t request_len, 
-                     uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
-    (void)response_data;
-    
-    // 读取报警列表
-    uint8_t alarm_list_data[MAX_DATA_SIZE];
-    uint16_t alarm_list_len = sizeof(alarm_list_data);
+#if COMM_GATEWAY
+// 转发的应答：AD为下游设备地址，DA为下游应答的数据部分（ST[+DA]），原样返回
+static uint8_t forward_target;
+#define FORWARD_POLL_MS 10
+
+static int complete_forward(uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    const uint8_t *payload;
+    uint16_t length;
+    uint8_t type;
+    int result = gateway_forward_result(&payload, &length, &type);
+    if (result == GATEWAY_FORWARD_PENDING && command_defer(complete_forward, FORWARD_POLL_MS)) {
+        *response_len = 0;
+        return COMMAND_DEFERRED;
+    }
     
-    if (read_tlv_raw(request_data, request_len, TAG_ALARM_LIST, alarm_list_data, &alarm_list_len) < 0) {
+    // 超时与glog的STATUS_BUSY一样返回0，状态码原样送达App
+    int ret = 0;
+    *response_len = 0;
+    if (result != 0) {
+        *status = STATUS_TIMEOUT;
+    } else if (length > RESPONSE_DATA_BUDGET - 5 - 4) {
+        *status = STATUS_INTERNAL_ERROR; // 下游应答放不下，应减小请求的MX等
+        ret = -1;
+    } else {
+        uint16_t len = write_tlv_uint8(response_data, RESPONSE_DATA_BUDGET, TAG_ADDRESS, forward_target);
+        len += write_tlv_raw(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_DATA, payload, length);
+        *status = STATUS_OK;
+        *response_len = len;
+    }
+    gateway_forward_release();
+    return ret;
+}
+#endif
+
+// 转发命令处理：把DA（下游请求的数据部分，IN[+DA]）发给地址为AD的下游设备，
+// 挂起到下游应答或超时（STATUS_TIMEOUT）；上一个转发尚未完成时返回STATUS_BUSY
+int handle_forward(const uint8_t *request_data, uint16_t request_len, 
+                   uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+#if COMM_GATEWAY
+    TlvBinding binding;
+    uint8_t address;
+    const uint8_t *request;
+    uint16_t length;
+    if (tlv_schema_bind(tlv_schema_request(OP_FORWARD), request_data, request_len, &binding) < 0 ||
+        tlv_binding_get_uint8(&binding, FWRD_AD, &address) < 0 ||
+        tlv_binding_get_view(&binding, FWRD_DA, &request, &length) < 0 ||
+        address < PROTOCOL_ADDRESS_MIN || address > PROTOCOL_ADDRESS_MAX ||
+        length > GATEWAY_FORWARD_MAX) {
         *status = STATUS_INVALID_PARAM;
         *response_len = 0;
         return -1;
     }
     
-    // 解析报警项
-    // 这里简化处理，假设最多有MAX_ALARMS个报警项
-    // 实际应该遍历所有IT标签
+    if (!gateway_forward(address, request, length)) {
+        *status = STATUS_BUSY; // 上一个转发尚未完成
+        *response_len = 0;
+        return 0;
+    }
+    forward_target = address;
     
-    *status = STATUS_OK;
+    // 挂起后轮询结果；批量请求中不能挂起时直接等待
+    if (command_defer(complete_forward, FORWARD_POLL_MS)) {
+        *response_len = 0;
+        return COMMAND_DEFERRED;
+    }
+    int result;
+    const uint8_t *payload;
+    uint8_t type;
+    while ((result = gateway_forward_result(&payload, &length, &type)) == GATEWAY_FORWARD_PENDING) {
+        osDelay(FORWARD_POLL_MS);
+    }
+    return complete_forward(response_data, response_len, status);
+#else
+    (void)request_data;
+    (void)request_len;
+    (void)response_data;
+    *status = STATUS_NOT_INITIALIZED;
     *response_len = 0;
-    return 0;
+    return -1;
+#endif
 }
 
-// 获取温度日志命令处理
-int handle_get_log(const uint8_t *request_data, uint16_t request_len, 
-                  uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
-    uint64_t start_time = 0, end_time = 0;
-    uint16_t max_count = 100;
+// 获取报警事件命令处理：与glog的单帧响应相同，放不下或达到MX时带CU，
+// 带SI时只返回日志序号大于SI的事件；未指定T1时从最早的事件开始
+int handle_get_events(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    if (!storage_loaded(status, response_len)) {
+        return -1;
+    }
     
-    // 读取查询参数
-    read_tlv_uint64(request_data, request_len, TAG_TIME_START, &start_time);
-    read_tlv_uint64(request_data, request_len, TAG_TIME_END, &end_time);
-    read_tlv_uint16(request_data, request_len, TAG_MAX_COUNT, &max_count);
+    TlvBinding fields;
+    if (tlv_schema_bind(tlv_schema_request(OP_GET_EVENTS), request_data, request_len, &fields) < 0) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
     
-    // 如果未指定时间范围，使用默认值
+    uint64_t start_time = 0, end_time = 0;
+    uint16_t max_count = MAX_LOG_ENTRIES;
+    uint32_t cursor = 0, since = 0;
+    tlv_binding_get_uint64(&fields, GEVT_REQ_T1, &start_time);
+    tlv_binding_get_uint64(&fields, GEVT_REQ_T2, &end_time);
+    tlv_binding_get_uint16(&fields, GEVT_REQ_MX, &max_count);
     if (end_time == 0) {
         end_time = rtc_get_timestamp();
     }
-    if (start_time == 0) {
-        start_time = end_time - 24 * 3600; // 默认查询最近24小时
+    
+    TempLogQuery query;
+    if (tlv_binding_get_uint32(&fields, GEVT_REQ_CU, &cursor) > 0) {
+        alarm_event_query_resume(&query, cursor, end_time);
+    } else if (tlv_binding_get_uint32(&fields, GEVT_REQ_SI, &since) > 0) {
+        if (since >= alarm_event_next_sequence()) {
+            *status = STATUS_INVALID_PARAM;
+            *response_len = 0;
+            return -1;
+        }
+        alarm_event_query_resume(&query, since + 1, end_time);
+    } else {
+        alarm_event_query_begin(&query, start_time, end_time);
     }
     
-    // 获取日志条目
-    TempLogEntry entries[100];
-    uint32_t entry_count = temp_log_get_entries(start_time, end_time, entries, 
-                                              max_count < 100 ? max_count : 100);
+    // EV列表，CU和LN字段预留在列表之后
+    uint16_t budget = RESPONSE_DATA_BUDGET - 16;
+    if (write_tlv_begin(response_data, budget, TAG_EVENT_LIST) < 0) {
+        *status = STATUS_INTERNAL_ERROR;
+        *response_len = 0;
+        return -1;
+    }
     
-    // 构建日志列表
-    uint8_t log_list_data[MAX_DATA_SIZE];
-    uint16_t log_list_len = 0;
+    uint16_t temp_size = (session->temperature_format == TEMP_FORMAT_INT16) ? 6 : 8;
+    uint16_t length = 0;
+    uint32_t n = 0, last = 0;
+    bool more = false;
+    AlarmEvent event;
     
-    for (uint32_t i = 0; i < entry_count; i++) {
-        // 构建单个日志项
-        uint8_t log_item_data[16];
-        uint16_t log_item_len = 0;
-        
-        int ts_len = write_tlv_uint64(log_item_data + log_item_len, sizeof(log_item_data) - log_item_len, TAG_TIMESTAMP, entries[i].timestamp);
-        if (ts_len < 0) break;
-        log_item_len += ts_len;
-        
-        int temp_len = write_tlv_float32(log_item_data + log_item_len, sizeof(log_item_data) - log_item_len, TAG_TEMPERATURE, entries[i].temperature);
-        if (temp_len < 0) break;
-        log_item_len += temp_len;
-        
-        // 添加到日志列表
-        int item_len = write_tlv_raw(log_list_data + log_list_len, sizeof(log_list_data) - log_list_len, TAG_ALARM_ITEM, log_item_data, log_item_len);
-        if (item_len < 0) break;
-        log_list_len += item_len;
+    while (n < max_count) {
+        TempLogQuery position = query;
+        if (!alarm_event_query_next(&query, &event)) {
+            break;
+        }
+        uint8_t *item = response_data + 4 + length;
+        uint16_t item_size = budget - 4 - length;
+        if (item_size < 4 + 12 + 6 + 3 * 5 + temp_size) { // IT + TS + MS + ID/ET/SN + T
+            query = position;
+            more = true;
+            break;
+        }
+        uint16_t item_len = write_tlv_begin(item, item_size, TAG_ALARM_ITEM);
+        item_len += write_tlv_uint64(item + item_len, item_size - item_len, TAG_TIMESTAMP, event.timestamp);
+        item_len += write_tlv_uint16(item + item_len, item_size - item_len, TAG_MILLISECOND, event.millisecond);
+        item_len += write_tlv_uint8(item + item_len, item_size - item_len, TAG_ALARM_ID, event.channel);
+        item_len += write_tlv_uint8(item + item_len, item_size - item_len, TAG_EVENT_TYPE, event.type);
+        item_len += write_tlv_uint8(item + item_len, item_size - item_len, TAG_SENSOR, event.sensor);
+        item_len += write_tlv_temperature(item + item_len, item_size - item_len, TAG_TEMPERATURE, event.temperature, session->temperature_format);
+        length += write_tlv_end(item, item_len - 4);
+        last = event.sequence;
+        n++;
+    }
+    uint16_t len = write_tlv_end(response_data, length);
+    
+    cursor = temp_log_query_cursor(&query);
+    if (!more && n == max_count) {
+        more = alarm_event_query_next(&query, &event);
+    }
+    if (more) {
+        len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_LOG_CURSOR, cursor);
+    }
+    if (n > 0) {
+        len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_LOG_LAST, last);
+    }
+    
+    *status = STATUS_OK;
+    *response_len = len;
+    return 0;
+}
+
+// 获取报警前后记录命令处理：每项为一条完整的记录，放不下或达到MX时带CU；
+// 温度固定为int16数组，不随TF改变
+int handle_get_bursts(const uint8_t *request_data, uint16_t request_len, 
+                      uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    if (!storage_loaded(status, response_len)) {
+        return -1;
+    }
+    
+    TlvBinding fields;
+    if (tlv_schema_bind(tlv_schema_request(OP_GET_BURSTS), request_data, request_len, &fields) < 0) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return -1;
+    }
+    
+    uint64_t start_time = 0, end_time = 0;
+    uint16_t max_count = MAX_LOG_ENTRIES;
+    uint32_t cursor = 0;
+    tlv_binding_get_uint64(&fields, GBST_REQ_T1, &start_time);
+    tlv_binding_get_uint64(&fields, GBST_REQ_T2, &end_time);
+    tlv_binding_get_uint16(&fields, GBST_REQ_MX, &max_count);
+    if (end_time == 0) {
+        end_time = rtc_get_timestamp();
+    }
+    
+    TempLogQuery query;
+    if (tlv_binding_get_uint32(&fields, GBST_REQ_CU, &cursor) > 0) {
+        alarm_burst_query_resume(&query, cursor, end_time);
+    } else {
+        alarm_burst_query_begin(&query, start_time, end_time);
     }
     
-    // 构建最终响应
-    int lg_len = write_tlv_raw(response_data, MAX_DATA_SIZE, TAG_LOG_LIST, log_list_data, log_list_len);
-    if (lg_len < 0) {
+    // BL列表，CU字段预留在列表之后
+    uint16_t budget = RESPONSE_DATA_BUDGET - 8;
+    if (write_tlv_begin(response_data, budget, TAG_BURST_LIST) < 0) {
         *status = STATUS_INTERNAL_ERROR;
         *response_len = 0;
         return -1;
     }
     
+    uint16_t length = 0;
+    uint32_t n = 0;
+    bool more = false;
+    AlarmBurst burst;
+    uint8_t samples[ALARM_BURST_SAMPLES * 2];
+    
+    while (n < max_count) {
+        TempLogQuery position = query;
+        if (!alarm_burst_query_next(&query, &burst)) {
+            break;
+        }
+        uint8_t *item = response_data + 4 + length;
+        uint16_t item_size = budget - 4 - length;
+        if (item_size < 4 + 12 + 6 + 4 * 5 + 4 + sizeof(samples)) { // IT + TS + MS + ID/ET/SN/PB + BT
+            query = position;
+            more = true;
+            break;
+        }
+        for (uint8_t i = 0; i < ALARM_BURST_SAMPLES; i++) {
+            samples[i * 2] = (uint8_t)((uint16_t)burst.temperatures[i] & 0xFF);
+            samples[i * 2 + 1] = (uint8_t)((uint16_t)burst.temperatures[i] >> 8);
+        }
+        uint16_t item_len = write_tlv_begin(item, item_size, TAG_ALARM_ITEM);
+        item_len += write_tlv_uint64(item + item_len, item_size - item_len, TAG_TIMESTAMP, burst.timestamp);
+        item_len += write_tlv_uint16(item + item_len, item_size - item_len, TAG_MILLISECOND, burst.millisecond);
+        item_len += write_tlv_uint8(item + item_len, item_size - item_len, TAG_ALARM_ID, burst.channel);
+        item_len += write_tlv_uint8(item + item_len, item_size - item_len, TAG_EVENT_TYPE, burst.type);
+        item_len += write_tlv_uint8(item + item_len, item_size - item_len, TAG_SENSOR, burst.sensor);
+        item_len += write_tlv_uint8(item + item_len, item_size - item_len, TAG_BURST_PRE, ALARM_BURST_PRE_SAMPLES);
+        item_len += write_tlv_raw(item + item_len, item_size - item_len, TAG_BURST_SAMPLES, samples, sizeof(samples));
+        length += write_tlv_end(item, item_len - 4);
+        n++;
+    }
+    uint16_t len = write_tlv_end(response_data, length);
+    
+    cursor = temp_log_query_cursor(&query);
+    if (!more && n == max_count) {
+        more = alarm_burst_query_next(&query, &burst);
+    }
+    if (more) {
+        len += write_tlv_uint32(response_data + len, RESPONSE_DATA_BUDGET - len, TAG_LOG_CURSOR, cursor);
+    }
+    
     *status = STATUS_OK;
-    *response_len = lg_len;
+    *response_len = len;
     return 0;
 }
 
-// LED控制命令处理
-int handle_set_led(const uint8_t *request_data, uint16_t request_len, 
-                  uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+#if FW_UPDATE
+// 固件升级的结果映射为状态码：暂存区不可用时为STATUS_NOT_INITIALIZED
+static uint8_t fw_update_status(FwUpdateResult result) {
+    switch (result) {
+    case FW_UPDATE_OK:          return STATUS_OK;
+    case FW_UPDATE_INVALID:     return STATUS_INVALID_PARAM;
+    case FW_UPDATE_BUSY:        return STATUS_BUSY;
+    case FW_UPDATE_NO_IMAGE:    return STATUS_NOT_INITIALIZED;
+    case FW_UPDATE_FLASH_ERROR: return STATUS_STORAGE_ERROR;
+    }
+    return STATUS_INTERNAL_ERROR;
+}
+#endif
+
+// 不支持固件升级（或暂存区未就绪）时返回STATUS_NOT_INITIALIZED
+static bool fw_update_available(uint8_t *status, uint16_t *response_len) {
+#if FW_UPDATE
+    if (fw_update_ready()) {
+        return true;
+    }
+#endif
+    *status = STATUS_NOT_INITIALIZED;
+    *response_len = 0;
+    return false;
+}
+
+// 开始（或继续）升级：FS为映像长度，CK为整个映像的CRC32；响应FO为下一块应有的偏移，
+// SZ为一块的最大字节数。与进行中的映像相同时从已收到的位置继续；不带FS时只查询。
+// 带FP时为差分升级：之后的fwch发送长度为FP的补丁（FO为补丁中的偏移），OL/OC为生成补丁时旧映像的长度和CRC32，
+// 与当前固件不符时返回STATUS_INVALID_PARAM
+// A/B程序槽时响应另带FA（本固件所在的槽）和FB（本次启动是否为回退），新固件确认前返回STATUS_BUSY
+int handle_fw_begin(const uint8_t *request_data, uint16_t request_len, 
+                    uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    if (!fw_update_available(status, response_len)) {
+        return 0;
+    }
+#if FW_UPDATE
+    TlvBinding binding;
+    uint32_t size = 0, crc = 0, patch_size = 0, base_size = 0, base_crc = 0;
+    if (tlv_schema_bind(tlv_schema_request(OP_FW_BEGIN), request_data, request_len, &binding) < 0) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return 0;
+    }
+    
+    uint32_t offset = fw_update_received();
+    *status = STATUS_OK;
+    if (tlv_binding_get_uint32(&binding, FWBG_REQ_FS, &size) > 0) {
+        if (tlv_binding_get_uint32(&binding, FWBG_REQ_CK, &crc) < 0) {
+            *status = STATUS_INVALID_PARAM;
+#if FW_SLOTS
+        } else if (!fw_slots_confirmed()) {
+            *status = STATUS_BUSY;
+#endif
+        } else if (tlv_binding_get_uint32(&binding, FWBG_REQ_FP, &patch_size) > 0) {
+            if (tlv_binding_get_uint32(&binding, FWBG_REQ_OL, &base_size) < 0 ||
+                tlv_binding_get_uint32(&binding, FWBG_REQ_OC, &base_crc) < 0) {
+                *status = STATUS_INVALID_PARAM;
+            } else {
+                *status = fw_update_status(fw_update_begin_delta(size, crc, patch_size, base_size, base_crc, &offset));
+            }
+        } else {
+            *status = fw_update_status(fw_update_begin(size, crc, &offset));
+        }
+    }
+    if (*status != STATUS_OK) {
+        *response_len = 0;
+        return 0;
+    }
+    uint16_t len = write_tlv_uint32(response_data, MAX_DATA_SIZE, TAG_FW_OFFSET, offset);
+    len += write_tlv_uint16(response_data + len, MAX_DATA_SIZE - len, TAG_BENCH_SIZE, FW_UPDATE_CHUNK_MAX);
+#if FW_SLOTS
+    len += write_tlv_uint8(response_data + len, MAX_DATA_SIZE - len, TAG_FW_SLOT, FW_SLOT_ID);
+    len += write_tlv_uint8(response_data + len, MAX_DATA_SIZE - len, TAG_FW_ROLLED_BACK, fw_slots_rolled_back());
+#endif
+    *response_len = len;
+#else
     (void)request_data;
     (void)request_len;
     (void)response_data;
-    
-    led_on();
-    
-    *status = STATUS_OK;
-    *response_len = 0;
+#endif
     return 0;
 }
 
-int handle_reset_led(const uint8_t *request_data, uint16_t request_len, 
+// 写入一块：FO为偏移，FD为数据，CK为该块的CRC32。响应的FO为下一块应有的偏移（出错时也带），
+// 主机可以连续发送，出错或STATUS_BUSY时从FO重发
+int handle_fw_chunk(const uint8_t *request_data, uint16_t request_len, 
                     uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    if (!fw_update_available(status, response_len)) {
+        return 0;
+    }
+#if FW_UPDATE
+    TlvBinding binding;
+    uint32_t offset = 0, crc = 0;
+    const uint8_t *data = NULL;
+    uint16_t length = 0;
+    uint32_t next;
+    FwUpdateResult result = FW_UPDATE_INVALID;
+    if (tlv_schema_bind(tlv_schema_request(OP_FW_CHUNK), request_data, request_len, &binding) >= 0 &&
+        tlv_binding_get_uint32(&binding, FWCH_REQ_FO, &offset) > 0 &&
+        tlv_binding_get_view(&binding, FWCH_REQ_FD, &data, &length) > 0 &&
+        tlv_binding_get_uint32(&binding, FWCH_REQ_CK, &crc) > 0) {
+        result = fw_update_chunk(offset, data, length, crc, &next);
+    } else {
+        fw_update_chunk(0, NULL, 0, 0, &next); // 只取下一块的偏移
+    }
+    
+    *status = fw_update_status(result);
+    *response_len = write_tlv_uint32(response_data, MAX_DATA_SIZE, TAG_FW_OFFSET, next);
+#else
     (void)request_data;
     (void)request_len;
     (void)response_data;
-    
-    led_off();
-    
-    *status = STATUS_OK;
-    *response_len = 0;
+#endif
     return 0;
 }
 
-// 蜂鸣器控制命令处理
-int handle_set_buzzer(const uint8_t *request_data, uint16_t request_len, 
+// 校验暂存区中的映像：全部块写入闪存后比较整个映像的CRC并检查向量表，响应CK为计算得到的CRC；
+// 还有页未写入时返回STATUS_BUSY，稍后重试
+int handle_fw_verify(const uint8_t *request_data, uint16_t request_len, 
+                     uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    (void)request_data;
+    (void)request_len;
+    if (!fw_update_available(status, response_len)) {
+        return 0;
+    }
+#if FW_UPDATE
+    uint32_t crc;
+    *status = fw_update_status(fw_update_verify(&crc));
+    *response_len = (*status == STATUS_OK || *status == STATUS_INVALID_PARAM)
+        ? write_tlv_uint32(response_data, MAX_DATA_SIZE, TAG_FW_CRC, crc) : 0;
+#else
+    (void)response_data;
+#endif
+    return 0;
+}
+
+// 安装校验通过的映像：应答发出后由存储任务复制到程序区并复位，复位后ping确认新固件
+int handle_fw_commit(const uint8_t *request_data, uint16_t request_len, 
                      uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
     (void)request_data;
     (void)request_len;
     (void)response_data;
+    if (!fw_update_available(status, response_len)) {
+        return 0;
+    }
+#if FW_UPDATE
+    *status = fw_update_status(fw_update_commit());
+    *response_len = 0;
+#endif
+    return 0;
+}
+
+// 传感器校准命令处理：SN选择传感器（缺省为0），带KP时设置校准点（每点为读数、参考温度两个int16小端，
+// 0.1°C，按读数递增排列；空为清除校准），不带KP时只查询。新校准从下一次采样开始生效并保存在闪存中
+int handle_set_calibration(const uint8_t *request_data, uint16_t request_len, 
+                           uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    TlvBinding binding;
+    uint8_t sensor = 0;
+    if (tlv_schema_bind(tlv_schema_request(OP_SET_CALIBRATION), request_data, request_len, &binding) < 0 ||
+        (tlv_binding_has(&binding, SCAL_SN) &&
+         (tlv_binding_get_uint8(&binding, SCAL_SN, &sensor) < 0 || sensor >= TEMP_MAX_SENSORS))) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return 0;
+    }
     
-    buzzer_beep(1000); // 蜂鸣1秒
+    TempCalibration calibration;
+    const uint8_t *points;
+    uint16_t points_len;
+    if (tlv_binding_get_view(&binding, SCAL_KP, &points, &points_len) >= 0) {
+        memset(&calibration, 0, sizeof(calibration));
+        if (points_len % 4 != 0 || points_len / 4 > TEMP_CALIB_MAX_POINTS) {
+            *status = STATUS_INVALID_PARAM;
+            *response_len = 0;
+            return 0;
+        }
+        calibration.count = (uint8_t)(points_len / 4);
+        for (uint8_t i = 0; i < calibration.count; i++) {
+            calibration.measured[i] = (int16_t)(points[i * 4] | (points[i * 4 + 1] << 8));
+            calibration.reference[i] = (int16_t)(points[i * 4 + 2] | (points[i * 4 + 3] << 8));
+        }
+        if (!temp_calib_valid(&calibration)) {
+            *status = STATUS_INVALID_PARAM;
+            *response_len = 0;
+            return 0;
+        }
+        temp_calib_configure(sensor, &calibration);
+        config_store_request_save(CONFIG_KEY_CALIB);
+    }
+    temp_calib_get(sensor, &calibration);
+    
+    uint8_t encoded[TEMP_CALIB_MAX_POINTS * 4];
+    for (uint8_t i = 0; i < calibration.count; i++) {
+        encoded[i * 4] = (uint8_t)calibration.measured[i];
+        encoded[i * 4 + 1] = (uint8_t)((uint16_t)calibration.measured[i] >> 8);
+        encoded[i * 4 + 2] = (uint8_t)calibration.reference[i];
+        encoded[i * 4 + 3] = (uint8_t)((uint16_t)calibration.reference[i] >> 8);
+    }
+    uint16_t len = write_tlv_uint8(response_data, MAX_DATA_SIZE, TAG_SENSOR, sensor);
+    len += write_tlv_raw(response_data + len, MAX_DATA_SIZE - len, TAG_CALIB_POINTS, encoded,
+                         (uint16_t)(calibration.count * 4));
+    *status = STATUS_OK;
+    *response_len = len;
+    return 0;
+}
+
+// 运行统计命令处理：SN选择传感器（缺省为0），WN选择窗口（0为复位以来，1为最近一小时，2为最近一天，缺省为0）；
+// 带AT时先设置超限阈值，CL=1时先清零该传感器的统计。没有读数时只返回SN、WN、CN和TA
+int handle_get_temp_stats(const uint8_t *request_data, uint16_t request_len, 
+                          uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+    TlvBinding binding;
+    uint8_t sensor = 0;
+    uint8_t window = TEMP_STATS_SINCE_BOOT;
+    uint8_t clear = 0;
+    int16_t threshold;
+    if (tlv_schema_bind(tlv_schema_request(OP_GET_TEMP_STATS), request_data, request_len, &binding) < 0 ||
+        (tlv_binding_get_uint8(&binding, TSTA_REQ_SN, &sensor) > 0 && sensor >= TEMP_MAX_SENSORS) ||
+        (tlv_binding_get_uint8(&binding, TSTA_REQ_WN, &window) > 0 && window >= TEMP_STATS_WINDOWS) ||
+        (tlv_binding_get_uint8(&binding, TSTA_REQ_CL, &clear) > 0 && clear > 1)) {
+        *status = STATUS_INVALID_PARAM;
+        *response_len = 0;
+        return 0;
+    }
+    if (tlv_binding_has(&binding, TSTA_REQ_AT)) {
+        if (tlv_binding_get_temperature(&binding, TSTA_REQ_AT, &threshold) < 0) {
+            *status = STATUS_INVALID_PARAM;
+            *response_len = 0;
+            return 0;
+        }
+        temp_stats_set_threshold(sensor, threshold);
+    }
+    if (clear) {
+        temp_stats_clear(sensor);
+    }
     
+    TempStatsResult result;
+    temp_stats_query(sensor, window, HAL_GetTick(), &result);
+    uint8_t format = session->temperature_format;
+    uint16_t len = write_tlv_uint8(response_data, MAX_DATA_SIZE, TAG_SENSOR, sensor);
+    len += write_tlv_uint8(response_data + len, MAX_DATA_SIZE - len, TAG_WINDOW, window);
+    len += write_tlv_uint32(response_data + len, MAX_DATA_SIZE - len, TAG_BUCKET_COUNT, result.count);
+    if (result.count > 0) {
+        len += write_tlv_temperature(response_data + len, MAX_DATA_SIZE - len, TAG_BUCKET_MIN, result.min, format);
+        len += write_tlv_temperature(response_data + len, MAX_DATA_SIZE - len, TAG_BUCKET_MAX, result.max, format);
+        len += write_tlv_temperature(response_data + len, MAX_DATA_SIZE - len, TAG_BUCKET_MEAN, result.mean, format);
+        len += write_tlv_uint32(response_data + len, MAX_DATA_SIZE - len, TAG_STATS_VARIANCE, result.variance);
+    }
+    len += write_tlv_uint32(response_data + len, MAX_DATA_SIZE - len, TAG_ABOVE_TIME, result.above_ms);
+    if (result.threshold != TEMP_INVALID) {
+        len += write_tlv_temperature(response_data + len, MAX_DATA_SIZE - len, TAG_ABOVE_THRESHOLD, result.threshold, format);
+    }
     *status = STATUS_OK;
-    *response_len = 0;
+    *response_len = len;
     return 0;
 }
 
-int handle_reset_buzzer(const uint8_t *request_data, uint16_t request_len, 
-                       uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
+// 所有传感器读数命令处理：只读采样任务的缓存和健康记录，不访问总线。
+// TP中每个传感器一条8字节的记录：SN、PR（最近一次读取成功为1）、T、TR（int16小端，0.1°C，
+// 读取失败为TEMP_INVALID）、CF（连续失败次数，uint16小端）；同一次采样，AG对所有传感器相同
+#define ALL_TEMPS_RECORD_SIZE 8
+int handle_get_all_temps(const uint8_t *request_data, uint16_t request_len, 
+                         uint8_t *response_data, uint16_t *response_len, uint8_t *status) {
     (void)request_data;
     (void)request_len;
-    (void)response_data;
+    TempSample sample;
+    if (!temp_sampler_get(&sample) || sample.sequence == 0) {
+        *status = STATUS_SENSOR_ERROR;
+        *response_len = 0;
+        return 0;
+    }
     
-    buzzer_off();
+    uint8_t records[TEMP_MAX_SENSORS * ALL_TEMPS_RECORD_SIZE];
+    uint8_t count = sample.sensor_count;
+    for (uint8_t i = 0; i < count; i++) {
+        TempSensorHealth health = { 0 };
+        temperature_get_health(i, &health);
+        uint8_t *record = records + i * ALL_TEMPS_RECORD_SIZE;
+        uint16_t temperature = (uint16_t)sample.temperatures[i];
+        uint16_t raw = (uint16_t)sample.raw[i];
+        record[0] = i;
+        record[1] = sample.temperatures[i] != TEMP_INVALID ? 1 : 0;
+        record[2] = (uint8_t)temperature;
+        record[3] = (uint8_t)(temperature >> 8);
+        record[4] = (uint8_t)raw;
+        record[5] = (uint8_t)(raw >> 8);
+        record[6] = (uint8_t)health.consecutive_faults;
+        record[7] = (uint8_t)(health.consecutive_faults >> 8);
+    }
     
+    uint16_t len = write_tlv_uint32(response_data, MAX_DATA_SIZE, TAG_SAMPLE_AGE,
+                                    temp_sample_age_ms(&sample, HAL_GetTick()));
+    len += write_tlv_uint8(response_data + len, MAX_DATA_SIZE - len, TAG_SENSOR_COUNT, count);
+    len += write_tlv_raw(response_data + len, MAX_DATA_SIZE - len, TAG_TEMP_PACKED, records,
+                         (uint16_t)(count * ALL_TEMPS_RECORD_SIZE));
     *status = STATUS_OK;
-    *response_len = 0;
+    *response_len = len;
     return 0;
 }
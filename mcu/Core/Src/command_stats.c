@@ -0,0 +1,101 @@
+#include "command_stats.h"
+#include "timebase.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "warm_state.h"
+#include <string.h>
+
+// 执行任务写请求数和排队耗时，发送完成中断写发送耗时，读取和清零时屏蔽中断；
+// 热复位后保留（warm_state.h），中断中不能封装，由采样任务定期封装
+static WARM_STATE struct {
+    WarmState state;
+    CommandStats stats[COMMAND_STATS_OPCODES];
+} warm;
+
+static uint8_t bucket_of(uint32_t cycles) {
+    uint32_t us = timebase_cycles_to_us(cycles);
+    if (us < 16) {
+        return 0;
+    }
+    uint32_t bucket = 31U - (uint32_t)__builtin_clz(us) - 3U;
+    return bucket < COMMAND_STATS_BUCKETS ? (uint8_t)bucket : COMMAND_STATS_BUCKETS - 1;
+}
+
+static void record(uint16_t *hist, uint32_t *max_us, uint32_t cycles) {
+    uint16_t *bin = &hist[bucket_of(cycles)];
+    if (*bin != UINT16_MAX) {
+        (*bin)++;
+    }
+    uint32_t us = timebase_cycles_to_us(cycles);
+    if (us > *max_us) {
+        *max_us = us;
+    }
+}
+
+void command_stats_warm_restore(void) {
+    if (!warm_state_restore(&warm.state, COMMAND_STATS_WARM_MAGIC, sizeof(warm))) {
+        memset(warm.stats, 0, sizeof(warm.stats));
+    }
+    warm_state_seal(&warm.state);
+    warm_state_register(&warm.state);
+}
+
+void command_stats_record_request(uint8_t opcode) {
+    if (opcode < COMMAND_STATS_OPCODES) {
+        warm.stats[opcode].count++;
+    }
+}
+
+void command_stats_record_queued(uint8_t opcode, uint32_t cycles) {
+    if (opcode < COMMAND_STATS_OPCODES) {
+        record(warm.stats[opcode].queued_hist, &warm.stats[opcode].queued_max_us, cycles);
+    }
+}
+
+void command_stats_record_transmit(uint8_t opcode, uint32_t cycles) {
+    if (opcode < COMMAND_STATS_OPCODES) {
+        record(warm.stats[opcode].transmit_hist, &warm.stats[opcode].transmit_max_us, cycles);
+    }
+}
+
+bool command_stats_get(uint8_t opcode, CommandStats *out) {
+    if (opcode >= COMMAND_STATS_OPCODES) {
+        return false;
+    }
+    taskENTER_CRITICAL();
+    *out = warm.stats[opcode];
+    taskEXIT_CRITICAL();
+    return true;
+}
+
+uint32_t command_stats_percentile_us(const uint16_t *hist, uint32_t max_us, uint8_t percent) {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < COMMAND_STATS_BUCKETS; i++) {
+        total += hist[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint32_t target = (total * percent + 99U) / 100U;
+    uint32_t seen = 0;
+    uint8_t bucket = 0;
+    for (; bucket < COMMAND_STATS_BUCKETS - 1; bucket++) {
+        seen += hist[bucket];
+        if (seen >= target) {
+            break;
+        }
+    }
+    // 桶i的上界为2^(i+4)微秒，最后一桶不封顶
+    uint32_t upper = bucket < COMMAND_STATS_BUCKETS - 1 ? (1UL << (bucket + 4)) : max_us;
+    return upper < max_us ? upper : max_us;
+}
+
+void command_stats_reset(uint8_t opcode) {
+    if (opcode >= COMMAND_STATS_OPCODES) {
+        return;
+    }
+    taskENTER_CRITICAL();
+    memset(&warm.stats[opcode], 0, sizeof(warm.stats[opcode]));
+    taskEXIT_CRITICAL();
+}
@@ -1,143 +1,729 @@
 #include "communication.h"
 #include "command_handler.h"
+#include "ring_buffer.h"
+#include "frame_parser.h"
+#include "frame_writer.h"
+#include "trace.h"
+#include "block_pool.h"
+#include "watchdog.h"
+#include "command_stats.h"
+#include "timebase.h"
+#include "config_store.h"
+#include "uart_transport.h"
+#include "usb_cdc.h"
+#include "gateway.h"
+#include "clock_scale.h"
 #include "main.h"
 #include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
 #include <string.h>
 
-// 外部UART句柄
-extern UART_HandleTypeDef huart1;
+// 一条链路的会话状态：接收（环形缓冲区、解析器）、发送队列、波特率和统计都按链路独立，
+// 一条链路出错、重同步或切换波特率不影响其他链路
+typedef struct {
+    CommTransport transport;
+    CommState state;
+    CommStats stats;
+    
+    // 接收环形缓冲区：DMA_CIRCULAR直接写入其存储区，ISR只推进head，任务消费
+    uint8_t ring_storage[COMM_RX_RING_SIZE];
+    RingBuffer ring;
+    // 流式帧解析器，直接从环形缓冲区逐字节解码到当前的请求缓冲区
+    FrameParser parser;
+    uint8_t *rx_request;              // 解析器正在使用的请求缓冲区
+    volatile bool rx_restart_pending; // 接收DMA出错停止，需要重新启动接收
+    
+    // 发送队列：已提交、等待DMA的槽编号，由任务入队、发送完成回调出队
+    int8_t tx_queue[COMM_TX_SLOT_COUNT];
+    volatile uint8_t tx_queue_head;
+    volatile uint8_t tx_queue_tail;
+    volatile int8_t tx_active_slot;   // 正在DMA发送的槽，-1表示空闲
+    
+    // 波特率协商状态
+    uint32_t baud_rate_current;
+    uint32_t baud_rate_base;          // 回退的波特率，BLE链路为模块配置后的波特率（ble_module.h）
+    uint32_t baud_rate_pending;       // 待切换的波特率，0表示无
+    bool baud_confirm_pending;        // 切换后尚未收到有效帧
+    uint32_t baud_switch_tick;
+    
+    uint8_t tx_version;               // 该链路主机最近使用的协议版本，决定组帧方式
+} CommLink;
+
+static CommLink links[COMM_LINK_COUNT] = {
+    [COMM_LINK_BLE] = {.transport = {&uart_transport_ops, &uart_ble_port}},
+#if COMM_WIRED_LINK
+    [COMM_LINK_WIRED] = {.transport = {&uart_transport_ops, &uart_wired_port}},
+#endif
+#if COMM_USB_LINK
+    [COMM_LINK_USB] = {.transport = {&usb_cdc_ops, NULL}},
+#endif
+};
+
+#if COMM_GATEWAY
+// 网关的下游总线：UART4不作为链路，由总线主机（gateway.c）直接收发
+static const CommTransport bus_transport = {&uart_transport_ops, &uart_wired_port};
+#endif
+
+// 执行任务正在为其构建帧的链路
+static uint8_t current_link = COMM_LINK_BLE;
+static uint32_t current_rx_cycles = 0; // 正在执行的请求收完时的周期计数
+
+// 请求缓冲区池：解析器直接解码到其中一块，收完一帧后整块交给执行任务，执行完归还
+static uint32_t request_storage[BLOCK_POOL_WORDS(COMM_RX_BUFFER_SIZE, COMM_REQUEST_SLOTS)];
+static BlockPool request_pool;
+
+// 等待执行的请求缓冲区，按优先级类别（COMMAND_CLASS_*）分为两个队列，
+// 每个队列都能容纳全部请求缓冲区
+#define REQUEST_CLASS_COUNT 2
+
+typedef struct {
+    uint8_t *frame;        // 请求缓冲区：包头之后是数据部分
+    uint32_t rx_cycles;    // 收完该帧时的周期计数
+    uint8_t opcode;        // 指令编号（command_stats.h）
+    uint8_t link;          // 请求到达的链路，响应发回同一链路
+} RequestMessage;
+
+static StaticQueue_t request_queue_cb[REQUEST_CLASS_COUNT];
+static RequestMessage request_queue_storage[REQUEST_CLASS_COUNT][COMM_REQUEST_SLOTS];
+static osMessageQueueId_t request_queue[REQUEST_CLASS_COUNT];
+
+static const osMessageQueueAttr_t request_queue_attributes[REQUEST_CLASS_COUNT] = {
+    [COMMAND_CLASS_INTERACTIVE] = {
+        .name = "commRequest",
+        .cb_mem = &request_queue_cb[COMMAND_CLASS_INTERACTIVE],
+        .cb_size = sizeof(request_queue_cb[0]),
+        .mq_mem = request_queue_storage[COMMAND_CLASS_INTERACTIVE],
+        .mq_size = sizeof(request_queue_storage[0]),
+    },
+    [COMMAND_CLASS_BULK] = {
+        .name = "commBulk",
+        .cb_mem = &request_queue_cb[COMMAND_CLASS_BULK],
+        .cb_size = sizeof(request_queue_cb[0]),
+        .mq_mem = request_queue_storage[COMMAND_CLASS_BULK],
+        .mq_size = sizeof(request_queue_storage[0]),
+    },
+};
+
+// 执行任务的命令工作缓冲区，请求帧、工作缓冲区和发送槽都在这里静态分配，
+// 按引用传给命令处理，命令处理不在栈上分配帧大小的缓冲区
+static CommandScratch executor_scratch;
 
-// 通信状态和缓冲区
-static CommState comm_state = COMM_STATE_IDLE;
-static CommStats comm_stats = {0};
+// 命令执行任务
+static StaticTask_t executor_tcb;
+static uint32_t executor_stack[COMM_EXECUTOR_STACK_WORDS];
+static osThreadId_t executor_thread = NULL;
 
-static uint8_t rx_buffer[COMM_RX_BUFFER_SIZE];
-static uint8_t tx_buffer[COMM_TX_BUFFER_SIZE];
-static volatile uint16_t rx_buffer_pos = 0;
-static volatile bool rx_complete = false;
-static volatile bool tx_complete = true;
+static const osThreadAttr_t executor_attributes = {
+    .name = "commExec",
+    .cb_mem = &executor_tcb,
+    .cb_size = sizeof(executor_tcb),
+    .stack_mem = executor_stack,
+    .stack_size = sizeof(executor_stack),
+    .priority = (osPriority_t) osPriorityBelowNormal, // 低于接收任务和采样任务
+};
+
+// 发送槽池：响应帧直接构建在槽内并由DMA发送，发送完成后在回调中归还。
+// 各链路共用，两个任务都会申请发送槽，信号量计数空闲槽的数量
+static uint8_t tx_slots[COMM_TX_SLOT_COUNT][COMM_TX_BUFFER_SIZE];
+static volatile bool tx_slot_used[COMM_TX_SLOT_COUNT];
+static StaticSemaphore_t tx_slot_sem_cb;
+static osSemaphoreId_t tx_slot_sem = NULL;
+
+static const osSemaphoreAttr_t tx_slot_sem_attributes = {
+    .name = "commTxSlot",
+    .cb_mem = &tx_slot_sem_cb,
+    .cb_size = sizeof(tx_slot_sem_cb),
+};
+static uint16_t tx_slot_len[COMM_TX_SLOT_COUNT];
+// 各槽中响应帧的指令编号和提交时的周期计数，发送完成时记录发送耗时
+static uint8_t tx_slot_opcode[COMM_TX_SLOT_COUNT];
+static uint32_t tx_slot_cycles[COMM_TX_SLOT_COUNT];
+
+static volatile uint32_t activity_tick = 0; // 任一链路最近一次收发的HAL_GetTick()
+
+// 接收任务句柄，ISR通过线程标志唤醒任务
+static osThreadId_t comm_thread = NULL;
 
 // 数据包ID计数器
 static uint16_t packet_id_counter = 0x8000; // 从机数据包ID从0x8000开始
 
 // 函数声明
-static void start_uart_receive(void);
-static int process_received_data(void);
-static void send_response_packet(const uint8_t *packet, uint16_t length);
+static void start_uart_receive(CommLink *link);
+static void restart_uart_receive(CommLink *link);
+static void drain_rx_ring(uint8_t link_id);
+static void handle_frame_result(uint8_t link_id, FrameResult result);
+static void submit_request(uint8_t link_id, const PacketHeader *header);
+static void executor_task(void *argument);
+static int process_received_data(const PacketHeader *header, const RequestMessage *request);
+static int8_t tx_slot_acquire(CommLink *link);
+static void tx_slot_release(int8_t slot);
+static void tx_slot_submit(CommLink *link, int8_t slot, uint16_t length);
+static bool run_due_command(void);
+static void tx_start_next(CommLink *link);
+static bool tx_idle(const CommLink *link);
+static void link_service(CommLink *link);
+static void apply_baud_rate(CommLink *link, uint32_t baud_rate);
+static uint32_t baud_fallback_remaining_ms(const CommLink *link);
+static void notify_task(uint32_t flags);
+static void notify_executor(uint32_t flags);
 
 void communication_init(void) {
-    // 初始化通信状态
-    comm_state = COMM_STATE_IDLE;
-    memset(&comm_stats, 0, sizeof(comm_stats));
+    // 每个解析器先取一块，其余留给排队的请求
+    for (uint8_t i = 0; i < REQUEST_CLASS_COUNT; i++) {
+        request_queue[i] = osMessageQueueNew(COMM_REQUEST_SLOTS, sizeof(RequestMessage), &request_queue_attributes[i]);
+    }
+    block_pool_init(&request_pool, "request", request_storage, COMM_RX_BUFFER_SIZE, COMM_REQUEST_SLOTS);
     
-    rx_buffer_pos = 0;
-    rx_complete = false;
-    tx_complete = true;
+    for (uint8_t i = 0; i < COMM_TX_SLOT_COUNT; i++) {
+        tx_slot_used[i] = false;
+    }
+    tx_slot_sem = osSemaphoreNew(COMM_TX_SLOT_COUNT, COMM_TX_SLOT_COUNT, &tx_slot_sem_attributes);
+    
+    for (uint8_t i = 0; i < COMM_LINK_COUNT; i++) {
+        CommLink *link = &links[i];
+        link->state = COMM_STATE_IDLE;
+        memset(&link->stats, 0, sizeof(link->stats));
+        link->rx_request = block_pool_alloc(&request_pool);
+        frame_parser_init(&link->parser, link->rx_request, COMM_RX_BUFFER_SIZE);
+        ring_buffer_init(&link->ring, link->ring_storage, sizeof(link->ring_storage));
+        link->tx_active_slot = -1;
+        link->tx_queue_head = 0;
+        link->tx_queue_tail = 0;
+        link->baud_rate_current = COMM_DEFAULT_BAUD_RATE;
+        link->baud_rate_base = COMM_DEFAULT_BAUD_RATE;
+        link->tx_version = protocol_get_tx_version();
+    }
+    current_link = COMM_LINK_BLE;
+#if COMM_WIRED_LINK
+    frame_parser_set_address(&links[COMM_LINK_WIRED].parser, FRAME_ADDRESS_BLOCKED);
+#endif
     
     // 初始化命令处理器
     command_handler_init();
     
     // 开始第一次接收
-    start_uart_receive();
+    for (uint8_t i = 0; i < COMM_LINK_COUNT; i++) {
+        start_uart_receive(&links[i]);
+    }
+#if COMM_GATEWAY
+    gateway_init(&bus_transport);
+#endif
+}
+
+void communication_start(void) {
+    executor_thread = osThreadNew(executor_task, NULL, &executor_attributes);
+}
+
+void communication_wait_event(uint32_t timeout_ms) {
+    comm_thread = osThreadGetId();
+    
+    // 任一链路有待处理数据时直接返回，各链路的波特率回退时间也作为唤醒条件
+    bool pending = (timeout_ms == 0);
+    for (uint8_t i = 0; i < COMM_LINK_COUNT; i++) {
+        const CommLink *link = &links[i];
+        uint32_t due_ms = baud_fallback_remaining_ms(link);
+        if (due_ms < timeout_ms) {
+            timeout_ms = due_ms;
+        }
+        if (link->rx_restart_pending || ring_buffer_count(&link->ring) > 0 || due_ms == 0) {
+            pending = true;
+        }
+    }
+#if COMM_GATEWAY
+    // 总线主机的应答超时和下一轮轮询
+    uint32_t gateway_due_ms = gateway_next_due_ms();
+    if (gateway_due_ms < timeout_ms) {
+        timeout_ms = gateway_due_ms;
+    }
+    if (gateway_due_ms == 0) {
+        pending = true;
+    }
+#endif
+    
+    if (pending) {
+        osThreadFlagsClear(COMM_EVENT_ALL);
+        return;
+    }
+    
+    osThreadFlagsWait(COMM_EVENT_ALL, osFlagsWaitAny, timeout_ms);
 }
 
 void communication_task(void) {
-    // 检查接收完成
-    if (rx_complete) {
-        rx_complete = false;
-        comm_state = COMM_STATE_PROCESSING;
+    for (uint8_t i = 0; i < COMM_LINK_COUNT; i++) {
+        link_service(&links[i]);
+        drain_rx_ring(i);
+    }
+#if COMM_GATEWAY
+    gateway_service();
+#endif
+}
+
+// 接收任务中处理一条链路的接收重启和波特率切换
+static void link_service(CommLink *link) {
+    // UART出错后在任务上下文中重新启动接收
+    if (link->rx_restart_pending) {
+        link->rx_restart_pending = false;
+        restart_uart_receive(link);
+    }
+    
+    // 协商响应发送完成后切换波特率
+    if (link->baud_rate_pending != 0 && tx_idle(link)) {
+        apply_baud_rate(link, link->baud_rate_pending);
+        link->baud_rate_pending = 0;
+        link->baud_confirm_pending = (link->baud_rate_current != link->baud_rate_base);
+        link->baud_switch_tick = HAL_GetTick();
+    }
+    
+    // 新波特率下超时未收到有效帧，回退到默认波特率
+    if (link->baud_confirm_pending && baud_fallback_remaining_ms(link) == 0) {
+        link->baud_confirm_pending = false;
+        apply_baud_rate(link, link->baud_rate_base);
+    }
+}
+
+// 从command_class类别的队列取出一个请求并执行，队列为空时返回false
+static bool run_request(uint8_t command_class) {
+    RequestMessage request;
+    if (osMessageQueueGet(request_queue[command_class], &request, NULL, 0) != osOK) {
+        return false;
+    }
+    
+    const PacketHeader *header = (const PacketHeader *)request.frame;
+    CommLink *link = &links[request.link];
+    trace_event(TRACE_DISPATCH, request.opcode);
+    // 按该链路主机本帧使用的组帧方式回复
+    if (protocol_is_version_supported(header->version)) {
+        link->tx_version = header->version;
+    }
+    communication_select_link(request.link);
+    current_rx_cycles = request.rx_cycles;
+    link->state = COMM_STATE_PROCESSING;
+    
+    if (process_received_data(header, &request) < 0) {
+        link->stats.format_errors++;
+    }
+    
+    if (link->state == COMM_STATE_PROCESSING) {
+        link->state = COMM_STATE_IDLE;
+    }
+    block_pool_free(&request_pool, request.frame);
+    
+    // 波特率协商的响应已提交，由接收任务在发送完成后切换
+    if (link->baud_rate_pending != 0) {
+        notify_task(COMM_EVENT_WAKE);
+    }
+    return true;
+}
+
+// 命令执行任务：执行接收任务提交的请求，并完成已到期的挂起命令（如温度转换、glog分片），
+// 响应按各自的response_id发回。每做完一件事都先检查交互类队列，交互类请求
+// 最多等待一个批量命令或一个分片；到期命令和批量类请求轮流执行，互不饿死
+static void executor_task(void *argument) {
+    (void)argument;
+    int8_t watchdog_id = watchdog_register("exec", WATCHDOG_TASK_DEADLINE_MS);
+    
+    for (;;) {
+        watchdog_checkin(watchdog_id);
+        if (run_request(COMMAND_CLASS_INTERACTIVE)) {
+            continue;
+        }
         
-        // 处理接收到的数据
-        int result = process_received_data();
-        if (result < 0) {
-            comm_stats.format_errors++;
+        bool worked = run_due_command();
+        if (run_request(COMMAND_CLASS_BULK)) {
+            worked = true;
+        }
+        if (worked) {
+            continue;
         }
         
-        // 重新开始接收
-        start_uart_receive();
-        comm_state = COMM_STATE_IDLE;
+        // 到下一个挂起命令到期、有新请求或其他任务唤醒（如新的温度采样）
+        watchdog_wait(watchdog_id);
+        osThreadFlagsWait(COMM_EVENT_REQUEST | COMM_EVENT_WAKE, osFlagsWaitAny, command_handler_next_due_ms());
+    }
+}
+
+// 完成一个已到期的挂起命令或推送，没有到期命令或没有空闲发送槽时返回false
+static bool run_due_command(void) {
+    if (command_handler_next_due_ms() != 0) {
+        return false;
     }
     
-    // 其他处理逻辑...
+    int8_t slot = tx_slot_acquire(&links[current_link]);
+    if (slot < 0) {
+        return false;
+    }
+    
+    // 挂起命令和推送各自记录了发起它们的链路，帧按该链路的组帧方式构建
+    uint16_t response_len = 0;
+    uint8_t link_id = current_link;
+    if (command_handler_poll(tx_slots[slot], sizeof(tx_slots[slot]), &response_len, &link_id, &executor_scratch) > 0 &&
+        link_id < COMM_LINK_COUNT) {
+        tx_slot_submit(&links[link_id], slot, response_len);
+    } else {
+        tx_slot_release(slot);
+    }
+    return true;
 }
 
-static void start_uart_receive(void) {
-    if (comm_state == COMM_STATE_IDLE) {
-        comm_state = COMM_STATE_RECEIVING;
-        rx_buffer_pos = 0;
+// 消费环形缓冲区中的数据，边接收边解码，结束符到达时帧已校验完毕
+static void drain_rx_ring(uint8_t link_id) {
+    CommLink *link = &links[link_id];
+    const uint8_t *span;
+    uint16_t span_len;
+    while ((span_len = ring_buffer_peek(&link->ring, &span)) > 0) {
+        uint16_t used = 0;
+        FrameResult result = FRAME_RESULT_NONE;
+        
+        while (used < span_len && result == FRAME_RESULT_NONE) {
+            result = frame_parser_feed(&link->parser, span[used++]);
+        }
+        ring_buffer_consume(&link->ring, used);
+        link->stats.rx_bytes += used;
         
-        // 使用DMA接收单个字节
-        HAL_UART_Receive_DMA(&huart1, rx_buffer, 1);
+        if (result != FRAME_RESULT_NONE) {
+            handle_frame_result(link_id, result);
+        }
     }
 }
 
-static int process_received_data(void) {
-    if (rx_buffer_pos < 4) { // 最小数据包长度检查
-        return -1;
-    }
+// 接收DMA出错后重启接收：出错前DMA已写入的字节先交给解析器，
+// 解析器状态保留，正在接收的帧由CRC判断是否完好
+static void restart_uart_receive(CommLink *link) {
+    ring_buffer_commit_to(&link->ring, link->transport.ops->rx_position(link->transport.context));
+    drain_rx_ring((uint8_t)(link - links));
+    start_uart_receive(link);
+}
+
+static void start_uart_receive(CommLink *link) {
+    // DMA已停止，可以安全地同时复位head和tail
+    ring_buffer_reset(&link->ring);
+    
+    // 循环DMA + 空闲线检测：DMA持续写入环形缓冲区，
+    // 在半满/全满/总线空闲时通过communication_rx_event_callback()通知
+    link->transport.ops->start_rx(link->transport.context, link->ring_storage, sizeof(link->ring_storage));
+}
+
+static void handle_frame_result(uint8_t link_id, FrameResult result) {
+    CommLink *link = &links[link_id];
+    const PacketHeader *header = frame_parser_header(&link->parser);
+    trace_event(TRACE_FRAME_RX, result);
     
-    // 查找完整的数据包
-    size_t start_pos, end_pos;
-    if (!find_packet_boundaries(rx_buffer, rx_buffer_pos, &start_pos, &end_pos)) {
-        return -1; // 没有找到完整数据包
+    if (result == FRAME_RESULT_OK) {
+        // 新波特率下收到有效帧，确认切换成功
+        link->baud_confirm_pending = false;
+        submit_request(link_id, header);
+        return;
     }
     
-    // 解析数据包
-    PacketHeader header;
-    uint8_t packet_data[MAX_DATA_SIZE];
+    if (result == FRAME_RESULT_CRC_ERROR) {
+        link->stats.crc_errors++;
+    } else {
+        link->stats.format_errors++;
+    }
     
-    int data_len = parse_packet(rx_buffer, rx_buffer_pos, &header, packet_data, sizeof(packet_data));
-    if (data_len < 0) {
-        comm_stats.crc_errors++;
-        
-        // 发送错误响应
-        send_error_response(header.packet_id, ERROR_CODE_CORRUPT, "Packet corrupted");
-        return -1;
+    // 包头已收齐时才知道请求编号，回复错误帧以便主机立即重试
+    if (frame_parser_has_header(&link->parser)) {
+        send_error_response(link_id, header->packet_id, ERROR_CODE_CORRUPT, "Packet corrupted");
+    }
+}
+
+// 收完的帧整块交给执行任务（按命令的优先级类别入队），解析器换用空闲的请求缓冲区；
+// 执行任务积压、没有空闲缓冲区时丢弃本帧并回复忙，主机稍后重试
+static void submit_request(uint8_t link_id, const PacketHeader *header) {
+    CommLink *link = &links[link_id];
+    uint8_t *next = block_pool_alloc(&request_pool);
+    if (next == NULL) {
+        link->stats.rx_dropped++;
+        send_error_response(link_id, header->packet_id, ERROR_CODE_BUSY, "Busy");
+        return;
     }
     
-    comm_stats.packets_received++;
+    RequestMessage request = {
+        .frame = link->rx_request,
+        .rx_cycles = timebase_cycles(),
+        .opcode = 0,
+        .link = link_id,
+    };
+    link->rx_request = next;
+    frame_parser_set_buffer(&link->parser, next);
+    
+    uint8_t command_class = COMMAND_CLASS_INTERACTIVE;
+    if (header->type == PKT_TYPE_HOST_REQUEST) {
+        command_class = command_handler_request_class(request.frame + sizeof(PacketHeader), header->data_length,
+                                                      &request.opcode);
+    }
+    osMessageQueuePut(request_queue[command_class], &request, 0, 0);
+    notify_executor(COMM_EVENT_REQUEST);
+}
+
+// 不内联：栈深度报告（perf_report）以本函数为命令执行路径的起点
+__attribute__((noinline))
+static int process_received_data(const PacketHeader *header, const RequestMessage *request) {
+    const uint8_t *data = request->frame + sizeof(PacketHeader);
+    CommLink *link = &links[request->link];
+    link->stats.packets_received++;
     
     // 检查数据包类型
-    if (header.type != PKT_TYPE_HOST_REQUEST) {
+    if (header->type != PKT_TYPE_HOST_REQUEST) {
         // 发送错误响应
-        send_error_response(header.packet_id, ERROR_CODE_UNEXPECTED_RESP, "Unexpected packet type");
+        send_error_response(request->link, header->packet_id, ERROR_CODE_UNEXPECTED_RESP, "Unexpected packet type");
         return -1;
     }
+    command_stats_record_request(request->opcode);
     
-    // 处理命令
-    uint8_t response_packet[MAX_PACKET_SIZE];
+    int8_t slot = tx_slot_acquire(link);
+    if (slot < 0) {
+        return -1; // 没有空闲发送槽
+    }
+    
+    // 处理命令，响应帧直接构建到发送槽
     uint16_t response_len = 0;
     
-    int cmd_result = process_command_packet(packet_data, data_len, response_packet, &response_len, header.packet_id);
+    int cmd_result = process_command_packet(data, header->data_length, tx_slots[slot], sizeof(tx_slots[slot]), &response_len, header->packet_id, &executor_scratch);
+    if (cmd_result == COMMAND_DEFERRED) {
+        // 慢命令已挂起，到期后由执行任务发送响应
+        tx_slot_release(slot);
+        return 0;
+    }
     if (cmd_result < 0) {
+        tx_slot_release(slot);
+        
         // 发送错误响应
-        send_error_response(header.packet_id, ERROR_CODE_UNKNOWN, "Command processing failed");
+        send_error_response(request->link, header->packet_id, ERROR_CODE_UNKNOWN, "Command processing failed");
         return -1;
     }
     
     // 发送响应
-    send_response_packet(response_packet, response_len);
+    uint32_t queued_cycles = timebase_cycles();
+    command_stats_record_queued(request->opcode, queued_cycles - request->rx_cycles);
+    tx_slot_opcode[slot] = request->opcode;
+    tx_slot_cycles[slot] = queued_cycles;
+    tx_slot_submit(link, slot, response_len);
     
     return 0;
 }
 
-static void send_response_packet(const uint8_t *packet, uint16_t length) {
-    if (!tx_complete || length > sizeof(tx_buffer)) {
+// 申请一个空闲发送槽（仅在任务中调用）
+// 所有槽都在排队时等待发送完成归还，超时返回-1
+static int8_t tx_slot_acquire(CommLink *link) {
+    if (osSemaphoreAcquire(tx_slot_sem, COMM_TX_ACQUIRE_TIMEOUT_MS) != osOK) {
+        link->stats.tx_dropped++;
+        return -1;
+    }
+    
+    // 取得信号量后一定有空闲槽，与另一个任务互斥查找
+    int8_t slot = 0;
+    taskENTER_CRITICAL();
+    while (tx_slot_used[slot]) {
+        slot++;
+    }
+    tx_slot_used[slot] = true;
+    taskEXIT_CRITICAL();
+    tx_slot_opcode[slot] = COMMAND_STATS_NONE;
+    return slot;
+}
+
+// 任务和发送完成回调中都会调用
+static void tx_slot_release(int8_t slot) {
+    tx_slot_used[slot] = false;
+    osSemaphoreRelease(tx_slot_sem);
+}
+
+// 提交已构建好的帧：入队到link的发送队列，该链路DMA空闲时立即开始发送
+static void tx_slot_submit(CommLink *link, int8_t slot, uint16_t length) {
+    if (length == 0) {
+        tx_slot_release(slot);
         return;
     }
     
-    // 复制数据到发送缓冲区
-    memcpy(tx_buffer, packet, length);
+    tx_slot_len[slot] = length;
+    trace_event(TRACE_RESPONSE, length);
+    
+    // 与发送完成回调互斥访问队列
+    // 每个链路的队列都能容纳全部发送槽
+    taskENTER_CRITICAL();
+    link->tx_queue[link->tx_queue_head & (COMM_TX_SLOT_COUNT - 1)] = slot;
+    link->tx_queue_head++;
+    
+    uint8_t depth = (uint8_t)(link->tx_queue_head - link->tx_queue_tail);
+    if (depth > link->stats.tx_queue_peak) {
+        link->stats.tx_queue_peak = depth;
+    }
+    
+    if (link->tx_active_slot < 0) {
+        tx_start_next(link);
+    }
+    link->stats.tx_queue_depth = (uint8_t)(link->tx_queue_head - link->tx_queue_tail);
+    taskEXIT_CRITICAL();
+}
+
+uint16_t communication_next_packet_id(void) {
+    return (uint16_t)(packet_id_counter++ | 0x8000);
+}
+
+static bool tx_idle(const CommLink *link) {
+    return link->tx_active_slot < 0 && link->tx_queue_head == link->tx_queue_tail;
+}
+
+void communication_mark_activity(void) {
+    activity_tick = HAL_GetTick();
+}
+
+bool communication_quiet(uint32_t quiet_ms) {
+    for (uint8_t i = 0; i < COMM_LINK_COUNT; i++) {
+        const CommLink *link = &links[i];
+        if (!tx_idle(link) || link->rx_restart_pending || ring_buffer_count(&link->ring) != 0) {
+            return false;
+        }
+    }
+#if COMM_GATEWAY
+    if (!gateway_idle()) {
+        return false;
+    }
+#endif
+    return osMessageQueueGetCount(request_queue[COMMAND_CLASS_INTERACTIVE]) == 0 &&
+           osMessageQueueGetCount(request_queue[COMMAND_CLASS_BULK]) == 0 &&
+           HAL_GetTick() - activity_tick >= quiet_ms;
+}
+
+bool communication_stop_allowed(void) {
+    for (uint8_t i = 0; i < COMM_LINK_COUNT; i++) {
+        if (links[i].baud_rate_pending != 0 || links[i].baud_confirm_pending) {
+            return false;
+        }
+    }
+    return communication_quiet(COMM_STOP_HOLDOFF_MS);
+}
+
+bool communication_low_clock_allowed(void) {
+    for (uint8_t i = 0; i < COMM_LINK_COUNT; i++) {
+        if (links[i].baud_rate_pending != 0 || links[i].baud_confirm_pending ||
+            links[i].baud_rate_current > CLOCK_SCALE_BAUD_MAX) {
+            return false;
+        }
+    }
+    return communication_quiet(CLOCK_SCALE_QUIET_MS);
+}
+
+bool communication_is_baud_supported(uint32_t baud_rate) {
+    static const uint32_t rates[COMM_BAUD_RATE_COUNT] = COMM_BAUD_RATES;
+    for (uint8_t i = 0; i < COMM_BAUD_RATE_COUNT; i++) {
+        if (rates[i] == baud_rate) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool communication_request_baud_rate(uint32_t baud_rate) {
+    if (!communication_is_baud_supported(baud_rate)) {
+        return false;
+    }
+    
+    links[current_link].baud_rate_pending = baud_rate;
+    return true;
+}
+
+void communication_set_base_baud_rate(uint8_t link_id, uint32_t baud_rate) {
+    CommLink *link = &links[link_id];
+    link->baud_rate_base = baud_rate;
+    if (link->baud_rate_current != baud_rate) {
+        apply_baud_rate(link, baud_rate);
+    }
+}
+
+uint32_t communication_get_baud_rate(void) {
+    return links[current_link].baud_rate_current;
+}
+
+// 解析器的地址由执行任务或存储任务改写，接收任务从下一帧开始按新地址过滤
+void communication_set_address(uint8_t address) {
+    protocol_set_address(address);
+#if COMM_WIRED_LINK
+    frame_parser_set_address(&links[COMM_LINK_WIRED].parser, address);
+#endif
+}
+
+uint8_t communication_get_address(void) {
+    return protocol_get_address();
+}
+
+// 闪存按半字编程，地址保存为uint16_t
+void communication_load_address(void) {
+    uint16_t length = 0;
+    const void *saved = config_store_find(CONFIG_KEY_ADDRESS, &length);
+    uint16_t address = PROTOCOL_ADDRESS_NONE;
+    if (saved && length == sizeof(address)) {
+        memcpy(&address, saved, sizeof(address));
+    }
+    if (address < PROTOCOL_ADDRESS_MIN || address > PROTOCOL_ADDRESS_MAX) {
+        address = PROTOCOL_ADDRESS_NONE;
+    }
+    communication_set_address((uint8_t)address);
+}
+
+void communication_get_address_item(uint16_t index, void *item) {
+    (void)index;
+    uint16_t address = protocol_get_address();
+    memcpy(item, &address, sizeof(address));
+}
+
+static uint32_t baud_fallback_remaining_ms(const CommLink *link) {
+    if (!link->baud_confirm_pending) {
+        return UINT32_MAX;
+    }
+    
+    uint32_t elapsed = HAL_GetTick() - link->baud_switch_tick;
+    return (elapsed >= COMM_BAUD_FALLBACK_MS) ? 0 : COMM_BAUD_FALLBACK_MS - elapsed;
+}
+
+// 重新配置链路的波特率（该链路发送已空闲时在任务中调用）
+static void apply_baud_rate(CommLink *link, uint32_t baud_rate) {
+    const CommTransport *transport = &link->transport;
+    transport->ops->stop_rx(transport->context);
     
-    // 开始发送
-    tx_complete = false;
-    comm_state = COMM_STATE_TRANSMITTING;
+    if (!transport->ops->set_baud(transport->context, baud_rate)) {
+        // 超出范围时恢复回退的波特率
+        baud_rate = link->baud_rate_base;
+        transport->ops->set_baud(transport->context, baud_rate);
+    }
+    link->baud_rate_current = baud_rate;
     
-    HAL_UART_Transmit_DMA(&huart1, tx_buffer, length);
+    // 旧波特率下未完成的帧作废
+    frame_parser_reset(&link->parser);
+    start_uart_receive(link);
 }
 
-int send_error_response(uint16_t response_id, uint8_t error_code, const char *error_desc) {
-    uint8_t error_data[256];
+// 从队列取出下一帧并启动DMA（调用者保证互斥：临界区内或发送完成回调中）
+static void tx_start_next(CommLink *link) {
+    while (link->tx_queue_tail != link->tx_queue_head) {
+        int8_t slot = link->tx_queue[link->tx_queue_tail & (COMM_TX_SLOT_COUNT - 1)];
+        link->tx_queue_tail++;
+        
+        link->tx_active_slot = slot;
+        link->state = COMM_STATE_TRANSMITTING;
+        if (link->transport.ops->send(link->transport.context, tx_slots[slot], tx_slot_len[slot])) {
+            trace_event(TRACE_TX_START, tx_slot_len[slot]);
+            return;
+        }
+        
+        // 启动失败，丢弃该帧继续下一帧
+        tx_slot_release(slot);
+        link->stats.tx_dropped++;
+    }
+    
+    link->tx_active_slot = -1;
+    link->state = COMM_STATE_IDLE;
+}
+
+// 接收任务和执行任务都会发送错误帧，组帧方式直接取该链路的版本，
+// 不经过build_packet()使用的当前链路版本
+int send_error_response(uint8_t link_id, uint16_t response_id, uint8_t error_code, const char *error_desc) {
+    CommLink *link = &links[link_id];
+    uint8_t error_data[64]; // EC和简短的ED，过长的描述返回-1
     uint16_t error_data_len = 0;
     
     // 构建错误数据
@@ -151,106 +737,163 @@ int send_error_response(uint16_t response_id, uint8_t error_code, const char *er
         error_data_len += ed_len;
     }
     
-    // 构建错误数据包
-    uint8_t error_packet[MAX_PACKET_SIZE];
-    int packet_len = build_packet(PKT_TYPE_SLAVE_ERROR, packet_id_counter++, response_id, error_data, error_data_len, error_packet, sizeof(error_packet));
+    int8_t slot = tx_slot_acquire(link);
+    if (slot < 0) {
+        return -1;
+    }
+    
+    // 错误数据包直接构建到发送槽
+    PacketHeader header = {
+        .version = link->tx_version,
+        .address = protocol_get_address(),
+        .type = PKT_TYPE_SLAVE_ERROR,
+        .packet_id = communication_next_packet_id(),
+        .response_id = response_id,
+        .data_length = error_data_len,
+    };
+    FrameWriter writer;
+    frame_writer_begin(&writer, tx_slots[slot], sizeof(tx_slots[slot]), &header);
+    frame_writer_write(&writer, error_data, error_data_len);
+    int packet_len = frame_writer_finish(&writer);
     if (packet_len < 0) {
+        tx_slot_release(slot);
         return -1;
     }
     
     // 发送错误响应
-    send_response_packet(error_packet, packet_len);
+    tx_slot_submit(link, slot, packet_len);
     
     return 0;
 }
 
 // UART回调函数
-void communication_rx_complete_callback(void) {
-    // 检查是否接收到起始符
-    if (rx_buffer_pos == 0 && rx_buffer[0] == START_MARK_1) {
-        rx_buffer_pos = 1;
-        HAL_UART_Receive_DMA(&huart1, &rx_buffer[1], 1);
+void communication_rx_event_callback(uint8_t link, uint16_t dma_pos) {
+    // dma_pos为DMA在环形缓冲区中的当前写入位置，ISR只发布新的head
+    trace_event(TRACE_UART_RX, dma_pos);
+#if COMM_GATEWAY
+    // 总线上的应答都是本机请求的结果，不推迟STOP模式
+    if (link == COMM_LINK_BUS) {
+        gateway_rx_event(dma_pos);
+        notify_task(COMM_EVENT_RX);
         return;
     }
-    
-    if (rx_buffer_pos == 1 && rx_buffer[1] == START_MARK_2) {
-        rx_buffer_pos = 2;
-        HAL_UART_Receive_DMA(&huart1, &rx_buffer[2], 1);
+#endif
+    ring_buffer_commit_to(&links[link].ring, dma_pos);
+    communication_mark_activity();
+    clock_scale_full(); // 请求在全速下解析和执行
+    notify_task(COMM_EVENT_RX);
+}
+
+static void notify_task(uint32_t flags) {
+    if (comm_thread != NULL) {
+        osThreadFlagsSet(comm_thread, flags);
+    }
+}
+
+static void notify_executor(uint32_t flags) {
+    if (executor_thread != NULL) {
+        osThreadFlagsSet(executor_thread, flags);
+    }
+}
+
+void communication_wake(void) {
+    notify_executor(COMM_EVENT_WAKE);
+}
+
+void communication_wake_rx(void) {
+    notify_task(COMM_EVENT_WAKE);
+}
+
+void communication_tx_complete_callback(uint8_t link_id) {
+#if COMM_GATEWAY
+    if (link_id == COMM_LINK_BUS) {
+        gateway_tx_complete();
+        notify_task(COMM_EVENT_TX);
         return;
     }
+#endif
+    CommLink *link = &links[link_id];
     
-    // 继续接收数据
-    if (rx_buffer_pos >= 2) {
-        rx_buffer_pos++;
-        
-        // 检查是否接收到结束符
-        if (rx_buffer_pos >= 4 && 
-            rx_buffer[rx_buffer_pos - 2] == END_MARK_1 && 
-            rx_buffer[rx_buffer_pos - 1] == END_MARK_2) {
-            
-            // 检查这不是转义序列
-            bool is_escaped = false;
-            if (rx_buffer_pos > 4) {
-                // 简化的转义检查
-                if (rx_buffer[rx_buffer_pos - 3] == ESCAPE_BYTE) {
-                    is_escaped = true;
-                }
-            }
-            
-            if (!is_escaped) {
-                // 接收完成
-                rx_complete = true;
-                return;
-            }
-        }
-        
-        // 继续接收下一个字节
-        if (rx_buffer_pos < COMM_RX_BUFFER_SIZE) {
-            HAL_UART_Receive_DMA(&huart1, &rx_buffer[rx_buffer_pos], 1);
-        } else {
-            // 缓冲区溢出，重新开始
-            rx_buffer_pos = 0;
-            HAL_UART_Receive_DMA(&huart1, rx_buffer, 1);
-        }
-    } else {
-        // 重新开始寻找起始符
-        rx_buffer_pos = 0;
-        HAL_UART_Receive_DMA(&huart1, rx_buffer, 1);
+    // 记录发送耗时并归还刚发送完的槽
+    int8_t slot = link->tx_active_slot;
+    if (slot >= 0) {
+        trace_event(TRACE_TX_DONE, tx_slot_len[slot]);
+        command_stats_record_transmit(tx_slot_opcode[slot], timebase_cycles() - tx_slot_cycles[slot]);
+        link->stats.tx_bytes += tx_slot_len[slot];
+        tx_slot_release(slot);
+        link->tx_active_slot = -1;
     }
+    link->stats.packets_sent++;
+    
+    communication_mark_activity();
+    
+    // 紧接着发送队列中的下一帧
+    tx_start_next(link);
+    link->stats.tx_queue_depth = (uint8_t)(link->tx_queue_head - link->tx_queue_tail);
+    
+    notify_task(COMM_EVENT_TX);
 }
 
-void communication_tx_complete_callback(void) {
-    tx_complete = true;
-    comm_stats.packets_sent++;
+void communication_error_callback(uint8_t link_id, bool rx_stopped) {
+    trace_event(TRACE_UART_ERROR, rx_stopped);
+#if COMM_GATEWAY
+    if (link_id == COMM_LINK_BUS) {
+        gateway_error(rx_stopped);
+        notify_task(COMM_EVENT_ERROR);
+        return;
+    }
+#endif
+    links[link_id].stats.timeout_errors++;
     
-    if (comm_state == COMM_STATE_TRANSMITTING) {
-        comm_state = COMM_STATE_IDLE;
+    // 帧错误、噪声和溢出时循环DMA继续接收；DMA传输错误停止了接收，交给任务重新启动
+    if (rx_stopped) {
+        links[link_id].rx_restart_pending = true;
+        notify_task(COMM_EVENT_ERROR);
     }
 }
 
-void communication_error_callback(void) {
-    // 处理UART错误
-    comm_stats.timeout_errors++;
-    
-    // 重新开始接收
-    rx_buffer_pos = 0;
-    rx_complete = false;
-    
-    if (comm_state == COMM_STATE_RECEIVING) {
-        start_uart_receive();
+uint8_t communication_current_link(void) {
+    return current_link;
+}
+
+uint32_t communication_request_age_us(void) {
+    return timebase_cycles_to_us(timebase_cycles() - current_rx_cycles);
+}
+
+void communication_select_link(uint8_t link) {
+    if (link < COMM_LINK_COUNT) {
+        current_link = link;
+        protocol_set_tx_version(links[link].tx_version);
     }
 }
 
 CommState communication_get_state(void) {
-    return comm_state;
+    return links[current_link].state;
 }
 
-void communication_get_stats(CommStats *stats) {
-    if (stats) {
-        *stats = comm_stats;
+// 解析器和环形缓冲区的计数由各自维护，读取时汇总
+void communication_get_link_stats(uint8_t link_id, CommStats *stats) {
+    if (stats && link_id < COMM_LINK_COUNT) {
+        const CommLink *link = &links[link_id];
+        *stats = link->stats;
+        stats->rx_unstuffed = link->parser.unstuffed;
+        stats->tx_stuffed = frame_writer_stuffed_total();
+        stats->resyncs = link->parser.resyncs;
+        stats->rx_ring_peak = link->ring.peak;
+        stats->rx_overflows = link->ring.overflows;
     }
 }
 
+void communication_get_stats(CommStats *stats) {
+    communication_get_link_stats(current_link, stats);
+}
+
 void communication_reset_stats(void) {
-    memset(&comm_stats, 0, sizeof(comm_stats));
+    CommLink *link = &links[current_link];
+    memset(&link->stats, 0, sizeof(link->stats));
+    link->parser.unstuffed = 0;
+    link->parser.resyncs = 0;
+    link->ring.peak = 0;
+    link->ring.overflows = 0;
+    frame_writer_reset_stats();
 }
@@ -0,0 +1,316 @@
+#include "config_store.h"
+#include "log_store.h"
+#include "storage_task.h"
+#include "device_control.h"
+#include "rtc_clock.h"
+#include "communication.h"
+#include "gateway.h"
+#include "sampling_settings.h"
+#include "log_compress.h"
+#include "temp_calib.h"
+#include "crc32.h"
+#include "main.h"
+#include <string.h>
+#include <assert.h>
+
+// 页头：页序号在切换页时加1，magic最后写入
+typedef struct {
+    uint32_t sequence;
+    uint16_t magic;
+    uint16_t format;
+} ConfigPageHeader;
+
+// 记录：| 记录头 | 内容（补齐到4字节） | 记录尾 |，记录头先写，
+// 记录尾最后写入，没有记录尾（编程中途掉电）或CRC不符的记录跳过
+typedef struct {
+    uint16_t magic;
+    uint8_t key;
+    uint8_t version;     // 内容格式，见sections
+    uint16_t length;     // 内容字节数
+    uint16_t reserved;
+} ConfigRecordHeader;
+
+typedef struct {
+    uint32_t crc;        // 记录头和内容的CRC32
+    uint16_t commit;
+    uint16_t reserved;
+} ConfigRecordTrailer;
+
+#define CONFIG_PAGE_MAGIC    0x4643U // "CF"
+#define CONFIG_PAGE_FORMAT   1U
+#define CONFIG_RECORD_MAGIC  0x5243U // "CR"
+#define CONFIG_RECORD_COMMIT 0xA55AU
+#define CONFIG_NO_PAGE       0xFFU
+
+#define CONFIG_STORE_BASE (LOG_STORE_BASE + (LOG_STORE_PAGES - CONFIG_STORE_PAGES) * LOG_STORE_PAGE_SIZE)
+#define CONFIG_ITEM_MAX   32U // 单个条目的最大长度（写入时的缓冲）
+
+// 各键的内容：item_count个条目，保存时由存储任务逐条读取当前设置
+typedef struct {
+    uint8_t version;      // 条目结构改变时加1，旧记录不再加载
+    uint16_t item_size;
+    uint16_t item_count;
+    void (*get_item)(uint16_t index, void *item);
+} ConfigSection;
+
+static void alarm_get_item(uint16_t index, void *item) {
+    alarm_get_config((uint8_t)index, item);
+}
+
+static const ConfigSection sections[CONFIG_KEY_COUNT] = {
+    [CONFIG_KEY_ALARMS] = { 1, sizeof(AlarmConfig), MAX_ALARMS, alarm_get_item },
+    [CONFIG_KEY_CLOCK]  = { 1, sizeof(int16_t), 1, rtc_get_correction_item },
+    [CONFIG_KEY_ADDRESS] = { 1, sizeof(uint16_t), 1, communication_get_address_item },
+    [CONFIG_KEY_SAMPLING] = { 1, sizeof(SamplingSettings), 1, sampling_settings_get_item },
+    [CONFIG_KEY_COMPRESS] = { 1, sizeof(LogCompressConfig), TEMP_MAX_SENSORS, sampling_settings_get_compress_item },
+    [CONFIG_KEY_CALIB] = { 1, sizeof(TempCalibration), TEMP_MAX_SENSORS, sampling_settings_get_calib_item },
+#if COMM_GATEWAY
+    [CONFIG_KEY_GATEWAY] = { 1, sizeof(GatewayConfig), 1, gateway_get_config_item },
+#endif
+};
+
+static_assert(sizeof(ConfigPageHeader) % 4 == 0 && sizeof(ConfigRecordHeader) % 4 == 0 &&
+              sizeof(ConfigRecordTrailer) % 4 == 0, "记录按4字节对齐");
+static_assert(sizeof(AlarmConfig) <= CONFIG_ITEM_MAX && sizeof(AlarmConfig) % 2 == 0, "条目超过写入缓冲或长度不是偶数");
+static_assert(sizeof(GatewayConfig) <= CONFIG_ITEM_MAX && sizeof(GatewayConfig) % 2 == 0, "条目超过写入缓冲或长度不是偶数");
+static_assert(sizeof(SamplingSettings) <= CONFIG_ITEM_MAX && sizeof(SamplingSettings) % 2 == 0, "条目超过写入缓冲或长度不是偶数");
+static_assert(sizeof(LogCompressConfig) <= CONFIG_ITEM_MAX && sizeof(LogCompressConfig) % 2 == 0, "条目超过写入缓冲或长度不是偶数");
+static_assert(sizeof(TempCalibration) <= CONFIG_ITEM_MAX && sizeof(TempCalibration) % 2 == 0, "条目超过写入缓冲或长度不是偶数");
+// 换页时各键的最新记录都搬入新页，须能放进一页
+#define CONFIG_RECORD_SIZE(length) \
+    (sizeof(ConfigRecordHeader) + (((length) + 3U) & ~3U) + sizeof(ConfigRecordTrailer))
+static_assert(sizeof(ConfigPageHeader) + CONFIG_RECORD_SIZE(sizeof(AlarmConfig) * MAX_ALARMS) +
+              CONFIG_RECORD_SIZE(sizeof(int16_t)) + CONFIG_RECORD_SIZE(sizeof(uint16_t)) +
+              CONFIG_RECORD_SIZE(sizeof(GatewayConfig)) + CONFIG_RECORD_SIZE(sizeof(SamplingSettings)) +
+              CONFIG_RECORD_SIZE(sizeof(LogCompressConfig) * TEMP_MAX_SENSORS) +
+              CONFIG_RECORD_SIZE(sizeof(TempCalibration) * TEMP_MAX_SENSORS) <= LOG_STORE_PAGE_SIZE,
+              "设置超过一页");
+
+static uint8_t active_page = CONFIG_NO_PAGE;
+static uint32_t active_sequence = 0;
+static uint16_t write_offset = 0;       // 当前页中下一条记录的位置，等于页大小表示已写满
+static volatile uint32_t dirty_mask = 0; // 待保存的键
+
+static inline uint32_t page_address(uint8_t page) {
+    return CONFIG_STORE_BASE + (uint32_t)page * LOG_STORE_PAGE_SIZE;
+}
+
+static inline const ConfigPageHeader *page_header(uint8_t page) {
+    return (const ConfigPageHeader *)page_address(page);
+}
+
+static inline bool page_valid(uint8_t page) {
+    return page_header(page)->magic == CONFIG_PAGE_MAGIC && page_header(page)->format == CONFIG_PAGE_FORMAT;
+}
+
+static inline uint16_t record_size(uint16_t length) {
+    return (uint16_t)CONFIG_RECORD_SIZE(length);
+}
+
+static bool flash_erase(uint8_t page) {
+    FLASH_EraseInitTypeDef erase = {
+        .TypeErase = FLASH_TYPEERASE_PAGES,
+        .Banks = FLASH_BANK_1,
+        .PageAddress = page_address(page),
+        .NbPages = 1,
+    };
+    uint32_t page_error = 0;
+
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &page_error);
+    HAL_FLASH_Lock();
+    return status == HAL_OK;
+}
+
+static bool flash_program(uint32_t address, const void *data, uint32_t size) {
+    const uint8_t *bytes = data;
+    bool ok = true;
+
+    HAL_FLASH_Unlock();
+    for (uint32_t i = 0; i < size && ok; i += 2) {
+        uint16_t halfword = (uint16_t)(bytes[i] | (bytes[i + 1] << 8));
+        ok = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, address + i, halfword) == HAL_OK;
+    }
+    HAL_FLASH_Lock();
+    return ok;
+}
+
+// offset处记录的长度，不是记录头（空白或损坏）时返回0
+static uint16_t record_at(uint8_t page, uint16_t offset, const ConfigRecordHeader **header) {
+    if (offset + sizeof(ConfigRecordHeader) + sizeof(ConfigRecordTrailer) > LOG_STORE_PAGE_SIZE) {
+        return 0;
+    }
+    *header = (const ConfigRecordHeader *)(page_address(page) + offset);
+    if ((*header)->magic != CONFIG_RECORD_MAGIC) {
+        return 0;
+    }
+    uint16_t size = record_size((*header)->length);
+    return (offset + size <= LOG_STORE_PAGE_SIZE) ? size : 0;
+}
+
+static bool record_complete(const ConfigRecordHeader *header) {
+    const uint8_t *data = (const uint8_t *)(header + 1);
+    const ConfigRecordTrailer *trailer =
+        (const ConfigRecordTrailer *)(data + ((header->length + 3U) & ~3U));
+    return trailer->commit == CONFIG_RECORD_COMMIT &&
+           trailer->crc == crc32_compute_sw((const uint8_t *)header, sizeof(*header) + header->length);
+}
+
+// 当前页中key最新的完整记录
+static const ConfigRecordHeader *find_record(uint8_t key) {
+    const ConfigRecordHeader *found = NULL;
+    if (active_page == CONFIG_NO_PAGE) {
+        return NULL;
+    }
+    uint16_t offset = sizeof(ConfigPageHeader);
+    const ConfigRecordHeader *header;
+    uint16_t size;
+    while ((size = record_at(active_page, offset, &header)) != 0) {
+        if (header->key == key && record_complete(header)) {
+            found = header;
+        }
+        offset += size;
+    }
+    return found;
+}
+
+void config_store_init(void) {
+    active_page = CONFIG_NO_PAGE;
+    active_sequence = 0;
+    write_offset = LOG_STORE_PAGE_SIZE;
+
+    // 页序号较大的有效页是当前页
+    for (uint8_t page = 0; page < CONFIG_STORE_PAGES; page++) {
+        if (page_valid(page) &&
+            (active_page == CONFIG_NO_PAGE || page_header(page)->sequence > active_sequence)) {
+            active_page = page;
+            active_sequence = page_header(page)->sequence;
+        }
+    }
+    if (active_page == CONFIG_NO_PAGE) {
+        return; // 还没有保存过，第一次保存时切换到第0页
+    }
+
+    // 写入位置在最后一条记录之后；其后不是空白时（记录头损坏）视为写满，下次保存时换页
+    uint16_t offset = sizeof(ConfigPageHeader);
+    const ConfigRecordHeader *header;
+    uint16_t size;
+    while ((size = record_at(active_page, offset, &header)) != 0) {
+        offset += size;
+    }
+    const uint16_t *rest = (const uint16_t *)(page_address(active_page) + offset);
+    bool blank = true;
+    for (uint16_t i = 0; i < (LOG_STORE_PAGE_SIZE - offset) / 2 && blank; i++) {
+        blank = rest[i] == 0xFFFFU;
+    }
+    write_offset = blank ? offset : LOG_STORE_PAGE_SIZE;
+}
+
+const void *config_store_find(uint8_t key, uint16_t *length) {
+    if (key >= CONFIG_KEY_COUNT) {
+        return NULL;
+    }
+    const ConfigRecordHeader *header = find_record(key);
+    if (!header || header->version != sections[key].version ||
+        header->length != sections[key].item_size * sections[key].item_count) {
+        return NULL;
+    }
+    *length = header->length;
+    return header + 1;
+}
+
+void config_store_request_save(uint8_t key) {
+    if (key < CONFIG_KEY_COUNT) {
+        __atomic_fetch_or(&dirty_mask, 1UL << key, __ATOMIC_RELAXED);
+        storage_task_wake();
+    }
+}
+
+// 把key的当前设置写成一条记录：记录头、逐条读取的内容、记录尾
+static bool write_section(uint8_t key) {
+    const ConfigSection *section = &sections[key];
+    uint32_t address = page_address(active_page) + write_offset;
+    ConfigRecordHeader header = {
+        .magic = CONFIG_RECORD_MAGIC,
+        .key = key,
+        .version = section->version,
+        .length = (uint16_t)(section->item_size * section->item_count),
+        .reserved = 0xFFFFU,
+    };
+    write_offset += record_size(header.length); // 失败时跳过这条记录
+
+    Crc32Context crc;
+    crc32_init(&crc);
+    crc32_update(&crc, (const uint8_t *)&header, sizeof(header));
+    if (!flash_program(address, &header, sizeof(header))) {
+        return false;
+    }
+    address += sizeof(header);
+
+    uint32_t item[CONFIG_ITEM_MAX / 4]; // 按条目结构对齐
+    for (uint16_t i = 0; i < section->item_count; i++) {
+        memset(item, 0, sizeof(item)); // 结构中的填充字节也参与CRC
+        section->get_item(i, item);
+        crc32_update(&crc, (const uint8_t *)item, section->item_size);
+        if (!flash_program(address, item, section->item_size)) {
+            return false;
+        }
+        address += section->item_size;
+    }
+    address = (address + 3U) & ~3U;
+
+    ConfigRecordTrailer trailer = {
+        .crc = crc32_final(&crc),
+        .commit = CONFIG_RECORD_COMMIT,
+        .reserved = 0xFFFFU,
+    };
+    return flash_program(address, &trailer, sizeof(trailer));
+}
+
+// 换到另一页：擦除后先搬入除skip外各键的最新记录，再写页头
+static bool switch_page(uint8_t skip) {
+    uint8_t page = (active_page == CONFIG_NO_PAGE) ? 0 : (uint8_t)((active_page + 1) % CONFIG_STORE_PAGES);
+    if (!flash_erase(page)) {
+        return false;
+    }
+
+    uint16_t offset = sizeof(ConfigPageHeader);
+    for (uint8_t key = 0; key < CONFIG_KEY_COUNT; key++) {
+        const ConfigRecordHeader *header = (key != skip) ? find_record(key) : NULL;
+        if (header) {
+            uint16_t size = record_size(header->length);
+            flash_program(page_address(page) + offset, header, size);
+            offset += size;
+        }
+    }
+
+    ConfigPageHeader page_header_value = {
+        .sequence = active_sequence + 1,
+        .magic = CONFIG_PAGE_MAGIC,
+        .format = CONFIG_PAGE_FORMAT,
+    };
+    if (!flash_program(page_address(page), &page_header_value, sizeof(page_header_value))) {
+        return false;
+    }
+    active_page = page;
+    active_sequence = page_header_value.sequence;
+    write_offset = offset;
+    return true;
+}
+
+void config_store_service(void) {
+    uint32_t dirty = __atomic_exchange_n(&dirty_mask, 0, __ATOMIC_RELAXED);
+    for (uint8_t key = 0; key < CONFIG_KEY_COUNT; key++) {
+        if (!(dirty & (1UL << key))) {
+            continue;
+        }
+        uint16_t size = record_size((uint16_t)(sections[key].item_size * sections[key].item_count));
+        if ((active_page == CONFIG_NO_PAGE || write_offset + size > LOG_STORE_PAGE_SIZE) && !switch_page(key)) {
+            config_store_request_save(key); // 擦写失败，下次再试
+            continue;
+        }
+        if (!write_section(key)) {
+            config_store_request_save(key);
+        }
+    }
+}
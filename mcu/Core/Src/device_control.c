@@ -1,323 +1,887 @@
 #include "device_control.h"
 #include "main.h"
 #include "DS18B20.h"
+#include "temp_driver.h"
+#include "analog_temp.h"
+#include "test_mode.h"
+#include "log_store.h"
+#include "log_archive.h"
+#include "log_compress.h"
+#include "clock_scale.h"
+#include "output_sequencer.h"
 #include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
 #include <string.h>
 
 // 外部句柄
-extern RTC_HandleTypeDef hrtc;
 extern TIM_HandleTypeDef htim4;
 
-// 全局变量
-AlarmConfig g_alarm_configs[MAX_ALARMS];
-TempLogEntry g_temp_log[MAX_LOG_ENTRIES];
-uint32_t g_log_count = 0;
-uint32_t g_log_write_index = 0;
+// 温度转换状态机：转换期间DS18B20对读时隙回0，完成后回1，超过当前分辨率的最长转换时间
+// 同样视为完成。采样时直接等待最长转换时间，不再每隔几毫秒唤醒CPU轮询（temp_driver.c）
+typedef enum {
+    TEMP_CONV_IDLE,       // 未在转换
+    TEMP_CONV_RUNNING,    // 已发出转换命令，等待完成
+    TEMP_CONV_DONE        // 转换完成，暂存器中为新结果
+} TempConversionState;
+static TempConversionState temp_conversion_state = TEMP_CONV_IDLE;
+static uint32_t temp_conversion_start = 0;
+static uint8_t temp_resolution = TEMP_RESOLUTION_DEFAULT;
 
-static bool led_state = false;
-static bool buzzer_state = false;
-static uint32_t buzzer_end_time = 0;
+// 各分辨率（9~12位）的最长转换时间
+static const uint16_t temp_conversion_time_ms[] = { 94, 188, 375, 750 };
+#define TEMP_CONVERSION_TIME_MS (temp_conversion_time_ms[temp_resolution - TEMP_RESOLUTION_MIN])
+
+// 总线上的传感器：初始化时搜索ROM，按搜索顺序编号；作为第一个驱动，编号即传感器编号
+static uint8_t temp_sensor_roms[TEMP_MAX_SENSORS][DS18B20_ROM_SIZE];
+static uint8_t temp_sensor_count = 0;
+
+// 健康状态由采样任务写入，读取时进入临界段；按所有驱动的传感器编号
+static TempSensorHealth temp_sensor_health[TEMP_MAX_SENSORS];
+static uint8_t temp_sensor_total = 0;
+
+// 传感器的寻址方式：只有一个时跳过ROM，多个时匹配ROM
+static const uint8_t *temp_sensor_rom(uint8_t sensor) {
+    return (temp_sensor_count > 1) ? temp_sensor_roms[sensor] : NULL;
+}
+
+// LED和蜂鸣器：共用TIM4的计数器（约1 kHz），各占一个通道，两个通道在初始化时启动，
+// 开关只写各自的比较寄存器（一次写入，各任务并发调用不会改动另一个通道）。
+// 简单节拍由各自的软件定时器切换，定时器任务优先级高于其他任务，节拍不受通信和采样影响；
+// 多步序列由DMA写比较寄存器（output_sequencer.h）。开关、节拍和序列互相取消
+typedef struct {
+    uint32_t channel;
+    uint8_t output;       // output_sequencer的输出编号
+    TimerHandle_t timer;
+    StaticTimer_t timer_buffer;
+    uint16_t on_ms;
+    uint16_t off_ms;
+    uint16_t remaining;   // 节拍中还要打开的次数（含当前这次），0为一直重复
+    uint8_t duty;         // 节拍打开时的占空比
+    bool pattern;         // 节拍进行中，为false时定时器回调不做任何事
+} Actuator;
+
+static Actuator led_output = { .channel = TIM_CHANNEL_4, .output = OUTPUT_LED };
+static Actuator buzzer_output = { .channel = TIM_CHANNEL_3, .output = OUTPUT_BUZZER };
+
+static void actuator_write(Actuator *actuator, uint8_t duty) {
+    // 向上计数的PWM1：比较值即占空比（周期OUTPUT_DUTY_MAX），为0时输出始终无效
+    if (duty != 0) {
+        clock_scale_full(); // TIM4的预分频按全速设置
+    }
+    __HAL_TIM_SET_COMPARE(&htim4, actuator->channel, duty);
+}
+
+// 输出当前是否打开（含序列中占空比不为0的一步）
+static bool actuator_is_on(const Actuator *actuator) {
+    return __HAL_TIM_GET_COMPARE(&htim4, actuator->channel) != 0;
+}
+
+// 定时器任务中调用：切换到节拍的下一段
+static void actuator_timer_callback(TimerHandle_t timer) {
+    Actuator *actuator = pvTimerGetTimerID(timer);
+    uint16_t period_ms = 0;
+
+    taskENTER_CRITICAL();
+    if (actuator->pattern) {
+        bool on = !actuator_is_on(actuator);
+        if (!on && actuator->remaining != 0 && --actuator->remaining == 0) {
+            actuator->pattern = false; // 最后一次打开结束
+        } else {
+            period_ms = on ? actuator->on_ms : actuator->off_ms;
+        }
+        actuator_write(actuator, on ? actuator->duty : 0);
+    }
+    taskEXIT_CRITICAL();
+
+    if (period_ms != 0) {
+        xTimerChangePeriod(timer, pdMS_TO_TICKS(period_ms), 0);
+    }
+}
+
+// 调度器启动前调用：启动通道并关闭输出，不进入临界段
+static void actuator_init(Actuator *actuator) {
+    output_sequencer_init();
+    if (!actuator->timer) {
+        actuator->timer = xTimerCreateStatic("output", 1, pdFALSE, actuator,
+                                             actuator_timer_callback, &actuator->timer_buffer);
+    }
+    output_sequencer_stop(actuator->output);
+    actuator->pattern = false;
+    actuator_write(actuator, 0);
+    HAL_TIM_PWM_Start(&htim4, actuator->channel);
+}
+
+static void actuator_set(Actuator *actuator, uint8_t duty) {
+    taskENTER_CRITICAL();
+    output_sequencer_stop(actuator->output);
+    actuator->pattern = false;
+    actuator_write(actuator, duty);
+    taskEXIT_CRITICAL();
+    xTimerStop(actuator->timer, 0);
+}
+
+static void actuator_start_pattern(Actuator *actuator, uint16_t on_ms, uint16_t off_ms, uint16_t count,
+                                   uint8_t duty) {
+    if (!output_pattern_valid(on_ms, off_ms, count) || duty == 0) {
+        actuator_set(actuator, 0);
+        return;
+    }
+    taskENTER_CRITICAL();
+    output_sequencer_stop(actuator->output);
+    actuator->on_ms = on_ms;
+    actuator->off_ms = off_ms;
+    actuator->remaining = count;
+    actuator->duty = duty;
+    actuator->pattern = true;
+    actuator_write(actuator, duty);
+    taskEXIT_CRITICAL();
+    xTimerChangePeriod(actuator->timer, pdMS_TO_TICKS(on_ms), 0); // 同时启动定时器
+}
+
+static bool actuator_play(Actuator *actuator, uint8_t sequence, bool loop) {
+    if (sequence == OUTPUT_SEQUENCE_NONE || sequence >= OUTPUT_SEQUENCE_COUNT) {
+        return false;
+    }
+    taskENTER_CRITICAL();
+    actuator->pattern = false;
+    output_sequencer_play_preset(actuator->output, sequence, loop);
+    taskEXIT_CRITICAL();
+    xTimerStop(actuator->timer, 0);
+    return true;
+}
+
+bool output_pattern_valid(uint16_t on_ms, uint16_t off_ms, uint16_t count) {
+    return on_ms != 0 && (off_ms != 0 || count == 1);
+}
+
+uint8_t output_duty_from_percent(uint8_t percent) {
+    return (uint8_t)((percent * OUTPUT_DUTY_MAX + 50U) / 100U);
+}
+
+// TIM4的计数时钟：APB1分频时定时器时钟为PCLK1的2倍
+static uint32_t output_timer_clock(void) {
+    uint32_t clock = HAL_RCC_GetPCLK1Freq();
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) {
+        clock *= 2;
+    }
+    return clock;
+}
+
+// 载波频率由TIM4的预分频决定，周期（OUTPUT_DUTY_MAX个计数，即占空比的刻度）不变；
+// 预分频有预装载，在下一个周期生效，不会产生半个周期
+bool output_set_frequency(uint16_t hz) {
+    if (hz < OUTPUT_FREQUENCY_MIN || hz > OUTPUT_FREQUENCY_MAX) {
+        return false;
+    }
+    uint32_t counts = (uint32_t)hz * OUTPUT_DUTY_MAX;
+    clock_scale_full();
+    __HAL_TIM_SET_PRESCALER(&htim4, (output_timer_clock() + counts / 2) / counts - 1);
+    return true;
+}
+
+uint16_t output_get_frequency(void) {
+    return (uint16_t)(output_timer_clock() / ((htim4.Instance->PSC + 1U) * OUTPUT_DUTY_MAX));
+}
+
+// 节拍的关闭段比较值为0，定时器到期前不影响输出
+bool output_all_off(void) {
+    return !actuator_is_on(&led_output) && !actuator_is_on(&buzzer_output) &&
+           !output_sequencer_playing(OUTPUT_LED) && !output_sequencer_playing(OUTPUT_BUZZER);
+}
 
 // LED控制实现
 void led_init(void) {
-    // LED使用PWM控制，这里可以设置初始状态
-    led_off();
+    actuator_init(&led_output);
 }
 
 void led_on(void) {
-    // 使用TIM4 CH3 PWM输出控制LED
-    HAL_TIM_PWM_Start(&htim4, TIM_CHANNEL_3);
-    // 设置占空比为50%用于LED亮度控制
-    __HAL_TIM_SET_COMPARE(&htim4, TIM_CHANNEL_3, htim4.Init.Period / 2);
-    led_state = true;
+    actuator_set(&led_output, OUTPUT_DUTY_HALF);
 }
 
 void led_off(void) {
-    HAL_TIM_PWM_Stop(&htim4, TIM_CHANNEL_3);
-    led_state = false;
+    actuator_set(&led_output, 0);
+}
+
+void led_set_duty(uint8_t duty) {
+    actuator_set(&led_output, duty);
 }
 
 void led_toggle(void) {
-    if (led_state) {
-        led_off();
-    } else {
-        led_on();
-    }
+    actuator_set(&led_output, actuator_is_on(&led_output) ? 0 : OUTPUT_DUTY_HALF);
+}
+
+void led_blink(uint16_t on_ms, uint16_t off_ms, uint16_t count, uint8_t duty) {
+    actuator_start_pattern(&led_output, on_ms, off_ms, count, duty);
+}
+
+bool led_play(uint8_t sequence, bool loop) {
+    return actuator_play(&led_output, sequence, loop);
 }
 
 bool led_get_state(void) {
-    return led_state;
+    return actuator_is_on(&led_output);
 }
 
-// 蜂鸣器控制实现 (使用同一个PWM通道，但可以通过不同参数控制)
+// 蜂鸣器控制实现
 void buzzer_init(void) {
-    buzzer_off();
+    actuator_init(&buzzer_output);
 }
 
 void buzzer_on(void) {
-    // 蜂鸣器需要更高频率的PWM信号
-    HAL_TIM_PWM_Start(&htim4, TIM_CHANNEL_3);
-    // 设置占空比为50%产生音频信号
-    __HAL_TIM_SET_COMPARE(&htim4, TIM_CHANNEL_3, htim4.Init.Period / 2);
-    buzzer_state = true;
+    actuator_set(&buzzer_output, OUTPUT_DUTY_HALF);
 }
 
 void buzzer_off(void) {
-    if (!led_state) { // 如果LED也不亮，才关闭PWM
-        HAL_TIM_PWM_Stop(&htim4, TIM_CHANNEL_3);
-    }
-    buzzer_state = false;
-    buzzer_end_time = 0;
+    actuator_set(&buzzer_output, 0);
 }
 
-void buzzer_beep(uint32_t duration_ms) {
-    buzzer_on();
-    buzzer_end_time = HAL_GetTick() + duration_ms;
+void buzzer_set_duty(uint8_t duty) {
+    actuator_set(&buzzer_output, duty);
 }
 
-bool buzzer_get_state(void) {
-    // 检查定时蜂鸣是否结束
-    if (buzzer_end_time > 0 && HAL_GetTick() >= buzzer_end_time) {
-        buzzer_off();
-    }
-    return buzzer_state;
+void buzzer_beep(uint16_t duration_ms) {
+    actuator_start_pattern(&buzzer_output, duration_ms, 0, 1, OUTPUT_DUTY_HALF);
 }
 
-// 温度传感器实现
-bool temperature_sensor_init(void) {
-    return (DS18B20_Init() == 0);
+void buzzer_pattern(uint16_t on_ms, uint16_t off_ms, uint16_t count, uint8_t duty) {
+    actuator_start_pattern(&buzzer_output, on_ms, off_ms, count, duty);
 }
 
-float temperature_get_current(void) {
-    if (!temperature_is_sensor_ok()) {
-        return -999.0f; // 错误值
+bool buzzer_play(uint8_t sequence, bool loop) {
+    return actuator_play(&buzzer_output, sequence, loop);
+}
+
+bool buzzer_get_state(void) {
+    return actuator_is_on(&buzzer_output);
+}
+
+// 温度传感器实现：1-Wire总线上的DS18B20作为驱动（temp_driver.h）
+#if !TEST_MODE
+static uint8_t ds18b20_probe(void *context) {
+    (void)context;
+    temp_sensor_count = 0;
+    if (DS18B20_Init() != 0) {
+        return 0;
     }
     
-    // 开始温度转换
-    DS18B20_Start();
-    
-    // 等待转换完成（750ms）
-    osDelay(750);
-    
-    // 读取温度
-    short temp_raw = DS18B20_Get_Temp();
-    if (temp_raw == -1000) {
-        return -999.0f; // 读取失败
+    // 搜索失败但有存在脉冲时按单个传感器处理（跳过ROM）
+    temp_sensor_count = DS18B20_Search(temp_sensor_roms, TEMP_MAX_SENSORS);
+    if (temp_sensor_count == 0) {
+        temp_sensor_count = 1;
     }
     
-    // 转换为浮点数（原始值是0.1°C单位）
-    return (float)temp_raw / 10.0f;
+    // 分辨率保存在传感器EEPROM中，上电后读回（以0号传感器为准）
+    uint8_t bits = DS18B20_Get_Resolution(temp_sensor_rom(0));
+    if (bits >= TEMP_RESOLUTION_MIN && bits <= TEMP_RESOLUTION_MAX) {
+        temp_resolution = bits;
+    }
+    return temp_sensor_count;
 }
 
-bool temperature_is_sensor_ok(void) {
-    return (DS18B20_Check() == 0);
+static bool ds18b20_start(void *context, uint32_t *remaining_ms) {
+    (void)context;
+    return temperature_start_conversion(remaining_ms);
 }
 
-// RTC功能实现
-bool rtc_is_initialized(void) {
-    // 简单检查RTC是否初始化
-    return (hrtc.Instance != NULL);
+static bool ds18b20_poll(void *context) {
+    (void)context;
+    return temperature_conversion_done();
 }
 
-bool rtc_get_date(RTCDate *date) {
-    if (!rtc_is_initialized() || !date) {
-        return false;
-    }
+static int16_t ds18b20_read(void *context, uint8_t channel) {
+    (void)context;
+    return temperature_read_conversion(channel);
+}
+
+static const TempDriver ds18b20_driver = {
+    .name = "ds18b20",
+    .probe = ds18b20_probe,
+    .start = ds18b20_start,
+    .poll = ds18b20_poll,
+    .read = ds18b20_read,
+};
+#endif
+
+bool temperature_sensor_init(void) {
+    memset(temp_sensor_health, 0, sizeof(temp_sensor_health));
+    
+    // 1-Wire总线排在最前，其他驱动（ADC热敏电阻、SPI热电偶等）在其后注册；
+    // 测试模式下脚本传感器代替DS18B20（test_mode.h）
+    temp_driver_reset();
+#if TEST_MODE
+    temp_driver_register(&test_script_driver, &test_mode_script);
+#else
+    temp_driver_register(&ds18b20_driver, NULL);
+#endif
+#if TEMP_ANALOG
+    temp_driver_register(&analog_temp_driver, NULL);
+#endif
+    temp_sensor_total = temp_driver_probe();
+    return temp_sensor_total > 0;
+}
+
+uint8_t temperature_sensor_count(void) {
+    return temp_sensor_total;
+}
+
+// 记录一次读取结果
+static void temperature_update_health(uint8_t sensor, bool ok) {
+    TempSensorHealth *health = &temp_sensor_health[sensor];
     
-    RTC_DateTypeDef rtc_date;
-    if (HAL_RTC_GetDate(&hrtc, &rtc_date, RTC_FORMAT_BIN) != HAL_OK) {
+    taskENTER_CRITICAL();
+    health->present = ok;
+    if (ok) {
+        health->consecutive_faults = 0;
+        health->last_seen_tick = HAL_GetTick();
+        health->seen_count++;
+    } else {
+        if (health->consecutive_faults < UINT16_MAX) {
+            health->consecutive_faults++;
+        }
+        health->fault_count++;
+    }
+    taskEXIT_CRITICAL();
+}
+
+bool temperature_get_health(uint8_t sensor, TempSensorHealth *health) {
+    if (sensor >= temp_sensor_total) {
         return false;
     }
-    
-    date->year = rtc_date.Year;
-    date->month = rtc_date.Month;
-    date->day = rtc_date.Date;
-    date->weekday = rtc_date.WeekDay;
-    
+    taskENTER_CRITICAL();
+    *health = temp_sensor_health[sensor];
+    taskEXIT_CRITICAL();
     return true;
 }
 
-bool rtc_set_date(const RTCDate *date) {
-    if (!rtc_is_initialized() || !date) {
+bool temperature_set_resolution(uint8_t bits) {
+    if (bits < TEMP_RESOLUTION_MIN || bits > TEMP_RESOLUTION_MAX ||
+        temp_conversion_state == TEMP_CONV_RUNNING || temp_sensor_count == 0) {
         return false;
     }
     
-    // 参数验证
-    if (date->year > 99 || date->month < 1 || date->month > 12 ||
-        date->day < 1 || date->day > 31 || date->weekday < 1 || date->weekday > 7) {
-        return false;
+    // 逐个写入并读回确认，所有传感器使用同一分辨率，共享一次广播转换
+    bool ok = true;
+    for (uint8_t i = 0; i < temp_sensor_count; i++) {
+        const uint8_t *rom = temp_sensor_rom(i);
+        if (DS18B20_Set_Resolution(rom, bits) != 0 || DS18B20_Get_Resolution(rom) != bits) {
+            ok = false;
+        }
     }
     
-    RTC_DateTypeDef rtc_date;
-    rtc_date.Year = date->year;
-    rtc_date.Month = date->month;
-    rtc_date.Date = date->day;
-    rtc_date.WeekDay = date->weekday;
-    
-    return (HAL_RTC_SetDate(&hrtc, &rtc_date, RTC_FORMAT_BIN) == HAL_OK);
+    // 部分失败时转换超时按较长的分辨率计算
+    if (ok || bits > temp_resolution) {
+        temp_resolution = bits;
+    }
+    return ok;
 }
 
-bool rtc_get_time(RTCTime *time) {
-    if (!rtc_is_initialized() || !time) {
-        return false;
+uint8_t temperature_get_resolution(void) {
+    return temp_resolution;
+}
+
+uint8_t temperature_sample_all(int16_t *temperatures) {
+    // 各驱动同时转换：DS18B20跳过ROM广播转换命令，阻塞到该分辨率的最长转换时间，
+    // 期间空闲任务可以进入低功耗模式（low_power.h），之后逐个匹配ROM读取暂存器；
+    // 无存在脉冲时全部记为失败
+    uint8_t count = temp_driver_sample(temperatures);
+    for (uint8_t i = 0; i < count; i++) {
+        temperature_update_health(i, temperatures[i] != TEMP_INVALID);
     }
-    
-    RTC_TimeTypeDef rtc_time;
-    if (HAL_RTC_GetTime(&hrtc, &rtc_time, RTC_FORMAT_BIN) != HAL_OK) {
-        return false;
+    return count;
+}
+
+int16_t temperature_get_current(void) {
+    int16_t temperatures[TEMP_MAX_SENSORS];
+    if (temperature_sample_all(temperatures) == 0) {
+        return TEMP_INVALID;
+    }
+    return temperatures[0];
+}
+
+bool temperature_start_conversion(uint32_t *remaining_ms) {
+    // 已在转换中则不重复启动，多个请求共享同一次转换
+    if (temp_conversion_state == TEMP_CONV_IDLE) {
+        // 转换命令本身带复位和存在检测，不再单独检测
+        if (DS18B20_Start() != 0) {
+            return false;
+        }
+        
+        temp_conversion_state = TEMP_CONV_RUNNING;
+        temp_conversion_start = HAL_GetTick();
     }
     
-    time->hour = rtc_time.Hours;
-    time->minute = rtc_time.Minutes;
-    time->second = rtc_time.Seconds;
-    
+    if (remaining_ms) {
+        uint32_t elapsed = HAL_GetTick() - temp_conversion_start;
+        if (temp_conversion_state == TEMP_CONV_DONE || elapsed >= TEMP_CONVERSION_TIME_MS) {
+            *remaining_ms = 0;
+        } else {
+            *remaining_ms = TEMP_CONVERSION_TIME_MS - elapsed;
+        }
+    }
     return true;
 }
 
-bool rtc_set_time(const RTCTime *time) {
-    if (!rtc_is_initialized() || !time) {
-        return false;
+bool temperature_conversion_done(void) {
+    if (temp_conversion_state != TEMP_CONV_RUNNING) {
+        return true;
     }
     
-    // 参数验证
-    if (time->hour > 23 || time->minute > 59 || time->second > 59) {
-        return false;
+    // 读时隙回1表示转换完成（多个传感器时所有传感器都完成才为1）；
+    // 超时后同样结束，由读取结果判断是否有效
+    if (DS18B20_Read_Bit() ||
+        HAL_GetTick() - temp_conversion_start >= TEMP_CONVERSION_TIME_MS) {
+        temp_conversion_state = TEMP_CONV_DONE;
+        return true;
     }
-    
-    RTC_TimeTypeDef rtc_time;
-    rtc_time.Hours = time->hour;
-    rtc_time.Minutes = time->minute;
-    rtc_time.Seconds = time->second;
-    
-    return (HAL_RTC_SetTime(&hrtc, &rtc_time, RTC_FORMAT_BIN) == HAL_OK);
+    return false;
 }
 
-uint64_t rtc_get_timestamp(void) {
-    if (!rtc_is_initialized()) {
-        return 0;
+int16_t temperature_read_conversion(uint8_t sensor) {
+    // 转换结果保留在暂存器中，共享同一次转换的请求可重复读取
+    temp_conversion_state = TEMP_CONV_IDLE;
+    if (sensor >= temp_sensor_count) {
+        return TEMP_INVALID;
     }
     
-    RTCDate date;
-    RTCTime time;
-    
-    if (!rtc_get_date(&date) || !rtc_get_time(&time)) {
-        return 0;
+    // 读取温度
+    int16_t raw = DS18B20_Get_Temp_Raw(temp_sensor_rom(sensor));
+    if (raw == DS18B20_TEMP_INVALID_RAW) {
+        return TEMP_INVALID; // 读取失败
     }
     
-    // 简单的时间戳计算（从2000年开始）
-    // 这里可以实现更精确的时间戳转换
-    uint64_t timestamp = 0;
+    // 1/16°C换算为0.1°C
+    return DS18B20_Raw_To_Deci(raw);
+}
+
+bool temperature_is_sensor_ok(void) {
+    // 只读缓存的健康状态，不访问总线
+    for (uint8_t i = 0; i < temp_sensor_total; i++) {
+        if (temp_sensor_health[i].present) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 温度日志系统实现：记录保存在闪存中（log_store），复位后仍然保留
+// 每小时汇总的累加器：只由记录任务修改，查询时在临界段中复制；
+// 进入下一小时时写入汇总流，复位后由temp_log_recover_rollups()从原始记录恢复
+#define ROLLUP_APPEND_RETRIES  20   // 待写队列满时等待存储任务写入闪存
+#define ROLLUP_APPEND_DELAY_MS 100
+static TempLogSummary rollup_current[TEMP_MAX_SENSORS];
+
+void temp_log_init(void) {
+    log_store_init();
+    memset(rollup_current, 0, sizeof(rollup_current));
+}
+
+static void summary_merge(TempLogSummary *total, const TempLogSummary *part) {
+    if (total->count == 0) {
+        uint32_t time = total->time;
+        *total = *part;
+        total->time = time;
+        return;
+    }
+    if (part->min < total->min) {
+        total->min = part->min;
+    }
+    if (part->max > total->max) {
+        total->max = part->max;
+    }
+    total->count += part->count;
+    total->sum += part->sum;
+}
+
+static void rollup_add(uint8_t sensor, uint32_t timestamp, int16_t temperature) {
+    uint32_t hour = timestamp - timestamp % TEMP_LOG_ROLLUP_SECONDS;
+    TempLogSummary *current = &rollup_current[sensor];
     
-    // 年份转换（以2000年为基准）
-    timestamp += (uint64_t)(date.year + 2000 - 2000) * 365 * 24 * 3600;
+    if (current->count > 0 && current->time != hour) {
+        LogRollupPayload rollup = {
+            .min = current->min,
+            .max = current->max,
+            .count = (uint16_t)(current->count > UINT16_MAX ? UINT16_MAX : current->count),
+            .sum = current->sum,
+            .sensor = sensor,
+        };
+        // 补齐汇总时一次写入较多，队列满时稍等
+        for (int i = 0; i < ROLLUP_APPEND_RETRIES &&
+                        !log_store_append(LOG_STREAM_ROLLUPS, current->time * 1000ULL, &rollup); i++) {
+            osDelay(ROLLUP_APPEND_DELAY_MS);
+        }
+        taskENTER_CRITICAL();
+        current->count = 0;
+        taskEXIT_CRITICAL();
+    }
     
-    // 月份转换（简化处理）
-    const uint8_t days_in_month[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-    for (uint8_t i = 1; i < date.month; i++) {
-        timestamp += days_in_month[i - 1] * 24 * 3600;
+    TempLogSummary sample = { hour, temperature, temperature, 1, temperature };
+    taskENTER_CRITICAL();
+    current->time = hour;
+    summary_merge(current, &sample);
+    taskEXIT_CRITICAL();
+}
+
+void temp_log_add_entry(uint8_t sensor, int16_t temperature, int16_t raw) {
+    uint64_t timestamp_ms = rtc_get_timestamp_ms();
+    LogCompressPoint point = { timestamp_ms, temperature, raw };
+    LogCompressPoint points[LOG_COMPRESS_MAX_POINTS];
+    uint8_t count = log_compress_feed(sensor, &point, points);
+    for (uint8_t i = 0; i < count; i++) {
+        LogSamplePayload sample = {
+            .temperature = points[i].temperature,
+            .raw = points[i].raw,
+            .sensor = sensor,
+        };
+        log_store_append(LOG_STREAM_SAMPLES, points[i].timestamp_ms, &sample);
     }
     
-    // 日期转换
-    timestamp += (date.day - 1) * 24 * 3600;
+    // 汇总按每个读数统计，不受压缩影响
+    if (sensor < TEMP_MAX_SENSORS) {
+        rollup_add(sensor, (uint32_t)(timestamp_ms / 1000U), temperature);
+    }
+}
+
+void temp_log_recover_rollups(void) {
+    // 各传感器下一个需要汇总的小时（汇总按写入顺序，以最后一条为准）
+    uint32_t next_hour[TEMP_MAX_SENSORS] = { 0 };
+    LogStoreIter iter;
+    uint64_t timestamp_ms;
+    LogRollupPayload rollup;
+    log_store_iter_begin(&iter, LOG_STREAM_ROLLUPS);
+    while (log_store_iter_next(&iter, &timestamp_ms, &rollup)) {
+        if (rollup.sensor < TEMP_MAX_SENSORS) {
+            next_hour[rollup.sensor] = (uint32_t)(timestamp_ms / 1000U) + TEMP_LOG_ROLLUP_SECONDS;
+        }
+    }
     
-    // 时间转换
-    timestamp += time.hour * 3600 + time.minute * 60 + time.second;
+    uint32_t start = next_hour[0];
+    for (uint8_t s = 1; s < TEMP_MAX_SENSORS; s++) {
+        if (next_hour[s] < start) {
+            start = next_hour[s];
+        }
+    }
     
-    return timestamp;
+    // 重新统计之后的原始记录，小时变化时rollup_add()写入汇总，最后留下当前小时
+    LogSamplePayload sample;
+    log_store_seek(&iter, LOG_STREAM_SAMPLES, start * 1000ULL);
+    while (log_store_iter_next(&iter, &timestamp_ms, &sample)) {
+        uint32_t timestamp = (uint32_t)(timestamp_ms / 1000U);
+        if (sample.sensor < TEMP_MAX_SENSORS && timestamp >= next_hour[sample.sensor]) {
+            rollup_add(sample.sensor, timestamp, sample.temperature);
+        }
+    }
 }
 
-// 报警系统实现
-void alarm_init(void) {
-    // 初始化报警配置
-    for (int i = 0; i < MAX_ALARMS; i++) {
-        g_alarm_configs[i].id = i;
-        g_alarm_configs[i].low_temp = -40.0f;   // 默认下限
-        g_alarm_configs[i].high_temp = 80.0f;   // 默认上限
-    }
+static void query_resume(TempLogQuery *query, uint8_t stream, uint8_t sensor,
+                         uint32_t cursor, uint64_t end_time) {
+    query->sensor = sensor;
+    query->start_time = 0;
+    query->end_time = end_time > UINT32_MAX ? UINT32_MAX : (uint32_t)end_time;
+    query->filter_raw = false;
+    query->low = INT16_MIN;
+    query->high = INT16_MAX;
+    log_store_iter_resume(&query->iter, stream, cursor);
+}
+
+static uint32_t next_sequence(uint8_t stream) {
+    LogStoreIter end = { .stream = stream, .pages_left = 0 };
+    return log_store_iter_position(&end);
 }
 
-void alarm_set_config(uint8_t alarm_id, float low_temp, float high_temp) {
-    if (alarm_id < MAX_ALARMS) {
-        g_alarm_configs[alarm_id].low_temp = low_temp;
-        g_alarm_configs[alarm_id].high_temp = high_temp;
+static void query_begin(TempLogQuery *query, uint8_t stream, uint8_t sensor,
+                        uint64_t start_time, uint64_t end_time) {
+    query->sensor = sensor;
+    query->start_time = start_time > UINT32_MAX ? UINT32_MAX : (uint32_t)start_time;
+    query->end_time = end_time > UINT32_MAX ? UINT32_MAX : (uint32_t)end_time;
+    query->filter_raw = false;
+    query->low = INT16_MIN;
+    query->high = INT16_MAX;
+    
+    if (start_time > end_time || start_time > UINT32_MAX) {
+        query->iter.stream = stream;
+        query->iter.pages_left = 0; // 空范围
+        return;
     }
+    log_store_seek(&query->iter, stream, query->start_time * 1000ULL);
+}
+
+void temp_log_query_begin(TempLogQuery *query, uint8_t sensor, uint64_t start_time, uint64_t end_time) {
+    query_begin(query, LOG_STREAM_SAMPLES, sensor, start_time, end_time);
 }
 
-void alarm_get_config(uint8_t alarm_id, AlarmConfig *config) {
-    if (alarm_id < MAX_ALARMS && config) {
-        *config = g_alarm_configs[alarm_id];
+void temp_log_query_resume(TempLogQuery *query, uint8_t sensor, uint32_t cursor, uint64_t end_time) {
+    query_resume(query, LOG_STREAM_SAMPLES, sensor, cursor, end_time);
+}
+
+void temp_log_query_latest(TempLogQuery *query, uint8_t sensor, uint16_t count, uint64_t end_time) {
+    LogStoreIter iter;
+    uint64_t timestamp_ms;
+    LogSamplePayload sample;
+    uint32_t cursor = 0;
+    bool found = false;
+    log_store_iter_end(&iter, LOG_STREAM_SAMPLES);
+    while (count > 0 && log_store_iter_prev(&iter, &timestamp_ms, &sample)) {
+        if (sample.sensor == sensor && timestamp_ms / 1000U <= end_time) {
+            cursor = log_store_iter_position(&iter);
+            found = true;
+            count--;
+        }
+    }
+    
+    query_resume(query, LOG_STREAM_SAMPLES, sensor, cursor, end_time);
+    if (!found) {
+        query->iter.pages_left = 0; // 没有记录
     }
 }
 
-void alarm_check_temperature(float temperature) {
-    // 检查所有报警配置
-    for (int i = 0; i < MAX_ALARMS; i++) {
-        if (temperature < g_alarm_configs[i].low_temp || 
-            temperature > g_alarm_configs[i].high_temp) {
-            
-            // 触发报警
-            if (g_alarm_configs[i].id == 0) {
-                // ID 0 = 蜂鸣器
-                buzzer_beep(1000); // 蜂鸣1秒
-            } else if (g_alarm_configs[i].id == 1) {
-                // ID 1 = LED
-                led_on();
-            }
+uint32_t temp_log_next_sequence(void) {
+    return next_sequence(LOG_STREAM_SAMPLES);
+}
+
+bool temp_log_archive_ready(void) {
+#if LOG_ARCHIVE_SD
+    return log_archive_ready();
+#else
+    return false;
+#endif
+}
+
+// 没有归档时调用方已先检查temp_log_archive_ready()，退回闪存中的记录
+#if LOG_ARCHIVE_SD
+#define TEMP_LOG_ARCHIVE_STREAM LOG_STREAM_ARCHIVE
+#else
+#define TEMP_LOG_ARCHIVE_STREAM LOG_STREAM_SAMPLES
+#endif
+
+void temp_log_archive_begin(TempLogQuery *query, uint8_t sensor, uint64_t start_time, uint64_t end_time) {
+    query_begin(query, TEMP_LOG_ARCHIVE_STREAM, sensor, start_time, end_time);
+}
+
+void temp_log_archive_resume(TempLogQuery *query, uint8_t sensor, uint32_t cursor, uint64_t end_time) {
+    query_resume(query, TEMP_LOG_ARCHIVE_STREAM, sensor, cursor, end_time);
+}
+
+void temp_log_query_filter(TempLogQuery *query, int16_t low, int16_t high, bool raw) {
+    query->filter_raw = raw;
+    query->low = low;
+    query->high = high;
+    log_store_iter_filter(&query->iter, low, high);
+}
+
+bool temp_log_query_next(TempLogQuery *query, TempLogEntry *entry) {
+    uint64_t timestamp_ms;
+    LogSamplePayload sample;
+    uint16_t skipped = query->iter.skipped;
+    
+    query->gap = false;
+    while (log_store_iter_next(&query->iter, &timestamp_ms, &sample)) {
+        if (query->iter.skipped != skipped) {
+            skipped = query->iter.skipped;
+            query->gap = true;
+        }
+        uint32_t timestamp = (uint32_t)(timestamp_ms / 1000U);
+        if (timestamp > query->end_time) {
+            query->iter.pages_left = 0; // 记录按时间顺序，之后都超出范围
+            return false;
         }
+        if (sample.sensor != query->sensor || timestamp < query->start_time) {
+            continue;
+        }
+        int16_t value = query->filter_raw ? sample.raw : sample.temperature;
+        if (value < query->low || value > query->high) {
+            query->gap = true;
+            continue;
+        }
+        entry->timestamp = timestamp;
+        entry->millisecond = (uint16_t)(timestamp_ms % 1000U);
+        entry->sequence = log_store_iter_position(&query->iter) - 1;
+        entry->temperature = sample.temperature;
+        entry->raw = sample.raw;
+        entry->sensor = sample.sensor;
+        return true;
     }
+    if (query->iter.skipped != skipped) {
+        query->gap = true;
+    }
+    return false;
 }
 
-void alarm_reset_all(void) {
-    led_off();
-    buzzer_off();
+void alarm_event_query_begin(TempLogQuery *query, uint64_t start_time, uint64_t end_time) {
+    query_begin(query, LOG_STREAM_EVENTS, 0, start_time, end_time);
 }
 
-// 温度日志系统实现
-void temp_log_init(void) {
-    g_log_count = 0;
-    g_log_write_index = 0;
-    memset(g_temp_log, 0, sizeof(g_temp_log));
+void alarm_event_query_resume(TempLogQuery *query, uint32_t cursor, uint64_t end_time) {
+    query_resume(query, LOG_STREAM_EVENTS, 0, cursor, end_time);
 }
 
-void temp_log_add_entry(float temperature) {
-    uint64_t timestamp = rtc_get_timestamp();
+bool alarm_event_query_next(TempLogQuery *query, AlarmEvent *event) {
+    uint64_t timestamp_ms;
+    LogEventPayload payload;
     
-    // 添加日志条目
-    g_temp_log[g_log_write_index].timestamp = timestamp;
-    g_temp_log[g_log_write_index].temperature = temperature;
+    while (log_store_iter_next(&query->iter, &timestamp_ms, &payload)) {
+        uint32_t timestamp = (uint32_t)(timestamp_ms / 1000U);
+        if (timestamp > query->end_time) {
+            query->iter.pages_left = 0;
+            return false;
+        }
+        if (timestamp >= query->start_time) {
+            event->timestamp = timestamp;
+            event->millisecond = (uint16_t)(timestamp_ms % 1000U);
+            event->sequence = log_store_iter_position(&query->iter) - 1;
+            event->channel = payload.channel;
+            event->type = payload.type;
+            event->sensor = payload.sensor;
+            event->temperature = payload.temperature;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t alarm_event_next_sequence(void) {
+    return next_sequence(LOG_STREAM_EVENTS);
+}
+
+void alarm_burst_query_begin(TempLogQuery *query, uint64_t start_time, uint64_t end_time) {
+    query_begin(query, LOG_STREAM_BURSTS, 0, start_time, end_time);
+}
+
+void alarm_burst_query_resume(TempLogQuery *query, uint32_t cursor, uint64_t end_time) {
+    query_resume(query, LOG_STREAM_BURSTS, 0, cursor, end_time);
+}
+
+// 按块号顺序拼合一条记录：各块的时间戳、规则和传感器须与第0块相同，缺块时丢弃已拼合的部分
+bool alarm_burst_query_next(TempLogQuery *query, AlarmBurst *burst) {
+    uint64_t timestamp_ms, burst_ms = 0;
+    LogBurstPayload payload;
+    uint8_t next = 0; // 下一块应有的块号，0表示还没有读到第0块
+    bool in_range = false;
     
-    // 更新索引
-    g_log_write_index = (g_log_write_index + 1) % MAX_LOG_ENTRIES;
+    while (log_store_iter_next(&query->iter, &timestamp_ms, &payload)) {
+        uint8_t index = payload.chunk & LOG_BURST_CHUNK_MASK;
+        if (index == 0) {
+            uint32_t timestamp = (uint32_t)(timestamp_ms / 1000U);
+            if (timestamp > query->end_time) {
+                query->iter.pages_left = 0;
+                return false;
+            }
+            in_range = timestamp >= query->start_time;
+            burst_ms = timestamp_ms;
+            burst->timestamp = timestamp;
+            burst->millisecond = (uint16_t)(timestamp_ms % 1000U);
+            burst->channel = payload.channel;
+            burst->type = (payload.chunk & LOG_BURST_ENTER) ? ALARM_EVENT_ENTER : ALARM_EVENT_LEAVE;
+            burst->sensor = payload.sensor;
+        } else if (index != next || index >= ALARM_BURST_CHUNKS || timestamp_ms != burst_ms ||
+                   payload.channel != burst->channel || payload.sensor != burst->sensor) {
+            next = 0;
+            continue;
+        }
+        memcpy(&burst->temperatures[index * LOG_BURST_CHUNK_SAMPLES], payload.temperatures,
+               sizeof(payload.temperatures));
+        next = index + 1U;
+        if ((payload.chunk & LOG_BURST_LAST) != 0) {
+            if (next == ALARM_BURST_CHUNKS && in_range) {
+                return true;
+            }
+            next = 0;
+        }
+    }
+    return false;
+}
+
+void temp_log_aggregate_begin(TempLogAggregate *aggregate, uint8_t sensor, uint64_t start_time,
+                              uint64_t end_time, uint32_t width, bool raw) {
+    aggregate->width = (width != 0) ? width : 1;
+    aggregate->raw = raw;
+    aggregate->rollups = !raw && aggregate->width % TEMP_LOG_ROLLUP_SECONDS == 0;
+    aggregate->live_pending = aggregate->rollups;
+    aggregate->has_carry = false;
     
-    // 更新计数
-    if (g_log_count < MAX_LOG_ENTRIES) {
-        g_log_count++;
+    if (aggregate->rollups) {
+        // 汇总的时间戳为小时起点，起始时间所在的小时也计入
+        query_begin(&aggregate->query, LOG_STREAM_ROLLUPS, sensor,
+                    start_time - start_time % TEMP_LOG_ROLLUP_SECONDS, end_time);
+    } else {
+        query_begin(&aggregate->query, LOG_STREAM_SAMPLES, sensor, start_time, end_time);
     }
 }
 
-uint32_t temp_log_get_entries(uint64_t start_time, uint64_t end_time, 
-                             TempLogEntry *entries, uint32_t max_entries) {
-    if (!entries || max_entries == 0) {
-        return 0;
+// 读取下一段统计：一条记录，或一小时的汇总（汇总流读完后是当前小时的累加器）
+static bool aggregate_read(TempLogAggregate *aggregate, TempLogSummary *part) {
+    TempLogQuery *query = &aggregate->query;
+    
+    if (!aggregate->rollups) {
+        TempLogEntry entry;
+        if (!temp_log_query_next(query, &entry)) {
+            return false;
+        }
+        int16_t temperature = aggregate->raw ? entry.raw : entry.temperature;
+        *part = (TempLogSummary){ entry.timestamp, temperature, temperature, 1, temperature };
+        return true;
     }
     
-    uint32_t found_count = 0;
-    uint32_t read_index = (g_log_write_index + MAX_LOG_ENTRIES - g_log_count) % MAX_LOG_ENTRIES;
+    uint64_t timestamp_ms;
+    LogRollupPayload rollup;
+    while (log_store_iter_next(&query->iter, &timestamp_ms, &rollup)) {
+        uint32_t timestamp = (uint32_t)(timestamp_ms / 1000U);
+        if (timestamp > query->end_time) {
+            query->iter.pages_left = 0;
+            break;
+        }
+        if (rollup.sensor == query->sensor && timestamp >= query->start_time && rollup.count > 0) {
+            *part = (TempLogSummary){ timestamp, rollup.min, rollup.max, rollup.count, rollup.sum };
+            return true;
+        }
+    }
+    
+    if (aggregate->live_pending && query->sensor < TEMP_MAX_SENSORS) {
+        aggregate->live_pending = false;
+        taskENTER_CRITICAL();
+        *part = rollup_current[query->sensor];
+        taskEXIT_CRITICAL();
+        return part->count > 0 && part->time >= query->start_time && part->time <= query->end_time;
+    }
+    return false;
+}
+
+bool temp_log_aggregate_next(TempLogAggregate *aggregate, TempLogBucket *bucket) {
+    TempLogSummary total = { 0 };
+    TempLogSummary part;
     
-    // 遍历所有日志条目
-    for (uint32_t i = 0; i < g_log_count && found_count < max_entries; i++) {
-        uint32_t current_index = (read_index + i) % MAX_LOG_ENTRIES;
+    for (;;) {
+        if (aggregate->has_carry) {
+            part = aggregate->carry;
+            aggregate->has_carry = false;
+        } else if (!aggregate_read(aggregate, &part)) {
+            break;
+        }
         
-        if (g_temp_log[current_index].timestamp >= start_time && 
-            g_temp_log[current_index].timestamp <= end_time) {
-            entries[found_count] = g_temp_log[current_index];
-            found_count++;
+        uint32_t start = part.time - part.time % aggregate->width;
+        if (total.count != 0 && start != total.time) {
+            aggregate->carry = part; // 属于下一个桶
+            aggregate->has_carry = true;
+            break;
         }
+        total.time = start;
+        summary_merge(&total, &part);
+    }
+    
+    if (total.count == 0) {
+        return false;
     }
     
-    return found_count;
+    int32_t half = (int32_t)(total.count / 2);
+    bucket->start = total.time;
+    bucket->min = total.min;
+    bucket->max = total.max;
+    bucket->mean = (int16_t)((total.sum + (total.sum < 0 ? -half : half)) / (int32_t)total.count);
+    bucket->count = total.count;
+    return true;
 }
 
 void temp_log_clear(void) {
-    temp_log_init();
+    log_store_clear();
 }
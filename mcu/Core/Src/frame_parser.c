@@ -0,0 +1,349 @@
+#include "frame_parser.h"
+#include <string.h>
+#include <stddef.h>
+
+#define FRAME_HEADER_SIZE  sizeof(PacketHeader)
+#define FRAME_CRC_SIZE     sizeof(uint32_t)
+#define FRAME_ADDRESS_END  (offsetof(PacketHeader, address) + 1)
+
+static inline bool is_mark_byte(uint8_t byte) {
+    return byte == 0xAA || byte == 0x55;
+}
+
+// 地址不符：本帧余下的字节只用于寻找帧尾
+static void skip_frame(FrameParser *parser) {
+    parser->skipped++;
+    parser->pending = 0;
+    parser->state = (parser->state == FRAME_STATE_COBS) ? FRAME_STATE_COBS_SKIP : FRAME_STATE_SKIP;
+}
+
+static bool address_accepted(const FrameParser *parser) {
+    if (parser->address == PROTOCOL_ADDRESS_NONE) {
+        return true;
+    }
+    const PacketHeader *header = frame_parser_header(parser);
+    return (header->version & PROTOCOL_VERSION_ADDRESSED) != 0 && header->address == parser->address &&
+           header->address <= PROTOCOL_ADDRESS_MAX;
+}
+
+// 写入一个去转义后的字节：版本到达时检查组帧方式，地址到达时过滤，包头收齐时检查长度
+static FrameResult store_byte(FrameParser *parser, uint8_t byte) {
+    if (parser->expected != 0 && parser->pos >= parser->expected) {
+        return FRAME_RESULT_FORMAT_ERROR; // 数据超出包头声明的长度
+    }
+    if (parser->pos >= parser->capacity) {
+        return FRAME_RESULT_FORMAT_ERROR; // 缓冲区溢出
+    }
+
+    // CRC覆盖包头和数据，不包括末尾的CRC字段
+    if (parser->expected == 0 || parser->pos < parser->expected - FRAME_CRC_SIZE) {
+        crc32_update_byte(&parser->crc, byte);
+    }
+    parser->buffer[parser->pos++] = byte;
+
+    if (parser->pos == 1 && parser->state == FRAME_STATE_COBS && byte == PROTOCOL_VERSION_STREAM) {
+        parser->stream = parser->accept_streams;
+        return parser->stream ? FRAME_RESULT_NONE : FRAME_RESULT_FORMAT_ERROR;
+    }
+    if (parser->stream) {
+        return FRAME_RESULT_NONE; // 流帧没有包头，长度由分隔符确定
+    }
+
+    if (parser->pos == 1) {
+        uint8_t framing = (parser->state == FRAME_STATE_COBS) ? PROTOCOL_VERSION_COBS : PROTOCOL_VERSION;
+        if (PROTOCOL_FRAMING(byte) != framing) {
+            return FRAME_RESULT_FORMAT_ERROR;
+        }
+        // 不带地址的版本：补上地址字段（不在线路上，不计入CRC），包头布局与带地址时相同
+        if ((byte & PROTOCOL_VERSION_ADDRESSED) == 0) {
+            parser->buffer[parser->pos++] = PROTOCOL_ADDRESS_NONE;
+        }
+    }
+
+    if (parser->pos == FRAME_ADDRESS_END && !address_accepted(parser)) {
+        skip_frame(parser);
+        return FRAME_RESULT_NONE;
+    }
+
+    if (parser->pos == FRAME_HEADER_SIZE) {
+        const PacketHeader *header = frame_parser_header(parser);
+        uint32_t total = FRAME_HEADER_SIZE + header->data_length + FRAME_CRC_SIZE;
+        if (total > parser->capacity) {
+            return FRAME_RESULT_FORMAT_ERROR;
+        }
+        parser->expected = (uint16_t)total;
+    }
+
+    return FRAME_RESULT_NONE;
+}
+
+// 结束符到达：检查长度并校验CRC
+static FrameResult finish_frame(FrameParser *parser) {
+    if (parser->stream) {
+        if (parser->pos < STREAM_FRAME_HEADER_SIZE + STREAM_FRAME_CRC_SIZE) {
+            return FRAME_RESULT_FORMAT_ERROR;
+        }
+        uint16_t crc_offset = parser->pos - STREAM_FRAME_CRC_SIZE;
+        uint16_t received_crc = (uint16_t)(parser->buffer[crc_offset] | (parser->buffer[crc_offset + 1] << 8));
+        return calculate_crc16(CRC16_INIT, parser->buffer, crc_offset) == received_crc ?
+               FRAME_RESULT_STREAM : FRAME_RESULT_CRC_ERROR;
+    }
+    if (parser->expected == 0 || parser->pos != parser->expected) {
+        return FRAME_RESULT_FORMAT_ERROR;
+    }
+
+    uint16_t crc_offset = parser->pos - FRAME_CRC_SIZE;
+    uint32_t received_crc;
+    memcpy(&received_crc, parser->buffer + crc_offset, sizeof(received_crc));
+
+    if (crc32_final(&parser->crc) != received_crc) {
+        return FRAME_RESULT_CRC_ERROR;
+    }
+
+    return FRAME_RESULT_OK;
+}
+
+// 开始接收新帧
+static void begin_frame(FrameParser *parser, FrameState state) {
+    parser->pos = 0;
+    parser->expected = 0;
+    parser->pending = 0;
+    parser->cobs_code = 0;
+    parser->cobs_left = 0;
+    parser->stream = false;
+    crc32_init(&parser->crc);
+    parser->state = state;
+}
+
+// 寻找起始符：0xAA 0x55开始转义帧，0x00开始COBS帧
+// 出错时也从出错字节重新寻找，使紧随其后的下一帧不受影响
+static void hunt(FrameParser *parser, uint8_t byte) {
+    if (byte == START_MARK_1) {
+        parser->state = FRAME_STATE_START;
+    } else if (byte == COBS_DELIMITER) {
+        parser->state = FRAME_STATE_COBS_OPEN;
+    } else {
+        parser->state = FRAME_STATE_HUNT;
+    }
+}
+
+// 放弃未完成的帧，从byte重新寻找起始符
+static void resync(FrameParser *parser, uint8_t byte) {
+    parser->resyncs++;
+    hunt(parser, byte);
+}
+
+// 跳过转义帧：帧体中的0xAA/0x55之后只能是转义字节或结束符，不必去转义即可找到帧尾；
+// 遇到起始符说明该帧不完整、下一帧已经开始
+static void skip_escaped(FrameParser *parser, uint8_t byte) {
+    if (parser->pending == 0) {
+        if (is_mark_byte(byte)) {
+            parser->pending = byte;
+        }
+        return;
+    }
+    
+    uint8_t pending = parser->pending;
+    parser->pending = 0;
+    switch (frame_classify_pair(pending, byte)) {
+    case FRAME_PAIR_ESCAPED:
+        break;
+    case FRAME_PAIR_END:
+        parser->state = FRAME_STATE_HUNT;
+        break;
+    case FRAME_PAIR_START:
+        parser->state = FRAME_STATE_OPEN;
+        break;
+    case FRAME_PAIR_INVALID:
+    default:
+        resync(parser, byte);
+        break;
+    }
+}
+
+// COBS帧体：编码字节给出下一个0x00之前的数据字节数（0xFF表示254字节且其后无0x00）
+static FrameResult feed_cobs(FrameParser *parser, uint8_t byte) {
+    if (byte == COBS_DELIMITER) {
+        // 分隔符同时是下一帧的起点
+        parser->state = FRAME_STATE_COBS_OPEN;
+        if (parser->cobs_left != 0) {
+            return FRAME_RESULT_FORMAT_ERROR; // 块未完整
+        }
+        return finish_frame(parser);
+    }
+    
+    FrameResult result = FRAME_RESULT_NONE;
+    if (parser->cobs_left > 0) {
+        parser->cobs_left--;
+        result = store_byte(parser, byte);
+    } else {
+        // 新块开始：上一个非满块之后隐含一个0x00，编码字节代替了它，其余编码字节是开销
+        if (parser->cobs_code != 0 && parser->cobs_code != 0xFF) {
+            result = store_byte(parser, 0x00);
+        } else {
+            parser->unstuffed++;
+        }
+        parser->cobs_code = byte;
+        parser->cobs_left = byte - 1;
+    }
+    
+    if (result != FRAME_RESULT_NONE) {
+        resync(parser, byte);
+    }
+    return result;
+}
+
+void frame_parser_init(FrameParser *parser, uint8_t *buffer, uint16_t capacity) {
+    parser->buffer = buffer;
+    parser->capacity = capacity;
+    parser->unstuffed = 0;
+    parser->resyncs = 0;
+    parser->skipped = 0;
+    parser->address = PROTOCOL_ADDRESS_NONE;
+    parser->accept_streams = false;
+    frame_parser_reset(parser);
+}
+
+void frame_parser_accept_streams(FrameParser *parser, bool accept) {
+    parser->accept_streams = accept;
+}
+
+void frame_parser_set_address(FrameParser *parser, uint8_t address) {
+    parser->address = address;
+}
+
+void frame_parser_reset(FrameParser *parser) {
+    parser->pos = 0;
+    parser->expected = 0;
+    parser->state = FRAME_STATE_HUNT;
+    parser->pending = 0;
+    parser->cobs_code = 0;
+    parser->cobs_left = 0;
+    parser->stream = false;
+}
+
+// 帧结束后解析器处于寻找起始符或新帧开头（COBS的0x00同时开始下一帧），
+// 下一帧从缓冲区开头写起，此时换缓冲区不影响解析状态
+void frame_parser_set_buffer(FrameParser *parser, uint8_t *buffer) {
+    parser->buffer = buffer;
+    parser->pos = 0;
+    parser->expected = 0;
+}
+
+FrameResult frame_parser_feed(FrameParser *parser, uint8_t byte) {
+    FrameResult result = FRAME_RESULT_NONE;
+
+    switch (parser->state) {
+    case FRAME_STATE_HUNT:
+        hunt(parser, byte);
+        return FRAME_RESULT_NONE;
+
+    case FRAME_STATE_START:
+        if (byte == START_MARK_2) {
+            parser->state = FRAME_STATE_OPEN;
+        } else {
+            hunt(parser, byte);
+        }
+        return FRAME_RESULT_NONE;
+
+    case FRAME_STATE_COBS_OPEN:
+        if (byte == COBS_DELIMITER) {
+            return FRAME_RESULT_NONE; // 连续分隔符
+        }
+        begin_frame(parser, FRAME_STATE_COBS);
+        return feed_cobs(parser, byte);
+
+    case FRAME_STATE_COBS:
+        if (parser->pos == 0 &&
+            (parser->cobs_left == 0 || (PROTOCOL_FRAMING(byte) != PROTOCOL_VERSION_COBS &&
+                                        !(parser->accept_streams && byte == PROTOCOL_VERSION_STREAM)))) {
+            // 分隔符后的第一个数据字节不是COBS版本号：多半是线路噪声中的0x00，
+            // 回到寻找起始符，重新检查编码字节和当前字节（可能是转义帧的起始符）
+            resync(parser, parser->cobs_code);
+            return frame_parser_feed(parser, byte);
+        }
+        return feed_cobs(parser, byte);
+
+    case FRAME_STATE_SKIP:
+        skip_escaped(parser, byte);
+        return FRAME_RESULT_NONE;
+
+    case FRAME_STATE_COBS_SKIP:
+        if (byte == COBS_DELIMITER) {
+            parser->state = FRAME_STATE_COBS_OPEN; // 分隔符同时是下一帧的起点
+        }
+        return FRAME_RESULT_NONE;
+
+    case FRAME_STATE_OPEN:
+        begin_frame(parser, FRAME_STATE_BODY);
+        break;
+
+    case FRAME_STATE_BODY:
+    default:
+        break;
+    }
+
+    if (parser->pending == 0) {
+        if (is_mark_byte(byte)) {
+            // 0xAA/0x55后面必须跟转义字节，或组成结束符，暂存等待下一字节
+            parser->pending = byte;
+            return FRAME_RESULT_NONE;
+        }
+        result = store_byte(parser, byte);
+        if (result != FRAME_RESULT_NONE) {
+            resync(parser, byte);
+        }
+        return result;
+    }
+
+    uint8_t pending = parser->pending;
+    parser->pending = 0;
+
+    switch (frame_classify_pair(pending, byte)) {
+    case FRAME_PAIR_ESCAPED:
+        // 转义序列：pending为数据字节，去掉其后的转义字节
+        parser->unstuffed++;
+        result = store_byte(parser, pending);
+        if (result != FRAME_RESULT_NONE) {
+            parser->resyncs++;
+            parser->state = FRAME_STATE_HUNT;
+        }
+        return result;
+
+    case FRAME_PAIR_END:
+        parser->state = FRAME_STATE_HUNT;
+        return finish_frame(parser);
+
+    case FRAME_PAIR_START:
+        // 帧体中出现起始符：前一帧不完整，新帧已经开始
+        parser->resyncs++;
+        parser->state = FRAME_STATE_OPEN;
+        return FRAME_RESULT_FORMAT_ERROR;
+
+    case FRAME_PAIR_INVALID:
+    default:
+        // 未转义的0xAA/0x55：帧损坏，从当前字节重新寻找起始符
+        resync(parser, byte);
+        return FRAME_RESULT_FORMAT_ERROR;
+    }
+}
+
+bool frame_parser_has_header(const FrameParser *parser) {
+    return parser->expected != 0;
+}
+
+const PacketHeader *frame_parser_header(const FrameParser *parser) {
+    return (const PacketHeader *)parser->buffer;
+}
+
+const uint8_t *frame_parser_payload(const FrameParser *parser) {
+    return parser->buffer + FRAME_HEADER_SIZE;
+}
+
+const uint8_t *frame_parser_stream(const FrameParser *parser, uint8_t *stream_id, uint8_t *sequence,
+                                   uint16_t *length) {
+    *stream_id = parser->buffer[1];
+    *sequence = parser->buffer[2];
+    *length = (uint16_t)(parser->pos - STREAM_FRAME_HEADER_SIZE - STREAM_FRAME_CRC_SIZE);
+    return parser->buffer + STREAM_FRAME_HEADER_SIZE;
+}
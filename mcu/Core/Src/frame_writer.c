@@ -0,0 +1,208 @@
+#include "frame_writer.h"
+#include "ramfunc.h"
+#include <string.h>
+#include <stddef.h>
+
+// 执行任务和接收任务都会组帧，用原子加累计
+static uint32_t stuffed_total = 0;
+
+static inline void put_raw(FrameWriter *writer, uint8_t byte) {
+    if (writer->pos >= writer->capacity) {
+        writer->overflow = true;
+        return;
+    }
+    writer->buffer[writer->pos++] = byte;
+}
+
+static inline void put_block(FrameWriter *writer, const uint8_t *data, uint16_t length) {
+    if (length > writer->capacity - writer->pos) {
+        writer->overflow = true;
+        return;
+    }
+    memcpy(writer->buffer + writer->pos, data, length);
+    writer->pos += length;
+}
+
+// 转义并输出，可选累加CRC：按字扫描找到下一个需转义字节，之前的数据整段拷贝
+RAMFUNC static void put_escaped(FrameWriter *writer, const uint8_t *data, uint16_t length, bool update_crc) {
+    while (length > 0 && !writer->overflow) {
+        uint16_t run = (uint16_t)find_escape_byte(data, length);
+        if (run > 0) {
+            if (update_crc) {
+                crc32_update(&writer->crc, data, run);
+            }
+            put_block(writer, data, run);
+            data += run;
+            length -= run;
+        }
+        
+        if (length > 0) {
+            if (update_crc) {
+                crc32_update_byte(&writer->crc, *data);
+            }
+            put_raw(writer, *data);
+            put_raw(writer, ESCAPE_BYTE);
+            writer->stuffed++;
+            data++;
+            length--;
+        }
+    }
+}
+
+// 结束当前COBS块：回填编码字节并为下一块预留位置
+static inline void cobs_close_block(FrameWriter *writer) {
+    if (!writer->overflow) {
+        writer->buffer[writer->code_pos] = writer->code;
+    }
+    writer->code_pos = writer->pos;
+    writer->code = 1;
+    put_raw(writer, 0);
+}
+
+// COBS编码并输出：两个0x00之间（且不超过254字节）的数据整段拷贝
+static void put_cobs(FrameWriter *writer, const uint8_t *data, uint16_t length, bool update_crc) {
+    if (update_crc) {
+        crc32_update(&writer->crc, data, length);
+    }
+    
+    while (length > 0 && !writer->overflow) {
+        uint16_t room = 0xFF - writer->code;
+        uint16_t limit = length < room ? length : room;
+        const uint8_t *zero = (const uint8_t *)memchr(data, 0x00, limit);
+        uint16_t run = zero ? (uint16_t)(zero - data) : limit;
+        
+        put_block(writer, data, run);
+        writer->code += run;
+        data += run;
+        length -= run;
+        
+        if (zero) {
+            // 0x00本身由编码字节表示
+            data++;
+            length--;
+            cobs_close_block(writer);
+        } else if (writer->code == 0xFF) {
+            // 满块之后的编码字节不代表0x00
+            cobs_close_block(writer);
+            writer->stuffed++;
+        }
+    }
+}
+
+static inline void put_encoded(FrameWriter *writer, const uint8_t *data, uint16_t length, bool update_crc) {
+    if (writer->cobs) {
+        put_cobs(writer, data, length, update_crc);
+    } else {
+        put_escaped(writer, data, length, update_crc);
+    }
+}
+
+static void cobs_open(FrameWriter *writer) {
+    put_raw(writer, COBS_DELIMITER);
+    writer->code_pos = writer->pos;
+    writer->code = 1;
+    put_raw(writer, 0); // 编码字节占位
+    writer->stuffed++;  // 最后一块之后没有0x00，按开销计
+}
+
+// 回填最后一块的编码字节并写出结束符（或分隔符），计入统计
+static int close_frame(FrameWriter *writer) {
+    if (writer->cobs) {
+        if (!writer->overflow) {
+            writer->buffer[writer->code_pos] = writer->code;
+        }
+        put_raw(writer, COBS_DELIMITER);
+    } else {
+        put_raw(writer, END_MARK_1);
+        put_raw(writer, END_MARK_2);
+    }
+    
+    if (writer->overflow) {
+        return -1;
+    }
+    __atomic_fetch_add(&stuffed_total, writer->stuffed, __ATOMIC_RELAXED);
+    return writer->pos;
+}
+
+void frame_writer_begin(FrameWriter *writer, uint8_t *buffer, uint16_t capacity,
+                        const PacketHeader *header) {
+    writer->buffer = buffer;
+    writer->capacity = capacity;
+    writer->pos = 0;
+    writer->overflow = false;
+    writer->stuffed = 0;
+    writer->cobs = (PROTOCOL_FRAMING(header->version) == PROTOCOL_VERSION_COBS);
+    crc32_init(&writer->crc);
+    
+    if (writer->cobs) {
+        cobs_open(writer);
+    } else {
+        put_raw(writer, START_MARK_1);
+        put_raw(writer, START_MARK_2);
+    }
+    // 地址字段只在带地址的版本中写出
+    const uint8_t *bytes = (const uint8_t *)header;
+    put_encoded(writer, bytes, offsetof(PacketHeader, address), true);
+    if (header->version & PROTOCOL_VERSION_ADDRESSED) {
+        put_encoded(writer, &header->address, sizeof(header->address), true);
+    }
+    put_encoded(writer, bytes + offsetof(PacketHeader, type), sizeof(PacketHeader) - offsetof(PacketHeader, type), true);
+}
+
+void frame_writer_write(FrameWriter *writer, const uint8_t *data, uint16_t length) {
+    if (data && length > 0) {
+        put_encoded(writer, data, length, true);
+    }
+}
+
+int frame_writer_finish(FrameWriter *writer) {
+    uint32_t crc = crc32_final(&writer->crc);
+    put_encoded(writer, (const uint8_t *)&crc, sizeof(crc), false);
+    return close_frame(writer);
+}
+
+int frame_writer_stream(uint8_t *buffer, uint16_t capacity, uint8_t stream_id, uint8_t sequence,
+                        const uint8_t *payload, uint16_t length) {
+    if (length > STREAM_FRAME_MAX_PAYLOAD) {
+        return -1;
+    }
+    FrameWriter writer = {
+        .buffer = buffer,
+        .capacity = capacity,
+        .cobs = true,
+    };
+    cobs_open(&writer);
+    
+    const uint8_t header[STREAM_FRAME_HEADER_SIZE] = {PROTOCOL_VERSION_STREAM, stream_id, sequence};
+    uint16_t crc = calculate_crc16(CRC16_INIT, header, sizeof(header));
+    crc = calculate_crc16(crc, payload, length);
+    const uint8_t trailer[STREAM_FRAME_CRC_SIZE] = {(uint8_t)crc, (uint8_t)(crc >> 8)};
+    
+    put_cobs(&writer, header, sizeof(header), false);
+    put_cobs(&writer, payload, length, false);
+    put_cobs(&writer, trailer, sizeof(trailer), false);
+    return close_frame(&writer);
+}
+
+uint32_t frame_writer_stuffed_total(void) {
+    return __atomic_load_n(&stuffed_total, __ATOMIC_RELAXED);
+}
+
+void frame_writer_reset_stats(void) {
+    __atomic_store_n(&stuffed_total, 0, __ATOMIC_RELAXED);
+}
+
+uint16_t frame_escaped_length(const uint8_t *data, uint16_t length) {
+    uint16_t escaped = length;
+    
+    while (length > 0) {
+        uint16_t run = (uint16_t)find_escape_byte(data, length);
+        if (run >= length) {
+            break;
+        }
+        escaped++;
+        data += run + 1;
+        length -= run + 1;
+    }
+    return escaped;
+}
@@ -24,6 +24,7 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "timebase.h"
 
 /* USER CODE END Includes */
 
@@ -52,6 +53,40 @@
 
 /* USER CODE END FunctionPrototypes */
 
+/* Hook prototypes */
+void configureTimerForRunTimeStats(void);
+unsigned long getRunTimeCounterValue(void);
+void vApplicationIdleHook(void);
+
+/* USER CODE BEGIN 1 */
+/* Functions needed when configGENERATE_RUN_TIME_STATS is on */
+// 任务运行时间以micros()计（1MHz，约71.6分钟回绕）：每次切换任务读一次，
+// 不另占定时器；HAL毫秒数在睡眠和STOP后按实际时长补齐，空闲任务的时间包含睡眠时间
+void configureTimerForRunTimeStats(void)
+{
+  // timebase_init()和HAL时基在启动调度器之前已经初始化
+}
+
+unsigned long getRunTimeCounterValue(void)
+{
+  return micros();
+}
+/* USER CODE END 1 */
+
+/* USER CODE BEGIN 2 */
+void vApplicationIdleHook( void )
+{
+   /* vApplicationIdleHook() will only be called if configUSE_IDLE_HOOK is set
+   to 1 in FreeRTOSConfig.h. It will be called on each iteration of the idle
+   task. It is essential that code added to this hook function never attempts
+   to block in any way (for example, call xQueueReceive() with a block time
+   specified, or call vTaskDelay()). */
+
+   // 不在这里WFI：钩子在每次判断是否进入tickless空闲之前执行，
+   // 睡眠和STOP模式都由low_power_suppress_ticks()进入
+}
+/* USER CODE END 2 */
+
 /* Private application code --------------------------------------------------*/
 /* USER CODE BEGIN Application */
 
@@ -0,0 +1,214 @@
+#include "fw_update.h"
+
+#if FW_UPDATE
+
+#include "boot_slots.h"
+#include "config_store.h"
+#include "ramfunc.h"
+#include "main.h"
+#include <string.h>
+#include <assert.h>
+
+#if FW_SLOTS
+// A/B程序槽：暂存区为另一个槽，映像在该槽中运行
+#define FW_STAGING_BASE  (FW_SLOT_ID == BOOT_SLOT_A ? BOOT_SLOT_B_BASE : BOOT_SLOT_A_BASE)
+#define FW_STAGING_SIZE  BOOT_SLOT_SIZE
+#define FW_STAGING_LINK  FW_STAGING_BASE
+#define FW_RUNNING_BASE  (FW_SLOT_ID == BOOT_SLOT_A ? BOOT_SLOT_A_BASE : BOOT_SLOT_B_BASE)
+#define FW_RUNNING_SIZE  BOOT_SLOT_SIZE
+static_assert(FW_SLOT_ID <= BOOT_SLOT_B, "FW_SLOT_ID为BOOT_SLOT_A或BOOT_SLOT_B");
+static_assert(BOOT_STATE_BASE + BOOT_STATE_SIZE <=
+              LOG_STORE_BASE + (LOG_STORE_PAGES - CONFIG_STORE_PAGES) * LOG_STORE_PAGE_SIZE,
+              "引导记录页与设置存储页重叠");
+#else
+// 暂存区为片内闪存日志区中设置存储页以外的各页（日志流在外置闪存上）
+#define FW_STAGING_BASE  LOG_STORE_BASE
+#define FW_STAGING_SIZE  ((LOG_STORE_PAGES - CONFIG_STORE_PAGES) * LOG_STORE_PAGE_SIZE)
+#define FW_STAGING_LINK  FW_UPDATE_APP_BASE
+#define FW_RUNNING_BASE  FW_UPDATE_APP_BASE
+#define FW_RUNNING_SIZE  FW_UPDATE_APP_SIZE
+static_assert(FW_STAGING_BASE >= FW_UPDATE_APP_BASE + FW_UPDATE_APP_SIZE, "暂存区与程序区重叠");
+#endif
+#define FW_IWDG_RELOAD   0xAAAAU
+
+static_assert(LOG_STORE_SPI_NOR, "暂存区占用片内日志区，须把日志流放在外置闪存");
+static_assert(FW_UPDATE_PAGE_SIZE == LOG_STORE_PAGE_SIZE && BOOT_PAGE_SIZE == LOG_STORE_PAGE_SIZE,
+              "暂存区按日志区的页擦除");
+
+static bool flash_erase_page(uint32_t address) {
+    FLASH_EraseInitTypeDef erase = {
+        .TypeErase = FLASH_TYPEERASE_PAGES,
+        .Banks = FLASH_BANK_1,
+        .PageAddress = address,
+        .NbPages = 1,
+    };
+    uint32_t page_error = 0;
+
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &page_error);
+    HAL_FLASH_Lock();
+    return status == HAL_OK;
+}
+
+static bool flash_program(uint32_t address, const void *data, uint32_t size) {
+    const uint8_t *bytes = data;
+    bool ok = true;
+
+    HAL_FLASH_Unlock();
+    for (uint32_t i = 0; i < size && ok; i += 2) {
+        uint16_t halfword = (uint16_t)(bytes[i] | (bytes[i + 1] << 8));
+        ok = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, address + i, halfword) == HAL_OK;
+    }
+    HAL_FLASH_Lock();
+    return ok;
+}
+
+static bool staging_erase(void *context, uint32_t offset) {
+    (void)context;
+    return flash_erase_page(FW_STAGING_BASE + offset);
+}
+
+static bool staging_program(void *context, uint32_t offset, const void *data, uint32_t size) {
+    (void)context;
+    return flash_program(FW_STAGING_BASE + offset, data, size);
+}
+
+#if FW_SLOTS
+static bool slots_settled = false;
+static bool slots_rolled_back = false;
+
+// 追加一条引导记录（取代当前记录），读回比较
+static bool boot_record_append(uint8_t confirmed, uint8_t trial) {
+    const uint8_t *state = (const uint8_t *)BOOT_STATE_BASE;
+    BootRecord record;
+    uint32_t append;
+    uint16_t sequence = boot_record_find(state, &record, &append) ? (uint16_t)(record.sequence + 1U) : 0;
+
+    record = (BootRecord){
+        .magic = BOOT_RECORD_MAGIC,
+        .sequence = sequence,
+        .confirmed = confirmed,
+        .trial = trial,
+    };
+    record.check = boot_record_check(&record);
+    if (append % BOOT_PAGE_SIZE == 0 && !flash_erase_page(BOOT_STATE_BASE + append)) {
+        return false;
+    }
+    return flash_program(BOOT_STATE_BASE + append, &record, sizeof(record)) &&
+           memcmp(state + append, &record, sizeof(record)) == 0;
+}
+
+// 由存储任务调用：追加试运行记录后复位，引导程序从新槽启动，不复制映像
+static void staging_install(void *context, uint32_t image_size) {
+    (void)context;
+    (void)image_size;
+    if (boot_record_append(FW_SLOT_ID, FW_SLOT_ID ^ 1U)) {
+        NVIC_SystemReset();
+    }
+    // 写入失败时仍运行当前固件，fwcm之后的状态保持INSTALLING，复位后重新升级
+}
+
+uint32_t fw_slots_service(uint32_t now_ms) {
+    if (slots_settled) {
+        return UINT32_MAX;
+    }
+    BootRecord record;
+    uint32_t append;
+    bool found = boot_record_find((const uint8_t *)BOOT_STATE_BASE, &record, &append);
+    if (found ? (record.confirmed == FW_SLOT_ID && record.trial == BOOT_SLOT_NONE) : FW_SLOT_ID == BOOT_SLOT_A) {
+        slots_settled = true;
+        return UINT32_MAX;
+    }
+
+    if (found && record.trial == FW_SLOT_ID) {
+        // 试运行中：运行一段时间（看门狗未复位）后确认
+        if (now_ms < BOOT_CONFIRM_MS) {
+            return BOOT_CONFIRM_MS - now_ms;
+        }
+    } else if (found && record.trial != BOOT_SLOT_NONE) {
+        slots_rolled_back = true; // 试运行的槽未确认就复位，或映像无效，引导程序回到了本槽
+    }
+    // 记下本槽为已确认的槽，备份域掉电后也不再试运行；写入失败时稍后重试
+    if (!boot_record_append(FW_SLOT_ID, BOOT_SLOT_NONE)) {
+        return BOOT_CONFIRM_MS;
+    }
+    slots_settled = true;
+    return UINT32_MAX;
+}
+
+bool fw_slots_confirmed(void) {
+    return slots_settled;
+}
+
+bool fw_slots_rolled_back(void) {
+    return slots_rolled_back;
+}
+#else
+
+// 等待闪存操作完成，期间喂狗（复制约10秒，超过看门狗周期）
+static RAMFUNC void flash_wait(void) {
+    while ((FLASH->SR & FLASH_SR_BSY) != 0) {
+        IWDG->KR = FW_IWDG_RELOAD;
+    }
+    FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPRTERR;
+}
+
+// 从SRAM执行：擦除程序区开头的各页后逐半字复制，再复位。程序区被擦除后不能再调用闪存中的
+// 任何函数（含HAL和memcpy），也不能响应中断（向量表在闪存中），因此只访问寄存器
+static RAMFUNC __attribute__((noreturn, noinline)) void install_copy(uint32_t image_size) {
+    FLASH->KEYR = FLASH_KEY1;
+    FLASH->KEYR = FLASH_KEY2;
+
+    for (uint32_t offset = 0; offset < image_size; offset += FW_UPDATE_PAGE_SIZE) {
+        flash_wait();
+        FLASH->CR |= FLASH_CR_PER;
+        FLASH->AR = FW_UPDATE_APP_BASE + offset;
+        FLASH->CR |= FLASH_CR_STRT;
+        flash_wait();
+        FLASH->CR &= ~FLASH_CR_PER;
+    }
+
+    const volatile uint16_t *source = (const volatile uint16_t *)FW_STAGING_BASE;
+    volatile uint16_t *target = (volatile uint16_t *)FW_UPDATE_APP_BASE;
+    FLASH->CR |= FLASH_CR_PG;
+    for (uint32_t i = 0; i < (image_size + 1U) / 2U; i++) {
+        target[i] = source[i];
+        flash_wait();
+    }
+    FLASH->CR &= ~FLASH_CR_PG;
+    FLASH->CR |= FLASH_CR_LOCK;
+
+    __DSB();
+    SCB->AIRCR = (0x5FAUL << SCB_AIRCR_VECTKEY_Pos) | (SCB->AIRCR & SCB_AIRCR_PRIGROUP_Msk) |
+                 SCB_AIRCR_SYSRESETREQ_Msk;
+    __DSB();
+    for (;;) {
+    }
+}
+
+// 由存储任务调用：关中断后不再有任务切换，DMA传输照常进行但不访问程序区
+static void staging_install(void *context, uint32_t image_size) {
+    (void)context;
+    __disable_irq();
+    install_copy(image_size);
+}
+#endif // FW_SLOTS
+
+static const FwUpdateDevice staging_device = {
+    .erase = staging_erase,
+    .program = staging_program,
+    .install = staging_install,
+    .context = NULL,
+    .base = (const uint8_t *)FW_STAGING_BASE,
+    .size = FW_STAGING_SIZE,
+    .link_base = FW_STAGING_LINK,
+    .old_base = (const uint8_t *)FW_RUNNING_BASE,
+    .old_size = FW_RUNNING_SIZE,
+    .old_link = FW_RUNNING_BASE,
+};
+
+const FwUpdateDevice *fw_install_device(void) {
+    return &staging_device;
+}
+
+#endif // FW_UPDATE
@@ -0,0 +1,450 @@
+#include "fw_update.h"
+
+#if FW_UPDATE
+
+#include "crc32.h"
+#include "boot_slots.h"
+#include "storage_task.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <string.h>
+#include <assert.h>
+
+static_assert(FW_UPDATE_CHUNK_MAX <= FW_UPDATE_PAGE_SIZE, "一块最多跨过一个页边界");
+
+typedef enum {
+    FW_STATE_IDLE,
+    FW_STATE_RECEIVING,
+    FW_STATE_VERIFIED,
+    FW_STATE_INSTALLING,
+} FwUpdateState;
+
+// 一页的缓冲：命令执行任务填写，写满（或到映像末尾）后置ready，存储任务写入闪存后清除
+typedef struct {
+    uint32_t page;        // 暂存区内的页编号
+    uint16_t length;      // 已填写的字节数
+    volatile bool ready;
+    uint8_t data[FW_UPDATE_PAGE_SIZE];
+} FwPageBuffer;
+
+static const FwUpdateDevice *fw_device = NULL;
+static FwUpdateState fw_state = FW_STATE_IDLE; // 只由命令执行任务修改
+static uint32_t fw_image_size;
+static uint32_t fw_image_crc;
+static uint32_t fw_received;                  // 下一块应有的偏移
+static FwPageBuffer fw_buffers[2];
+static uint8_t fw_filling = 0;                // 正在填写的缓冲
+static volatile bool fw_flash_failed = false; // 存储任务写入或读回比较失败
+static volatile bool fw_install_pending = false;
+static bool fw_install_armed = false;         // 以下只由存储任务访问
+static uint32_t fw_install_at_ms;
+
+// 差分升级：收到的是补丁（fw_received为补丁的偏移），第二个页缓冲用作补丁的环形缓冲，
+// 存储任务按补丁从当前固件和补丁数据生成新映像，写入第一个页缓冲，写满一页即写入闪存
+#define FW_PATCH_RING      FW_UPDATE_PAGE_SIZE
+#define FW_PATCH_HEADER_MAX 9U
+#define fw_patch_ring      (fw_buffers[1].data)
+static_assert((FW_PATCH_RING & (FW_PATCH_RING - 1U)) == 0, "环形缓冲的长度为2的幂");
+
+static bool fw_delta = false;
+static uint32_t fw_patch_size;
+static volatile uint32_t fw_patch_head;          // 命令执行任务写入的字节数
+static volatile uint32_t fw_patch_tail;          // 存储任务取出的字节数
+static volatile bool fw_patch_failed = false;    // 补丁的操作不合法
+static volatile bool fw_patch_waiting = true;    // 存储任务已处理完收到的补丁，等待更多数据
+static volatile bool fw_patch_done = false;      // 新映像已全部生成并写入
+static struct {                                  // 以下只由存储任务访问（开始升级时除外）
+    uint8_t header[FW_PATCH_HEADER_MAX];
+    uint8_t header_length;
+    uint8_t op;
+    uint32_t source;     // 复制操作在当前固件中的偏移
+    uint32_t remaining;  // 当前操作尚未生成的字节数
+    uint32_t output;     // 已生成的新映像字节数
+} fw_patch;
+
+static bool buffers_busy(void) {
+    return fw_buffers[0].ready || fw_buffers[1].ready || (fw_delta && !fw_patch_waiting);
+}
+
+void fw_update_init(const FwUpdateDevice *device) {
+    fw_device = device;
+    fw_state = FW_STATE_IDLE;
+    fw_buffers[0].ready = false;
+    fw_buffers[1].ready = false;
+    fw_flash_failed = false;
+    fw_install_pending = false;
+    fw_install_armed = false;
+    fw_delta = false;
+    fw_patch_failed = false;
+    fw_patch_waiting = true;
+}
+
+bool fw_update_ready(void) {
+    return fw_device != NULL;
+}
+
+uint32_t fw_update_received(void) {
+    return (fw_state == FW_STATE_RECEIVING || fw_state == FW_STATE_VERIFIED) ? fw_received : 0;
+}
+
+// 检查映像参数：同一映像（写入失败的除外）从已收到的位置继续，或者不能开始时返回true，
+// 结果在*result中；可以重新开始时返回false
+static bool begin_check(uint32_t image_size, uint32_t image_crc, bool delta, uint32_t patch_size,
+                        uint32_t *offset, FwUpdateResult *result) {
+    *offset = 0;
+    *result = FW_UPDATE_OK;
+    if (fw_device == NULL) {
+        *result = FW_UPDATE_NO_IMAGE;
+    } else if (fw_state == FW_STATE_INSTALLING) {
+        *result = FW_UPDATE_BUSY;
+    } else if (image_size == 0 || image_size > fw_device->size || image_size > FW_UPDATE_APP_SIZE) {
+        *result = FW_UPDATE_INVALID;
+    } else if ((fw_state == FW_STATE_RECEIVING || fw_state == FW_STATE_VERIFIED) && !fw_flash_failed &&
+               !fw_patch_failed && image_size == fw_image_size && image_crc == fw_image_crc &&
+               delta == fw_delta && (!delta || patch_size == fw_patch_size)) {
+        *offset = fw_received;
+    } else if (buffers_busy()) {
+        *result = FW_UPDATE_BUSY; // 上一个映像还有页在写入
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static void begin_reset(uint32_t image_size, uint32_t image_crc) {
+    fw_image_size = image_size;
+    fw_image_crc = image_crc;
+    fw_received = 0;
+    fw_filling = 0;
+    fw_flash_failed = false;
+    fw_state = FW_STATE_RECEIVING;
+}
+
+FwUpdateResult fw_update_begin(uint32_t image_size, uint32_t image_crc, uint32_t *offset) {
+    FwUpdateResult result;
+    if (begin_check(image_size, image_crc, false, 0, offset, &result)) {
+        return result;
+    }
+    fw_delta = false;
+    begin_reset(image_size, image_crc);
+    return FW_UPDATE_OK;
+}
+
+FwUpdateResult fw_update_begin_delta(uint32_t image_size, uint32_t image_crc, uint32_t patch_size,
+                                     uint32_t base_size, uint32_t base_crc, uint32_t *offset) {
+    FwUpdateResult result;
+    if (begin_check(image_size, image_crc, true, patch_size, offset, &result)) {
+        return result;
+    }
+    // 补丁只适用于生成它时的旧映像，先确认当前固件与之相同
+    if (fw_device->old_base == NULL || patch_size == 0 || base_size == 0 || base_size > fw_device->old_size ||
+        crc32_compute(fw_device->old_base, base_size) != base_crc) {
+        return FW_UPDATE_INVALID;
+    }
+    fw_delta = true;
+    fw_patch_size = patch_size;
+    fw_patch_head = 0;
+    fw_patch_tail = 0;
+    fw_patch_failed = false;
+    fw_patch_done = false;
+    memset(&fw_patch, 0, sizeof(fw_patch));
+    fw_buffers[0].length = 0;
+    fw_patch_waiting = true;
+    begin_reset(image_size, image_crc);
+    return FW_UPDATE_OK;
+}
+
+// 把一段数据追加到正在填写的缓冲（不跨页），填满或到映像末尾时交给存储任务
+static void buffer_append(const uint8_t *data, uint16_t length) {
+    FwPageBuffer *buffer = &fw_buffers[fw_filling];
+    if (fw_received % FW_UPDATE_PAGE_SIZE == 0) {
+        buffer->page = fw_received / FW_UPDATE_PAGE_SIZE; // 另一个缓冲可能还未写入，不在切换时清零
+        buffer->length = 0;
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    fw_received += length;
+    if (buffer->length == FW_UPDATE_PAGE_SIZE || fw_received == fw_image_size) {
+        buffer->ready = true;
+        fw_filling ^= 1U;
+        storage_task_wake();
+    }
+}
+
+// 补丁数据放入环形缓冲，由存储任务处理；放不下时不接受
+static FwUpdateResult patch_append(const uint8_t *data, uint16_t length, uint32_t *next) {
+    if (fw_patch_failed) {
+        return FW_UPDATE_INVALID;
+    }
+    uint32_t head = fw_patch_head;
+    if (FW_PATCH_RING - (head - fw_patch_tail) < length) {
+        return FW_UPDATE_BUSY;
+    }
+    for (uint16_t i = 0; i < length; i++) {
+        fw_patch_ring[(head + i) & (FW_PATCH_RING - 1U)] = data[i];
+    }
+    fw_patch_head = head + length;
+    fw_patch_waiting = false;
+    fw_received += length;
+    *next = fw_received;
+    storage_task_wake();
+    return FW_UPDATE_OK;
+}
+
+FwUpdateResult fw_update_chunk(uint32_t offset, const uint8_t *data, uint16_t length, uint32_t chunk_crc,
+                               uint32_t *next) {
+    *next = fw_received;
+    if (fw_state != FW_STATE_RECEIVING) {
+        return (fw_state == FW_STATE_VERIFIED && offset < fw_received) ? FW_UPDATE_OK : FW_UPDATE_NO_IMAGE;
+    }
+    if (fw_flash_failed) {
+        return FW_UPDATE_FLASH_ERROR;
+    }
+    if (length == 0 || length > FW_UPDATE_CHUNK_MAX) {
+        return FW_UPDATE_INVALID;
+    }
+    if (offset < fw_received && offset + length <= fw_received) {
+        return FW_UPDATE_OK; // 重发已收到的块（应答丢失）
+    }
+    uint32_t total = fw_delta ? fw_patch_size : fw_image_size;
+    if (offset != fw_received || total - fw_received < length || crc32_compute(data, length) != chunk_crc) {
+        return FW_UPDATE_INVALID;
+    }
+    if (fw_delta) {
+        return patch_append(data, length, next);
+    }
+
+    // 跨页的块需要两个空闲的缓冲，先检查再复制，不接受半块
+    uint16_t first = (uint16_t)(FW_UPDATE_PAGE_SIZE - fw_received % FW_UPDATE_PAGE_SIZE);
+    if (first > length) {
+        first = length;
+    }
+    if (fw_buffers[fw_filling].ready || (first < length && fw_buffers[fw_filling ^ 1U].ready)) {
+        return FW_UPDATE_BUSY;
+    }
+    buffer_append(data, first);
+    if (first < length) {
+        buffer_append(data + first, length - first);
+    }
+    *next = fw_received;
+    return FW_UPDATE_OK;
+}
+
+FwUpdateResult fw_update_verify(uint32_t *crc) {
+    *crc = 0;
+    if (fw_state != FW_STATE_RECEIVING && fw_state != FW_STATE_VERIFIED) {
+        return FW_UPDATE_NO_IMAGE;
+    }
+    if (buffers_busy()) {
+        return FW_UPDATE_BUSY;
+    }
+    if (fw_flash_failed) {
+        return FW_UPDATE_FLASH_ERROR;
+    }
+    // 差分升级时补丁处理完后新映像仍不完整（补丁不完整或有误）同样校验失败
+    if (fw_delta ? (fw_patch_failed || !fw_patch_done) : fw_received != fw_image_size) {
+        return FW_UPDATE_INVALID;
+    }
+
+    *crc = crc32_compute(fw_device->base, fw_image_size);
+    if (*crc != fw_image_crc || fw_image_size < 8) {
+        fw_state = FW_STATE_RECEIVING;
+        return FW_UPDATE_INVALID;
+    }
+
+    // 向量表：复位向量须在映像内（按另一个槽链接的映像在这里被拒绝）
+    if (!boot_image_valid(fw_device->base, fw_device->link_base, fw_image_size)) {
+        fw_state = FW_STATE_RECEIVING;
+        return FW_UPDATE_INVALID;
+    }
+    fw_state = FW_STATE_VERIFIED;
+    return FW_UPDATE_OK;
+}
+
+FwUpdateResult fw_update_commit(void) {
+    if (fw_state != FW_STATE_VERIFIED) {
+        return FW_UPDATE_NO_IMAGE;
+    }
+    fw_state = FW_STATE_INSTALLING;
+    fw_install_pending = true;
+    storage_task_wake();
+    return FW_UPDATE_OK;
+}
+
+// 擦除并写入一页，读回比较
+static bool write_page(FwPageBuffer *buffer) {
+    uint32_t offset = buffer->page * FW_UPDATE_PAGE_SIZE;
+    uint32_t size = (buffer->length + 1U) & ~1U; // 按半字编程，奇数长度补一个擦除值
+    if (size > buffer->length) {
+        buffer->data[buffer->length] = 0xFF;
+    }
+    return fw_device->erase(fw_device->context, offset) &&
+           fw_device->program(fw_device->context, offset, buffer->data, size) &&
+           memcmp(fw_device->base + offset, buffer->data, buffer->length) == 0;
+}
+
+static uint8_t patch_pop(void) {
+    uint32_t tail = fw_patch_tail;
+    uint8_t byte = fw_patch_ring[tail & (FW_PATCH_RING - 1U)];
+    fw_patch_tail = tail + 1U;
+    return byte;
+}
+
+static uint32_t read_le32(const uint8_t *bytes) {
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+// 没有可用的补丁数据时置等待标志后再检查一次，避免与命令执行任务写入的数据错过
+static bool patch_wait(void) {
+    if (fw_patch_head != fw_patch_tail) {
+        return false;
+    }
+    fw_patch_waiting = true;
+    if (fw_patch_head != fw_patch_tail) {
+        fw_patch_waiting = false;
+        return false;
+    }
+    return true;
+}
+
+// 补丁不合法：不再处理，校验失败
+static bool patch_fail(void) {
+    fw_patch_failed = true;
+    fw_patch_waiting = true;
+    return false;
+}
+
+// 读取下一个操作的头部；数据不够或不合法时返回false
+static bool patch_read_header(void) {
+    while (fw_patch.header_length == 0 || fw_patch.header_length < (fw_patch.header[0] == FW_PATCH_DATA ? 3U : 9U)) {
+        if (patch_wait()) {
+            return false;
+        }
+        fw_patch.header[fw_patch.header_length++] = patch_pop();
+        if (fw_patch.header[0] < FW_PATCH_COPY || fw_patch.header[0] > FW_PATCH_DATA) {
+            return patch_fail();
+        }
+    }
+    fw_patch.header_length = 0;
+    fw_patch.op = fw_patch.header[0];
+    if (fw_patch.op == FW_PATCH_DATA) {
+        fw_patch.remaining = fw_patch.header[1] | (fw_patch.header[2] << 8);
+    } else {
+        fw_patch.source = read_le32(fw_patch.header + 1);
+        fw_patch.remaining = read_le32(fw_patch.header + 5);
+        // 复制的范围在当前固件所在区域内；改写地址的复制按字对齐
+        if (fw_patch.source > fw_device->old_size || fw_device->old_size - fw_patch.source < fw_patch.remaining ||
+            (fw_patch.op == FW_PATCH_COPY_REBASE &&
+             ((fw_patch.source | fw_patch.remaining | fw_patch.output) & 3U) != 0)) {
+            return patch_fail();
+        }
+    }
+    if (fw_image_size - fw_patch.output < fw_patch.remaining) {
+        return patch_fail(); // 超出新映像的长度
+    }
+    return true;
+}
+
+// 按补丁生成新映像，写满一页（或到映像末尾）后写入闪存并返回true（还可能有后续工作）；
+// 等待补丁数据时返回false
+static bool patch_run(void) {
+    FwPageBuffer *page = &fw_buffers[0];
+    if (fw_patch_done && fw_patch_head != fw_patch_tail) {
+        fw_patch_failed = true; // 补丁比新映像长
+    }
+    while (!fw_patch_failed && !fw_patch_done) {
+        if (fw_patch.remaining == 0 && !patch_read_header()) {
+            return false;
+        }
+        if (page->length == 0) {
+            page->page = fw_patch.output / FW_UPDATE_PAGE_SIZE;
+        }
+        uint32_t count = FW_UPDATE_PAGE_SIZE - page->length;
+        if (count > fw_patch.remaining) {
+            count = fw_patch.remaining;
+        }
+        uint8_t *target = page->data + page->length;
+        if (fw_patch.op == FW_PATCH_DATA) {
+            uint32_t available = fw_patch_head - fw_patch_tail;
+            if (count > available) {
+                count = available;
+            }
+            if (count == 0) {
+                if (patch_wait()) {
+                    return false;
+                }
+                continue;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                target[i] = patch_pop();
+            }
+        } else {
+            memcpy(target, fw_device->old_base + fw_patch.source, count);
+            if (fw_patch.op == FW_PATCH_COPY_REBASE) {
+                // 指向当前固件所在区域的字改为指向新映像的区域（另一个程序槽）
+                for (uint32_t i = 0; i < count; i += 4) {
+                    uint32_t word = read_le32(target + i);
+                    if (word - fw_device->old_link < fw_device->old_size) {
+                        word += fw_device->link_base - fw_device->old_link;
+                        memcpy(target + i, &word, sizeof(word));
+                    }
+                }
+            }
+            fw_patch.source += count;
+        }
+        page->length += count;
+        fw_patch.remaining -= count;
+        fw_patch.output += count;
+
+        if (page->length == FW_UPDATE_PAGE_SIZE || fw_patch.output == fw_image_size) {
+            if (!write_page(page)) {
+                fw_flash_failed = true;
+            }
+            page->length = 0;
+            if (fw_patch.output == fw_image_size) {
+                fw_patch_done = true; // 补丁之后多余的数据在校验时不再检查
+                fw_patch_waiting = true;
+            }
+            return true;
+        }
+    }
+    fw_patch_waiting = true; // 失败或已完成：不再处理补丁
+    return false;
+}
+
+uint32_t fw_update_service(uint32_t now_ms) {
+    if (fw_device == NULL) {
+        return UINT32_MAX;
+    }
+
+    // 差分升级：每次调用最多写入一页，之后立即再次调用，期间其他存储工作照常进行
+    if (fw_delta && fw_state == FW_STATE_RECEIVING && !fw_flash_failed && patch_run()) {
+        return 0;
+    }
+
+    // 两页都已就绪时先写页号小的
+    for (uint8_t n = 0; n < 2 && buffers_busy(); n++) {
+        uint8_t i = (fw_buffers[0].ready && (!fw_buffers[1].ready || fw_buffers[0].page < fw_buffers[1].page)) ? 0 : 1;
+        if (!write_page(&fw_buffers[i])) {
+            fw_flash_failed = true;
+        }
+        fw_buffers[i].ready = false;
+    }
+
+    if (!fw_install_pending) {
+        return UINT32_MAX;
+    }
+    if (!fw_install_armed) {
+        fw_install_armed = true;
+        fw_install_at_ms = now_ms + FW_UPDATE_INSTALL_DELAY_MS;
+    }
+    int32_t remaining = (int32_t)(fw_install_at_ms - now_ms);
+    if (remaining > 0) {
+        return (uint32_t)remaining;
+    }
+    fw_device->install(fw_device->context, fw_image_size); // 固件中不返回，主机测试中返回
+    fw_install_pending = false;
+    return UINT32_MAX;
+}
+
+#endif // FW_UPDATE
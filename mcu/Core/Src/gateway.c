@@ -0,0 +1,468 @@
+#include "gateway.h"
+#include "config_store.h"
+#include "frame_parser.h"
+#include "frame_writer.h"
+#include "ring_buffer.h"
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <string.h>
+
+#if COMM_GATEWAY
+
+// 请求帧的最大长度：带地址的包头 + 转发请求 + CRC，COBS编码并加分隔符
+#define GATEWAY_TX_FRAME_SIZE FRAME_COBS_MAX_LENGTH(GATEWAY_FORWARD_MAX)
+
+typedef enum {
+    FORWARD_IDLE = 0,
+    FORWARD_QUEUED,    // 执行任务已提交，等待总线空闲
+    FORWARD_SENT,      // 已发出，等待应答
+    FORWARD_DONE,      // 已应答：结果留在接收缓冲区中，取走之前暂停轮询和解析
+    FORWARD_FAILED     // 超时
+} ForwardState;
+
+// 一块发送缓冲区中已构建的请求帧
+typedef struct {
+    uint8_t frame[GATEWAY_TX_FRAME_SIZE];
+    uint16_t length;
+    uint16_t packet_id;
+    uint8_t address;
+    bool forward;      // 转发请求，否则为轮询
+} BusRequest;
+
+static const CommTransport *bus = NULL;
+static uint8_t ring_storage[GATEWAY_RX_RING_SIZE];
+static RingBuffer ring;
+static FrameParser parser;
+static uint8_t frame_buffer[MAX_PACKET_SIZE];
+static volatile bool rx_restart_pending = false;
+static volatile bool tx_busy = false;
+
+// 两块发送缓冲区轮流使用：一块正在发送或等待应答，另一块构建下一个请求
+static BusRequest requests[2];
+static uint8_t staged = 0;              // requests[staged]为下一个要发出的帧
+static bool staged_ready = false;
+static BusRequest *outstanding = NULL;  // 已发出、等待应答的请求
+static uint32_t outstanding_deadline = 0;
+static uint16_t next_packet_id = 0;
+
+// 轮询请求的数据部分：IN为1字节的temp编号
+static uint8_t poll_request[5];
+
+// 设置和缓存：由接收任务更新，执行任务（优先级更低，不会打断接收任务）在临界区中访问
+static GatewayConfig config;
+static GatewayDevice devices[GATEWAY_MAX_DEVICES];
+static uint8_t poll_index = 0;          // 本轮下一个要轮询的设备，等于count时本轮已结束
+static uint32_t cycle_tick = 0;         // 本轮开始的时刻
+
+static volatile uint8_t forward_state = FORWARD_IDLE;
+static uint8_t forward_address;
+static uint16_t forward_length;
+static uint8_t forward_request[GATEWAY_FORWARD_MAX];
+static uint8_t forward_type;
+static uint16_t forward_payload_length;
+static uint32_t forward_done_tick;
+
+static uint32_t ms_until(uint32_t tick, uint32_t now) {
+    int32_t remaining = (int32_t)(tick - now);
+    return remaining > 0 ? (uint32_t)remaining : 0;
+}
+
+static GatewayDevice *find_device(uint8_t address) {
+    for (uint8_t i = 0; i < config.count; i++) {
+        if (devices[i].address == address) {
+            return &devices[i];
+        }
+    }
+    return NULL;
+}
+
+static void apply_config(const GatewayConfig *new_config) {
+    memset(&config, 0, sizeof(config));
+    config.interval_ms = new_config->interval_ms;
+    config.count = new_config->count;
+    memcpy(config.addresses, new_config->addresses, new_config->count);
+    memset(devices, 0, sizeof(devices));
+    for (uint8_t i = 0; i < config.count; i++) {
+        devices[i].address = config.addresses[i];
+    }
+    // 立即开始新一轮，已构建的旧请求作废
+    poll_index = 0;
+    cycle_tick = HAL_GetTick();
+    staged_ready = false;
+}
+
+void gateway_init(const CommTransport *transport) {
+    bus = transport;
+    uint8_t opcode = OP_GET_TEMP;
+    write_tlv_raw(poll_request, sizeof(poll_request), TAG_INSTRUCTION, &opcode, 1);
+
+    GatewayConfig empty = {.interval_ms = GATEWAY_DEFAULT_INTERVAL_MS, .count = 0};
+    apply_config(&empty);
+    outstanding = NULL;
+    forward_state = FORWARD_IDLE;
+    tx_busy = false;
+    rx_restart_pending = false;
+
+    frame_parser_init(&parser, frame_buffer, sizeof(frame_buffer));
+    ring_buffer_init(&ring, ring_storage, sizeof(ring_storage));
+    bus->ops->start_rx(bus->context, ring_storage, sizeof(ring_storage));
+}
+
+void gateway_rx_event(uint16_t dma_pos) {
+    ring_buffer_commit_to(&ring, dma_pos);
+}
+
+void gateway_tx_complete(void) {
+    tx_busy = false;
+}
+
+void gateway_error(bool rx_stopped) {
+    if (rx_stopped) {
+        rx_restart_pending = true;
+    }
+}
+
+static bool build_request(BusRequest *request, uint8_t address, const uint8_t *data, uint16_t length, bool forward) {
+    next_packet_id = (uint16_t)((next_packet_id + 1) & 0x7FFF); // 最高位为0：主机编号
+    PacketHeader header = {
+        .version = PROTOCOL_VERSION_COBS_ADDR,
+        .address = address,
+        .type = PKT_TYPE_HOST_REQUEST,
+        .packet_id = next_packet_id,
+        .response_id = 0,
+        .data_length = length,
+    };
+    FrameWriter writer;
+    frame_writer_begin(&writer, request->frame, sizeof(request->frame), &header);
+    frame_writer_write(&writer, data, length);
+    int frame_len = frame_writer_finish(&writer);
+    if (frame_len < 0) {
+        return false;
+    }
+    request->length = (uint16_t)frame_len;
+    request->packet_id = header.packet_id;
+    request->address = address;
+    request->forward = forward;
+    return true;
+}
+
+// 本轮还有未轮询的设备，或已到开始新一轮的时刻
+static bool poll_due(uint32_t now) {
+    if (config.count == 0) {
+        return false;
+    }
+    if (poll_index < config.count) {
+        return true;
+    }
+    if (ms_until(cycle_tick + config.interval_ms, now) > 0) {
+        return false;
+    }
+    poll_index = 0;
+    cycle_tick = now;
+    return true;
+}
+
+// 在空闲的发送缓冲区中预先构建本轮下一个设备的轮询请求
+static void stage_poll(void) {
+    if (staged_ready || poll_index >= config.count) {
+        return;
+    }
+    staged_ready = build_request(&requests[staged], config.addresses[poll_index],
+                                 poll_request, sizeof(poll_request), false);
+}
+
+// 发出下一个请求：排队的转发优先，其次是本轮剩余的轮询
+static void send_next(uint32_t now) {
+    if (outstanding != NULL || tx_busy) {
+        return;
+    }
+
+    BusRequest *request = &requests[staged];
+    uint32_t timeout_ms;
+    if (forward_state == FORWARD_QUEUED) {
+        staged_ready = false; // 覆盖预先构建的轮询请求，之后重新构建
+        if (!build_request(request, forward_address, forward_request, forward_length, true)) {
+            forward_state = FORWARD_FAILED;
+            return;
+        }
+        forward_state = FORWARD_SENT;
+        timeout_ms = GATEWAY_FORWARD_TIMEOUT_MS;
+    } else {
+        if (!poll_due(now)) {
+            return;
+        }
+        stage_poll();
+        if (!staged_ready) {
+            return;
+        }
+        staged_ready = false;
+        poll_index++;
+        timeout_ms = GATEWAY_RESPONSE_TIMEOUT_MS;
+    }
+
+    // 发送失败（传输层忙）时同样等待超时，按未应答处理
+    tx_busy = true;
+    if (!bus->ops->send(bus->context, request->frame, request->length)) {
+        tx_busy = false;
+    }
+    outstanding = request;
+    outstanding_deadline = now + timeout_ms;
+    staged ^= 1U;
+}
+
+// 从轮询应答的DA中取出温度和读数的时效；ST不为OK时保留上一次的读数
+static void record_reading(uint8_t address, const PacketHeader *header, const uint8_t *payload) {
+    GatewayDevice *device = find_device(address);
+    if (device == NULL) {
+        return; // 地址表已改变
+    }
+    device->answered = true;
+    device->consecutive_misses = 0;
+    device->responses++;
+
+    uint8_t status = STATUS_INTERNAL_ERROR;
+    const uint8_t *da = NULL;
+    uint16_t da_len = 0;
+    if (header->type == PKT_TYPE_SLAVE_RESPONSE) {
+        read_tlv_uint8(payload, header->data_length, TAG_STATUS, &status);
+        if (read_tlv_view(payload, header->data_length, TAG_DATA, &da, &da_len) < 0) {
+            da = NULL;
+        }
+    } else if (header->type == PKT_TYPE_SLAVE_COMPACT && header->data_length > 0) {
+        // 紧凑响应：ST(1字节)之后直接是DA的值
+        status = payload[0];
+        da = payload + 1;
+        da_len = header->data_length - 1;
+    }
+    device->status = status;
+
+    if (status != STATUS_OK || da == NULL) {
+        return;
+    }
+    TlvIndex index;
+    int16_t temperature;
+    uint32_t age_ms = 0;
+    tlv_index_build(&index, da, da_len);
+    if (tlv_index_get_temperature(&index, TAG_TEMPERATURE, &temperature) < 0) {
+        device->status = STATUS_SENSOR_ERROR;
+        return;
+    }
+    tlv_index_get_uint32(&index, TAG_SAMPLE_AGE, &age_ms);
+    device->temperature = temperature;
+    device->sample_age_ms = age_ms;
+    device->reading_tick = HAL_GetTick();
+    device->has_reading = true;
+}
+
+// 处理一帧校验通过的帧，转发的应答到达时返回true（停止解析，结果留在接收缓冲区中）
+static bool handle_frame(void) {
+    const PacketHeader *header = frame_parser_header(&parser);
+    if (outstanding == NULL || header->address != outstanding->address ||
+        header->response_id != outstanding->packet_id ||
+        (header->type != PKT_TYPE_SLAVE_RESPONSE && header->type != PKT_TYPE_SLAVE_COMPACT &&
+         header->type != PKT_TYPE_SLAVE_ERROR)) {
+        return false; // 超时后迟到的应答或其他帧
+    }
+
+    BusRequest *answered = outstanding;
+    outstanding = NULL;
+    if (answered->forward) {
+        if (forward_state != FORWARD_SENT) {
+            return false; // 执行任务已放弃等待
+        }
+        forward_type = header->type;
+        forward_payload_length = header->data_length;
+        forward_done_tick = HAL_GetTick();
+        forward_state = FORWARD_DONE;
+        return true;
+    }
+
+    // 流水线：先发出已构建好的下一个请求，再解码这一个应答
+    uint8_t address = answered->address;
+    send_next(HAL_GetTick());
+    record_reading(address, header, frame_parser_payload(&parser));
+    return false;
+}
+
+static void receive(void) {
+    const uint8_t *data;
+    uint16_t length;
+    while (forward_state != FORWARD_DONE && (length = ring_buffer_peek(&ring, &data)) > 0) {
+        uint16_t used = 0;
+        while (used < length) {
+            if (frame_parser_feed(&parser, data[used++]) == FRAME_RESULT_OK && handle_frame()) {
+                break;
+            }
+        }
+        ring_buffer_consume(&ring, used);
+    }
+}
+
+static void handle_timeout(void) {
+    BusRequest *expired = outstanding;
+    outstanding = NULL;
+    frame_parser_reset(&parser);
+    if (expired->forward) {
+        if (forward_state == FORWARD_SENT) {
+            forward_state = FORWARD_FAILED;
+        }
+        return;
+    }
+    GatewayDevice *device = find_device(expired->address);
+    if (device != NULL) {
+        device->misses++;
+        if (device->consecutive_misses < UINT8_MAX) {
+            device->consecutive_misses++;
+        }
+    }
+}
+
+void gateway_service(void) {
+    if (bus == NULL) {
+        return;
+    }
+    if (rx_restart_pending) {
+        rx_restart_pending = false;
+        bus->ops->stop_rx(bus->context);
+        ring_buffer_reset(&ring);
+        frame_parser_reset(&parser);
+        bus->ops->start_rx(bus->context, ring_storage, sizeof(ring_storage));
+    }
+
+    uint32_t now = HAL_GetTick();
+    if (forward_state == FORWARD_DONE) {
+        if (ms_until(forward_done_tick + GATEWAY_FORWARD_HOLD_MS, now) > 0) {
+            return;
+        }
+        forward_state = FORWARD_IDLE; // 结果一直没有被取走
+    }
+
+    receive();
+    if (outstanding != NULL && ms_until(outstanding_deadline, HAL_GetTick()) == 0) {
+        handle_timeout();
+    }
+    send_next(HAL_GetTick());
+    stage_poll();
+}
+
+uint32_t gateway_next_due_ms(void) {
+    if (bus == NULL) {
+        return UINT32_MAX;
+    }
+    uint32_t now = HAL_GetTick();
+    if (forward_state == FORWARD_DONE) {
+        return ms_until(forward_done_tick + GATEWAY_FORWARD_HOLD_MS, now);
+    }
+    if (rx_restart_pending || ring_buffer_count(&ring) > 0) {
+        return 0;
+    }
+    if (outstanding != NULL) {
+        return ms_until(outstanding_deadline, now);
+    }
+    if (forward_state == FORWARD_QUEUED || (config.count != 0 && poll_index < config.count)) {
+        return tx_busy ? 1 : 0; // 超时后上一帧仍在发送
+    }
+    if (config.count == 0) {
+        return UINT32_MAX;
+    }
+    return ms_until(cycle_tick + config.interval_ms, now);
+}
+
+bool gateway_idle(void) {
+    return outstanding == NULL && !tx_busy && gateway_next_due_ms() > 0;
+}
+
+static bool config_valid(const GatewayConfig *candidate) {
+    if (candidate->count > GATEWAY_MAX_DEVICES || candidate->interval_ms < GATEWAY_MIN_INTERVAL_MS) {
+        return false;
+    }
+    for (uint8_t i = 0; i < candidate->count; i++) {
+        uint8_t address = candidate->addresses[i];
+        if (address < PROTOCOL_ADDRESS_MIN || address > PROTOCOL_ADDRESS_MAX ||
+            memchr(candidate->addresses, address, i) != NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool gateway_configure(const GatewayConfig *new_config) {
+    if (!config_valid(new_config)) {
+        return false;
+    }
+    taskENTER_CRITICAL();
+    apply_config(new_config);
+    taskEXIT_CRITICAL();
+    communication_wake_rx();
+    return true;
+}
+
+void gateway_get_config(GatewayConfig *out) {
+    taskENTER_CRITICAL();
+    *out = config;
+    taskEXIT_CRITICAL();
+}
+
+void gateway_load_config(void) {
+    uint16_t length = 0;
+    const void *saved = config_store_find(CONFIG_KEY_GATEWAY, &length);
+    GatewayConfig loaded;
+    if (saved && length == sizeof(loaded)) {
+        memcpy(&loaded, saved, sizeof(loaded));
+        gateway_configure(&loaded);
+    }
+}
+
+void gateway_get_config_item(uint16_t index, void *item) {
+    (void)index;
+    GatewayConfig current;
+    gateway_get_config(&current);
+    memcpy(item, &current, sizeof(current));
+}
+
+bool gateway_get_device(uint8_t index, GatewayDevice *device) {
+    bool found = false;
+    taskENTER_CRITICAL();
+    if (index < config.count) {
+        *device = devices[index];
+        found = true;
+    }
+    taskEXIT_CRITICAL();
+    return found;
+}
+
+bool gateway_forward(uint8_t address, const uint8_t *request, uint16_t length) {
+    if (bus == NULL || forward_state != FORWARD_IDLE || length > GATEWAY_FORWARD_MAX ||
+        address < PROTOCOL_ADDRESS_MIN || address > PROTOCOL_ADDRESS_MAX) {
+        return false;
+    }
+    memcpy(forward_request, request, length);
+    forward_length = length;
+    forward_address = address;
+    forward_state = FORWARD_QUEUED;
+    communication_wake_rx();
+    return true;
+}
+
+int gateway_forward_result(const uint8_t **payload, uint16_t *length, uint8_t *type) {
+    switch (forward_state) {
+    case FORWARD_DONE:
+        *payload = frame_parser_payload(&parser);
+        *length = forward_payload_length;
+        *type = forward_type;
+        return 0;
+    case FORWARD_QUEUED:
+    case FORWARD_SENT:
+        return GATEWAY_FORWARD_PENDING;
+    default:
+        return -1;
+    }
+}
+
+void gateway_forward_release(void) {
+    forward_state = FORWARD_IDLE;
+    communication_wake_rx();
+}
+
+#endif // COMM_GATEWAY
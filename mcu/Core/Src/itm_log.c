@@ -0,0 +1,167 @@
+#include "itm_log.h"
+#include "communication.h"
+#include "trace.h"
+#include "log_store.h"
+#include "main.h"
+#include "FreeRTOS.h"
+#include "timers.h"
+#include <string.h>
+
+#define ITM_TRACE_CHUNK 8 // 每次从跟踪缓冲区取出的记录数
+
+static volatile uint32_t dropped = 0;
+static uint32_t trace_sequence = 0;
+
+static StaticTimer_t stats_timer_buffer;
+
+bool itm_port_enabled(uint8_t port) {
+    return (CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk) &&
+           (ITM->TCR & ITM_TCR_ITMENA_Msk) &&
+           (ITM->TER & (1UL << port));
+}
+
+// 激励端口读出1表示FIFO可以接收
+static inline bool port_ready(uint8_t port) {
+    return ITM->PORT[port].u32 != 0;
+}
+
+uint16_t itm_write(uint8_t port, const void *data, uint16_t len) {
+    if (len == 0 || !itm_port_enabled(port)) {
+        return 0;
+    }
+    if (!port_ready(port)) {
+        dropped++;
+        return 0;
+    }
+
+    // 整字写入每4字节只占一个SWO包，余下的逐字节写入
+    const uint8_t *bytes = data;
+    uint16_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        uint32_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        while (!port_ready(port)) {
+        }
+        ITM->PORT[port].u32 = word;
+    }
+    for (; i < len; i++) {
+        while (!port_ready(port)) {
+        }
+        ITM->PORT[port].u8 = bytes[i];
+    }
+    return len;
+}
+
+void itm_puts(const char *text) {
+    itm_write(ITM_PORT_TEXT, text, (uint16_t)strlen(text));
+}
+
+uint32_t itm_dropped(void) {
+    return dropped;
+}
+
+// syscalls.c的_write()逐字符调用
+int __io_putchar(int ch) {
+    uint8_t c = (uint8_t)ch;
+    itm_write(ITM_PORT_TEXT, &c, 1);
+    return ch;
+}
+
+// 在行缓冲中追加" name=value"
+static uint16_t append_u32(char *line, uint16_t len, uint16_t size, const char *name, uint32_t value) {
+    char digits[10];
+    uint8_t n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    uint16_t name_len = (uint16_t)strlen(name);
+    if (len + 2 + name_len + n >= size) {
+        return len;
+    }
+    line[len++] = ' ';
+    memcpy(line + len, name, name_len);
+    len += name_len;
+    line[len++] = '=';
+    while (n > 0) {
+        line[len++] = digits[--n];
+    }
+    return len;
+}
+
+static void write_link_stats(uint8_t link) {
+    CommStats stats;
+    communication_get_link_stats(link, &stats);
+
+    char line[160];
+    uint16_t len = 4;
+    memcpy(line, "comm", 4);
+    len = append_u32(line, len, sizeof(line), "ln", link);
+    len = append_u32(line, len, sizeof(line), "ni", stats.packets_received);
+    len = append_u32(line, len, sizeof(line), "no", stats.packets_sent);
+    len = append_u32(line, len, sizeof(line), "bi", stats.rx_bytes);
+    len = append_u32(line, len, sizeof(line), "bo", stats.tx_bytes);
+    len = append_u32(line, len, sizeof(line), "ce", stats.crc_errors);
+    len = append_u32(line, len, sizeof(line), "fe", stats.format_errors);
+    len = append_u32(line, len, sizeof(line), "ue", stats.timeout_errors);
+    len = append_u32(line, len, sizeof(line), "ry", stats.resyncs);
+    len = append_u32(line, len, sizeof(line), "rh", stats.rx_ring_peak);
+    len = append_u32(line, len, sizeof(line), "qp", stats.tx_queue_peak);
+    len = append_u32(line, len, sizeof(line), "qd", stats.tx_dropped);
+    len = append_u32(line, len, sizeof(line), "rd", stats.rx_dropped);
+    len = append_u32(line, len, sizeof(line), "hm", xPortGetMinimumEverFreeHeapSize());
+    len = append_u32(line, len, sizeof(line), "id", dropped);
+    line[len++] = '\n';
+    itm_write(ITM_PORT_TEXT, line, len);
+}
+
+// 每条链路一行，ln为链路编号（COMM_LINK_*）
+static void write_stats(void) {
+    for (uint8_t link = 0; link < COMM_LINK_COUNT; link++) {
+        write_link_stats(link);
+    }
+}
+
+// 把上次以来的跟踪记录按原始格式输出，FIFO满时留到下一周期
+static void write_trace(void) {
+    uint8_t records[ITM_TRACE_CHUNK * sizeof(TraceRecord)];
+    uint32_t lost = 0;
+    while (port_ready(ITM_PORT_TRACE)) {
+        uint16_t count = trace_read(&trace_sequence, records, ITM_TRACE_CHUNK, &lost);
+        if (count == 0) {
+            break;
+        }
+        itm_write(ITM_PORT_TRACE, records, (uint16_t)(count * sizeof(TraceRecord)));
+    }
+}
+
+// 定时器任务中执行，调试器未打开端口时什么也不做
+static void stats_callback(TimerHandle_t timer) {
+    (void)timer;
+    if (itm_port_enabled(ITM_PORT_TEXT)) {
+        write_stats();
+    }
+    if (itm_port_enabled(ITM_PORT_TRACE)) {
+        write_trace();
+    } else {
+        trace_sequence = trace_head; // 端口打开后从新的记录开始
+    }
+}
+
+void itm_start(void) {
+#if defined(DEBUG) && !LOG_STORE_SPI_NOR
+    // 调试器打开异步跟踪（DBGMCU_CR.TRACE_IOEN）后PB3输出SWO，MX_GPIO_Init()把它设成了模拟输入
+    GPIO_InitTypeDef gpio = {0};
+    gpio.Pin = GPIO_PIN_3;
+    gpio.Mode = GPIO_MODE_AF_PP;
+    gpio.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(GPIOB, &gpio);
+#endif
+
+    if (ITM_STATS_PERIOD_MS != 0) {
+        TimerHandle_t timer = xTimerCreateStatic("itm", pdMS_TO_TICKS(ITM_STATS_PERIOD_MS), pdTRUE, NULL,
+                                                 stats_callback, &stats_timer_buffer);
+        xTimerStart(timer, 0);
+    }
+}
@@ -0,0 +1,514 @@
+#include "log_archive.h"
+#include "crc32.h"
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+// 超级块（块0）：清除或格式化时重写，其余时间只读
+typedef struct {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t reserved;
+    uint32_t generation;     // 每次清除加1，其他代的数据块视为无效
+    uint32_t start_sequence; // 本代的第一块
+    uint32_t block_count;    // 格式化时的块数，与块设备不符（换卡）时重新格式化
+    uint32_t crc;
+} LogArchiveSuperblock;
+
+// 数据块头，crc覆盖块头（crc之前）和count条记录；未写满的块原位重写时count增加
+typedef struct {
+    uint32_t sequence;
+    uint32_t base_time;   // 块内第一条记录的时间戳（整秒）
+    uint32_t generation;
+    uint16_t magic;
+    uint16_t count;
+    int16_t min;          // 块内滤波前后温度的最小最大值，按温度筛选时整块跳过
+    int16_t max;
+    uint32_t crc;
+} LogArchiveBlockHeader;
+
+// 与闪存中的采样记录相同，滤波前温度按相对滤波后的差值截断
+typedef struct {
+    uint32_t offset_ms;   // 相对base_time
+    int16_t temperature;
+    int8_t raw_delta;
+    uint8_t sensor;
+} LogArchiveRecord;
+
+#define LOG_ARCHIVE_RECORDS ((LOG_ARCHIVE_BLOCK_SIZE - sizeof(LogArchiveBlockHeader)) / sizeof(LogArchiveRecord))
+
+typedef struct {
+    LogArchiveBlockHeader header;
+    LogArchiveRecord records[LOG_ARCHIVE_RECORDS];
+} LogArchiveBlock;
+
+static_assert(sizeof(LogArchiveBlock) == LOG_ARCHIVE_BLOCK_SIZE, "数据块按512字节定长");
+static_assert(sizeof(LogArchiveSuperblock) <= LOG_ARCHIVE_BLOCK_SIZE, "超级块超出一块");
+static_assert(offsetof(LogArchiveBlockHeader, crc) % 4 == 0, "块头在crc之前的部分须为整字（crc32_compute_segments）");
+
+#define LOG_ARCHIVE_MAGIC        0x5241474CU // "LGAR"
+#define LOG_ARCHIVE_BLOCK_MAGIC  0x4241U     // "AB"
+#define LOG_ARCHIVE_FORMAT       1U
+#define LOG_ARCHIVE_RETRY_MS     1000U       // 写入失败后重试的间隔
+
+// 写入状态只由存储任务修改，读取方和写入方都在设备锁内访问。
+// 暂存块stage[i]为第stage_first + i块，最后一块（head）正在填写；
+// 写入块设备后head留在stage[0]，未写满时下一次原位重写
+static const LogArchiveDevice *device = NULL;
+static bool mounted = false;
+static uint32_t data_blocks;          // 数据区块数（块设备块数减超级块）
+static uint32_t generation;
+static uint32_t start_sequence;
+static LogArchiveBlock stage[LOG_ARCHIVE_STAGE_BLOCKS];
+static uint32_t stage_first;
+static uint8_t stage_used;            // 1~LOG_ARCHIVE_STAGE_BLOCKS
+static bool dirty;                    // 有未写入块设备的记录
+static bool deadline_armed;
+static bool superblock_dirty;         // 清除后还没有写入新的超级块
+static uint32_t deadline_ms;
+static LogArchiveBlock cache;         // 读取方和挂载共用的一块缓存
+static bool cache_valid;
+
+static inline void lock(void) {
+    device->ops->lock(device->context);
+}
+
+static inline void unlock(void) {
+    device->ops->unlock(device->context);
+}
+
+static inline uint32_t head(void) {
+    return stage_first + stage_used - 1U;
+}
+
+static inline LogArchiveBlock *head_block(void) {
+    return &stage[stage_used - 1U];
+}
+
+// 仍保留的最旧的块
+static inline uint32_t tail(void) {
+    uint32_t oldest = head() >= data_blocks ? head() - data_blocks + 1U : 0;
+    return oldest > start_sequence ? oldest : start_sequence;
+}
+
+static inline bool read_data(uint32_t position, LogArchiveBlock *block) {
+    return device->ops->read(device->context, 1U + position, 1, block);
+}
+
+// 块头在crc之前的部分为整字，记录部分较长时由DMA写入硬件CRC
+static uint32_t block_crc(const LogArchiveBlock *block) {
+    const Crc32Segment segments[2] = {
+        { &block->header, offsetof(LogArchiveBlockHeader, crc) },
+        { block->records, block->header.count * sizeof(LogArchiveRecord) },
+    };
+    return crc32_compute_segments(segments, 2);
+}
+
+// position号数据块是本代写入的、块序号与位置相符的块
+static bool block_valid(const LogArchiveBlock *block, uint32_t position) {
+    const LogArchiveBlockHeader *header = &block->header;
+    return header->magic == LOG_ARCHIVE_BLOCK_MAGIC && header->generation == generation &&
+           header->count > 0 && header->count <= LOG_ARCHIVE_RECORDS &&
+           header->sequence >= start_sequence && header->sequence % data_blocks == position &&
+           header->crc == block_crc(block);
+}
+
+static void block_open(LogArchiveBlock *block, uint32_t sequence) {
+    memset(&block->header, 0, sizeof(block->header));
+    block->header.sequence = sequence;
+    block->header.generation = generation;
+    block->header.magic = LOG_ARCHIVE_BLOCK_MAGIC;
+    block->header.min = INT16_MAX;
+    block->header.max = INT16_MIN;
+}
+
+static inline uint64_t record_time(const LogArchiveBlock *block, uint16_t slot) {
+    return (uint64_t)block->header.base_time * 1000U + block->records[slot].offset_ms;
+}
+
+static bool write_superblock(void) {
+    LogArchiveSuperblock *super = (LogArchiveSuperblock *)&cache;
+    cache_valid = false;
+    memset(&cache, 0, sizeof(cache));
+    super->magic = LOG_ARCHIVE_MAGIC;
+    super->format = LOG_ARCHIVE_FORMAT;
+    super->generation = generation;
+    super->start_sequence = start_sequence;
+    super->block_count = data_blocks + 1U;
+    super->crc = crc32_compute_sw((const uint8_t *)super, offsetof(LogArchiveSuperblock, crc));
+    return device->ops->write(device->context, 0, 1, &cache);
+}
+
+static void stage_reset(uint32_t sequence) {
+    stage_first = sequence;
+    stage_used = 1;
+    block_open(&stage[0], sequence);
+    dirty = false;
+    deadline_armed = false;
+}
+
+static bool mount(uint32_t format_id) {
+    const LogArchiveSuperblock *super = (const LogArchiveSuperblock *)&cache;
+    cache_valid = false;
+    if (!device->ops->read(device->context, 0, 1, &cache)) {
+        return false;
+    }
+    if (super->magic == LOG_ARCHIVE_MAGIC && super->format == LOG_ARCHIVE_FORMAT &&
+        super->block_count == data_blocks + 1U &&
+        super->crc == crc32_compute_sw((const uint8_t *)super, offsetof(LogArchiveSuperblock, crc))) {
+        generation = super->generation;
+        start_sequence = super->start_sequence;
+    } else {
+        // 新卡或格式不同：换一代，之前的数据块不再读取
+        generation = (super->magic == LOG_ARCHIVE_MAGIC && super->generation == format_id) ? format_id + 1U
+                                                                                             : format_id;
+        start_sequence = 0;
+        if (!write_superblock()) {
+            return false;
+        }
+    }
+
+    // 本代第一块所在的位置保存着该位置上最新的一块（块序号s），之后的位置依次为s+1、s+2……
+    // 直到最新的块，再往后是更早一轮的块或空白块：二分查找这条链的末尾
+    uint32_t first = start_sequence % data_blocks;
+    if (!read_data(first, &cache)) {
+        return false;
+    }
+    if (!block_valid(&cache, first)) {
+        stage_reset(start_sequence); // 本代还没有写入
+        return true;
+    }
+    uint32_t sequence = cache.header.sequence;
+    uint32_t low = 1, high = data_blocks;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2U;
+        uint32_t position = (first + mid) % data_blocks;
+        if (!read_data(position, &cache)) {
+            return false;
+        }
+        if (block_valid(&cache, position) && cache.header.sequence == sequence + mid) {
+            low = mid + 1U;
+        } else {
+            high = mid;
+        }
+    }
+
+    // 最新的块放回暂存块，未写满时继续填写
+    uint32_t last = sequence + low - 1U;
+    stage_reset(last);
+    return read_data(last % data_blocks, &stage[0]) && block_valid(&stage[0], last % data_blocks);
+}
+
+bool log_archive_mount(const LogArchiveDevice *archive_device, uint32_t format_id) {
+    mounted = false;
+    if (archive_device->block_count < LOG_ARCHIVE_MIN_BLOCKS + 1U) {
+        return false;
+    }
+    device = archive_device;
+    data_blocks = archive_device->block_count - 1U;
+    superblock_dirty = false;
+    lock();
+    bool ok = mount(format_id);
+    unlock();
+    mounted = ok;
+    return ok;
+}
+
+bool log_archive_ready(void) {
+    return mounted;
+}
+
+bool log_archive_last_time(uint64_t *timestamp_ms) {
+    if (!mounted) {
+        return false;
+    }
+    lock();
+    const LogArchiveBlock *block = head_block();
+    bool found = block->header.count > 0; // 只有空的归档最新一块为空
+    if (found) {
+        *timestamp_ms = record_time(block, (uint16_t)(block->header.count - 1U));
+    }
+    unlock();
+    return found;
+}
+
+static bool stage_record(uint64_t timestamp_ms, const LogSamplePayload *sample) {
+    LogArchiveBlock *block = head_block();
+    uint64_t base_ms = (uint64_t)block->header.base_time * 1000U;
+    // 块写满、时间回拨或偏移超出32位时换块
+    if (block->header.count == LOG_ARCHIVE_RECORDS ||
+        (block->header.count > 0 && (timestamp_ms < record_time(block, (uint16_t)(block->header.count - 1U)) ||
+                                     timestamp_ms - base_ms > UINT32_MAX))) {
+        if (stage_used == LOG_ARCHIVE_STAGE_BLOCKS) {
+            return false;
+        }
+        stage_used++;
+        block = head_block();
+        block_open(block, head());
+    }
+    if (block->header.count == 0) {
+        block->header.base_time = (uint32_t)(timestamp_ms / 1000U);
+        base_ms = (uint64_t)block->header.base_time * 1000U;
+    }
+
+    int32_t raw_delta = sample->raw - sample->temperature;
+    raw_delta = raw_delta < INT8_MIN ? INT8_MIN : raw_delta > INT8_MAX ? INT8_MAX : raw_delta;
+    LogArchiveRecord *record = &block->records[block->header.count++];
+    record->offset_ms = (uint32_t)(timestamp_ms - base_ms);
+    record->temperature = sample->temperature;
+    record->raw_delta = (int8_t)raw_delta;
+    record->sensor = sample->sensor;
+
+    int16_t values[2] = { sample->temperature, (int16_t)(sample->temperature + raw_delta) };
+    for (uint8_t i = 0; i < 2; i++) {
+        if (values[i] < block->header.min) {
+            block->header.min = values[i];
+        }
+        if (values[i] > block->header.max) {
+            block->header.max = values[i];
+        }
+    }
+    dirty = true;
+    return true;
+}
+
+bool log_archive_stage(uint64_t timestamp_ms, const LogSamplePayload *sample) {
+    if (!mounted) {
+        return false;
+    }
+    lock();
+    bool ok = stage_record(timestamp_ms, sample);
+    unlock();
+    return ok;
+}
+
+// 把暂存块（最后一块为空时除外）一次写入，数据区回绕时分两次
+static bool flush(void) {
+    uint32_t count = stage_used;
+    if (head_block()->header.count == 0) {
+        count--;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        stage[i].header.crc = block_crc(&stage[i]);
+    }
+    uint32_t position = stage_first % data_blocks;
+    uint32_t first_part = count < data_blocks - position ? count : data_blocks - position;
+    if (count > 0 &&
+        (!device->ops->write(device->context, 1U + position, first_part, &stage[0]) ||
+         (first_part < count && !device->ops->write(device->context, 1U, count - first_part, &stage[first_part])))) {
+        return false;
+    }
+
+    cache_valid = false;
+    if (stage_used > 1) {
+        stage[0] = *head_block();
+        stage_first = head();
+        stage_used = 1;
+    }
+    dirty = false;
+    deadline_armed = false;
+    return true;
+}
+
+uint32_t log_archive_service(uint32_t now_ms, bool force) {
+    if (!mounted) {
+        return UINT32_MAX;
+    }
+    lock();
+    uint32_t wait = UINT32_MAX;
+    if (superblock_dirty) {
+        superblock_dirty = !write_superblock();
+        if (superblock_dirty) {
+            wait = LOG_ARCHIVE_RETRY_MS;
+        }
+    }
+    if (dirty && !superblock_dirty) {
+        if (!deadline_armed) {
+            deadline_ms = now_ms + LOG_ARCHIVE_FLUSH_MS;
+            deadline_armed = true;
+        }
+        int32_t left = (int32_t)(deadline_ms - now_ms);
+        // 暂存块用完前写入，换块时还有空闲的块
+        if (force || left <= 0 || stage_used == LOG_ARCHIVE_STAGE_BLOCKS) {
+            if (!flush()) {
+                deadline_ms = now_ms + LOG_ARCHIVE_RETRY_MS;
+                wait = LOG_ARCHIVE_RETRY_MS;
+            }
+        } else {
+            wait = (uint32_t)left;
+        }
+    }
+    unlock();
+    return wait;
+}
+
+void log_archive_clear(void) {
+    if (!mounted) {
+        return;
+    }
+    lock();
+    generation++;
+    start_sequence = head() + 1U;
+    superblock_dirty = true; // 由log_archive_service()写入，写入前复位则原有记录仍保留
+    stage_reset(start_sequence);
+    unlock();
+}
+
+// 以下读取函数由命令执行任务调用，均在设备锁内
+
+// 第sequence块：暂存的块直接使用，其余从块设备读入缓存；读取失败或块无效（掉电时未写完）时返回NULL
+static const LogArchiveBlock *fetch(uint32_t sequence) {
+    if (sequence - stage_first < stage_used) {
+        return &stage[sequence - stage_first];
+    }
+    if (cache_valid && cache.header.sequence == sequence) {
+        return &cache;
+    }
+    uint32_t position = sequence % data_blocks;
+    cache_valid = read_data(position, &cache) && block_valid(&cache, position) &&
+                  cache.header.sequence == sequence;
+    return cache_valid ? &cache : NULL;
+}
+
+static void iter_begin(LogStoreIter *iter) {
+    iter->stream = LOG_STREAM_ARCHIVE;
+    iter->page = 0;
+    iter->sequence = mounted ? tail() : 0;
+    iter->slot = 0;
+    iter->pages_left = mounted ? 1 : 0; // 归档的游标只用它表示是否已读完
+    iter->low = INT16_MIN;
+    iter->high = INT16_MAX;
+    iter->skipped = 0;
+}
+
+void log_archive_iter_begin(LogStoreIter *iter) {
+    if (!mounted) {
+        iter_begin(iter);
+        return;
+    }
+    lock();
+    iter_begin(iter);
+    unlock();
+}
+
+// 块头表明块内没有温度值落在[low, high]内；正在填写的块之后还会追加，不据此跳过
+static inline bool block_excluded(const LogStoreIter *iter, const LogArchiveBlock *block) {
+    if ((iter->low == INT16_MIN && iter->high == INT16_MAX) || iter->sequence == head()) {
+        return false;
+    }
+    return block->header.max < iter->low || block->header.min > iter->high;
+}
+
+bool log_archive_iter_next(LogStoreIter *iter, uint64_t *timestamp_ms, LogSamplePayload *sample) {
+    if (!mounted || iter->pages_left == 0) {
+        return false;
+    }
+    lock();
+    bool found = false;
+    for (;;) {
+        uint32_t oldest = tail();
+        if (iter->sequence < oldest) {
+            iter->sequence = oldest; // 已被覆盖
+            iter->slot = 0;
+            iter->skipped++;
+        }
+        if (iter->sequence > head()) {
+            iter->pages_left = 0;
+            break;
+        }
+        const LogArchiveBlock *block = fetch(iter->sequence);
+        if (block != NULL && iter->slot == 0 && block_excluded(iter, block)) {
+            iter->skipped++;
+            block = NULL;
+        }
+        if (block != NULL && iter->slot < block->header.count) {
+            const LogArchiveRecord *record = &block->records[iter->slot];
+            *timestamp_ms = record_time(block, iter->slot);
+            sample->temperature = record->temperature;
+            sample->raw = (int16_t)(record->temperature + record->raw_delta);
+            sample->sensor = record->sensor;
+            iter->slot++;
+            found = true;
+            break;
+        }
+        if (iter->sequence == head()) {
+            iter->pages_left = 0;
+            break;
+        }
+        iter->sequence++;
+        iter->slot = 0;
+    }
+    unlock();
+    return found;
+}
+
+void log_archive_seek(LogStoreIter *iter, uint64_t timestamp_ms) {
+    if (!mounted) {
+        iter_begin(iter);
+        return;
+    }
+    lock();
+    iter_begin(iter);
+
+    // 各块起始时间递增：找第一个起始时间晚于timestamp_ms的块，目标在它的前一块
+    uint32_t first = iter->sequence;
+    uint32_t low = 0, high = head() - first + 1U;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2U;
+        const LogArchiveBlock *block = fetch(first + mid);
+        if (block != NULL && block->header.count > 0 && record_time(block, 0) > timestamp_ms) {
+            high = mid;
+        } else {
+            low = mid + 1U;
+        }
+    }
+    if (low > 0) {
+        iter->sequence = first + low - 1U;
+        const LogArchiveBlock *block = fetch(iter->sequence);
+        uint16_t slot_low = 0, slot_high = block != NULL ? block->header.count : 0;
+        while (slot_low < slot_high) {
+            uint16_t mid = (uint16_t)((slot_low + slot_high) / 2U);
+            if (record_time(block, mid) < timestamp_ms) {
+                slot_low = (uint16_t)(mid + 1U);
+            } else {
+                slot_high = mid;
+            }
+        }
+        iter->slot = slot_low;
+    }
+    unlock();
+}
+
+uint32_t log_archive_iter_position(const LogStoreIter *iter) {
+    if (!mounted) {
+        return 0;
+    }
+    lock();
+    uint32_t position;
+    if (iter->pages_left == 0) {
+        position = head() * LOG_ARCHIVE_RECORDS + head_block()->header.count; // 下一条写入的记录
+    } else if (iter->sequence < tail()) {
+        position = tail() * LOG_ARCHIVE_RECORDS;
+    } else {
+        position = iter->sequence * LOG_ARCHIVE_RECORDS + iter->slot;
+    }
+    unlock();
+    return position;
+}
+
+void log_archive_iter_resume(LogStoreIter *iter, uint32_t position) {
+    if (!mounted) {
+        iter_begin(iter);
+        return;
+    }
+    lock();
+    iter_begin(iter);
+    uint32_t sequence = position / LOG_ARCHIVE_RECORDS;
+    if (sequence > head()) {
+        iter->pages_left = 0; // 还没有写入
+    } else if (sequence >= iter->sequence) {
+        iter->sequence = sequence;
+        iter->slot = (uint16_t)(position % LOG_ARCHIVE_RECORDS);
+    } // 已被覆盖时从最旧的记录开始
+    unlock();
+}
@@ -0,0 +1,202 @@
+#include "log_codec.h"
+
+#define VARINT_MAX_LENGTH 10
+
+static inline uint64_t zigzag_encode(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t zigzag_decode(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// 写入变长整数（每字节7位，最高位表示后续还有字节）
+static size_t put_varint(uint8_t *output, uint64_t value) {
+    size_t len = 0;
+    while (value >= 0x80) {
+        output[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    output[len++] = (uint8_t)value;
+    return len;
+}
+
+static bool get_varint(const uint8_t *input, size_t input_len, size_t *pos, uint64_t *value) {
+    uint64_t result = 0;
+    
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (*pos >= input_len) {
+            return false;
+        }
+        uint8_t byte = input[(*pos)++];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool log_codec_begin(LogCodecEncoder *encoder, uint8_t *output, size_t output_size) {
+    if (!output || output_size < 2) {
+        return false;
+    }
+    encoder->output = output;
+    encoder->size = output_size;
+    encoder->pos = 2; // 条目数在结束时写入
+    encoder->count = 0;
+    encoder->format = LOG_FORMAT_DELTA;
+    encoder->prev_ts = 0;
+    encoder->prev_delta = 0;
+    encoder->prev_temp = 0;
+    return true;
+}
+
+bool log_codec_begin_packed(LogCodecEncoder *encoder, uint8_t *output, size_t output_size) {
+    if (!log_codec_begin(encoder, output, output_size)) {
+        return false;
+    }
+    encoder->format = LOG_FORMAT_PACKED;
+    return true;
+}
+
+static bool put_packed(LogCodecEncoder *encoder, const TempLogEntry *entry) {
+    if (LOG_PACKED_ENTRY_SIZE > encoder->size - encoder->pos) {
+        return false;
+    }
+    uint8_t *item = encoder->output + encoder->pos;
+    uint16_t temp = (uint16_t)entry->temperature;
+    item[0] = (uint8_t)entry->timestamp;
+    item[1] = (uint8_t)(entry->timestamp >> 8);
+    item[2] = (uint8_t)(entry->timestamp >> 16);
+    item[3] = (uint8_t)(entry->timestamp >> 24);
+    item[4] = (uint8_t)entry->millisecond;
+    item[5] = (uint8_t)(entry->millisecond >> 8);
+    item[6] = (uint8_t)temp;
+    item[7] = (uint8_t)(temp >> 8);
+    encoder->pos += LOG_PACKED_ENTRY_SIZE;
+    encoder->count++;
+    return true;
+}
+
+bool log_codec_put(LogCodecEncoder *encoder, const TempLogEntry *entry) {
+    if (encoder->count >= UINT16_MAX) {
+        return false;
+    }
+    if (encoder->format == LOG_FORMAT_PACKED) {
+        return put_packed(encoder, entry);
+    }
+    
+    uint8_t item[2 * VARINT_MAX_LENGTH];
+    size_t item_len;
+    int32_t temp = entry->temperature;
+    int64_t delta = 0;
+    
+    if (encoder->count == 0) {
+        item_len = put_varint(item, entry->timestamp);
+        item_len += put_varint(item + item_len, zigzag_encode(temp));
+    } else {
+        delta = (int64_t)(entry->timestamp - encoder->prev_ts);
+        item_len = put_varint(item, zigzag_encode(delta - encoder->prev_delta));
+        item_len += put_varint(item + item_len, zigzag_encode((int64_t)temp - encoder->prev_temp));
+    }
+    
+    if (item_len > encoder->size - encoder->pos) {
+        return false; // 放不下，编码状态不变
+    }
+    for (size_t i = 0; i < item_len; i++) {
+        encoder->output[encoder->pos++] = item[i];
+    }
+    if (encoder->count > 0) {
+        encoder->prev_delta = delta;
+    }
+    encoder->prev_ts = entry->timestamp;
+    encoder->prev_temp = temp;
+    encoder->count++;
+    return true;
+}
+
+int log_codec_finish(LogCodecEncoder *encoder) {
+    encoder->output[0] = (uint8_t)(encoder->count & 0xFF);
+    encoder->output[1] = (uint8_t)(encoder->count >> 8);
+    return (int)encoder->pos;
+}
+
+int log_codec_encode(const TempLogEntry *entries, uint32_t count,
+                     uint8_t *output, size_t output_size, uint32_t *encoded) {
+    LogCodecEncoder encoder;
+    if ((count > 0 && !entries) || !log_codec_begin(&encoder, output, output_size)) {
+        return -1;
+    }
+    
+    for (uint32_t n = 0; n < count && log_codec_put(&encoder, &entries[n]); n++) {
+    }
+    
+    if (encoded) {
+        *encoded = encoder.count;
+    }
+    return log_codec_finish(&encoder);
+}
+
+int log_codec_decode(const uint8_t *input, size_t input_len,
+                     TempLogEntry *entries, uint32_t max_entries) {
+    if (!input || input_len < 2) {
+        return -1;
+    }
+    
+    uint32_t count = input[0] | ((uint32_t)input[1] << 8);
+    if (count > max_entries) {
+        return -1;
+    }
+    
+    size_t pos = 2;
+    uint64_t ts = 0;
+    int64_t delta = 0;
+    int64_t temp = 0;
+    
+    for (uint32_t n = 0; n < count; n++) {
+        uint64_t ts_field, temp_field;
+        if (!get_varint(input, input_len, &pos, &ts_field) ||
+            !get_varint(input, input_len, &pos, &temp_field)) {
+            return -1;
+        }
+        
+        if (n == 0) {
+            ts = ts_field;
+            temp = zigzag_decode(temp_field);
+        } else {
+            delta += zigzag_decode(ts_field);
+            ts += (uint64_t)delta;
+            temp += zigzag_decode(temp_field);
+        }
+        
+        entries[n].timestamp = ts;
+        if (temp < INT16_MIN || temp > INT16_MAX) {
+            return -1;
+        }
+        entries[n].temperature = (int16_t)temp;
+    }
+    
+    return pos == input_len ? (int)count : -1;
+}
+
+int log_codec_decode_packed(const uint8_t *input, size_t input_len,
+                            TempLogEntry *entries, uint32_t max_entries) {
+    if (!input || input_len < 2) {
+        return -1;
+    }
+    
+    uint32_t count = input[0] | ((uint32_t)input[1] << 8);
+    if (count > max_entries || input_len != 2 + (size_t)count * LOG_PACKED_ENTRY_SIZE) {
+        return -1;
+    }
+    
+    for (uint32_t n = 0; n < count; n++) {
+        const uint8_t *item = input + 2 + n * LOG_PACKED_ENTRY_SIZE;
+        entries[n].timestamp = item[0] | ((uint32_t)item[1] << 8) | ((uint32_t)item[2] << 16) | ((uint32_t)item[3] << 24);
+        entries[n].millisecond = (uint16_t)(item[4] | (item[5] << 8));
+        entries[n].temperature = (int16_t)(item[6] | (item[7] << 8));
+    }
+    return (int)count;
+}
@@ -0,0 +1,148 @@
+#include "log_compress.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+// 每个传感器的压缩状态，只由记录任务访问。
+// 旋转门的两扇门用斜率表示：从保存点出发的直线斜率不低于保存点之后各点(v - E)的斜率的最大值，
+// 不高于各点(v + E)的斜率的最小值；新读数落在门外时门已打开。
+// 斜率保存为分数（0.1°C / 毫秒），比较时交叉相乘，不经过浮点运算
+typedef struct {
+    bool started;              // archived有效
+    bool holding;              // held为已收到、尚未决定是否保存的点
+    LogCompressPoint archived; // 最近保存的点
+    LogCompressPoint held;
+    int32_t min_rise;          // 斜率下界 min_rise / min_dt
+    uint32_t min_dt;
+    int32_t max_rise;          // 斜率上界 max_rise / max_dt
+    uint32_t max_dt;
+} LogCompressState;
+
+static LogCompressState states[TEMP_MAX_SENSORS];
+static LogCompressConfig configs[TEMP_MAX_SENSORS]; // 访问时进入临界段，默认全零即不压缩
+static volatile uint8_t config_changed = 0;         // 配置已修改的传感器（位）
+
+bool log_compress_config_valid(const LogCompressConfig *config) {
+    return config->mode <= LOG_COMPRESS_SWINGING_DOOR &&
+           config->tolerance >= 0 && config->tolerance <= LOG_COMPRESS_MAX_TOLERANCE &&
+           (config->heartbeat_ms == 0 || config->heartbeat_ms >= LOG_COMPRESS_MIN_HEARTBEAT_MS);
+}
+
+void log_compress_configure(uint8_t sensor, const LogCompressConfig *config) {
+    if (sensor >= TEMP_MAX_SENSORS) {
+        return;
+    }
+    taskENTER_CRITICAL();
+    configs[sensor] = *config;
+    config_changed |= (uint8_t)(1U << sensor);
+    taskEXIT_CRITICAL();
+}
+
+void log_compress_get_config(uint8_t sensor, LogCompressConfig *config) {
+    if (sensor >= TEMP_MAX_SENSORS) {
+        *config = (LogCompressConfig){ LOG_COMPRESS_NONE, 0, 0 };
+        return;
+    }
+    taskENTER_CRITICAL();
+    *config = configs[sensor];
+    taskEXIT_CRITICAL();
+}
+
+void log_compress_reset(void) {
+    taskENTER_CRITICAL();
+    for (uint8_t i = 0; i < TEMP_MAX_SENSORS; i++) {
+        configs[i] = (LogCompressConfig){ LOG_COMPRESS_NONE, 0, 0 };
+        states[i] = (LogCompressState){ 0 };
+    }
+    config_changed = 0;
+    taskEXIT_CRITICAL();
+}
+
+// a_rise / a_dt < b_rise / b_dt（dt均大于0）
+static inline bool slope_less(int32_t a_rise, uint32_t a_dt, int32_t b_rise, uint32_t b_dt) {
+    return (int64_t)a_rise * b_dt < (int64_t)b_rise * a_dt;
+}
+
+static inline void archive(LogCompressState *state, const LogCompressPoint *point) {
+    state->archived = *point;
+    state->started = true;
+    state->holding = false;
+}
+
+// 以archived为起点、point为第一个暂存点打开两扇门
+static void open_doors(LogCompressState *state, const LogCompressPoint *point, int16_t tolerance) {
+    uint32_t dt = (uint32_t)(point->timestamp_ms - state->archived.timestamp_ms);
+    int32_t rise = point->temperature - state->archived.temperature;
+    state->min_rise = rise - tolerance;
+    state->min_dt = dt;
+    state->max_rise = rise + tolerance;
+    state->max_dt = dt;
+    state->held = *point;
+    state->holding = true;
+}
+
+uint8_t log_compress_feed(uint8_t sensor, const LogCompressPoint *point, LogCompressPoint *points) {
+    if (sensor >= TEMP_MAX_SENSORS) {
+        points[0] = *point;
+        return 1;
+    }
+
+    taskENTER_CRITICAL();
+    LogCompressConfig config = configs[sensor];
+    bool restart = (config_changed & (1U << sensor)) != 0;
+    config_changed &= (uint8_t)~(1U << sensor);
+    taskEXIT_CRITICAL();
+
+    LogCompressState *state = &states[sensor];
+    uint8_t n = 0;
+    if (restart) {
+        state->started = false;
+    }
+
+    // 起点、不压缩、时间回拨（RTC被设置）或心跳到期：保存暂存的点和本点，从本点重新开始
+    uint64_t dt = point->timestamp_ms - state->archived.timestamp_ms;
+    if (!state->started || config.mode == LOG_COMPRESS_NONE ||
+        point->timestamp_ms <= state->archived.timestamp_ms || dt > UINT32_MAX ||
+        (config.heartbeat_ms != 0 && dt >= config.heartbeat_ms)) {
+        if (state->holding) {
+            points[n++] = state->held;
+        }
+        archive(state, point);
+        points[n++] = *point;
+        return n;
+    }
+
+    if (config.mode == LOG_COMPRESS_DEADBAND) {
+        int32_t change = point->temperature - state->archived.temperature;
+        if (change > config.tolerance || change < -config.tolerance) {
+            archive(state, point);
+            points[n++] = *point;
+        }
+        return n;
+    }
+
+    if (!state->holding) {
+        open_doors(state, point, config.tolerance);
+        return n;
+    }
+
+    // 从保存点到本点的直线仍在门内时，本点代替暂存点，之前各点的误差都不超过容差
+    int32_t rise = point->temperature - state->archived.temperature;
+    if (slope_less(rise, (uint32_t)dt, state->min_rise, state->min_dt) ||
+        slope_less(state->max_rise, state->max_dt, rise, (uint32_t)dt)) {
+        // 门已打开：保存暂存点，从它重新打开门
+        points[n++] = state->held;
+        archive(state, &state->held);
+        open_doors(state, point, config.tolerance);
+        return n;
+    }
+    if (slope_less(state->min_rise, state->min_dt, rise - config.tolerance, (uint32_t)dt)) {
+        state->min_rise = rise - config.tolerance;
+        state->min_dt = (uint32_t)dt;
+    }
+    if (slope_less(rise + config.tolerance, (uint32_t)dt, state->max_rise, state->max_dt)) {
+        state->max_rise = rise + config.tolerance;
+        state->max_dt = (uint32_t)dt;
+    }
+    state->held = *point;
+    return n;
+}
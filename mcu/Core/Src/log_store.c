@@ -0,0 +1,1109 @@
+#include "log_store.h"
+#include "log_archive.h"
+#include "config_store.h"
+#include "storage_task.h"
+#include "spi_nor.h"
+#include "warm_state.h"
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "cmsis_os.h"
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#if !LOG_STORE_SPI_NOR
+#define LOG_STORE_STREAM_BASE      LOG_STORE_BASE
+#define LOG_STORE_STREAM_PAGE_SIZE LOG_STORE_PAGE_SIZE
+#define LOG_STORE_STREAM_PAGES     (LOG_STORE_PAGES - CONFIG_STORE_PAGES)
+#endif
+
+// 页头：页序号在打开新页时加1，magic最后写入，magic不对的页视为无效
+typedef struct {
+    uint32_t sequence;
+    uint32_t base_time;  // 页内记录的时间基准（第一条记录的时间戳，整秒）
+    uint16_t magic;
+    uint16_t format;     // 低字节为记录格式，高字节为日志流编号
+} LogPageHeader;
+
+// 页摘要（区域映射），紧接页头，换页时为写满的旧页编程，commit最后写入；
+// 活动页和掉电时未写摘要的页没有摘要，读取时不据此跳过。
+// 页内第一条记录的时间即页头的base_time（整秒），摘要中只记最后一条
+typedef struct {
+    uint32_t last_offset; // 最后一条记录相对base_time的毫秒数
+    int16_t min;          // 页内各记录的温度值（见LogStreamConfig的value_offsets）的最小值
+    int16_t max;
+    uint16_t count;       // 已提交的记录数
+    uint16_t commit;
+} LogPageIndex;
+
+#define LOG_INDEX_COMMIT 0x5A5AU
+
+// 按行存放的页（汇总和事件流）内的一条记录：| 相对base_time的毫秒数 uint32 | 载荷 | commit uint8 |，
+// 全部按半字编程；载荷最后一个字节与commit同在最后一个半字，最后写入，
+// 编程中途掉电的记录没有commit，读取时跳过
+#define LOG_RECORD_OVERHEAD 5U
+#define LOG_RECORD_COMMIT   0x5AU
+
+// 采样流的页按列存放（columns）：页摘要之后是各传感器的温度基准（int16，在该传感器
+// 页内第一条记录之前写入，不取擦除值-1），之后分为三列，每列每条记录一个半字，
+// 同一列的各条记录连续存放：
+// | 秒偏移列：相对base_time的秒数 |
+// | 温度列：低字节为滤波后温度相对基准的int8差值，高字节为滤波前相对滤波后的差值 |
+// | 毫秒列：低10位为毫秒，10~11位为传感器，高4位为commit，最后写入 |
+// 每条记录6字节。温度超出基准±12.7°C、秒偏移超出16位时换页；滤波前后相差超过12.7°C时
+// 滤波前温度按差值截断。按时间查找只读秒偏移列（同一秒内再读毫秒列），不读温度列。
+// 闪存按半字编程且每个半字只能编程一次，因此各列按半字定长，不跨记录按位压缩
+#define LOG_COLUMN_COUNT       3U
+#define LOG_COLUMN_SECONDS     0U
+#define LOG_COLUMN_VALUES      1U
+#define LOG_COLUMN_META        2U
+#define LOG_COLUMN_MAX_SECONDS 0xFFFEU  // 0xFFFF为擦除值，空白记录的各列均为擦除值
+#define LOG_COLUMN_COMMIT      0xAU
+#define LOG_COLUMN_NO_BASE     ((int16_t)-1)
+
+#define LOG_PAGE_MAGIC   0x474CU // "LG"
+#define LOG_PAGE_FORMAT  5U      // 1为不压缩的12字节记录，2为16位秒偏移，3为无页摘要，4为采样按行存放，升级后旧页按无效页擦除
+#define LOG_NO_PAGE      0xFFFFU
+#define LOG_MOUNT_PROBE_PAGES 2U // 启动查找活动页时，结果之后检查的页数
+
+// 各日志流在日志区中的位置（页编号相对LOG_STORE_STREAM_BASE）和记录长度
+typedef struct {
+    uint16_t first_page;
+    uint16_t page_count;
+    uint8_t record_size; // 含偏移和commit，必须为偶数；按列存放时为各列之和
+    uint8_t value_offsets[2]; // 计入页摘要最小最大值的两个int16温度在载荷中的偏移
+    bool columns;        // 按列存放（只用于LogSamplePayload）
+} LogStreamConfig;
+
+static const LogStreamConfig stream_configs[LOG_STREAM_COUNT] = {
+    [LOG_STREAM_SAMPLES] = { 0, LOG_STORE_SAMPLE_PAGES,
+                             LOG_COLUMN_COUNT * 2U,
+                             { offsetof(LogSamplePayload, temperature), offsetof(LogSamplePayload, raw) }, true },
+    [LOG_STREAM_ROLLUPS] = { LOG_STORE_SAMPLE_PAGES, LOG_STORE_ROLLUP_PAGES,
+                             sizeof(LogRollupPayload) + LOG_RECORD_OVERHEAD,
+                             { offsetof(LogRollupPayload, min), offsetof(LogRollupPayload, max) }, false },
+    [LOG_STREAM_EVENTS]  = { LOG_STORE_SAMPLE_PAGES + LOG_STORE_ROLLUP_PAGES, LOG_STORE_EVENT_PAGES,
+                             sizeof(LogEventPayload) + LOG_RECORD_OVERHEAD,
+                             { offsetof(LogEventPayload, temperature), offsetof(LogEventPayload, temperature) }, false },
+    [LOG_STREAM_BURSTS]  = { LOG_STORE_SAMPLE_PAGES + LOG_STORE_ROLLUP_PAGES + LOG_STORE_EVENT_PAGES,
+                             LOG_STORE_BURST_PAGES, sizeof(LogBurstPayload) + LOG_RECORD_OVERHEAD,
+                             { offsetof(LogBurstPayload, temperatures), offsetof(LogBurstPayload, temperatures) + 2U }, false },
+};
+
+static_assert(sizeof(LogPageHeader) % 2 == 0 && sizeof(LogPageIndex) % 2 == 0, "闪存按半字编程");
+static_assert(LOG_STORE_SAMPLE_PAGES + LOG_STORE_ROLLUP_PAGES + LOG_STORE_EVENT_PAGES + LOG_STORE_BURST_PAGES <=
+              LOG_STORE_STREAM_PAGES,
+              "日志流超出日志区");
+#if LOG_STORE_SPI_NOR
+static_assert(LOG_STORE_STREAM_PAGE_SIZE == SPI_NOR_SECTOR_SIZE && LOG_STORE_STREAM_BASE % SPI_NOR_SECTOR_SIZE == 0,
+              "日志页须与擦除扇区对齐");
+#endif
+static_assert(LOG_STORE_SAMPLE_PAGES >= 2 && LOG_STORE_ROLLUP_PAGES >= 2 && LOG_STORE_EVENT_PAGES >= 2 &&
+              LOG_STORE_BURST_PAGES >= 2,
+              "每个流至少两页（活动页和提前擦除的下一页）");
+static_assert((sizeof(LogRollupPayload) + LOG_RECORD_OVERHEAD) % 2 == 0 &&
+              (sizeof(LogEventPayload) + LOG_RECORD_OVERHEAD) % 2 == 0 &&
+              (sizeof(LogBurstPayload) + LOG_RECORD_OVERHEAD) % 2 == 0, "记录长度必须为偶数");
+static_assert(LOG_STORE_MAX_SENSORS <= 4, "毫秒列中传感器只占2位");
+static_assert(LOG_STORE_MAX_PAYLOAD >= sizeof(LogSamplePayload) &&
+              LOG_STORE_MAX_PAYLOAD >= sizeof(LogRollupPayload) &&
+              LOG_STORE_MAX_PAYLOAD >= sizeof(LogEventPayload) &&
+              LOG_STORE_MAX_PAYLOAD >= sizeof(LogBurstPayload), "待写队列放不下载荷");
+
+// 各流的写入状态，只由存储任务修改（初始化除外）。
+// 换页、擦除时用version做seqlock：修改前后各加1，奇数表示正在修改；通信任务读取
+// 页头和记录前后比较version，不同则重试，不加锁，存储任务不会因读取方而阻塞。
+// 活动页内追加记录不改变version（commit字节最后写入，读取方看不到半条记录）
+typedef struct {
+    uint32_t version;
+    uint16_t active;     // 正在写入的页（流内编号），LOG_NO_PAGE表示还没有任何页
+    uint16_t write_slot; // 活动页中下一条记录的位置
+    uint32_t sequence;   // 活动页的页序号
+    uint32_t base_time;  // 活动页的时间基准
+    bool next_erased;    // 活动页的下一页已擦除
+    LogPageIndex index;  // 活动页的摘要，换页时写入闪存
+} LogStreamState;
+
+static LogStreamState streams[LOG_STREAM_COUNT];
+
+// 待写队列：各流共用，记录任务和采样任务入队，存储任务出队，访问时进入临界段
+typedef struct {
+    uint64_t timestamp_ms;
+    uint8_t stream;
+    uint8_t payload[LOG_STORE_MAX_PAYLOAD];
+} LogPendingRecord;
+
+// 热复位后保留（warm_state.h），复位前还没写入闪存的记录在复位后写入；
+// 每次入队、出队在临界段内封装（约400字节的软件CRC）
+static WARM_STATE struct {
+    WarmState state;
+    LogPendingRecord records[LOG_STORE_PENDING];
+    uint8_t head;
+    uint8_t count;
+} pending;
+static volatile bool clear_requested = false;
+#if LOG_STORE_SPI_NOR
+static bool nor_ready = false;   // 外置闪存已识别且容量足够
+static bool nor_clearing = false; // 正在整片擦除（清除日志）
+#endif
+
+static inline void write_begin(uint8_t stream) {
+    __atomic_store_n(&streams[stream].version, streams[stream].version + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void write_end(uint8_t stream) {
+    __atomic_store_n(&streams[stream].version, streams[stream].version + 1, __ATOMIC_RELEASE);
+}
+
+// 正在修改时让出CPU等待（存储任务优先级较低，忙等会使它无法完成修改）
+static uint32_t read_begin(uint8_t stream) {
+    uint32_t version;
+    while ((version = __atomic_load_n(&streams[stream].version, __ATOMIC_ACQUIRE)) & 1U) {
+        osDelay(1);
+    }
+    return version;
+}
+
+static inline bool read_retry(uint8_t stream, uint32_t version) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&streams[stream].version, __ATOMIC_RELAXED) != version;
+}
+
+#define LOG_PAGE_RECORDS_OFFSET (sizeof(LogPageHeader) + sizeof(LogPageIndex))
+
+// 日志区的读取：片内闪存直接复制，外置闪存经SPI读取（失败时按擦除值处理，页无效或为空白记录）
+#if LOG_STORE_SPI_NOR
+static void flash_read(uint32_t address, void *data, uint32_t size) {
+    if (!nor_ready || !spi_nor_read(address, data, size)) {
+        memset(data, 0xFF, size);
+    }
+}
+#else
+static inline void flash_read(uint32_t address, void *data, uint32_t size) {
+    memcpy(data, (const void *)address, size);
+}
+#endif
+
+// 记录区在页内的偏移，按列存放的页在温度基准之后
+static inline uint32_t records_offset(uint8_t stream) {
+    return LOG_PAGE_RECORDS_OFFSET + (stream_configs[stream].columns ? LOG_STORE_MAX_SENSORS * 2U : 0U);
+}
+
+static inline uint16_t page_slots(uint8_t stream) {
+    return (uint16_t)((LOG_STORE_STREAM_PAGE_SIZE - records_offset(stream)) / stream_configs[stream].record_size);
+}
+
+static inline uint32_t page_address(uint8_t stream, uint16_t page) {
+    return LOG_STORE_STREAM_BASE + (uint32_t)(stream_configs[stream].first_page + page) * LOG_STORE_STREAM_PAGE_SIZE;
+}
+
+static inline LogPageHeader page_header(uint8_t stream, uint16_t page) {
+    LogPageHeader header;
+    flash_read(page_address(stream, page), &header, sizeof(header));
+    return header;
+}
+
+static inline LogPageIndex page_index(uint8_t stream, uint16_t page) {
+    LogPageIndex index;
+    flash_read(page_address(stream, page) + sizeof(LogPageHeader), &index, sizeof(index));
+    return index;
+}
+
+static inline uint32_t slot_address(uint8_t stream, uint16_t page, uint16_t slot) {
+    return page_address(stream, page) + records_offset(stream) +
+           (uint32_t)slot * stream_configs[stream].record_size;
+}
+
+static inline uint32_t base_address(uint8_t stream, uint16_t page, uint8_t sensor) {
+    return page_address(stream, page) + LOG_PAGE_RECORDS_OFFSET + sensor * 2U;
+}
+
+static inline int16_t column_base(uint8_t stream, uint16_t page, uint8_t sensor) {
+    int16_t base;
+    flash_read(base_address(stream, page, sensor), &base, sizeof(base));
+    return base;
+}
+
+static inline uint32_t cell_address(uint8_t stream, uint16_t page, uint8_t column, uint16_t slot) {
+    return page_address(stream, page) + records_offset(stream) +
+           ((uint32_t)column * page_slots(stream) + slot) * 2U;
+}
+
+static inline uint16_t column_cell(uint8_t stream, uint16_t page, uint8_t column, uint16_t slot) {
+    uint16_t cell;
+    flash_read(cell_address(stream, page, column, slot), &cell, sizeof(cell));
+    return cell;
+}
+
+// 记录相对base_time的毫秒数；按行存放的记录只按半字对齐
+static inline uint32_t slot_offset(uint8_t stream, uint16_t page, uint16_t slot) {
+    if (stream_configs[stream].columns) {
+        return column_cell(stream, page, LOG_COLUMN_SECONDS, slot) * 1000U +
+               (column_cell(stream, page, LOG_COLUMN_META, slot) & 0x3FFU);
+    }
+    uint32_t offset;
+    flash_read(slot_address(stream, page, slot), &offset, sizeof(offset));
+    return offset;
+}
+
+static inline uint8_t payload_size(uint8_t stream) {
+    return stream_configs[stream].columns ? (uint8_t)sizeof(LogSamplePayload)
+                                          : (uint8_t)(stream_configs[stream].record_size - LOG_RECORD_OVERHEAD);
+}
+
+static inline uint64_t page_base_ms(uint8_t stream, uint16_t page) {
+    return (uint64_t)page_header(stream, page).base_time * 1000U;
+}
+
+static inline bool slot_committed(uint8_t stream, uint16_t page, uint16_t slot) {
+    if (stream_configs[stream].columns) {
+        return (column_cell(stream, page, LOG_COLUMN_META, slot) >> 12) == LOG_COLUMN_COMMIT;
+    }
+    uint8_t commit;
+    flash_read(slot_address(stream, page, slot) + stream_configs[stream].record_size - 1U, &commit, 1);
+    return commit == LOG_RECORD_COMMIT;
+}
+
+// 读出已提交的一条记录的时间戳和载荷
+static void slot_read(uint8_t stream, uint16_t page, uint16_t slot, uint64_t *timestamp_ms, void *payload) {
+    *timestamp_ms = page_base_ms(stream, page) + slot_offset(stream, page, slot);
+    if (!stream_configs[stream].columns) {
+        flash_read(slot_address(stream, page, slot) + 4U, payload, stream_configs[stream].record_size - LOG_RECORD_OVERHEAD);
+        return;
+    }
+    uint16_t values = column_cell(stream, page, LOG_COLUMN_VALUES, slot);
+    uint8_t sensor = (uint8_t)((column_cell(stream, page, LOG_COLUMN_META, slot) >> 10) & 0x3U);
+    LogSamplePayload sample;
+    sample.temperature = (int16_t)(column_base(stream, page, sensor) + (int8_t)(values & 0xFFU));
+    sample.raw = (int16_t)(sample.temperature + (int8_t)(values >> 8));
+    sample.sensor = sensor;
+    memcpy(payload, &sample, sizeof(sample));
+}
+
+static inline uint16_t page_format(uint8_t stream) {
+    return (uint16_t)(LOG_PAGE_FORMAT | (stream << 8));
+}
+
+static bool page_valid(uint8_t stream, uint16_t page) {
+    LogPageHeader header = page_header(stream, page);
+    return header.magic == LOG_PAGE_MAGIC && header.format == page_format(stream);
+}
+
+// 分段读出比较，整页检查时每段一次SPI读取
+static bool halfwords_blank(uint32_t address, uint32_t size) {
+    uint16_t halfwords[32];
+    for (uint32_t done = 0; done < size; done += sizeof(halfwords)) {
+        uint32_t chunk = size - done < sizeof(halfwords) ? size - done : sizeof(halfwords);
+        flash_read(address + done, halfwords, chunk);
+        for (uint32_t i = 0; i < chunk / 2; i++) {
+            if (halfwords[i] != 0xFFFFU) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static inline bool slot_blank(uint8_t stream, uint16_t page, uint16_t slot) {
+    if (stream_configs[stream].columns) {
+        for (uint8_t column = 0; column < LOG_COLUMN_COUNT; column++) {
+            if (column_cell(stream, page, column, slot) != 0xFFFFU) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return halfwords_blank(slot_address(stream, page, slot), stream_configs[stream].record_size);
+}
+
+static inline bool page_blank(uint8_t stream, uint16_t page) {
+    return halfwords_blank(page_address(stream, page), LOG_STORE_STREAM_PAGE_SIZE);
+}
+
+static inline uint16_t next_page(uint8_t stream) {
+    const LogStreamState *state = &streams[stream];
+    return state->active == LOG_NO_PAGE ? 0 : (uint16_t)((state->active + 1) % stream_configs[stream].page_count);
+}
+
+#if LOG_STORE_SPI_NOR
+static bool flash_erase(uint8_t stream, uint16_t page) {
+    return nor_ready && spi_nor_erase_sector(page_address(stream, page));
+}
+
+static bool flash_program(uint32_t address, const void *data, uint32_t size) {
+    return nor_ready && spi_nor_program(address, data, size);
+}
+#else
+static bool flash_erase(uint8_t stream, uint16_t page) {
+    FLASH_EraseInitTypeDef erase = {
+        .TypeErase = FLASH_TYPEERASE_PAGES,
+        .Banks = FLASH_BANK_1,
+        .PageAddress = page_address(stream, page),
+        .NbPages = 1,
+    };
+    uint32_t page_error = 0;
+    return HAL_FLASHEx_Erase(&erase, &page_error) == HAL_OK;
+}
+
+// 擦写只在log_store_service()中进行，由它在开始时解锁闪存、结束时上锁，
+// 一次唤醒的全部记录连续编程
+static bool flash_program(uint32_t address, const void *data, uint32_t size) {
+    const uint8_t *bytes = data;
+    bool ok = true;
+    for (uint32_t i = 0; i < size && ok; i += 2) {
+        uint16_t halfword = (uint16_t)(bytes[i] | (bytes[i + 1] << 8));
+        ok = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, address + i, halfword) == HAL_OK;
+    }
+    return ok;
+}
+#endif
+
+// 擦除一页：有效页先把magic编程为0。擦除中途掉电时页内为新旧数据的混合，页序号可能
+// 已部分擦除（变大）而magic仍在，不能被当作有效页（片内闪存允许在已编程的半字上写0）
+static bool page_erase(uint8_t stream, uint16_t page) {
+    static const uint16_t invalid = 0;
+    if (page_valid(stream, page) &&
+        !flash_program(page_address(stream, page) + offsetof(LogPageHeader, magic), &invalid, sizeof(invalid))) {
+        return false;
+    }
+    return flash_erase(stream, page);
+}
+
+static void index_reset(LogPageIndex *index) {
+    *index = (LogPageIndex){ .min = INT16_MAX, .max = INT16_MIN, .commit = LOG_INDEX_COMMIT };
+}
+
+static void index_add(uint8_t stream, LogPageIndex *index, uint32_t offset, const uint8_t *payload) {
+    for (uint8_t i = 0; i < 2; i++) {
+        int16_t value;
+        memcpy(&value, payload + stream_configs[stream].value_offsets[i], sizeof(value));
+        if (value < index->min) {
+            index->min = value;
+        }
+        if (value > index->max) {
+            index->max = value;
+        }
+    }
+    index->last_offset = offset;
+    index->count++;
+}
+
+// 为写满（或因时间戳换页）的活动页写入摘要，没有记录的页不写
+static void close_active(uint8_t stream) {
+    const LogStreamState *state = &streams[stream];
+    if (state->active == LOG_NO_PAGE || state->index.count == 0 ||
+        page_index(stream, state->active).commit != 0xFFFFU) {
+        return;
+    }
+    uint32_t address = page_address(stream, state->active) + sizeof(LogPageHeader);
+    if (flash_program(address, &state->index, sizeof(LogPageIndex) - 2U)) {
+        flash_program(address + sizeof(LogPageIndex) - 2U, &state->index.commit, 2);
+    }
+}
+
+// 记录能否按偏移存入活动页（时间戳早于基准或超出32位毫秒偏移时换页；
+// 按列存放时秒偏移超出16位或温度超出该传感器的基准±12.7°C时换页）
+static bool fits_active(uint8_t stream, const LogPendingRecord *record) {
+    const LogStreamState *state = &streams[stream];
+    uint64_t base_ms = (uint64_t)state->base_time * 1000U;
+    uint64_t timestamp_ms = record->timestamp_ms;
+    if (state->active == LOG_NO_PAGE || state->write_slot >= page_slots(stream) ||
+        timestamp_ms < base_ms || timestamp_ms - base_ms > UINT32_MAX) {
+        return false;
+    }
+    if (!stream_configs[stream].columns) {
+        return true;
+    }
+    LogSamplePayload sample;
+    memcpy(&sample, record->payload, sizeof(sample));
+    int16_t base = column_base(stream, state->active, sample.sensor);
+    int32_t delta = sample.temperature - base;
+    return timestamp_ms / 1000U - state->base_time <= LOG_COLUMN_MAX_SECONDS &&
+           (base == LOG_COLUMN_NO_BASE || (delta >= INT8_MIN && delta <= INT8_MAX));
+}
+
+// 活动页放不下时打开下一页，下一页未预先擦除时在这里擦除
+static bool ensure_slot(uint8_t stream, const LogPendingRecord *record) {
+    if (fits_active(stream, record)) {
+        return true;
+    }
+    uint64_t timestamp_ms = record->timestamp_ms;
+
+    LogStreamState *state = &streams[stream];
+    uint16_t page = next_page(stream);
+    write_begin(stream);
+    close_active(stream);
+    if (!state->next_erased && !page_erase(stream, page)) {
+        write_end(stream);
+        return false;
+    }
+
+    LogPageHeader header = {
+        .sequence = state->sequence + 1,
+        .base_time = (uint32_t)(timestamp_ms / 1000U),
+        .magic = LOG_PAGE_MAGIC,
+        .format = page_format(stream),
+    };
+    state->active = page;
+    state->sequence = header.sequence;
+    state->base_time = header.base_time;
+    state->write_slot = 0;
+    state->next_erased = false;
+    index_reset(&state->index);
+    bool ok = flash_program(page_address(stream, page), &header, sizeof(header));
+    if (!ok) {
+        state->write_slot = page_slots(stream); // 页头无效，下次换下一页
+    }
+    write_end(stream);
+    return ok;
+}
+
+// 按列写入一条采样记录，需要时先写入传感器的温度基准；返回实际保存的载荷（滤波前温度可能截断）
+static bool write_columns(uint8_t stream, uint16_t slot, const LogPendingRecord *record, LogSamplePayload *stored) {
+    LogStreamState *state = &streams[stream];
+    uint16_t page = state->active;
+    memcpy(stored, record->payload, sizeof(*stored));
+
+    int16_t base = column_base(stream, page, stored->sensor);
+    if (base == LOG_COLUMN_NO_BASE) {
+        base = stored->temperature == LOG_COLUMN_NO_BASE ? 0 : stored->temperature;
+        if (!flash_program(base_address(stream, page, stored->sensor), &base, sizeof(base))) {
+            state->write_slot = page_slots(stream); // 基准无效，下次换下一页
+            return false;
+        }
+    }
+
+    int32_t raw_delta = stored->raw - stored->temperature;
+    raw_delta = raw_delta < INT8_MIN ? INT8_MIN : raw_delta > INT8_MAX ? INT8_MAX : raw_delta;
+    stored->raw = (int16_t)(stored->temperature + raw_delta);
+    uint16_t seconds = (uint16_t)(record->timestamp_ms / 1000U - state->base_time);
+    uint16_t values = (uint16_t)((uint8_t)(int8_t)(stored->temperature - base) |
+                                 ((uint16_t)(uint8_t)(int8_t)raw_delta << 8));
+    uint16_t meta = (uint16_t)((record->timestamp_ms % 1000U) | ((uint16_t)stored->sensor << 10) |
+                               (LOG_COLUMN_COMMIT << 12));
+    return flash_program(cell_address(stream, page, LOG_COLUMN_SECONDS, slot), &seconds, 2) &&
+           flash_program(cell_address(stream, page, LOG_COLUMN_VALUES, slot), &values, 2) &&
+           flash_program(cell_address(stream, page, LOG_COLUMN_META, slot), &meta, 2);
+}
+
+static void write_record(const LogPendingRecord *record) {
+    uint8_t stream = record->stream;
+    if (!ensure_slot(stream, record)) {
+        return; // 擦写失败，丢弃该记录
+    }
+
+    LogStreamState *state = &streams[stream];
+    if (stream_configs[stream].columns) {
+        LogSamplePayload stored;
+        uint16_t slot = state->write_slot++;
+        if (write_columns(stream, slot, record, &stored)) {
+            index_add(stream, &state->index, slot_offset(stream, state->active, slot), (const uint8_t *)&stored);
+        }
+        return;
+    }
+
+    uint8_t size = stream_configs[stream].record_size;
+    uint8_t data[LOG_STORE_MAX_PAYLOAD + LOG_RECORD_OVERHEAD + 1];
+    uint32_t offset = (uint32_t)(record->timestamp_ms - (uint64_t)state->base_time * 1000U);
+    memcpy(data, &offset, sizeof(offset));
+    memcpy(data + sizeof(offset), record->payload, size - LOG_RECORD_OVERHEAD);
+    data[size - 1] = LOG_RECORD_COMMIT;
+
+    // 最后一个半字（载荷末字节与commit）单独最后编程
+    uint32_t address = slot_address(stream, state->active, state->write_slot);
+    state->write_slot++;
+    if (flash_program(address, data, size - 2U) &&
+        flash_program(address + size - 2U, data + size - 2U, 2)) {
+        index_add(stream, &state->index, offset, record->payload);
+    }
+}
+
+static bool pending_pop(LogPendingRecord *record) {
+    bool ok = false;
+    taskENTER_CRITICAL();
+    if (pending.count > 0) {
+        *record = pending.records[pending.head];
+        pending.head = (uint8_t)((pending.head + 1) % LOG_STORE_PENDING);
+        pending.count--;
+        warm_state_seal(&pending.state);
+        ok = true;
+    }
+    taskEXIT_CRITICAL();
+    if (ok) {
+        storage_task_wake();
+    }
+    return ok;
+}
+
+// 外置闪存逐页擦除需要数分钟，改为整片擦除，各流先置为空（读取方不再读闪存），
+// 擦除完成后才写入（log_store_service()）
+static void erase_all(void) {
+    for (uint8_t stream = 0; stream < LOG_STREAM_COUNT; stream++) {
+        write_begin(stream);
+#if !LOG_STORE_SPI_NOR
+        for (uint16_t page = 0; page < stream_configs[stream].page_count; page++) {
+            if (!page_blank(stream, page)) {
+                page_erase(stream, page);
+            }
+        }
+#endif
+        streams[stream].active = LOG_NO_PAGE;
+        streams[stream].write_slot = 0;
+        streams[stream].next_erased = !LOG_STORE_SPI_NOR;
+        write_end(stream);
+    }
+#if LOG_STORE_SPI_NOR
+    nor_clearing = nor_ready && spi_nor_erase_chip();
+#endif
+#if LOG_ARCHIVE_SD
+    log_archive_clear();
+#endif
+}
+
+// 页内已写入的记录数：空白记录只出现在页尾，二分查找第一条空白记录
+static uint16_t page_record_count(uint8_t stream, uint16_t page) {
+    uint16_t low = 0, high = page_slots(stream);
+    while (low < high) {
+        uint16_t mid = (uint16_t)((low + high) / 2);
+        if (slot_blank(stream, page, mid)) {
+            high = mid;
+        } else {
+            low = (uint16_t)(mid + 1);
+        }
+    }
+    return low;
+}
+
+// page是有效页，页序号为sequence
+static inline bool page_has_sequence(uint8_t stream, uint16_t page, uint32_t sequence) {
+    return page_valid(stream, page) && page_header(stream, page).sequence == sequence;
+}
+
+// 页序号最大的有效页（活动页），没有有效页时为LOG_NO_PAGE。
+// 从第一个有效页（参考页）起按页环顺序页序号逐页加1，直到活动页，之后是擦除的页或上一轮的旧页：
+// 二分查找最后一个页序号与参考页相差其距离的页，只读O(log n)个页头。
+// 中间的页头编程失败（无效页）会打断这一规律，查找结果之后LOG_MOUNT_PROBE_PAGES页内
+// 仍能接上页序号时，退回逐页比较
+static uint16_t find_active(uint8_t stream) {
+    uint16_t page_count = stream_configs[stream].page_count;
+    uint16_t first = 0;
+    while (first < page_count && !page_valid(stream, first)) {
+        first++; // 通常只有提前擦除的一页
+    }
+    if (first == page_count) {
+        return LOG_NO_PAGE;
+    }
+
+    uint32_t first_sequence = page_header(stream, first).sequence;
+    uint16_t low = 1, high = page_count; // 距参考页的页数，[1, low)均接上页序号
+    while (low < high) {
+        uint16_t mid = (uint16_t)((low + high) / 2);
+        if (page_has_sequence(stream, (uint16_t)((first + mid) % page_count), first_sequence + mid)) {
+            low = (uint16_t)(mid + 1);
+        } else {
+            high = mid;
+        }
+    }
+    uint16_t distance = (uint16_t)(low - 1);
+    uint16_t active = (uint16_t)((first + distance) % page_count);
+
+    for (uint16_t probe = 2; probe <= LOG_MOUNT_PROBE_PAGES + 1U && distance + probe < page_count; probe++) {
+        if (page_has_sequence(stream, (uint16_t)((first + distance + probe) % page_count),
+                              first_sequence + distance + probe)) {
+            active = first;
+            for (uint16_t page = 0; page < page_count; page++) {
+                if (page_valid(stream, page) && page_header(stream, page).sequence > page_header(stream, active).sequence) {
+                    active = page;
+                }
+            }
+            break;
+        }
+    }
+    return active;
+}
+
+static void mount_stream(uint8_t stream) {
+    LogStreamState *state = &streams[stream];
+    state->version = 0;
+    state->active = LOG_NO_PAGE;
+    state->sequence = 0;
+    state->write_slot = 0;
+
+    state->active = find_active(stream);
+    if (state->active != LOG_NO_PAGE) {
+        state->sequence = page_header(stream, state->active).sequence;
+        state->base_time = page_header(stream, state->active).base_time;
+    }
+
+    // 写入位置在最后一条非空记录之后（掉电中断的记录也不再覆盖），
+    // 并由已提交的记录重建活动页的摘要。已开始写入摘要的页（换页时在新页页头之前掉电）
+    // 不再追加，否则摘要与之后的记录不符，筛选时会跳过它们；重建的摘要与写了一部分的
+    // 摘要相同，换页时补写
+    index_reset(&state->index);
+    if (state->active != LOG_NO_PAGE) {
+        uint16_t slot = page_record_count(stream, state->active);
+        bool closed = !halfwords_blank(page_address(stream, state->active) + sizeof(LogPageHeader),
+                                       sizeof(LogPageIndex));
+        state->write_slot = closed ? page_slots(stream) : slot;
+        for (uint16_t i = 0; i < slot; i++) {
+            if (slot_committed(stream, state->active, i)) {
+                uint64_t timestamp_ms;
+                uint8_t payload[LOG_STORE_MAX_PAYLOAD];
+                slot_read(stream, state->active, i, &timestamp_ms, payload);
+                index_add(stream, &state->index, slot_offset(stream, state->active, i), payload);
+            }
+        }
+    }
+    state->next_erased = page_blank(stream, next_page(stream));
+}
+
+void log_store_init(void) {
+#if LOG_STORE_SPI_NOR
+    // 没有外置闪存或容量不足时各流为空，记录写入失败后丢弃
+    nor_ready = spi_nor_init() &&
+                spi_nor_capacity() >= LOG_STORE_STREAM_BASE + LOG_STORE_STREAM_PAGES * LOG_STORE_STREAM_PAGE_SIZE;
+    nor_clearing = false;
+#endif
+    for (uint8_t stream = 0; stream < LOG_STREAM_COUNT; stream++) {
+        mount_stream(stream);
+    }
+
+    clear_requested = false;
+}
+
+void log_store_warm_restore(void) {
+    if (!warm_state_restore(&pending.state, LOG_STORE_WARM_MAGIC, sizeof(pending)) ||
+        pending.head >= LOG_STORE_PENDING || pending.count > LOG_STORE_PENDING) {
+        pending.head = 0;
+        pending.count = 0;
+    }
+    warm_state_seal(&pending.state);
+}
+
+bool log_store_append(uint8_t stream, uint64_t timestamp_ms, const void *payload) {
+    if (stream >= LOG_STREAM_COUNT ||
+        (stream_configs[stream].columns && ((const LogSamplePayload *)payload)->sensor >= LOG_STORE_MAX_SENSORS)) {
+        return false;
+    }
+
+    bool ok = false;
+    taskENTER_CRITICAL();
+    if (pending.count < LOG_STORE_PENDING) {
+        LogPendingRecord *record = &pending.records[(pending.head + pending.count) % LOG_STORE_PENDING];
+        record->timestamp_ms = timestamp_ms;
+        record->stream = stream;
+        memcpy(record->payload, payload, payload_size(stream));
+        pending.count++;
+        warm_state_seal(&pending.state);
+        ok = true;
+    }
+    taskEXIT_CRITICAL();
+    return ok;
+}
+
+bool log_store_service(bool idle) {
+    bool deferred = false;
+#if !LOG_STORE_SPI_NOR
+    HAL_FLASH_Unlock();
+#endif
+    if (clear_requested) {
+        clear_requested = false;
+        erase_all();
+    }
+#if LOG_STORE_SPI_NOR
+    // 整片擦除期间不写入，记录留在待写队列（队列满后新记录丢弃）
+    if (nor_clearing) {
+        if (spi_nor_busy()) {
+            return true;
+        }
+        nor_clearing = false;
+        for (uint8_t stream = 0; stream < LOG_STREAM_COUNT; stream++) {
+            streams[stream].next_erased = true;
+        }
+    }
+#endif
+
+    LogPendingRecord record;
+    while (pending_pop(&record)) {
+        write_record(&record);
+    }
+
+    // 提前擦除下一页，翻页时不需要等待擦除（回绕后即丢弃最旧的一页）；
+    // 擦除约20ms，尽量推迟到空闲时，活动页快写满时不再等待
+    for (uint8_t stream = 0; stream < LOG_STREAM_COUNT; stream++) {
+        LogStreamState *state = &streams[stream];
+        if (state->next_erased || state->active == LOG_NO_PAGE) {
+            continue;
+        }
+        if (!idle && (uint16_t)(page_slots(stream) - state->write_slot) > LOG_STORE_ERASE_MARGIN) {
+            deferred = true;
+            continue;
+        }
+        write_begin(stream);
+        state->next_erased = page_erase(stream, next_page(stream));
+        write_end(stream);
+    }
+#if !LOG_STORE_SPI_NOR
+    HAL_FLASH_Lock();
+#endif
+    return deferred;
+}
+
+void log_store_clear(void) {
+    taskENTER_CRITICAL();
+    pending.count = 0;
+    warm_state_seal(&pending.state);
+    clear_requested = true;
+    taskEXIT_CRITICAL();
+    storage_task_wake();
+}
+
+// 以下读取函数由命令执行任务调用，在seqlock内读取写入状态、页头和记录
+
+static void iter_begin(LogStoreIter *iter, uint8_t stream) {
+    // 活动页之后的一页最旧（或已擦除），按页环顺序读到活动页；
+    // 页序号按页环顺序逐页加1（更早的页序号回绕，不会与页头相符）
+    const LogStreamState *state = &streams[stream];
+    uint16_t page_count = stream_configs[stream].page_count;
+    iter->stream = stream;
+    iter->page = next_page(stream);
+    iter->sequence = state->sequence - (page_count - 1U);
+    iter->slot = 0;
+    iter->pages_left = (state->active == LOG_NO_PAGE) ? 0 : page_count;
+    iter->low = INT16_MIN;
+    iter->high = INT16_MAX;
+    iter->skipped = 0;
+}
+
+void log_store_iter_begin(LogStoreIter *iter, uint8_t stream) {
+#if LOG_ARCHIVE_SD
+    if (stream == LOG_STREAM_ARCHIVE) {
+        log_archive_iter_begin(iter);
+        return;
+    }
+#endif
+    uint32_t version;
+    do {
+        version = read_begin(stream);
+        iter_begin(iter, stream);
+    } while (read_retry(stream, version));
+}
+
+// iter当前页仍是它期望的那一页（没有被擦除或覆盖为新页）
+static inline bool iter_page_valid(const LogStoreIter *iter) {
+    return page_valid(iter->stream, iter->page) &&
+           page_header(iter->stream, iter->page).sequence == iter->sequence;
+}
+
+static void seek(LogStoreIter *iter, uint8_t stream, uint64_t timestamp_ms) {
+    iter_begin(iter, stream);
+    if (iter->pages_left == 0) {
+        return;
+    }
+
+    // 按页环顺序各页起始时间递增（无效页只出现在最前面）：
+    // 找第一个起始时间晚于timestamp_ms的页，目标在它的前一页
+    uint16_t page_count = stream_configs[stream].page_count;
+    uint16_t first = iter->page;
+    uint16_t low = 0, high = page_count;
+    while (low < high) {
+        uint16_t mid = (uint16_t)((low + high) / 2);
+        uint16_t page = (uint16_t)((first + mid) % page_count);
+        if (page_valid(stream, page) && page_base_ms(stream, page) > timestamp_ms) {
+            high = mid;
+        } else {
+            low = (uint16_t)(mid + 1);
+        }
+    }
+    if (low == 0) {
+        return; // 全部记录都不早于timestamp_ms
+    }
+
+    uint16_t page = (uint16_t)((first + low - 1) % page_count);
+    iter->page = page;
+    iter->sequence += low - 1U;
+    iter->pages_left = (uint16_t)(page_count - (low - 1));
+    if (!page_valid(stream, page)) {
+        return;
+    }
+
+    // 页内已提交的记录按时间递增，找第一条不早于timestamp_ms的记录。掉电中断的记录
+    // 偏移不可信（可能只编程了一部分），按它之后第一条已提交的记录比较
+    uint64_t base_ms = page_base_ms(stream, page);
+    uint16_t slot_low = 0, slot_high = page_record_count(stream, page);
+    while (slot_low < slot_high) {
+        uint16_t mid = (uint16_t)((slot_low + slot_high) / 2);
+        uint16_t probe = mid;
+        while (probe < slot_high && !slot_committed(stream, page, probe)) {
+            probe++;
+        }
+        if (probe < slot_high && base_ms + slot_offset(stream, page, probe) < timestamp_ms) {
+            slot_low = (uint16_t)(probe + 1);
+        } else {
+            slot_high = mid;
+        }
+    }
+    iter->slot = slot_low;
+}
+
+void log_store_seek(LogStoreIter *iter, uint8_t stream, uint64_t timestamp_ms) {
+#if LOG_ARCHIVE_SD
+    if (stream == LOG_STREAM_ARCHIVE) {
+        log_archive_seek(iter, timestamp_ms);
+        return;
+    }
+#endif
+    uint32_t version;
+    do {
+        version = read_begin(stream);
+        seek(iter, stream, timestamp_ms);
+    } while (read_retry(stream, version));
+}
+
+// iter当前页的摘要表明页内没有温度值落在[low, high]内，调用方已确认页有效
+static inline bool iter_page_excluded(const LogStoreIter *iter) {
+    if (iter->low == INT16_MIN && iter->high == INT16_MAX) {
+        return false;
+    }
+    LogPageIndex index = page_index(iter->stream, iter->page);
+    return index.commit == LOG_INDEX_COMMIT && (index.max < iter->low || index.min > iter->high);
+}
+
+void log_store_iter_filter(LogStoreIter *iter, int16_t low, int16_t high) {
+    iter->low = low;
+    iter->high = high;
+}
+
+bool log_store_iter_next(LogStoreIter *iter, uint64_t *timestamp_ms, void *payload) {
+#if LOG_ARCHIVE_SD
+    if (iter->stream == LOG_STREAM_ARCHIVE) {
+        return log_archive_iter_next(iter, timestamp_ms, payload);
+    }
+#endif
+    uint8_t stream = iter->stream;
+    uint16_t slots = page_slots(stream);
+
+    while (iter->pages_left > 0) {
+        while (iter->slot < slots) {
+            // 先复制记录，再确认复制期间该页没有被擦除或换页
+            uint32_t version = read_begin(stream);
+            if (!iter_page_valid(iter)) {
+                if (read_retry(stream, version)) {
+                    continue;
+                }
+                break;
+            }
+            if (iter_page_excluded(iter)) {
+                if (read_retry(stream, version)) {
+                    continue;
+                }
+                iter->skipped++;
+                break; // 整页跳过
+            }
+            uint16_t slot = iter->slot;
+            bool committed = slot_committed(stream, iter->page, slot);
+            bool blank = !committed && slot_blank(stream, iter->page, slot);
+            if (committed) {
+                slot_read(stream, iter->page, slot, timestamp_ms, payload);
+            }
+            if (read_retry(stream, version)) {
+                continue;
+            }
+            iter->slot++;
+            if (committed) {
+                return true;
+            }
+            if (blank) {
+                break; // 页内之后没有记录
+            }
+        }
+        iter->page = (uint16_t)((iter->page + 1) % stream_configs[stream].page_count);
+        iter->sequence++;
+        iter->slot = 0;
+        iter->pages_left--;
+    }
+    return false;
+}
+
+static void iter_end(LogStoreIter *iter, uint8_t stream) {
+    iter_begin(iter, stream);
+    if (iter->pages_left == 0) {
+        return;
+    }
+    // 从活动页的写入位置往前，最多读完整个页环
+    const LogStreamState *state = &streams[stream];
+    iter->page = state->active;
+    iter->sequence = state->sequence;
+    iter->slot = state->write_slot;
+}
+
+void log_store_iter_end(LogStoreIter *iter, uint8_t stream) {
+    if (stream >= LOG_STREAM_COUNT) {
+        iter->stream = stream;
+        iter->pages_left = 0;
+        return;
+    }
+    uint32_t version;
+    do {
+        version = read_begin(stream);
+        iter_end(iter, stream);
+    } while (read_retry(stream, version));
+}
+
+bool log_store_iter_prev(LogStoreIter *iter, uint64_t *timestamp_ms, void *payload) {
+    uint8_t stream = iter->stream;
+    if (stream >= LOG_STREAM_COUNT) {
+        return false;
+    }
+    uint16_t page_count = stream_configs[stream].page_count;
+
+    while (iter->pages_left > 0) {
+        while (iter->slot > 0) {
+            uint32_t version = read_begin(stream);
+            if (!iter_page_valid(iter)) {
+                if (read_retry(stream, version)) {
+                    continue;
+                }
+                iter->pages_left = 0; // 更早的页已擦除或被覆盖，之前没有记录
+                return false;
+            }
+            if (iter_page_excluded(iter)) {
+                if (read_retry(stream, version)) {
+                    continue;
+                }
+                iter->skipped++;
+                break; // 整页跳过
+            }
+            uint16_t slot = (uint16_t)(iter->slot - 1U);
+            bool committed = slot_committed(stream, iter->page, slot);
+            if (committed) {
+                slot_read(stream, iter->page, slot, timestamp_ms, payload);
+            }
+            if (read_retry(stream, version)) {
+                continue;
+            }
+            iter->slot = slot;
+            if (committed) {
+                return true;
+            }
+        }
+        if (--iter->pages_left == 0) {
+            break;
+        }
+        iter->page = (uint16_t)((iter->page + page_count - 1U) % page_count);
+        iter->sequence--;
+        iter->slot = page_slots(stream);
+    }
+    return false;
+}
+
+static uint32_t iter_position(const LogStoreIter *iter) {
+    uint8_t stream = iter->stream;
+    const LogStreamState *state = &streams[stream];
+    uint32_t slots = page_slots(stream);
+
+    if (state->active == LOG_NO_PAGE) {
+        return (state->sequence + 1) * slots; // 下一页的第一条
+    }
+    if (iter->pages_left == 0) {
+        return state->sequence * slots + state->write_slot; // 已读完，为下一条写入的记录
+    }
+    if (state->sequence - iter->sequence >= state->sequence) {
+        return slots; // 页序号从1开始，更早的页没有记录
+    }
+    return iter->sequence * slots + iter->slot;
+}
+
+uint32_t log_store_iter_position(const LogStoreIter *iter) {
+#if LOG_ARCHIVE_SD
+    if (iter->stream == LOG_STREAM_ARCHIVE) {
+        return log_archive_iter_position(iter);
+    }
+#endif
+    uint32_t position, version;
+    do {
+        version = read_begin(iter->stream);
+        position = iter_position(iter);
+    } while (read_retry(iter->stream, version));
+    return position;
+}
+
+static void iter_resume(LogStoreIter *iter, uint8_t stream, uint32_t position) {
+    iter_begin(iter, stream);
+    if (iter->pages_left == 0) {
+        return;
+    }
+
+    const LogStreamState *state = &streams[stream];
+    uint16_t slots = page_slots(stream);
+    uint32_t sequence = position / slots;
+    uint16_t page_count = stream_configs[stream].page_count;
+
+    if (sequence > state->sequence) {
+        iter->pages_left = 0; // 还没有写入
+        return;
+    }
+    uint32_t distance = state->sequence - sequence;
+    if (distance >= page_count) {
+        return; // 已被覆盖
+    }
+    iter->page = (uint16_t)((state->active + page_count - distance) % page_count);
+    iter->sequence = sequence;
+    iter->slot = (uint16_t)(position % slots);
+    iter->pages_left = (uint16_t)(distance + 1);
+}
+
+void log_store_iter_resume(LogStoreIter *iter, uint8_t stream, uint32_t position) {
+#if LOG_ARCHIVE_SD
+    if (stream == LOG_STREAM_ARCHIVE) {
+        log_archive_iter_resume(iter, position);
+        return;
+    }
+#endif
+    uint32_t version;
+    do {
+        version = read_begin(stream);
+        iter_resume(iter, stream, position);
+    } while (read_retry(stream, version));
+}
+
+#if LOG_ARCHIVE_SD
+// 下一条要写入归档的采样记录在闪存中的位置，只由存储任务访问
+static uint32_t archive_cursor = 0;
+
+void log_store_archive_start(void) {
+    LogStoreIter iter;
+    uint64_t last_ms;
+    if (log_archive_last_time(&last_ms)) {
+        log_store_seek(&iter, LOG_STREAM_SAMPLES, last_ms + 1U);
+    } else {
+        log_store_iter_begin(&iter, LOG_STREAM_SAMPLES); // 新的归档从闪存中最旧的记录开始
+    }
+    archive_cursor = log_store_iter_position(&iter);
+}
+
+// 闪存即归档的待写队列：从archive_cursor读出新记录放入暂存块。
+// 归档落后超过闪存的保留时长时，被覆盖的记录从归档中缺失
+uint32_t log_store_archive_sync(uint32_t now_ms) {
+    if (!log_archive_ready()) {
+        return UINT32_MAX;
+    }
+    LogStoreIter iter;
+    uint64_t timestamp_ms;
+    LogSamplePayload sample;
+    log_store_iter_resume(&iter, LOG_STREAM_SAMPLES, archive_cursor);
+    while (log_store_iter_next(&iter, &timestamp_ms, &sample)) {
+        if (!log_archive_stage(timestamp_ms, &sample)) {
+            // 暂存块已满（补写积压的记录时）：写入后立即再调用，每次调用最多写入一次，
+            // 存储任务在两次调用之间签到看门狗；写入失败时稍后从该记录重试
+            uint32_t wait = log_archive_service(now_ms, true);
+            return wait == UINT32_MAX ? 0 : wait;
+        }
+        archive_cursor = log_store_iter_position(&iter);
+    }
+    archive_cursor = log_store_iter_position(&iter);
+    return log_archive_service(now_ms, false);
+}
+#endif // LOG_ARCHIVE_SD
@@ -0,0 +1,159 @@
+#include "low_power.h"
+#include "rtc_clock.h"
+#include "communication.h"
+#include "device_control.h"
+#include "usb_cdc.h"
+#include "clock_scale.h"
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+// FreeRTOSConfig.h改为调用low_power_suppress_ticks()后portmacro.h不再声明
+extern void vPortSuppressTicksAndSleep(TickType_t expected_idle_time);
+
+// STOP期间各链路RX线的唤醒EXTI线：PA10（USART1_RX）为EXTI10，PC11（UART4_RX）为EXTI11
+#if COMM_WIRED_LINK
+#define WAKE_LINES (EXTI_IMR_MR10 | EXTI_IMR_MR11)
+#else
+#define WAKE_LINES EXTI_IMR_MR10
+#endif
+
+// 睡眠模式期间HAL时基被挂起，由low_power_pre_sleep()置位
+static bool hal_tick_suspended = false;
+
+void low_power_init(void) {
+    // RX线下降沿（起始位）触发，只在STOP期间打开
+    __HAL_RCC_AFIO_CLK_ENABLE();
+    __HAL_RCC_PWR_CLK_ENABLE();
+    MODIFY_REG(AFIO->EXTICR[2], AFIO_EXTICR3_EXTI10, AFIO_EXTICR3_EXTI10_PA);
+#if COMM_WIRED_LINK
+    MODIFY_REG(AFIO->EXTICR[2], AFIO_EXTICR3_EXTI11, AFIO_EXTICR3_EXTI11_PC);
+#endif
+    EXTI->IMR &= ~WAKE_LINES;
+    EXTI->FTSR |= WAKE_LINES; // FTSR与IMR的位布局相同
+    HAL_NVIC_SetPriority(EXTI15_10_IRQn, 15, 0);
+    HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
+
+    rtc_alarm_init();
+
+#ifdef DEBUG
+    DBGMCU->CR |= DBGMCU_CR_DBG_STOP; // STOP期间调试器保持连接
+#endif
+}
+
+void low_power_exti_irq_handler(void) {
+    EXTI->PR = WAKE_LINES;
+}
+
+// 睡眠模式：port.c在确认可以睡眠后调用（configPRE_SLEEP_PROCESSING），此时中断已屏蔽
+void low_power_pre_sleep(void) {
+    HAL_SuspendTick();
+    hal_tick_suspended = true;
+}
+
+// HAL时基停止期间的节拍按elapsed补上；TIM7计数器一直在走，溢出标志已包含在elapsed中
+static void resume_hal_tick(uint32_t elapsed) {
+    uwTick += elapsed;
+    if (elapsed != 0) {
+        TIM7->SR = 0; // TIM7只用更新中断
+    }
+    HAL_ResumeTick();
+}
+
+// STOP唤醒后系统时钟为HSI，按SystemClock_Config()的设置重新启动HSE和PLL；
+// 分频（含降频时的AHB分频，clock_scale.h）和PLL倍频在STOP期间保持，只需重新打开振荡器并切换时钟源
+static void restore_system_clock(void) {
+    RCC->CR |= RCC_CR_HSEON;
+    while ((RCC->CR & RCC_CR_HSERDY) == 0) {
+    }
+    RCC->CR |= RCC_CR_PLLON;
+    while ((RCC->CR & RCC_CR_PLLRDY) == 0) {
+    }
+    MODIFY_REG(RCC->CFGR, RCC_CFGR_SW, RCC_CFGR_SW_PLL);
+    while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL) {
+    }
+}
+
+// 串口、输出和DMA在STOP期间都会停止，只在它们都空闲时进入；
+// USB枚举后需要48MHz时钟，只有总线挂起或未连接时才能进入
+static bool stop_allowed(void) {
+#if COMM_USB_LINK
+    if (usb_cdc_active()) {
+        return false;
+    }
+#endif
+    return communication_stop_allowed() && output_all_off();
+}
+
+// 进入STOP直到RTC闹钟或其他中断，返回false表示有任务就绪、未进入
+static bool enter_stop(uint64_t start_ms, uint32_t expected_ticks) {
+    __disable_irq();
+    __DSB();
+    __ISB();
+    if (eTaskConfirmSleepModeStatus() == eAbortSleep) {
+        __enable_irq();
+        return false;
+    }
+
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    HAL_SuspendTick();
+    EXTI->PR = WAKE_LINES;
+    EXTI->IMR |= WAKE_LINES;
+
+    HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+
+    EXTI->IMR &= ~WAKE_LINES;
+    restore_system_clock();
+    rtc_resync();
+    if (EXTI->PR & WAKE_LINES) {
+        communication_mark_activity(); // 主机开始发送，暂时不再进入STOP
+    }
+
+    // 不足一个节拍的部分舍去；跨过下一个超时的部分也不计，该任务随即就绪
+    uint64_t elapsed = rtc_get_timestamp_ms() - start_ms;
+    if (elapsed > expected_ticks) {
+        elapsed = expected_ticks;
+    }
+    vTaskStepTick((TickType_t)elapsed);
+    resume_hal_tick((uint32_t)elapsed);
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    // 唤醒的中断在这里执行
+    __enable_irq();
+    return true;
+}
+
+void low_power_suppress_ticks(uint32_t expected_ticks) {
+    if (expected_ticks >= LOW_POWER_STOP_MIN_MS && stop_allowed()) {
+        uint64_t now_ms = rtc_get_timestamp_ms();
+        if (rtc_alarm_arm(now_ms + expected_ticks, now_ms + LOW_POWER_STOP_MIN_MS) != 0) {
+            bool stopped = enter_stop(now_ms, expected_ticks);
+            rtc_alarm_restore(); // 闹钟改回各定时唤醒槽中最早的一个
+            if (stopped) {
+                return;
+            }
+        }
+    }
+
+    // 降频后的睡眠：port.c的tickless会把SysTick改回HCLK/8，因此节拍照常运行，每个节拍唤醒一次
+    if (clock_scale_idle()) {
+        __disable_irq();
+        if (eTaskConfirmSleepModeStatus() != eAbortSleep) {
+            __DSB();
+            __WFI();
+        }
+        __enable_irq();
+        return;
+    }
+
+    // 睡眠模式：SysTick由port.c重装并补齐内核节拍，HAL时基按内核节拍补齐
+    TickType_t start = xTaskGetTickCount();
+    vPortSuppressTicksAndSleep(expected_ticks);
+    if (hal_tick_suspended) {
+        __disable_irq();
+        hal_tick_suspended = false;
+        resume_hal_tick(xTaskGetTickCount() - start);
+        __enable_irq();
+    }
+}
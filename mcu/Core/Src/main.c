@@ -25,9 +25,26 @@
 #include "communication.h"
 #include "device_control.h"
 #include "DS18B20.h"
+#include "temp_sampler.h"
+#include "timebase.h"
+#include "temp_logger.h"
+#include "low_power.h"
+#include "storage_task.h"
+#include "watchdog.h"
+#include "itm_log.h"
+#include "bench.h"
+#include "uart_transport.h"
+#include "ble_module.h"
+#include "usb_cdc.h"
+#include "crc32.h"
+#include "warm_state.h"
+#include "temp_stats.h"
+#include "command_stats.h"
+#include "log_store.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
+typedef StaticTask_t osStaticThreadDef_t;
 /* USER CODE BEGIN PTD */
 
 /* USER CODE END PTD */
@@ -53,12 +70,17 @@ UART_HandleTypeDef huart1;
 DMA_HandleTypeDef hdma_usart1_rx;
 DMA_HandleTypeDef hdma_usart1_tx;
 
-/* Definitions for defaultTask */
-osThreadId_t defaultTaskHandle;
-const osThreadAttr_t defaultTask_attributes = {
-  .name = "defaultTask",
-  .stack_size = 128 * 4,
-  .priority = (osPriority_t) osPriorityNormal,
+/* Definitions for commRxTask */
+osThreadId_t commRxTaskHandle;
+uint32_t commRxTaskBuffer[ 256 ];
+osStaticThreadDef_t commRxTaskControlBlock;
+const osThreadAttr_t commRxTask_attributes = {
+  .name = "commRxTask",
+  .cb_mem = &commRxTaskControlBlock,
+  .cb_size = sizeof(commRxTaskControlBlock),
+  .stack_mem = &commRxTaskBuffer[0],
+  .stack_size = sizeof(commRxTaskBuffer),
+  .priority = (osPriority_t) osPriorityAboveNormal,
 };
 /* USER CODE BEGIN PV */
 
@@ -72,7 +94,7 @@ static void MX_USART1_UART_Init(void);
 static void MX_RTC_Init(void);
 static void MX_CRC_Init(void);
 static void MX_TIM4_Init(void);
-void StartDefaultTask(void *argument);
+void StartCommRxTask(void *argument);
 
 /* USER CODE BEGIN PFP */
 
@@ -107,7 +129,13 @@ int main(void)
   SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
-
+  // 72MHz：闪存2个等待周期，预取缓冲开启（HAL_Init按PREFETCH_ENABLE开启），半周期访问关闭
+  if ((FLASH->ACR & (FLASH_ACR_LATENCY | FLASH_ACR_HLFCYA | FLASH_ACR_PRFTBS)) != (FLASH_LATENCY_2 | FLASH_ACR_PRFTBS))
+  {
+    Error_Handler();
+  }
+  // DWT周期计数器（微秒延时、耗时测量）
+  timebase_init();
   /* USER CODE END SysInit */
 
   /* Initialize all configured peripherals */
@@ -117,21 +145,42 @@ int main(void)
   MX_RTC_Init();
   MX_CRC_Init();
   MX_TIM4_Init();  /* USER CODE BEGIN 2 */
-  // 初始化通信模块
+  // 读取并清除复位原因（备份寄存器在RTC初始化后才能访问）
+  watchdog_init();
+  
+  // 先启动串口接收，复位后尽快应答主机；有线串口（UART4）在此之前配置
+#if UART_WIRED_PORT
+  uart_transport_wired_init();
+#endif
+#if BLE_MODULE_CONFIG
+  // 接收DMA启动前用AT指令配置BLE模块的波特率和连接间隔，没有找到模块时约0.4秒后返回
+  BleModuleResult ble_module;
+  ble_module_configure(uart_transport_ble_module_port(), &ble_module);
+#endif
   communication_init();
+#if BLE_MODULE_CONFIG
+  communication_set_base_baud_rate(COMM_LINK_BLE, ble_module.baud_rate);
+#endif
+#if COMM_USB_LINK
+  usb_cdc_init();
+#endif
   
   // 初始化设备控制模块（LED, 蜂鸣器等）
   led_init();
   buzzer_init();
   
-  // 初始化温度传感器
-  temperature_sensor_init();
+  // 空闲时的低功耗模式：串口RX和RTC闹钟的唤醒中断
+  low_power_init();
   
-  // 初始化报警系统
-  alarm_init();
+  // 看门狗、软件和NRST复位时SRAM保留，沿用校验通过的采样缓存、统计和待写队列（warm_state.h）
+  uint8_t reset_reason = watchdog_reset_reason();
+  warm_state_init(reset_reason == RESET_REASON_PIN || reset_reason == RESET_REASON_SOFTWARE ||
+                  reset_reason == RESET_REASON_WATCHDOG || reset_reason == RESET_REASON_WINDOW_WATCHDOG);
+  temp_stats_warm_restore();
+  command_stats_warm_restore();
+  log_store_warm_restore();
   
-  // 初始化温度日志系统
-  temp_log_init();
+  // 温度传感器由采样任务、报警规则和日志由存储任务在调度器启动后初始化
   /* USER CODE END 2 */
 
   /* Init scheduler */
@@ -139,6 +188,8 @@ int main(void)
 
   /* USER CODE BEGIN RTOS_MUTEX */
   /* add mutexes, ... */
+  // 各任务共用的硬件CRC：互斥量和大块数据的DMA通道
+  crc32_dma_init();
   /* USER CODE END RTOS_MUTEX */
 
   /* USER CODE BEGIN RTOS_SEMAPHORES */
@@ -154,11 +205,24 @@ int main(void)
   /* USER CODE END RTOS_QUEUES */
 
   /* Create the thread(s) */
-  /* creation of defaultTask */
-  defaultTaskHandle = osThreadNew(StartDefaultTask, NULL, &defaultTask_attributes);
+  /* creation of commRxTask */
+  commRxTaskHandle = osThreadNew(StartCommRxTask, NULL, &commRxTask_attributes);
 
   /* USER CODE BEGIN RTOS_THREADS */
   /* add threads, ... */
+  // 任务都使用静态内存，优先级从高到低：接收、采样、命令执行、记录和存储
+  communication_start();
+  // 温度采样任务：连续转换并缓存最近一次读数
+  temp_sampler_start();
+  temp_logger_start();
+  storage_task_start();
+  itm_start();
+#ifdef BENCH_AT_BOOT
+  // 协议编解码微基准，结果经ITM文本端口输出（bench.h）
+  bench_report(timebase_cycles, BENCH_ITERATIONS);
+#endif
+  // 所有任务创建之后启动看门狗，此后任务须按期签到
+  watchdog_start();
   /* USER CODE END RTOS_THREADS */
 
   /* USER CODE BEGIN RTOS_EVENTS */
@@ -288,7 +352,11 @@ static void MX_RTC_Init(void)
   }
 
   /* USER CODE BEGIN Check_RTC_BKUP */
-
+  // 备份域没有掉电时RTC仍在计时，保留当前时间
+  if (rtc_restore())
+  {
+    return;
+  }
   /* USER CODE END Check_RTC_BKUP */
 
   /** Initialize RTC and set the Time and Date
@@ -311,6 +379,9 @@ static void MX_RTC_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN RTC_Init 2 */
+  // 备份域掉电过（或第一次上电）：HAL_RTC_SetDate()只保存在RAM中，
+  // 计数器按Unix时间戳重新设置为2000-01-01 00:00:00
+  rtc_set_timestamp(RTC_TIMESTAMP_2000);
 
   /* USER CODE END RTC_Init 2 */
 
@@ -336,9 +407,9 @@ static void MX_TIM4_Init(void)
 
   /* USER CODE END TIM4_Init 1 */
   htim4.Instance = TIM4;
-  htim4.Init.Prescaler = 253;
-  htim4.Init.CounterMode = TIM_COUNTERMODE_DOWN;
-  htim4.Init.Period = 270;
+  htim4.Init.Prescaler = 282;
+  htim4.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim4.Init.Period = 254;
   htim4.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
   htim4.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
   if (HAL_TIM_Base_Init(&htim4) != HAL_OK)
@@ -361,13 +432,17 @@ static void MX_TIM4_Init(void)
     Error_Handler();
   }
   sConfigOC.OCMode = TIM_OCMODE_PWM1;
-  sConfigOC.Pulse = 135;
+  sConfigOC.Pulse = 0;
   sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
   sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
   if (HAL_TIM_PWM_ConfigChannel(&htim4, &sConfigOC, TIM_CHANNEL_3) != HAL_OK)
   {
     Error_Handler();
   }
+  if (HAL_TIM_PWM_ConfigChannel(&htim4, &sConfigOC, TIM_CHANNEL_4) != HAL_OK)
+  {
+    Error_Handler();
+  }
   /* USER CODE BEGIN TIM4_Init 2 */
 
   /* USER CODE END TIM4_Init 2 */
@@ -550,50 +625,31 @@ static void MX_GPIO_Init(void)
 
 /* USER CODE BEGIN 4 */
 
-// UART接收完成回调函数
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
-    if (huart->Instance == USART1) {
-        communication_rx_complete_callback();
-    }
-}
-
-// UART发送完成回调函数
-void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
-    if (huart->Instance == USART1) {
-        communication_tx_complete_callback();
-    }
-}
-
-// UART错误回调函数
-void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
-    if (huart->Instance == USART1) {
-        communication_error_callback();
-    }
-}
+// USART1的收发和中断由uart_transport.c直接处理，不使用HAL_UART回调
 
 /* USER CODE END 4 */
 
-/* USER CODE BEGIN Header_StartDefaultTask */
+/* USER CODE BEGIN Header_StartCommRxTask */
 /**
-  * @brief  Function implementing the defaultTask thread.
+  * @brief  Function implementing the commRxTask thread.
   * @param  argument: Not used
   * @retval None
   */
-/* USER CODE END Header_StartDefaultTask */
-void StartDefaultTask(void *argument)
+/* USER CODE END Header_StartCommRxTask */
+void StartCommRxTask(void *argument)
 {
   /* USER CODE BEGIN 5 */
+  int8_t watchdog_id = watchdog_register("rx", WATCHDOG_TASK_DEADLINE_MS);
   /* Infinite loop */
   for(;;)
   {
-    // 运行通信任务
-    communication_task();
+    // 等待UART事件（蜂鸣和闪烁的节拍由软件定时器完成，这里不需要轮询）
+    watchdog_wait(watchdog_id);
+    communication_wait_event(osWaitForever);
+    watchdog_checkin(watchdog_id);
     
-    // 检查蜂鸣器状态（处理定时蜂鸣）
-    buzzer_get_state();
-    
-    // 短暂延时
-    osDelay(10);
+    // 解析收到的数据，完整的请求交给命令执行任务
+    communication_task();
   }
   /* USER CODE END 5 */
 }
@@ -0,0 +1,234 @@
+#include "onewire.h"
+#include "onewire_pin.h"
+#include "main.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "trace.h"
+#include "clock_scale.h"
+#include "ramfunc.h"
+
+// 时隙时序（微秒，Maxim AN126推荐值；读时隙缩短A、E，
+// 加上两次中断进入时间后采样点仍在拉低后15us之内）
+#define OW_RESET_LOW_US      480  // H：复位脉冲
+#define OW_PRESENCE_WAIT_US  70   // I：释放后到采样存在脉冲
+#define OW_RESET_END_US      410  // J：采样后到复位结束
+#define OW_WRITE1_LOW_US     6    // A：写1时隙的拉低时间
+#define OW_READ_LOW_US       3    // A：读时隙的拉低时间
+#define OW_WRITE1_END_US     64   // B：写1时隙剩余时间
+#define OW_WRITE0_LOW_US     60   // C：写0拉低时间
+#define OW_WRITE0_END_US     10   // D：写0恢复时间
+#define OW_READ_SAMPLE_US    7    // E：读时隙释放后到采样
+#define OW_READ_END_US       60   // F：采样后到时隙结束
+
+// 中断状态机的阶段
+typedef enum {
+    OW_PHASE_RESET_RELEASE,  // 复位脉冲结束，释放总线
+    OW_PHASE_PRESENCE,       // 采样存在脉冲
+    OW_PHASE_RESET_END,      // 复位结束，开始第一个时隙
+    OW_PHASE_SLOT_RELEASE,   // 时隙拉低结束，释放总线
+    OW_PHASE_SLOT_SAMPLE,    // 读时隙采样
+    OW_PHASE_SLOT_END        // 时隙结束，开始下一个时隙
+} OneWirePhase;
+
+// 正在进行的传输，中断与调用方共享
+static struct {
+    const uint8_t *tx;
+    uint8_t *rx;
+    uint16_t tx_bits;
+    uint16_t total_bits;     // tx_bits + rx_bits
+    uint16_t bit;            // 当前时隙序号
+    uint8_t phase;           // OneWirePhase
+    bool presence;
+    volatile bool busy;
+} transfer;
+
+// 总线锁：传输期间禁止闪存擦写（取指暂停时时隙中断无法按时执行）
+static StaticSemaphore_t bus_lock_buffer;
+static osMutexId_t bus_lock = NULL;
+
+static const osMutexAttr_t bus_lock_attributes = {
+    .name = "onewire",
+    .attr_bits = osMutexPrioInherit,
+    .cb_mem = &bus_lock_buffer,
+    .cb_size = sizeof(bus_lock_buffer),
+};
+
+// TIM6单脉冲：delay_us（至少2）后产生一次更新中断
+static inline void schedule(uint16_t delay_us) {
+    TIM6->ARR = delay_us - 1;
+    TIM6->CNT = 0;
+    TIM6->CR1 |= TIM_CR1_CEN;
+}
+
+static inline bool slot_is_read(uint16_t bit) {
+    return bit >= transfer.tx_bits;
+}
+
+static inline bool tx_bit(uint16_t bit) {
+    return (transfer.tx[bit >> 3] >> (bit & 7)) & 1U;
+}
+
+// 开始当前时隙：拉低总线；全部时隙完成时结束传输
+// 时隙中断的代码都在SRAM中执行，时序不受闪存等待周期影响
+RAMFUNC static void start_slot(void) {
+    if (transfer.bit >= transfer.total_bits) {
+        transfer.busy = false;
+        return;
+    }
+
+    ONEWIRE_PIN_LOW();
+    transfer.phase = OW_PHASE_SLOT_RELEASE;
+    if (slot_is_read(transfer.bit)) {
+        schedule(OW_READ_LOW_US);
+    } else {
+        schedule(tx_bit(transfer.bit) ? OW_WRITE1_LOW_US : OW_WRITE0_LOW_US);
+    }
+}
+
+RAMFUNC void onewire_timer_irq_handler(void) {
+    TIM6->SR = 0;
+
+    switch (transfer.phase) {
+    case OW_PHASE_RESET_RELEASE:
+        ONEWIRE_PIN_RELEASE();
+        transfer.phase = OW_PHASE_PRESENCE;
+        schedule(OW_PRESENCE_WAIT_US);
+        break;
+
+    case OW_PHASE_PRESENCE:
+        transfer.presence = !ONEWIRE_PIN_READ(); // 从机拉低表示存在
+        transfer.phase = OW_PHASE_RESET_END;
+        schedule(OW_RESET_END_US);
+        break;
+
+    case OW_PHASE_RESET_END:
+        if (!transfer.presence) {
+            transfer.busy = false;
+            break;
+        }
+        start_slot();
+        break;
+
+    case OW_PHASE_SLOT_RELEASE: {
+        ONEWIRE_PIN_RELEASE();
+        uint16_t bit = transfer.bit;
+        if (slot_is_read(bit)) {
+            transfer.phase = OW_PHASE_SLOT_SAMPLE;
+            schedule(OW_READ_SAMPLE_US);
+        } else {
+            transfer.phase = OW_PHASE_SLOT_END;
+            schedule(tx_bit(bit) ? OW_WRITE1_END_US : OW_WRITE0_END_US);
+        }
+        break;
+    }
+
+    case OW_PHASE_SLOT_SAMPLE: {
+        uint16_t index = transfer.bit - transfer.tx_bits;
+        uint8_t mask = (uint8_t)(1U << (index & 7));
+        if (ONEWIRE_PIN_READ()) {
+            transfer.rx[index >> 3] |= mask;
+        } else {
+            transfer.rx[index >> 3] &= (uint8_t)~mask;
+        }
+        transfer.phase = OW_PHASE_SLOT_END;
+        schedule(OW_READ_END_US);
+        break;
+    }
+
+    case OW_PHASE_SLOT_END:
+    default:
+        transfer.bit++;
+        start_slot();
+        break;
+    }
+}
+
+void onewire_pin_init(void) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    __HAL_RCC_GPIOG_CLK_ENABLE();
+    ONEWIRE_PIN_RELEASE();
+    GPIO_InitStruct.Pin = DS18B20_Pin;
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_OD;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(DS18B20_GPIO_Port, &GPIO_InitStruct);
+}
+
+void onewire_init(void) {
+    onewire_pin_init();
+
+    // TIM6计数频率1MHz：APB1分频时定时器时钟为PCLK1的2倍（降频时由clock_scale.c按比例改写）
+    __HAL_RCC_TIM6_CLK_ENABLE();
+    uint32_t clock = HAL_RCC_GetPCLK1Freq();
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) {
+        clock *= 2;
+    }
+    TIM6->CR1 = TIM_CR1_OPM | TIM_CR1_URS; // 单脉冲，只有计数溢出产生中断
+    TIM6->PSC = clock / 1000000U - 1;
+    TIM6->EGR = TIM_EGR_UG;                // 装载预分频值
+    TIM6->SR = 0;
+    TIM6->DIER = TIM_DIER_UIE;
+
+    if (bus_lock == NULL) {
+        bus_lock = osMutexNew(&bus_lock_attributes);
+    }
+
+    HAL_NVIC_SetPriority(TIM6_IRQn, ONEWIRE_TIM_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(TIM6_IRQn);
+}
+
+// 调度器启动前只有一个执行流，不需要加锁
+void onewire_lock(void) {
+    if (osKernelGetState() == osKernelRunning) {
+        osMutexAcquire(bus_lock, osWaitForever);
+    }
+}
+
+void onewire_unlock(void) {
+    if (osKernelGetState() == osKernelRunning) {
+        osMutexRelease(bus_lock);
+    }
+}
+
+uint8_t onewire_transfer(bool reset, const uint8_t *tx, uint16_t tx_bits,
+                         uint8_t *rx, uint16_t rx_bits) {
+    if (tx_bits + rx_bits == 0 && !reset) {
+        return 0;
+    }
+
+    onewire_lock();
+    clock_scale_hold(); // 时隙中断的进入时间按全速计算
+    trace_event(TRACE_ONEWIRE_START, (uint16_t)(tx_bits + rx_bits));
+    transfer.tx = tx;
+    transfer.rx = rx;
+    transfer.tx_bits = tx_bits;
+    transfer.total_bits = tx_bits + rx_bits;
+    transfer.bit = 0;
+    transfer.presence = true;
+    transfer.busy = true;
+
+    if (reset) {
+        ONEWIRE_PIN_LOW();
+        transfer.phase = OW_PHASE_RESET_RELEASE;
+        schedule(OW_RESET_LOW_US);
+    } else {
+        // 时隙都从中断中开始，拉低时间不受任务切换影响
+        transfer.phase = OW_PHASE_RESET_END;
+        schedule(2);
+    }
+
+    // 调度器运行后让出CPU，启动前（初始化阶段）直接等待
+    while (transfer.busy) {
+        if (osKernelGetState() == osKernelRunning) {
+            osDelay(1);
+        }
+    }
+
+    uint8_t result = transfer.presence ? 0 : 1;
+    trace_event(TRACE_ONEWIRE_END, result);
+    clock_scale_release();
+    onewire_unlock();
+    return result;
+}
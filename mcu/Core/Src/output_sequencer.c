@@ -0,0 +1,105 @@
+#include "output_sequencer.h"
+#include "clock_scale.h"
+#include "main.h"
+
+#define SEQ_5(v)  v, v, v, v, v   // 100 ms
+#define SEQ_ON    OUTPUT_DUTY_HALF
+
+// 三短一停：100 ms响、100 ms停各三次，再停700 ms
+static const uint8_t sequence_beep3[] = {
+    SEQ_5(SEQ_ON), SEQ_5(0), SEQ_5(SEQ_ON), SEQ_5(0), SEQ_5(SEQ_ON), SEQ_5(0),
+    SEQ_5(0), SEQ_5(0), SEQ_5(0), SEQ_5(0), SEQ_5(0), SEQ_5(0), SEQ_5(0),
+};
+
+// 两短一停：100 ms响、100 ms停各两次，再停600 ms
+static const uint8_t sequence_double[] = {
+    SEQ_5(SEQ_ON), SEQ_5(0), SEQ_5(SEQ_ON), SEQ_5(0),
+    SEQ_5(0), SEQ_5(0), SEQ_5(0), SEQ_5(0), SEQ_5(0), SEQ_5(0),
+};
+
+// 渐亮渐暗：占空比按2.0伽马预先计算，1秒渐亮、1秒渐暗
+static const uint8_t sequence_breathe[] = {
+    0, 0, 0, 1, 2, 3, 4, 5, 7, 8, 10, 12, 15, 17, 20, 23, 26, 29, 33, 37,
+    41, 45, 49, 54, 59, 64, 69, 74, 80, 86, 92, 98, 104, 111, 118, 125, 132, 140, 147, 155,
+    163, 171, 180, 189, 197, 207, 216, 225, 235, 245, 255, 245, 235, 225, 216, 207, 197, 189, 180, 171,
+    163, 155, 147, 140, 132, 125, 118, 111, 104, 98, 92, 86, 80, 74, 69, 64, 59, 54, 49, 45,
+    41, 37, 33, 29, 26, 23, 20, 17, 15, 12, 10, 8, 7, 5, 4, 3, 2, 1, 0, 0,
+};
+
+static const struct {
+    const uint8_t *steps;
+    uint16_t length;
+} presets[OUTPUT_SEQUENCE_COUNT] = {
+    [OUTPUT_SEQUENCE_BEEP3]   = { sequence_beep3, sizeof(sequence_beep3) },
+    [OUTPUT_SEQUENCE_DOUBLE]  = { sequence_double, sizeof(sequence_double) },
+    [OUTPUT_SEQUENCE_BREATHE] = { sequence_breathe, sizeof(sequence_breathe) },
+};
+
+// 各输出的DMA通道和目标寄存器（F103的DMA1请求映射是固定的）
+static DMA_Channel_TypeDef *const channels[OUTPUT_COUNT] = {
+    [OUTPUT_BUZZER] = DMA1_Channel3,  // TIM3_UP
+    [OUTPUT_LED]    = DMA1_Channel6,  // TIM3_CH1
+};
+static volatile uint32_t *const targets[OUTPUT_COUNT] = {
+    [OUTPUT_BUZZER] = &TIM4->CCR3,
+    [OUTPUT_LED]    = &TIM4->CCR4,
+};
+
+void output_sequencer_init(void) {
+    for (uint8_t output = 0; output < OUTPUT_COUNT; output++) {
+        output_sequencer_stop(output);
+    }
+
+    // TIM3计数频率10 kHz，每步产生一次更新和一次CC1的DMA请求，不开中断
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    __HAL_RCC_TIM3_CLK_ENABLE();
+    uint32_t clock = HAL_RCC_GetPCLK1Freq();
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) {
+        clock *= 2;
+    }
+    TIM3->CR1 = 0;
+    TIM3->PSC = clock / 10000U - 1;
+    TIM3->ARR = OUTPUT_SEQUENCE_STEP_MS * 10U - 1;
+    TIM3->CCR1 = OUTPUT_SEQUENCE_STEP_MS * 5U;  // 与更新错开半步
+    TIM3->CCMR1 = 0;                            // CC1为输出比较（冻结），只用于产生请求
+    TIM3->EGR = TIM_EGR_UG;                     // 装载预分频值
+    TIM3->SR = 0;
+    TIM3->DIER = TIM_DIER_UDE | TIM_DIER_CC1DE;
+    TIM3->CR1 = TIM_CR1_CEN;
+}
+
+// 内存8位到外设16位：DMA把每项零扩展后写入比较寄存器
+void output_sequencer_play(uint8_t output, const uint8_t *steps, uint16_t length, bool loop) {
+    if (output >= OUTPUT_COUNT || length == 0) {
+        return;
+    }
+    clock_scale_full(); // TIM3/TIM4的预分频按全速设置，播放期间不降频
+    DMA_Channel_TypeDef *channel = channels[output];
+    channel->CCR = 0;
+    channel->CPAR = (uint32_t)targets[output];
+    channel->CMAR = (uint32_t)steps;
+    channel->CNDTR = length;
+    channel->CCR = DMA_CCR_DIR | DMA_CCR_MINC | DMA_CCR_PSIZE_0 | (loop ? DMA_CCR_CIRC : 0) | DMA_CCR_EN;
+}
+
+bool output_sequencer_play_preset(uint8_t output, uint8_t sequence, bool loop) {
+    if (sequence >= OUTPUT_SEQUENCE_COUNT || !presets[sequence].steps) {
+        return false;
+    }
+    output_sequencer_play(output, presets[sequence].steps, presets[sequence].length, loop);
+    return true;
+}
+
+void output_sequencer_stop(uint8_t output) {
+    if (output < OUTPUT_COUNT) {
+        channels[output]->CCR = 0;
+    }
+}
+
+bool output_sequencer_playing(uint8_t output) {
+    if (output >= OUTPUT_COUNT) {
+        return false;
+    }
+    uint32_t ccr = channels[output]->CCR;
+    return (ccr & DMA_CCR_EN) && ((ccr & DMA_CCR_CIRC) || channels[output]->CNDTR != 0);
+}
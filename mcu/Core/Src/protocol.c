@@ -1,54 +1,126 @@
 #include "protocol.h"
-#include "main.h"
+#include "crc32.h"
+#include "frame_writer.h"
+#include "frame_parser.h"
+#include "ramfunc.h"
 #include <string.h>
 
-// STM32 CRC32 硬件计算（与标准CRC32不同）
-extern CRC_HandleTypeDef hcrc;
-
+// CRC32计算（与STM32硬件CRC一致，见crc32.h）
 uint32_t calculate_crc32(const uint8_t *data, size_t length) {
-    if (hcrc.Instance == NULL) {
-        // 如果CRC硬件未初始化，返回简单校验和作为备用
-        uint32_t sum = 0;
-        for (size_t i = 0; i < length; i++) {
-            sum += data[i];
+    return crc32_compute(data, length);
+}
+
+// 流帧很短，按半字节查表
+uint16_t calculate_crc16(uint16_t crc, const uint8_t *data, size_t length) {
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    };
+    while (length-- > 0) {
+        crc = (uint16_t)((crc << 4) ^ table[(crc >> 12) ^ (*data >> 4)]);
+        crc = (uint16_t)((crc << 4) ^ table[(crc >> 12) ^ (*data & 0x0F)]);
+        data++;
+    }
+    return crc;
+}
+
+// SWAR：字中等于0xAA或0x55的字节对应的最高位置1
+// 经典的“含零字节”判断只会在真正的零字节之上产生误报，因此最低的置位字节是准确的
+static inline uint32_t mark_byte_mask(uint32_t word) {
+    uint32_t a = word ^ 0xAAAAAAAAU;
+    uint32_t b = word ^ 0x55555555U;
+    return (((a - 0x01010101U) & ~a) | ((b - 0x01010101U) & ~b)) & 0x80808080U;
+}
+
+static inline bool is_mark_byte(uint8_t byte) {
+    return byte == 0xAA || byte == 0x55;
+}
+
+// 查找第一个需要转义的字节（0xAA/0x55），返回其下标，没有则返回length
+// 对齐后按32位字扫描，大部分不需要转义的数据每4字节只需几条指令
+RAMFUNC size_t find_escape_byte(const uint8_t *data, size_t length) {
+    size_t i = 0;
+    
+    while (i < length && ((uintptr_t)(data + i) & 3U) != 0) {
+        if (is_mark_byte(data[i])) {
+            return i;
         }
-        return sum;
+        i++;
     }
     
-    // 使用STM32硬件CRC计算
-    return HAL_CRC_Calculate(&hcrc, (uint32_t*)data, (length + 3) / 4);
+    for (; i + 4 <= length; i += 4) {
+        uint32_t word;
+        memcpy(&word, data + i, sizeof(word));
+        
+        uint32_t mask = mark_byte_mask(word);
+        if (mask != 0) {
+            // 小端：最低置位所在字节即地址最小的匹配字节
+            return i + ((size_t)__builtin_ctz(mask) >> 3);
+        }
+    }
+    
+    while (i < length) {
+        if (is_mark_byte(data[i])) {
+            return i;
+        }
+        i++;
+    }
+    
+    return length;
 }
 
-// 数据转义处理
+// 数据转义处理：不需要转义的连续字节整段拷贝
 int escape_data(const uint8_t *input, size_t input_len, uint8_t *output, size_t output_size) {
     size_t out_pos = 0;
+    size_t i = 0;
     
-    for (size_t i = 0; i < input_len && out_pos < output_size; i++) {
-        uint8_t byte = input[i];
+    while (i < input_len) {
+        size_t run = find_escape_byte(input + i, input_len - i);
+        if (out_pos + run > output_size) {
+            return -1; // 缓冲区不足
+        }
+        memcpy(output + out_pos, input + i, run);
+        out_pos += run;
+        i += run;
         
-        if (byte == 0xAA || byte == 0x55) {
+        if (i < input_len) {
             // 需要转义
-            if (out_pos + 1 >= output_size) {
+            if (out_pos + 2 > output_size) {
                 return -1; // 缓冲区不足
             }
-            output[out_pos++] = byte;
+            output[out_pos++] = input[i++];
             output[out_pos++] = ESCAPE_BYTE;
-        } else {
-            output[out_pos++] = byte;
         }
     }
     
     return out_pos;
 }
 
-// 数据去转义处理
+// 数据去转义处理：两个标记字节之间的数据整段拷贝
 int unescape_data(const uint8_t *input, size_t input_len, uint8_t *output, size_t output_size) {
     size_t out_pos = 0;
     
-    for (size_t i = 0; i < input_len && out_pos < output_size; i++) {
+    for (size_t i = 0; i < input_len; i++) {
+        size_t run = find_escape_byte(input + i, input_len - i);
+        if (run > 0) {
+            if (out_pos + run > output_size) {
+                return -1; // 缓冲区不足
+            }
+            memcpy(output + out_pos, input + i, run);
+            out_pos += run;
+            i += run;
+            if (i >= input_len) {
+                break;
+            }
+        }
+        
+        if (out_pos >= output_size) {
+            return -1; // 缓冲区不足
+        }
+        
         uint8_t byte = input[i];
         
-        if ((byte == 0xAA || byte == 0x55) && i + 1 < input_len && input[i + 1] == ESCAPE_BYTE) {
+        if (i + 1 < input_len && input[i + 1] == ESCAPE_BYTE) {
             // 这是转义序列
             output[out_pos++] = byte;
             i++; // 跳过转义字节
@@ -64,147 +136,120 @@ int unescape_data(const uint8_t *input, size_t input_len, uint8_t *output, size_
     return out_pos;
 }
 
-// 查找数据包边界
+// 查找数据包边界：与流式解析器使用同一套转义判定（frame_classify_pair）
+// start_pos指向起始符之后，end_pos指向结束符第1字节
 bool find_packet_boundaries(const uint8_t *buffer, size_t buffer_len, size_t *start_pos, size_t *end_pos) {
-    bool start_found = false;
+    size_t i = 0;
     
-    for (size_t i = 0; i < buffer_len - 1; i++) {
-        if (!start_found && buffer[i] == START_MARK_1 && buffer[i + 1] == START_MARK_2) {
-            *start_pos = i + 2; // 跳过起始符
-            start_found = true;
-            i++; // 跳过下一个字节
+    while (i + 1 < buffer_len) {
+        if (buffer[i] != START_MARK_1 || buffer[i + 1] != START_MARK_2) {
+            i++;
             continue;
         }
         
-        if (start_found && buffer[i] == END_MARK_1 && buffer[i + 1] == END_MARK_2) {
-            // 需要确认这不是转义序列
-            bool is_escaped = false;
-            if (i > 0 && buffer[i - 1] == ESCAPE_BYTE) {
-                // 检查前面是否有0x55
-                if (i > 1 && buffer[i - 2] == 0x55) {
-                    is_escaped = true;
-                }
+        size_t body = i + 2;
+        size_t j = body;
+        
+        while (j + 1 < buffer_len) {
+            j += find_escape_byte(buffer + j, buffer_len - j);
+            if (j + 1 >= buffer_len) {
+                break;
             }
             
-            if (!is_escaped) {
-                *end_pos = i;
+            FramePair pair = frame_classify_pair(buffer[j], buffer[j + 1]);
+            if (pair == FRAME_PAIR_ESCAPED) {
+                j += 2;
+                continue;
+            }
+            if (pair == FRAME_PAIR_END) {
+                *start_pos = body;
+                *end_pos = j;
                 return true;
             }
+            break; // 帧损坏，从该位置继续寻找起始符
+        }
+        
+        if (j + 1 >= buffer_len) {
+            return false;
         }
+        i = j;
     }
     
     return false;
 }
 
-// 构建数据包
+static uint8_t tx_version = PROTOCOL_VERSION;
+static uint8_t local_address = PROTOCOL_ADDRESS_NONE;
+
+void protocol_set_tx_version(uint8_t version) {
+    if (protocol_is_version_supported(version)) {
+        tx_version = version;
+    }
+}
+
+uint8_t protocol_get_tx_version(void) {
+    return tx_version;
+}
+
+bool protocol_is_version_supported(uint8_t version) {
+    uint8_t framing = PROTOCOL_FRAMING(version);
+    return framing == PROTOCOL_VERSION || framing == PROTOCOL_VERSION_COBS;
+}
+
+void protocol_set_address(uint8_t address) {
+    local_address = address;
+}
+
+uint8_t protocol_get_address(void) {
+    return local_address;
+}
+
+// 构建数据包：单遍编码输出，组帧方式由当前发送版本决定，输出长度为实际编码后的长度
 int build_packet(uint8_t type, uint16_t packet_id, uint16_t response_id, 
                 const uint8_t *data, uint16_t data_len, uint8_t *output, size_t output_size) {
-    if (output_size < 16 + data_len * 2) { // 预留转义空间
-        return -1;
-    }
-    
-    size_t pos = 0;
-    
-    // 起始符
-    output[pos++] = START_MARK_1;
-    output[pos++] = START_MARK_2;
-    
-    // 构建包头（不转义）
     PacketHeader header;
-    header.version = PROTOCOL_VERSION;
+    header.version = tx_version;
+    header.address = local_address;
     header.type = type;
     header.packet_id = packet_id;
     header.response_id = response_id;
     header.data_length = data_len;
     
-    // 准备需要转义的数据（包头+数据）
-    uint8_t temp_buffer[MAX_PACKET_SIZE];
-    size_t temp_pos = 0;
-    
-    // 复制包头
-    memcpy(temp_buffer + temp_pos, &header, sizeof(PacketHeader));
-    temp_pos += sizeof(PacketHeader);
-    
-    // 复制数据
-    if (data && data_len > 0) {
-        memcpy(temp_buffer + temp_pos, data, data_len);
-        temp_pos += data_len;
+    if (output_size > UINT16_MAX) {
+        output_size = UINT16_MAX;
     }
     
-    // 计算CRC32
-    uint32_t crc = calculate_crc32(temp_buffer, temp_pos);
-    memcpy(temp_buffer + temp_pos, &crc, sizeof(uint32_t));
-    temp_pos += sizeof(uint32_t);
-    
-    // 转义数据
-    int escaped_len = escape_data(temp_buffer, temp_pos, output + pos, output_size - pos - 2);
-    if (escaped_len < 0) {
-        return -1;
-    }
-    pos += escaped_len;
-    
-    // 结束符
-    if (pos + 2 > output_size) {
-        return -1;
-    }
-    output[pos++] = END_MARK_1;
-    output[pos++] = END_MARK_2;
-    
-    return pos;
+    FrameWriter writer;
+    frame_writer_begin(&writer, output, (uint16_t)output_size, &header);
+    frame_writer_write(&writer, data, data_len);
+    return frame_writer_finish(&writer);
 }
 
-// 解析数据包
+// 解析数据包：用流式解析器扫描缓冲区，与接收路径的组帧和校验规则完全一致
+// 损坏的帧被跳过，返回缓冲区中第一个有效数据包
 int parse_packet(const uint8_t *buffer, size_t buffer_len, PacketHeader *header, uint8_t *data, size_t data_size) {
-    size_t start_pos, end_pos;
-    
-    // 查找数据包边界
-    if (!find_packet_boundaries(buffer, buffer_len, &start_pos, &end_pos)) {
-        return -1; // 未找到完整数据包
-    }
-    
-    // 提取并去转义数据
-    uint8_t temp_buffer[MAX_PACKET_SIZE];
-    int unescaped_len = unescape_data(buffer + start_pos, end_pos - start_pos, temp_buffer, sizeof(temp_buffer));
-    if (unescaped_len < 0) {
-        return -1; // 去转义失败
-    }
-    
-    // 检查最小长度
-    if (unescaped_len < (int)(sizeof(PacketHeader) + sizeof(uint32_t))) {
-        return -1; // 数据包太短
-    }
-    
-    // 提取包头
-    memcpy(header, temp_buffer, sizeof(PacketHeader));
-    
-    // 验证版本
-    if (header->version != PROTOCOL_VERSION) {
-        return -1; // 版本不匹配
-    }
-    
-    // 验证数据长度
-    size_t expected_len = sizeof(PacketHeader) + header->data_length + sizeof(uint32_t);
-    if ((size_t)unescaped_len != expected_len) {
-        return -1; // 长度不匹配
-    }
-    
-    // 验证CRC32
-    uint32_t received_crc;
-    memcpy(&received_crc, temp_buffer + unescaped_len - sizeof(uint32_t), sizeof(uint32_t));
-    uint32_t calculated_crc = calculate_crc32(temp_buffer, unescaped_len - sizeof(uint32_t));
-    if (received_crc != calculated_crc) {
-        return -1; // CRC校验失败
-    }
+    uint8_t frame_buffer[MAX_PACKET_SIZE];
+    FrameParser parser;
+    frame_parser_init(&parser, frame_buffer, sizeof(frame_buffer));
     
-    // 提取数据
-    if (header->data_length > 0) {
-        if (data_size < header->data_length) {
-            return -1; // 输出缓冲区太小
+    for (size_t i = 0; i < buffer_len; i++) {
+        if (frame_parser_feed(&parser, buffer[i]) != FRAME_RESULT_OK) {
+            continue;
+        }
+        
+        memcpy(header, frame_parser_header(&parser), sizeof(PacketHeader));
+        
+        // 提取数据
+        if (header->data_length > 0) {
+            if (data_size < header->data_length) {
+                return -1; // 输出缓冲区太小
+            }
+            memcpy(data, frame_parser_payload(&parser), header->data_length);
         }
-        memcpy(data, temp_buffer + sizeof(PacketHeader), header->data_length);
+        return header->data_length;
     }
     
-    return header->data_length;
+    return -1; // 未找到完整数据包
 }
 
 // TLV写入函数
@@ -228,6 +273,16 @@ int write_tlv_uint16(uint8_t *buffer, size_t buffer_size, const char *tag, uint1
     return 6;
 }
 
+int write_tlv_uint32(uint8_t *buffer, size_t buffer_size, const char *tag, uint32_t value) {
+    if (buffer_size < 8) return -1; // 2+2+4
+    
+    memcpy(buffer, tag, 2);
+    uint16_t length = 4;
+    memcpy(buffer + 2, &length, 2);
+    memcpy(buffer + 4, &value, 4);
+    return 8;
+}
+
 int write_tlv_uint64(uint8_t *buffer, size_t buffer_size, const char *tag, uint64_t value) {
     if (buffer_size < 12) return -1; // 2+2+8
     
@@ -238,6 +293,19 @@ int write_tlv_uint64(uint8_t *buffer, size_t buffer_size, const char *tag, uint6
     return 12;
 }
 
+int write_tlv_temperature(uint8_t *buffer, size_t buffer_size, const char *tag, int16_t value, uint8_t format) {
+    if (format == TEMP_FORMAT_INT16) {
+        if (buffer_size < 6) return -1; // 2+2+2
+        
+        memcpy(buffer, tag, 2);
+        uint16_t length = 2;
+        memcpy(buffer + 2, &length, 2);
+        memcpy(buffer + 4, &value, 2);
+        return 6;
+    }
+    return write_tlv_float32(buffer, buffer_size, tag, (float)value / TEMP_SCALE);
+}
+
 int write_tlv_float32(uint8_t *buffer, size_t buffer_size, const char *tag, float value) {
     if (buffer_size < 8) return -1; // 2+2+4
     
@@ -269,9 +337,26 @@ int write_tlv_raw(uint8_t *buffer, size_t buffer_size, const char *tag, const ui
     return 4 + length;
 }
 
+int write_tlv_begin(uint8_t *buffer, size_t buffer_size, const char *tag) {
+    if (buffer_size < 4) return -1;
+    
+    memcpy(buffer, tag, 2);
+    buffer[2] = 0;
+    buffer[3] = 0;
+    return 4;
+}
+
+int write_tlv_end(uint8_t *field, size_t value_length) {
+    if (value_length > UINT16_MAX) return -1;
+    
+    uint16_t length = (uint16_t)value_length;
+    memcpy(field + 2, &length, 2);
+    return 4 + length;
+}
+
 // TLV读取函数
 int read_tlv_uint8(const uint8_t *buffer, size_t buffer_size, const char *tag, uint8_t *value) {
-    for (size_t i = 0; i < buffer_size - 4; ) {
+    for (size_t i = 0; i + 4 < buffer_size; ) {
         if (memcmp(buffer + i, tag, 2) == 0) {
             uint16_t length;
             memcpy(&length, buffer + i + 2, 2);
@@ -290,7 +375,7 @@ int read_tlv_uint8(const uint8_t *buffer, size_t buffer_size, const char *tag, u
 }
 
 int read_tlv_uint16(const uint8_t *buffer, size_t buffer_size, const char *tag, uint16_t *value) {
-    for (size_t i = 0; i < buffer_size - 4; ) {
+    for (size_t i = 0; i + 4 < buffer_size; ) {
         if (memcmp(buffer + i, tag, 2) == 0) {
             uint16_t length;
             memcpy(&length, buffer + i + 2, 2);
@@ -308,8 +393,27 @@ int read_tlv_uint16(const uint8_t *buffer, size_t buffer_size, const char *tag,
     return -1;
 }
 
+int read_tlv_uint32(const uint8_t *buffer, size_t buffer_size, const char *tag, uint32_t *value) {
+    for (size_t i = 0; i + 4 < buffer_size; ) {
+        if (memcmp(buffer + i, tag, 2) == 0) {
+            uint16_t length;
+            memcpy(&length, buffer + i + 2, 2);
+            if (length == 4 && i + 4 + length <= buffer_size) {
+                memcpy(value, buffer + i + 4, 4);
+                return 1;
+            }
+        }
+        
+        // 跳到下一个TLV
+        uint16_t length;
+        memcpy(&length, buffer + i + 2, 2);
+        i += 4 + length;
+    }
+    return -1;
+}
+
 int read_tlv_uint64(const uint8_t *buffer, size_t buffer_size, const char *tag, uint64_t *value) {
-    for (size_t i = 0; i < buffer_size - 4; ) {
+    for (size_t i = 0; i + 4 < buffer_size; ) {
         if (memcmp(buffer + i, tag, 2) == 0) {
             uint16_t length;
             memcpy(&length, buffer + i + 2, 2);
@@ -328,7 +432,7 @@ int read_tlv_uint64(const uint8_t *buffer, size_t buffer_size, const char *tag,
 }
 
 int read_tlv_float32(const uint8_t *buffer, size_t buffer_size, const char *tag, float *value) {
-    for (size_t i = 0; i < buffer_size - 4; ) {
+    for (size_t i = 0; i + 4 < buffer_size; ) {
         if (memcmp(buffer + i, tag, 2) == 0) {
             uint16_t length;
             memcpy(&length, buffer + i + 2, 2);
@@ -347,7 +451,7 @@ int read_tlv_float32(const uint8_t *buffer, size_t buffer_size, const char *tag,
 }
 
 int read_tlv_string(const uint8_t *buffer, size_t buffer_size, const char *tag, char *str, size_t str_size) {
-    for (size_t i = 0; i < buffer_size - 4; ) {
+    for (size_t i = 0; i + 4 < buffer_size; ) {
         if (memcmp(buffer + i, tag, 2) == 0) {
             uint16_t length;
             memcpy(&length, buffer + i + 2, 2);
@@ -367,7 +471,7 @@ int read_tlv_string(const uint8_t *buffer, size_t buffer_size, const char *tag,
 }
 
 int read_tlv_raw(const uint8_t *buffer, size_t buffer_size, const char *tag, uint8_t *data, uint16_t *length) {
-    for (size_t i = 0; i < buffer_size - 4; ) {
+    for (size_t i = 0; i + 4 < buffer_size; ) {
         if (memcmp(buffer + i, tag, 2) == 0) {
             uint16_t tlv_length;
             memcpy(&tlv_length, buffer + i + 2, 2);
@@ -385,3 +489,172 @@ int read_tlv_raw(const uint8_t *buffer, size_t buffer_size, const char *tag, uin
     }
     return -1;
 }
+
+int read_tlv_view(const uint8_t *buffer, size_t buffer_size, const char *tag, const uint8_t **value, uint16_t *length) {
+    TlvIndex index;
+    tlv_index_build(&index, buffer, buffer_size);
+    return tlv_index_get_view(&index, tag, value, length);
+}
+
+// TLV索引
+int tlv_index_build(TlvIndex *index, const uint8_t *buffer, size_t buffer_size) {
+    if (!index) {
+        return -1;
+    }
+    
+    index->buffer = buffer;
+    index->count = 0;
+    if (!buffer) {
+        return 0;
+    }
+    
+    size_t offset = 0;
+    while (offset + 4 <= buffer_size && index->count < TLV_INDEX_MAX_FIELDS) {
+        uint16_t length;
+        memcpy(&length, buffer + offset + 2, 2);
+        if (offset + 4 + length > buffer_size) {
+            break; // 字段不完整
+        }
+        
+        TlvField *field = &index->fields[index->count++];
+        field->tag[0] = buffer[offset];
+        field->tag[1] = buffer[offset + 1];
+        field->offset = (uint16_t)(offset + 4);
+        field->length = length;
+        offset += 4 + length;
+    }
+    
+    return index->count;
+}
+
+void tlv_cursor_init(TlvCursor *cursor, const uint8_t *buffer, size_t buffer_size) {
+    cursor->buffer = buffer;
+    cursor->size = buffer ? buffer_size : 0;
+    cursor->offset = 0;
+}
+
+int tlv_cursor_next(TlvCursor *cursor, TlvField *field) {
+    if (cursor->offset == cursor->size) {
+        return 0;
+    }
+    if (cursor->offset + 4 > cursor->size) {
+        return -1;
+    }
+    
+    const uint8_t *header = cursor->buffer + cursor->offset;
+    uint16_t length;
+    memcpy(&length, header + 2, 2);
+    if (cursor->offset + 4 + length > cursor->size) {
+        return -1; // 字段不完整
+    }
+    
+    field->tag[0] = header[0];
+    field->tag[1] = header[1];
+    field->offset = (uint16_t)(cursor->offset + 4);
+    field->length = length;
+    cursor->offset += 4 + length;
+    return 1;
+}
+
+// 查找指定标签且长度满足要求的字段，length为0表示不限长度
+static const TlvField *find_field(const TlvIndex *index, const char *tag, uint16_t length) {
+    for (uint8_t i = 0; i < index->count; i++) {
+        const TlvField *field = &index->fields[i];
+        if (memcmp(field->tag, tag, 2) == 0 && (length == 0 || field->length == length)) {
+            return field;
+        }
+    }
+    return NULL;
+}
+
+const TlvField *tlv_index_find(const TlvIndex *index, const char *tag) {
+    return find_field(index, tag, 0);
+}
+
+static int get_fixed(const TlvIndex *index, const char *tag, void *value, uint16_t size) {
+    const TlvField *field = find_field(index, tag, size);
+    if (!field) {
+        return -1;
+    }
+    memcpy(value, index->buffer + field->offset, size);
+    return 1;
+}
+
+int tlv_index_get_uint8(const TlvIndex *index, const char *tag, uint8_t *value) {
+    return get_fixed(index, tag, value, sizeof(*value));
+}
+
+int tlv_index_get_uint16(const TlvIndex *index, const char *tag, uint16_t *value) {
+    return get_fixed(index, tag, value, sizeof(*value));
+}
+
+int tlv_index_get_uint32(const TlvIndex *index, const char *tag, uint32_t *value) {
+    return get_fixed(index, tag, value, sizeof(*value));
+}
+
+int tlv_index_get_uint64(const TlvIndex *index, const char *tag, uint64_t *value) {
+    return get_fixed(index, tag, value, sizeof(*value));
+}
+
+int tlv_index_get_float32(const TlvIndex *index, const char *tag, float *value) {
+    return get_fixed(index, tag, value, sizeof(*value));
+}
+
+int tlv_decode_temperature(const uint8_t *value, uint16_t length, int16_t *temperature) {
+    if (length == sizeof(int16_t)) {
+        memcpy(temperature, value, sizeof(int16_t));
+        return 1;
+    }
+    if (length != sizeof(float)) {
+        return -1;
+    }
+    
+    float celsius;
+    memcpy(&celsius, value, sizeof(celsius));
+    float scaled = celsius * TEMP_SCALE;
+    if (!(scaled > INT16_MIN && scaled <= INT16_MAX)) {
+        return -1; // 超出范围或NaN，INT16_MIN保留为TEMP_INVALID
+    }
+    *temperature = (int16_t)(scaled >= 0.0f ? scaled + 0.5f : scaled - 0.5f);
+    return 1;
+}
+
+int tlv_index_get_temperature(const TlvIndex *index, const char *tag, int16_t *value) {
+    const TlvField *field = tlv_index_find(index, tag);
+    if (!field) {
+        return -1;
+    }
+    return tlv_decode_temperature(index->buffer + field->offset, field->length, value);
+}
+
+int tlv_index_get_string(const TlvIndex *index, const char *tag, char *str, size_t str_size) {
+    const TlvField *field = tlv_index_find(index, tag);
+    if (!field || field->length >= str_size) {
+        return -1;
+    }
+    memcpy(str, index->buffer + field->offset, field->length);
+    str[field->length] = '\0';
+    return field->length;
+}
+
+int tlv_index_get_raw(const TlvIndex *index, const char *tag, uint8_t *data, uint16_t *length) {
+    const TlvField *field = tlv_index_find(index, tag);
+    if (!field || field->length > *length) {
+        return -1;
+    }
+    if (field->length > 0) {
+        memcpy(data, index->buffer + field->offset, field->length);
+    }
+    *length = field->length;
+    return field->length;
+}
+
+int tlv_index_get_view(const TlvIndex *index, const char *tag, const uint8_t **value, uint16_t *length) {
+    const TlvField *field = tlv_index_find(index, tag);
+    if (!field) {
+        return -1;
+    }
+    *value = index->buffer + field->offset;
+    *length = field->length;
+    return field->length;
+}
@@ -0,0 +1,108 @@
+#include "response_cache.h"
+#include "main.h"
+#include <string.h>
+
+typedef struct {
+    bool valid;
+    bool answered;           // 已保存应答帧，否则为挂起状态
+    uint8_t link;
+    uint16_t packet_id;
+    uint32_t request_crc;
+    uint32_t tick;           // 开始执行的时刻
+    uint16_t length;
+    uint8_t frame[RESPONSE_CACHE_FRAME_MAX];
+} CachedResponse;
+
+static CachedResponse entries[RESPONSE_CACHE_ENTRIES];
+static uint32_t replays = 0;
+
+static bool expired(const CachedResponse *entry) {
+    return HAL_GetTick() - entry->tick >= RESPONSE_CACHE_TTL_MS;
+}
+
+static CachedResponse *find(uint8_t link, uint16_t packet_id) {
+    for (uint8_t i = 0; i < RESPONSE_CACHE_ENTRIES; i++) {
+        CachedResponse *entry = &entries[i];
+        if (entry->valid && entry->link == link && entry->packet_id == packet_id) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+void response_cache_reset(void) {
+    memset(entries, 0, sizeof(entries));
+    replays = 0;
+}
+
+int response_cache_lookup(uint8_t link, uint16_t packet_id, uint32_t request_crc,
+                          uint8_t *frame, uint16_t frame_size, uint16_t *length) {
+    CachedResponse *entry = find(link, packet_id);
+    if (entry == NULL || entry->request_crc != request_crc || expired(entry)) {
+        return RESPONSE_CACHE_MISS;
+    }
+    if (!entry->answered) {
+        return RESPONSE_CACHE_PENDING;
+    }
+    if (entry->length > frame_size) {
+        return RESPONSE_CACHE_MISS;
+    }
+    memcpy(frame, entry->frame, entry->length);
+    *length = entry->length;
+    replays++;
+    return RESPONSE_CACHE_HIT;
+}
+
+void response_cache_begin(uint8_t link, uint16_t packet_id, uint32_t request_crc) {
+    // 同一编号的旧项、空项或过期项优先，否则替换最早的一项
+    CachedResponse *slot = find(link, packet_id);
+    for (uint8_t i = 0; slot == NULL && i < RESPONSE_CACHE_ENTRIES; i++) {
+        if (!entries[i].valid || expired(&entries[i])) {
+            slot = &entries[i];
+        }
+    }
+    if (slot == NULL) {
+        slot = &entries[0];
+        for (uint8_t i = 1; i < RESPONSE_CACHE_ENTRIES; i++) {
+            if ((int32_t)(entries[i].tick - slot->tick) < 0) {
+                slot = &entries[i];
+            }
+        }
+    }
+    slot->valid = true;
+    slot->answered = false;
+    slot->link = link;
+    slot->packet_id = packet_id;
+    slot->request_crc = request_crc;
+    slot->tick = HAL_GetTick();
+    slot->length = 0;
+}
+
+void response_cache_store(uint8_t link, uint16_t packet_id, const uint8_t *frame, uint16_t length) {
+    CachedResponse *entry = find(link, packet_id);
+    if (entry == NULL) {
+        return;
+    }
+    if (length > sizeof(entry->frame)) {
+        entry->valid = false;
+        return;
+    }
+    memcpy(entry->frame, frame, length);
+    entry->length = length;
+    entry->answered = true;
+}
+
+void response_cache_drop(uint8_t link, uint16_t packet_id) {
+    CachedResponse *entry = find(link, packet_id);
+    if (entry != NULL) {
+        entry->valid = false;
+    }
+}
+
+uint32_t response_cache_replays(void) {
+    return replays;
+}
+
+void response_cache_reset_stats(void) {
+    replays = 0;
+}
@@ -0,0 +1,121 @@
+#include "ring_buffer.h"
+#include <string.h>
+
+// head/tail的发布使用release/acquire语义，保证数据先于索引可见
+#define RB_LOAD_ACQUIRE(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define RB_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+bool ring_buffer_init(RingBuffer *rb, uint8_t *storage, uint16_t size) {
+    if (!rb || !storage || size == 0 || size > 16384 || (size & (size - 1)) != 0) {
+        return false;
+    }
+    
+    rb->buffer = storage;
+    rb->size = size;
+    rb->mask = size - 1;
+    rb->head = 0;
+    rb->tail = 0;
+    rb->overflows = 0;
+    rb->peak = 0;
+    return true;
+}
+
+void ring_buffer_reset(RingBuffer *rb) {
+    rb->head = 0;
+    rb->tail = 0;
+}
+
+uint16_t ring_buffer_push(RingBuffer *rb, const uint8_t *data, uint16_t length) {
+    uint16_t head = rb->head;
+    uint16_t tail = RB_LOAD_ACQUIRE(&rb->tail);
+    uint16_t space = rb->size - (uint16_t)(head - tail);
+    
+    if (length > space) {
+        length = space;
+    }
+    
+    // 最多分两段拷贝（回绕处）
+    uint16_t offset = head & rb->mask;
+    uint16_t first = rb->size - offset;
+    if (first > length) {
+        first = length;
+    }
+    memcpy(rb->buffer + offset, data, first);
+    memcpy(rb->buffer, data + first, length - first);
+    
+    RB_STORE_RELEASE(&rb->head, (uint16_t)(head + length));
+    return length;
+}
+
+bool ring_buffer_commit_to(RingBuffer *rb, uint16_t write_pos) {
+    uint16_t head = rb->head;
+    uint16_t advance = (uint16_t)(write_pos - (head & rb->mask)) & rb->mask;
+    
+    if (advance == 0) {
+        return true;
+    }
+    
+    uint16_t tail = RB_LOAD_ACQUIRE(&rb->tail);
+    bool ok = (uint16_t)(head + advance - tail) <= rb->size;
+    
+    RB_STORE_RELEASE(&rb->head, (uint16_t)(head + advance));
+    return ok;
+}
+
+uint16_t ring_buffer_peek(RingBuffer *rb, const uint8_t **data) {
+    uint16_t head = RB_LOAD_ACQUIRE(&rb->head);
+    uint16_t tail = rb->tail;
+    uint16_t count = (uint16_t)(head - tail);
+    
+    if (count > rb->size) {
+        // 生产者覆盖了未读数据，内容已不可信，整体丢弃
+        rb->overflows++;
+        RB_STORE_RELEASE(&rb->tail, head);
+        return 0;
+    }
+    if (count > rb->peak) {
+        rb->peak = count;
+    }
+    
+    uint16_t offset = tail & rb->mask;
+    uint16_t contiguous = rb->size - offset;
+    if (contiguous > count) {
+        contiguous = count;
+    }
+    
+    *data = rb->buffer + offset;
+    return contiguous;
+}
+
+void ring_buffer_consume(RingBuffer *rb, uint16_t length) {
+    RB_STORE_RELEASE(&rb->tail, (uint16_t)(rb->tail + length));
+}
+
+uint16_t ring_buffer_pop(RingBuffer *rb, uint8_t *data, uint16_t length) {
+    uint16_t total = 0;
+    
+    while (total < length) {
+        const uint8_t *span;
+        uint16_t n = ring_buffer_peek(rb, &span);
+        if (n == 0) {
+            break;
+        }
+        if (n > length - total) {
+            n = length - total;
+        }
+        memcpy(data + total, span, n);
+        ring_buffer_consume(rb, n);
+        total += n;
+    }
+    
+    return total;
+}
+
+uint16_t ring_buffer_count(const RingBuffer *rb) {
+    return (uint16_t)(RB_LOAD_ACQUIRE(&rb->head) - RB_LOAD_ACQUIRE(&rb->tail));
+}
+
+uint16_t ring_buffer_space(const RingBuffer *rb) {
+    uint16_t count = ring_buffer_count(rb);
+    return count >= rb->size ? 0 : rb->size - count;
+}
@@ -0,0 +1,568 @@
+#include "rtc_clock.h"
+#include "config_store.h"
+#include "timebase.h"
+#include "test_mode.h"
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <string.h>
+
+// 外部句柄
+extern RTC_HandleTypeDef hrtc;
+
+#define SECONDS_PER_DAY 86400U
+#define RTC_PRESCALER_NOMINAL (LSE_VALUE - 1U)  // RTC_AUTO_1_SECOND
+#define RTC_CAL_STEPS_PER_TICK ((1UL << 20) / LSE_VALUE) // 预分频值减1相当于的校准步数（32）
+
+// 备份寄存器（由VBAT供电，与RTC一起在复位后保持）：DR1为设置过时间的标记，DR2为phase_ms
+#define RTC_BKP_MAGIC    0x5254U // "RT"
+#define RTC_BKP_REG_MAGIC RTC_BKP_DR1
+#define RTC_BKP_REG_PHASE RTC_BKP_DR2
+
+// 计数器以外的时钟状态：phase_ms为加在计数器上的亚秒部分（F1的预分频器不能置位，
+// 按毫秒设置时间时由它补齐），prescaler_ticks为当前每秒的RTC时钟数。
+// 写入时用version做seqlock（与log_store相同），读取方比较前后的version。
+// 读取方不让出CPU（空闲任务在调度器挂起时也要读取），写入期间挂起调度器，
+// 优先级更高的采样任务不会在写入中途抢占并一直等待
+static uint16_t phase_ms = 0;
+static uint32_t prescaler_ticks = LSE_VALUE;
+static int16_t correction = 0;
+static volatile uint32_t version = 0;
+
+// 定时唤醒的槽：counter为触发时的计数器值，0为未设置；alarm_counter为ALR中的值。
+// 由任务在临界段中修改，闹钟中断优先级最低，与临界段互斥
+typedef struct {
+    uint32_t counter;
+    RtcWakeCallback callback;
+} RtcWake;
+static RtcWake wakes[RTC_WAKE_COUNT];
+static uint32_t alarm_counter = 0;
+
+// 校时状态：drift_since_ms为上一次估计频率误差之后第一次校时的设备时间，
+// drift_offset_ms为此后各次校时累计调整的时间
+static bool drift_valid = false;
+static uint64_t drift_since_ms = 0;
+static int64_t drift_offset_ms = 0;
+
+bool rtc_is_initialized(void) {
+    // 简单检查RTC是否初始化
+    return (hrtc.Instance != NULL);
+}
+
+// 计数器分为两个16位寄存器：两次读高16位不同时说明读取期间低16位进位，重读低16位
+static uint32_t rtc_read_counter(void) {
+    uint16_t high = RTC->CNTH;
+    uint16_t low = RTC->CNTL;
+    uint16_t high_again = RTC->CNTH;
+    if (high_again != high) {
+        high = high_again;
+        low = RTC->CNTL;
+    }
+    return ((uint32_t)high << 16) | low;
+}
+
+static inline uint32_t rtc_read_divider(void) {
+    return ((RTC->DIVH & RTC_DIVH_RTC_DIV) << 16) | RTC->DIVL;
+}
+
+// 本秒已经过的毫秒数（不含phase_ms）
+static inline uint32_t divider_elapsed_ms(uint32_t divider, uint32_t ticks) {
+    return (divider < ticks) ? (ticks - 1U - divider) * 1000U / ticks : 0;
+}
+
+// 读取计数器和本秒已经过的毫秒数：预分频器从prescaler_ticks - 1递减到0时计数器加1，
+// 读取期间跨秒或时钟被修改则重读
+static uint32_t rtc_read(uint16_t *millis) {
+    uint32_t seconds, divider, ticks, start;
+    uint16_t phase;
+    do {
+        while ((start = __atomic_load_n(&version, __ATOMIC_ACQUIRE)) & 1U) {
+        }
+        ticks = prescaler_ticks;
+        phase = phase_ms;
+        seconds = rtc_read_counter();
+        divider = rtc_read_divider();
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (rtc_read_counter() != seconds || version != start);
+    
+    uint32_t ms = divider_elapsed_ms(divider, ticks) + phase;
+    if (ms >= 1000U) {
+        seconds++;
+        ms -= 1000U;
+    }
+    *millis = (uint16_t)ms;
+    return seconds;
+}
+
+static void wake_fire_all(void);
+
+static inline void write_begin(void) {
+    if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+        vTaskSuspendAll();
+    }
+    __atomic_store_n(&version, version + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void write_end(void) {
+    __atomic_store_n(&version, version + 1, __ATOMIC_RELEASE);
+    if (xTaskGetSchedulerState() == taskSCHEDULER_SUSPENDED) {
+        xTaskResumeAll();
+    }
+}
+
+// 等待上一次写入RTC的操作完成（写入在RTC时钟域中进行，需要几个LSE周期）
+static bool rtc_wait_write_done(void) {
+    uint32_t start = HAL_GetTick();
+    while ((RTC->CRL & RTC_CRL_RTOFF) == 0) {
+        if (HAL_GetTick() - start > RTC_TIMEOUT_VALUE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool rtc_write_counter(uint32_t value) {
+    if (!rtc_wait_write_done()) {
+        return false;
+    }
+    RTC->CRL |= RTC_CRL_CNF;   // 进入配置模式
+    RTC->CNTH = (uint16_t)(value >> 16);
+    RTC->CNTL = (uint16_t)value;
+    RTC->CRL &= ~RTC_CRL_CNF;  // 退出配置模式后开始写入
+    return rtc_wait_write_done();
+}
+
+uint64_t rtc_get_timestamp(void) {
+    if (!rtc_is_initialized()) {
+        return 0;
+    }
+#if TEST_MODE
+    return test_mode_clock_ms() / 1000U;
+#endif
+    if (phase_ms == 0) {
+        return rtc_read_counter();
+    }
+    uint16_t millis;
+    return rtc_read(&millis);
+}
+
+uint64_t rtc_get_timestamp_ms(void) {
+    if (!rtc_is_initialized()) {
+        return 0;
+    }
+#if TEST_MODE
+    return test_mode_clock_ms();
+#endif
+    uint16_t millis;
+    uint32_t seconds = rtc_read(&millis);
+    return (uint64_t)seconds * 1000U + millis;
+}
+
+// 计数器按当前的亚秒位置写入，差值由phase_ms补齐；
+// 离下一秒不到2毫秒时先等到跨秒，避免写入期间计数器进位
+static bool rtc_write_ms(uint64_t timestamp_ms) {
+    if (timestamp_ms / 1000U > UINT32_MAX) {
+        return false;
+    }
+#if TEST_MODE
+    test_mode_clock_set_ms(timestamp_ms); // 只修改虚拟时钟，RTC和备份寄存器不变
+    wake_fire_all();
+    return true;
+#endif
+    uint32_t start = HAL_GetTick();
+    while (rtc_read_divider() * 1000U < 2U * prescaler_ticks && HAL_GetTick() - start < 2U) {
+    }
+    uint64_t counter_ms = timestamp_ms - divider_elapsed_ms(rtc_read_divider(), prescaler_ticks);
+    
+    write_begin();
+    phase_ms = (uint16_t)(counter_ms % 1000U);
+    bool ok = rtc_write_counter((uint32_t)(counter_ms / 1000U));
+    write_end();
+    if (ok) {
+        HAL_RTCEx_BKUPWrite(&hrtc, RTC_BKP_REG_PHASE, phase_ms);
+        HAL_RTCEx_BKUPWrite(&hrtc, RTC_BKP_REG_MAGIC, RTC_BKP_MAGIC);
+    }
+    wake_fire_all();
+    return ok;
+}
+
+bool rtc_restore(void) {
+    if (TEST_MODE || !rtc_is_initialized() || HAL_RTCEx_BKUPRead(&hrtc, RTC_BKP_REG_MAGIC) != RTC_BKP_MAGIC) {
+        return false; // 测试模式的虚拟时钟每次启动从默认时间开始
+    }
+    uint32_t phase = HAL_RTCEx_BKUPRead(&hrtc, RTC_BKP_REG_PHASE);
+    phase_ms = (uint16_t)(phase < 1000U ? phase : 0);
+    return true;
+}
+
+bool rtc_set_timestamp_ms(uint64_t timestamp_ms) {
+    if (!rtc_is_initialized()) {
+        return false;
+    }
+    drift_valid = false; // 手动设置的时间不能用来估计频率误差
+    return rtc_write_ms(timestamp_ms);
+}
+
+bool rtc_set_timestamp(uint32_t timestamp) {
+    return rtc_set_timestamp_ms((uint64_t)timestamp * 1000U);
+}
+
+uint32_t rtc_wait_ticks(uint64_t span_ms) {
+#if TEST_MODE
+    return test_clock_wait_ticks(span_ms, TEST_MODE_SPEED);
+#else
+    return span_ms > UINT32_MAX ? UINT32_MAX : (uint32_t)span_ms;
+#endif
+}
+
+// 日期和时间换算用的整秒数
+static uint32_t clock_seconds(void) {
+#if TEST_MODE
+    return (uint32_t)(test_mode_clock_ms() / 1000U);
+#else
+    return rtc_read_counter();
+#endif
+}
+
+int16_t rtc_get_correction(void) {
+    return correction;
+}
+
+// 预分频值和校准值都在配置模式下写入
+bool rtc_set_correction(int16_t steps) {
+    if (!rtc_is_initialized() || steps < RTC_CORRECTION_MIN || steps > RTC_CORRECTION_MAX) {
+        return false;
+    }
+    uint32_t ticks = LSE_VALUE;
+    uint32_t cal = (uint32_t)steps;
+    if (steps < 0) {
+        ticks--;                                     // 每秒少一个周期，约快32步
+        cal = (uint32_t)(steps + (int16_t)RTC_CAL_STEPS_PER_TICK); // 再用CAL调回
+    }
+    if (!rtc_wait_write_done()) {
+        return false;
+    }
+    
+    write_begin();
+    RTC->CRL |= RTC_CRL_CNF;
+    RTC->PRLH = (uint16_t)((ticks - 1U) >> 16);
+    RTC->PRLL = (uint16_t)(ticks - 1U);
+    RTC->CRL &= ~RTC_CRL_CNF;
+    MODIFY_REG(BKP->RTCCR, BKP_RTCCR_CAL, cal);
+    prescaler_ticks = ticks;
+    correction = steps;
+    bool ok = rtc_wait_write_done();
+    write_end();
+    return ok;
+}
+
+// HAL_RTC_Init()每次复位都重写预分频值，校准寄存器则随备份域保持，两者都按保存的值重写
+void rtc_load_correction(void) {
+    uint16_t length = 0;
+    const void *saved = config_store_find(CONFIG_KEY_CLOCK, &length);
+    int16_t steps = 0;
+    if (saved && length == sizeof(steps)) {
+        memcpy(&steps, saved, sizeof(steps));
+    }
+    if (!rtc_set_correction(steps)) {
+        rtc_set_correction(0); // 超出范围时不校准
+    }
+}
+
+void rtc_get_correction_item(uint16_t index, void *item) {
+    (void)index;
+    memcpy(item, &correction, sizeof(correction));
+}
+
+bool rtc_sync(int32_t offset_ms) {
+    if (!rtc_is_initialized()) {
+        return false;
+    }
+    uint64_t now_ms = rtc_get_timestamp_ms();
+    uint64_t target_ms = now_ms + (int64_t)offset_ms;
+    if ((int64_t)now_ms + offset_ms < (int64_t)RTC_TIMESTAMP_2000 * 1000 ||
+        target_ms >= (uint64_t)RTC_TIMESTAMP_2100 * 1000U) {
+        return false;
+    }
+    if (offset_ms > RTC_SYNC_STEP_MAX_MS || offset_ms < -RTC_SYNC_STEP_MAX_MS) {
+        drift_valid = false; // 偏差过大，视为重新设置时间
+    } else if (!drift_valid) {
+        // 第一次校时只作为起点
+    } else {
+        drift_offset_ms += offset_ms;
+        uint64_t elapsed_ms = now_ms - drift_since_ms;
+        if (elapsed_ms >= RTC_DRIFT_MIN_INTERVAL_MS) {
+            // 主机时间减设备时间为负说明设备偏快，需要正的校准值（变慢）；
+            // 步长为2^-20，即每经过2^20毫秒偏快1毫秒对应1步
+            int64_t steps = -(drift_offset_ms * (int64_t)(1UL << 20)) / (int64_t)elapsed_ms;
+            int32_t total = correction + (int32_t)steps;
+            if (total < RTC_CORRECTION_MIN) {
+                total = RTC_CORRECTION_MIN;
+            } else if (total > RTC_CORRECTION_MAX) {
+                total = RTC_CORRECTION_MAX;
+            }
+            if (total != correction) {
+                if (!rtc_set_correction((int16_t)total)) {
+                    return false;
+                }
+                config_store_request_save(CONFIG_KEY_CLOCK);
+            }
+            drift_valid = false; // 从这次校时重新开始累计
+        }
+    }
+    
+    if (!rtc_write_ms(target_ms)) {
+        return false;
+    }
+    if (!drift_valid) {
+        drift_valid = true;
+        drift_since_ms = target_ms;
+        drift_offset_ms = 0;
+    }
+    return true;
+}
+
+void rtc_alarm_init(void) {
+    // 闹钟经EXTI17上升沿进入中断，STOP模式下同样有效
+    EXTI->RTSR |= EXTI_RTSR_TR17;
+    EXTI->IMR |= EXTI_IMR_MR17;
+    RTC->CRL &= ~RTC_CRL_ALRF;
+    RTC->CRH |= RTC_CRH_ALRIE;
+    HAL_NVIC_SetPriority(RTC_Alarm_IRQn, 15, 0);
+    HAL_NVIC_EnableIRQ(RTC_Alarm_IRQn);
+}
+
+// 不晚于timestamp_ms的最后一次计数器进位（进位到C的时刻为C * 1000 + phase_ms），
+// 超出32位时返回0
+static uint32_t counter_at_or_before(uint64_t timestamp_ms) {
+    if (timestamp_ms < phase_ms) {
+        return 0;
+    }
+    uint64_t counter = (timestamp_ms - phase_ms) / 1000U;
+    return (counter > UINT32_MAX) ? 0 : (uint32_t)counter;
+}
+
+static inline uint64_t counter_to_ms(uint32_t counter) {
+    return (uint64_t)counter * 1000U + phase_ms;
+}
+
+// ALR中的值，与要设置的相同时不重写（写入要等几个LSE周期）
+static bool alarm_write(uint32_t counter) {
+    if (counter == alarm_counter) {
+        return true;
+    }
+    if (!rtc_wait_write_done()) {
+        return false;
+    }
+    RTC->CRL |= RTC_CRL_CNF;
+    RTC->ALRH = (uint16_t)(counter >> 16);
+    RTC->ALRL = (uint16_t)counter;
+    RTC->CRL &= ~RTC_CRL_CNF;
+    alarm_counter = counter;
+    return rtc_wait_write_done();
+}
+
+static uint32_t wake_earliest(void) {
+    uint32_t earliest = 0;
+    for (uint8_t i = 0; i < RTC_WAKE_COUNT; i++) {
+        if (wakes[i].counter != 0 && (earliest == 0 || wakes[i].counter < earliest)) {
+            earliest = wakes[i].counter;
+        }
+    }
+    return earliest;
+}
+
+// 闹钟设为最早的槽；写入完成时已经过了该时刻则直接挂起中断，由中断处理到期的槽
+static void alarm_update(void) {
+    uint32_t counter = wake_earliest();
+    if (counter != 0 && alarm_write(counter) && rtc_read_counter() >= counter) {
+        NVIC_SetPendingIRQ(RTC_Alarm_IRQn);
+    }
+}
+
+// 时间被修改后各槽的触发时刻失效，全部立即触发，由任务按新的时间重新设置；
+// 调度器启动前没有设置过的槽，不进入临界段
+static void wake_fire_all(void) {
+    alarm_counter = 0;
+    for (uint8_t i = 0; i < RTC_WAKE_COUNT; i++) {
+        if (wakes[i].counter == 0) {
+            continue;
+        }
+        taskENTER_CRITICAL();
+        RtcWakeCallback callback = wakes[i].counter ? wakes[i].callback : NULL;
+        wakes[i].counter = 0;
+        taskEXIT_CRITICAL();
+        if (callback) {
+            callback();
+        }
+    }
+}
+
+uint64_t rtc_wake_schedule(uint8_t slot, uint64_t timestamp_ms, RtcWakeCallback callback) {
+    if (TEST_MODE || slot >= RTC_WAKE_COUNT || !rtc_is_initialized()) {
+        return 0; // 测试模式下闹钟与虚拟时钟无关，只由内核超时唤醒
+    }
+    uint64_t wake_ms = 0;
+    taskENTER_CRITICAL();
+    uint32_t counter = counter_at_or_before(timestamp_ms);
+    if (counter > rtc_read_counter()) {
+        wakes[slot].counter = counter;
+        wakes[slot].callback = callback;
+        wake_ms = counter_to_ms(counter);
+    } else {
+        wakes[slot].counter = 0;
+    }
+    alarm_update();
+    taskEXIT_CRITICAL();
+    return wake_ms;
+}
+
+void rtc_wake_cancel(uint8_t slot) {
+    if (slot < RTC_WAKE_COUNT) {
+        taskENTER_CRITICAL();
+        wakes[slot].counter = 0;  // 闹钟不改，提前触发时中断里没有到期的槽
+        taskEXIT_CRITICAL();
+    }
+}
+
+uint64_t rtc_alarm_arm(uint64_t timestamp_ms, uint64_t earliest_ms) {
+    if (TEST_MODE || !rtc_is_initialized()) {
+        return 0;
+    }
+    uint64_t alarm_ms = 0;
+    taskENTER_CRITICAL();
+    uint32_t counter = counter_at_or_before(timestamp_ms);
+    uint32_t scheduled = wake_earliest();
+    if (scheduled != 0 && scheduled < counter) {
+        counter = scheduled;
+    }
+    if (counter != 0 && counter_to_ms(counter) >= earliest_ms && alarm_write(counter)) {
+        alarm_ms = counter_to_ms(counter);
+    }
+    taskEXIT_CRITICAL();
+    return alarm_ms;
+}
+
+void rtc_alarm_restore(void) {
+    taskENTER_CRITICAL();
+    alarm_update();
+    taskEXIT_CRITICAL();
+}
+
+// 优先级最低，与任务中的临界段互斥
+void rtc_alarm_irq_handler(void) {
+    RTC->CRL &= ~RTC_CRL_ALRF;
+    EXTI->PR = EXTI_PR_PR17;
+    
+    uint32_t now = rtc_read_counter();
+    for (uint8_t i = 0; i < RTC_WAKE_COUNT; i++) {
+        if (wakes[i].counter != 0 && wakes[i].counter <= now) {
+            wakes[i].counter = 0;
+            if (wakes[i].callback) {
+                wakes[i].callback();
+            }
+        }
+    }
+    alarm_update();
+}
+
+// 计数器和分频器寄存器经APB1读取，APB1时钟停止过后须等RSF重新置位，
+// 同步只需几个RTC时钟周期；此时HAL时基可能未运行，超时（1毫秒）用周期计数器判断
+void rtc_resync(void) {
+    RTC->CRL &= ~RTC_CRL_RSF;
+    uint32_t start = timebase_cycles();
+    uint32_t timeout = 1000U * timebase_cycles_per_us;
+    while ((RTC->CRL & RTC_CRL_RSF) == 0 && timebase_cycles() - start < timeout) {
+    }
+}
+
+// 公历换算（H. Hinnant的days_from_civil/civil_from_days，只处理1970年以后）
+uint32_t rtc_days_from_civil(uint16_t year, uint8_t month, uint8_t day) {
+    uint32_t y = (uint32_t)year - (month <= 2);
+    uint32_t era = y / 400;
+    uint32_t yoe = y - era * 400;                                      // [0, 399]
+    uint32_t doy = (153U * (month > 2 ? month - 3U : month + 9U) + 2U) / 5U + day - 1U; // [0, 365]
+    uint32_t doe = yoe * 365U + yoe / 4U - yoe / 100U + doy;           // [0, 146096]
+    return era * 146097U + doe - 719468U;
+}
+
+void rtc_civil_from_days(uint32_t days, uint16_t *year, uint8_t *month, uint8_t *day) {
+    uint32_t z = days + 719468U;
+    uint32_t era = z / 146097U;
+    uint32_t doe = z - era * 146097U;
+    uint32_t yoe = (doe - doe / 1460U + doe / 36524U - doe / 146096U) / 365U;
+    uint32_t doy = doe - (365U * yoe + yoe / 4U - yoe / 100U);
+    uint32_t mp = (5U * doy + 2U) / 153U;
+    *day = (uint8_t)(doy - (153U * mp + 2U) / 5U + 1U);
+    *month = (uint8_t)(mp < 10 ? mp + 3U : mp - 9U);
+    *year = (uint16_t)(yoe + era * 400U + (*month <= 2));
+}
+
+static uint8_t days_in_month(uint16_t year, uint8_t month) {
+    static const uint8_t days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return (month == 2 && leap) ? 29 : days[month - 1];
+}
+
+bool rtc_get_date(RTCDate *date) {
+    if (!rtc_is_initialized() || !date) {
+        return false;
+    }
+    
+    uint32_t timestamp = clock_seconds();
+    if (timestamp < RTC_TIMESTAMP_2000) {
+        return false; // 不能表示为两位年份
+    }
+    uint32_t days = timestamp / SECONDS_PER_DAY;
+    uint16_t year;
+    rtc_civil_from_days(days, &year, &date->month, &date->day);
+    date->year = (uint8_t)(year - 2000);
+    date->weekday = (uint8_t)((days + 3) % 7 + 1); // 1970-01-01为星期四，1为星期一
+    
+    return true;
+}
+
+bool rtc_set_date(const RTCDate *date) {
+    if (!rtc_is_initialized() || !date) {
+        return false;
+    }
+    
+    // 参数验证
+    if (date->year > 99 || date->month < 1 || date->month > 12 || date->day < 1 ||
+        date->day > days_in_month(2000 + date->year, date->month) ||
+        date->weekday < 1 || date->weekday > 7) {
+        return false;
+    }
+    
+    uint32_t time_of_day = clock_seconds() % SECONDS_PER_DAY;
+    uint32_t days = rtc_days_from_civil(2000 + date->year, date->month, date->day);
+    return rtc_set_timestamp(days * SECONDS_PER_DAY + time_of_day);
+}
+
+bool rtc_get_time(RTCTime *time) {
+    if (!rtc_is_initialized() || !time) {
+        return false;
+    }
+    
+    uint32_t time_of_day = clock_seconds() % SECONDS_PER_DAY;
+    time->hour = (uint8_t)(time_of_day / 3600);
+    time->minute = (uint8_t)(time_of_day / 60 % 60);
+    time->second = (uint8_t)(time_of_day % 60);
+    
+    return true;
+}
+
+bool rtc_set_time(const RTCTime *time) {
+    if (!rtc_is_initialized() || !time) {
+        return false;
+    }
+    
+    // 参数验证
+    if (time->hour > 23 || time->minute > 59 || time->second > 59) {
+        return false;
+    }
+    
+    uint32_t midnight = clock_seconds() / SECONDS_PER_DAY * SECONDS_PER_DAY;
+    return rtc_set_timestamp(midnight + time->hour * 3600U + time->minute * 60U + time->second);
+}
@@ -0,0 +1,79 @@
+#include "sample_schedule.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <string.h>
+
+// 计划只由采样任务访问；统计由采样任务写入、命令执行任务读取，访问时进入临界段
+static uint32_t period_ms = 1000;
+static uint64_t due_ms = 0;   // 0为尚未对齐
+static uint32_t lead_ms = 0;
+static SampleScheduleStats stats;
+
+void sample_schedule_reset(uint32_t period) {
+    period_ms = period != 0 ? period : 1;
+    due_ms = 0;
+    lead_ms = period_ms; // 还不知道转换耗时，第一次提前一整个周期开始
+    taskENTER_CRITICAL();
+    memset(&stats, 0, sizeof(stats));
+    stats.lead_ms = lead_ms;
+    taskEXIT_CRITICAL();
+}
+
+uint64_t sample_schedule_next_start(uint64_t now_ms) {
+    // 第一次、时间回拨（计划时刻远在下一周期之后）或大幅前进时，对齐到来得及完成的第一个整周期
+    if (due_ms == 0 || due_ms > now_ms + period_ms + lead_ms || now_ms > due_ms + SAMPLE_SCHEDULE_RESYNC_MS) {
+        due_ms = ((now_ms + lead_ms) / period_ms + 1) * period_ms;
+    }
+    return due_ms > lead_ms ? due_ms - lead_ms : 0;
+}
+
+uint64_t sample_schedule_due(void) {
+    return due_ms;
+}
+
+void sample_schedule_complete(uint64_t publish_ms, uint32_t conversion_ms) {
+    uint64_t error = publish_ms >= due_ms ? publish_ms - due_ms : due_ms - publish_ms;
+    bool late = publish_ms > due_ms + SAMPLE_SCHEDULE_TOLERANCE_MS;
+    uint8_t bucket = 0;
+    while (bucket < SAMPLE_SCHEDULE_BUCKETS - 1 && error >= (1ULL << bucket)) {
+        bucket++;
+    }
+
+    // 下一个计划时刻在发布之后；跳过的周期都记为错过
+    uint32_t skipped = 0;
+    due_ms += period_ms;
+    while (due_ms <= publish_ms) {
+        due_ms += period_ms;
+        skipped++;
+    }
+    lead_ms = conversion_ms + SAMPLE_SCHEDULE_MARGIN_MS;
+    if (lead_ms > period_ms) {
+        lead_ms = period_ms;
+    }
+
+    taskENTER_CRITICAL();
+    stats.samples++;
+    stats.missed += (late ? 1U : 0U) + skipped;
+    if (error > stats.error_max_ms) {
+        stats.error_max_ms = error > UINT32_MAX ? UINT32_MAX : (uint32_t)error;
+    }
+    if (stats.error_hist[bucket] < UINT16_MAX) {
+        stats.error_hist[bucket]++;
+    }
+    stats.lead_ms = lead_ms;
+    taskEXIT_CRITICAL();
+}
+
+void sample_schedule_get_stats(SampleScheduleStats *out) {
+    taskENTER_CRITICAL();
+    *out = stats;
+    taskEXIT_CRITICAL();
+}
+
+void sample_schedule_clear_stats(void) {
+    taskENTER_CRITICAL();
+    uint32_t lead = stats.lead_ms;
+    memset(&stats, 0, sizeof(stats));
+    stats.lead_ms = lead;
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,70 @@
+#include "sampling_settings.h"
+#include "config_store.h"
+#include "temp_logger.h"
+#include "temp_sampler.h"
+#include "temp_filter.h"
+#include "log_compress.h"
+#include "temp_calib.h"
+#include "device_control.h"
+#include <string.h>
+
+void sampling_settings_load(void) {
+    uint16_t length = 0;
+    const void *saved = config_store_find(CONFIG_KEY_SAMPLING, &length);
+    if (saved && length == sizeof(SamplingSettings)) {
+        SamplingSettings settings;
+        memcpy(&settings, saved, sizeof(settings));
+        temp_logger_set_interval(settings.log_interval_ms); // 非法时保持默认间隔
+        if (settings.resolution >= TEMP_RESOLUTION_MIN && settings.resolution <= TEMP_RESOLUTION_MAX &&
+            settings.resolution != temperature_get_resolution()) {
+            temp_sampler_request_resolution(settings.resolution);
+        }
+        TempFilterConfig filter = { settings.filter_mode, settings.filter_param };
+        if (temp_filter_config_valid(&filter)) {
+            temp_filter_configure(&filter);
+        }
+    }
+
+    saved = config_store_find(CONFIG_KEY_COMPRESS, &length);
+    if (saved && length == sizeof(LogCompressConfig) * TEMP_MAX_SENSORS) {
+        for (uint8_t sensor = 0; sensor < TEMP_MAX_SENSORS; sensor++) {
+            LogCompressConfig compress;
+            memcpy(&compress, (const uint8_t *)saved + sensor * sizeof(compress), sizeof(compress));
+            if (log_compress_config_valid(&compress)) {
+                log_compress_configure(sensor, &compress);
+            }
+        }
+    }
+
+    saved = config_store_find(CONFIG_KEY_CALIB, &length);
+    if (saved && length == sizeof(TempCalibration) * TEMP_MAX_SENSORS) {
+        for (uint8_t sensor = 0; sensor < TEMP_MAX_SENSORS; sensor++) {
+            TempCalibration calibration;
+            memcpy(&calibration, (const uint8_t *)saved + sensor * sizeof(calibration), sizeof(calibration));
+            if (temp_calib_valid(&calibration)) {
+                temp_calib_configure(sensor, &calibration);
+            }
+        }
+    }
+}
+
+void sampling_settings_get_item(uint16_t index, void *item) {
+    (void)index;
+    TempFilterConfig filter;
+    temp_filter_get_config(&filter);
+    SamplingSettings settings = {
+        .log_interval_ms = temp_logger_get_interval(),
+        .resolution = temperature_get_resolution(),
+        .filter_mode = filter.mode,
+        .filter_param = filter.param,
+    };
+    memcpy(item, &settings, sizeof(settings));
+}
+
+void sampling_settings_get_compress_item(uint16_t index, void *item) {
+    log_compress_get_config((uint8_t)index, item);
+}
+
+void sampling_settings_get_calib_item(uint16_t index, void *item) {
+    temp_calib_get((uint8_t)index, item);
+}
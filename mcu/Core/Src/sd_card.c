@@ -0,0 +1,338 @@
+#include "sd_card.h"
+
+#if LOG_ARCHIVE_SD
+
+#include "main.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+// 响应类型
+#define SD_RESPONSE_NONE   0U
+#define SD_RESPONSE_SHORT  1U
+#define SD_RESPONSE_R3     2U  // 短响应，无CRC（ACMD41），CCRCFAIL不是错误
+#define SD_RESPONSE_LONG   3U
+
+#define SD_R1_ERRORS       0xFDFFE008U // 卡状态中的错误位
+#define SD_R1_READY        0x00000100U // READY_FOR_DATA
+#define SD_R1_STATE(r1)    (((r1) >> 9) & 0x0FU)
+#define SD_STATE_TRANSFER  4U
+#define SD_CHECK_PATTERN   0x1AAU      // CMD8：2.7~3.6V，校验模式0xAA
+#define SD_OCR_ARGUMENT    0x40FF8000U // HCS，3.0~3.6V
+#define SD_OCR_BUSY        0x80000000U // 上电完成
+#define SD_OCR_CCS         0x40000000U // 大容量卡，按块寻址
+#define SD_DATA_TIMEOUT    0xFFFFFFFFU // 数据超时由软件计时
+
+#define SD_STATIC_FLAGS (SDIO_ICR_CCRCFAILC | SDIO_ICR_DCRCFAILC | SDIO_ICR_CTIMEOUTC | SDIO_ICR_DTIMEOUTC | \
+                         SDIO_ICR_TXUNDERRC | SDIO_ICR_RXOVERRC | SDIO_ICR_CMDRENDC | SDIO_ICR_CMDSENTC |   \
+                         SDIO_ICR_DATAENDC | SDIO_ICR_STBITERRC | SDIO_ICR_DBCKENDC)
+#define SD_DATA_ERRORS  (SDIO_STA_DCRCFAIL | SDIO_STA_DTIMEOUT | SDIO_STA_TXUNDERR | SDIO_STA_RXOVERR | \
+                         SDIO_STA_STBITERR)
+
+static bool card_ready = false;
+static bool high_capacity = false;
+static uint32_t rca = 0;
+static uint32_t block_count = 0;
+
+static StaticSemaphore_t card_lock_buffer;
+static osMutexId_t card_lock = NULL;
+
+static const osMutexAttr_t card_lock_attributes = {
+    .name = "sd_card",
+    .attr_bits = osMutexPrioInherit,
+    .cb_mem = &card_lock_buffer,
+    .cb_size = sizeof(card_lock_buffer),
+};
+
+// 发送命令并等待响应（微秒级，忙等），response为NULL时不取响应
+static bool command(uint8_t index, uint32_t argument, uint8_t type, uint32_t *response) {
+    static const uint32_t wait_bits[] = {
+        [SD_RESPONSE_NONE]  = 0,
+        [SD_RESPONSE_SHORT] = SDIO_CMD_WAITRESP_0,
+        [SD_RESPONSE_R3]    = SDIO_CMD_WAITRESP_0,
+        [SD_RESPONSE_LONG]  = SDIO_CMD_WAITRESP_0 | SDIO_CMD_WAITRESP_1,
+    };
+    uint32_t done = (type == SD_RESPONSE_NONE) ? SDIO_STA_CMDSENT
+                                               : (SDIO_STA_CMDREND | SDIO_STA_CCRCFAIL | SDIO_STA_CTIMEOUT);
+    SDIO->ICR = SD_STATIC_FLAGS;
+    SDIO->ARG = argument;
+    SDIO->CMD = index | wait_bits[type] | SDIO_CMD_CPSMEN;
+
+    uint32_t start = HAL_GetTick();
+    uint32_t status;
+    while (((status = SDIO->STA) & done) == 0) {
+        if (HAL_GetTick() - start > 2U) {
+            return false;
+        }
+    }
+    SDIO->ICR = SD_STATIC_FLAGS;
+    if ((status & SDIO_STA_CTIMEOUT) ||
+        ((status & SDIO_STA_CCRCFAIL) && type != SD_RESPONSE_R3) ||
+        (type == SD_RESPONSE_SHORT && SDIO->RESPCMD != index)) {
+        return false;
+    }
+    if (response != NULL) {
+        *response = SDIO->RESP1;
+    }
+    return true;
+}
+
+// 响应为卡状态（R1、R1b）的命令
+static bool command_r1(uint8_t index, uint32_t argument, uint32_t *r1) {
+    uint32_t status;
+    if (!command(index, argument, SD_RESPONSE_SHORT, &status) || (status & SD_R1_ERRORS)) {
+        return false;
+    }
+    if (r1 != NULL) {
+        *r1 = status;
+    }
+    return true;
+}
+
+// 等到卡回到传输状态并可以接收数据（写入后的编程期间CMD13返回编程状态）
+static bool wait_card(uint32_t timeout_ms) {
+    uint32_t start = HAL_GetTick();
+    for (;;) {
+        uint32_t r1;
+        if (command_r1(13, rca << 16, &r1) && SD_R1_STATE(r1) == SD_STATE_TRANSFER && (r1 & SD_R1_READY)) {
+            return true;
+        }
+        if (HAL_GetTick() - start > timeout_ms) {
+            return false;
+        }
+        osDelay(1);
+    }
+}
+
+static void dma_start(bool to_card, const void *data, uint32_t words) {
+    DMA2_Channel4->CCR = 0;
+    DMA2->IFCR = DMA_IFCR_CGIF4;
+    DMA2_Channel4->CPAR = (uint32_t)&SDIO->FIFO;
+    DMA2_Channel4->CMAR = (uint32_t)data;
+    DMA2_Channel4->CNDTR = words;
+    DMA2_Channel4->CCR = DMA_CCR_MINC | DMA_CCR_PSIZE_1 | DMA_CCR_MSIZE_1 | DMA_CCR_PL_1 |
+                         (to_card ? DMA_CCR_DIR : 0) | DMA_CCR_EN;
+}
+
+static void data_stop(void) {
+    DMA2_Channel4->CCR = 0;
+    DMA2->IFCR = DMA_IFCR_CGIF4;
+    SDIO->DCTRL = 0;
+    SDIO->ICR = SD_STATIC_FLAGS;
+}
+
+// 等待数据传输结束（读取时还要等DMA取空FIFO），之后关闭DMA通道
+static bool wait_data(bool to_card) {
+    uint32_t start = HAL_GetTick();
+    bool ok = false;
+    for (;;) {
+        uint32_t status = SDIO->STA;
+        if (status & SD_DATA_ERRORS) {
+            break;
+        }
+        if ((status & SDIO_STA_DATAEND) && (to_card || (DMA2->ISR & DMA_ISR_TCIF4))) {
+            ok = (DMA2->ISR & DMA_ISR_TEIF4) == 0;
+            break;
+        }
+        if (HAL_GetTick() - start > SD_CARD_TIMEOUT_MS) {
+            break;
+        }
+        osDelay(1);
+    }
+    data_stop();
+    return ok;
+}
+
+static inline uint32_t card_address(uint32_t block) {
+    return high_capacity ? block : block * SD_CARD_BLOCK_SIZE;
+}
+
+static inline bool transfer_valid(uint32_t block, uint32_t count, const void *data) {
+    return card_ready && count > 0 && count <= SD_CARD_MAX_BLOCKS &&
+           block < block_count && count <= block_count - block && ((uintptr_t)data & 3U) == 0;
+}
+
+static void data_setup(bool to_card, const void *data, uint32_t count) {
+    SDIO->DCTRL = 0;
+    SDIO->DTIMER = SD_DATA_TIMEOUT;
+    SDIO->DLEN = count * SD_CARD_BLOCK_SIZE;
+    dma_start(to_card, data, count * SD_CARD_BLOCK_SIZE / 4U);
+}
+
+bool sd_card_read(uint32_t block, uint32_t count, void *data) {
+    if (!transfer_valid(block, count, data) || !wait_card(SD_CARD_TIMEOUT_MS)) {
+        return false;
+    }
+    // 读取时数据通道先于命令打开，卡发出的第一块不会溢出FIFO
+    data_setup(false, data, count);
+    SDIO->DCTRL = (9U << SDIO_DCTRL_DBLOCKSIZE_Pos) | SDIO_DCTRL_DTDIR | SDIO_DCTRL_DMAEN | SDIO_DCTRL_DTEN;
+    bool ok = command_r1(count == 1 ? 17 : 18, card_address(block), NULL) && wait_data(false);
+    if (!ok) {
+        data_stop();
+    }
+    if (count > 1) {
+        ok = command_r1(12, 0, NULL) && ok;
+    }
+    return ok;
+}
+
+// 多块写入（CMD25）由卡连续编程，比逐块写入少了每块之间的编程等待
+bool sd_card_write(uint32_t block, uint32_t count, const void *data) {
+    if (!transfer_valid(block, count, data) || !wait_card(SD_CARD_TIMEOUT_MS)) {
+        return false;
+    }
+    data_setup(true, data, count);
+    bool ok = command_r1(count == 1 ? 24 : 25, card_address(block), NULL);
+    if (ok) {
+        SDIO->DCTRL = (9U << SDIO_DCTRL_DBLOCKSIZE_Pos) | SDIO_DCTRL_DMAEN | SDIO_DCTRL_DTEN;
+        ok = wait_data(true);
+    } else {
+        data_stop();
+    }
+    if (count > 1) {
+        ok = command_r1(12, 0, NULL) && ok;
+    }
+    // 等卡编程完成，返回后数据已经保存
+    return wait_card(SD_CARD_TIMEOUT_MS) && ok;
+}
+
+static void power_off(void) {
+    SDIO->CLKCR = 0;
+    SDIO->POWER = 0;
+    card_ready = false;
+}
+
+// 从CSD计算512字节块数（RESP1为CSD的127~96位）
+static uint32_t csd_block_count(const uint32_t csd[4]) {
+    if ((csd[0] >> 30) == 1U) {
+        uint32_t c_size = ((csd[1] & 0x3FU) << 16) | (csd[2] >> 16); // 2.0：69~48位
+        return (c_size + 1U) * 1024U;
+    }
+    uint32_t read_bl_len = (csd[1] >> 16) & 0x0FU;                   // 1.0：83~80位
+    uint32_t c_size = ((csd[1] & 0x3FFU) << 2) | (csd[2] >> 30);     // 73~62位
+    uint32_t c_size_mult = (csd[2] >> 15) & 0x07U;                   // 49~47位
+    return ((c_size + 1U) << (c_size_mult + 2U)) << read_bl_len >> 9;
+}
+
+static bool identify(void) {
+    uint32_t response;
+    command(0, 0, SD_RESPONSE_NONE, NULL);
+    if (!command(8, SD_CHECK_PATTERN, SD_RESPONSE_SHORT, &response) || (response & 0xFFFU) != SD_CHECK_PATTERN) {
+        return false; // 没有卡或1.x的卡
+    }
+
+    uint32_t start = HAL_GetTick();
+    do {
+        if (HAL_GetTick() - start > SD_CARD_INIT_TIMEOUT_MS ||
+            !command_r1(55, 0, NULL) || !command(41, SD_OCR_ARGUMENT, SD_RESPONSE_R3, &response)) {
+            return false;
+        }
+        osDelay(1);
+    } while ((response & SD_OCR_BUSY) == 0);
+    high_capacity = (response & SD_OCR_CCS) != 0;
+
+    uint32_t csd[4];
+    if (!command(2, 0, SD_RESPONSE_LONG, NULL) || !command(3, 0, SD_RESPONSE_SHORT, &response)) {
+        return false;
+    }
+    rca = response >> 16;
+    if (!command(9, rca << 16, SD_RESPONSE_LONG, NULL)) {
+        return false;
+    }
+    csd[0] = SDIO->RESP1;
+    csd[1] = SDIO->RESP2;
+    csd[2] = SDIO->RESP3;
+    csd[3] = SDIO->RESP4;
+    block_count = csd_block_count(csd);
+
+    return command_r1(7, rca << 16, NULL) &&
+           (high_capacity || command_r1(16, SD_CARD_BLOCK_SIZE, NULL));
+}
+
+bool sd_card_init(void) {
+    __HAL_RCC_SDIO_CLK_ENABLE();
+    __HAL_RCC_DMA2_CLK_ENABLE();
+    __HAL_RCC_GPIOC_CLK_ENABLE();
+    __HAL_RCC_GPIOD_CLK_ENABLE();
+
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    GPIO_InitStruct.Pin = GPIO_PIN_8 | GPIO_PIN_12;
+    HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
+    GPIO_InitStruct.Pin = GPIO_PIN_2;
+    HAL_GPIO_Init(GPIOD, &GPIO_InitStruct);
+
+    if (card_lock == NULL) {
+        card_lock = osMutexNew(&card_lock_attributes);
+    }
+
+    // 上电后至少74个时钟再发命令；识别阶段不超过400kHz，1位总线，不用省电和硬件流控
+    SDIO->POWER = SDIO_POWER_PWRCTRL;
+    SDIO->CLKCR = SD_CARD_INIT_CLKDIV | SDIO_CLKCR_CLKEN;
+    osDelay(2);
+
+    card_ready = identify();
+    if (!card_ready || block_count == 0) {
+        power_off();
+        return false;
+    }
+    SDIO->CLKCR = SD_CARD_TRANSFER_CLKDIV | SDIO_CLKCR_CLKEN;
+    return true;
+}
+
+bool sd_card_ready(void) {
+    return card_ready;
+}
+
+uint32_t sd_card_block_count(void) {
+    return block_count;
+}
+
+// 调度器启动前只有一个执行流，不需要加锁
+void sd_card_lock(void) {
+    if (card_lock != NULL && osKernelGetState() == osKernelRunning) {
+        osMutexAcquire(card_lock, osWaitForever);
+    }
+}
+
+void sd_card_unlock(void) {
+    if (card_lock != NULL && osKernelGetState() == osKernelRunning) {
+        osMutexRelease(card_lock);
+    }
+}
+
+static bool archive_read(void *context, uint32_t block, uint32_t count, void *data) {
+    (void)context;
+    return sd_card_read(block, count, data);
+}
+
+static bool archive_write(void *context, uint32_t block, uint32_t count, const void *data) {
+    (void)context;
+    return sd_card_write(block, count, data);
+}
+
+static void archive_lock(void *context) {
+    (void)context;
+    sd_card_lock();
+}
+
+static void archive_unlock(void *context) {
+    (void)context;
+    sd_card_unlock();
+}
+
+static const LogArchiveOps archive_ops = {
+    .read = archive_read,
+    .write = archive_write,
+    .lock = archive_lock,
+    .unlock = archive_unlock,
+};
+
+const LogArchiveDevice *sd_card_archive_device(void) {
+    static LogArchiveDevice archive_device = { &archive_ops, NULL, 0 };
+    archive_device.block_count = block_count;
+    return &archive_device;
+}
+
+#endif // LOG_ARCHIVE_SD
@@ -0,0 +1,299 @@
+#include "spi_nor.h"
+
+#if LOG_STORE_SPI_NOR
+
+#include "main.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+// 命令（W25Qxx，其他厂商的同类芯片相同）
+#define NOR_CMD_WRITE_ENABLE 0x06U
+#define NOR_CMD_READ_STATUS  0x05U
+#define NOR_CMD_WRITE_STATUS 0x01U
+#define NOR_CMD_PAGE_PROGRAM 0x02U
+#define NOR_CMD_SECTOR_ERASE 0x20U
+#define NOR_CMD_CHIP_ERASE   0xC7U
+#define NOR_CMD_FAST_READ    0x0BU  // 地址之后一个空字节
+#define NOR_CMD_JEDEC_ID     0x9FU
+#define NOR_CMD_RELEASE_POWER_DOWN 0xABU
+
+#define NOR_STATUS_BUSY      0x01U
+#define NOR_STATUS_PROTECT   0x7CU  // BP0~BP2、TB、SEC：出厂或上次设置的写保护
+#define NOR_MIN_CAPACITY_ID  0x10U  // JEDEC ID第三字节为容量的2的幂次
+#define NOR_MAX_CAPACITY_ID  0x18U  // 3字节地址最大16MB
+
+static bool chip_ready = false;
+static uint32_t capacity = 0;
+
+static StaticSemaphore_t chip_lock_buffer;
+static osMutexId_t chip_lock = NULL;
+
+static const osMutexAttr_t chip_lock_attributes = {
+    .name = "spi_nor",
+    .attr_bits = osMutexPrioInherit,
+    .cb_mem = &chip_lock_buffer,
+    .cb_size = sizeof(chip_lock_buffer),
+};
+
+// 调度器启动前只有一个执行流，不需要加锁
+static void lock(void) {
+    if (chip_lock != NULL && osKernelGetState() == osKernelRunning) {
+        osMutexAcquire(chip_lock, osWaitForever);
+    }
+}
+
+static void unlock(void) {
+    if (chip_lock != NULL && osKernelGetState() == osKernelRunning) {
+        osMutexRelease(chip_lock);
+    }
+}
+
+static inline void chip_select(void) {
+    GPIOA->BSRR = GPIO_BSRR_BR15;
+}
+
+// 等最后一个字节发送完再释放片选
+static inline void chip_deselect(void) {
+    while (SPI3->SR & SPI_SR_BSY) {
+    }
+    GPIOA->BSRR = GPIO_BSRR_BS15;
+}
+
+static uint8_t exchange(uint8_t byte) {
+    while ((SPI3->SR & SPI_SR_TXE) == 0) {
+    }
+    *(volatile uint8_t *)&SPI3->DR = byte;
+    while ((SPI3->SR & SPI_SR_RXNE) == 0) {
+    }
+    return (uint8_t)SPI3->DR;
+}
+
+// 收发size字节：tx为NULL时发送0xFF，rx为NULL时丢弃收到的字节。
+// 较长的经DMA传输（接收通道优先级高于发送通道，不会溢出），4KB约2ms，忙等结束
+static bool transfer(const uint8_t *tx, uint8_t *rx, uint32_t size) {
+    if (size < SPI_NOR_DMA_MIN) {
+        for (uint32_t i = 0; i < size; i++) {
+            uint8_t byte = exchange(tx != NULL ? tx[i] : 0xFFU);
+            if (rx != NULL) {
+                rx[i] = byte;
+            }
+        }
+        return true;
+    }
+
+    static const uint8_t fill = 0xFFU;
+    static uint8_t sink;
+    DMA2_Channel1->CCR = 0;
+    DMA2_Channel2->CCR = 0;
+    DMA2->IFCR = DMA_IFCR_CGIF1 | DMA_IFCR_CGIF2;
+    DMA2_Channel1->CPAR = (uint32_t)&SPI3->DR;
+    DMA2_Channel1->CMAR = (uint32_t)(rx != NULL ? rx : &sink);
+    DMA2_Channel1->CNDTR = size;
+    DMA2_Channel1->CCR = (rx != NULL ? DMA_CCR_MINC : 0) | DMA_CCR_PL_1 | DMA_CCR_EN;
+    DMA2_Channel2->CPAR = (uint32_t)&SPI3->DR;
+    DMA2_Channel2->CMAR = (uint32_t)(tx != NULL ? tx : &fill);
+    DMA2_Channel2->CNDTR = size;
+    DMA2_Channel2->CCR = (tx != NULL ? DMA_CCR_MINC : 0) | DMA_CCR_DIR | DMA_CCR_EN;
+    SPI3->CR2 = SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN;
+
+    uint32_t status;
+    while (((status = DMA2->ISR) & (DMA_ISR_TCIF1 | DMA_ISR_TEIF1 | DMA_ISR_TEIF2)) == 0) {
+    }
+    SPI3->CR2 = 0;
+    DMA2_Channel1->CCR = 0;
+    DMA2_Channel2->CCR = 0;
+    DMA2->IFCR = DMA_IFCR_CGIF1 | DMA_IFCR_CGIF2;
+    return (status & (DMA_ISR_TEIF1 | DMA_ISR_TEIF2)) == 0;
+}
+
+// 命令字节和3字节地址，之后片选保持有效
+static void command_address(uint8_t opcode, uint32_t address) {
+    uint8_t header[4] = { opcode, (uint8_t)(address >> 16), (uint8_t)(address >> 8), (uint8_t)address };
+    chip_select();
+    transfer(header, NULL, sizeof(header));
+}
+
+static void command(uint8_t opcode) {
+    chip_select();
+    exchange(opcode);
+    chip_deselect();
+}
+
+static uint8_t read_status(void) {
+    chip_select();
+    exchange(NOR_CMD_READ_STATUS);
+    uint8_t status = exchange(0xFFU);
+    chip_deselect();
+    return status;
+}
+
+// 等上一次编程或擦除完成；编程只需几百微秒，忙等，擦除时让出CPU
+static bool wait_ready(uint32_t timeout_ms) {
+    uint32_t start = HAL_GetTick();
+    while (read_status() & NOR_STATUS_BUSY) {
+        if (HAL_GetTick() - start > timeout_ms) {
+            return false;
+        }
+        if (timeout_ms > SPI_NOR_PROGRAM_TIMEOUT_MS) {
+            osDelay(1);
+        }
+    }
+    return true;
+}
+
+static inline bool range_valid(uint32_t address, uint32_t size) {
+    return chip_ready && size <= capacity && address <= capacity - size;
+}
+
+bool spi_nor_read(uint32_t address, void *data, uint32_t size) {
+    if (!range_valid(address, size)) {
+        return false;
+    }
+    lock();
+    bool ok = wait_ready(SPI_NOR_PROGRAM_TIMEOUT_MS);
+    if (ok) {
+        command_address(NOR_CMD_FAST_READ, address);
+        exchange(0xFFU);
+        ok = transfer(NULL, data, size);
+        chip_deselect();
+    }
+    unlock();
+    return ok;
+}
+
+// 按编程页分段，每段编程完成后再写下一段
+bool spi_nor_program(uint32_t address, const void *data, uint32_t size) {
+    if (!range_valid(address, size)) {
+        return false;
+    }
+    const uint8_t *bytes = data;
+    lock();
+    bool ok = wait_ready(SPI_NOR_PROGRAM_TIMEOUT_MS);
+    while (ok && size > 0) {
+        uint32_t chunk = SPI_NOR_PROGRAM_PAGE - address % SPI_NOR_PROGRAM_PAGE;
+        if (chunk > size) {
+            chunk = size;
+        }
+        command(NOR_CMD_WRITE_ENABLE);
+        command_address(NOR_CMD_PAGE_PROGRAM, address);
+        ok = transfer(bytes, NULL, chunk);
+        chip_deselect();
+        ok = wait_ready(SPI_NOR_PROGRAM_TIMEOUT_MS) && ok;
+        address += chunk;
+        bytes += chunk;
+        size -= chunk;
+    }
+    unlock();
+    return ok;
+}
+
+bool spi_nor_erase_sector(uint32_t address) {
+    if (!range_valid(address, SPI_NOR_SECTOR_SIZE) || address % SPI_NOR_SECTOR_SIZE != 0) {
+        return false;
+    }
+    lock();
+    bool ok = wait_ready(SPI_NOR_PROGRAM_TIMEOUT_MS);
+    if (ok) {
+        command(NOR_CMD_WRITE_ENABLE);
+        command_address(NOR_CMD_SECTOR_ERASE, address);
+        chip_deselect();
+        ok = wait_ready(SPI_NOR_ERASE_TIMEOUT_MS);
+    }
+    unlock();
+    return ok;
+}
+
+bool spi_nor_erase_chip(void) {
+    if (!chip_ready) {
+        return false;
+    }
+    lock();
+    bool ok = wait_ready(SPI_NOR_PROGRAM_TIMEOUT_MS);
+    if (ok) {
+        command(NOR_CMD_WRITE_ENABLE);
+        command(NOR_CMD_CHIP_ERASE);
+    }
+    unlock();
+    return ok;
+}
+
+bool spi_nor_busy(void) {
+    if (!chip_ready) {
+        return false;
+    }
+    lock();
+    bool busy = (read_status() & NOR_STATUS_BUSY) != 0;
+    unlock();
+    return busy;
+}
+
+bool spi_nor_init(void) {
+    __HAL_RCC_SPI3_CLK_ENABLE();
+    __HAL_RCC_DMA2_CLK_ENABLE();
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+
+    GPIOA->BSRR = GPIO_BSRR_BS15;
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    GPIO_InitStruct.Pin = GPIO_PIN_15;
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+    GPIO_InitStruct.Pin = GPIO_PIN_3 | GPIO_PIN_5;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+    GPIO_InitStruct.Pin = GPIO_PIN_4;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_INPUT;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+    if (chip_lock == NULL) {
+        chip_lock = osMutexNew(&chip_lock_attributes);
+    }
+
+    // 主机、软件片选、模式0、8位，18MHz
+    SPI3->CR1 = 0;
+    SPI3->CR2 = 0;
+    SPI3->CR1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI | SPI_CR1_SPE;
+
+    // 上次运行可能使芯片处于掉电模式，唤醒需要3μs
+    command(NOR_CMD_RELEASE_POWER_DOWN);
+    osDelay(1);
+
+    uint8_t id[3];
+    chip_select();
+    exchange(NOR_CMD_JEDEC_ID);
+    transfer(NULL, id, sizeof(id));
+    chip_deselect();
+    if (id[0] == 0x00U || id[0] == 0xFFU || id[2] < NOR_MIN_CAPACITY_ID || id[2] > NOR_MAX_CAPACITY_ID) {
+        SPI3->CR1 = 0;
+        return false; // 没有芯片或容量超出3字节地址
+    }
+    capacity = 1UL << id[2];
+
+    // 清除写保护（非易失的状态寄存器，只在设置过时写入）
+    if (read_status() & NOR_STATUS_PROTECT) {
+        command(NOR_CMD_WRITE_ENABLE);
+        chip_select();
+        exchange(NOR_CMD_WRITE_STATUS);
+        exchange(0x00U);
+        chip_deselect();
+        if (!wait_ready(SPI_NOR_ERASE_TIMEOUT_MS)) {
+            SPI3->CR1 = 0;
+            return false;
+        }
+    }
+    chip_ready = true;
+    return true;
+}
+
+bool spi_nor_ready(void) {
+    return chip_ready;
+}
+
+uint32_t spi_nor_capacity(void) {
+    return capacity;
+}
+
+#endif // LOG_STORE_SPI_NOR
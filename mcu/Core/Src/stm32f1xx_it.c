@@ -23,6 +23,14 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "communication.h"
+#include "onewire.h"
+#include "rtc_clock.h"
+#include "low_power.h"
+#include "ramfunc.h"
+#include "uart_transport.h"
+#include "usb_cdc.h"
+#include "analog_temp.h"
+#include "crc32.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -164,55 +172,129 @@ void DebugMon_Handler(void)
 /******************************************************************************/
 
 /**
-  * @brief This function handles DMA1 channel4 global interrupt.
+  * @brief This function handles TIM7 global interrupt.
   */
-void DMA1_Channel4_IRQHandler(void)
+void TIM7_IRQHandler(void)
 {
-  /* USER CODE BEGIN DMA1_Channel4_IRQn 0 */
+  /* USER CODE BEGIN TIM7_IRQn 0 */
 
-  /* USER CODE END DMA1_Channel4_IRQn 0 */
-  HAL_DMA_IRQHandler(&hdma_usart1_tx);
-  /* USER CODE BEGIN DMA1_Channel4_IRQn 1 */
+  /* USER CODE END TIM7_IRQn 0 */
+  HAL_TIM_IRQHandler(&htim7);
+  /* USER CODE BEGIN TIM7_IRQn 1 */
 
-  /* USER CODE END DMA1_Channel4_IRQn 1 */
+  /* USER CODE END TIM7_IRQn 1 */
 }
 
+/* USER CODE BEGIN 1 */
+
 /**
-  * @brief This function handles DMA1 channel5 global interrupt.
+  * @brief This function handles USART1 global interrupt.
   */
-void DMA1_Channel5_IRQHandler(void)
+RAMFUNC void USART1_IRQHandler(void)
 {
-  /* USER CODE BEGIN DMA1_Channel5_IRQn 0 */
+    uart_transport_irq_handler(&uart_ble_port);
+}
 
-  /* USER CODE END DMA1_Channel5_IRQn 0 */
-  HAL_DMA_IRQHandler(&hdma_usart1_rx);
-  /* USER CODE BEGIN DMA1_Channel5_IRQn 1 */
+/**
+  * @brief This function handles DMA1 channel4 global interrupt (USART1 TX).
+  */
+RAMFUNC void DMA1_Channel4_IRQHandler(void)
+{
+    uart_transport_tx_dma_irq_handler(&uart_ble_port);
+}
 
-  /* USER CODE END DMA1_Channel5_IRQn 1 */
+/**
+  * @brief This function handles DMA1 channel5 global interrupt (USART1 RX).
+  */
+RAMFUNC void DMA1_Channel5_IRQHandler(void)
+{
+    uart_transport_rx_dma_irq_handler(&uart_ble_port);
 }
 
+#if UART_WIRED_PORT
 /**
-  * @brief This function handles TIM7 global interrupt.
+  * @brief This function handles UART4 global interrupt (wired link or gateway bus).
   */
-void TIM7_IRQHandler(void)
+RAMFUNC void UART4_IRQHandler(void)
 {
-  /* USER CODE BEGIN TIM7_IRQn 0 */
+    uart_transport_irq_handler(&uart_wired_port);
+}
 
-  /* USER CODE END TIM7_IRQn 0 */
-  HAL_TIM_IRQHandler(&htim7);
-  /* USER CODE BEGIN TIM7_IRQn 1 */
+/**
+  * @brief This function handles DMA2 channel3 global interrupt (UART4 RX).
+  */
+RAMFUNC void DMA2_Channel3_IRQHandler(void)
+{
+    uart_transport_rx_dma_irq_handler(&uart_wired_port);
+}
 
-  /* USER CODE END TIM7_IRQn 1 */
+/**
+  * @brief This function handles DMA2 channel4 and channel5 global interrupts (UART4 TX on channel5).
+  */
+RAMFUNC void DMA2_Channel4_5_IRQHandler(void)
+{
+    uart_transport_tx_dma_irq_handler(&uart_wired_port);
 }
+#endif
 
-/* USER CODE BEGIN 1 */
+#if COMM_USB_LINK
+/**
+  * @brief This function handles USB low priority interrupt (USB CDC link).
+  */
+RAMFUNC void USB_LP_CAN1_RX0_IRQHandler(void)
+{
+    usb_cdc_irq_handler();
+}
 
 /**
-  * @brief This function handles USART1 global interrupt.
+  * @brief This function handles USB wake-up interrupt through EXTI line 18 (wake-up from STOP).
+  */
+void USBWakeUp_IRQHandler(void)
+{
+    usb_cdc_wakeup_irq_handler();
+}
+#endif
+
+#if TEMP_ANALOG
+/**
+  * @brief This function handles DMA1 channel1 global interrupt (ADC1 analog temperature channels).
+  */
+void DMA1_Channel1_IRQHandler(void)
+{
+    analog_temp_dma_irq_handler();
+}
+#endif
+
+/**
+  * @brief This function handles DMA1 channel7 global interrupt (CRC32 memory-to-memory transfer).
+  */
+void DMA1_Channel7_IRQHandler(void)
+{
+    crc32_dma_irq_handler();
+}
+
+/**
+  * @brief This function handles TIM6 global interrupt (1-Wire slot timing).
+  */
+RAMFUNC void TIM6_IRQHandler(void)
+{
+    onewire_timer_irq_handler();
+}
+
+/**
+  * @brief This function handles RTC alarm interrupt through EXTI line 17 (wake-up from STOP).
+  */
+void RTC_Alarm_IRQHandler(void)
+{
+    rtc_alarm_irq_handler();
+}
+
+/**
+  * @brief This function handles EXTI line[15:10] interrupts (USART1/UART4 RX wake-up from STOP).
   */
-void USART1_IRQHandler(void)
+void EXTI15_10_IRQHandler(void)
 {
-    HAL_UART_IRQHandler(&huart1);
+    low_power_exti_irq_handler();
 }
 
 /* USER CODE END 1 */
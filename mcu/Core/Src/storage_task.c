@@ -0,0 +1,127 @@
+#include "storage_task.h"
+#include "log_store.h"
+#include "config_store.h"
+#include "onewire.h"
+#include "device_control.h"
+#include "rtc_clock.h"
+#include "communication.h"
+#include "gateway.h"
+#include "watchdog.h"
+#include "log_archive.h"
+#include "sd_card.h"
+#include "fw_update.h"
+#include "sampling_settings.h"
+#include "main.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define STORAGE_FLAG_WAKE 0x0001U
+
+// 存储任务使用静态内存，不占用FreeRTOS堆
+static StaticTask_t storage_tcb;
+static uint32_t storage_stack[256];
+static osThreadId_t storage_thread = NULL;
+static volatile bool storage_ready = false;
+
+static const osThreadAttr_t storage_attributes = {
+    .name = "storage",
+    .cb_mem = &storage_tcb,
+    .cb_size = sizeof(storage_tcb),
+    .stack_mem = storage_stack,
+    .stack_size = sizeof(storage_stack),
+    .priority = (osPriority_t) osPriorityLow, // 与记录任务相同，低于其他任务
+};
+
+// 擦写失败的内容留在队列中（或重新标记），下一次唤醒时重试
+static void storage_task(void *argument) {
+    (void)argument;
+    int8_t watchdog_id = watchdog_register("stor", WATCHDOG_TASK_DEADLINE_MS);
+    
+    // 上电扫描放在任务中，不推迟串口应答；日志挂载时可能擦除损坏的页，同样取得总线锁
+    onewire_lock();
+    alarm_init();          // 含config_store_init()
+    rtc_load_correction();
+    sampling_settings_load();
+    communication_load_address();
+#if COMM_GATEWAY
+    gateway_load_config();
+#endif
+    temp_log_init();
+    onewire_unlock();
+#if FW_UPDATE
+    fw_update_init(fw_install_device());
+#endif
+#if LOG_ARCHIVE_SD
+    // SD卡不影响取指，识别和挂载不需要总线锁；没有插卡时不归档
+    if (sd_card_init() && log_archive_mount(sd_card_archive_device(), (uint32_t)rtc_get_timestamp())) {
+        log_store_archive_start();
+    }
+#endif
+    storage_ready = true;
+    
+    for (;;) {
+        watchdog_checkin(watchdog_id);
+#if LOG_STORE_SPI_NOR
+        // 外置闪存擦写不暂停取指，不取总线锁，也不必等串口链路空闲；设置仍在片内闪存
+        bool erase_deferred = log_store_service(true);
+        onewire_lock();
+        config_store_service();
+#if FW_UPDATE
+        // 暂存区在片内闪存，与设置存储一样在总线空闲时擦写
+        uint32_t update_wait = fw_update_service(HAL_GetTick());
+#if FW_SLOTS
+        uint32_t slots_wait = fw_slots_service(HAL_GetTick());
+        if (slots_wait < update_wait) {
+            update_wait = slots_wait;
+        }
+#endif
+#endif
+        onewire_unlock();
+#else
+        onewire_lock();
+        bool erase_deferred = log_store_service(communication_quiet(STORAGE_ERASE_QUIET_MS));
+        config_store_service();
+        onewire_unlock();
+#endif
+        uint32_t timeout = erase_deferred ? STORAGE_ERASE_RETRY_MS : osWaitForever;
+#if FW_UPDATE
+        if (update_wait < timeout) {
+            timeout = update_wait;
+        }
+#endif
+#if LOG_ARCHIVE_SD
+        // 归档在总线锁之外写入SD卡，写入期间采样和闪存写入照常进行
+        uint32_t archive_wait = log_store_archive_sync(HAL_GetTick());
+        if (archive_wait < timeout) {
+            timeout = archive_wait;
+        }
+#endif
+        
+        watchdog_wait(watchdog_id);
+        if (osThreadFlagsWait(STORAGE_FLAG_WAKE, osFlagsWaitAny, timeout) == STORAGE_FLAG_WAKE &&
+            !erase_deferred) {
+            osDelay(STORAGE_BATCH_MS);
+        }
+    }
+}
+
+void storage_task_start(void) {
+    storage_thread = osThreadNew(storage_task, NULL, &storage_attributes);
+}
+
+void storage_task_wake(void) {
+    if (storage_thread != NULL) {
+        osThreadFlagsSet(storage_thread, STORAGE_FLAG_WAKE);
+    }
+}
+
+bool storage_task_ready(void) {
+    return storage_ready;
+}
+
+void storage_task_wait_ready(void) {
+    while (!storage_ready) {
+        osDelay(STORAGE_READY_POLL_MS);
+    }
+}
@@ -0,0 +1,106 @@
+#include "temp_calib.h"
+#include "protocol.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+// 每个传感器的修正表：第i段从measured[i]开始，斜率slope[i]（参考温度/读数，<< TEMP_CALIB_SLOPE_SHIFT），
+// 只有一个点时斜率为1。访问时进入临界段
+typedef struct {
+    TempCalibration points;
+    int32_t slope[TEMP_CALIB_MAX_POINTS - 1];
+} TempCalibTable;
+
+static TempCalibTable tables[TEMP_MAX_SENSORS];
+
+bool temp_calib_valid(const TempCalibration *calibration) {
+    if (calibration->count > TEMP_CALIB_MAX_POINTS) {
+        return false;
+    }
+    for (uint8_t i = 0; i < calibration->count; i++) {
+        if (calibration->measured[i] < TEMP_CALIB_MIN || calibration->measured[i] > TEMP_CALIB_MAX ||
+            calibration->reference[i] < TEMP_CALIB_MIN || calibration->reference[i] > TEMP_CALIB_MAX) {
+            return false;
+        }
+        if (i == 0) {
+            continue;
+        }
+        // 相邻两点的斜率在1/4~4之间（增益修正，避免输错的点把读数放大）
+        int32_t rise = calibration->reference[i] - calibration->reference[i - 1];
+        int32_t run = calibration->measured[i] - calibration->measured[i - 1];
+        if (run <= 0 || rise * 4 < run || rise > run * 4) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void temp_calib_configure(uint8_t sensor, const TempCalibration *calibration) {
+    if (sensor >= TEMP_MAX_SENSORS) {
+        return;
+    }
+    // 斜率在临界段外算好
+    TempCalibTable table = { .points = *calibration };
+    table.points.reserved = 0;
+    for (uint8_t i = calibration->count; i < TEMP_CALIB_MAX_POINTS; i++) {
+        table.points.measured[i] = 0;
+        table.points.reference[i] = 0;
+    }
+    table.slope[0] = 1 << TEMP_CALIB_SLOPE_SHIFT;
+    for (uint8_t i = 0; i + 1 < calibration->count; i++) {
+        int32_t rise = calibration->reference[i + 1] - calibration->reference[i];
+        int32_t run = calibration->measured[i + 1] - calibration->measured[i];
+        table.slope[i] = (rise * (1 << TEMP_CALIB_SLOPE_SHIFT) + run / 2) / run;
+    }
+    taskENTER_CRITICAL();
+    tables[sensor] = table;
+    taskEXIT_CRITICAL();
+}
+
+void temp_calib_get(uint8_t sensor, TempCalibration *calibration) {
+    if (sensor >= TEMP_MAX_SENSORS) {
+        *calibration = (TempCalibration){ 0 };
+        return;
+    }
+    taskENTER_CRITICAL();
+    *calibration = tables[sensor].points;
+    taskEXIT_CRITICAL();
+}
+
+void temp_calib_reset(void) {
+    for (uint8_t i = 0; i < TEMP_MAX_SENSORS; i++) {
+        temp_calib_configure(i, &(TempCalibration){ 0 });
+    }
+}
+
+static int16_t calib_correct(const TempCalibTable *table, int16_t value) {
+    uint8_t count = table->points.count;
+    if (count == 0 || value == TEMP_INVALID) {
+        return value;
+    }
+    // 选段：低于第二个点用第0段，高于倒数第二个点用最后一段
+    // 读数限制在校准点的范围内（DS18B20不会超出），差值不超过1900、斜率不超过4，乘积不溢出
+    if (value < TEMP_CALIB_MIN) {
+        value = TEMP_CALIB_MIN;
+    } else if (value > TEMP_CALIB_MAX) {
+        value = TEMP_CALIB_MAX;
+    }
+    uint8_t segment = 0;
+    while (segment + 2 < count && value >= table->points.measured[segment + 1]) {
+        segment++;
+    }
+    int32_t offset = (int32_t)(value - table->points.measured[segment]) * table->slope[segment];
+    int32_t corrected = table->points.reference[segment] +
+                        ((offset + (1 << (TEMP_CALIB_SLOPE_SHIFT - 1))) >> TEMP_CALIB_SLOPE_SHIFT);
+    return (int16_t)corrected;
+}
+
+void temp_calib_apply(int16_t *temperatures, uint8_t count) {
+    if (count > TEMP_MAX_SENSORS) {
+        count = TEMP_MAX_SENSORS;
+    }
+    taskENTER_CRITICAL();
+    for (uint8_t i = 0; i < count; i++) {
+        temperatures[i] = calib_correct(&tables[i], temperatures[i]);
+    }
+    taskEXIT_CRITICAL();
+}
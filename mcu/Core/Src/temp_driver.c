@@ -0,0 +1,111 @@
+#include "temp_driver.h"
+#include "main.h"
+#include "cmsis_os.h"
+#include <string.h>
+
+typedef struct {
+    const TempDriver *driver;
+    void *context;
+    uint8_t first;    // 第一个通道的传感器编号
+    uint8_t channels; // 使用的通道数
+} TempDriverSlot;
+
+// 只由采样任务访问
+static TempDriverSlot driver_slots[TEMP_DRIVER_MAX];
+static uint8_t driver_count = 0;
+static uint8_t sensor_total = 0;
+
+void temp_driver_reset(void) {
+    memset(driver_slots, 0, sizeof(driver_slots));
+    driver_count = 0;
+    sensor_total = 0;
+}
+
+bool temp_driver_register(const TempDriver *driver, void *context) {
+    if (driver_count >= TEMP_DRIVER_MAX) {
+        return false;
+    }
+    driver_slots[driver_count].driver = driver;
+    driver_slots[driver_count].context = context;
+    driver_slots[driver_count].first = 0;
+    driver_slots[driver_count].channels = 0;
+    driver_count++;
+    return true;
+}
+
+uint8_t temp_driver_probe(void) {
+    sensor_total = 0;
+    for (uint8_t d = 0; d < driver_count; d++) {
+        TempDriverSlot *slot = &driver_slots[d];
+        uint8_t channels = slot->driver->probe(slot->context);
+        if (channels > TEMP_MAX_SENSORS - sensor_total) {
+            channels = (uint8_t)(TEMP_MAX_SENSORS - sensor_total);
+        }
+        slot->first = sensor_total;
+        slot->channels = channels;
+        sensor_total = (uint8_t)(sensor_total + channels);
+    }
+    return sensor_total;
+}
+
+uint8_t temp_driver_sensor_count(void) {
+    return sensor_total;
+}
+
+static void temp_driver_read(const TempDriverSlot *slot, int16_t *temperatures) {
+    for (uint8_t c = 0; c < slot->channels; c++) {
+        if (slot->driver->healthy == NULL || slot->driver->healthy(slot->context, c)) {
+            temperatures[slot->first + c] = slot->driver->read(slot->context, c);
+        }
+    }
+}
+
+uint8_t temp_driver_sample(int16_t *temperatures) {
+    for (uint8_t i = 0; i < sensor_total; i++) {
+        temperatures[i] = TEMP_INVALID;
+    }
+
+    // 全部启动后再等待；启动失败的驱动本次各通道记为失败
+    uint32_t ready_at[TEMP_DRIVER_MAX];
+    uint32_t pending = 0;
+    for (uint8_t d = 0; d < driver_count; d++) {
+        TempDriverSlot *slot = &driver_slots[d];
+        uint32_t remaining_ms = 0;
+        if (slot->channels == 0 || !slot->driver->start(slot->context, &remaining_ms)) {
+            continue;
+        }
+        ready_at[d] = HAL_GetTick() + remaining_ms;
+        pending |= 1UL << d;
+    }
+
+    // 睡到最早到期的驱动，到期的驱动才轮询，完成后立即读取，其余驱动的转换继续进行
+    while (pending != 0) {
+        uint32_t now = HAL_GetTick();
+        uint32_t wait = UINT32_MAX;
+        for (uint8_t d = 0; d < driver_count; d++) {
+            if ((pending & (1UL << d)) == 0) {
+                continue;
+            }
+            const TempDriverSlot *slot = &driver_slots[d];
+            int32_t left = (int32_t)(ready_at[d] - now);
+            if (left > 0) {
+                if ((uint32_t)left < wait) {
+                    wait = (uint32_t)left;
+                }
+                continue;
+            }
+            if (slot->driver->poll(slot->context)) {
+                temp_driver_read(slot, temperatures);
+                pending &= ~(1UL << d);
+            } else if ((uint32_t)-left >= TEMP_DRIVER_TIMEOUT_MS) {
+                pending &= ~(1UL << d); // 驱动没有结束转换，不再等待
+            } else if (TEMP_DRIVER_POLL_MS < wait) {
+                wait = TEMP_DRIVER_POLL_MS;
+            }
+        }
+        if (pending != 0) {
+            osDelay(wait);
+        }
+    }
+    return sensor_total;
+}
@@ -0,0 +1,130 @@
+#include "temp_filter.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+// EMA累加值比读数多保留的小数位：比最大N多4位，(x - ema) / 2^N在差距不足0.1°C时
+// 仍有整数部分，从下方和上方都收敛到读数
+#define EMA_FRACTION_BITS (TEMP_FILTER_MAX_SHIFT + 4)
+
+// 每个传感器的滤波历史，只由采样任务访问
+typedef struct {
+    int16_t history[TEMP_FILTER_MAX_WINDOW]; // 环形缓冲区
+    uint8_t count;                           // 历史中的读数个数（不超过窗口）
+    uint8_t next;                            // 下一个写入位置
+    int32_t ema;                             // EMA累加值（0.1°C << EMA_FRACTION_BITS）
+} TempFilterState;
+
+static TempFilterState filter_states[TEMP_MAX_SENSORS];
+static TempFilterConfig filter_config = { TEMP_FILTER_NONE, 0 }; // 访问时进入临界段
+static volatile bool filter_config_changed = false;
+
+bool temp_filter_config_valid(const TempFilterConfig *config) {
+    switch (config->mode) {
+    case TEMP_FILTER_NONE:
+        return true;
+    case TEMP_FILTER_AVERAGE:
+    case TEMP_FILTER_MEDIAN:
+        return config->param >= 1 && config->param <= TEMP_FILTER_MAX_WINDOW;
+    case TEMP_FILTER_EMA:
+        return config->param >= 1 && config->param <= TEMP_FILTER_MAX_SHIFT;
+    default:
+        return false;
+    }
+}
+
+void temp_filter_configure(const TempFilterConfig *config) {
+    taskENTER_CRITICAL();
+    filter_config = *config;
+    filter_config_changed = true;
+    taskEXIT_CRITICAL();
+}
+
+void temp_filter_get_config(TempFilterConfig *config) {
+    taskENTER_CRITICAL();
+    *config = filter_config;
+    taskEXIT_CRITICAL();
+}
+
+// 整数除法四舍五入（远离0）
+static int16_t divide_rounded(int32_t sum, int32_t count) {
+    return (int16_t)((sum + (sum < 0 ? -count / 2 : count / 2)) / count);
+}
+
+static int16_t filter_average(const TempFilterState *state) {
+    int32_t sum = 0;
+    for (uint8_t i = 0; i < state->count; i++) {
+        sum += state->history[i];
+    }
+    return divide_rounded(sum, state->count);
+}
+
+static int16_t filter_median(const TempFilterState *state) {
+    // 窗口很小，复制后插入排序
+    int16_t sorted[TEMP_FILTER_MAX_WINDOW];
+    uint8_t n = state->count;
+    for (uint8_t i = 0; i < n; i++) {
+        int16_t value = state->history[i];
+        uint8_t j = i;
+        while (j > 0 && sorted[j - 1] > value) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+    }
+    
+    // 偶数个时取中间两个的平均
+    if (n & 1) {
+        return sorted[n / 2];
+    }
+    return divide_rounded((int32_t)sorted[n / 2 - 1] + sorted[n / 2], 2);
+}
+
+int16_t temp_filter_apply(uint8_t sensor, int16_t raw) {
+    TempFilterConfig config;
+    
+    taskENTER_CRITICAL();
+    config = filter_config;
+    bool changed = filter_config_changed;
+    filter_config_changed = false;
+    taskEXIT_CRITICAL();
+    
+    // 配置变化后所有传感器重新开始
+    if (changed) {
+        for (uint8_t i = 0; i < TEMP_MAX_SENSORS; i++) {
+            filter_states[i].count = 0;
+            filter_states[i].next = 0;
+        }
+    }
+    
+    if (sensor >= TEMP_MAX_SENSORS || raw == TEMP_INVALID) {
+        return TEMP_INVALID;
+    }
+    
+    TempFilterState *state = &filter_states[sensor];
+    switch (config.mode) {
+    case TEMP_FILTER_AVERAGE:
+    case TEMP_FILTER_MEDIAN:
+        state->history[state->next] = raw;
+        state->next = (uint8_t)((state->next + 1) % config.param);
+        if (state->count < config.param) {
+            state->count++;
+        }
+        return (config.mode == TEMP_FILTER_AVERAGE) ? filter_average(state) : filter_median(state);
+        
+    case TEMP_FILTER_EMA:
+        // 第一个读数直接作为初值，之后 ema += (x - ema) / 2^N，增量四舍五入（算术右移前加半个单位），
+        // 两个方向的残差对称
+        if (state->count == 0) {
+            state->ema = (int32_t)raw * (1 << EMA_FRACTION_BITS);
+            state->count = 1;
+        } else {
+            int32_t gap = (int32_t)raw * (1 << EMA_FRACTION_BITS) - state->ema;
+            state->ema += (gap + (1 << (config.param - 1))) >> config.param;
+        }
+        return (int16_t)((state->ema + (1 << (EMA_FRACTION_BITS - 1))) >> EMA_FRACTION_BITS);
+        
+    case TEMP_FILTER_NONE:
+    default:
+        return raw;
+    }
+}
@@ -0,0 +1,123 @@
+#include "temp_logger.h"
+#include "temp_sampler.h"
+#include "device_control.h"
+#include "rtc_clock.h"
+#include "watchdog.h"
+#include "storage_task.h"
+#include "main.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+// 记录任务的线程标志
+#define LOGGER_FLAG_CONFIG 0x0001U
+#define LOGGER_FLAG_ALARM  0x0002U  // RTC定时唤醒
+
+// 记录任务使用静态内存，不占用FreeRTOS堆
+static StaticTask_t logger_tcb;
+static uint32_t logger_stack[128];
+static osThreadId_t logger_thread = NULL;
+
+static const osThreadAttr_t logger_attributes = {
+    .name = "tempLogger",
+    .cb_mem = &logger_tcb,
+    .cb_size = sizeof(logger_tcb),
+    .stack_mem = logger_stack,
+    .stack_size = sizeof(logger_stack),
+    .priority = (osPriority_t) osPriorityLow, // 低于采样任务
+};
+
+static volatile uint32_t log_interval_ms = TEMP_LOG_INTERVAL_DEFAULT_MS;
+
+// 记录最近一次采样中每个读取成功的传感器
+static void log_latest_sample(void) {
+    TempSample sample;
+    if (!temp_sampler_get(&sample)) {
+        return; // 上电后尚无采样
+    }
+    
+    for (uint8_t i = 0; i < sample.sensor_count; i++) {
+        if (sample.temperatures[i] != TEMP_INVALID) {
+            temp_log_add_entry(i, sample.temperatures[i], sample.raw[i]);
+        }
+    }
+}
+
+// 闹钟中断中调用
+static void logger_alarm(void) {
+    osThreadFlagsSet(logger_thread, LOGGER_FLAG_ALARM);
+}
+
+// 等待一次：RTC闹钟在target_ms之前的最后一个整秒唤醒，不足一秒的部分由内核超时补齐。
+// 内核节拍在STOP期间有舍入误差，按RTC计时的长间隔不会累积误差。记录间隔被修改时返回true
+static bool logger_wait(uint64_t target_ms, uint64_t now_ms) {
+    rtc_wake_schedule(RTC_WAKE_LOGGER, target_ms, logger_alarm);
+    uint32_t flags = osThreadFlagsWait(LOGGER_FLAG_CONFIG | LOGGER_FLAG_ALARM, osFlagsWaitAny,
+                                       rtc_wait_ticks(target_ms - now_ms));
+    return (flags & osFlagsError) == 0 && (flags & LOGGER_FLAG_CONFIG) != 0;
+}
+
+static void logger_task(void *argument) {
+    (void)argument;
+    
+    // 日志挂载后补齐复位前未写入的每小时汇总
+    storage_task_wait_ready();
+    temp_log_recover_rollups();
+    
+    uint64_t next_ms = rtc_get_timestamp_ms() + log_interval_ms;
+    int8_t watchdog_id = watchdog_register("log", WATCHDOG_TASK_DEADLINE_MS);
+    
+    for (;;) {
+        watchdog_checkin(watchdog_id);
+        uint32_t interval = log_interval_ms;
+        if (interval == 0) {
+            rtc_wake_cancel(RTC_WAKE_LOGGER);
+            watchdog_wait(watchdog_id);
+            osThreadFlagsWait(LOGGER_FLAG_CONFIG, osFlagsWaitAny, osWaitForever);
+            next_ms = rtc_get_timestamp_ms() + log_interval_ms;
+            continue;
+        }
+        
+        // 每次唤醒（含设置时间后的立即唤醒）都按当前时间重新判断，时间回拨时从现在重新计时；
+        // 间隔修改时提前唤醒，从修改时刻重新计时
+        uint64_t now_ms = rtc_get_timestamp_ms();
+        if (next_ms > now_ms + interval) {
+            next_ms = now_ms + interval;
+        }
+        if (now_ms < next_ms) {
+            watchdog_wait(watchdog_id);
+            if (logger_wait(next_ms, now_ms)) {
+                next_ms = rtc_get_timestamp_ms() + log_interval_ms;
+            }
+            continue;
+        }
+        
+        log_latest_sample();
+        
+        // 按固定节拍推进，不累积记录本身的耗时；落后超过一个间隔时重新计时
+        next_ms += interval;
+        if (next_ms <= now_ms) {
+            next_ms = now_ms + interval;
+        }
+    }
+}
+
+void temp_logger_start(void) {
+    logger_thread = osThreadNew(logger_task, NULL, &logger_attributes);
+}
+
+bool temp_logger_set_interval(uint32_t interval_ms) {
+    if (interval_ms != 0 && interval_ms < TEMP_LOG_INTERVAL_MIN_MS) {
+        return false;
+    }
+    
+    log_interval_ms = interval_ms;
+    if (logger_thread != NULL) {
+        osThreadFlagsSet(logger_thread, LOGGER_FLAG_CONFIG);
+    }
+    return true;
+}
+
+uint32_t temp_logger_get_interval(void) {
+    return log_interval_ms;
+}
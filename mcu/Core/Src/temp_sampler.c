@@ -0,0 +1,207 @@
+#include "temp_sampler.h"
+#include "device_control.h"
+#include "temp_filter.h"
+#include "temp_calib.h"
+#include "temp_stats.h"
+#include "sample_schedule.h"
+#include "communication.h"
+#include "timebase.h"
+#include "rtc_clock.h"
+#include "watchdog.h"
+#include "storage_task.h"
+#include "warm_state.h"
+#include "main.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <string.h>
+
+// 采样任务的线程标志
+#define SAMPLER_FLAG_FRESH 0x0001U
+#define SAMPLER_FLAG_ALARM 0x0002U  // RTC定时唤醒
+
+// 闹钟在目标时刻触发时内核超时推迟这些毫秒，内核节拍与RTC有偏差时也不会先于闹钟到期
+#define SAMPLER_ALARM_MARGIN_MS 100U
+
+// 采样任务使用静态内存，不占用FreeRTOS堆
+static StaticTask_t sampler_tcb;
+static uint32_t sampler_stack[128];
+static osThreadId_t sampler_thread = NULL;
+
+static const osThreadAttr_t sampler_attributes = {
+    .name = "tempSampler",
+    .cb_mem = &sampler_tcb,
+    .cb_size = sizeof(sampler_tcb),
+    .stack_mem = sampler_stack,
+    .stack_size = sizeof(sampler_stack),
+    .priority = (osPriority_t) osPriorityNormal, // 低于接收任务，高于命令执行任务
+};
+
+// 最近一次采样，通信任务读取，访问时进入临界段；热复位后保留（warm_state.h），
+// 复位后temp立即有读数（AG为实际的年龄），第一次新的转换完成前也不用等待
+#define SAMPLER_WARM_MAGIC 0x54534D50UL
+static WARM_STATE struct {
+    WarmState state;
+    TempSample sample;
+    uint64_t publish_ms; // 发布时的RTC时间，恢复时换算为本次启动的节拍
+} latest;
+static volatile uint32_t started_sequence = 0; // 最近一次开始的转换序号
+static volatile uint8_t pending_resolution = 0; // 待写入的分辨率，0表示无
+static volatile uint32_t alarm_latency_max_us = 0; // 转换完成到报警输出的最长耗时
+
+// 闹钟中断中调用
+static void sampler_alarm(void) {
+    osThreadFlagsSet(sampler_thread, SAMPLER_FLAG_ALARM);
+}
+
+// 等到RTC时间target_ms，收到新采样请求时提前返回false。到target_ms之前的最后一个整秒
+// 由RTC闹钟唤醒（期间可进入STOP），不足一秒的部分由内核超时等待；target_ms为整秒时内核超时
+// 推迟一点，只作为闹钟失效（RTC未运行）时的后备。时间被修改（闹钟立即触发）后按新时间判断，
+// 回拨时不再等待
+static bool sampler_wait_until(uint64_t target_ms) {
+    bool reached = true;
+    for (;;) {
+        uint64_t now_ms = rtc_get_timestamp_ms();
+        if (now_ms >= target_ms || target_ms - now_ms > TEMP_SAMPLE_INTERVAL_MS) {
+            break;
+        }
+        uint32_t timeout = rtc_wait_ticks(target_ms - now_ms);
+        uint64_t wake_ms = rtc_wake_schedule(RTC_WAKE_SAMPLER, target_ms, sampler_alarm);
+        if (wake_ms == target_ms) {
+            timeout += SAMPLER_ALARM_MARGIN_MS;
+        }
+        uint32_t flags = osThreadFlagsWait(SAMPLER_FLAG_FRESH | SAMPLER_FLAG_ALARM, osFlagsWaitAny, timeout);
+        if ((flags & osFlagsError) != 0) {
+            break; // 超时
+        }
+        if ((flags & SAMPLER_FLAG_FRESH) != 0) {
+            reached = false; // 新采样请求；只有闹钟时回到开头按当前时间判断
+            break;
+        }
+    }
+    rtc_wake_cancel(RTC_WAKE_SAMPLER);
+    osThreadFlagsClear(SAMPLER_FLAG_FRESH | SAMPLER_FLAG_ALARM);
+    return reached;
+}
+
+// 每个采样周期签到一次，等待下一周期时也受监督（最长等待一个周期）。
+// 按计划（sample_schedule.h）提前开始转换，读数在整秒发布；新采样请求立即开始一次计划外的转换
+static void sampler_task(void *argument) {
+    (void)argument;
+    int8_t watchdog_id = watchdog_register("samp", WATCHDOG_TASK_DEADLINE_MS);
+
+    // 搜索传感器耗时数十毫秒，在本任务中完成；第一次检查报警前等规则加载完
+    temperature_sensor_init();
+    storage_task_wait_ready();
+    sample_schedule_reset(TEMP_SAMPLE_INTERVAL_MS);
+
+    for (;;) {
+        watchdog_checkin(watchdog_id);
+        bool scheduled = sampler_wait_until(sample_schedule_next_start(rtc_get_timestamp_ms()));
+        uint64_t start_ms = rtc_get_timestamp_ms();
+        uint32_t sequence = started_sequence + 1;
+        started_sequence = sequence;
+
+        // 总线只由本任务访问，分辨率在转换开始前写入；
+        // 先更新序号再取请求，请求方拿到的序号之后的采样一定已应用该分辨率
+        uint8_t bits = pending_resolution;
+        if (bits != 0) {
+            pending_resolution = 0;
+            temperature_set_resolution(bits);
+        }
+
+        // 转换期间只阻塞本任务
+        int16_t raw[TEMP_MAX_SENSORS];
+        uint8_t count = temperature_sample_all(raw);
+        uint32_t ready_cycles = timebase_cycles();
+
+        // 校准在滤波之前，发布的原始值也是修正后的读数
+        temp_calib_apply(raw, count);
+
+        // 定点滤波也在本任务中完成，通信任务只取结果
+        int16_t filtered[TEMP_MAX_SENSORS];
+        for (uint8_t i = 0; i < count; i++) {
+            filtered[i] = temp_filter_apply(i, raw[i]);
+        }
+
+        // 每次转换后立即检查报警，与主机是否连接无关；
+        // 耗时只取决于滤波和检查本身，优先级更高的通信任务抢占时才会变长
+        alarm_check_temperatures(filtered, count);
+        uint32_t latency_us = timebase_cycles_to_us(timebase_cycles() - ready_cycles);
+        if (latency_us > alarm_latency_max_us) {
+            alarm_latency_max_us = latency_us;
+        }
+        // 报警前后记录在测量耗时之后更新，触发的事件在本次检查中产生，本次读数计入触发前的部分
+        alarm_burst_sample(filtered, count);
+
+        // 按计划的采样提前完成时等到计划时刻再发布，转换耗时不含等待
+        uint64_t publish_ms = rtc_get_timestamp_ms();
+        uint32_t conversion_ms = (uint32_t)(publish_ms - start_ms);
+        if (scheduled && publish_ms < sample_schedule_due()) {
+            osDelay(rtc_wait_ticks(sample_schedule_due() - publish_ms));
+            publish_ms = rtc_get_timestamp_ms();
+        }
+
+        // 运行统计与发布的读数相同（滤波后）
+        uint32_t tick = HAL_GetTick();
+        temp_stats_update(filtered, count, tick);
+
+        taskENTER_CRITICAL();
+        memcpy(latest.sample.raw, raw, sizeof(raw));
+        memcpy(latest.sample.temperatures, filtered, sizeof(filtered));
+        latest.sample.sensor_count = count;
+        latest.sample.tick = tick;
+        latest.sample.sequence = sequence;
+        latest.publish_ms = publish_ms;
+        taskEXIT_CRITICAL();
+        if (scheduled) {
+            sample_schedule_complete(publish_ms, conversion_ms);
+        }
+
+        // 运行统计、通信统计和本次读数每次采样封装一次，复位时最多丢失一个周期内的修改
+        warm_state_seal_all();
+
+        // 通知通信任务处理新读数（报警推送、等待新采样的请求）
+        communication_wake();
+    }
+}
+
+void temp_sampler_start(void) {
+    if (warm_state_restore(&latest.state, SAMPLER_WARM_MAGIC, sizeof(latest)) && latest.sample.sequence != 0) {
+        // 序号接着上一次启动，等待新采样的请求不会把保留的读数当作新的
+        uint64_t now_ms = rtc_get_timestamp_ms();
+        uint64_t age_ms = now_ms > latest.publish_ms ? now_ms - latest.publish_ms : 0;
+        latest.sample.tick = HAL_GetTick() - (age_ms > UINT32_MAX ? UINT32_MAX : (uint32_t)age_ms);
+    } else {
+        latest.sample.sequence = 0;
+    }
+    started_sequence = latest.sample.sequence;
+    warm_state_seal(&latest.state);
+    warm_state_register(&latest.state);
+    sampler_thread = osThreadNew(sampler_task, NULL, &sampler_attributes);
+}
+
+bool temp_sampler_get(TempSample *sample) {
+    taskENTER_CRITICAL();
+    *sample = latest.sample;
+    taskEXIT_CRITICAL();
+    return sample->sequence != 0;
+}
+
+uint32_t temp_sampler_request_fresh(void) {
+    // 先取序号再唤醒，正在进行的转换不算新采样
+    uint32_t sequence = started_sequence;
+    if (sampler_thread != NULL) {
+        osThreadFlagsSet(sampler_thread, SAMPLER_FLAG_FRESH);
+    }
+    return sequence;
+}
+
+uint32_t temp_sampler_request_resolution(uint8_t bits) {
+    pending_resolution = bits;
+    return temp_sampler_request_fresh();
+}
+
+uint32_t temp_sampler_alarm_latency_max_us(void) {
+    return alarm_latency_max_us;
+}
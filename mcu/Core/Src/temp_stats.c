@@ -0,0 +1,232 @@
+#include "temp_stats.h"
+#include "protocol.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "warm_state.h"
+#include "main.h"
+
+// 一个窗口（或一个桶）的累计值
+typedef struct {
+    uint32_t count;
+    int16_t min;
+    int16_t max;
+    int64_t sum;
+    uint64_t sum_squares;
+    uint64_t above_ms;
+} StatsTotal;
+
+// 时间窗的一个桶：epoch为桶的序号加1（0为空），count达到上限后不再计入（每秒一次时远不会达到）
+typedef struct {
+    uint32_t epoch;
+    uint16_t count;
+    uint16_t above_ds;     // 高于阈值的时长（0.1秒）
+    int16_t min;
+    int16_t max;
+    int32_t sum;
+    uint64_t sum_squares;
+} StatsBin;
+
+typedef struct {
+    StatsTotal total;      // 复位（或清零）以来
+    StatsBin hour[TEMP_STATS_HOUR_BINS];
+    StatsBin day[TEMP_STATS_DAY_BINS];
+    int16_t threshold;     // 只在has_threshold时有效
+    bool has_threshold;
+    bool has_previous;     // previous_tick为上一次有效读数的时间
+    uint32_t previous_tick;
+} SensorStats;
+
+// 全零即无统计、无阈值，访问时进入临界段；热复位后保留（warm_state.h），由采样任务定期封装
+static WARM_STATE struct {
+    WarmState state;
+    SensorStats stats[TEMP_MAX_SENSORS];
+    // HAL_GetTick()扩展为64位的毫秒数，时间窗在计数回绕（约49.7天）时不清空
+    uint64_t clock_ms;
+    uint32_t clock_tick;
+} warm;
+
+static void sensor_clear(SensorStats *sensor) {
+    sensor->total = (StatsTotal){ 0 };
+    for (uint8_t i = 0; i < TEMP_STATS_HOUR_BINS; i++) {
+        sensor->hour[i].epoch = 0;
+    }
+    for (uint8_t i = 0; i < TEMP_STATS_DAY_BINS; i++) {
+        sensor->day[i].epoch = 0;
+    }
+    sensor->has_previous = false;
+}
+
+void temp_stats_reset(void) {
+    taskENTER_CRITICAL();
+    for (uint8_t i = 0; i < TEMP_MAX_SENSORS; i++) {
+        sensor_clear(&warm.stats[i]);
+        warm.stats[i].has_threshold = false;
+    }
+    warm.clock_ms = 0;
+    warm.clock_tick = 0;
+    taskEXIT_CRITICAL();
+}
+
+void temp_stats_warm_restore(void) {
+    if (warm_state_restore(&warm.state, TEMP_STATS_WARM_MAGIC, sizeof(warm))) {
+        // 上一次启动的节拍已失效：时钟从现在接着计（复位期间不计入），超限时长从下一次采样开始
+        warm.clock_tick = HAL_GetTick();
+        for (uint8_t i = 0; i < TEMP_MAX_SENSORS; i++) {
+            warm.stats[i].has_previous = false;
+        }
+    } else {
+        temp_stats_reset();
+    }
+    warm_state_seal(&warm.state);
+    warm_state_register(&warm.state);
+}
+
+void temp_stats_clear(uint8_t sensor) {
+    if (sensor >= TEMP_MAX_SENSORS) {
+        return;
+    }
+    taskENTER_CRITICAL();
+    sensor_clear(&warm.stats[sensor]);
+    taskEXIT_CRITICAL();
+}
+
+void temp_stats_set_threshold(uint8_t sensor, int16_t threshold) {
+    if (sensor >= TEMP_MAX_SENSORS) {
+        return;
+    }
+    taskENTER_CRITICAL();
+    warm.stats[sensor].threshold = threshold;
+    warm.stats[sensor].has_threshold = threshold != TEMP_INVALID;
+    taskEXIT_CRITICAL();
+}
+
+static void bin_add(StatsBin *bins, uint8_t bin_count, uint32_t bin_ms, uint64_t now_ms,
+                    int16_t value, uint32_t above_ms) {
+    uint32_t epoch = (uint32_t)(now_ms / bin_ms) + 1;
+    StatsBin *bin = &bins[epoch % bin_count];
+    if (bin->epoch != epoch) {
+        *bin = (StatsBin){ .epoch = epoch, .min = value, .max = value };
+    }
+    if (bin->count == UINT16_MAX) {
+        return;
+    }
+    bin->count++;
+    bin->above_ds += (uint16_t)(above_ms / 100U);
+    if (value < bin->min) {
+        bin->min = value;
+    }
+    if (value > bin->max) {
+        bin->max = value;
+    }
+    bin->sum += value;
+    bin->sum_squares += (uint32_t)((int32_t)value * value);
+}
+
+void temp_stats_update(const int16_t *temperatures, uint8_t count, uint32_t tick) {
+    if (count > TEMP_MAX_SENSORS) {
+        count = TEMP_MAX_SENSORS;
+    }
+    taskENTER_CRITICAL();
+    warm.clock_ms += (uint32_t)(tick - warm.clock_tick);
+    warm.clock_tick = tick;
+    for (uint8_t i = 0; i < count; i++) {
+        SensorStats *sensor = &warm.stats[i];
+        int16_t value = temperatures[i];
+        if (value == TEMP_INVALID) {
+            sensor->has_previous = false;
+            continue;
+        }
+        // 读数高于阈值时计入与上一次采样的间隔
+        uint32_t above_ms = 0;
+        if (sensor->has_previous && sensor->has_threshold && value > sensor->threshold) {
+            above_ms = tick - sensor->previous_tick;
+            if (above_ms > TEMP_STATS_MAX_GAP_MS) {
+                above_ms = 0;
+            }
+        }
+        sensor->has_previous = true;
+        sensor->previous_tick = tick;
+
+        StatsTotal *total = &sensor->total;
+        if (total->count == 0 || value < total->min) {
+            total->min = value;
+        }
+        if (total->count == 0 || value > total->max) {
+            total->max = value;
+        }
+        total->count++;
+        total->sum += value;
+        total->sum_squares += (uint32_t)((int32_t)value * value);
+        total->above_ms += above_ms;
+
+        bin_add(sensor->hour, TEMP_STATS_HOUR_BINS, TEMP_STATS_HOUR_BIN_MS, warm.clock_ms, value, above_ms);
+        bin_add(sensor->day, TEMP_STATS_DAY_BINS, TEMP_STATS_DAY_BIN_MS, warm.clock_ms, value, above_ms);
+    }
+    taskEXIT_CRITICAL();
+}
+
+// 合并落在当前桶及之前bin_count - 1个桶内的桶
+static void bins_merge(const StatsBin *bins, uint8_t bin_count, uint32_t bin_ms, uint64_t now_ms, StatsTotal *total) {
+    uint32_t current = (uint32_t)(now_ms / bin_ms) + 1;
+    for (uint8_t i = 0; i < bin_count; i++) {
+        const StatsBin *bin = &bins[i];
+        if (bin->epoch == 0 || bin->count == 0 || current - bin->epoch >= bin_count) {
+            continue;
+        }
+        if (total->count == 0 || bin->min < total->min) {
+            total->min = bin->min;
+        }
+        if (total->count == 0 || bin->max > total->max) {
+            total->max = bin->max;
+        }
+        total->count += bin->count;
+        total->sum += bin->sum;
+        total->sum_squares += bin->sum_squares;
+        total->above_ms += (uint64_t)bin->above_ds * 100U;
+    }
+}
+
+// 整数除法四舍五入（远离0）
+static int64_t divide_rounded(int64_t value, int64_t divisor) {
+    return (value + (value < 0 ? -divisor / 2 : divisor / 2)) / divisor;
+}
+
+bool temp_stats_query(uint8_t sensor, uint8_t window, uint32_t now, TempStatsResult *result) {
+    if (sensor >= TEMP_MAX_SENSORS || window >= TEMP_STATS_WINDOWS) {
+        return false;
+    }
+    StatsTotal total = { 0 };
+    taskENTER_CRITICAL();
+    const SensorStats *state = &warm.stats[sensor];
+    uint64_t now_ms = warm.clock_ms + (uint32_t)(now - warm.clock_tick);
+    if (window == TEMP_STATS_SINCE_BOOT) {
+        total = state->total;
+    } else if (window == TEMP_STATS_HOUR) {
+        bins_merge(state->hour, TEMP_STATS_HOUR_BINS, TEMP_STATS_HOUR_BIN_MS, now_ms, &total);
+    } else {
+        bins_merge(state->day, TEMP_STATS_DAY_BINS, TEMP_STATS_DAY_BIN_MS, now_ms, &total);
+    }
+    int16_t threshold = state->has_threshold ? state->threshold : TEMP_INVALID;
+    taskEXIT_CRITICAL();
+
+    *result = (TempStatsResult){ .count = total.count, .threshold = threshold,
+                                 .above_ms = total.above_ms > UINT32_MAX ? UINT32_MAX : (uint32_t)total.above_ms };
+    if (total.count == 0) {
+        return true;
+    }
+    int64_t n = total.count;
+    int64_t mean = divide_rounded(total.sum, n);
+    result->min = total.min;
+    result->max = total.max;
+    result->mean = (int16_t)mean;
+    if (n >= 2) {
+        // Σ(x - μ)² = Σ(x - m)² - (Σx - n·m)² / n，m为取整的均值；各项都是整数，
+        // |x - m|不超过量程，n·m²与平方和同一量级，不会溢出
+        int64_t deviation = total.sum - n * mean;
+        int64_t squares = (int64_t)total.sum_squares - 2 * mean * total.sum + n * mean * mean -
+                          deviation * deviation / n;
+        int64_t variance = squares > 0 ? divide_rounded(squares, n - 1) : 0;
+        result->variance = variance > UINT32_MAX ? UINT32_MAX : (uint32_t)variance;
+    }
+    return true;
+}
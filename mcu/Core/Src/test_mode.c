@@ -0,0 +1,122 @@
+#include "test_mode.h"
+
+#if TEST_MODE
+#include "main.h"
+#endif
+
+void test_script_init(TestScript *script, uint32_t seed, uint8_t sensors) {
+    script->seed = seed;
+    script->sensors = sensors;
+    script->index = 0;
+    script->current = 0;
+}
+
+// 由种子、传感器和序号决定的伪随机数（MurmurHash3的末尾混合）
+static uint32_t script_hash(uint32_t seed, uint8_t sensor, uint32_t index) {
+    uint32_t x = seed * 0x9E3779B1U ^ index * 0x85EBCA77U ^ (uint32_t)sensor * 0xC2B2AE3DU;
+    x ^= x >> 16;
+    x *= 0x85EBCA6BU;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35U;
+    x ^= x >> 16;
+    return x;
+}
+
+// 周期内的位置映射为-AMPLITUDE~AMPLITUDE的三角波
+static int32_t script_triangle(uint32_t index) {
+    uint32_t half = TEST_SCRIPT_PERIOD / 2U;
+    uint32_t phase = index % TEST_SCRIPT_PERIOD;
+    uint32_t rise = phase < half ? phase : TEST_SCRIPT_PERIOD - phase;
+    return -TEST_SCRIPT_AMPLITUDE + (int32_t)(rise * 2U * TEST_SCRIPT_AMPLITUDE / half);
+}
+
+int16_t test_script_value(const TestScript *script, uint8_t sensor, uint32_t index) {
+    if (sensor > 0 && sensor + 1U == script->sensors &&
+        index % TEST_SCRIPT_DROP_EVERY == TEST_SCRIPT_DROP_EVERY - 1U) {
+        return TEMP_INVALID;
+    }
+    int32_t value = TEST_SCRIPT_BASE + (int32_t)sensor * TEST_SCRIPT_STEP;
+    value += script_triangle(index + sensor * (TEST_SCRIPT_PERIOD / 8U));
+    value += (int32_t)(script_hash(script->seed, sensor, index) % (2U * TEST_SCRIPT_NOISE + 1U)) - TEST_SCRIPT_NOISE;
+    if (sensor == 0 && index % TEST_SCRIPT_SPIKE_EVERY >= TEST_SCRIPT_SPIKE_EVERY - TEST_SCRIPT_SPIKE_LENGTH) {
+        value += TEST_SCRIPT_SPIKE;
+    }
+    return (int16_t)value;
+}
+
+static uint8_t script_probe(void *context) {
+    TestScript *script = context;
+    script->index = 0;
+    return script->sensors;
+}
+
+static bool script_start(void *context, uint32_t *remaining_ms) {
+    TestScript *script = context;
+    script->current = script->index++;
+    *remaining_ms = 0;
+    return true;
+}
+
+static bool script_poll(void *context) {
+    (void)context;
+    return true;
+}
+
+static int16_t script_read(void *context, uint8_t channel) {
+    const TestScript *script = context;
+    if (channel >= script->sensors) {
+        return TEMP_INVALID;
+    }
+    return test_script_value(script, channel, script->current);
+}
+
+const TempDriver test_script_driver = {
+    .name = "script",
+    .probe = script_probe,
+    .start = script_start,
+    .poll = script_poll,
+    .read = script_read,
+};
+
+uint64_t test_clock_elapsed_ms(uint32_t ticks, uint32_t speed) {
+    return (uint64_t)ticks * speed;
+}
+
+uint32_t test_clock_wait_ticks(uint64_t span_ms, uint32_t speed) {
+    uint64_t ticks = (span_ms + speed - 1U) / speed;
+    return ticks > UINT32_MAX ? UINT32_MAX : (uint32_t)ticks;
+}
+
+#if TEST_MODE
+TestScript test_mode_script = { TEST_MODE_SEED, TEST_MODE_SENSORS, 0, 0 };
+
+// 虚拟时钟为clock_base_ms加上clock_base_tick以来的节拍数乘以倍速；
+// 设置时间后连续运行约49天内节拍差不回绕。写入时关中断，
+// 被写入打断的读取方由version（seqlock，与rtc_clock.c相同）发现并重读
+static uint64_t clock_base_ms = 0;
+static uint32_t clock_base_tick = 0;
+static volatile uint32_t clock_version = 0;
+
+uint64_t test_mode_clock_ms(void) {
+    uint64_t base_ms;
+    uint32_t base_tick, start;
+    do {
+        while ((start = __atomic_load_n(&clock_version, __ATOMIC_ACQUIRE)) & 1U) {
+        }
+        base_ms = clock_base_ms;
+        base_tick = clock_base_tick;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (clock_version != start);
+    return base_ms + test_clock_elapsed_ms(HAL_GetTick() - base_tick, TEST_MODE_SPEED);
+}
+
+void test_mode_clock_set_ms(uint64_t timestamp_ms) {
+    __disable_irq();
+    __atomic_store_n(&clock_version, clock_version + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    clock_base_ms = timestamp_ms;
+    clock_base_tick = HAL_GetTick();
+    __atomic_store_n(&clock_version, clock_version + 1, __ATOMIC_RELEASE);
+    __enable_irq();
+}
+#endif
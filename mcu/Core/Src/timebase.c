@@ -0,0 +1,35 @@
+#include "timebase.h"
+#include "stm32f1xx_hal.h"
+
+// HAL时基定时器（stm32f1xx_hal_timebase_tim.c）：计数频率1MHz，1000次溢出一次
+#define TIMEBASE_TIM TIM7
+
+uint32_t timebase_cycles_per_us = 72;
+
+void timebase_init(void) {
+    timebase_cycles_per_us = SystemCoreClock / 1000000U;
+    
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // 使能DWT
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t micros(void) {
+    uint32_t ms, us;
+    
+    // 读取期间毫秒数变化则重读，保证两者属于同一毫秒
+    do {
+        ms = HAL_GetTick();
+        us = TIMEBASE_TIM->CNT;
+    } while (ms != HAL_GetTick());
+    
+    // 中断被屏蔽时溢出中断可能尚未处理，此时计数值已回到下一毫秒
+    if ((TIMEBASE_TIM->SR & TIM_SR_UIF) && us < 500) {
+        ms++;
+    }
+    return ms * 1000U + us;
+}
+
+void delay_us(uint32_t delay_time) {
+    delay_cycles(delay_time * timebase_cycles_per_us);
+}
@@ -0,0 +1,715 @@
+#include "tlv_schema.h"
+#include "command_list.h"
+#include <string.h>
+
+#define FIELD(tag, type)              { tag, type, 1, NULL }
+#define FIELD_SINCE(tag, type, since) { tag, type, since, NULL }
+#define LIST(tag, children)           { tag, TLV_TYPE_LIST, 1, &children }
+#define LIST_SINCE(tag, children, since) { tag, TLV_TYPE_LIST, since, &children }
+#define SCHEMA(fields)                { fields, sizeof(fields) / sizeof(fields[0]) }
+
+// 报警规则：AL -> IT -> ID/L/H/...
+static const TlvFieldDef alarm_item_fields[] = {
+    [ALARM_ITEM_ID] = FIELD(TAG_ALARM_ID, TLV_TYPE_UINT8),
+    [ALARM_ITEM_L]  = FIELD(TAG_ALARM_LOW, TLV_TYPE_TEMPERATURE),
+    [ALARM_ITEM_H]  = FIELD(TAG_ALARM_HIGH, TLV_TYPE_TEMPERATURE),
+    [ALARM_ITEM_HY] = FIELD_SINCE(TAG_ALARM_HYSTERESIS, TLV_TYPE_TEMPERATURE, 12),
+    [ALARM_ITEM_DL] = FIELD_SINCE(TAG_ALARM_DELAY, TLV_TYPE_UINT16, 12),
+    [ALARM_ITEM_SN] = FIELD_SINCE(TAG_SENSOR, TLV_TYPE_UINT8, 14),
+    [ALARM_ITEM_RT] = FIELD_SINCE(TAG_ALARM_RATE, TLV_TYPE_TEMPERATURE, 14),
+    [ALARM_ITEM_AC] = FIELD_SINCE(TAG_ALARM_ACTIONS, TLV_TYPE_UINT8, 14),
+    [ALARM_ITEM_EN] = FIELD_SINCE(TAG_ALARM_ENABLED, TLV_TYPE_UINT8, 14),
+    [ALARM_ITEM_WS] = FIELD_SINCE(TAG_ALARM_WINDOW, TLV_TYPE_UINT16, 15),
+    [ALARM_ITEM_PH] = FIELD_SINCE(TAG_ALARM_HORIZON, TLV_TYPE_UINT16, 15),
+};
+const TlvSchema tlv_schema_alarm_item = SCHEMA(alarm_item_fields);
+
+static const TlvFieldDef alarm_items_fields[] = {
+    [ALARM_ITEMS_IT] = LIST(TAG_ALARM_ITEM, tlv_schema_alarm_item),
+};
+const TlvSchema tlv_schema_alarm_items = SCHEMA(alarm_items_fields);
+
+static const TlvFieldDef alarm_list_fields[] = {
+    [ALARM_LIST_AL] = LIST(TAG_ALARM_LIST, tlv_schema_alarm_items),
+};
+static const TlvSchema alarm_list_schema = SCHEMA(alarm_list_fields);
+
+// 日志：LG -> IT -> TS/T/MS
+static const TlvFieldDef log_item_fields[] = {
+    FIELD(TAG_TIMESTAMP, TLV_TYPE_UINT64),
+    FIELD(TAG_TEMPERATURE, TLV_TYPE_TEMPERATURE),
+    FIELD_SINCE(TAG_MILLISECOND, TLV_TYPE_UINT16, 21),
+};
+static const TlvSchema log_item_schema = SCHEMA(log_item_fields);
+
+static const TlvFieldDef log_items_fields[] = {
+    LIST(TAG_ALARM_ITEM, log_item_schema),
+};
+static const TlvSchema log_items_schema = SCHEMA(log_items_fields);
+
+// 按桶聚合的日志：BK列表，每项IT为一个桶
+static const TlvFieldDef bucket_item_fields[] = {
+    FIELD(TAG_TIMESTAMP, TLV_TYPE_UINT64),
+    FIELD(TAG_BUCKET_MIN, TLV_TYPE_TEMPERATURE),
+    FIELD(TAG_BUCKET_MAX, TLV_TYPE_TEMPERATURE),
+    FIELD(TAG_BUCKET_MEAN, TLV_TYPE_TEMPERATURE),
+    FIELD(TAG_BUCKET_COUNT, TLV_TYPE_UINT32),
+};
+static const TlvSchema bucket_item_schema = SCHEMA(bucket_item_fields);
+
+static const TlvFieldDef bucket_items_fields[] = {
+    LIST(TAG_ALARM_ITEM, bucket_item_schema),
+};
+static const TlvSchema bucket_items_schema = SCHEMA(bucket_items_fields);
+
+// 按区间返回的日志：IR列表，每项IT为一个区间
+static const TlvFieldDef interval_item_fields[] = {
+    FIELD(TAG_TIME_START, TLV_TYPE_UINT64),
+    FIELD(TAG_TIME_END, TLV_TYPE_UINT64),
+    FIELD(TAG_PEAK, TLV_TYPE_TEMPERATURE),
+    FIELD(TAG_BUCKET_COUNT, TLV_TYPE_UINT32),
+    FIELD(TAG_SENSOR, TLV_TYPE_UINT8),
+    FIELD(TAG_ONGOING, TLV_TYPE_UINT8),
+};
+static const TlvSchema interval_item_schema = SCHEMA(interval_item_fields);
+
+static const TlvFieldDef interval_items_fields[] = {
+    LIST(TAG_ALARM_ITEM, interval_item_schema),
+};
+static const TlvSchema interval_items_schema = SCHEMA(interval_items_fields);
+
+// 传感器状态：SL -> IT -> SN/PR/FC/CF/LS
+static const TlvFieldDef sensor_item_fields[] = {
+    FIELD_SINCE(TAG_SENSOR, TLV_TYPE_UINT8, 6),
+    FIELD_SINCE(TAG_PRESENT, TLV_TYPE_UINT8, 6),
+    FIELD_SINCE(TAG_FAULT_COUNT, TLV_TYPE_UINT32, 6),
+    FIELD_SINCE(TAG_CONSECUTIVE_FAULTS, TLV_TYPE_UINT16, 6),
+    FIELD_SINCE(TAG_LAST_SEEN, TLV_TYPE_UINT32, 6),
+};
+static const TlvSchema sensor_item_schema = SCHEMA(sensor_item_fields);
+
+static const TlvFieldDef sensor_items_fields[] = {
+    LIST(TAG_ALARM_ITEM, sensor_item_schema),
+};
+static const TlvSchema sensor_items_schema = SCHEMA(sensor_items_fields);
+
+static const TlvFieldDef sensor_list_fields[] = {
+    LIST(TAG_SENSOR_LIST, sensor_items_schema),
+};
+static const TlvSchema sensor_list_schema = SCHEMA(sensor_list_fields);
+
+// 下游设备的缓存：GW -> IT -> AD/ST/T/AG/CF
+static const TlvFieldDef gateway_item_fields[] = {
+    FIELD_SINCE(TAG_ADDRESS, TLV_TYPE_UINT8, 33),
+    FIELD_SINCE(TAG_STATUS, TLV_TYPE_UINT8, 33),
+    FIELD_SINCE(TAG_TEMPERATURE, TLV_TYPE_TEMPERATURE, 33),
+    FIELD_SINCE(TAG_SAMPLE_AGE, TLV_TYPE_UINT32, 33),
+    FIELD_SINCE(TAG_CONSECUTIVE_FAULTS, TLV_TYPE_UINT16, 33),
+};
+static const TlvSchema gateway_item_schema = SCHEMA(gateway_item_fields);
+
+static const TlvFieldDef gateway_items_fields[] = {
+    LIST_SINCE(TAG_ALARM_ITEM, gateway_item_schema, 33),
+};
+static const TlvSchema gateway_items_schema = SCHEMA(gateway_items_fields);
+
+static const TlvFieldDef ggwy_response_fields[] = {
+    LIST_SINCE(TAG_GATEWAY_LIST, gateway_items_schema, 33),
+};
+static const TlvSchema ggwy_response = SCHEMA(ggwy_response_fields);
+
+// 各指令的请求DA
+static const TlvFieldDef ping_request_fields[] = {
+    [PING_REQ_TF] = FIELD(TAG_TEMP_FORMAT, TLV_TYPE_UINT8),
+    [PING_REQ_LT] = FIELD_SINCE(TAG_LATENCY, TLV_TYPE_UINT8, 30),
+    [PING_REQ_CB] = FIELD_SINCE(TAG_CAPABILITIES, TLV_TYPE_UINT8, 34),
+    [PING_REQ_CM] = FIELD_SINCE(TAG_COMPACT, TLV_TYPE_UINT8, 36),
+    [PING_REQ_HT] = FIELD_SINCE(TAG_HOST_TIME, TLV_TYPE_UINT64, 53),
+};
+static const TlvSchema ping_request = SCHEMA(ping_request_fields);
+
+static const TlvFieldDef temp_request_fields[] = {
+    [TEMP_REQ_FR] = FIELD_SINCE(TAG_FRESH, TLV_TYPE_UINT8, 2),
+    [TEMP_REQ_SN] = FIELD_SINCE(TAG_SENSOR, TLV_TYPE_UINT8, 4),
+    [TEMP_REQ_MA] = FIELD_SINCE(TAG_MAX_AGE, TLV_TYPE_UINT32, 50),
+};
+static const TlvSchema temp_request = SCHEMA(temp_request_fields);
+
+static const TlvFieldDef rtc_date_fields[] = {
+    [RTC_DATE_YY] = FIELD(TAG_YEAR, TLV_TYPE_UINT8),
+    [RTC_DATE_MM] = FIELD(TAG_MONTH, TLV_TYPE_UINT8),
+    [RTC_DATE_DD] = FIELD(TAG_DAY, TLV_TYPE_UINT8),
+    [RTC_DATE_WK] = FIELD(TAG_WEEKDAY, TLV_TYPE_UINT8),
+};
+static const TlvSchema rtc_date_schema = SCHEMA(rtc_date_fields);
+
+static const TlvFieldDef rtc_time_fields[] = {
+    [RTC_TIME_HH] = FIELD(TAG_HOUR, TLV_TYPE_UINT8),
+    [RTC_TIME_MM] = FIELD(TAG_MINUTE, TLV_TYPE_UINT8),
+    [RTC_TIME_SS] = FIELD(TAG_SECOND, TLV_TYPE_UINT8),
+};
+static const TlvSchema rtc_time_schema = SCHEMA(rtc_time_fields);
+
+// sdtm请求与gdtm响应：Unix时间戳（秒）及毫秒
+static const TlvFieldDef datetime_fields[] = {
+    [DATETIME_TS] = FIELD_SINCE(TAG_TIMESTAMP, TLV_TYPE_UINT64, 20),
+    [DATETIME_MS] = FIELD_SINCE(TAG_MILLISECOND, TLV_TYPE_UINT16, 20),
+};
+static const TlvSchema datetime_schema = SCHEMA(datetime_fields);
+
+// csyn：主机发送时间T0（回显）及要调整的偏差CO，响应带设备的收发时间和校准值
+static const TlvFieldDef csyn_request_fields[] = {
+    [CSYN_REQ_T0] = FIELD_SINCE(TAG_SYNC_ORIGIN, TLV_TYPE_UINT64, 22),
+    [CSYN_REQ_CO] = FIELD_SINCE(TAG_CLOCK_OFFSET, TLV_TYPE_UINT32, 22),
+};
+static const TlvSchema csyn_request = SCHEMA(csyn_request_fields);
+
+static const TlvFieldDef csyn_response_fields[] = {
+    FIELD_SINCE(TAG_SYNC_ORIGIN, TLV_TYPE_UINT64, 22),
+    FIELD_SINCE(TAG_SYNC_RECEIVE, TLV_TYPE_UINT64, 22),
+    FIELD_SINCE(TAG_SYNC_TRANSMIT, TLV_TYPE_UINT64, 22),
+    FIELD_SINCE(TAG_CLOCK_CORRECTION, TLV_TYPE_UINT16, 22),
+};
+static const TlvSchema csyn_response = SCHEMA(csyn_response_fields);
+
+// 任务状态：TK -> IT -> NM/PI/SW，另有堆的HF/HM
+static const TlvFieldDef task_item_fields[] = {
+    FIELD_SINCE(TAG_TASK_NAME, TLV_TYPE_STRING, 23),
+    FIELD_SINCE(TAG_TASK_PRIORITY, TLV_TYPE_UINT8, 23),
+    FIELD_SINCE(TAG_STACK_FREE, TLV_TYPE_UINT16, 23),
+    FIELD_SINCE(TAG_TASK_LOAD, TLV_TYPE_UINT16, 28),
+};
+static const TlvSchema task_item_schema = SCHEMA(task_item_fields);
+
+static const TlvFieldDef task_items_fields[] = {
+    LIST(TAG_ALARM_ITEM, task_item_schema),
+};
+static const TlvSchema task_items_schema = SCHEMA(task_items_fields);
+
+// 内存池：PL -> IT -> NM/BS/BN/BU/BP/BF
+static const TlvFieldDef pool_item_fields[] = {
+    FIELD_SINCE(TAG_TASK_NAME, TLV_TYPE_STRING, 24),
+    FIELD_SINCE(TAG_BLOCK_SIZE, TLV_TYPE_UINT16, 24),
+    FIELD_SINCE(TAG_BLOCK_COUNT, TLV_TYPE_UINT16, 24),
+    FIELD_SINCE(TAG_BLOCK_USED, TLV_TYPE_UINT16, 24),
+    FIELD_SINCE(TAG_BLOCK_PEAK, TLV_TYPE_UINT16, 24),
+    FIELD_SINCE(TAG_BLOCK_FAILURES, TLV_TYPE_UINT32, 24),
+};
+static const TlvSchema pool_item_schema = SCHEMA(pool_item_fields);
+
+static const TlvFieldDef pool_items_fields[] = {
+    LIST(TAG_ALARM_ITEM, pool_item_schema),
+};
+static const TlvSchema pool_items_schema = SCHEMA(pool_items_fields);
+
+static const TlvFieldDef gtsk_response_fields[] = {
+    LIST(TAG_TASK_LIST, task_items_schema),
+    FIELD_SINCE(TAG_HEAP_FREE, TLV_TYPE_UINT32, 23),
+    FIELD_SINCE(TAG_HEAP_MIN, TLV_TYPE_UINT32, 23),
+    LIST_SINCE(TAG_POOL_LIST, pool_items_schema, 24),
+    FIELD_SINCE(TAG_RESET_REASON, TLV_TYPE_UINT8, 25),
+    FIELD_SINCE(TAG_STALLED_TASK, TLV_TYPE_STRING, 25),
+    FIELD_SINCE(TAG_LOAD_WINDOW, TLV_TYPE_UINT32, 28),
+};
+static const TlvSchema gtsk_response = SCHEMA(gtsk_response_fields);
+
+static const TlvFieldDef stat_request_fields[] = {
+    [STAT_REQ_ID] = FIELD_SINCE(TAG_ALARM_ID, TLV_TYPE_UINT8, 26),
+    [STAT_REQ_CL] = FIELD_SINCE(TAG_STATS_CLEAR, TLV_TYPE_UINT8, 26),
+};
+static const TlvSchema stat_request = SCHEMA(stat_request_fields);
+
+// 命令统计：CS -> IT -> ID/NR/QX/QH/TX/TH，另有NX
+static const TlvFieldDef stat_item_fields[] = {
+    FIELD_SINCE(TAG_ALARM_ID, TLV_TYPE_UINT8, 26),
+    FIELD_SINCE(TAG_STATS_COUNT, TLV_TYPE_UINT32, 26),
+    FIELD_SINCE(TAG_QUEUED_MAX, TLV_TYPE_UINT32, 26),
+    FIELD_SINCE(TAG_QUEUED_HIST, TLV_TYPE_RAW, 26),
+    FIELD_SINCE(TAG_TRANSMIT_MAX, TLV_TYPE_UINT32, 26),
+    FIELD_SINCE(TAG_TRANSMIT_HIST, TLV_TYPE_RAW, 26),
+};
+static const TlvSchema stat_item_schema = SCHEMA(stat_item_fields);
+
+static const TlvFieldDef stat_items_fields[] = {
+    LIST(TAG_ALARM_ITEM, stat_item_schema),
+};
+static const TlvSchema stat_items_schema = SCHEMA(stat_items_fields);
+
+static const TlvFieldDef stat_response_fields[] = {
+    LIST_SINCE(TAG_STATS_LIST, stat_items_schema, 26),
+    FIELD_SINCE(TAG_ALARM_NEXT, TLV_TYPE_UINT8, 26),
+    FIELD_SINCE(TAG_SCHED_SAMPLES, TLV_TYPE_UINT32, 49),
+    FIELD_SINCE(TAG_SCHED_MISSED, TLV_TYPE_UINT32, 49),
+    FIELD_SINCE(TAG_SCHED_ERROR_MAX, TLV_TYPE_UINT32, 49),
+    FIELD_SINCE(TAG_SCHED_ERROR_HIST, TLV_TYPE_RAW, 49),
+    FIELD_SINCE(TAG_SCHED_LEAD, TLV_TYPE_UINT32, 49),
+};
+static const TlvSchema stat_response = SCHEMA(stat_response_fields);
+
+static const TlvFieldDef gcom_request_fields[] = {
+    [GCOM_REQ_CL] = FIELD_SINCE(TAG_STATS_CLEAR, TLV_TYPE_UINT8, 27),
+};
+static const TlvSchema gcom_request = SCHEMA(gcom_request_fields);
+
+static const TlvFieldDef gcom_response_fields[] = {
+    FIELD_SINCE(TAG_PACKETS_IN, TLV_TYPE_UINT32, 27),
+    FIELD_SINCE(TAG_PACKETS_OUT, TLV_TYPE_UINT32, 27),
+    FIELD_SINCE(TAG_BYTES_IN, TLV_TYPE_UINT32, 27),
+    FIELD_SINCE(TAG_BYTES_OUT, TLV_TYPE_UINT32, 27),
+    FIELD_SINCE(TAG_CRC_ERRORS, TLV_TYPE_UINT32, 27),
+    FIELD_SINCE(TAG_FORMAT_ERRORS, TLV_TYPE_UINT32, 27),
+    FIELD_SINCE(TAG_UART_ERRORS, TLV_TYPE_UINT32, 27),
+    FIELD_SINCE(TAG_UNSTUFFED, TLV_TYPE_UINT32, 27),
+    FIELD_SINCE(TAG_STUFFED, TLV_TYPE_UINT32, 27),
+    FIELD_SINCE(TAG_RESYNCS, TLV_TYPE_UINT32, 27),
+    FIELD_SINCE(TAG_RING_PEAK, TLV_TYPE_UINT16, 27),
+    FIELD_SINCE(TAG_RING_OVERFLOWS, TLV_TYPE_UINT32, 27),
+    FIELD_SINCE(TAG_TX_QUEUE_PEAK, TLV_TYPE_UINT8, 27),
+    FIELD_SINCE(TAG_TX_DROPPED, TLV_TYPE_UINT32, 27),
+    FIELD_SINCE(TAG_REPLAYED, TLV_TYPE_UINT32, 35),
+    FIELD_SINCE(TAG_RX_DROPPED, TLV_TYPE_UINT32, 27),
+};
+static const TlvSchema gcom_response = SCHEMA(gcom_response_fields);
+
+static const TlvFieldDef gtrc_request_fields[] = {
+    [GTRC_REQ_ID] = FIELD_SINCE(TAG_ALARM_ID, TLV_TYPE_UINT32, 29),
+};
+static const TlvSchema gtrc_request = SCHEMA(gtrc_request_fields);
+
+static const TlvFieldDef gtrc_response_fields[] = {
+    FIELD_SINCE(TAG_TRACE_RECORDS, TLV_TYPE_RAW, 29),
+    FIELD_SINCE(TAG_ALARM_NEXT, TLV_TYPE_UINT32, 29),
+    FIELD_SINCE(TAG_TRACE_LOST, TLV_TYPE_UINT32, 29),
+    FIELD_SINCE(TAG_CYCLES_PER_US, TLV_TYPE_UINT8, 29),
+};
+static const TlvSchema gtrc_response = SCHEMA(gtrc_response_fields);
+
+static const TlvFieldDef bnch_request_fields[] = {
+    [BNCH_REQ_PD] = FIELD_SINCE(TAG_BENCH_PAYLOAD, TLV_TYPE_RAW, 31),
+    [BNCH_REQ_SZ] = FIELD_SINCE(TAG_BENCH_SIZE, TLV_TYPE_UINT16, 31),
+    [BNCH_REQ_CT] = FIELD_SINCE(TAG_BENCH_COUNT, TLV_TYPE_UINT16, 31),
+};
+static const TlvSchema bnch_request = SCHEMA(bnch_request_fields);
+
+static const TlvFieldDef bnch_response_fields[] = {
+    FIELD_SINCE(TAG_SEQUENCE, TLV_TYPE_UINT16, 31),
+    FIELD_SINCE(TAG_BENCH_PAYLOAD, TLV_TYPE_RAW, 31),
+};
+static const TlvSchema bnch_response = SCHEMA(bnch_response_fields);
+
+static const TlvFieldDef glog_request_fields[] = {
+    [GLOG_REQ_T1] = FIELD(TAG_TIME_START, TLV_TYPE_UINT64),
+    [GLOG_REQ_T2] = FIELD(TAG_TIME_END, TLV_TYPE_UINT64),
+    [GLOG_REQ_MX] = FIELD(TAG_MAX_COUNT, TLV_TYPE_UINT16),
+    [GLOG_REQ_CP] = FIELD(TAG_LOG_FORMAT, TLV_TYPE_UINT8),
+    [GLOG_REQ_FG] = FIELD(TAG_FRAGMENTED, TLV_TYPE_UINT8),
+    [GLOG_REQ_WN] = FIELD(TAG_WINDOW, TLV_TYPE_UINT8),
+    [GLOG_REQ_SN] = FIELD_SINCE(TAG_SENSOR, TLV_TYPE_UINT8, 4),
+    [GLOG_REQ_RW] = FIELD_SINCE(TAG_LOG_RAW, TLV_TYPE_UINT8, 5),
+    [GLOG_REQ_BW] = FIELD_SINCE(TAG_BUCKET_WIDTH, TLV_TYPE_UINT32, 8),
+    [GLOG_REQ_CU] = FIELD_SINCE(TAG_LOG_CURSOR, TLV_TYPE_UINT32, 9),
+    [GLOG_REQ_SI] = FIELD_SINCE(TAG_LOG_SINCE, TLV_TYPE_UINT32, 10),
+    [GLOG_REQ_L]  = FIELD_SINCE(TAG_ALARM_LOW, TLV_TYPE_TEMPERATURE, 37),
+    [GLOG_REQ_H]  = FIELD_SINCE(TAG_ALARM_HIGH, TLV_TYPE_TEMPERATURE, 37),
+    [GLOG_REQ_IR] = FIELD_SINCE(TAG_LOG_INTERVALS, TLV_TYPE_UINT8, 38),
+    [GLOG_REQ_AS] = FIELD_SINCE(TAG_ALARM_STATE, TLV_TYPE_UINT8, 38),
+    [GLOG_REQ_AR] = FIELD_SINCE(TAG_ARCHIVE, TLV_TYPE_UINT8, 40),
+    [GLOG_REQ_LA] = FIELD_SINCE(TAG_LOG_LATEST, TLV_TYPE_UINT16, 51),
+};
+static const TlvSchema glog_request = SCHEMA(glog_request_fields);
+
+static const TlvFieldDef baud_request_fields[] = {
+    [BAUD_REQ_BR] = FIELD(TAG_BAUD_RATE, TLV_TYPE_UINT32),
+};
+static const TlvSchema baud_request = SCHEMA(baud_request_fields);
+
+static const TlvFieldDef subscribe_request_fields[] = {
+    [SUBT_IV] = FIELD(TAG_INTERVAL, TLV_TYPE_UINT32),
+    [SUBT_AE] = FIELD_SINCE(TAG_EVENT_PUSH, TLV_TYPE_UINT8, 19),
+    [SUBT_SF] = FIELD_SINCE(TAG_STREAM_ID, TLV_TYPE_UINT8, 52),
+};
+static const TlvSchema subscribe_request = SCHEMA(subscribe_request_fields);
+
+static const TlvFieldDef fack_request_fields[] = {
+    [FACK_REQ_SQ] = FIELD(TAG_SEQUENCE, TLV_TYPE_UINT16),
+    [FACK_REQ_BM] = FIELD(TAG_BITMAP, TLV_TYPE_UINT32),
+};
+static const TlvSchema fack_request = SCHEMA(fack_request_fields);
+
+static const TlvFieldDef sres_fields[] = {
+    [SRES_REQ_RS] = FIELD_SINCE(TAG_RESOLUTION, TLV_TYPE_UINT8, 3),
+};
+static const TlvSchema sres_schema = SCHEMA(sres_fields);
+
+static const TlvFieldDef sflt_fields[] = {
+    [SFLT_FM] = FIELD_SINCE(TAG_FILTER_MODE, TLV_TYPE_UINT8, 5),
+    [SFLT_FN] = FIELD_SINCE(TAG_FILTER_PARAM, TLV_TYPE_UINT8, 5),
+};
+static const TlvSchema sflt_schema = SCHEMA(sflt_fields);
+
+// sled和sbzr的节拍或预置序列、占空比和载波频率
+static const TlvFieldDef pattern_fields[] = {
+    [PATTERN_ON] = FIELD_SINCE(TAG_PATTERN_ON, TLV_TYPE_UINT16, 16),
+    [PATTERN_OF] = FIELD_SINCE(TAG_PATTERN_OFF, TLV_TYPE_UINT16, 16),
+    [PATTERN_RP] = FIELD_SINCE(TAG_PATTERN_REPEAT, TLV_TYPE_UINT16, 16),
+    [PATTERN_PT] = FIELD_SINCE(TAG_PATTERN_SEQUENCE, TLV_TYPE_UINT8, 17),
+    [PATTERN_DU] = FIELD_SINCE(TAG_OUTPUT_DUTY, TLV_TYPE_UINT8, 18),
+    [PATTERN_FQ] = FIELD_SINCE(TAG_OUTPUT_FREQUENCY, TLV_TYPE_UINT16, 18),
+};
+static const TlvSchema pattern_schema = SCHEMA(pattern_fields);
+
+static const TlvFieldDef slog_fields[] = {
+    [SLOG_IV] = FIELD_SINCE(TAG_INTERVAL, TLV_TYPE_UINT32, 7),
+    [SLOG_SN] = FIELD_SINCE(TAG_SENSOR, TLV_TYPE_UINT8, 39),
+    [SLOG_LC] = FIELD_SINCE(TAG_LOG_COMPRESSION, TLV_TYPE_UINT8, 39),
+    [SLOG_TO] = FIELD_SINCE(TAG_TOLERANCE, TLV_TYPE_TEMPERATURE, 39),
+    [SLOG_HB] = FIELD_SINCE(TAG_HEARTBEAT, TLV_TYPE_UINT32, 39),
+};
+static const TlvSchema slog_schema = SCHEMA(slog_fields);
+
+static const TlvFieldDef sadr_fields[] = {
+    [SADR_AD] = FIELD_SINCE(TAG_ADDRESS, TLV_TYPE_UINT8, 32),
+};
+static const TlvSchema sadr_schema = SCHEMA(sadr_fields);
+
+// 网关：sgwy的地址表（每字节一个地址）和轮询间隔，fwrd的目标地址和下游请求/应答的数据部分
+static const TlvFieldDef sgwy_fields[] = {
+    [SGWY_AD] = FIELD_SINCE(TAG_ADDRESS, TLV_TYPE_RAW, 33),
+    [SGWY_IV] = FIELD_SINCE(TAG_INTERVAL, TLV_TYPE_UINT32, 33),
+};
+static const TlvSchema sgwy_schema = SCHEMA(sgwy_fields);
+
+static const TlvFieldDef ggwy_request_fields[] = {
+    [GGWY_REQ_AD] = FIELD_SINCE(TAG_ADDRESS, TLV_TYPE_UINT8, 33),
+};
+static const TlvSchema ggwy_request = SCHEMA(ggwy_request_fields);
+
+static const TlvFieldDef fwrd_fields[] = {
+    [FWRD_AD] = FIELD_SINCE(TAG_ADDRESS, TLV_TYPE_UINT8, 33),
+    [FWRD_DA] = FIELD_SINCE(TAG_DATA, TLV_TYPE_RAW, 33),
+};
+static const TlvSchema fwrd_schema = SCHEMA(fwrd_fields);
+
+static const TlvFieldDef galm_request_fields[] = {
+    [GALM_REQ_ID] = FIELD_SINCE(TAG_ALARM_ID, TLV_TYPE_UINT8, 14),
+};
+static const TlvSchema galm_request = SCHEMA(galm_request_fields);
+
+static const TlvFieldDef gevt_request_fields[] = {
+    [GEVT_REQ_T1] = FIELD_SINCE(TAG_TIME_START, TLV_TYPE_UINT64, 11),
+    [GEVT_REQ_T2] = FIELD_SINCE(TAG_TIME_END, TLV_TYPE_UINT64, 11),
+    [GEVT_REQ_MX] = FIELD_SINCE(TAG_MAX_COUNT, TLV_TYPE_UINT16, 11),
+    [GEVT_REQ_CU] = FIELD_SINCE(TAG_LOG_CURSOR, TLV_TYPE_UINT32, 11),
+    [GEVT_REQ_SI] = FIELD_SINCE(TAG_LOG_SINCE, TLV_TYPE_UINT32, 11),
+};
+static const TlvSchema gevt_request = SCHEMA(gevt_request_fields);
+
+static const TlvFieldDef gbst_request_fields[] = {
+    [GBST_REQ_T1] = FIELD_SINCE(TAG_TIME_START, TLV_TYPE_UINT64, 42),
+    [GBST_REQ_T2] = FIELD_SINCE(TAG_TIME_END, TLV_TYPE_UINT64, 42),
+    [GBST_REQ_MX] = FIELD_SINCE(TAG_MAX_COUNT, TLV_TYPE_UINT16, 42),
+    [GBST_REQ_CU] = FIELD_SINCE(TAG_LOG_CURSOR, TLV_TYPE_UINT32, 42),
+};
+static const TlvSchema gbst_request = SCHEMA(gbst_request_fields);
+
+static const TlvFieldDef fwbg_request_fields[] = {
+    [FWBG_REQ_FS] = FIELD_SINCE(TAG_FW_SIZE, TLV_TYPE_UINT32, 43),
+    [FWBG_REQ_CK] = FIELD_SINCE(TAG_FW_CRC, TLV_TYPE_UINT32, 43),
+    [FWBG_REQ_FP] = FIELD_SINCE(TAG_FW_PATCH, TLV_TYPE_UINT32, 45),
+    [FWBG_REQ_OL] = FIELD_SINCE(TAG_FW_BASE_SIZE, TLV_TYPE_UINT32, 45),
+    [FWBG_REQ_OC] = FIELD_SINCE(TAG_FW_BASE_CRC, TLV_TYPE_UINT32, 45),
+};
+static const TlvSchema fwbg_request = SCHEMA(fwbg_request_fields);
+
+static const TlvFieldDef fwch_request_fields[] = {
+    [FWCH_REQ_FO] = FIELD_SINCE(TAG_FW_OFFSET, TLV_TYPE_UINT32, 43),
+    [FWCH_REQ_FD] = FIELD_SINCE(TAG_FW_DATA, TLV_TYPE_RAW, 43),
+    [FWCH_REQ_CK] = FIELD_SINCE(TAG_FW_CRC, TLV_TYPE_UINT32, 43),
+};
+static const TlvSchema fwch_request = SCHEMA(fwch_request_fields);
+
+// 各指令的响应DA
+// galm响应另带AW（报警检查的最长耗时）和NX（分页）
+static const TlvFieldDef galm_response_fields[] = {
+    LIST(TAG_ALARM_LIST, tlv_schema_alarm_items),
+    FIELD_SINCE(TAG_ALARM_LATENCY, TLV_TYPE_UINT32, 13),
+    FIELD_SINCE(TAG_ALARM_NEXT, TLV_TYPE_UINT8, 14),
+};
+static const TlvSchema galm_response = SCHEMA(galm_response_fields);
+
+// ping的能力列表：PV支持的包头版本（每字节一个），BR可协商的波特率（uint32小端数组）
+static const TlvFieldDef capability_fields[] = {
+    FIELD_SINCE(TAG_PROTOCOL_VERSIONS, TLV_TYPE_RAW, 34),
+    FIELD_SINCE(TAG_MAX_PACKET, TLV_TYPE_UINT16, 34),
+    FIELD_SINCE(TAG_OPCODE_MAX, TLV_TYPE_UINT8, 34),
+    FIELD_SINCE(TAG_LOG_FORMATS, TLV_TYPE_RAW, 34),
+    FIELD_SINCE(TAG_PUSH_MODES, TLV_TYPE_UINT8, 34),
+    FIELD_SINCE(TAG_BAUD_RATE, TLV_TYPE_RAW, 34),
+    FIELD_SINCE(TAG_FEATURES, TLV_TYPE_UINT8, 34),
+};
+static const TlvSchema capability_schema = SCHEMA(capability_fields);
+
+static const TlvFieldDef ping_response_fields[] = {
+    [PING_RSP_TF] = FIELD(TAG_TEMP_FORMAT, TLV_TYPE_UINT8),
+    [PING_RSP_SV] = FIELD(TAG_SCHEMA_VERSION, TLV_TYPE_UINT8),
+    [PING_RSP_SC] = FIELD_SINCE(TAG_SENSOR_COUNT, TLV_TYPE_UINT8, 4),
+    [PING_RSP_LT] = FIELD_SINCE(TAG_LATENCY, TLV_TYPE_RAW, 30),
+    [PING_RSP_CB] = LIST_SINCE(TAG_CAPABILITIES, capability_schema, 34),
+    [PING_RSP_CM] = FIELD_SINCE(TAG_COMPACT, TLV_TYPE_UINT8, 36),
+    [PING_RSP_HT] = FIELD_SINCE(TAG_HOST_TIME, TLV_TYPE_UINT64, 53),
+    [PING_RSP_RX] = FIELD_SINCE(TAG_DEVICE_RX, TLV_TYPE_UINT32, 53),
+    [PING_RSP_TT] = FIELD_SINCE(TAG_DEVICE_TX, TLV_TYPE_UINT32, 53),
+};
+static const TlvSchema ping_response = SCHEMA(ping_response_fields);
+
+// temp响应带AG、SN和TR，推送帧另带TS、AM和AX
+static const TlvFieldDef temp_response_fields[] = {
+    FIELD(TAG_TEMPERATURE, TLV_TYPE_TEMPERATURE),
+    FIELD(TAG_TIMESTAMP, TLV_TYPE_UINT64),
+    FIELD(TAG_ALARM_MASK, TLV_TYPE_UINT8),
+    FIELD_SINCE(TAG_SAMPLE_AGE, TLV_TYPE_UINT32, 2),
+    FIELD_SINCE(TAG_SENSOR, TLV_TYPE_UINT8, 4),
+    FIELD_SINCE(TAG_RAW_TEMPERATURE, TLV_TYPE_TEMPERATURE, 5),
+    FIELD_SINCE(TAG_ALARM_MASK_ALL, TLV_TYPE_UINT32, 14),
+};
+static const TlvSchema temp_response = SCHEMA(temp_response_fields);
+
+static const TlvFieldDef glog_response_fields[] = {
+    FIELD(TAG_SEQUENCE, TLV_TYPE_UINT16),
+    FIELD(TAG_MORE_FRAGMENTS, TLV_TYPE_UINT8),
+    LIST(TAG_LOG_LIST, log_items_schema),
+    FIELD(TAG_LOG_COMPRESSED, TLV_TYPE_RAW),
+    { TAG_BUCKET_LIST, TLV_TYPE_LIST, 8, &bucket_items_schema },
+    FIELD_SINCE(TAG_LOG_CURSOR, TLV_TYPE_UINT32, 9),
+    FIELD_SINCE(TAG_LOG_LAST, TLV_TYPE_UINT32, 10),
+    LIST_SINCE(TAG_LOG_INTERVALS, interval_items_schema, 38),
+    FIELD_SINCE(TAG_LOG_PACKED, TLV_TYPE_RAW, 41),
+};
+static const TlvSchema glog_response = SCHEMA(glog_response_fields);
+
+static const TlvFieldDef event_item_fields[] = {
+    FIELD(TAG_TIMESTAMP, TLV_TYPE_UINT64),
+    FIELD(TAG_ALARM_ID, TLV_TYPE_UINT8),
+    FIELD(TAG_EVENT_TYPE, TLV_TYPE_UINT8),
+    FIELD(TAG_SENSOR, TLV_TYPE_UINT8),
+    FIELD(TAG_TEMPERATURE, TLV_TYPE_TEMPERATURE),
+    FIELD_SINCE(TAG_MILLISECOND, TLV_TYPE_UINT16, 21),
+};
+static const TlvSchema event_item_schema = SCHEMA(event_item_fields);
+
+static const TlvFieldDef event_items_fields[] = {
+    LIST(TAG_ALARM_ITEM, event_item_schema),
+};
+static const TlvSchema event_items_schema = SCHEMA(event_items_fields);
+
+// 报警事件推送帧的DA与gevt响应相同，另带AX
+static const TlvFieldDef gevt_response_fields[] = {
+    { TAG_EVENT_LIST, TLV_TYPE_LIST, 11, &event_items_schema },
+    FIELD_SINCE(TAG_LOG_CURSOR, TLV_TYPE_UINT32, 11),
+    FIELD_SINCE(TAG_LOG_LAST, TLV_TYPE_UINT32, 11),
+    FIELD_SINCE(TAG_ALARM_MASK_ALL, TLV_TYPE_UINT32, 19),
+};
+static const TlvSchema gevt_response = SCHEMA(gevt_response_fields);
+
+// 报警前后记录：BL -> IT -> TS/MS/ID/ET/SN/PB/BT，BT为逐秒温度（int16小端数组，0.1°C）
+static const TlvFieldDef burst_item_fields[] = {
+    FIELD_SINCE(TAG_TIMESTAMP, TLV_TYPE_UINT64, 42),
+    FIELD_SINCE(TAG_MILLISECOND, TLV_TYPE_UINT16, 42),
+    FIELD_SINCE(TAG_ALARM_ID, TLV_TYPE_UINT8, 42),
+    FIELD_SINCE(TAG_EVENT_TYPE, TLV_TYPE_UINT8, 42),
+    FIELD_SINCE(TAG_SENSOR, TLV_TYPE_UINT8, 42),
+    FIELD_SINCE(TAG_BURST_PRE, TLV_TYPE_UINT8, 42),
+    FIELD_SINCE(TAG_BURST_SAMPLES, TLV_TYPE_RAW, 42),
+};
+static const TlvSchema burst_item_schema = SCHEMA(burst_item_fields);
+
+static const TlvFieldDef burst_items_fields[] = {
+    LIST_SINCE(TAG_ALARM_ITEM, burst_item_schema, 42),
+};
+static const TlvSchema burst_items_schema = SCHEMA(burst_items_fields);
+
+static const TlvFieldDef gbst_response_fields[] = {
+    LIST_SINCE(TAG_BURST_LIST, burst_items_schema, 42),
+    FIELD_SINCE(TAG_LOG_CURSOR, TLV_TYPE_UINT32, 42),
+};
+static const TlvSchema gbst_response = SCHEMA(gbst_response_fields);
+
+// fwbg响应另带SZ（一块的最大字节数），A/B程序槽时带FA/FB
+static const TlvFieldDef fwbg_response_fields[] = {
+    FIELD_SINCE(TAG_FW_OFFSET, TLV_TYPE_UINT32, 43),
+    FIELD_SINCE(TAG_BENCH_SIZE, TLV_TYPE_UINT16, 43),
+    FIELD_SINCE(TAG_FW_SLOT, TLV_TYPE_UINT8, 44),
+    FIELD_SINCE(TAG_FW_ROLLED_BACK, TLV_TYPE_UINT8, 44),
+};
+static const TlvSchema fwbg_response = SCHEMA(fwbg_response_fields);
+
+static const TlvFieldDef fwch_response_fields[] = {
+    FIELD_SINCE(TAG_FW_OFFSET, TLV_TYPE_UINT32, 43),
+};
+static const TlvSchema fwch_response = SCHEMA(fwch_response_fields);
+
+static const TlvFieldDef fwvf_response_fields[] = {
+    FIELD_SINCE(TAG_FW_CRC, TLV_TYPE_UINT32, 43),
+};
+static const TlvSchema fwvf_response = SCHEMA(fwvf_response_fields);
+
+// 传感器校准：KP为校准点（每点4字节：读数、参考温度，均为int16小端，0.1°C）
+static const TlvFieldDef scal_fields[] = {
+    [SCAL_SN] = FIELD_SINCE(TAG_SENSOR, TLV_TYPE_UINT8, 46),
+    [SCAL_KP] = FIELD_SINCE(TAG_CALIB_POINTS, TLV_TYPE_RAW, 46),
+};
+static const TlvSchema scal_schema = SCHEMA(scal_fields);
+
+// 运行统计：WN选择窗口，AT设置超限阈值，CL清零
+static const TlvFieldDef tsta_request_fields[] = {
+    [TSTA_REQ_SN] = FIELD_SINCE(TAG_SENSOR, TLV_TYPE_UINT8, 47),
+    [TSTA_REQ_WN] = FIELD_SINCE(TAG_WINDOW, TLV_TYPE_UINT8, 47),
+    [TSTA_REQ_AT] = FIELD_SINCE(TAG_ABOVE_THRESHOLD, TLV_TYPE_TEMPERATURE, 47),
+    [TSTA_REQ_CL] = FIELD_SINCE(TAG_STATS_CLEAR, TLV_TYPE_UINT8, 47),
+};
+static const TlvSchema tsta_request = SCHEMA(tsta_request_fields);
+
+static const TlvFieldDef tsta_response_fields[] = {
+    FIELD_SINCE(TAG_SENSOR, TLV_TYPE_UINT8, 47),
+    FIELD_SINCE(TAG_WINDOW, TLV_TYPE_UINT8, 47),
+    FIELD_SINCE(TAG_BUCKET_COUNT, TLV_TYPE_UINT32, 47),
+    FIELD_SINCE(TAG_BUCKET_MIN, TLV_TYPE_TEMPERATURE, 47),
+    FIELD_SINCE(TAG_BUCKET_MAX, TLV_TYPE_TEMPERATURE, 47),
+    FIELD_SINCE(TAG_BUCKET_MEAN, TLV_TYPE_TEMPERATURE, 47),
+    FIELD_SINCE(TAG_STATS_VARIANCE, TLV_TYPE_UINT32, 47),
+    FIELD_SINCE(TAG_ABOVE_TIME, TLV_TYPE_UINT32, 47),
+    FIELD_SINCE(TAG_ABOVE_THRESHOLD, TLV_TYPE_TEMPERATURE, 47),
+};
+static const TlvSchema tsta_response = SCHEMA(tsta_response_fields);
+
+// 所有传感器的读数：TP为每个传感器8字节的定长记录（command_handler.c）
+static const TlvFieldDef tall_response_fields[] = {
+    FIELD_SINCE(TAG_SAMPLE_AGE, TLV_TYPE_UINT32, 48),
+    FIELD_SINCE(TAG_SENSOR_COUNT, TLV_TYPE_UINT8, 48),
+    FIELD_SINCE(TAG_TEMP_PACKED, TLV_TYPE_RAW, 48),
+};
+static const TlvSchema tall_response = SCHEMA(tall_response_fields);
+
+// 按指令编号索引，由command_list.h展开
+#define REQUEST_SCHEMA_ENTRY(op, name, handler, cls, request, response)  [op] = request,
+#define RESPONSE_SCHEMA_ENTRY(op, name, handler, cls, request, response) [op] = response,
+
+static const TlvSchema *const request_schemas[] = {
+    COMMAND_LIST(REQUEST_SCHEMA_ENTRY)
+};
+
+static const TlvSchema *const response_schemas[] = {
+    COMMAND_LIST(RESPONSE_SCHEMA_ENTRY)
+};
+
+_Static_assert(sizeof(glog_request_fields) / sizeof(TlvFieldDef) <= TLV_SCHEMA_MAX_FIELDS,
+               "字段表超过TLV_SCHEMA_MAX_FIELDS");
+
+const TlvSchema *tlv_schema_request(uint8_t opcode) {
+    if (opcode >= sizeof(request_schemas) / sizeof(request_schemas[0])) {
+        return NULL;
+    }
+    return request_schemas[opcode];
+}
+
+const TlvSchema *tlv_schema_response(uint8_t opcode) {
+    if (opcode >= sizeof(response_schemas) / sizeof(response_schemas[0])) {
+        return NULL;
+    }
+    return response_schemas[opcode];
+}
+
+int tlv_schema_find(const TlvSchema *schema, const char *tag) {
+    for (uint8_t i = 0; i < schema->count; i++) {
+        if (memcmp(schema->fields[i].tag, tag, 2) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 类型是否允许该长度
+static bool length_matches(uint8_t type, uint16_t length) {
+    switch (type) {
+    case TLV_TYPE_UINT8:       return length == 1;
+    case TLV_TYPE_UINT16:      return length == 2;
+    case TLV_TYPE_UINT32:
+    case TLV_TYPE_FLOAT32:     return length == 4;
+    case TLV_TYPE_UINT64:      return length == 8;
+    case TLV_TYPE_TEMPERATURE: return length == 2 || length == 4;
+    default:                   return true;
+    }
+}
+
+int tlv_schema_bind(const TlvSchema *schema, const uint8_t *buffer, size_t buffer_size,
+                    TlvBinding *binding) {
+    binding->schema = schema;
+    binding->buffer = buffer;
+    binding->present = 0;
+
+    int bound = 0;
+    size_t offset = 0;
+    while (offset < buffer_size) {
+        if (offset + 4 > buffer_size) {
+            return -1;
+        }
+        uint16_t length;
+        memcpy(&length, buffer + offset + 2, 2);
+        if (offset + 4 + length > buffer_size) {
+            return -1;
+        }
+
+        int index = tlv_schema_find(schema, (const char *)buffer + offset);
+        if (index >= 0 && !tlv_binding_has(binding, (uint8_t)index)) {
+            if (!length_matches(schema->fields[index].type, length)) {
+                return -1;
+            }
+            binding->offset[index] = (uint16_t)(offset + 4);
+            binding->length[index] = length;
+            binding->present |= 1UL << index;
+            bound++;
+        }
+        offset += 4 + length; // 未定义的标签直接跳过
+    }
+    return bound;
+}
+
+static int get_fixed(const TlvBinding *binding, uint8_t index, void *value, uint16_t size) {
+    if (!tlv_binding_has(binding, index) || binding->length[index] != size) {
+        return -1;
+    }
+    memcpy(value, binding->buffer + binding->offset[index], size);
+    return 1;
+}
+
+int tlv_binding_get_uint8(const TlvBinding *binding, uint8_t index, uint8_t *value) {
+    return get_fixed(binding, index, value, sizeof(*value));
+}
+
+int tlv_binding_get_uint16(const TlvBinding *binding, uint8_t index, uint16_t *value) {
+    return get_fixed(binding, index, value, sizeof(*value));
+}
+
+int tlv_binding_get_uint32(const TlvBinding *binding, uint8_t index, uint32_t *value) {
+    return get_fixed(binding, index, value, sizeof(*value));
+}
+
+int tlv_binding_get_uint64(const TlvBinding *binding, uint8_t index, uint64_t *value) {
+    return get_fixed(binding, index, value, sizeof(*value));
+}
+
+int tlv_binding_get_temperature(const TlvBinding *binding, uint8_t index, int16_t *value) {
+    if (!tlv_binding_has(binding, index)) {
+        return -1;
+    }
+    return tlv_decode_temperature(binding->buffer + binding->offset[index], binding->length[index], value);
+}
+
+int tlv_binding_get_view(const TlvBinding *binding, uint8_t index, const uint8_t **value, uint16_t *length) {
+    if (!tlv_binding_has(binding, index)) {
+        return -1;
+    }
+    *value = binding->buffer + binding->offset[index];
+    *length = binding->length[index];
+    return binding->length[index];
+}
@@ -0,0 +1,37 @@
+#include "trace.h"
+#include <string.h>
+
+TraceRecord trace_ring[TRACE_RECORDS];
+uint32_t trace_head = 0;
+
+uint32_t trace_oldest(void) {
+    uint32_t head = trace_head;
+    return head > TRACE_RECORDS ? head - TRACE_RECORDS : 0;
+}
+
+uint16_t trace_read(uint32_t *sequence, uint8_t *out, uint16_t max_records, uint32_t *lost) {
+    uint16_t count = 0;
+    while (count < max_records) {
+        // 逐条在屏蔽中断时取出，读出期间写入的记录不会被读成一半
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        uint32_t head = trace_head;
+        uint32_t oldest = head > TRACE_RECORDS ? head - TRACE_RECORDS : 0;
+        uint32_t next = *sequence;
+        if ((int32_t)(next - oldest) < 0) {
+            *lost += oldest - next;
+            next = oldest;
+        } else if ((int32_t)(next - head) > 0) {
+            next = oldest;
+        }
+        if (next == head) {
+            __set_PRIMASK(primask);
+            break;
+        }
+        memcpy(out + count * sizeof(TraceRecord), &trace_ring[next & (TRACE_RECORDS - 1)], sizeof(TraceRecord));
+        __set_PRIMASK(primask);
+        *sequence = next + 1;
+        count++;
+    }
+    return count;
+}
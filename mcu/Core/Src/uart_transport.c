@@ -0,0 +1,319 @@
+#include "uart_transport.h"
+#include "ramfunc.h"
+#include "main.h"
+#include "stm32f1xx_ll_usart.h"
+#include "stm32f1xx_ll_dma.h"
+
+#if COMM_WIRED_LINK && COMM_GATEWAY
+#error "UART4不能同时作为有线链路和网关的下游总线，网关角色中设置COMM_WIRED_LINK=0"
+#endif
+
+// 16倍过采样时USARTDIV不能小于1
+#define UART_MIN_DIVIDER 16U
+
+// DMA中断标志：每个通道占ISR/IFCR中的4位（GIF、TCIF、HTIF、TEIF）
+#define DMA_FLAG_SHIFT(channel) (((channel) - 1U) * 4U)
+#define DMA_FLAG_GI(channel)    (DMA_ISR_GIF1 << DMA_FLAG_SHIFT(channel))
+#define DMA_FLAG_TC(channel)    (DMA_ISR_TCIF1 << DMA_FLAG_SHIFT(channel))
+#define DMA_FLAG_HT(channel)    (DMA_ISR_HTIF1 << DMA_FLAG_SHIFT(channel))
+#define DMA_FLAG_TE(channel)    (DMA_ISR_TEIF1 << DMA_FLAG_SHIFT(channel))
+
+struct UartPort {
+    USART_TypeDef *usart;
+    DMA_TypeDef *dma;
+    uint32_t rx_channel; // LL_DMA_CHANNEL_x
+    uint32_t tx_channel;
+    bool apb2;           // USART1挂在APB2，其余在APB1
+    uint8_t link;        // COMM_LINK_*
+    uint16_t rx_size;
+    uint32_t baud_rate;  // 当前波特率，系统时钟改变时重新计算分频（clock_scale.h）
+    GPIO_TypeDef *de_port; // RS-485收发器的DE/RE（高电平发送），NULL为全双工
+    uint16_t de_pin;
+};
+
+UartPort uart_ble_port = {
+    .usart = USART1,
+    .dma = DMA1,
+    .rx_channel = LL_DMA_CHANNEL_5,
+    .tx_channel = LL_DMA_CHANNEL_4,
+    .apb2 = true,
+    .link = COMM_LINK_BLE,
+    .baud_rate = COMM_DEFAULT_BAUD_RATE, // MX_USART1_UART_Init()的设置
+};
+
+#if UART_WIRED_PORT
+UartPort uart_wired_port = {
+    .usart = UART4,
+    .dma = DMA2,
+    .rx_channel = LL_DMA_CHANNEL_3,
+    .tx_channel = LL_DMA_CHANNEL_5,
+    .apb2 = false,
+    .link = COMM_GATEWAY ? COMM_LINK_BUS : COMM_LINK_WIRED,
+    .de_port = GPIOC,
+    .de_pin = GPIO_PIN_12,
+};
+#endif
+
+void uart_transport_wired_init(void) {
+#if UART_WIRED_PORT
+    __HAL_RCC_UART4_CLK_ENABLE();
+    __HAL_RCC_GPIOC_CLK_ENABLE();
+    __HAL_RCC_DMA2_CLK_ENABLE();
+
+    // PC10 TX复用推挽，PC11 RX上拉输入（未接线或收发器发送、RO高阻时保持空闲电平），
+    // PC12为RS-485收发器的DE/RE，低电平接收
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    GPIO_InitStruct.Pin = GPIO_PIN_10;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
+    GPIO_InitStruct.Pin = GPIO_PIN_11;
+    GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
+    GPIOC->BRR = GPIO_PIN_12;
+    GPIO_InitStruct.Pin = GPIO_PIN_12;
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
+
+    LL_USART_Disable(UART4);
+    LL_USART_SetTransferDirection(UART4, LL_USART_DIRECTION_TX_RX);
+    LL_USART_ConfigCharacter(UART4, LL_USART_DATAWIDTH_8B, LL_USART_PARITY_NONE, LL_USART_STOPBITS_1);
+    uart_transport_set_baud(&uart_wired_port, COMM_DEFAULT_BAUD_RATE);
+
+    HAL_NVIC_SetPriority(UART4_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(UART4_IRQn);
+    HAL_NVIC_SetPriority(DMA2_Channel3_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Channel3_IRQn);
+    HAL_NVIC_SetPriority(DMA2_Channel4_5_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Channel4_5_IRQn);
+#endif
+}
+
+bool uart_transport_set_baud(UartPort *port, uint32_t baud_rate) {
+    uint32_t clock = port->apb2 ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+    if (baud_rate == 0 || clock / baud_rate < UART_MIN_DIVIDER) {
+        return false;
+    }
+    LL_USART_Disable(port->usart);
+    port->usart->BRR = (uint16_t)__LL_USART_DIV_SAMPLING16(clock, baud_rate);
+    LL_USART_Enable(port->usart);
+    port->baud_rate = baud_rate;
+    return true;
+}
+
+// 只改分频，不停止USART和DMA：调用方保证线路空闲，接收缓冲中的数据不受影响
+void uart_transport_clock_changed(void) {
+    UartPort *ports[] = {
+        &uart_ble_port,
+#if UART_WIRED_PORT
+        &uart_wired_port,
+#endif
+    };
+    for (uint8_t i = 0; i < sizeof(ports) / sizeof(ports[0]); i++) {
+        UartPort *port = ports[i];
+        if (port->baud_rate != 0) {
+            uint32_t clock = port->apb2 ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+            port->usart->BRR = (uint16_t)__LL_USART_DIV_SAMPLING16(clock, port->baud_rate);
+        }
+    }
+}
+
+void uart_transport_start_rx(UartPort *port, uint8_t *buffer, uint16_t size) {
+    USART_TypeDef *usart = port->usart;
+    uart_transport_stop_rx(port);
+    port->rx_size = size;
+
+    // 清除残留的接收数据和错误标志（先读SR再读DR）
+    (void)usart->SR;
+    (void)usart->DR;
+
+    LL_DMA_ConfigTransfer(port->dma, port->rx_channel,
+                          LL_DMA_DIRECTION_PERIPH_TO_MEMORY | LL_DMA_MODE_CIRCULAR |
+                          LL_DMA_PERIPH_NOINCREMENT | LL_DMA_MEMORY_INCREMENT |
+                          LL_DMA_PDATAALIGN_BYTE | LL_DMA_MDATAALIGN_BYTE | LL_DMA_PRIORITY_LOW);
+    LL_DMA_SetPeriphAddress(port->dma, port->rx_channel, (uint32_t)&usart->DR);
+    LL_DMA_SetMemoryAddress(port->dma, port->rx_channel, (uint32_t)buffer);
+    LL_DMA_SetDataLength(port->dma, port->rx_channel, size);
+    port->dma->IFCR = DMA_FLAG_GI(port->rx_channel);
+    LL_DMA_EnableIT_HT(port->dma, port->rx_channel);
+    LL_DMA_EnableIT_TC(port->dma, port->rx_channel);
+    LL_DMA_EnableIT_TE(port->dma, port->rx_channel);
+    LL_DMA_EnableChannel(port->dma, port->rx_channel);
+
+    LL_USART_EnableDMAReq_RX(usart);
+    LL_USART_EnableIT_IDLE(usart);
+    LL_USART_EnableIT_ERROR(usart); // DMA接收时FE/NE/ORE由EIE产生中断
+    LL_USART_EnableIT_PE(usart);
+}
+
+void uart_transport_stop_rx(UartPort *port) {
+    LL_USART_DisableIT_IDLE(port->usart);
+    LL_USART_DisableIT_ERROR(port->usart);
+    LL_USART_DisableIT_PE(port->usart);
+    LL_USART_DisableDMAReq_RX(port->usart);
+    LL_DMA_DisableChannel(port->dma, port->rx_channel);
+    LL_DMA_DisableIT_HT(port->dma, port->rx_channel);
+    LL_DMA_DisableIT_TC(port->dma, port->rx_channel);
+    LL_DMA_DisableIT_TE(port->dma, port->rx_channel);
+    port->dma->IFCR = DMA_FLAG_GI(port->rx_channel);
+}
+
+uint16_t uart_transport_rx_position(UartPort *port) {
+    return (uint16_t)(port->rx_size - LL_DMA_GetDataLength(port->dma, port->rx_channel));
+}
+
+bool uart_transport_send(UartPort *port, const uint8_t *data, uint16_t length) {
+    USART_TypeDef *usart = port->usart;
+    if (length == 0 || LL_DMA_IsEnabledChannel(port->dma, port->tx_channel) || LL_USART_IsEnabledIT_TC(usart)) {
+        return false;
+    }
+
+    LL_DMA_ConfigTransfer(port->dma, port->tx_channel,
+                          LL_DMA_DIRECTION_MEMORY_TO_PERIPH | LL_DMA_MODE_NORMAL |
+                          LL_DMA_PERIPH_NOINCREMENT | LL_DMA_MEMORY_INCREMENT |
+                          LL_DMA_PDATAALIGN_BYTE | LL_DMA_MDATAALIGN_BYTE | LL_DMA_PRIORITY_LOW);
+    LL_DMA_SetPeriphAddress(port->dma, port->tx_channel, (uint32_t)&usart->DR);
+    LL_DMA_SetMemoryAddress(port->dma, port->tx_channel, (uint32_t)data);
+    LL_DMA_SetDataLength(port->dma, port->tx_channel, length);
+    port->dma->IFCR = DMA_FLAG_GI(port->tx_channel);
+    LL_DMA_EnableIT_TC(port->dma, port->tx_channel);
+    LL_DMA_EnableIT_TE(port->dma, port->tx_channel);
+
+    LL_USART_ClearFlag_TC(usart);
+    if (port->de_port != NULL) {
+        port->de_port->BSRR = port->de_pin; // 先打开驱动器，第一个起始位前总线已由本机驱动
+    }
+    LL_DMA_EnableChannel(port->dma, port->tx_channel);
+    LL_USART_EnableDMAReq_TX(usart);
+    return true;
+}
+
+// 空闲线和错误标志都由先读SR再读DR清除，DR中的数据已由DMA取走
+RAMFUNC void uart_transport_irq_handler(UartPort *port) {
+    USART_TypeDef *usart = port->usart;
+    uint32_t status = usart->SR;
+
+    if ((status & (USART_SR_PE | USART_SR_FE | USART_SR_NE | USART_SR_ORE)) != 0) {
+        (void)usart->DR;
+        communication_error_callback(port->link, false);
+    }
+
+    if ((status & USART_SR_IDLE) != 0 && LL_USART_IsEnabledIT_IDLE(usart)) {
+        (void)usart->DR;
+        communication_rx_event_callback(port->link, uart_transport_rx_position(port));
+    }
+
+    if ((status & USART_SR_TC) != 0 && LL_USART_IsEnabledIT_TC(usart)) {
+        LL_USART_DisableIT_TC(usart);
+        // 最后一个停止位已移出：立即释放总线，主机的下一帧不会与本机的驱动器冲突
+        if (port->de_port != NULL) {
+            port->de_port->BRR = port->de_pin;
+        }
+        communication_tx_complete_callback(port->link);
+    }
+}
+
+RAMFUNC void uart_transport_rx_dma_irq_handler(UartPort *port) {
+    uint32_t status = port->dma->ISR;
+    if ((status & DMA_FLAG_TE(port->rx_channel)) != 0) {
+        port->dma->IFCR = DMA_FLAG_GI(port->rx_channel); // 通道已被硬件关闭
+        communication_error_callback(port->link, true);
+        return;
+    }
+    if ((status & (DMA_FLAG_HT(port->rx_channel) | DMA_FLAG_TC(port->rx_channel))) != 0) {
+        port->dma->IFCR = DMA_FLAG_HT(port->rx_channel) | DMA_FLAG_TC(port->rx_channel);
+        communication_rx_event_callback(port->link, uart_transport_rx_position(port));
+    }
+}
+
+// DMA写完最后一个字节后等USART TC，确认字节已全部移出再通知完成（之后才能切换波特率）；
+// 传输错误时同样结束本帧，剩余部分由主机按超时处理
+RAMFUNC void uart_transport_tx_dma_irq_handler(UartPort *port) {
+    if ((port->dma->ISR & (DMA_FLAG_TC(port->tx_channel) | DMA_FLAG_TE(port->tx_channel))) != 0) {
+        port->dma->IFCR = DMA_FLAG_GI(port->tx_channel);
+        LL_DMA_DisableChannel(port->dma, port->tx_channel);
+        LL_USART_DisableDMAReq_TX(port->usart);
+        LL_USART_EnableIT_TC(port->usart);
+    }
+}
+
+// CommTransportOps适配：context为UartPort*
+static void ops_start_rx(void *context, uint8_t *buffer, uint16_t size) {
+    uart_transport_start_rx((UartPort *)context, buffer, size);
+}
+
+static void ops_stop_rx(void *context) {
+    uart_transport_stop_rx((UartPort *)context);
+}
+
+static uint16_t ops_rx_position(void *context) {
+    return uart_transport_rx_position((UartPort *)context);
+}
+
+static bool ops_send(void *context, const uint8_t *data, uint16_t length) {
+    return uart_transport_send((UartPort *)context, data, length);
+}
+
+static bool ops_set_baud(void *context, uint32_t baud_rate) {
+    return uart_transport_set_baud((UartPort *)context, baud_rate);
+}
+
+const CommTransportOps uart_transport_ops = {
+    .start_rx = ops_start_rx,
+    .stop_rx = ops_stop_rx,
+    .rx_position = ops_rx_position,
+    .send = ops_send,
+    .set_baud = ops_set_baud,
+};
+
+// BLE模块配置：轮询收发，不使用DMA和中断
+static bool module_set_baud(void *context, uint32_t baud_rate) {
+    return uart_transport_set_baud((UartPort *)context, baud_rate);
+}
+
+static void module_send(void *context, const uint8_t *data, uint16_t length) {
+    USART_TypeDef *usart = ((UartPort *)context)->usart;
+    for (uint16_t i = 0; i < length; i++) {
+        while (!LL_USART_IsActiveFlag_TXE(usart)) {
+        }
+        LL_USART_TransmitData8(usart, data[i]);
+    }
+    while (!LL_USART_IsActiveFlag_TC(usart)) {
+    }
+    // 清除发送期间收到的残留字节和溢出标志（先读SR再读DR）
+    (void)usart->SR;
+    (void)usart->DR;
+}
+
+static uint16_t module_receive(void *context, uint8_t *buffer, uint16_t size, uint32_t first_ms, uint32_t gap_ms) {
+    USART_TypeDef *usart = ((UartPort *)context)->usart;
+    uint16_t length = 0;
+    uint32_t last = HAL_GetTick();
+    while (HAL_GetTick() - last < (length == 0 ? first_ms : gap_ms)) {
+        uint32_t status = usart->SR;
+        if ((status & USART_SR_RXNE) != 0) {
+            uint8_t byte = (uint8_t)usart->DR;
+            if (length < size) {
+                buffer[length++] = byte;
+            }
+            last = HAL_GetTick();
+        } else if ((status & USART_SR_ORE) != 0) {
+            (void)usart->DR;
+        }
+    }
+    return length;
+}
+
+static const BleModulePort ble_module_port = {
+    .set_baud = module_set_baud,
+    .send = module_send,
+    .receive = module_receive,
+    .context = &uart_ble_port,
+};
+
+const BleModulePort *uart_transport_ble_module_port(void) {
+    return &ble_module_port;
+}
@@ -0,0 +1,612 @@
+#include "usb_cdc.h"
+#include "ramfunc.h"
+#include "timebase.h"
+#include "main.h"
+#include <string.h>
+
+#if COMM_USB_LINK
+
+// 端点编号和包大小
+#define EP_CONTROL      0U
+#define EP_DATA_IN      1U
+#define EP_DATA_OUT     2U
+#define EP_NOTIFY       3U
+#define EP0_SIZE        64U
+#define BULK_SIZE       64U
+#define NOTIFY_SIZE     8U
+
+// PMA布局（PMA内的字节偏移）：缓冲区描述表在0，各端点缓冲区依次排列
+#define PMA_BTABLE      0x000U
+#define PMA_EP0_TX      0x040U
+#define PMA_EP0_RX      0x080U
+#define PMA_DATA_IN     0x0C0U
+#define PMA_DATA_OUT    0x100U
+#define PMA_NOTIFY      0x140U
+
+// 接收缓冲区大小字段：BL_SIZE=1（32字节一块）、NUM_BLOCK=1，即64字节
+#define PMA_RX_COUNT_64 0x8400U
+#define PMA_COUNT_MASK  0x03FFU
+
+// F103的PMA按16位组织，CPU侧每16位占32位地址
+#define PMA_WORD(offset) (*(volatile uint32_t *)(USB_PMAADDR + (uint32_t)(offset) * 2U))
+#define EPR(ep)          (*(volatile uint16_t *)(USB_BASE + (uint32_t)(ep) * 4U))
+
+// 缓冲区描述表：每个端点4个16位字段
+#define BT_ADDR_TX(ep)   (PMA_BTABLE + (ep) * 8U)
+#define BT_COUNT_TX(ep)  (PMA_BTABLE + (ep) * 8U + 2U)
+#define BT_ADDR_RX(ep)   (PMA_BTABLE + (ep) * 8U + 4U)
+#define BT_COUNT_RX(ep)  (PMA_BTABLE + (ep) * 8U + 6U)
+
+// 标准请求和CDC类请求
+#define REQ_TYPE_MASK              0x60U
+#define REQ_TYPE_STANDARD          0x00U
+#define REQ_TYPE_CLASS             0x20U
+#define REQ_GET_STATUS             0x00U
+#define REQ_CLEAR_FEATURE          0x01U
+#define REQ_SET_FEATURE            0x03U
+#define REQ_SET_ADDRESS            0x05U
+#define REQ_GET_DESCRIPTOR         0x06U
+#define REQ_GET_CONFIGURATION      0x08U
+#define REQ_SET_CONFIGURATION      0x09U
+#define REQ_GET_INTERFACE          0x0AU
+#define REQ_SET_INTERFACE          0x0BU
+#define CDC_SET_LINE_CODING        0x20U
+#define CDC_GET_LINE_CODING        0x21U
+#define CDC_SET_CONTROL_LINE_STATE 0x22U
+#define CDC_SEND_BREAK             0x23U
+#define CDC_LINE_DTR               0x0001U
+
+#define DESC_DEVICE 0x01U
+#define DESC_CONFIG 0x02U
+#define DESC_STRING 0x03U
+
+// D+拉低的时间，主机据此认为设备拔出后重新插入
+#define USB_DETACH_US 10000U
+
+// ST虚拟串口的VID/PID，主机用系统自带的CDC驱动
+static const uint8_t device_descriptor[] = {
+    18, DESC_DEVICE, 0x00, 0x02,       // USB 2.0
+    0x02, 0x00, 0x00, EP0_SIZE,        // CDC类
+    0x83, 0x04, 0x40, 0x57,            // VID 0x0483, PID 0x5740
+    0x00, 0x02, 1, 2, 3, 1,            // bcdDevice 2.00，字符串1~3，1个配置
+};
+
+static const uint8_t config_descriptor[] = {
+    9, DESC_CONFIG, 67, 0, 2, 1, 0, 0xC0, 50,           // 2个接口，自供电，100mA
+    // 通信接口：ACM，通知端点EP3
+    9, 0x04, 0, 0, 1, 0x02, 0x02, 0x01, 0,
+    5, 0x24, 0x00, 0x10, 0x01,                          // Header，CDC 1.10
+    5, 0x24, 0x01, 0x00, 1,                             // Call Management，数据接口1
+    4, 0x24, 0x02, 0x02,                                // ACM：支持线路设置和控制线状态
+    5, 0x24, 0x06, 0, 1,                                // Union：主接口0，从接口1
+    7, 0x05, 0x80 | EP_NOTIFY, 0x03, NOTIFY_SIZE, 0, 16,
+    // 数据接口：EP2 OUT、EP1 IN
+    9, 0x04, 1, 0, 2, 0x0A, 0x00, 0x00, 0,
+    7, 0x05, EP_DATA_OUT, 0x02, BULK_SIZE, 0, 0,
+    7, 0x05, 0x80 | EP_DATA_IN, 0x02, BULK_SIZE, 0, 0,
+};
+
+static const char *const string_table[] = {
+    [1] = "Temperature Measure",
+    [2] = "Temperature Logger CDC",
+};
+
+// 控制传输状态
+static uint8_t ctrl_buffer[EP0_SIZE];   // 动态生成的应答（字符串、状态、线路设置）
+static const uint8_t *ctrl_data = NULL; // 数据阶段待发送的部分
+static uint16_t ctrl_remaining = 0;
+static bool ctrl_zlp = false;           // 应答短于wLength且为包长整数倍时补零长度包
+static bool ctrl_line_coding_out = false; // 等待SET_LINE_CODING的数据阶段
+static uint8_t pending_address = 0;     // SET_ADDRESS在状态阶段完成后生效
+
+// 线路设置：115200 8N1，只保存以便GET_LINE_CODING原样返回
+static uint8_t line_coding[7] = {0x00, 0xC2, 0x01, 0x00, 0, 0, 8};
+
+static volatile bool configured = false;
+static volatile bool suspended = false;
+static volatile bool port_open = false;   // 主机置DTR
+
+// 接收：OUT包拷入communication.c给出的环形缓冲区
+static uint8_t *rx_buffer = NULL;
+static uint16_t rx_size = 0;
+static volatile uint16_t rx_pos = 0;
+
+// 发送：当前帧按64字节分包
+static const uint8_t *tx_data = NULL;
+static uint16_t tx_remaining = 0;
+static bool tx_zlp = false;
+static volatile bool tx_busy = false;
+
+RAMFUNC static void pma_write(uint16_t offset, const uint8_t *data, uint16_t length) {
+    volatile uint32_t *pma = &PMA_WORD(offset);
+    for (uint16_t i = 0; i < length; i += 2) {
+        uint16_t word = data[i];
+        if (i + 1 < length) {
+            word |= (uint16_t)(data[i + 1] << 8);
+        }
+        *pma++ = word;
+    }
+}
+
+RAMFUNC static void pma_read(uint16_t offset, uint8_t *data, uint16_t length) {
+    volatile const uint32_t *pma = &PMA_WORD(offset);
+    for (uint16_t i = 0; i < length; i += 2) {
+        uint16_t word = (uint16_t)*pma++;
+        data[i] = (uint8_t)word;
+        if (i + 1 < length) {
+            data[i + 1] = (uint8_t)(word >> 8);
+        }
+    }
+}
+
+// EPnR中STAT和DTOG位写1翻转、CTR位写0清除：写回时CTR写1保持，只翻转需要改变的STAT位
+RAMFUNC static void ep_set_tx_status(uint8_t ep, uint16_t status) {
+    uint16_t value = EPR(ep);
+    EPR(ep) = (uint16_t)(((value & USB_EPTX_DTOGMASK) ^ status) | USB_EP_CTR_RX | USB_EP_CTR_TX);
+}
+
+RAMFUNC static void ep_set_rx_status(uint8_t ep, uint16_t status) {
+    uint16_t value = EPR(ep);
+    EPR(ep) = (uint16_t)(((value & USB_EPRX_DTOGMASK) ^ status) | USB_EP_CTR_RX | USB_EP_CTR_TX);
+}
+
+RAMFUNC static void ep_clear_ctr_rx(uint8_t ep) {
+    EPR(ep) = (uint16_t)((EPR(ep) & (0x7FFFU & USB_EPREG_MASK)) | USB_EP_CTR_TX);
+}
+
+RAMFUNC static void ep_clear_ctr_tx(uint8_t ep) {
+    EPR(ep) = (uint16_t)((EPR(ep) & (0xFF7FU & USB_EPREG_MASK)) | USB_EP_CTR_RX);
+}
+
+// 设置端点类型和地址，数据翻转位清零（已置位的写1翻转），收发状态为禁用后由调用者设置
+static void ep_configure(uint8_t ep, uint16_t type) {
+    uint16_t value = EPR(ep);
+    EPR(ep) = (uint16_t)(type | ep | (value & (USB_EP_DTOG_RX | USB_EP_DTOG_TX | USB_EPRX_STAT | USB_EPTX_STAT)) |
+                         USB_EP_CTR_RX | USB_EP_CTR_TX);
+}
+
+// 结束正在发送的帧：主机不再取数据（关闭串口、总线复位或挂起）时按已完成处理，归还发送槽
+static void tx_abort(void) {
+    if (tx_busy) {
+        tx_busy = false;
+        tx_remaining = 0;
+        tx_zlp = false;
+        ep_set_tx_status(EP_DATA_IN, USB_EP_TX_NAK);
+        communication_tx_complete_callback(COMM_LINK_USB);
+    }
+}
+
+RAMFUNC static void tx_send_next(void) {
+    uint16_t length = tx_remaining < BULK_SIZE ? tx_remaining : BULK_SIZE;
+    pma_write(PMA_DATA_IN, tx_data, length);
+    PMA_WORD(BT_COUNT_TX(EP_DATA_IN)) = length;
+    tx_data += length;
+    tx_remaining -= length;
+    ep_set_tx_status(EP_DATA_IN, USB_EP_TX_VALID);
+}
+
+// 总线复位：只有EP0，地址为0
+static void bus_reset(void) {
+    tx_abort();
+    configured = false;
+    port_open = false;
+    suspended = false;
+    pending_address = 0;
+    ctrl_line_coding_out = false;
+
+    USB->BTABLE = PMA_BTABLE;
+    PMA_WORD(BT_ADDR_TX(EP_CONTROL)) = PMA_EP0_TX;
+    PMA_WORD(BT_COUNT_TX(EP_CONTROL)) = 0;
+    PMA_WORD(BT_ADDR_RX(EP_CONTROL)) = PMA_EP0_RX;
+    PMA_WORD(BT_COUNT_RX(EP_CONTROL)) = PMA_RX_COUNT_64;
+    ep_configure(EP_CONTROL, USB_EP_CONTROL);
+    ep_set_rx_status(EP_CONTROL, USB_EP_RX_VALID);
+    ep_set_tx_status(EP_CONTROL, USB_EP_TX_NAK);
+    USB->DADDR = USB_DADDR_EF;
+}
+
+// SET_CONFIGURATION：打开数据端点
+static void configure_endpoints(void) {
+    PMA_WORD(BT_ADDR_TX(EP_DATA_IN)) = PMA_DATA_IN;
+    PMA_WORD(BT_COUNT_TX(EP_DATA_IN)) = 0;
+    ep_configure(EP_DATA_IN, USB_EP_BULK);
+    ep_set_tx_status(EP_DATA_IN, USB_EP_TX_NAK);
+
+    PMA_WORD(BT_ADDR_RX(EP_DATA_OUT)) = PMA_DATA_OUT;
+    PMA_WORD(BT_COUNT_RX(EP_DATA_OUT)) = PMA_RX_COUNT_64;
+    ep_configure(EP_DATA_OUT, USB_EP_BULK);
+    ep_set_rx_status(EP_DATA_OUT, USB_EP_RX_VALID);
+
+    PMA_WORD(BT_ADDR_TX(EP_NOTIFY)) = PMA_NOTIFY;
+    PMA_WORD(BT_COUNT_TX(EP_NOTIFY)) = 0;
+    ep_configure(EP_NOTIFY, USB_EP_INTERRUPT);
+    ep_set_tx_status(EP_NOTIFY, USB_EP_TX_NAK);
+}
+
+static void ctrl_send_next(void) {
+    uint16_t length = ctrl_remaining < EP0_SIZE ? ctrl_remaining : EP0_SIZE;
+    if (length > 0) {
+        pma_write(PMA_EP0_TX, ctrl_data, length);
+        ctrl_data += length;
+        ctrl_remaining -= length;
+    }
+    PMA_WORD(BT_COUNT_TX(EP_CONTROL)) = length;
+    ep_set_tx_status(EP_CONTROL, USB_EP_TX_VALID);
+}
+
+// 发送数据阶段（length为0时即状态阶段的零长度包），不超过主机请求的wLength
+static void ctrl_send(const uint8_t *data, uint16_t length, uint16_t requested) {
+    if (length > requested) {
+        length = requested;
+    }
+    ctrl_data = data;
+    ctrl_remaining = length;
+    ctrl_zlp = (length < requested && length % EP0_SIZE == 0 && length != 0);
+    ctrl_send_next();
+}
+
+static void ctrl_stall(void) {
+    ep_set_tx_status(EP_CONTROL, USB_EP_TX_STALL);
+    ep_set_rx_status(EP_CONTROL, USB_EP_RX_STALL);
+}
+
+// ASCII字符串转为字符串描述符（UTF-16LE）
+static uint16_t string_descriptor(const char *text, uint8_t *out) {
+    uint16_t length = 2;
+    while (*text && length + 2U <= EP0_SIZE) {
+        out[length++] = (uint8_t)*text++;
+        out[length++] = 0;
+    }
+    out[0] = (uint8_t)length;
+    out[1] = DESC_STRING;
+    return length;
+}
+
+// 序列号为96位芯片唯一ID的十六进制，多台设备同时接入时可以区分
+static uint16_t serial_descriptor(uint8_t *out) {
+    static const char hex[] = "0123456789ABCDEF";
+    const uint8_t *uid = (const uint8_t *)UID_BASE;
+    char text[25];
+    for (uint8_t i = 0; i < 12; i++) {
+        text[i * 2] = hex[uid[i] >> 4];
+        text[i * 2 + 1] = hex[uid[i] & 0x0F];
+    }
+    text[24] = '\0';
+    return string_descriptor(text, out);
+}
+
+static bool get_descriptor(uint16_t value, uint16_t requested) {
+    uint8_t type = (uint8_t)(value >> 8);
+    uint8_t index = (uint8_t)value;
+
+    if (type == DESC_DEVICE) {
+        ctrl_send(device_descriptor, sizeof(device_descriptor), requested);
+    } else if (type == DESC_CONFIG) {
+        ctrl_send(config_descriptor, sizeof(config_descriptor), requested);
+    } else if (type == DESC_STRING && index == 0) {
+        static const uint8_t languages[] = {4, DESC_STRING, 0x09, 0x04}; // 英语（美国）
+        ctrl_send(languages, sizeof(languages), requested);
+    } else if (type == DESC_STRING && index == 3) {
+        ctrl_send(ctrl_buffer, serial_descriptor(ctrl_buffer), requested);
+    } else if (type == DESC_STRING && index < sizeof(string_table) / sizeof(string_table[0]) && string_table[index]) {
+        ctrl_send(ctrl_buffer, string_descriptor(string_table[index], ctrl_buffer), requested);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool standard_request(const uint8_t *setup, uint16_t value, uint16_t requested) {
+    switch (setup[1]) {
+    case REQ_GET_STATUS:
+        ctrl_buffer[0] = 0x01; // 自供电
+        ctrl_buffer[1] = 0;
+        ctrl_send(ctrl_buffer, 2, requested);
+        return true;
+    case REQ_CLEAR_FEATURE:
+    case REQ_SET_FEATURE:
+    case REQ_SET_INTERFACE:
+        ctrl_send(NULL, 0, 0);
+        return true;
+    case REQ_SET_ADDRESS:
+        pending_address = (uint8_t)(value & 0x7F);
+        ctrl_send(NULL, 0, 0);
+        return true;
+    case REQ_GET_DESCRIPTOR:
+        return get_descriptor(value, requested);
+    case REQ_GET_CONFIGURATION:
+        ctrl_buffer[0] = configured ? 1 : 0;
+        ctrl_send(ctrl_buffer, 1, requested);
+        return true;
+    case REQ_GET_INTERFACE:
+        ctrl_buffer[0] = 0;
+        ctrl_send(ctrl_buffer, 1, requested);
+        return true;
+    case REQ_SET_CONFIGURATION:
+        tx_abort();
+        port_open = false;
+        configured = (value != 0);
+        if (configured) {
+            configure_endpoints();
+        }
+        ctrl_send(NULL, 0, 0);
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool class_request(const uint8_t *setup, uint16_t value, uint16_t requested) {
+    switch (setup[1]) {
+    case CDC_SET_LINE_CODING:
+        ctrl_line_coding_out = true; // 7字节在数据阶段到达
+        ep_set_rx_status(EP_CONTROL, USB_EP_RX_VALID);
+        return true;
+    case CDC_GET_LINE_CODING:
+        memcpy(ctrl_buffer, line_coding, sizeof(line_coding));
+        ctrl_send(ctrl_buffer, sizeof(line_coding), requested);
+        return true;
+    case CDC_SET_CONTROL_LINE_STATE:
+        port_open = (value & CDC_LINE_DTR) != 0;
+        if (!port_open) {
+            tx_abort();
+        }
+        ctrl_send(NULL, 0, 0);
+        return true;
+    case CDC_SEND_BREAK:
+        ctrl_send(NULL, 0, 0);
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void handle_setup(void) {
+    uint8_t setup[8];
+    pma_read(PMA_EP0_RX, setup, sizeof(setup));
+    uint16_t value = (uint16_t)(setup[2] | (setup[3] << 8));
+    uint16_t requested = (uint16_t)(setup[6] | (setup[7] << 8));
+
+    ctrl_remaining = 0;
+    ctrl_zlp = false;
+    ctrl_line_coding_out = false;
+
+    bool handled = false;
+    if ((setup[0] & REQ_TYPE_MASK) == REQ_TYPE_STANDARD) {
+        handled = standard_request(setup, value, requested);
+    } else if ((setup[0] & REQ_TYPE_MASK) == REQ_TYPE_CLASS) {
+        handled = class_request(setup, value, requested);
+    }
+
+    if (handled) {
+        ep_set_rx_status(EP_CONTROL, USB_EP_RX_VALID);
+    } else {
+        ctrl_stall();
+    }
+}
+
+static void handle_control(uint16_t status) {
+    if (status & USB_EP_CTR_RX) {
+        ep_clear_ctr_rx(EP_CONTROL);
+        if (status & USB_EP_SETUP) {
+            handle_setup();
+        } else {
+            // 数据阶段（SET_LINE_CODING）或IN数据阶段之后的状态阶段
+            if (ctrl_line_coding_out) {
+                uint16_t count = (uint16_t)(PMA_WORD(BT_COUNT_RX(EP_CONTROL)) & PMA_COUNT_MASK);
+                ctrl_line_coding_out = false;
+                if (count >= sizeof(line_coding)) {
+                    pma_read(PMA_EP0_RX, line_coding, sizeof(line_coding));
+                }
+                ctrl_send(NULL, 0, 0);
+            }
+            ep_set_rx_status(EP_CONTROL, USB_EP_RX_VALID);
+        }
+    }
+
+    if (status & USB_EP_CTR_TX) {
+        ep_clear_ctr_tx(EP_CONTROL);
+        if (pending_address != 0) {
+            USB->DADDR = (uint16_t)(USB_DADDR_EF | pending_address);
+            pending_address = 0;
+        }
+        if (ctrl_remaining > 0 || ctrl_zlp) {
+            if (ctrl_remaining == 0) {
+                ctrl_zlp = false;
+            }
+            ctrl_send_next();
+        }
+    }
+}
+
+// 一个OUT包拷入环形缓冲区（可能跨过末尾），发布新的写入位置
+RAMFUNC static void handle_data_out(void) {
+    ep_clear_ctr_rx(EP_DATA_OUT);
+    uint16_t count = (uint16_t)(PMA_WORD(BT_COUNT_RX(EP_DATA_OUT)) & PMA_COUNT_MASK);
+
+    if (rx_buffer != NULL && count > 0) {
+        uint8_t packet[BULK_SIZE];
+        if (count > sizeof(packet)) {
+            count = sizeof(packet);
+        }
+        pma_read(PMA_DATA_OUT, packet, count);
+
+        uint16_t pos = rx_pos;
+        uint16_t first = (uint16_t)(rx_size - pos);
+        if (first > count) {
+            first = count;
+        }
+        memcpy(rx_buffer + pos, packet, first);
+        memcpy(rx_buffer, packet + first, count - first);
+        pos = (uint16_t)(pos + count);
+        if (pos >= rx_size) {
+            pos = (uint16_t)(pos - rx_size);
+        }
+        rx_pos = pos;
+        communication_rx_event_callback(COMM_LINK_USB, pos);
+    }
+    ep_set_rx_status(EP_DATA_OUT, USB_EP_RX_VALID);
+}
+
+// 一个IN包已被主机取走：继续下一包，帧的长度是包长整数倍时以零长度包结束
+RAMFUNC static void handle_data_in(void) {
+    ep_clear_ctr_tx(EP_DATA_IN);
+    if (!tx_busy) {
+        return;
+    }
+    if (tx_remaining > 0) {
+        tx_send_next();
+        return;
+    }
+    if (tx_zlp) {
+        tx_zlp = false;
+        tx_send_next();
+        return;
+    }
+    tx_busy = false;
+    communication_tx_complete_callback(COMM_LINK_USB);
+}
+
+void usb_cdc_init(void) {
+    // USB时钟为PLL/1.5（USBPRE=0），72MHz时为48MHz
+    CLEAR_BIT(RCC->CFGR, RCC_CFGR_USBPRE);
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+
+    // 板上D+固定上拉：复位后先把PA12拉低，主机看到断开后才会重新枚举
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    GPIO_InitStruct.Pin = GPIO_PIN_12;
+    GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_OD;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    HAL_GPIO_WritePin(GPIOA, GPIO_PIN_12, GPIO_PIN_RESET);
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+    delay_us(USB_DETACH_US);
+    GPIO_InitStruct.Mode = GPIO_MODE_INPUT; // 外设使能后PA11/PA12由USB接管
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+    __HAL_RCC_USB_CLK_ENABLE();
+
+    // 退出掉电，等待收发器启动（tSTARTUP最长1us）后释放复位
+    USB->CNTR = USB_CNTR_FRES;
+    delay_us(1);
+    USB->CNTR = 0;
+    USB->ISTR = 0;
+    USB->CNTR = USB_CNTR_CTRM | USB_CNTR_RESETM | USB_CNTR_SUSPM | USB_CNTR_WKUPM;
+
+    HAL_NVIC_SetPriority(USB_LP_CAN1_RX0_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(USB_LP_CAN1_RX0_IRQn);
+
+    // 挂起期间可能进入STOP：总线恢复活动时由EXTI18（上升沿）唤醒
+    EXTI->RTSR |= EXTI_RTSR_TR18;
+    EXTI->IMR |= EXTI_IMR_MR18;
+    HAL_NVIC_SetPriority(USBWakeUp_IRQn, 15, 0);
+    HAL_NVIC_EnableIRQ(USBWakeUp_IRQn);
+}
+
+void usb_cdc_wakeup_irq_handler(void) {
+    EXTI->PR = EXTI_PR_PR18;
+}
+
+bool usb_cdc_active(void) {
+    return configured && !suspended;
+}
+
+RAMFUNC void usb_cdc_irq_handler(void) {
+    uint16_t istr = USB->ISTR;
+
+    if (istr & USB_ISTR_RESET) {
+        USB->ISTR = (uint16_t)~USB_ISTR_RESET;
+        bus_reset();
+        return;
+    }
+
+    // 总线3毫秒无活动（主机挂起或拔出）：结束发送，收发器进入挂起，允许进入STOP
+    if (istr & USB_ISTR_SUSP) {
+        USB->ISTR = (uint16_t)~USB_ISTR_SUSP;
+        suspended = true;
+        tx_abort();
+        USB->CNTR |= USB_CNTR_FSUSP;
+        USB->CNTR |= USB_CNTR_LP_MODE;
+    }
+    // 总线恢复活动（LPMODE由硬件清除）
+    if (istr & USB_ISTR_WKUP) {
+        USB->CNTR &= (uint16_t)~USB_CNTR_FSUSP;
+        USB->ISTR = (uint16_t)~USB_ISTR_WKUP;
+        suspended = false;
+    }
+
+    // CTR由硬件按端点依次置位，全部处理完后才清除
+    while ((istr = USB->ISTR) & USB_ISTR_CTR) {
+        uint8_t ep = (uint8_t)(istr & USB_ISTR_EP_ID);
+        uint16_t status = EPR(ep);
+        if (ep == EP_CONTROL) {
+            handle_control(status);
+        } else if (ep == EP_DATA_OUT && (status & USB_EP_CTR_RX)) {
+            handle_data_out();
+        } else if (ep == EP_DATA_IN && (status & USB_EP_CTR_TX)) {
+            handle_data_in();
+        } else {
+            // 通知端点不发送数据，其余情况只清除标志
+            if (status & USB_EP_CTR_RX) {
+                ep_clear_ctr_rx(ep);
+            }
+            if (status & USB_EP_CTR_TX) {
+                ep_clear_ctr_tx(ep);
+            }
+        }
+    }
+}
+
+// CommTransportOps：只有一个USB端口，context不使用
+
+static void ops_start_rx(void *context, uint8_t *buffer, uint16_t size) {
+    (void)context;
+    HAL_NVIC_DisableIRQ(USB_LP_CAN1_RX0_IRQn);
+    rx_buffer = buffer;
+    rx_size = size;
+    rx_pos = 0;
+    HAL_NVIC_EnableIRQ(USB_LP_CAN1_RX0_IRQn);
+}
+
+static void ops_stop_rx(void *context) {
+    (void)context;
+    HAL_NVIC_DisableIRQ(USB_LP_CAN1_RX0_IRQn);
+    rx_buffer = NULL;
+    HAL_NVIC_EnableIRQ(USB_LP_CAN1_RX0_IRQn);
+}
+
+static uint16_t ops_rx_position(void *context) {
+    (void)context;
+    return rx_pos;
+}
+
+// 在任务（临界区内）或发送完成回调中调用，与USB中断互斥
+static bool ops_send(void *context, const uint8_t *data, uint16_t length) {
+    (void)context;
+    if (length == 0 || tx_busy || !configured || suspended || !port_open) {
+        return false;
+    }
+    tx_data = data;
+    tx_remaining = length;
+    tx_zlp = (length % BULK_SIZE) == 0;
+    tx_busy = true;
+    tx_send_next();
+    return true;
+}
+
+// 虚拟串口没有波特率，协商照常成功
+static bool ops_set_baud(void *context, uint32_t baud_rate) {
+    (void)context;
+    (void)baud_rate;
+    return true;
+}
+
+const CommTransportOps usb_cdc_ops = {
+    .start_rx = ops_start_rx,
+    .stop_rx = ops_stop_rx,
+    .rx_position = ops_rx_position,
+    .send = ops_send,
+    .set_baud = ops_set_baud,
+};
+
+#endif // COMM_USB_LINK
@@ -69,6 +69,11 @@ size_t BufferReader::tell() const
     return current_ - begin_;
 }
 
+const char *BufferReader::current() const
+{
+    return current_;
+}
+
 size_t BufferReader::available() const
 {
     return end_ - current_;
@@ -0,0 +1,25 @@
+#include "utils/tlv.hpp"
+#include <cstring>
+
+TLV::TLV()
+    : tag(0), length(0), value(nullptr)
+{
+}
+
+TLV::TLV(char *buf)
+{
+    read(buf);
+}
+
+TLV::TLV(uint16_t tag, uint16_t length, void *value)
+    : tag(tag), length(length), value(value)
+{
+}
+
+void TLV::read(char *buf)
+{
+    tag = static_cast<uint16_t>(static_cast<uint8_t>(buf[0]) |
+                                (static_cast<uint8_t>(buf[1]) << 8));
+    std::memcpy(&length, buf + 2, sizeof(length));
+    value = buf + 4;
+}
@@ -0,0 +1,48 @@
+#include "warm_state.h"
+#include "crc32.h"
+
+// 登记表在普通的.bss中，每次启动重新登记
+static bool warm_boot = false;
+static WarmState *blocks[WARM_STATE_MAX_BLOCKS];
+static uint8_t block_count = 0;
+
+static uint32_t block_crc(const WarmState *state) {
+    return crc32_compute_sw((const uint8_t *)(state + 1), state->size - sizeof(WarmState));
+}
+
+void warm_state_init(bool warm) {
+    warm_boot = warm;
+    block_count = 0;
+}
+
+bool warm_state_is_warm(void) {
+    return warm_boot;
+}
+
+bool warm_state_restore(WarmState *state, uint32_t magic, uint32_t size) {
+    bool valid = warm_boot && state->magic == magic && state->size == size && block_crc(state) == state->crc;
+    if (!valid) {
+        state->magic = magic;
+        state->size = size;
+        state->crc = UINT32_MAX; // 调用方初始化并封装之前不会通过校验
+    }
+    return valid;
+}
+
+void warm_state_seal(WarmState *state) {
+    state->crc = block_crc(state);
+}
+
+bool warm_state_register(WarmState *state) {
+    if (block_count >= WARM_STATE_MAX_BLOCKS) {
+        return false;
+    }
+    blocks[block_count++] = state;
+    return true;
+}
+
+void warm_state_seal_all(void) {
+    for (uint8_t i = 0; i < block_count; i++) {
+        warm_state_seal(blocks[i]);
+    }
+}
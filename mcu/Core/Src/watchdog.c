@@ -0,0 +1,161 @@
+#include "watchdog.h"
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include <string.h>
+
+extern RTC_HandleTypeDef hrtc;
+
+// 超时任务名称的前4个字符保存在备份寄存器中（DR1/DR2由rtc_clock使用），复位后读出
+#define WATCHDOG_BKP_REG_NAME_LO RTC_BKP_DR3
+#define WATCHDOG_BKP_REG_NAME_HI RTC_BKP_DR4
+
+// LSI 40kHz / 64 = 625Hz，重装值4095约6.5秒
+#define IWDG_KEY_START   0xCCCCU
+#define IWDG_KEY_RELOAD  0xAAAAU
+#define IWDG_KEY_UNLOCK  0x5555U
+#define IWDG_RELOAD      4095U
+
+typedef struct {
+    char name[4];
+    uint32_t deadline_ticks;
+    volatile uint32_t checkin_tick;
+    volatile bool waiting;
+} WatchdogTask;
+
+static WatchdogTask tasks[WATCHDOG_MAX_TASKS];
+static volatile uint8_t task_count = 0;
+
+static uint8_t reset_reason = RESET_REASON_UNKNOWN;
+static char stalled_name[5];
+static bool stall_recorded = false;
+
+static StaticTimer_t supervisor_buffer;
+static TimerHandle_t supervisor_timer = NULL;
+
+void watchdog_init(void) {
+    uint32_t csr = RCC->CSR;
+    if (csr & RCC_CSR_IWDGRSTF) {
+        reset_reason = RESET_REASON_WATCHDOG;
+    } else if (csr & RCC_CSR_WWDGRSTF) {
+        reset_reason = RESET_REASON_WINDOW_WATCHDOG;
+    } else if (csr & RCC_CSR_LPWRRSTF) {
+        reset_reason = RESET_REASON_LOW_POWER;
+    } else if (csr & RCC_CSR_SFTRSTF) {
+        reset_reason = RESET_REASON_SOFTWARE;
+    } else if (csr & RCC_CSR_PORRSTF) {
+        reset_reason = RESET_REASON_POWER_ON; // 上电时PINRSTF也会置位，先判断POR
+    } else if (csr & RCC_CSR_PINRSTF) {
+        reset_reason = RESET_REASON_PIN;
+    }
+    RCC->CSR |= RCC_CSR_RMVF;
+
+    // 备份寄存器随RTC保留，只有看门狗复位时记录才有效，读出后清除
+    uint32_t lo = HAL_RTCEx_BKUPRead(&hrtc, WATCHDOG_BKP_REG_NAME_LO);
+    uint32_t hi = HAL_RTCEx_BKUPRead(&hrtc, WATCHDOG_BKP_REG_NAME_HI);
+    memset(stalled_name, 0, sizeof(stalled_name));
+    if (reset_reason == RESET_REASON_WATCHDOG && lo != 0) {
+        stalled_name[0] = (char)(lo & 0xFF);
+        stalled_name[1] = (char)(lo >> 8);
+        stalled_name[2] = (char)(hi & 0xFF);
+        stalled_name[3] = (char)(hi >> 8);
+    }
+    HAL_RTCEx_BKUPWrite(&hrtc, WATCHDOG_BKP_REG_NAME_LO, 0);
+    HAL_RTCEx_BKUPWrite(&hrtc, WATCHDOG_BKP_REG_NAME_HI, 0);
+
+#ifdef DEBUG
+    DBGMCU->CR |= DBGMCU_CR_DBG_IWDG_STOP; // 调试器暂停内核时看门狗也暂停
+#endif
+}
+
+static void iwdg_start(void) {
+    IWDG->KR = IWDG_KEY_START;
+    IWDG->KR = IWDG_KEY_UNLOCK;
+    IWDG->PR = IWDG_PR_PR_2; // 64分频
+    IWDG->RLR = IWDG_RELOAD;
+    while (IWDG->SR != 0) {
+    }
+    IWDG->KR = IWDG_KEY_RELOAD;
+}
+
+static void record_stall(const WatchdogTask *task) {
+    if (stall_recorded) {
+        return;
+    }
+    stall_recorded = true;
+    HAL_RTCEx_BKUPWrite(&hrtc, WATCHDOG_BKP_REG_NAME_LO, (uint8_t)task->name[0] | ((uint32_t)(uint8_t)task->name[1] << 8));
+    HAL_RTCEx_BKUPWrite(&hrtc, WATCHDOG_BKP_REG_NAME_HI, (uint8_t)task->name[2] | ((uint32_t)(uint8_t)task->name[3] << 8));
+}
+
+// 定时器任务中执行：有任务超过期限未签到时不再喂狗，等待IWDG复位
+static void supervisor_callback(TimerHandle_t timer) {
+    (void)timer;
+    TickType_t now = xTaskGetTickCount();
+
+    for (uint8_t i = 0; i < task_count; i++) {
+        WatchdogTask *task = &tasks[i];
+        if (task->waiting) {
+            continue;
+        }
+        if ((uint32_t)(now - task->checkin_tick) > task->deadline_ticks) {
+            record_stall(task);
+            return;
+        }
+    }
+    IWDG->KR = IWDG_KEY_RELOAD;
+}
+
+void watchdog_start(void) {
+    supervisor_timer = xTimerCreateStatic("watchdog", pdMS_TO_TICKS(WATCHDOG_KICK_MS), pdTRUE, NULL,
+                                          supervisor_callback, &supervisor_buffer);
+    xTimerStart(supervisor_timer, 0);
+    iwdg_start();
+}
+
+int8_t watchdog_register(const char *name, uint32_t deadline_ms) {
+    taskENTER_CRITICAL();
+    uint8_t index = task_count;
+    if (index >= WATCHDOG_MAX_TASKS) {
+        taskEXIT_CRITICAL();
+        return -1;
+    }
+
+    WatchdogTask *task = &tasks[index];
+    memset(task->name, 0, sizeof(task->name));
+    strncpy(task->name, name, sizeof(task->name));
+    task->deadline_ticks = pdMS_TO_TICKS(deadline_ms);
+    task->checkin_tick = xTaskGetTickCount();
+    task->waiting = false;
+    task_count = (uint8_t)(index + 1);
+    taskEXIT_CRITICAL();
+    return (int8_t)index;
+}
+
+void watchdog_checkin(int8_t id) {
+    if (id < 0) {
+        return;
+    }
+    // 先更新时间戳再结束等待，监督定时器不会看到旧的时间戳
+    tasks[id].checkin_tick = xTaskGetTickCount();
+    tasks[id].waiting = false;
+}
+
+void watchdog_wait(int8_t id) {
+    if (id < 0) {
+        return;
+    }
+    tasks[id].waiting = true;
+}
+
+uint8_t watchdog_reset_reason(void) {
+    return reset_reason;
+}
+
+bool watchdog_stalled_task(char name[5]) {
+    if (stalled_name[0] == '\0') {
+        return false;
+    }
+    memcpy(name, stalled_name, 5);
+    return true;
+}
@@ -0,0 +1,304 @@
+#
+# 体积/栈/速度报告（cmake -P），由perf_report目标调用：
+# - 各函数代码大小：nm --size-sort
+# - 最坏情况栈深度：读取-fcallgraph-info=su生成的.ci文件，从ROOT沿调用图取各分支的最大值；
+#   经函数指针的调用（__indirect_call）按INDIRECT匹配的全部函数（命令处理函数和完成函数）计算
+# - 微基准结果（BENCH_LOG，BENCH_AT_BOOT时从ITM/串口截取的"bench ..."行）附上对应函数的大小和栈深度
+# 上一次的结果保存在OUTPUT.prev.cmake中，本次与之对比并给出差值
+#
+# 参数：ELF NM CI_DIR ROOT INDIRECT OUTPUT [BENCH_LOG] [STACK_LIMIT]
+#
+
+foreach(var ELF NM CI_DIR ROOT INDIRECT OUTPUT)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "perf_report: 缺少参数 ${var}")
+    endif()
+endforeach()
+
+set(report "")
+macro(report_line text)
+    string(APPEND report "${text}\n")
+endmacro()
+
+# 按宽度左对齐
+function(pad text width out_var)
+    string(LENGTH "${text}" length)
+    if(length LESS width)
+        math(EXPR spaces "${width} - ${length}")
+        string(REPEAT " " ${spaces} fill)
+        set(text "${text}${fill}")
+    endif()
+    set(${out_var} "${text}" PARENT_SCOPE)
+endfunction()
+
+# ---- 代码大小 ----
+execute_process(
+    COMMAND ${NM} --size-sort -S --radix=d ${ELF}
+    OUTPUT_VARIABLE nm_output
+    RESULT_VARIABLE nm_result
+)
+if(NOT nm_result EQUAL 0)
+    message(FATAL_ERROR "perf_report: nm执行失败")
+endif()
+string(REPLACE "\n" ";" nm_lines "${nm_output}")
+set(code_symbols "")
+set(text_total 0)
+foreach(line IN LISTS nm_lines)
+    if(line MATCHES "^[0-9]+ ([0-9]+) [tTwW] (.+)$")
+        math(EXPR size "${CMAKE_MATCH_1}")
+        set(name "${CMAKE_MATCH_2}")
+        string(MAKE_C_IDENTIFIER "${name}" id)
+        set(SIZE_${id} ${size})
+        math(EXPR text_total "${text_total} + ${size}")
+        list(APPEND code_symbols "${size}:${name}")
+    endif()
+endforeach()
+function(symbol_size name out_var)
+    string(MAKE_C_IDENTIFIER "${name}" id)
+    if(DEFINED SIZE_${id})
+        set(${out_var} ${SIZE_${id}} PARENT_SCOPE)
+    else()
+        set(${out_var} "-" PARENT_SCOPE)
+    endif()
+endfunction()
+
+# ---- 调用图 ----
+# 节点标题：全局函数为函数名，静态函数为"文件:函数名"
+file(GLOB_RECURSE ci_files ${CI_DIR}/*.ci)
+if(NOT ci_files)
+    message(FATAL_ERROR "perf_report: ${CI_DIR}下没有.ci文件，请以FIRMWARE_PERF_REPORT=ON重新配置并构建")
+endif()
+set(indirect_targets "")
+foreach(ci IN LISTS ci_files)
+    file(STRINGS ${ci} lines REGEX "^(node|edge):")
+    foreach(line IN LISTS lines)
+        if(line MATCHES "^node: { title: \"([^\"]+)\" label: \"([^\\]+)\\\\n[^\\]+\\\\n([0-9]+) bytes \\(([a-z,]+)\\)\"")
+            set(title "${CMAKE_MATCH_1}")
+            set(name "${CMAKE_MATCH_2}")
+            string(MAKE_C_IDENTIFIER "${title}" id)
+            set_property(GLOBAL PROPERTY PR_OWN_${id} ${CMAKE_MATCH_3})
+            set_property(GLOBAL PROPERTY PR_NAME_${id} "${name}")
+            if(NOT CMAKE_MATCH_4 STREQUAL "static")
+                set_property(GLOBAL PROPERTY PR_KIND_${id} "${CMAKE_MATCH_4}")
+            endif()
+            if(name MATCHES "${INDIRECT}")
+                list(APPEND indirect_targets "${title}")
+            endif()
+        elseif(line MATCHES "^edge: { sourcename: \"([^\"]+)\" targetname: \"([^\"]+)\"")
+            string(MAKE_C_IDENTIFIER "${CMAKE_MATCH_1}" id)
+            set_property(GLOBAL APPEND PROPERTY PR_CALLS_${id} "${CMAKE_MATCH_2}")
+        endif()
+    endforeach()
+endforeach()
+list(REMOVE_DUPLICATES indirect_targets)
+
+# worst = 自身栈帧 + 各被调函数worst的最大值；结果按节点缓存
+# 回到正在计算的节点视为递归，该边不计入；未定义的函数（C库等）计0并记录
+set_property(GLOBAL PROPERTY PR_UNKNOWN "")
+set_property(GLOBAL PROPERTY PR_RECURSION "")
+function(worst_stack title out_var)
+    string(MAKE_C_IDENTIFIER "${title}" id)
+    get_property(done GLOBAL PROPERTY PR_WORST_${id} SET)
+    if(done)
+        get_property(worst GLOBAL PROPERTY PR_WORST_${id})
+        set(${out_var} ${worst} PARENT_SCOPE)
+        return()
+    endif()
+    get_property(visiting GLOBAL PROPERTY PR_VISITING_${id})
+    if(visiting)
+        set_property(GLOBAL APPEND PROPERTY PR_RECURSION "${title}")
+        set(${out_var} 0 PARENT_SCOPE)
+        return()
+    endif()
+    get_property(own GLOBAL PROPERTY PR_OWN_${id})
+    if(own STREQUAL "")
+        if(NOT title STREQUAL "__indirect_call")
+            set_property(GLOBAL APPEND PROPERTY PR_UNKNOWN "${title}")
+        endif()
+        set(own 0)
+    endif()
+
+    set_property(GLOBAL PROPERTY PR_VISITING_${id} TRUE)
+    get_property(calls GLOBAL PROPERTY PR_CALLS_${id})
+    if(title STREQUAL "__indirect_call")
+        set(calls ${indirect_targets})
+    endif()
+    list(REMOVE_DUPLICATES calls)
+    set(deepest 0)
+    set(next "")
+    foreach(callee IN LISTS calls)
+        worst_stack("${callee}" depth)
+        if(depth GREATER deepest)
+            set(deepest ${depth})
+            set(next "${callee}")
+        endif()
+    endforeach()
+    set_property(GLOBAL PROPERTY PR_VISITING_${id} FALSE)
+
+    math(EXPR worst "${own} + ${deepest}")
+    set_property(GLOBAL PROPERTY PR_WORST_${id} ${worst})
+    set_property(GLOBAL PROPERTY PR_NEXT_${id} "${next}")
+    set(${out_var} ${worst} PARENT_SCOPE)
+endfunction()
+
+function(node_name title out_var)
+    string(MAKE_C_IDENTIFIER "${title}" id)
+    get_property(name GLOBAL PROPERTY PR_NAME_${id})
+    if(name STREQUAL "")
+        set(name "${title}")
+    endif()
+    set(${out_var} "${name}" PARENT_SCOPE)
+endfunction()
+
+string(MAKE_C_IDENTIFIER "${ROOT}" root_id)
+get_property(root_defined GLOBAL PROPERTY PR_OWN_${root_id} SET)
+if(NOT root_defined)
+    # 静态函数的标题带文件名
+    foreach(ci IN LISTS ci_files)
+        file(STRINGS ${ci} root_lines REGEX "title: \"[^\"]*:${ROOT}\" label")
+        if(root_lines MATCHES "title: \"([^\"]+)\"")
+            set(ROOT_TITLE "${CMAKE_MATCH_1}")
+        endif()
+    endforeach()
+    if(NOT DEFINED ROOT_TITLE)
+        message(FATAL_ERROR "perf_report: 调用图中没有${ROOT}")
+    endif()
+else()
+    set(ROOT_TITLE "${ROOT}")
+endif()
+worst_stack("${ROOT_TITLE}" root_worst)
+
+# ---- 上一次的结果 ----
+if(EXISTS ${OUTPUT}.prev.cmake)
+    include(${OUTPUT}.prev.cmake)
+endif()
+function(delta current previous out_var)
+    if("${previous}" STREQUAL "" OR "${current}" STREQUAL "-")
+        set(${out_var} "" PARENT_SCOPE)
+        return()
+    endif()
+    math(EXPR diff "${current} - ${previous}")
+    if(diff GREATER 0)
+        set(${out_var} " (+${diff})" PARENT_SCOPE)
+    elseif(diff LESS 0)
+        set(${out_var} " (${diff})" PARENT_SCOPE)
+    else()
+        set(${out_var} "" PARENT_SCOPE)
+    endif()
+endfunction()
+set(state "")
+
+# ---- 输出 ----
+delta(${text_total} "${PREV_TEXT}" text_delta)
+report_line("代码总大小：${text_total} 字节${text_delta}")
+string(APPEND state "set(PREV_TEXT ${text_total})\n")
+report_line("")
+
+delta(${root_worst} "${PREV_STACK}" stack_delta)
+if(DEFINED STACK_LIMIT AND NOT STACK_LIMIT STREQUAL "")
+    math(EXPR margin "${STACK_LIMIT} - ${root_worst}")
+    report_line("${ROOT} 最坏栈深度：${root_worst} 字节${stack_delta}，任务栈 ${STACK_LIMIT} 字节，余量 ${margin} 字节")
+else()
+    report_line("${ROOT} 最坏栈深度：${root_worst} 字节${stack_delta}")
+endif()
+string(APPEND state "set(PREV_STACK ${root_worst})\n")
+report_line("    栈帧    累计  函数")
+set(title "${ROOT_TITLE}")
+set(depth 0)
+while(NOT title STREQUAL "")
+    string(MAKE_C_IDENTIFIER "${title}" id)
+    get_property(own GLOBAL PROPERTY PR_OWN_${id})
+    get_property(kind GLOBAL PROPERTY PR_KIND_${id})
+    node_name("${title}" name)
+    if(title STREQUAL "__indirect_call")
+        set(own 0)
+        set(name "（经函数指针）")
+    elseif(own STREQUAL "")
+        set(own 0)
+        set(kind "未知")
+    endif()
+    math(EXPR depth "${depth} + ${own}")
+    if(kind)
+        set(name "${name} [${kind}]")
+    endif()
+    pad("${own}" 6 own_text)
+    pad("${depth}" 6 depth_text)
+    report_line("  ${own_text}  ${depth_text}  ${name}")
+    get_property(title GLOBAL PROPERTY PR_NEXT_${id})
+endwhile()
+
+get_property(unknown GLOBAL PROPERTY PR_UNKNOWN)
+list(REMOVE_DUPLICATES unknown)
+if(unknown)
+    list(JOIN unknown ", " unknown_text)
+    report_line("  未计入（无栈信息，多为C库和编译器内建函数）：${unknown_text}")
+endif()
+get_property(recursion GLOBAL PROPERTY PR_RECURSION)
+list(REMOVE_DUPLICATES recursion)
+if(recursion)
+    set(names "")
+    foreach(title IN LISTS recursion)
+        node_name("${title}" name)
+        list(APPEND names "${name}")
+    endforeach()
+    list(JOIN names ", " recursion_text)
+    report_line("  递归（回边未计入）：${recursion_text}")
+endif()
+report_line("")
+
+# 微基准：名称与函数同名时附上该函数的大小和最坏栈深度
+if(DEFINED BENCH_LOG AND NOT BENCH_LOG STREQUAL "")
+    if(NOT EXISTS ${BENCH_LOG})
+        message(FATAL_ERROR "perf_report: 找不到BENCH_LOG ${BENCH_LOG}")
+    endif()
+    file(STRINGS ${BENCH_LOG} bench_lines REGEX "bench ")
+    report_line("微基准（${BENCH_LOG}）：")
+    report_line("  用例              载荷  字节   计时        每字节  代码  栈")
+    foreach(line IN LISTS bench_lines)
+        if(NOT line MATCHES "bench +([A-Za-z0-9_]+) +([a-z]+) +([0-9]+)B +([0-9]+) +([0-9.]+)/B")
+            continue()
+        endif()
+        set(name "${CMAKE_MATCH_1}")
+        set(payload "${CMAKE_MATCH_2}")
+        set(bytes "${CMAKE_MATCH_3}")
+        set(ticks "${CMAKE_MATCH_4}")
+        set(per_byte "${CMAKE_MATCH_5}")
+        symbol_size("${name}" size)
+        string(MAKE_C_IDENTIFIER "${name}" id)
+        get_property(defined GLOBAL PROPERTY PR_OWN_${id} SET)
+        set(stack "-")
+        if(defined)
+            worst_stack("${name}" stack)
+        endif()
+        string(MAKE_C_IDENTIFIER "PREV_BENCH_${name}_${payload}" key)
+        delta(${ticks} "${${key}}" ticks_delta)
+        string(APPEND state "set(${key} ${ticks})\n")
+        pad("${name}" 16 name_text)
+        pad("${payload}" 5 payload_text)
+        pad("${bytes}" 5 bytes_text)
+        pad("${ticks}${ticks_delta}" 11 ticks_text)
+        pad("${per_byte}" 7 per_byte_text)
+        pad("${size}" 5 size_text)
+        report_line("  ${name_text}  ${payload_text} ${bytes_text} ${ticks_text} ${per_byte_text} ${size_text} ${stack}")
+    endforeach()
+    report_line("")
+endif()
+
+# 最大的代码符号
+list(SORT code_symbols COMPARE NATURAL ORDER DESCENDING)
+list(LENGTH code_symbols symbol_count)
+if(symbol_count GREATER 30)
+    list(SUBLIST code_symbols 0 30 code_symbols)
+endif()
+report_line("最大的代码符号：")
+foreach(entry IN LISTS code_symbols)
+    string(REGEX REPLACE "^([0-9]+):(.*)$" "\\1;\\2" parts "${entry}")
+    list(GET parts 0 size)
+    list(GET parts 1 name)
+    pad("${size}" 7 size_text)
+    report_line("  ${size_text} ${name}")
+endforeach()
+
+file(WRITE ${OUTPUT} "${report}")
+file(WRITE ${OUTPUT}.prev.cmake "${state}")
+message("${report}")
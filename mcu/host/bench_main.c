@@ -0,0 +1,19 @@
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// 主机上的计时单位为纳秒（32位回绕，单项耗时远小于4秒）
+static uint32_t clock_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec);
+}
+
+// 用法：bench_protocol [重复次数]
+int main(int argc, char **argv) {
+    uint16_t iterations = argc > 1 ? (uint16_t)atoi(argv[1]) : 1000;
+    printf("单位：ns，重复%u次取最小值\n", (unsigned)iterations);
+    bench_report(clock_ns, iterations);
+    return 0;
+}
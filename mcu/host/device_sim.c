@@ -0,0 +1,334 @@
+#define _GNU_SOURCE
+#include "host_mock.h"
+#include "command_handler.h"
+#include "command_stats.h"
+#include "frame_parser.h"
+#include "temp_logger.h"
+#include "device_control.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// 模拟从机：在主机上运行真实的帧解析、命令处理和组帧代码，设备层为mock_device.c。
+// 链路层按communication.c的流程处理：收完一帧即按主机所用的组帧方式执行并回复，
+// 校验失败时回复错误帧，挂起命令和推送在到期时发送。每块模拟板是一个进程
+// （命令处理的状态为静态变量），经TCP端口或伪终端与主机通信。
+// 模拟时钟跟随实际时间，温度是种子、板号、传感器号和模拟秒数的确定函数，
+// 同样的种子在同样的时刻读到同样的温度。
+// 用法：device_sim [-n 板数] [-p 起始TCP端口 | -t] [-s 种子] [-c 传感器数]
+
+#define SIM_SAMPLE_PERIOD_MS 1000 // 与采样任务相同，每秒发布一次读数
+#define SIM_POLL_MAX         16   // 每轮最多完成的到期命令数
+
+typedef struct {
+    uint8_t board;
+    uint32_t seed;
+    uint8_t sensors;
+    int fd;                          // 当前连接（TCP客户端或伪终端主设备），-1为未连接
+    FrameParser parser;
+    uint8_t frame[MAX_PACKET_SIZE];
+    uint8_t tx[MAX_PACKET_SIZE * 2];
+    CommandScratch scratch;
+    uint32_t sim_ms;                 // 已推进的模拟时间
+    uint32_t next_sample_ms;
+    uint32_t next_log_ms;
+} SimBoard;
+
+static uint64_t start_ms;
+
+static uint32_t elapsed_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000U + (uint64_t)now.tv_nsec / 1000000U - start_ms);
+}
+
+static uint32_t mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7FEB352DU;
+    x ^= x >> 15;
+    x *= 0x846CA68BU;
+    x ^= x >> 16;
+    return x;
+}
+
+// 基准温度附近周期10分钟、幅度3.0°C的三角波，叠加±0.2°C的噪声（0.1°C）
+static int16_t sim_temperature(const SimBoard *sim, uint8_t sensor, uint32_t second) {
+    uint32_t phase = (second + sim->board * 37U + sensor * 101U) % 600U;
+    int32_t wave = (int32_t)(phase < 300 ? phase : 600 - phase) / 10;
+    int32_t noise = (int32_t)(mix(sim->seed ^ ((uint32_t)sim->board << 24) ^ ((uint32_t)sensor << 20) ^ second) % 5U) - 2;
+    return (int16_t)(220 + (sim->board % 8) * 5 + sensor * 10 + wave + noise);
+}
+
+static void sim_send(SimBoard *sim, const uint8_t *frame, uint16_t length) {
+    if (sim->fd < 0 || length == 0) {
+        return;
+    }
+    CommStats *stats = host_comm_stats();
+    size_t sent = 0;
+    while (sent < length) {
+        ssize_t n = write(sim->fd, frame + sent, length - sent);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            stats->tx_dropped++;
+            return;
+        }
+        sent += (size_t)n;
+    }
+    stats->packets_sent++;
+    stats->tx_bytes += length;
+}
+
+static void sim_send_error(SimBoard *sim, uint16_t response_id, uint8_t error_code, const char *error_desc) {
+    uint8_t error_data[64];
+    int len = write_tlv_uint8(error_data, sizeof(error_data), TAG_ERROR_CODE, error_code);
+    len += write_tlv_string(error_data + len, sizeof(error_data) - len, TAG_ERROR_DESC, error_desc);
+    int packet_len = build_packet(PKT_TYPE_SLAVE_ERROR, communication_next_packet_id(), response_id,
+                                  error_data, (uint16_t)len, sim->tx, sizeof(sim->tx));
+    if (packet_len > 0) {
+        sim_send(sim, sim->tx, (uint16_t)packet_len);
+    }
+}
+
+// 与communication.c的handle_frame_result()和process_received_data()相同的处理
+static void sim_handle_frame(SimBoard *sim, FrameResult result) {
+    CommStats *stats = host_comm_stats();
+    const PacketHeader *header = frame_parser_header(&sim->parser);
+
+    if (result != FRAME_RESULT_OK) {
+        if (result == FRAME_RESULT_CRC_ERROR) {
+            stats->crc_errors++;
+        } else {
+            stats->format_errors++;
+        }
+        if (frame_parser_has_header(&sim->parser)) {
+            sim_send_error(sim, header->packet_id, ERROR_CODE_CORRUPT, "Packet corrupted");
+        }
+        return;
+    }
+
+    stats->packets_received++;
+    protocol_set_tx_version(header->version);
+    if (header->type != PKT_TYPE_HOST_REQUEST) {
+        sim_send_error(sim, header->packet_id, ERROR_CODE_UNEXPECTED_RESP, "Unexpected packet type");
+        return;
+    }
+
+    const uint8_t *data = frame_parser_payload(&sim->parser);
+    uint8_t opcode = 0;
+    command_handler_request_class(data, header->data_length, &opcode);
+    command_stats_record_request(opcode);
+
+    uint16_t response_len = 0;
+    int result_code = process_command_packet(data, header->data_length, sim->tx, sizeof(sim->tx), &response_len,
+                                             header->packet_id, &sim->scratch);
+    if (result_code == COMMAND_DEFERRED) {
+        return;
+    }
+    if (result_code < 0) {
+        stats->format_errors++;
+        sim_send_error(sim, header->packet_id, ERROR_CODE_UNKNOWN, "Command processing failed");
+        return;
+    }
+    sim_send(sim, sim->tx, response_len);
+}
+
+// 推进模拟时钟：按采样周期发布读数并检查报警，按日志间隔写入日志
+static void sim_advance(SimBoard *sim) {
+    uint32_t now = elapsed_ms();
+    if (now > sim->sim_ms) {
+        host_advance_ms(now - sim->sim_ms);
+        sim->sim_ms = now;
+    }
+
+    while ((int32_t)(sim->sim_ms - sim->next_sample_ms) >= 0) {
+        int16_t temperatures[TEMP_MAX_SENSORS];
+        uint32_t second = sim->next_sample_ms / 1000U;
+        for (uint8_t i = 0; i < sim->sensors; i++) {
+            temperatures[i] = sim_temperature(sim, i, second);
+        }
+        host_set_temperatures(temperatures, sim->sensors);
+        alarm_check_temperatures(temperatures, sim->sensors);
+
+        uint32_t interval = temp_logger_get_interval();
+        if (interval != 0 && (int32_t)(sim->next_sample_ms - sim->next_log_ms) >= 0) {
+            for (uint8_t i = 0; i < sim->sensors; i++) {
+                temp_log_add_entry(i, temperatures[i], temperatures[i]);
+            }
+            sim->next_log_ms = sim->next_sample_ms + interval;
+        }
+        sim->next_sample_ms += SIM_SAMPLE_PERIOD_MS;
+    }
+}
+
+static void sim_poll_due(SimBoard *sim) {
+    for (int i = 0; i < SIM_POLL_MAX && command_handler_next_due_ms() == 0; i++) {
+        uint16_t response_len = 0;
+        uint8_t link = COMM_LINK_BLE; // 模拟器只有一条链路
+        if (command_handler_poll(sim->tx, sizeof(sim->tx), &response_len, &link, &sim->scratch) > 0) {
+            sim_send(sim, sim->tx, response_len);
+        }
+    }
+}
+
+// 等待输入或下一个到期时刻；返回false表示连接已断开
+static bool sim_step(SimBoard *sim) {
+    sim_advance(sim);
+    sim_poll_due(sim);
+
+    uint32_t timeout = command_handler_next_due_ms();
+    uint32_t until_sample = sim->next_sample_ms - sim->sim_ms;
+    if (until_sample < timeout) {
+        timeout = until_sample;
+    }
+
+    struct pollfd pfd = {.fd = sim->fd, .events = POLLIN};
+    int ready = poll(&pfd, 1, (int)timeout);
+    if (ready <= 0) {
+        return ready == 0 || errno == EINTR;
+    }
+
+    uint8_t chunk[512];
+    ssize_t n = read(sim->fd, chunk, sizeof(chunk));
+    if (n <= 0) {
+        return false;
+    }
+    host_comm_stats()->rx_bytes += (uint32_t)n;
+    sim_advance(sim);
+    for (ssize_t i = 0; i < n; i++) {
+        FrameResult result = frame_parser_feed(&sim->parser, chunk[i]);
+        if (result != FRAME_RESULT_NONE) {
+            sim_handle_frame(sim, result);
+        }
+    }
+    return true;
+}
+
+static void sim_init(SimBoard *sim, uint8_t board, uint32_t seed, uint8_t sensors) {
+    memset(sim, 0, sizeof(*sim));
+    sim->board = board;
+    sim->seed = seed;
+    sim->sensors = sensors;
+    sim->fd = -1;
+    host_reset();
+    command_handler_init();
+    frame_parser_init(&sim->parser, sim->frame, sizeof(sim->frame));
+    sim->sim_ms = 0;
+    sim->next_sample_ms = 0;
+    sim->next_log_ms = 0;
+    sim_advance(sim);
+}
+
+// TCP：每次接受一个连接，断开后等待下一个连接，设备状态保留
+static int run_tcp(SimBoard *sim, uint16_t port) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listener, 1) < 0) {
+        fprintf(stderr, "板%u：监听端口%u失败：%s\n", sim->board, port, strerror(errno));
+        return 1;
+    }
+    printf("板%u：tcp://127.0.0.1:%u\n", sim->board, port);
+    fflush(stdout);
+
+    for (;;) {
+        // 未连接时照常推进模拟时钟（采样和日志继续）
+        struct pollfd pfd = {.fd = listener, .events = POLLIN};
+        while (poll(&pfd, 1, SIM_SAMPLE_PERIOD_MS) <= 0) {
+            sim_advance(sim);
+        }
+        sim->fd = accept(listener, NULL, NULL);
+        if (sim->fd < 0) {
+            continue;
+        }
+        setsockopt(sim->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        frame_parser_reset(&sim->parser);
+        while (sim_step(sim)) {
+        }
+        close(sim->fd);
+        sim->fd = -1;
+    }
+}
+
+// 伪终端：自己保持从设备打开，主机程序关闭串口后主设备不会挂断
+static int run_pty(SimBoard *sim) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+        fprintf(stderr, "板%u：创建伪终端失败：%s\n", sim->board, strerror(errno));
+        return 1;
+    }
+    const char *name = ptsname(master);
+    int keep = open(name, O_RDWR | O_NOCTTY);
+    struct termios tio;
+    tcgetattr(keep, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(keep, TCSANOW, &tio);
+    printf("板%u：%s\n", sim->board, name);
+    fflush(stdout);
+
+    sim->fd = master;
+    while (sim_step(sim)) {
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    unsigned boards = 1;
+    unsigned port = 5760;
+    bool pty = false;
+    uint32_t seed = 1;
+    unsigned sensors = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:ts:c:")) != -1) {
+        switch (opt) {
+        case 'n': boards = (unsigned)strtoul(optarg, NULL, 0); break;
+        case 'p': port = (unsigned)strtoul(optarg, NULL, 0); break;
+        case 't': pty = true; break;
+        case 's': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'c': sensors = (unsigned)strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "用法：%s [-n 板数] [-p 起始TCP端口 | -t] [-s 种子] [-c 传感器数]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (boards == 0 || boards > 255 || sensors == 0 || sensors > TEMP_MAX_SENSORS || port + boards > 65536) {
+        fprintf(stderr, "参数超出范围\n");
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    start_ms = (uint64_t)now.tv_sec * 1000U + (uint64_t)now.tv_nsec / 1000000U;
+
+    // 每块板一个子进程，各自持有一份命令处理和设备层状态
+    for (unsigned i = 0; i < boards; i++) {
+        pid_t pid = boards == 1 ? 0 : fork();
+        if (pid < 0) {
+            perror("fork");
+            return 1;
+        }
+        if (pid == 0) {
+            static SimBoard sim;
+            sim_init(&sim, (uint8_t)i, seed, (uint8_t)sensors);
+            return pty ? run_pty(&sim) : run_tcp(&sim, (uint16_t)(port + i));
+        }
+    }
+    while (wait(NULL) > 0) {
+    }
+    return 0;
+}
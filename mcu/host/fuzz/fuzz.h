@@ -0,0 +1,20 @@
+#ifndef FUZZ_H
+#define FUZZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// 模糊测试入口（libFuzzer约定）：用clang和-DPROTOCOL_FUZZ=ON构建时链接libFuzzer，
+// 否则链接standalone.c，按参数给出的文件或目录逐个输入（可用于AFL和回归测试）
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// 不变量检查：在任何构建类型下都生效，失败时abort()以便模糊器记录输入
+#define FUZZ_CHECK(condition) \
+    do {                      \
+        if (!(condition)) {   \
+            abort();          \
+        }                     \
+    } while (0)
+
+#endif // FUZZ_H
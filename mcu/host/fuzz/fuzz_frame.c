@@ -0,0 +1,40 @@
+#include "fuzz.h"
+#include "frame_parser.h"
+#include "protocol.h"
+
+// 帧解析：同一输入分别经流式解析器（两种组帧方式，不过滤和按地址过滤）、缓冲区扫描和parse_packet
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static uint8_t frame[MAX_PACKET_SIZE];
+    static uint8_t payload[MAX_PACKET_SIZE];
+
+    FrameParser parser;
+    frame_parser_init(&parser, frame, sizeof(frame));
+    for (size_t i = 0; i < size; i++) {
+        if (frame_parser_feed(&parser, data[i]) == FRAME_RESULT_OK) {
+            const PacketHeader *header = frame_parser_header(&parser);
+            TlvIndex index;
+            tlv_index_build(&index, frame_parser_payload(&parser), header->data_length);
+        }
+    }
+
+    // 多点总线的地址过滤：只有发给本机地址的带地址帧能通过
+    frame_parser_init(&parser, frame, sizeof(frame));
+    frame_parser_set_address(&parser, 5);
+    for (size_t i = 0; i < size; i++) {
+        if (frame_parser_feed(&parser, data[i]) == FRAME_RESULT_OK) {
+            const PacketHeader *header = frame_parser_header(&parser);
+            FUZZ_CHECK((header->version & PROTOCOL_VERSION_ADDRESSED) && header->address == 5);
+        }
+    }
+
+    size_t start = 0;
+    size_t end = 0;
+    if (find_packet_boundaries(data, size, &start, &end)) {
+        FUZZ_CHECK(start <= end && end < size);
+    }
+
+    PacketHeader header;
+    int len = parse_packet(data, size, &header, payload, sizeof(payload));
+    FUZZ_CHECK(len < 0 || (size_t)len <= sizeof(payload));
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include "protocol.h"
+#include <stdio.h>
+#include <string.h>
+
+// 生成初始语料：若干合法请求的TLV数据（tlv_*）及其两种组帧（frame_v2_*、frame_v3_*）
+// 和带地址的版本（frame_v82_*、frame_v83_*）。
+// 用法：fuzz_seeds <目录>；语料也可作为解析快速路径的基准输入
+typedef struct {
+    const char *name;
+    uint8_t data[128];
+    uint16_t length;
+} Seed;
+
+static const char *out_dir;
+
+static void write_file(const char *prefix, const char *name, const uint8_t *data, size_t length) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s_%s", out_dir, prefix, name);
+    FILE *file = fopen(path, "wb");
+    if (file) {
+        fwrite(data, 1, length, file);
+        fclose(file);
+    }
+}
+
+// IN + DA{fields}
+static uint16_t request(uint8_t *out, const char *instruction, const uint8_t *fields, uint16_t fields_len) {
+    int len = write_tlv_string(out, 128, TAG_INSTRUCTION, instruction);
+    len += write_tlv_raw(out + len, 128 - len, TAG_DATA, fields, fields_len);
+    return (uint16_t)len;
+}
+
+static void emit(const char *name, const uint8_t *data, uint16_t length) {
+    uint8_t frame[MAX_PACKET_SIZE * 2];
+    write_file("tlv", name, data, length);
+    protocol_set_tx_version(PROTOCOL_VERSION);
+    int len = build_packet(PKT_TYPE_HOST_REQUEST, 1, 0, data, length, frame, sizeof(frame));
+    if (len > 0) {
+        write_file("frame_v2", name, frame, (size_t)len);
+    }
+    protocol_set_tx_version(PROTOCOL_VERSION_COBS);
+    len = build_packet(PKT_TYPE_HOST_REQUEST, 2, 0, data, length, frame, sizeof(frame));
+    if (len > 0) {
+        write_file("frame_v3", name, frame, (size_t)len);
+    }
+    // 带地址的版本，发给地址5
+    protocol_set_address(5);
+    protocol_set_tx_version(PROTOCOL_VERSION_ADDR);
+    len = build_packet(PKT_TYPE_HOST_REQUEST, 3, 0, data, length, frame, sizeof(frame));
+    if (len > 0) {
+        write_file("frame_v82", name, frame, (size_t)len);
+    }
+    protocol_set_tx_version(PROTOCOL_VERSION_COBS_ADDR);
+    len = build_packet(PKT_TYPE_HOST_REQUEST, 4, 0, data, length, frame, sizeof(frame));
+    if (len > 0) {
+        write_file("frame_v83", name, frame, (size_t)len);
+    }
+    protocol_set_address(PROTOCOL_ADDRESS_NONE);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "用法：%s <目录>\n", argv[0]);
+        return 2;
+    }
+    out_dir = argv[1];
+
+    uint8_t fields[96];
+    uint8_t data[128];
+    int len;
+
+    emit("ping", data, request(data, CMD_PING, NULL, 0));
+
+    len = write_tlv_uint8(fields, sizeof(fields), TAG_TEMP_FORMAT, TEMP_FORMAT_INT16);
+    len += write_tlv_uint8(fields + len, sizeof(fields) - len, TAG_LATENCY, 1);
+    emit("ping_tf", data, request(data, CMD_PING, fields, (uint16_t)len));
+
+    len = write_tlv_uint8(fields, sizeof(fields), TAG_FRESH, 1);
+    emit("temp_fresh", data, request(data, CMD_GET_TEMP, fields, (uint16_t)len));
+
+    len = write_tlv_uint64(fields, sizeof(fields), TAG_TIME_START, 0);
+    len += write_tlv_uint16(fields + len, sizeof(fields) - len, TAG_MAX_COUNT, 16);
+    len += write_tlv_uint8(fields + len, sizeof(fields) - len, TAG_LOG_FORMAT, 1);
+    len += write_tlv_uint8(fields + len, sizeof(fields) - len, TAG_FRAGMENTED, 1);
+    len += write_tlv_uint8(fields + len, sizeof(fields) - len, TAG_WINDOW, 4);
+    emit("glog", data, request(data, CMD_GET_LOG, fields, (uint16_t)len));
+
+    // salm：AL{IT{ID, L, H}}
+    uint8_t item[32];
+    int item_len = write_tlv_uint8(item, sizeof(item), TAG_ALARM_ID, 2);
+    item_len += write_tlv_uint16(item + item_len, sizeof(item) - item_len, TAG_ALARM_LOW, 100);
+    item_len += write_tlv_uint16(item + item_len, sizeof(item) - item_len, TAG_ALARM_HIGH, 300);
+    uint8_t list[48];
+    int list_len = write_tlv_raw(list, sizeof(list), TAG_ALARM_ITEM, item, (uint16_t)item_len);
+    len = write_tlv_raw(fields, sizeof(fields), TAG_ALARM_LIST, list, (uint16_t)list_len);
+    emit("salm", data, request(data, CMD_SET_ALARMS, fields, (uint16_t)len));
+
+    len = write_tlv_uint16(fields, sizeof(fields), TAG_BENCH_SIZE, 32);
+    len += write_tlv_uint16(fields + len, sizeof(fields) - len, TAG_BENCH_COUNT, 2);
+    emit("bnch", data, request(data, CMD_BENCH, fields, (uint16_t)len));
+
+    // 批量请求：两组IN，第二组用1字节编号
+    len = request(data, CMD_GET_DATETIME, NULL, 0);
+    const char opcode[2] = {OP_GET_COMM_STATS, '\0'};
+    len += write_tlv_raw(data + len, sizeof(data) - len, TAG_INSTRUCTION, (const uint8_t *)opcode, 1);
+    emit("batch", data, (uint16_t)len);
+
+    // 需要转义的数据：sdtm的TS中含0xAA/0x55
+    len = write_tlv_uint64(fields, sizeof(fields), TAG_TIMESTAMP, 0x55AA55AA55ULL);
+    len += write_tlv_uint16(fields + len, sizeof(fields) - len, TAG_MILLISECOND, 0x55AA);
+    emit("sdtm_marks", data, request(data, CMD_SET_DATETIME, fields, (uint16_t)len));
+
+    return 0;
+}
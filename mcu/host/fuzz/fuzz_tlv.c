@@ -0,0 +1,65 @@
+#include "fuzz.h"
+#include "protocol.h"
+#include "tlv_schema.h"
+#include "command_handler.h"
+#include "host_mock.h"
+
+// TLV解码：逐个tag的读取函数、一次扫描的索引、各指令的字段表绑定，最后按请求执行命令
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static CommandScratch scratch;
+    static uint8_t response[MAX_PACKET_SIZE * 2];
+    static uint8_t raw[MAX_PACKET_SIZE];
+    static bool initialized = false;
+    if (!initialized) {
+        host_reset();
+        command_handler_init();
+        initialized = true;
+    }
+
+    uint8_t u8;
+    uint16_t u16;
+    uint32_t u32;
+    uint64_t u64;
+    float f32;
+    char text[8];
+    uint16_t raw_len = sizeof(raw);
+    read_tlv_uint8(data, size, TAG_STATUS, &u8);
+    read_tlv_uint16(data, size, TAG_SEQUENCE, &u16);
+    read_tlv_uint32(data, size, TAG_INTERVAL, &u32);
+    read_tlv_uint64(data, size, TAG_TIMESTAMP, &u64);
+    read_tlv_float32(data, size, TAG_TEMPERATURE, &f32);
+    read_tlv_string(data, size, TAG_INSTRUCTION, text, sizeof(text));
+    read_tlv_raw(data, size, TAG_DATA, raw, &raw_len);
+    FUZZ_CHECK(raw_len <= sizeof(raw));
+
+    TlvIndex index;
+    tlv_index_build(&index, data, size);
+
+    for (uint16_t opcode = 0; opcode < 256; opcode++) {
+        TlvBinding binding;
+        const TlvSchema *schema = tlv_schema_request((uint8_t)opcode);
+        if (schema) {
+            tlv_schema_bind(schema, data, size, &binding);
+        }
+        schema = tlv_schema_response((uint8_t)opcode);
+        if (schema) {
+            tlv_schema_bind(schema, data, size, &binding);
+        }
+    }
+
+    // 请求数据包的长度字段为uint16
+    if (size <= UINT16_MAX) {
+        uint16_t response_len = 0;
+        uint8_t opcode;
+        command_handler_request_class(data, (uint16_t)size, &opcode);
+        int result = process_command_packet(data, (uint16_t)size, response, sizeof(response), &response_len, 1, &scratch);
+        FUZZ_CHECK(result != 0 || response_len <= sizeof(response));
+        // 挂起的命令（如分片传输）按模拟时钟到期后逐个完成
+        for (int i = 0; i < 4; i++) {
+            host_advance_ms(1000);
+            uint8_t link;
+            command_handler_poll(response, sizeof(response), &response_len, &link, &scratch);
+        }
+    }
+    return 0;
+}
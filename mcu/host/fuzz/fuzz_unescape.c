@@ -0,0 +1,26 @@
+#include "fuzz.h"
+#include "protocol.h"
+#include "log_codec.h"
+#include <string.h>
+
+// 反转义：输出不超过输入，且去转义后再转义应还原为合法输入的同一内容；
+// 同一输入也作为差分编码的日志数据解码
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static uint8_t plain[MAX_PACKET_SIZE * 2];
+    static uint8_t escaped[MAX_PACKET_SIZE * 4];
+    static uint8_t again[MAX_PACKET_SIZE * 2];
+    static TempLogEntry entries[MAX_PACKET_SIZE];
+
+    int len = unescape_data(data, size, plain, sizeof(plain));
+    if (len >= 0) {
+        FUZZ_CHECK((size_t)len <= size);
+        int escaped_len = escape_data(plain, (size_t)len, escaped, sizeof(escaped));
+        FUZZ_CHECK(escaped_len >= len);
+        int round_trip = unescape_data(escaped, (size_t)escaped_len, again, sizeof(again));
+        FUZZ_CHECK(round_trip == len && memcmp(plain, again, (size_t)len) == 0);
+    }
+
+    int count = log_codec_decode(data, size, entries, MAX_PACKET_SIZE);
+    FUZZ_CHECK(count <= MAX_PACKET_SIZE);
+    return 0;
+}
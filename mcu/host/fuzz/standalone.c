@@ -0,0 +1,67 @@
+#include "fuzz.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// 不使用libFuzzer时的入口：逐个运行参数中的文件（目录则运行其中的所有文件），
+// 没有参数时从标准输入读取一个输入（AFL的用法）；以'-'开头的参数（libFuzzer选项）忽略
+#define INPUT_MAX (1U << 20)
+
+static uint8_t input[INPUT_MAX];
+
+static int run_stream(FILE *file) {
+    size_t size = fread(input, 1, sizeof(input), file);
+    return LLVMFuzzerTestOneInput(input, size);
+}
+
+static int run_path(const char *path) {
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        fprintf(stderr, "无法读取 %s\n", path);
+        return 1;
+    }
+    if (S_ISDIR(info.st_mode)) {
+        DIR *dir = opendir(path);
+        if (!dir) {
+            return 1;
+        }
+        struct dirent *entry;
+        int failed = 0;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+            char child[4096];
+            snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+            failed |= run_path(child);
+        }
+        closedir(dir);
+        return failed;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "无法打开 %s\n", path);
+        return 1;
+    }
+    int result = run_stream(file);
+    fclose(file);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    int inputs = 0;
+    int failed = 0;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-') {
+            continue;
+        }
+        failed |= run_path(argv[i]);
+        inputs++;
+    }
+    if (inputs == 0) {
+        failed = run_stream(stdin);
+    }
+    return failed;
+}
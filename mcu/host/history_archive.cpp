@@ -0,0 +1,595 @@
+#include "history_archive.hpp"
+#include "crc32.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace history_archive {
+
+static_assert(std::endian::native == std::endian::little, "文件格式为小端，按原样映射");
+
+constexpr uint32_t file_magic = 0x31414C54;    // "TLA1"
+constexpr uint32_t block_magic = 0x4B424C54;   // "TLBK"
+constexpr uint32_t trailer_magic = 0x58494C54; // "TLIX"
+constexpr uint16_t format_version = 1;
+constexpr uint32_t max_payload = block_entries * 32U; // 每条每列最多10字节varint，留足余量
+
+struct FileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t device_id;
+    uint32_t block_entries;
+    uint8_t reserved[16];
+};
+static_assert(sizeof(FileHeader) == 32);
+
+struct BlockHeader {
+    uint32_t magic;
+    uint32_t count;
+    uint64_t first_ms;
+    uint64_t last_ms;
+    int16_t min_temperature;
+    int16_t max_temperature;
+    uint32_t sensors;
+    uint32_t payload_length;
+    uint32_t crc; // 块头（crc为0）和列数据
+};
+static_assert(sizeof(BlockHeader) == 40);
+
+struct Trailer {
+    uint32_t magic;
+    uint32_t block_count;
+    uint64_t index_offset;
+    uint64_t entry_count;
+    uint32_t index_crc;
+    uint32_t crc; // 页尾的前28字节
+};
+static_assert(sizeof(Trailer) == 32);
+
+static uint64_t padded(uint64_t length) {
+    return (length + 7U) & ~uint64_t{7};
+}
+
+static uint32_t sensor_bit(uint8_t sensor) {
+    return 1U << std::min<uint8_t>(sensor, 31);
+}
+
+static uint64_t zigzag_encode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t zigzag_decode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1U);
+}
+
+static void put_varint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static bool get_varint(const uint8_t *data, size_t size, size_t &pos, uint64_t &value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && pos < size; shift += 7) {
+        uint8_t byte = data[pos++];
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t block_crc(const BlockHeader &header, const uint8_t *payload) {
+    BlockHeader copy = header;
+    copy.crc = 0;
+    Crc32Context crc;
+    crc32_init(&crc);
+    crc32_update(&crc, reinterpret_cast<const uint8_t *>(&copy), sizeof(copy));
+    crc32_update(&crc, payload, header.payload_length);
+    return crc32_final(&crc);
+}
+
+static uint32_t trailer_crc(const Trailer &trailer) {
+    return crc32_compute_sw(reinterpret_cast<const uint8_t *>(&trailer), offsetof(Trailer, crc));
+}
+
+Entry from_log(const TempLogEntry &entry) {
+    return {static_cast<uint64_t>(entry.timestamp) * 1000U + entry.millisecond, entry.temperature, entry.raw,
+            entry.sensor};
+}
+
+// 按传感器分组、组内按列编码一块：
+// | 组数 varint | 每组：传感器 varint、条数 varint、时间列、温度列、原始温度列 |，每列为 | 长度 varint | 数据 |。
+// 同一传感器的逐秒记录时间间隔固定、温度缓变，组内的差分多为0
+static void encode_block(std::span<const Entry> entries, std::vector<uint8_t> &out) {
+    std::vector<uint8_t> sensors;
+    for (const Entry &entry : entries) {
+        if (std::find(sensors.begin(), sensors.end(), entry.sensor) == sensors.end()) {
+            sensors.push_back(entry.sensor);
+        }
+    }
+    put_varint(out, sensors.size());
+
+    std::vector<uint8_t> column;
+    auto emit = [&out, &column]() {
+        put_varint(out, column.size());
+        out.insert(out.end(), column.begin(), column.end());
+        column.clear();
+    };
+    for (uint8_t sensor : sensors) {
+        size_t count = static_cast<size_t>(std::count_if(entries.begin(), entries.end(),
+                                                         [sensor](const Entry &entry) { return entry.sensor == sensor; }));
+        put_varint(out, sensor);
+        put_varint(out, count);
+
+        uint64_t prev_time = 0;
+        int64_t prev_delta = 0;
+        bool first = true;
+        for (const Entry &entry : entries) {
+            if (entry.sensor != sensor) {
+                continue;
+            }
+            int64_t delta = static_cast<int64_t>(entry.time_ms - prev_time);
+            put_varint(column, first ? entry.time_ms : zigzag_encode(delta - prev_delta));
+            prev_delta = first ? 0 : delta;
+            prev_time = entry.time_ms;
+            first = false;
+        }
+        emit();
+
+        int32_t prev_temperature = 0;
+        for (const Entry &entry : entries) {
+            if (entry.sensor == sensor) {
+                put_varint(column, zigzag_encode(entry.temperature - prev_temperature));
+                prev_temperature = entry.temperature;
+            }
+        }
+        emit();
+
+        for (const Entry &entry : entries) {
+            if (entry.sensor == sensor) {
+                put_varint(column, zigzag_encode(entry.raw - entry.temperature));
+            }
+        }
+        emit();
+    }
+}
+
+// 解码一块，按（时间, 传感器）恢复写入时的顺序
+static bool decode_block(const uint8_t *data, size_t size, uint32_t count, std::vector<Entry> &entries) {
+    entries.clear();
+    entries.reserve(count);
+    size_t pos = 0;
+    size_t end = size;
+    auto column = [data, size, &pos, &end]() {
+        uint64_t length;
+        if (!get_varint(data, size, pos, length) || length > size - pos) {
+            return false;
+        }
+        end = pos + static_cast<size_t>(length);
+        return true;
+    };
+
+    uint64_t groups, sensor, group_count, value;
+    if (!get_varint(data, size, pos, groups) || groups > 256) {
+        return false;
+    }
+    for (uint64_t g = 0; g < groups; g++) {
+        if (!get_varint(data, size, pos, sensor) || !get_varint(data, size, pos, group_count) || sensor > 0xFF ||
+            group_count == 0 || group_count > count - entries.size()) {
+            return false;
+        }
+        size_t base = entries.size();
+        entries.resize(base + static_cast<size_t>(group_count), Entry{0, 0, 0, static_cast<uint8_t>(sensor)});
+        std::span<Entry> group(entries.data() + base, static_cast<size_t>(group_count));
+
+        if (!column()) {
+            return false;
+        }
+        uint64_t time = 0;
+        int64_t delta = 0;
+        for (size_t i = 0; i < group.size(); i++) {
+            if (!get_varint(data, end, pos, value)) {
+                return false;
+            }
+            if (i == 0) {
+                time = value;
+            } else {
+                delta += zigzag_decode(value);
+                time += static_cast<uint64_t>(delta);
+            }
+            group[i].time_ms = time;
+        }
+
+        if (pos != end || !column()) {
+            return false;
+        }
+        int32_t temperature = 0;
+        for (Entry &entry : group) {
+            if (!get_varint(data, end, pos, value)) {
+                return false;
+            }
+            temperature += static_cast<int32_t>(zigzag_decode(value));
+            entry.temperature = static_cast<int16_t>(temperature);
+        }
+
+        if (pos != end || !column()) {
+            return false;
+        }
+        for (Entry &entry : group) {
+            if (!get_varint(data, end, pos, value)) {
+                return false;
+            }
+            entry.raw = static_cast<int16_t>(entry.temperature + zigzag_decode(value));
+        }
+        if (pos != end) {
+            return false;
+        }
+    }
+    if (entries.size() != count || pos != size) {
+        return false;
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.time_ms != b.time_ms ? a.time_ms < b.time_ms : a.sensor < b.sensor;
+    });
+    return true;
+}
+
+// ---- Writer ----
+
+Writer::~Writer() {
+    close();
+}
+
+bool Writer::open(const char *path, uint32_t device_id) {
+    close();
+    int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    file_ = fdopen(fd, "r+b");
+    if (!file_) {
+        ::close(fd);
+        return false;
+    }
+    device_id_ = device_id;
+    index_.clear();
+    pending_.clear();
+    entries_ = 0;
+    recovered_ = 0;
+    has_last_ = false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        abandon();
+        return false;
+    }
+    uint64_t file_size = static_cast<uint64_t>(st.st_size);
+    if (file_size == 0) {
+        FileHeader header = {file_magic, format_version, sizeof(FileHeader), device_id, block_entries, {}};
+        data_end_ = sizeof(header);
+        if (std::fwrite(&header, sizeof(header), 1, file_) != 1 || !write_index()) {
+            abandon();
+            return false;
+        }
+        return true;
+    }
+
+    FileHeader header;
+    if (std::fread(&header, sizeof(header), 1, file_) != 1 || header.magic != file_magic ||
+        header.version != format_version || header.device_id != device_id) {
+        abandon();
+        return false;
+    }
+
+    // 页尾有效时直接读取索引，否则逐块恢复
+    Trailer trailer;
+    bool intact = file_size >= sizeof(FileHeader) + sizeof(Trailer) &&
+                  fseeko(file_, static_cast<off_t>(file_size - sizeof(Trailer)), SEEK_SET) == 0 &&
+                  std::fread(&trailer, sizeof(trailer), 1, file_) == 1 && trailer.magic == trailer_magic &&
+                  trailer.crc == trailer_crc(trailer) &&
+                  trailer.index_offset + static_cast<uint64_t>(trailer.block_count) * sizeof(BlockInfo) +
+                          sizeof(Trailer) == file_size;
+    if (intact) {
+        index_.resize(trailer.block_count);
+        intact = fseeko(file_, static_cast<off_t>(trailer.index_offset), SEEK_SET) == 0 &&
+                 std::fread(index_.data(), sizeof(BlockInfo), index_.size(), file_) == index_.size() &&
+                 crc32_compute_sw(reinterpret_cast<const uint8_t *>(index_.data()),
+                                  index_.size() * sizeof(BlockInfo)) == trailer.index_crc;
+        data_end_ = trailer.index_offset;
+        entries_ = trailer.entry_count;
+    }
+    if (!intact && !recover(file_size)) {
+        abandon();
+        return false;
+    }
+
+    // 最后一条的时间和传感器：解码最后一块
+    if (!index_.empty()) {
+        const BlockInfo &last = index_.back();
+        std::vector<uint8_t> payload(last.payload_length);
+        std::vector<Entry> entries;
+        if (fseeko(file_, static_cast<off_t>(last.offset + sizeof(BlockHeader)), SEEK_SET) != 0 ||
+            std::fread(payload.data(), 1, payload.size(), file_) != payload.size() ||
+            !decode_block(payload.data(), payload.size(), last.count, entries)) {
+            abandon();
+            return false;
+        }
+        has_last_ = true;
+        last_ms_ = entries.back().time_ms;
+        last_sensor_ = entries.back().sensor;
+    }
+    return true;
+}
+
+// 从文件头之后逐块校验，到第一个无效的块为止，之后的内容（旧索引或写入中断的块）丢弃
+bool Writer::recover(uint64_t file_size) {
+    index_.clear();
+    entries_ = 0;
+    uint64_t offset = sizeof(FileHeader);
+    std::vector<uint8_t> payload;
+    for (;;) {
+        BlockHeader header;
+        if (offset + sizeof(header) > file_size || fseeko(file_, static_cast<off_t>(offset), SEEK_SET) != 0 ||
+            std::fread(&header, sizeof(header), 1, file_) != 1 || header.magic != block_magic ||
+            header.count == 0 || header.count > block_entries || header.payload_length > max_payload ||
+            offset + sizeof(header) + header.payload_length > file_size) {
+            break;
+        }
+        payload.resize(header.payload_length);
+        if (std::fread(payload.data(), 1, payload.size(), file_) != payload.size() ||
+            block_crc(header, payload.data()) != header.crc) {
+            break;
+        }
+        index_.push_back({header.first_ms, header.last_ms, offset, header.count, header.payload_length,
+                          header.min_temperature, header.max_temperature, header.sensors});
+        entries_ += header.count;
+        offset += sizeof(header) + padded(header.payload_length);
+    }
+    data_end_ = offset;
+    recovered_ = file_size - offset;
+    return write_index();
+}
+
+long Writer::append(std::span<const Entry> entries) {
+    if (!file_) {
+        return -1;
+    }
+    long accepted = 0;
+    for (const Entry &entry : entries) {
+        if (has_last_ && (entry.time_ms < last_ms_ || (entry.time_ms == last_ms_ && entry.sensor <= last_sensor_))) {
+            continue;
+        }
+        pending_.push_back(entry);
+        has_last_ = true;
+        last_ms_ = entry.time_ms;
+        last_sensor_ = entry.sensor;
+        accepted++;
+        if (pending_.size() == block_entries && !write_block()) {
+            return -1;
+        }
+    }
+    return accepted;
+}
+
+bool Writer::write_block() {
+    if (pending_.empty()) {
+        return true;
+    }
+    std::vector<uint8_t> payload;
+    encode_block(pending_, payload);
+
+    BlockHeader header = {};
+    header.magic = block_magic;
+    header.count = static_cast<uint32_t>(pending_.size());
+    header.first_ms = pending_.front().time_ms;
+    header.last_ms = pending_.back().time_ms;
+    header.min_temperature = pending_.front().temperature;
+    header.max_temperature = pending_.front().temperature;
+    for (const Entry &entry : pending_) {
+        header.min_temperature = std::min(header.min_temperature, entry.temperature);
+        header.max_temperature = std::max(header.max_temperature, entry.temperature);
+        header.sensors |= sensor_bit(entry.sensor);
+    }
+    header.payload_length = static_cast<uint32_t>(payload.size());
+    header.crc = block_crc(header, payload.data());
+    payload.resize(padded(payload.size()), 0);
+
+    // 新块覆盖旧索引；索引在write_index()中重新写在其后
+    if (fseeko(file_, static_cast<off_t>(data_end_), SEEK_SET) != 0 ||
+        std::fwrite(&header, sizeof(header), 1, file_) != 1 ||
+        std::fwrite(payload.data(), 1, payload.size(), file_) != payload.size()) {
+        return false;
+    }
+    index_.push_back({header.first_ms, header.last_ms, data_end_, header.count, header.payload_length,
+                      header.min_temperature, header.max_temperature, header.sensors});
+    data_end_ += sizeof(header) + payload.size();
+    entries_ += header.count;
+    pending_.clear();
+    return true;
+}
+
+bool Writer::write_index() {
+    Trailer trailer = {};
+    trailer.magic = trailer_magic;
+    trailer.block_count = static_cast<uint32_t>(index_.size());
+    trailer.index_offset = data_end_;
+    trailer.entry_count = entries_;
+    trailer.index_crc = crc32_compute_sw(reinterpret_cast<const uint8_t *>(index_.data()),
+                                         index_.size() * sizeof(BlockInfo));
+    trailer.crc = trailer_crc(trailer);
+    uint64_t end = data_end_ + index_.size() * sizeof(BlockInfo) + sizeof(trailer);
+    return fseeko(file_, static_cast<off_t>(data_end_), SEEK_SET) == 0 &&
+           std::fwrite(index_.data(), sizeof(BlockInfo), index_.size(), file_) == index_.size() &&
+           std::fwrite(&trailer, sizeof(trailer), 1, file_) == 1 && std::fflush(file_) == 0 &&
+           ftruncate(fileno(file_), static_cast<off_t>(end)) == 0;
+}
+
+bool Writer::flush() {
+    return file_ && write_block() && write_index();
+}
+
+// 打开失败时关闭文件，不写入索引
+void Writer::abandon() {
+    std::fclose(file_);
+    file_ = nullptr;
+}
+
+bool Writer::close() {
+    if (!file_) {
+        return true;
+    }
+    bool ok = flush();
+    ok = std::fclose(file_) == 0 && ok;
+    file_ = nullptr;
+    return ok;
+}
+
+bool Writer::last_time(uint64_t &time_ms) const {
+    time_ms = last_ms_;
+    return has_last_;
+}
+
+uint64_t Writer::entry_count() const {
+    return entries_ + pending_.size();
+}
+
+// ---- Reader ----
+
+Reader::~Reader() {
+    close();
+}
+
+bool Reader::open(const char *path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FileHeader) + sizeof(Trailer)) {
+        ::close(fd);
+        return false;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void *map = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        size_ = 0;
+        return false;
+    }
+    map_ = static_cast<const uint8_t *>(map);
+
+    FileHeader header;
+    Trailer trailer;
+    std::memcpy(&header, map_, sizeof(header));
+    std::memcpy(&trailer, map_ + size_ - sizeof(trailer), sizeof(trailer));
+    uint64_t index_size = static_cast<uint64_t>(trailer.block_count) * sizeof(BlockInfo);
+    if (header.magic != file_magic || header.version != format_version || trailer.magic != trailer_magic ||
+        trailer.crc != trailer_crc(trailer) || trailer.index_offset % alignof(BlockInfo) != 0 ||
+        trailer.index_offset + index_size + sizeof(trailer) != size_ ||
+        crc32_compute_sw(map_ + trailer.index_offset, static_cast<size_t>(index_size)) != trailer.index_crc) {
+        close();
+        return false;
+    }
+    device_id_ = header.device_id;
+    entries_ = trailer.entry_count;
+    index_ = {reinterpret_cast<const BlockInfo *>(map_ + trailer.index_offset), trailer.block_count};
+    for (const BlockInfo &block : index_) {
+        if (block.offset + sizeof(BlockHeader) + block.payload_length > trailer.index_offset) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void Reader::close() {
+    if (map_) {
+        munmap(const_cast<uint8_t *>(map_), size_);
+    }
+    map_ = nullptr;
+    size_ = 0;
+    index_ = {};
+    entries_ = 0;
+}
+
+bool Reader::decode(const BlockInfo &block, std::vector<Entry> &entries) const {
+    BlockHeader header;
+    std::memcpy(&header, map_ + block.offset, sizeof(header));
+    const uint8_t *payload = map_ + block.offset + sizeof(header);
+    return header.magic == block_magic && header.count == block.count &&
+           header.payload_length == block.payload_length && block_crc(header, payload) == header.crc &&
+           decode_block(payload, header.payload_length, header.count, entries);
+}
+
+long long Reader::query(uint64_t from_ms, uint64_t to_ms, const std::function<bool(const Entry &)> &visit,
+                        uint8_t sensor) const {
+    // 第一个末时间不早于from_ms的块；块按时间顺序追加，首末时间都递增
+    auto it = std::lower_bound(index_.begin(), index_.end(), from_ms,
+                               [](const BlockInfo &block, uint64_t time) { return block.last_ms < time; });
+    long long visited = 0;
+    std::vector<Entry> entries;
+    for (; it != index_.end() && it->first_ms <= to_ms; ++it) {
+        if (sensor != all_sensors && (it->sensors & sensor_bit(sensor)) == 0) {
+            continue;
+        }
+        if (!decode(*it, entries)) {
+            return -1;
+        }
+        for (const Entry &entry : entries) {
+            if (entry.time_ms < from_ms || entry.time_ms > to_ms || (sensor != all_sensors && entry.sensor != sensor)) {
+                continue;
+            }
+            visited++;
+            if (!visit(entry)) {
+                return visited;
+            }
+        }
+    }
+    return visited;
+}
+
+bool Reader::summarize(uint64_t from_ms, uint64_t to_ms, Summary &summary) const {
+    summary = {};
+    auto add = [&summary](uint64_t count, int16_t min, int16_t max, uint64_t first, uint64_t last) {
+        if (summary.count == 0) {
+            summary.min_temperature = min;
+            summary.max_temperature = max;
+            summary.first_ms = first;
+        }
+        summary.count += count;
+        summary.min_temperature = std::min(summary.min_temperature, min);
+        summary.max_temperature = std::max(summary.max_temperature, max);
+        summary.last_ms = last;
+    };
+    auto it = std::lower_bound(index_.begin(), index_.end(), from_ms,
+                               [](const BlockInfo &block, uint64_t time) { return block.last_ms < time; });
+    std::vector<Entry> entries;
+    for (; it != index_.end() && it->first_ms <= to_ms; ++it) {
+        if (it->first_ms >= from_ms && it->last_ms <= to_ms) {
+            add(it->count, it->min_temperature, it->max_temperature, it->first_ms, it->last_ms);
+            continue;
+        }
+        // 与范围部分相交的块（只有首末两块）逐条统计
+        if (!decode(*it, entries)) {
+            return false;
+        }
+        for (const Entry &entry : entries) {
+            if (entry.time_ms >= from_ms && entry.time_ms <= to_ms) {
+                add(1, entry.temperature, entry.temperature, entry.time_ms, entry.time_ms);
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace history_archive
@@ -0,0 +1,134 @@
+#ifndef HISTORY_ARCHIVE_HPP
+#define HISTORY_ARCHIVE_HPP
+
+#include "protocol.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <span>
+#include <vector>
+
+// 主机端的温度历史归档：网关把glog下载的日志按设备各存一个只追加的文件，
+// 读取时用mmap映射整个文件，按页脚的时间索引二分查找，只解码与查询范围相交的块。
+// 文件布局（小端）：
+// | 文件头 32B | 块 ... | 索引（每块40B） | 页尾 32B |
+// - 块：块头（条目数、首末时间、温度最小最大值、传感器位图、CRC）之后按传感器分组，组内按列存放：
+//   时间（毫秒）二阶差分、温度一阶差分、原始温度与滤波后温度之差，均为zigzag varint，每列前有字节长度
+//   （与log_codec.h的差分编码相同的思路）；缓变的逐秒记录每条约3字节，约为TempLogEntry的1/5
+// - 条目按（时间, 传感器）严格递增，追加时跳过不晚于最后一条的条目，重复下载同一段日志不会重复存放
+// - 追加时新块写在原索引的位置，之后重写索引和页尾；写入中断（页尾无效）时，
+//   重新打开时从文件头逐块校验，重建索引并截去不完整的部分
+// 一年的逐秒记录（4个传感器）约4亿字节，索引约3万块（约1.2MB），打开时只映射、不读入
+namespace history_archive {
+
+constexpr uint32_t block_entries = 4096;   // 每块最多条目数
+constexpr uint8_t all_sensors = 0xFF;
+
+struct Entry {
+    uint64_t time_ms;
+    int16_t temperature; // 0.1°C，滤波后
+    int16_t raw;         // 0.1°C，滤波前
+    uint8_t sensor;
+};
+
+Entry from_log(const TempLogEntry &entry);
+
+// 索引项（文件中的格式）
+struct BlockInfo {
+    uint64_t first_ms;
+    uint64_t last_ms;
+    uint64_t offset;         // 块头在文件中的位置
+    uint32_t count;
+    uint32_t payload_length; // 块头之后的列数据长度
+    int16_t min_temperature;
+    int16_t max_temperature;
+    uint32_t sensors;        // 出现过的传感器（编号≥32的记在第31位）
+};
+static_assert(sizeof(BlockInfo) == 40);
+
+struct Summary {
+    uint64_t count = 0;
+    int16_t min_temperature = 0;
+    int16_t max_temperature = 0;
+    uint64_t first_ms = 0;
+    uint64_t last_ms = 0;
+};
+
+// 追加写入：append()的条目先放在内存中，满一块时写入；flush()写入未满的块和索引
+class Writer {
+public:
+    Writer() = default;
+    ~Writer();
+    Writer(const Writer &) = delete;
+    Writer &operator=(const Writer &) = delete;
+
+    // 打开或创建device_id的归档；已有文件的设备编号不同、文件头无效或读写失败时返回false
+    bool open(const char *path, uint32_t device_id);
+
+    // 追加按（时间, 传感器）排序的条目，返回接受的条数；写入失败返回-1
+    long append(std::span<const Entry> entries);
+
+    bool flush();
+    bool close();
+
+    // 最后一条的时间（含未写入的），用于增量下载；没有条目时返回false
+    bool last_time(uint64_t &time_ms) const;
+    uint64_t entry_count() const;
+    // 打开时截去的不完整数据的字节数（写入中断后恢复）
+    uint64_t recovered_bytes() const { return recovered_; }
+
+private:
+    bool recover(uint64_t file_size);
+    void abandon();
+    bool write_block();
+    bool write_index();
+
+    std::FILE *file_ = nullptr;
+    uint32_t device_id_ = 0;
+    std::vector<BlockInfo> index_;
+    std::vector<Entry> pending_;
+    uint64_t data_end_ = 0;
+    uint64_t entries_ = 0;
+    uint64_t recovered_ = 0;
+    bool has_last_ = false;
+    uint64_t last_ms_ = 0;
+    uint8_t last_sensor_ = 0;
+};
+
+// 只读映射：打开时校验文件头、页尾和索引，块的CRC在解码该块时校验
+class Reader {
+public:
+    Reader() = default;
+    ~Reader();
+    Reader(const Reader &) = delete;
+    Reader &operator=(const Reader &) = delete;
+
+    bool open(const char *path);
+    void close();
+
+    uint32_t device_id() const { return device_id_; }
+    uint64_t entry_count() const { return entries_; }
+    std::span<const BlockInfo> blocks() const { return index_; }
+
+    // 按时间顺序访问[from_ms, to_ms]内的条目（sensor为all_sensors时不筛选），visit返回false时停止；
+    // 返回访问的条数，块损坏时返回-1
+    long long query(uint64_t from_ms, uint64_t to_ms, const std::function<bool(const Entry &)> &visit,
+                    uint8_t sensor = all_sensors) const;
+
+    // [from_ms, to_ms]内的条数和温度范围；完全落在范围内的块直接用块头的统计，不解码
+    bool summarize(uint64_t from_ms, uint64_t to_ms, Summary &summary) const;
+
+private:
+    bool decode(const BlockInfo &block, std::vector<Entry> &entries) const;
+
+    const uint8_t *map_ = nullptr;
+    size_t size_ = 0;
+    uint32_t device_id_ = 0;
+    uint64_t entries_ = 0;
+    std::span<const BlockInfo> index_;
+};
+
+} // namespace history_archive
+
+#endif // HISTORY_ARCHIVE_HPP
@@ -0,0 +1,56 @@
+#ifndef HOST_MOCK_H
+#define HOST_MOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "protocol.h"
+#include "communication.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 主机构建的模拟设备层（mock_device.c）：替代HAL、RTOS和设备模块，全部在内存中单线程运行。
+// 时间只由测试推进：HAL_GetTick()、xTaskGetTickCount()和RTC都从同一个毫秒计数派生，
+// osDelay()推进模拟时钟后立即返回。温度采样在请求新转换时立即完成，
+// 日志和报警事件保存在内存数组中，按与闪存实现相同的顺序和游标规则查询
+#define HOST_LOG_CAPACITY   1024
+#define HOST_EVENT_CAPACITY 256
+#define HOST_BURST_CAPACITY 16
+#define HOST_CYCLES_PER_MS  72000U // 模拟的72MHz主频
+
+// 恢复上电状态：时钟归零、RTC为2025-06-23 14:30:00、1个传感器读数25.0°C、日志清空
+void host_reset(void);
+
+// 推进模拟时钟（DWT周期计数同步推进）
+void host_advance_ms(uint32_t ms);
+
+// 设置各传感器的读数（0.1°C）并发布一次新的采样，与采样任务一样计入运行统计
+void host_set_temperatures(const int16_t *temperatures, uint8_t count);
+
+// 追加一条报警事件（记入事件日志并放入推送队列），时间取当前RTC时间
+void host_add_alarm_event(uint8_t channel, uint8_t type, uint8_t sensor, int16_t temperature);
+
+// 追加一条报警前后记录（只记入日志流，时间由调用方填写）
+void host_add_alarm_burst(const AlarmBurst *burst);
+
+// 已请求保存的设置项次数（config_store_request_save()）
+uint32_t host_config_save_count(void);
+
+// communication_get_stats()返回的链路统计，由模拟的链路层（device_sim.c）更新
+CommStats *host_comm_stats(void);
+
+// 模拟插入或取出SD卡归档（temp_log_archive_ready()），归档的内容与日志相同
+void host_set_archive(bool present);
+
+// 之后的请求按链路link（COMM_LINK_*）的会话处理，模拟请求从该链路到达
+void host_set_link(uint8_t link);
+
+// communication_request_age_us()的返回值：模拟请求收完后在队列中等待的时间，host_reset()后为0
+void host_set_request_age_us(uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_MOCK_H
@@ -0,0 +1,185 @@
+#include "protocol.h"
+#include "frame_parser.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+
+// 链路吞吐测试的主机端（bnch，见docs/common/communication.md）：
+//   stream模式：发送一个带SZ和CT的请求，从机连续回复CT帧，测量单向吞吐
+//   pipeline模式：保持window个bnch请求在途，每个回复一帧，测量流水线下的往返吞吐
+// 用法：link_bench <串口> [波特率] [载荷字节] [帧数] [stream|pipeline] [window]
+// 串口可以是USART1的USB转串口，也可以是BLE桥接的虚拟串口
+
+#define IDLE_TIMEOUT_MS 2000 // 超过该时间没有收到任何字节即结束
+
+typedef struct {
+    int fd;
+    FrameParser parser;
+    uint8_t frame[MAX_PACKET_SIZE];
+    uint8_t chunk[256]; // 读到但尚未送入解析器的字节
+    size_t chunk_pos;
+    size_t chunk_len;
+    uint64_t rx_bytes; // 线路上收到的字节（含组帧开销）
+    uint64_t tx_bytes;
+} Link;
+
+static uint64_t now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000ULL + (uint64_t)now.tv_nsec / 1000U;
+}
+
+static speed_t baud_constant(uint32_t baud) {
+    switch (baud) {
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default:     return B0;
+    }
+}
+
+static bool link_open(Link *link, const char *path, uint32_t baud) {
+    speed_t speed = baud_constant(baud);
+    if (speed == B0) {
+        fprintf(stderr, "不支持的波特率 %u\n", baud);
+        return false;
+    }
+    link->fd = open(path, O_RDWR | O_NOCTTY);
+    if (link->fd < 0) {
+        fprintf(stderr, "打开 %s 失败：%s\n", path, strerror(errno));
+        return false;
+    }
+    struct termios tio;
+    tcgetattr(link->fd, &tio);
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tcsetattr(link->fd, TCSANOW, &tio);
+    tcflush(link->fd, TCIOFLUSH);
+
+    frame_parser_init(&link->parser, link->frame, sizeof(link->frame));
+    link->chunk_pos = 0;
+    link->chunk_len = 0;
+    link->rx_bytes = 0;
+    link->tx_bytes = 0;
+    return true;
+}
+
+static bool send_bench(Link *link, uint16_t packet_id, uint16_t size, uint16_t count) {
+    uint8_t data[32];
+    uint8_t packet[64];
+    int len = write_tlv_string(data, sizeof(data), TAG_INSTRUCTION, CMD_BENCH);
+    uint8_t *da = data + len;
+    len += write_tlv_begin(da, sizeof(data) - len, TAG_DATA);
+    len += write_tlv_uint16(data + len, sizeof(data) - len, TAG_BENCH_SIZE, size);
+    if (count > 1) {
+        len += write_tlv_uint16(data + len, sizeof(data) - len, TAG_BENCH_COUNT, count);
+    }
+    write_tlv_end(da, data + len - da - 4);
+
+    int packet_len = build_packet(PKT_TYPE_HOST_REQUEST, packet_id, 0, data, (uint16_t)len, packet, sizeof(packet));
+    if (packet_len < 0 || write(link->fd, packet, (size_t)packet_len) != packet_len) {
+        return false;
+    }
+    link->tx_bytes += (uint64_t)packet_len;
+    return true;
+}
+
+// 等待下一个bnch响应帧，返回true；超时返回false。状态非OK的帧计入*errors
+static bool receive_bench(Link *link, uint32_t *errors) {
+    for (;;) {
+        while (link->chunk_pos < link->chunk_len) {
+            if (frame_parser_feed(&link->parser, link->chunk[link->chunk_pos++]) != FRAME_RESULT_OK) {
+                continue;
+            }
+            const PacketHeader *header = frame_parser_header(&link->parser);
+            const uint8_t *payload = frame_parser_payload(&link->parser);
+            char instruction[5] = {0};
+            uint8_t status = STATUS_INTERNAL_ERROR;
+            if (read_tlv_string(payload, header->data_length, TAG_INSTRUCTION, instruction, sizeof(instruction)) < 0 ||
+                strcmp(instruction, CMD_BENCH) != 0) {
+                continue; // 推送帧等
+            }
+            read_tlv_uint8(payload, header->data_length, TAG_STATUS, &status);
+            if (status != STATUS_OK) {
+                (*errors)++;
+            }
+            return true;
+        }
+
+        struct pollfd pfd = {.fd = link->fd, .events = POLLIN};
+        if (poll(&pfd, 1, IDLE_TIMEOUT_MS) <= 0) {
+            return false;
+        }
+        ssize_t n = read(link->fd, link->chunk, sizeof(link->chunk));
+        if (n <= 0) {
+            return false;
+        }
+        link->rx_bytes += (uint64_t)n;
+        link->chunk_pos = 0;
+        link->chunk_len = (size_t)n;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "用法：%s <串口> [波特率] [载荷字节] [帧数] [stream|pipeline] [window]\n", argv[0]);
+        return 2;
+    }
+    uint32_t baud = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 115200;
+    uint16_t size = argc > 3 ? (uint16_t)strtoul(argv[3], NULL, 0) : 256;
+    uint16_t count = argc > 4 ? (uint16_t)strtoul(argv[4], NULL, 0) : 100;
+    bool pipeline = argc > 5 && strcmp(argv[5], "pipeline") == 0;
+    uint16_t window = argc > 6 ? (uint16_t)strtoul(argv[6], NULL, 0) : 4;
+    if (count == 0 || window == 0) {
+        fprintf(stderr, "帧数和window须大于0\n");
+        return 2;
+    }
+
+    Link link;
+    if (!link_open(&link, argv[1], baud)) {
+        return 1;
+    }
+
+    uint32_t received = 0;
+    uint32_t errors = 0;
+    uint16_t sent = 0;
+    uint64_t start = now_us();
+    if (!pipeline) {
+        if (!send_bench(&link, 1, size, count)) {
+            fprintf(stderr, "发送失败\n");
+            return 1;
+        }
+        sent = 1;
+    }
+    while (received < count) {
+        while (pipeline && sent < count && sent - received < window) {
+            if (!send_bench(&link, (uint16_t)(sent + 1), size, 1)) {
+                fprintf(stderr, "发送失败\n");
+                return 1;
+            }
+            sent++;
+        }
+        if (!receive_bench(&link, &errors)) {
+            break; // 超时，其余视为丢失
+        }
+        received++;
+    }
+    double seconds = (double)(now_us() - start) / 1e6;
+
+    printf("%s：%u/%u 帧，错误 %u，耗时 %.3f s，发送 %llu 字节\n", pipeline ? "pipeline" : "stream",
+           received, count, errors, seconds, (unsigned long long)link.tx_bytes);
+    printf("帧率 %.1f 帧/s，载荷 %.1f 字节/s，线路接收 %.1f 字节/s（波特率上限约 %.1f 字节/s）\n",
+           received / seconds, (double)received * size / seconds, (double)link.rx_bytes / seconds,
+           baud / 10.0);
+    close(link.fd);
+    return received == count ? 0 : 1;
+}
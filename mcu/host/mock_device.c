@@ -0,0 +1,814 @@
+#include "host_mock.h"
+#include "device_control.h"
+#include "temp_sampler.h"
+#include "temp_logger.h"
+#include "log_compress.h"
+#include "temp_calib.h"
+#include "temp_stats.h"
+#include "config_store.h"
+#include "storage_task.h"
+#include "communication.h"
+#include "output_sequencer.h"
+#include "watchdog.h"
+#include "timebase.h"
+#include "main.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define HOST_RTC_START_MS 1750689000000ULL // 2025-06-23 14:30:00
+
+#define HOST_STREAM_SAMPLES 0
+#define HOST_STREAM_EVENTS  1
+#define HOST_STREAM_BURSTS  2
+
+HostDwt host_dwt;
+uint32_t timebase_cycles_per_us = HOST_CYCLES_PER_MS / 1000U;
+
+static uint32_t tick_ms;
+static uint64_t rtc_base_ms;   // RTC时间减去tick_ms
+static int16_t rtc_correction;
+
+static TempSample sample;
+static uint8_t resolution = TEMP_RESOLUTION_DEFAULT;
+static uint32_t log_interval_ms = TEMP_LOG_INTERVAL_DEFAULT_MS;
+
+static AlarmConfig alarms[MAX_ALARMS];
+static uint32_t alarm_active_mask;
+static AlarmEvent notify_queue[ALARM_NOTIFY_QUEUE_LEN];
+static uint8_t notify_head;
+static uint8_t notify_count;
+
+static TempLogEntry log_entries[HOST_LOG_CAPACITY];
+static uint32_t log_count;
+static AlarmEvent events[HOST_EVENT_CAPACITY];
+static uint32_t event_count;
+static AlarmBurst bursts[HOST_BURST_CAPACITY];
+static uint32_t burst_count;
+
+static bool archive_present;
+static bool led_state;
+static bool buzzer_state;
+static uint16_t output_frequency = 1000;
+
+static CommStats comm_stats;
+static uint16_t packet_id;
+static uint8_t current_link; // host_set_link()或communication_select_link()选择的链路
+static uint32_t request_age_us;
+static uint32_t config_saves;
+
+void host_reset(void) {
+    tick_ms = 0;
+    host_dwt.CYCCNT = 0;
+    request_age_us = 0;
+    rtc_base_ms = HOST_RTC_START_MS;
+    rtc_correction = 0;
+
+    memset(&sample, 0, sizeof(sample));
+    resolution = TEMP_RESOLUTION_DEFAULT;
+    log_interval_ms = TEMP_LOG_INTERVAL_DEFAULT_MS;
+    int16_t initial = 250;
+    host_set_temperatures(&initial, 1);
+
+    alarm_init();
+    notify_head = 0;
+    notify_count = 0;
+    log_count = 0;
+    event_count = 0;
+    burst_count = 0;
+    log_compress_reset();
+    temp_calib_reset();
+    temp_stats_reset();
+    archive_present = false;
+
+    led_state = false;
+    buzzer_state = false;
+    output_frequency = 1000;
+    memset(&comm_stats, 0, sizeof(comm_stats));
+    packet_id = 0;
+    current_link = COMM_LINK_BLE;
+    protocol_set_address(PROTOCOL_ADDRESS_NONE);
+    config_saves = 0;
+}
+
+void host_advance_ms(uint32_t ms) {
+    tick_ms += ms;
+    host_dwt.CYCCNT += ms * HOST_CYCLES_PER_MS;
+}
+
+void host_set_temperatures(const int16_t *temperatures, uint8_t count) {
+    if (count > TEMP_MAX_SENSORS) {
+        count = TEMP_MAX_SENSORS;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        sample.temperatures[i] = temperatures[i];
+        sample.raw[i] = temperatures[i];
+    }
+    sample.sensor_count = count;
+    sample.tick = tick_ms;
+    sample.sequence++;
+    temp_stats_update(temperatures, count, tick_ms);
+}
+
+void host_add_alarm_event(uint8_t channel, uint8_t type, uint8_t sensor, int16_t temperature) {
+    uint64_t now_ms = rtc_get_timestamp_ms();
+    AlarmEvent event = {
+        .timestamp = (uint32_t)(now_ms / 1000U),
+        .millisecond = (uint16_t)(now_ms % 1000U),
+        .channel = channel,
+        .type = type,
+        .sensor = sensor,
+        .temperature = temperature,
+    };
+    if (event_count < HOST_EVENT_CAPACITY) {
+        event.sequence = event_count;
+        events[event_count++] = event;
+    }
+    if (notify_count < ALARM_NOTIFY_QUEUE_LEN) {
+        event.sequence = 0;
+        notify_queue[(notify_head + notify_count) % ALARM_NOTIFY_QUEUE_LEN] = event;
+        notify_count++;
+    }
+}
+
+void host_add_alarm_burst(const AlarmBurst *burst) {
+    if (burst_count < HOST_BURST_CAPACITY) {
+        bursts[burst_count++] = *burst;
+    }
+}
+
+uint32_t host_config_save_count(void) {
+    return config_saves;
+}
+
+CommStats *host_comm_stats(void) {
+    return &comm_stats;
+}
+
+void host_set_link(uint8_t link) {
+    current_link = link;
+}
+
+void host_set_request_age_us(uint32_t us) {
+    request_age_us = us;
+}
+
+// HAL和RTOS
+
+uint32_t HAL_GetTick(void) {
+    return tick_ms;
+}
+
+uint32_t micros(void) {
+    return host_dwt.CYCCNT / (HOST_CYCLES_PER_MS / 1000U);
+}
+
+void Error_Handler(void) {
+    abort();
+}
+
+osStatus_t osDelay(uint32_t ticks) {
+    host_advance_ms(ticks);
+    return osOK;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return tick_ms;
+}
+
+size_t xPortGetFreeHeapSize(void) {
+    return 0;
+}
+
+size_t xPortGetMinimumEverFreeHeapSize(void) {
+    return 0;
+}
+
+// 只有一个模拟任务，运行时间即模拟的毫秒数
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *const pxTaskStatusArray, const UBaseType_t uxArraySize,
+                                 uint32_t *const pulTotalRunTime) {
+    if (pulTotalRunTime != NULL) {
+        *pulTotalRunTime = tick_ms * 1000U;
+    }
+    if (uxArraySize == 0) {
+        return 0;
+    }
+    memset(&pxTaskStatusArray[0], 0, sizeof(pxTaskStatusArray[0]));
+    pxTaskStatusArray[0].pcTaskName = "host";
+    pxTaskStatusArray[0].xTaskNumber = 1;
+    pxTaskStatusArray[0].eCurrentState = eRunning;
+    pxTaskStatusArray[0].ulRunTimeCounter = tick_ms * 1000U;
+    pxTaskStatusArray[0].usStackHighWaterMark = 256;
+    return 1;
+}
+
+// 输出
+
+bool output_pattern_valid(uint16_t on_ms, uint16_t off_ms, uint16_t count) {
+    return on_ms != 0 && (off_ms != 0 || count == 1);
+}
+
+uint8_t output_duty_from_percent(uint8_t percent) {
+    return (uint8_t)((percent * OUTPUT_DUTY_MAX + 50U) / 100U);
+}
+
+bool output_set_frequency(uint16_t hz) {
+    if (hz < OUTPUT_FREQUENCY_MIN || hz > OUTPUT_FREQUENCY_MAX) {
+        return false;
+    }
+    output_frequency = hz;
+    return true;
+}
+
+uint16_t output_get_frequency(void) {
+    return output_frequency;
+}
+
+bool output_all_off(void) {
+    return !led_state && !buzzer_state;
+}
+
+void led_init(void) { led_state = false; }
+void led_on(void) { led_state = true; }
+void led_off(void) { led_state = false; }
+void led_set_duty(uint8_t duty) { led_state = duty != 0; }
+void led_toggle(void) { led_state = !led_state; }
+void led_blink(uint16_t on_ms, uint16_t off_ms, uint16_t count, uint8_t duty) {
+    (void)on_ms;
+    (void)off_ms;
+    (void)count;
+    led_state = duty != 0;
+}
+bool led_play(uint8_t sequence, bool loop) {
+    (void)loop;
+    if (sequence == OUTPUT_SEQUENCE_NONE || sequence >= OUTPUT_SEQUENCE_COUNT) {
+        return false;
+    }
+    led_state = true;
+    return true;
+}
+bool led_get_state(void) { return led_state; }
+
+void buzzer_init(void) { buzzer_state = false; }
+void buzzer_on(void) { buzzer_state = true; }
+void buzzer_off(void) { buzzer_state = false; }
+void buzzer_set_duty(uint8_t duty) { buzzer_state = duty != 0; }
+void buzzer_beep(uint16_t duration_ms) { buzzer_state = duration_ms != 0; }
+void buzzer_pattern(uint16_t on_ms, uint16_t off_ms, uint16_t count, uint8_t duty) {
+    (void)on_ms;
+    (void)off_ms;
+    (void)count;
+    buzzer_state = duty != 0;
+}
+bool buzzer_play(uint8_t sequence, bool loop) {
+    (void)loop;
+    if (sequence == OUTPUT_SEQUENCE_NONE || sequence >= OUTPUT_SEQUENCE_COUNT) {
+        return false;
+    }
+    buzzer_state = true;
+    return true;
+}
+bool buzzer_get_state(void) { return buzzer_state; }
+
+// 温度传感器和采样任务
+
+bool temperature_sensor_init(void) {
+    return sample.sensor_count > 0;
+}
+
+uint8_t temperature_sensor_count(void) {
+    return sample.sensor_count;
+}
+
+bool temperature_get_health(uint8_t sensor, TempSensorHealth *health) {
+    if (sensor >= sample.sensor_count) {
+        return false;
+    }
+    memset(health, 0, sizeof(*health));
+    health->present = sample.temperatures[sensor] != TEMP_INVALID;
+    health->last_seen_tick = sample.tick;
+    health->seen_count = sample.sequence;
+    return true;
+}
+
+bool temperature_is_sensor_ok(void) {
+    return sample.sensor_count > 0;
+}
+
+uint8_t temperature_get_resolution(void) {
+    return resolution;
+}
+
+bool temp_sampler_get(TempSample *out) {
+    if (sample.sequence == 0) {
+        return false;
+    }
+    *out = sample;
+    return true;
+}
+
+// 转换立即完成：返回请求前的序号，新的采样序号比它大
+uint32_t temp_sampler_request_fresh(void) {
+    uint32_t started = sample.sequence;
+    sample.tick = tick_ms;
+    sample.sequence++;
+    return started;
+}
+
+uint32_t temp_sampler_request_resolution(uint8_t bits) {
+    resolution = bits;
+    return temp_sampler_request_fresh();
+}
+
+uint32_t temp_sampler_alarm_latency_max_us(void) {
+    return 0;
+}
+
+bool temp_logger_set_interval(uint32_t interval_ms) {
+    if (interval_ms != 0 && interval_ms < TEMP_LOG_INTERVAL_MIN_MS) {
+        return false;
+    }
+    log_interval_ms = interval_ms;
+    return true;
+}
+
+uint32_t temp_logger_get_interval(void) {
+    return log_interval_ms;
+}
+
+// 报警
+
+bool alarm_config_valid(const AlarmConfig *config) {
+    return config->id < MAX_ALARMS &&
+           config->low_temp < config->high_temp &&
+           config->hysteresis >= 0 &&
+           (int32_t)config->hysteresis * 2 < (int32_t)config->high_temp - config->low_temp &&
+           (config->sensor < TEMP_MAX_SENSORS || config->sensor == ALARM_SENSOR_ANY) &&
+           config->rate >= 0 &&
+           (config->actions & ~ALARM_ACTIONS_ALL) == 0 &&
+           config->enabled <= 1;
+}
+
+// 与固件的默认规则相同：规则0为蜂鸣器、规则1为LED，-40.0~80.0°C
+void alarm_init(void) {
+    for (uint8_t i = 0; i < MAX_ALARMS; i++) {
+        AlarmConfig config = {
+            .id = i,
+            .low_temp = -400,
+            .high_temp = 800,
+            .sensor = ALARM_SENSOR_ANY,
+            .actions = i == 0 ? ALARM_ACTION_BUZZER : (i == 1 ? ALARM_ACTION_LED : 0),
+            .enabled = i < 2,
+        };
+        alarms[i] = config;
+    }
+    alarm_active_mask = 0;
+}
+
+void alarm_set_config(const AlarmConfig *config) {
+    if (config->id < MAX_ALARMS) {
+        alarms[config->id] = *config;
+    }
+}
+
+void alarm_get_config(uint8_t alarm_id, AlarmConfig *config) {
+    if (alarm_id < MAX_ALARMS) {
+        *config = alarms[alarm_id];
+    }
+}
+
+// 只比较上下限，不模拟持续时间、回差和速率
+void alarm_check_temperatures(const int16_t *temperatures, uint8_t count) {
+    for (uint8_t i = 0; i < MAX_ALARMS; i++) {
+        const AlarmConfig *config = &alarms[i];
+        bool over = false;
+        for (uint8_t s = 0; s < count && config->enabled; s++) {
+            if ((config->sensor == ALARM_SENSOR_ANY || config->sensor == s) && temperatures[s] != TEMP_INVALID &&
+                (temperatures[s] < config->low_temp || temperatures[s] > config->high_temp)) {
+                over = true;
+            }
+        }
+        alarm_active_mask = over ? (alarm_active_mask | (1UL << i)) : (alarm_active_mask & ~(1UL << i));
+    }
+}
+
+uint32_t alarm_get_active_mask(void) {
+    return alarm_active_mask;
+}
+
+void alarm_reset_all(void) {
+    alarm_active_mask = 0;
+}
+
+bool alarm_notify_pending(void) {
+    return notify_count != 0;
+}
+
+bool alarm_notify_pop(AlarmEvent *event) {
+    if (notify_count == 0) {
+        return false;
+    }
+    *event = notify_queue[notify_head];
+    notify_head = (uint8_t)((notify_head + 1) % ALARM_NOTIFY_QUEUE_LEN);
+    notify_count--;
+    return true;
+}
+
+// 温度日志和事件日志：迭代器的sequence为下一条的下标，位置即下标
+
+uint32_t log_store_iter_position(const LogStoreIter *iter) {
+    return iter->sequence;
+}
+
+static void query_setup(TempLogQuery *query, uint8_t stream, uint8_t sensor, uint32_t position,
+                        uint64_t start_time, uint64_t end_time) {
+    memset(query, 0, sizeof(*query));
+    query->iter.stream = stream;
+    query->iter.sequence = position;
+    query->sensor = sensor;
+    query->start_time = start_time > UINT32_MAX ? UINT32_MAX : (uint32_t)start_time;
+    query->end_time = end_time > UINT32_MAX ? UINT32_MAX : (uint32_t)end_time;
+    query->low = INT16_MIN;
+    query->high = INT16_MAX;
+}
+
+void temp_log_init(void) {
+    log_count = 0;
+}
+
+// 与固件相同，读数先经过日志压缩
+void temp_log_add_entry(uint8_t sensor, int16_t temperature, int16_t raw) {
+    LogCompressPoint point = { rtc_get_timestamp_ms(), temperature, raw };
+    LogCompressPoint points[LOG_COMPRESS_MAX_POINTS];
+    uint8_t count = log_compress_feed(sensor, &point, points);
+    for (uint8_t i = 0; i < count && log_count < HOST_LOG_CAPACITY; i++) {
+        TempLogEntry entry = {
+            .timestamp = (uint32_t)(points[i].timestamp_ms / 1000U),
+            .sequence = log_count,
+            .temperature = points[i].temperature,
+            .raw = points[i].raw,
+            .millisecond = (uint16_t)(points[i].timestamp_ms % 1000U),
+            .sensor = sensor,
+        };
+        log_entries[log_count++] = entry;
+    }
+}
+
+void temp_log_query_begin(TempLogQuery *query, uint8_t sensor, uint64_t start_time, uint64_t end_time) {
+    uint32_t first = 0;
+    while (first < log_count && log_entries[first].timestamp < start_time) {
+        first++;
+    }
+    query_setup(query, HOST_STREAM_SAMPLES, sensor, first, start_time, end_time);
+}
+
+void temp_log_query_resume(TempLogQuery *query, uint8_t sensor, uint32_t cursor, uint64_t end_time) {
+    query_setup(query, HOST_STREAM_SAMPLES, sensor, cursor, 0, end_time);
+}
+
+void temp_log_query_latest(TempLogQuery *query, uint8_t sensor, uint16_t count, uint64_t end_time) {
+    uint32_t first = log_count;
+    for (uint32_t i = log_count; i > 0 && count > 0; i--) {
+        if (log_entries[i - 1].sensor == sensor && log_entries[i - 1].timestamp <= end_time) {
+            first = i - 1;
+            count--;
+        }
+    }
+    query_setup(query, HOST_STREAM_SAMPLES, sensor, first, 0, end_time);
+}
+
+bool temp_log_query_next(TempLogQuery *query, TempLogEntry *entry) {
+    query->gap = false;
+    while (query->iter.sequence < log_count) {
+        const TempLogEntry *candidate = &log_entries[query->iter.sequence++];
+        if (candidate->timestamp > query->end_time) {
+            query->iter.sequence = log_count;
+            return false;
+        }
+        if (candidate->sensor != query->sensor || candidate->timestamp < query->start_time) {
+            continue;
+        }
+        int16_t value = query->filter_raw ? candidate->raw : candidate->temperature;
+        if (value < query->low || value > query->high) {
+            query->gap = true;
+            continue;
+        }
+        *entry = *candidate;
+        return true;
+    }
+    return false;
+}
+
+uint32_t temp_log_next_sequence(void) {
+    return log_count;
+}
+
+// 模拟的归档与日志共用同一个数组（host_set_archive()）
+bool temp_log_archive_ready(void) {
+    return archive_present;
+}
+
+void temp_log_archive_begin(TempLogQuery *query, uint8_t sensor, uint64_t start_time, uint64_t end_time) {
+    temp_log_query_begin(query, sensor, start_time, end_time);
+}
+
+void temp_log_archive_resume(TempLogQuery *query, uint8_t sensor, uint32_t cursor, uint64_t end_time) {
+    temp_log_query_resume(query, sensor, cursor, end_time);
+}
+
+void host_set_archive(bool present) {
+    archive_present = present;
+}
+
+void temp_log_query_filter(TempLogQuery *query, int16_t low, int16_t high, bool raw) {
+    query->filter_raw = raw;
+    query->low = low;
+    query->high = high;
+}
+
+void temp_log_clear(void) {
+    log_count = 0;
+}
+
+void alarm_event_query_begin(TempLogQuery *query, uint64_t start_time, uint64_t end_time) {
+    uint32_t first = 0;
+    while (first < event_count && events[first].timestamp < start_time) {
+        first++;
+    }
+    query_setup(query, HOST_STREAM_EVENTS, 0, first, start_time, end_time);
+}
+
+void alarm_event_query_resume(TempLogQuery *query, uint32_t cursor, uint64_t end_time) {
+    query_setup(query, HOST_STREAM_EVENTS, 0, cursor, 0, end_time);
+}
+
+bool alarm_event_query_next(TempLogQuery *query, AlarmEvent *event) {
+    while (query->iter.sequence < event_count) {
+        const AlarmEvent *candidate = &events[query->iter.sequence++];
+        if (candidate->timestamp > query->end_time) {
+            query->iter.sequence = event_count;
+            return false;
+        }
+        if (candidate->timestamp >= query->start_time) {
+            *event = *candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t alarm_event_next_sequence(void) {
+    return event_count;
+}
+
+void alarm_burst_query_begin(TempLogQuery *query, uint64_t start_time, uint64_t end_time) {
+    uint32_t first = 0;
+    while (first < burst_count && bursts[first].timestamp < start_time) {
+        first++;
+    }
+    query_setup(query, HOST_STREAM_BURSTS, 0, first, start_time, end_time);
+}
+
+void alarm_burst_query_resume(TempLogQuery *query, uint32_t cursor, uint64_t end_time) {
+    query_setup(query, HOST_STREAM_BURSTS, 0, cursor, 0, end_time);
+}
+
+bool alarm_burst_query_next(TempLogQuery *query, AlarmBurst *burst) {
+    while (query->iter.sequence < burst_count) {
+        const AlarmBurst *candidate = &bursts[query->iter.sequence++];
+        if (candidate->timestamp > query->end_time) {
+            query->iter.sequence = burst_count;
+            return false;
+        }
+        if (candidate->timestamp >= query->start_time) {
+            *burst = *candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 按桶聚合：逐条读取记录（不区分每小时汇总），raw时统计滤波前的温度
+void temp_log_aggregate_begin(TempLogAggregate *aggregate, uint8_t sensor, uint64_t start_time,
+                              uint64_t end_time, uint32_t width, bool raw) {
+    memset(aggregate, 0, sizeof(*aggregate));
+    aggregate->width = (width != 0) ? width : 1;
+    aggregate->raw = raw;
+    temp_log_query_begin(&aggregate->query, sensor, start_time, end_time);
+}
+
+bool temp_log_aggregate_next(TempLogAggregate *aggregate, TempLogBucket *bucket) {
+    TempLogSummary total = {0};
+    TempLogEntry entry;
+
+    for (;;) {
+        TempLogSummary part;
+        if (aggregate->has_carry) {
+            part = aggregate->carry;
+            aggregate->has_carry = false;
+        } else if (temp_log_query_next(&aggregate->query, &entry)) {
+            int16_t value = aggregate->raw ? entry.raw : entry.temperature;
+            part = (TempLogSummary){.time = entry.timestamp, .min = value, .max = value, .count = 1, .sum = value};
+        } else {
+            break;
+        }
+
+        uint32_t start = part.time - part.time % aggregate->width;
+        if (total.count != 0 && start != total.time) {
+            aggregate->carry = part;
+            aggregate->has_carry = true;
+            break;
+        }
+        if (total.count == 0) {
+            total = part;
+            total.time = start;
+        } else {
+            total.min = part.min < total.min ? part.min : total.min;
+            total.max = part.max > total.max ? part.max : total.max;
+            total.count += part.count;
+            total.sum += part.sum;
+        }
+    }
+
+    if (total.count == 0) {
+        return false;
+    }
+    bucket->start = total.time;
+    bucket->min = total.min;
+    bucket->max = total.max;
+    int32_t half = (int32_t)total.count / 2;
+    bucket->mean = (int16_t)((total.sum >= 0 ? total.sum + half : total.sum - half) / (int32_t)total.count);
+    bucket->count = total.count;
+    return true;
+}
+
+// RTC：时间戳为rtc_base_ms加模拟时钟
+
+static uint64_t days_to_ms(uint32_t days) {
+    return (uint64_t)days * 86400000ULL;
+}
+
+// 公历与1970-01-01起的天数互换（与rtc_clock.c相同的算法）
+static uint32_t days_from_civil(uint16_t year, uint8_t month, uint8_t day) {
+    int32_t y = (int32_t)year - (month <= 2);
+    int32_t era = y / 400;
+    uint32_t yoe = (uint32_t)(y - era * 400);
+    uint32_t doy = (153U * (month + (month > 2 ? -3 : 9)) + 2U) / 5U + day - 1U;
+    uint32_t doe = yoe * 365U + yoe / 4U - yoe / 100U + doy;
+    return (uint32_t)(era * 146097 + (int32_t)doe - 719468);
+}
+
+static void civil_from_days(uint32_t days, uint16_t *year, uint8_t *month, uint8_t *day) {
+    int32_t z = (int32_t)days + 719468;
+    int32_t era = z / 146097;
+    uint32_t doe = (uint32_t)(z - era * 146097);
+    uint32_t yoe = (doe - doe / 1460U + doe / 36524U - doe / 146096U) / 365U;
+    uint32_t doy = doe - (365U * yoe + yoe / 4U - yoe / 100U);
+    uint32_t mp = (5U * doy + 2U) / 153U;
+    *day = (uint8_t)(doy - (153U * mp + 2U) / 5U + 1U);
+    *month = (uint8_t)(mp < 10 ? mp + 3 : mp - 9);
+    *year = (uint16_t)((int32_t)yoe + era * 400 + (*month <= 2));
+}
+
+bool rtc_is_initialized(void) {
+    return true;
+}
+
+uint64_t rtc_get_timestamp_ms(void) {
+    return rtc_base_ms + tick_ms;
+}
+
+uint64_t rtc_get_timestamp(void) {
+    return rtc_get_timestamp_ms() / 1000U;
+}
+
+bool rtc_set_timestamp_ms(uint64_t timestamp_ms) {
+    if (timestamp_ms < RTC_TIMESTAMP_2000 * 1000ULL || timestamp_ms >= RTC_TIMESTAMP_2100 * 1000ULL) {
+        return false;
+    }
+    rtc_base_ms = timestamp_ms - tick_ms;
+    return true;
+}
+
+bool rtc_get_date(RTCDate *date) {
+    uint32_t days = (uint32_t)(rtc_get_timestamp() / 86400U);
+    uint16_t year;
+    civil_from_days(days, &year, &date->month, &date->day);
+    date->year = (uint8_t)(year - 2000U);
+    date->weekday = (uint8_t)((days + 3U) % 7U + 1U); // 1970-01-01为星期四，1为星期一
+    return true;
+}
+
+bool rtc_set_date(const RTCDate *date) {
+    if (date->year > 99 || date->month < 1 || date->month > 12 || date->day < 1 || date->day > 31) {
+        return false;
+    }
+    uint64_t time_of_day = rtc_get_timestamp_ms() % 86400000ULL;
+    return rtc_set_timestamp_ms(days_to_ms(days_from_civil(2000U + date->year, date->month, date->day)) + time_of_day);
+}
+
+bool rtc_get_time(RTCTime *time) {
+    uint32_t seconds = (uint32_t)(rtc_get_timestamp() % 86400U);
+    time->hour = (uint8_t)(seconds / 3600U);
+    time->minute = (uint8_t)(seconds / 60U % 60U);
+    time->second = (uint8_t)(seconds % 60U);
+    return true;
+}
+
+bool rtc_set_time(const RTCTime *time) {
+    if (time->hour > 23 || time->minute > 59 || time->second > 59) {
+        return false;
+    }
+    uint64_t day_start = rtc_get_timestamp_ms() - rtc_get_timestamp_ms() % 86400000ULL;
+    return rtc_set_timestamp_ms(day_start + (time->hour * 3600U + time->minute * 60U + time->second) * 1000ULL);
+}
+
+int16_t rtc_get_correction(void) {
+    return rtc_correction;
+}
+
+bool rtc_sync(int32_t offset_ms) {
+    return rtc_set_timestamp_ms(rtc_get_timestamp_ms() + offset_ms);
+}
+
+// 设置存储、链路和看门狗
+
+void config_store_request_save(uint8_t key) {
+    (void)key;
+    config_saves++;
+}
+
+// 模拟设备没有保存的设置
+const void *config_store_find(uint8_t key, uint16_t *length) {
+    (void)key;
+    *length = 0;
+    return NULL;
+}
+
+// 模拟设备在host_reset()中同步加载，始终就绪
+bool storage_task_ready(void) {
+    return true;
+}
+
+// 写入由测试直接调用fw_update_service()完成
+void storage_task_wake(void) {
+}
+
+void communication_get_stats(CommStats *stats) {
+    *stats = comm_stats;
+}
+
+void communication_reset_stats(void) {
+    memset(&comm_stats, 0, sizeof(comm_stats));
+}
+
+uint8_t communication_current_link(void) {
+    return current_link;
+}
+
+uint32_t communication_request_age_us(void) {
+    return request_age_us;
+}
+
+// 各链路共用模拟的组帧版本（device_sim.c按收到的帧设置）
+void communication_select_link(uint8_t link) {
+    current_link = link;
+}
+
+// 模拟的链路层不过滤地址，只记录本机地址
+void communication_set_address(uint8_t address) {
+    protocol_set_address(address);
+}
+
+uint8_t communication_get_address(void) {
+    return protocol_get_address();
+}
+
+// 单线程测试中由测试代码直接调用gateway_service()
+void communication_wake_rx(void) {
+}
+
+uint16_t communication_next_packet_id(void) {
+    return ++packet_id;
+}
+
+bool communication_request_baud_rate(uint32_t baud_rate) {
+    static const uint32_t rates[COMM_BAUD_RATE_COUNT] = COMM_BAUD_RATES;
+    for (uint8_t i = 0; i < COMM_BAUD_RATE_COUNT; i++) {
+        if (rates[i] == baud_rate) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t watchdog_reset_reason(void) {
+    return RESET_REASON_POWER_ON;
+}
+
+bool watchdog_stalled_task(char name[5]) {
+    (void)name;
+    return false;
+}
@@ -0,0 +1,443 @@
+#include "protocol_client.hpp"
+#include "frame_writer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace protocol_client {
+
+static uint64_t now_ms() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000U + static_cast<uint64_t>(now.tv_nsec) / 1000000U;
+}
+
+static speed_t baud_constant(uint32_t baud) {
+    switch (baud) {
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default:     return B0;
+    }
+}
+
+std::span<const uint8_t> Response::data() const {
+    if (type == PKT_TYPE_SLAVE_COMPACT) {
+        return payload.empty() ? payload : payload.subspan(1);
+    }
+    const uint8_t *value = nullptr;
+    uint16_t length = 0;
+    if (read_tlv_view(payload.data(), payload.size(), TAG_DATA, &value, &length) < 0) {
+        return {};
+    }
+    return {value, length};
+}
+
+int16_t StreamFrame::reading(size_t sensor) const {
+    if (sensor >= sensor_count()) {
+        return TEMP_INVALID;
+    }
+    return static_cast<int16_t>(payload[2 * sensor] | (payload[2 * sensor + 1] << 8));
+}
+
+Client::~Client() {
+    for (size_t i = 0; i < ports_.size(); i++) {
+        close(static_cast<int>(i));
+    }
+}
+
+int Client::open_serial(const char *path, uint32_t baud) {
+    speed_t speed = baud_constant(baud);
+    if (speed == B0) {
+        return -1;
+    }
+    int fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        return -1;
+    }
+    termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &tio);
+        tcflush(fd, TCIOFLUSH);
+    }
+    return attach(fd, true);
+}
+
+int Client::attach(int fd, bool owned) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return -1;
+    }
+    auto port = std::make_unique<Port>();
+    port->fd = fd;
+    port->owned = owned;
+    frame_parser_init(&port->parser, port->frame, sizeof(port->frame));
+    frame_parser_accept_streams(&port->parser, true);
+
+    // 复用已关闭端口的编号
+    for (size_t i = 0; i < ports_.size(); i++) {
+        if (!ports_[i]) {
+            ports_[i] = std::move(port);
+            return static_cast<int>(i);
+        }
+    }
+    ports_.push_back(std::move(port));
+    return static_cast<int>(ports_.size() - 1);
+}
+
+void Client::close(int port_id) {
+    fail_port(port_id);
+}
+
+void Client::set_window(int port_id, size_t window) {
+    if (Port *port = find(port_id)) {
+        port->window = std::max<size_t>(window, 1);
+        start_next(port_id, *port, now_ms());
+    }
+}
+
+void Client::set_address(int port_id, uint8_t address) {
+    if (Port *port = find(port_id)) {
+        port->address = address;
+    }
+}
+
+void Client::on_push(PushHandler handler) {
+    push_handler_ = std::move(handler);
+}
+
+void Client::on_stream(StreamHandler handler) {
+    stream_handler_ = std::move(handler);
+}
+
+Client::Port *Client::find(int port_id) const {
+    if (port_id < 0 || static_cast<size_t>(port_id) >= ports_.size()) {
+        return nullptr;
+    }
+    return ports_[static_cast<size_t>(port_id)].get();
+}
+
+// 主机数据包编号：1~0x7FFF（最高位为1的编号属于从机），跳过在途和排队的编号；
+// 从机的重复请求缓存按编号识别重发，编号依次递增而不立即复用
+uint16_t Client::allocate_id(Port &port) {
+    for (;;) {
+        uint16_t id = port.next_id;
+        port.next_id = static_cast<uint16_t>(id >= 0x7FFF ? 1 : id + 1);
+        bool queued = std::any_of(port.queue.begin(), port.queue.end(),
+                                  [id](const Queued &entry) { return entry.packet_id == id; });
+        if (!queued && port.pending.find(id) == port.pending.end()) {
+            return id;
+        }
+    }
+}
+
+int Client::request(int port_id, const char *instruction, std::span<const uint8_t> data, Callback callback,
+                    uint32_t timeout_ms) {
+    Port *port = find(port_id);
+    if (!port) {
+        return -1;
+    }
+
+    uint8_t payload[MAX_DATA_SIZE];
+    int length = write_tlv_string(payload, sizeof(payload), TAG_INSTRUCTION, instruction);
+    if (length < 0 || data.size() > sizeof(payload) - static_cast<size_t>(length) - 4) {
+        return -1;
+    }
+    uint8_t *da = payload + length;
+    length += write_tlv_begin(da, sizeof(payload) - static_cast<size_t>(length), TAG_DATA);
+    if (!data.empty()) {
+        std::memcpy(payload + length, data.data(), data.size());
+    }
+    length += static_cast<int>(data.size());
+    if (write_tlv_end(da, data.size()) < 0) {
+        return -1;
+    }
+
+    uint16_t packet_id = allocate_id(*port);
+    PacketHeader header = {
+        .version = static_cast<uint8_t>(port->address == PROTOCOL_ADDRESS_NONE ? PROTOCOL_VERSION_COBS
+                                                                               : PROTOCOL_VERSION_COBS_ADDR),
+        .address = port->address,
+        .type = PKT_TYPE_HOST_REQUEST,
+        .packet_id = packet_id,
+        .response_id = 0,
+        .data_length = static_cast<uint16_t>(length),
+    };
+    std::vector<uint8_t> frame(FRAME_COBS_MAX_LENGTH(MAX_DATA_SIZE));
+    FrameWriter writer;
+    frame_writer_begin(&writer, frame.data(), static_cast<uint16_t>(frame.size()), &header);
+    frame_writer_write(&writer, payload, static_cast<uint16_t>(length));
+    int frame_length = frame_writer_finish(&writer);
+    if (frame_length < 0) {
+        return -1;
+    }
+    frame.resize(static_cast<size_t>(frame_length));
+
+    port->queue.push_back({packet_id, std::move(frame), std::move(callback), timeout_ms});
+    start_next(port_id, *port, now_ms());
+    return packet_id;
+}
+
+// 窗口有空位时发出排队的请求，超时从写出时算起
+void Client::start_next(int port_id, Port &port, uint64_t now) {
+    while (port.pending.size() < port.window && !port.queue.empty()) {
+        Queued entry = std::move(port.queue.front());
+        port.queue.pop_front();
+        port.tx.insert(port.tx.end(), entry.frame.begin(), entry.frame.end());
+        port.pending[entry.packet_id] = {std::move(entry.callback), now + entry.timeout_ms, entry.timeout_ms};
+    }
+    if (!flush(port)) {
+        fail_port(port_id);
+    }
+}
+
+// 尽量写出发送缓冲区，串口缓冲区满时留待POLLOUT；写出错返回false
+bool Client::flush(Port &port) {
+    size_t written = 0;
+    while (written < port.tx.size()) {
+        ssize_t n = ::write(port.fd, port.tx.data() + written, port.tx.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    port.tx.erase(port.tx.begin(), port.tx.begin() + static_cast<ptrdiff_t>(written));
+    return true;
+}
+
+size_t Client::in_flight(int port_id) const {
+    const Port *port = find(port_id);
+    return port ? port->pending.size() : 0;
+}
+
+size_t Client::queued(int port_id) const {
+    const Port *port = find(port_id);
+    return port ? port->queue.size() : 0;
+}
+
+size_t Client::outstanding() const {
+    size_t total = 0;
+    for (const auto &port : ports_) {
+        if (port) {
+            total += port->pending.size() + port->queue.size();
+        }
+    }
+    return total;
+}
+
+// 在途和排队的请求以closed结束后关闭端口；回调中可以提交新请求（端口已无效，返回-1）
+int Client::fail_port(int port_id) {
+    Port *port = find(port_id);
+    if (!port) {
+        return 0;
+    }
+    std::unique_ptr<Port> owned = std::move(ports_[static_cast<size_t>(port_id)]);
+    if (owned->owned) {
+        ::close(owned->fd);
+    }
+    int completed = 0;
+    Response response;
+    response.port = port_id;
+    for (auto &[packet_id, pending] : owned->pending) {
+        response.response_id = packet_id;
+        if (pending.callback) {
+            pending.callback(Outcome::closed, response);
+        }
+        completed++;
+    }
+    for (Queued &entry : owned->queue) {
+        response.response_id = entry.packet_id;
+        if (entry.callback) {
+            entry.callback(Outcome::closed, response);
+        }
+        completed++;
+    }
+    return completed;
+}
+
+int Client::handle_frame(int port_id, Port &port) {
+    const PacketHeader *header = frame_parser_header(&port.parser);
+    Response response;
+    response.port = port_id;
+    response.type = header->type;
+    response.packet_id = header->packet_id;
+    response.response_id = header->response_id;
+    response.payload = {frame_parser_payload(&port.parser), header->data_length};
+
+    Outcome outcome = Outcome::response;
+    if (header->type == PKT_TYPE_SLAVE_ERROR) {
+        outcome = Outcome::error_frame;
+        read_tlv_uint8(response.payload.data(), response.payload.size(), TAG_ERROR_CODE, &response.error_code);
+    } else if (header->type == PKT_TYPE_SLAVE_COMPACT) {
+        if (!response.payload.empty()) {
+            response.status = response.payload[0];
+        }
+    } else if (header->type == PKT_TYPE_SLAVE_RESPONSE) {
+        read_tlv_uint8(response.payload.data(), response.payload.size(), TAG_STATUS, &response.status);
+    }
+
+    auto it = header->type == PKT_TYPE_SLAVE_REQUEST ? port.pending.end() : port.pending.find(header->response_id);
+    if (it == port.pending.end()) {
+        if (push_handler_) {
+            push_handler_(response);
+        }
+        return 0;
+    }
+    Callback callback = std::move(it->second.callback);
+    port.pending.erase(it);
+    if (callback) {
+        callback(outcome, response);
+    }
+    // 回调中可能关闭端口；窗口空出的位置给排队的下一个请求
+    if (find(port_id) == &port) {
+        start_next(port_id, port, now_ms());
+    }
+    return 1;
+}
+
+int Client::receive(int port_id, Port &port) {
+    uint8_t chunk[512];
+    ssize_t n = ::read(port.fd, chunk, sizeof(chunk));
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        return fail_port(port_id);
+    }
+    int completed = 0;
+    for (ssize_t i = 0; i < n; i++) {
+        // 回调中可能关闭端口
+        Port *current = find(port_id);
+        if (current != &port) {
+            break;
+        }
+        FrameResult result = frame_parser_feed(&port.parser, chunk[i]);
+        if (result == FRAME_RESULT_OK) {
+            completed += handle_frame(port_id, port);
+        } else if (result == FRAME_RESULT_STREAM && stream_handler_) {
+            StreamFrame frame;
+            frame.port = port_id;
+            uint16_t length = 0;
+            const uint8_t *payload = frame_parser_stream(&port.parser, &frame.stream_id, &frame.sequence, &length);
+            frame.payload = {payload, length};
+            stream_handler_(frame);
+        }
+    }
+    return completed;
+}
+
+int Client::expire(uint64_t now) {
+    struct Expired {
+        int port;
+        uint16_t packet_id;
+        Callback callback;
+    };
+    std::vector<Expired> expired;
+    for (size_t i = 0; i < ports_.size(); i++) {
+        Port *port = ports_[i].get();
+        if (!port) {
+            continue;
+        }
+        for (auto it = port->pending.begin(); it != port->pending.end();) {
+            if (it->second.deadline_ms <= now) {
+                expired.push_back({static_cast<int>(i), it->first, std::move(it->second.callback)});
+                it = port->pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (!expired.empty()) {
+            start_next(static_cast<int>(i), *port, now);
+        }
+    }
+    for (Expired &entry : expired) {
+        Response response;
+        response.port = entry.port;
+        response.response_id = entry.packet_id;
+        if (entry.callback) {
+            entry.callback(Outcome::timeout, response);
+        }
+    }
+    return static_cast<int>(expired.size());
+}
+
+void Client::fill_pollfds(std::vector<pollfd> &fds, std::vector<int> &ports) const {
+    fds.clear();
+    ports.clear();
+    for (size_t i = 0; i < ports_.size(); i++) {
+        const Port *port = ports_[i].get();
+        if (port) {
+            short events = POLLIN;
+            if (!port->tx.empty()) {
+                events |= POLLOUT;
+            }
+            fds.push_back({port->fd, events, 0});
+            ports.push_back(static_cast<int>(i));
+        }
+    }
+}
+
+int Client::next_timeout_ms() const {
+    uint64_t now = now_ms();
+    int64_t nearest = -1;
+    for (const auto &port : ports_) {
+        if (!port) {
+            continue;
+        }
+        for (const auto &[packet_id, pending] : port->pending) {
+            int64_t remaining = pending.deadline_ms > now ? static_cast<int64_t>(pending.deadline_ms - now) : 0;
+            if (nearest < 0 || remaining < nearest) {
+                nearest = remaining;
+            }
+        }
+    }
+    return static_cast<int>(nearest);
+}
+
+int Client::dispatch(const std::vector<pollfd> &fds, const std::vector<int> &ports) {
+    int completed = 0;
+    for (size_t i = 0; i < fds.size() && i < ports.size(); i++) {
+        Port *port = find(ports[i]);
+        if (!port || port->fd != fds[i].fd) {
+            continue;
+        }
+        if ((fds[i].revents & POLLOUT) != 0 && !flush(*port)) {
+            completed += fail_port(ports[i]);
+            continue;
+        }
+        if ((fds[i].revents & POLLIN) != 0) {
+            completed += receive(ports[i], *port);
+        } else if ((fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) {
+            completed += fail_port(ports[i]);
+        }
+    }
+    return completed + expire(now_ms());
+}
+
+int Client::run_once(int timeout_ms) {
+    std::vector<pollfd> fds;
+    std::vector<int> ports;
+    fill_pollfds(fds, ports);
+    int wait = next_timeout_ms();
+    if (timeout_ms >= 0 && (wait < 0 || timeout_ms < wait)) {
+        wait = timeout_ms;
+    }
+    if (poll(fds.data(), fds.size(), wait) < 0 && errno != EINTR) {
+        return -1;
+    }
+    return dispatch(fds, ports);
+}
+
+} // namespace protocol_client
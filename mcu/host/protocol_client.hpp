@@ -0,0 +1,154 @@
+#ifndef PROTOCOL_CLIENT_HPP
+#define PROTOCOL_CLIENT_HPP
+
+#include "protocol.h"
+#include "frame_parser.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <span>
+#include <vector>
+#include <poll.h>
+
+// 主机端C++客户端：与固件共用protocol.c（TLV、组帧）、frame_parser.c/frame_writer.c和crc32.c，
+// 供Linux网关直接访问从机，不经过App的CommunicationManager。
+// - 每个端口（串口、伪终端或套接字）独立组帧和解析，请求用COBS组帧（设置了地址时为带地址的版本）
+// - request()不阻塞：组帧后写出并立即返回数据包编号，应答按响应编号交给回调；
+//   每个端口最多window个请求在途，其余按提交顺序排队，应答或超时后依次发出
+// - 一个事件循环处理所有端口：run_once()调用poll()等待任一端口可读/可写或最近的超时，
+//   也可用fill_pollfds()/next_timeout_ms()/dispatch()接入外部的事件循环
+// - 没有对应请求的帧（订阅推送、报警事件、挂起命令迟到的应答）交给on_push()的处理函数，
+//   subt的SF流帧交给on_stream()的处理函数
+// 回调在run_once()/dispatch()中调用，可在回调中提交新请求。单线程使用，不加锁
+namespace protocol_client {
+
+// 请求的结果
+enum class Outcome : uint8_t {
+    response,    // 收到应答（PKT_TYPE_SLAVE_RESPONSE/COMPACT），状态见Response::status
+    error_frame, // 从机回复错误帧（PKT_TYPE_SLAVE_ERROR），错误码见Response::error_code
+    timeout,     // 超时未应答
+    closed,      // 端口关闭或读写出错
+};
+
+// 收到的帧；payload指向解析器缓冲区，只在回调中有效
+struct Response {
+    int port = -1;
+    uint8_t type = 0;
+    uint16_t packet_id = 0;
+    uint16_t response_id = 0;
+    uint8_t status = STATUS_INTERNAL_ERROR; // ST，错误帧和超时为STATUS_INTERNAL_ERROR
+    uint8_t error_code = 0;                 // 错误帧的EC
+    std::span<const uint8_t> payload;       // 数据部分（TLV）
+
+    // DA字段的值（紧凑响应为ST之后的部分），没有时为空
+    std::span<const uint8_t> data() const;
+};
+
+// 收到的流帧（PROTOCOL_VERSION_STREAM）；payload指向解析器缓冲区，只在回调中有效
+struct StreamFrame {
+    int port = -1;
+    uint8_t stream_id = 0;
+    uint8_t sequence = 0;               // 每帧加1，回绕；不连续说明中间有帧丢失
+    std::span<const uint8_t> payload;   // 各传感器的int16读数（小端，0.1°C）
+
+    size_t sensor_count() const { return payload.size() / 2; }
+    int16_t reading(size_t sensor) const;
+};
+
+using Callback = std::function<void(Outcome, const Response &)>;
+using PushHandler = std::function<void(const Response &)>;
+using StreamHandler = std::function<void(const StreamFrame &)>;
+
+class Client {
+public:
+    static constexpr size_t default_window = 4;
+    static constexpr uint32_t default_timeout_ms = 1000;
+
+    Client() = default;
+    ~Client();
+    Client(const Client &) = delete;
+    Client &operator=(const Client &) = delete;
+
+    // 打开串口（8N1，原始模式），返回端口编号，不支持的波特率或打开失败返回-1
+    int open_serial(const char *path, uint32_t baud);
+
+    // 使用已打开的文件描述符（伪终端、套接字），设为非阻塞；owned时close()关闭它
+    int attach(int fd, bool owned);
+
+    // 关闭端口：在途和排队的请求以Outcome::closed结束
+    void close(int port);
+
+    // 每个端口的在途请求数上限（从机按COMM_REQUEST_SLOTS排队，超出时回复BUSY）
+    void set_window(int port, size_t window);
+
+    // 设置目标地址（RS-485多点总线），之后的请求使用带地址的COBS帧；PROTOCOL_ADDRESS_NONE为不带地址
+    void set_address(int port, uint8_t address);
+
+    void on_push(PushHandler handler);
+    void on_stream(StreamHandler handler);
+
+    // 提交请求：data为DA字段的内容（TLV），组帧后写出或排队，返回数据包编号；
+    // 端口无效或请求超长时返回-1且不调用回调
+    int request(int port, const char *instruction, std::span<const uint8_t> data, Callback callback,
+                uint32_t timeout_ms = default_timeout_ms);
+
+    // 端口在途（已写出、未应答）和排队的请求数
+    size_t in_flight(int port) const;
+    size_t queued(int port) const;
+    // 所有端口在途和排队的请求总数
+    size_t outstanding() const;
+
+    // 等待最多timeout_ms（-1为直到下一个超时或事件），处理就绪的端口和到期的请求，
+    // 返回结束的请求数；poll()出错返回-1
+    int run_once(int timeout_ms);
+
+    // 接入外部事件循环：按端口填写pollfd（fds[i]对应ports()[i]），poll()之后把结果交给dispatch()
+    void fill_pollfds(std::vector<pollfd> &fds, std::vector<int> &ports) const;
+    int next_timeout_ms() const;
+    int dispatch(const std::vector<pollfd> &fds, const std::vector<int> &ports);
+
+private:
+    struct Pending {
+        Callback callback;
+        uint64_t deadline_ms;
+        uint32_t timeout_ms;
+    };
+    struct Queued {
+        uint16_t packet_id;
+        std::vector<uint8_t> frame;
+        Callback callback;
+        uint32_t timeout_ms;
+    };
+    struct Port {
+        int fd = -1;
+        bool owned = false;
+        uint8_t address = PROTOCOL_ADDRESS_NONE;
+        size_t window = default_window;
+        uint16_t next_id = 1;
+        FrameParser parser;
+        uint8_t frame[MAX_PACKET_SIZE];
+        std::vector<uint8_t> tx;          // 尚未写出的字节（串口缓冲区满时）
+        std::map<uint16_t, Pending> pending;
+        std::deque<Queued> queue;
+    };
+
+    Port *find(int port) const;
+    uint16_t allocate_id(Port &port);
+    void start_next(int port_id, Port &port, uint64_t now);
+    bool flush(Port &port);
+    int receive(int port_id, Port &port);
+    int handle_frame(int port_id, Port &port);
+    int expire(uint64_t now);
+    int fail_port(int port_id);
+
+    std::vector<std::unique_ptr<Port>> ports_;
+    PushHandler push_handler_;
+    StreamHandler stream_handler_;
+};
+
+} // namespace protocol_client
+
+#endif // PROTOCOL_CLIENT_HPP
@@ -0,0 +1,234 @@
+#include "command_list.h"
+#include "command_handler.h"
+#include "tlv_schema.h"
+#include <stdio.h>
+
+// 由命令清单（command_list.h）和字段表（tlv_schema.c）生成主机端绑定：
+//   TypeScript模块：命令编号、名称、类别和各层字段定义
+//   C++头文件：同样内容的constexpr表，可在编译期按名称查找命令
+// 嵌套的字段表按对象去重，子表先于引用它的表输出
+// 用法：schema_gen <输出.ts> <输出.hpp>
+
+typedef struct {
+    uint8_t opcode;
+    const char *name;
+    uint8_t command_class;
+} CommandInfo;
+
+#define COMMAND_INFO_ENTRY(op, name, handler, cls, request, response) \
+    {op, name, COMMAND_CLASS_##cls},
+static const CommandInfo commands[] = {
+    COMMAND_LIST(COMMAND_INFO_ENTRY)
+};
+#define COMMAND_INFO_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+// 去重后的字段表（请求、响应和嵌套层）上限
+#define MAX_SCHEMAS 96
+
+static const TlvSchema *schemas[MAX_SCHEMAS];
+static size_t schema_count = 0;
+
+static int schema_id(const TlvSchema *schema) {
+    for (size_t i = 0; i < schema_count; i++) {
+        if (schemas[i] == schema) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// 深度优先收集，子表排在前面
+static void collect(const TlvSchema *schema) {
+    if (!schema || schema_id(schema) >= 0 || schema_count >= MAX_SCHEMAS) {
+        return;
+    }
+    for (uint8_t i = 0; i < schema->count; i++) {
+        if (schema->fields[i].type == TLV_TYPE_LIST) {
+            collect(schema->fields[i].children);
+        }
+    }
+    schemas[schema_count++] = schema;
+}
+
+static const char *const ts_types[] = {
+    [TLV_TYPE_RAW] = "Raw", [TLV_TYPE_UINT8] = "Uint8", [TLV_TYPE_UINT16] = "Uint16",
+    [TLV_TYPE_UINT32] = "Uint32", [TLV_TYPE_UINT64] = "Uint64", [TLV_TYPE_FLOAT32] = "Float32",
+    [TLV_TYPE_STRING] = "String", [TLV_TYPE_TEMPERATURE] = "Temperature", [TLV_TYPE_LIST] = "List",
+};
+
+// 标签固定2字节，单字符标签（如报警规则的"L"、"H"）第2字节为0，以\0写出
+static void write_tag(FILE *out, const char tag[2]) {
+    fputc('"', out);
+    for (int i = 0; i < 2; i++) {
+        if (tag[i] == '\0') {
+            fputs("\\0", out);
+        } else {
+            fputc(tag[i], out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void write_ts(FILE *out) {
+    fprintf(out, "// 由host/schema_gen根据command_list.h和tlv_schema.c生成，请勿手工修改\n\n");
+    fprintf(out, "export const SCHEMA_VERSION = %d;\n\n", TLV_SCHEMA_VERSION);
+    fprintf(out, "export enum TlvType {\n");
+    for (size_t t = 0; t < sizeof(ts_types) / sizeof(ts_types[0]); t++) {
+        fprintf(out, "  %s = %zu,\n", ts_types[t], t);
+    }
+    fprintf(out, "}\n\n");
+    fprintf(out, "export interface FieldDef {\n"
+                 "  readonly tag: string;\n"
+                 "  readonly type: TlvType;\n"
+                 "  readonly since: number;\n"
+                 "  readonly children?: readonly FieldDef[];\n"
+                 "}\n\n");
+    fprintf(out, "export interface CommandDef {\n"
+                 "  readonly opcode: number;\n"
+                 "  readonly name: string;\n"
+                 "  readonly bulk: boolean;\n"
+                 "  readonly request: readonly FieldDef[];\n"
+                 "  readonly response: readonly FieldDef[];\n"
+                 "}\n\n");
+
+    for (size_t s = 0; s < schema_count; s++) {
+        fprintf(out, "const SCHEMA_%zu: readonly FieldDef[] = [\n", s);
+        for (uint8_t i = 0; i < schemas[s]->count; i++) {
+            const TlvFieldDef *field = &schemas[s]->fields[i];
+            fprintf(out, "  { tag: ");
+            write_tag(out, field->tag);
+            fprintf(out, ", type: TlvType.%s, since: %u", ts_types[field->type], field->since);
+            if (field->type == TLV_TYPE_LIST) {
+                fprintf(out, ", children: SCHEMA_%d", schema_id(field->children));
+            }
+            fprintf(out, " },\n");
+        }
+        fprintf(out, "];\n\n");
+    }
+
+    fprintf(out, "export const COMMANDS: readonly CommandDef[] = [\n");
+    for (size_t c = 0; c < COMMAND_INFO_COUNT; c++) {
+        int request = schema_id(tlv_schema_request(commands[c].opcode));
+        int response = schema_id(tlv_schema_response(commands[c].opcode));
+        fprintf(out, "  { opcode: 0x%02X, name: \"%s\", bulk: %s, ", commands[c].opcode, commands[c].name,
+                commands[c].command_class == COMMAND_CLASS_BULK ? "true" : "false");
+        if (request >= 0) {
+            fprintf(out, "request: SCHEMA_%d, ", request);
+        } else {
+            fprintf(out, "request: [], ");
+        }
+        if (response >= 0) {
+            fprintf(out, "response: SCHEMA_%d },\n", response);
+        } else {
+            fprintf(out, "response: [] },\n");
+        }
+    }
+    fprintf(out, "];\n\n");
+    fprintf(out, "export const COMMAND_BY_NAME: ReadonlyMap<string, CommandDef> =\n"
+                 "  new Map(COMMANDS.map((command) => [command.name, command]));\n");
+}
+
+static void write_hpp(FILE *out) {
+    fprintf(out, "// 由host/schema_gen根据command_list.h和tlv_schema.c生成，请勿手工修改\n");
+    fprintf(out, "#pragma once\n\n#include <cstddef>\n#include <cstdint>\n#include <span>\n#include <string_view>\n\n");
+    fprintf(out, "namespace protocol_schema {\n\n");
+    fprintf(out, "inline constexpr std::uint8_t schema_version = %d;\n\n", TLV_SCHEMA_VERSION);
+    fprintf(out, "// 与TlvType取值相同\nenum class TlvType : std::uint8_t {\n");
+    for (size_t t = 0; t < sizeof(ts_types) / sizeof(ts_types[0]); t++) {
+        fprintf(out, "    %s = %zu,\n", ts_types[t], t);
+    }
+    fprintf(out, "};\n\n");
+    fprintf(out, "struct FieldDef {\n"
+                 "    std::string_view tag;\n"
+                 "    TlvType type;\n"
+                 "    std::uint8_t since;\n"
+                 "    std::span<const FieldDef> children;\n"
+                 "};\n\n");
+    fprintf(out, "struct CommandDef {\n"
+                 "    std::uint8_t opcode;\n"
+                 "    std::string_view name;\n"
+                 "    bool bulk;\n"
+                 "    std::span<const FieldDef> request;\n"
+                 "    std::span<const FieldDef> response;\n"
+                 "};\n\n");
+
+    for (size_t s = 0; s < schema_count; s++) {
+        fprintf(out, "inline constexpr FieldDef schema_%zu[] = {\n", s);
+        for (uint8_t i = 0; i < schemas[s]->count; i++) {
+            const TlvFieldDef *field = &schemas[s]->fields[i];
+            fprintf(out, "    {{");
+            write_tag(out, field->tag);
+            fprintf(out, ", 2}, TlvType::%s, %u, ", ts_types[field->type], field->since);
+            if (field->type == TLV_TYPE_LIST) {
+                fprintf(out, "schema_%d},\n", schema_id(field->children));
+            } else {
+                fprintf(out, "{}},\n");
+            }
+        }
+        fprintf(out, "};\n\n");
+    }
+
+    fprintf(out, "inline constexpr CommandDef commands[] = {\n");
+    for (size_t c = 0; c < COMMAND_INFO_COUNT; c++) {
+        int request = schema_id(tlv_schema_request(commands[c].opcode));
+        int response = schema_id(tlv_schema_response(commands[c].opcode));
+        fprintf(out, "    {0x%02X, \"%s\", %s, ", commands[c].opcode, commands[c].name,
+                commands[c].command_class == COMMAND_CLASS_BULK ? "true" : "false");
+        if (request >= 0) {
+            fprintf(out, "schema_%d, ", request);
+        } else {
+            fprintf(out, "{}, ");
+        }
+        if (response >= 0) {
+            fprintf(out, "schema_%d},\n", response);
+        } else {
+            fprintf(out, "{}},\n");
+        }
+    }
+    fprintf(out, "};\n\n");
+    fprintf(out, "// 按名称查找命令，未定义返回nullptr\n"
+                 "constexpr const CommandDef *find_command(std::string_view name) {\n"
+                 "    for (const CommandDef &command : commands) {\n"
+                 "        if (command.name == name) {\n"
+                 "            return &command;\n"
+                 "        }\n"
+                 "    }\n"
+                 "    return nullptr;\n"
+                 "}\n\n");
+    fprintf(out, "// 在一层字段表中查找标签（2字节，单字符标签为\"L\\0\"形式），返回字段下标，未定义返回-1\n"
+                 "constexpr int find_field(std::span<const FieldDef> schema, std::string_view tag) {\n"
+                 "    for (std::size_t i = 0; i < schema.size(); i++) {\n"
+                 "        if (schema[i].tag == tag) {\n"
+                 "            return static_cast<int>(i);\n"
+                 "        }\n"
+                 "    }\n"
+                 "    return -1;\n"
+                 "}\n\n");
+    fprintf(out, "} // namespace protocol_schema\n");
+}
+
+static bool write_file(const char *path, void (*writer)(FILE *)) {
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        perror(path);
+        return false;
+    }
+    writer(out);
+    return fclose(out) == 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "用法：%s <输出.ts> <输出.hpp>\n", argv[0]);
+        return 2;
+    }
+    for (size_t c = 0; c < COMMAND_INFO_COUNT; c++) {
+        collect(tlv_schema_request(commands[c].opcode));
+        collect(tlv_schema_response(commands[c].opcode));
+    }
+    if (schema_count >= MAX_SCHEMAS) {
+        fprintf(stderr, "字段表超过%d个，请增大MAX_SCHEMAS\n", MAX_SCHEMAS);
+        return 1;
+    }
+    return write_file(argv[1], write_ts) && write_file(argv[2], write_hpp) ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+#ifndef HOST_SHIM_CMSIS_OS_H
+#define HOST_SHIM_CMSIS_OS_H
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 主机构建：协议栈只用到延时，模拟层中推进模拟时钟后立即返回
+typedef enum {
+    osOK = 0,
+    osError = -1
+} osStatus_t;
+
+osStatus_t osDelay(uint32_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_SHIM_CMSIS_OS_H
@@ -0,0 +1,21 @@
+#ifndef HOST_SHIM_MAIN_H
+#define HOST_SHIM_MAIN_H
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 主机构建：替代CubeMX生成的main.h，HAL只保留协议栈用到的毫秒时基。
+// HAL_GetTick()返回模拟时钟，由测试调用host_advance_ms()推进
+uint32_t HAL_GetTick(void);
+
+void Error_Handler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_SHIM_MAIN_H
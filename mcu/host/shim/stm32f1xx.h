@@ -0,0 +1,31 @@
+#ifndef HOST_SHIM_STM32F1XX_H
+#define HOST_SHIM_STM32F1XX_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 主机构建：替代CMSIS设备头文件，只提供协议栈用到的内核寄存器和内建函数。
+// DWT周期计数是普通变量，由模拟层推进（host_advance_cycles()）
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+} HostDwt;
+
+extern HostDwt host_dwt;
+#define DWT (&host_dwt)
+
+// 主机上没有中断，屏蔽中断的临界区退化为空操作
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t primask) { (void)primask; }
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+static inline uint32_t __get_IPSR(void) { return 0; }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_SHIM_STM32F1XX_H
@@ -0,0 +1,109 @@
+#include "host_mock.h"
+#include "command_handler.h"
+#include "response_cache.h"
+#include "admission.h"
+#include "protocol.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+// 请求准入经命令处理的测试：command_handler.c按COMMAND_ADMISSION=1单独编译（protocol_host中不限流），
+// 时间由模拟时钟推进。超出速率时以BUSY和RA应答，批量类消耗ADMISSION_BULK_COST个令牌，
+// fack不受限，被拒绝的应答不进入重复请求的缓存
+
+static CommandScratch scratch;
+
+typedef struct {
+    uint8_t status;
+    bool has_retry;
+    uint32_t retry_ms;
+    uint8_t busy_count; // 批量应答中BUSY的条数
+} Reply;
+
+static Reply send_request(const char *const *instructions, uint8_t count, uint16_t packet_id) {
+    uint8_t request[64];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint16_t response_len = 0;
+    int req_len = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        req_len += write_tlv_string(request + req_len, sizeof(request) - req_len, TAG_INSTRUCTION, instructions[i]);
+    }
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, packet_id, &scratch) == 0);
+
+    PacketHeader header;
+    uint8_t data[MAX_PACKET_SIZE];
+    int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 0);
+    Reply reply = { 0 };
+    assert(read_tlv_uint8(data, data_len, TAG_STATUS, &reply.status) > 0);
+    const uint8_t *da;
+    uint16_t da_len;
+    if (read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0) {
+        reply.has_retry = read_tlv_uint32(da, da_len, TAG_RETRY_AFTER, &reply.retry_ms) > 0;
+    }
+    // 批量应答为依次排列的IN/ST/DA
+    for (int i = 0; i + 4 <= data_len; ) {
+        uint16_t length = (uint16_t)(data[i + 2] | (data[i + 3] << 8));
+        if (memcmp(data + i, TAG_STATUS, 2) == 0 && length == 1 && data[i + 4] == STATUS_BUSY) {
+            reply.busy_count++;
+        }
+        i += 4 + length;
+    }
+    return reply;
+}
+
+static Reply send_one(const char *instruction, uint16_t packet_id) {
+    return send_request(&instruction, 1, packet_id);
+}
+
+int main(void) {
+    host_reset();
+    command_handler_init();
+    host_set_link(COMM_LINK_WIRED);
+    uint16_t packet_id = 0x0100;
+
+    // 批量类每条消耗ADMISSION_BULK_COST个令牌，把桶用完后被拒绝，RA为攒够一条所需的时间
+    for (uint8_t i = 0; i < ADMISSION_BURST / ADMISSION_BULK_COST; i++) {
+        assert(send_one(CMD_GET_SENSORS, packet_id++).status == STATUS_OK);
+    }
+    Reply reply = send_one(CMD_GET_SENSORS, packet_id++);
+    assert(reply.status == STATUS_BUSY && reply.has_retry);
+    assert(reply.retry_ms == ADMISSION_BULK_COST * ADMISSION_REFILL_MS);
+
+    // 交互类还可以透支ADMISSION_RESERVE个，之后同样被拒绝
+    for (uint8_t i = 0; i < ADMISSION_RESERVE; i++) {
+        assert(send_one(CMD_PING, packet_id++).status == STATUS_OK);
+    }
+    uint16_t refused_id = packet_id++;
+    reply = send_one(CMD_PING, refused_id);
+    assert(reply.status == STATUS_BUSY && reply.has_retry && reply.retry_ms == ADMISSION_REFILL_MS);
+
+    // 批量请求中的每条命令分别申请，全部被拒绝
+    static const char *const batch[] = { CMD_PING, CMD_GET_TEMP };
+    reply = send_request(batch, 2, packet_id++);
+    assert(reply.busy_count == 2);
+
+    // fack不消耗令牌，照常交给处理函数（没有DA时参数错误，不是BUSY）
+    reply = send_one(CMD_FRAGMENT_ACK, packet_id++);
+    assert(reply.status != STATUS_BUSY && !reply.has_retry);
+
+    // 等到RA之后用同一个包编号重发：重新执行，不重放缓存的BUSY
+    uint32_t replays = response_cache_replays();
+    host_advance_ms(ADMISSION_REFILL_MS);
+    reply = send_one(CMD_PING, refused_id);
+    assert(reply.status == STATUS_OK && !reply.has_retry);
+    assert(response_cache_replays() == replays);
+
+    // 已接受的应答照常缓存：再重发一次时重放，不消耗令牌
+    reply = send_one(CMD_PING, refused_id);
+    assert(reply.status == STATUS_OK && response_cache_replays() == replays + 1);
+    reply = send_one(CMD_PING, packet_id++);
+    assert(reply.status == STATUS_BUSY);
+
+    // 每条链路一个桶：其他链路不受影响
+    host_set_link(COMM_LINK_BLE);
+    assert(send_one(CMD_PING, packet_id++).status == STATUS_OK);
+
+    printf("admission tests passed\n");
+    return 0;
+}
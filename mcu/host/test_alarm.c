@@ -0,0 +1,391 @@
+#include "device_control.h"
+#include "config_store.h"
+#include "log_store.h"
+#include "main.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+// 报警引擎的测试：直接编译固件的alarm.c（protocol_host中的mock_device.c只比较上下限），
+// 输出、闪存和时钟由本文件提供。采样每秒一次，按采样任务的方式调用alarm_check_temperatures()
+
+#define EVENT_CAPACITY 64
+
+static uint32_t tick_ms;
+static LogEventPayload events[EVENT_CAPACITY];
+static uint8_t event_count;
+static uint32_t burst_chunks;
+static bool buzzer;
+static bool led;
+static uint8_t buzzer_switches; // 输出切换的次数：报警期间不重复打开
+static uint8_t led_switches;
+
+uint32_t HAL_GetTick(void) {
+    return tick_ms;
+}
+
+uint64_t rtc_get_timestamp_ms(void) {
+    return 1750689000000ULL + tick_ms;
+}
+
+void config_store_init(void) {
+}
+
+const void *config_store_find(uint8_t key, uint16_t *length) {
+    (void)key;
+    *length = 0;
+    return NULL;
+}
+
+bool log_store_append(uint8_t stream, uint64_t timestamp_ms, const void *payload) {
+    (void)timestamp_ms;
+    if (stream == LOG_STREAM_EVENTS) {
+        assert(event_count < EVENT_CAPACITY);
+        memcpy(&events[event_count++], payload, sizeof(LogEventPayload));
+    } else if (stream == LOG_STREAM_BURSTS) {
+        burst_chunks++;
+    }
+    return true;
+}
+
+void buzzer_on(void) {
+    assert(!buzzer);
+    buzzer = true;
+    buzzer_switches++;
+}
+
+void buzzer_off(void) {
+    assert(buzzer);
+    buzzer = false;
+    buzzer_switches++;
+}
+
+void led_on(void) {
+    assert(!led);
+    led = true;
+    led_switches++;
+}
+
+void led_off(void) {
+    assert(led);
+    led = false;
+    led_switches++;
+}
+
+// 停用全部规则（默认规则0、1为任一传感器-40.0~80.0°C），上一个测试中报警的规则随之解除，
+// 再采样到报警前后记录收集完毕；之后由各测试逐条配置
+static void reset(void) {
+    alarm_init();
+    for (uint8_t i = 0; i < MAX_ALARMS; i++) {
+        AlarmConfig config;
+        alarm_get_config(i, &config);
+        config.enabled = 0;
+        alarm_set_config(&config);
+    }
+    int16_t none = TEMP_INVALID;
+    for (uint8_t i = 0; i <= ALARM_BURST_POST_SAMPLES; i++) {
+        tick_ms += 1000;
+        alarm_check_temperatures(&none, 1);
+        alarm_burst_sample(&none, 1);
+    }
+    assert(alarm_get_active_mask() == 0 && !buzzer && !led);
+    event_count = 0;
+    burst_chunks = 0;
+    buzzer_switches = 0;
+    led_switches = 0;
+}
+
+// 经过1秒后的一次采样
+static void sample(const int16_t *temperatures, uint8_t count) {
+    tick_ms += 1000;
+    alarm_check_temperatures(temperatures, count);
+    alarm_burst_sample(temperatures, count);
+}
+
+static void sample_one(int16_t temperature) {
+    sample(&temperature, 1);
+}
+
+static void check_event(uint8_t index, uint8_t channel, uint8_t type, uint8_t sensor, int16_t temperature) {
+    assert(index < event_count);
+    const LogEventPayload *event = &events[index];
+    assert(event->channel == channel && event->type == type && event->sensor == sensor);
+    assert(event->temperature == temperature);
+}
+
+static void set_rule(uint8_t id, int16_t low, int16_t high, int16_t hysteresis, uint16_t delay_s,
+                     uint8_t sensor, uint8_t actions) {
+    AlarmConfig config = {
+        .id = id, .low_temp = low, .high_temp = high, .hysteresis = hysteresis, .delay_s = delay_s,
+        .sensor = sensor, .actions = actions, .enabled = 1,
+    };
+    assert(alarm_config_valid(&config));
+    alarm_set_config(&config);
+}
+
+// 持续超限DL秒才进入，中途回到范围内重新计时；进入后打开一次输出
+static void test_enter_delay(void) {
+    reset();
+    set_rule(0, 0, 300, 20, 5, 0, ALARM_ACTION_BUZZER);
+    sample_one(250);
+
+    // 超限3秒后回落：重新计时
+    for (uint8_t i = 0; i < 3; i++) {
+        sample_one(310);
+    }
+    sample_one(290);
+    assert(alarm_get_active_mask() == 0);
+
+    // 第一次超限后满5秒（第6次采样）进入
+    for (uint8_t i = 0; i < 5; i++) {
+        sample_one(310 + i);
+        assert(alarm_get_active_mask() == 0 && event_count == 0);
+    }
+    sample_one(320);
+    assert(alarm_get_active_mask() == 1U && buzzer && buzzer_switches == 1);
+    assert(event_count == 1);
+    check_event(0, 0, ALARM_EVENT_ENTER, 0, 320);
+
+    // 报警期间不重复记录事件和切换输出
+    for (uint8_t i = 0; i < 10; i++) {
+        sample_one(330);
+    }
+    assert(event_count == 1 && buzzer_switches == 1);
+
+    // DL为0时立即进入
+    reset();
+    set_rule(1, 0, 300, 0, 0, ALARM_SENSOR_ANY, ALARM_ACTION_LED);
+    sample_one(250);
+    sample_one(-1);
+    assert(alarm_get_active_mask() == 2U && led && led_switches == 1);
+    check_event(0, 1, ALARM_EVENT_ENTER, 0, -1);
+}
+
+// 回到[L + HY, H - HY]内才解除，回差带内保持报警
+static void test_hysteresis(void) {
+    reset();
+    set_rule(0, 0, 300, 20, 0, 0, ALARM_ACTION_BUZZER);
+    sample_one(250);
+    sample_one(301);
+    assert(alarm_get_active_mask() == 1U && buzzer);
+
+    // 回到上限以内、回差带内：保持
+    static const int16_t band[] = { 300, 295, 285, 281 };
+    for (uint8_t i = 0; i < sizeof(band) / sizeof(band[0]); i++) {
+        sample_one(band[i]);
+        assert(alarm_get_active_mask() == 1U && buzzer && event_count == 1);
+    }
+    // 28.0°C为解除范围的边界
+    sample_one(280);
+    assert(alarm_get_active_mask() == 0 && !buzzer && buzzer_switches == 2);
+    assert(event_count == 2);
+    check_event(1, 0, ALARM_EVENT_LEAVE, 0, 280);
+
+    // 下限一侧相同
+    sample_one(-1);
+    assert(alarm_get_active_mask() == 1U);
+    sample_one(19);
+    assert(alarm_get_active_mask() == 1U);
+    sample_one(20);
+    assert(alarm_get_active_mask() == 0 && event_count == 4);
+    check_event(2, 0, ALARM_EVENT_ENTER, 0, -1);
+    check_event(3, 0, ALARM_EVENT_LEAVE, 0, 20);
+
+    // 报警中的规则停用后立即解除
+    sample_one(400);
+    assert(alarm_get_active_mask() == 1U && buzzer);
+    AlarmConfig config;
+    alarm_get_config(0, &config);
+    config.enabled = 0;
+    alarm_set_config(&config);
+    sample_one(400);
+    assert(alarm_get_active_mask() == 0 && !buzzer);
+    check_event(5, 0, ALARM_EVENT_LEAVE, 0, 400);
+}
+
+// 输出按报警中的规则的动作之和：共用蜂鸣器的两条规则都解除后才关闭
+static void test_outputs(void) {
+    reset();
+    set_rule(0, 0, 300, 0, 0, 0, ALARM_ACTION_BUZZER);
+    set_rule(1, 0, 300, 0, 0, 1, ALARM_ACTION_BUZZER | ALARM_ACTION_LED);
+    int16_t t[2] = { 250, 250 };
+    sample(t, 2);
+
+    t[0] = 310;
+    sample(t, 2);
+    assert(alarm_get_active_mask() == 1U && buzzer && !led);
+    t[1] = 310;
+    sample(t, 2);
+    assert(alarm_get_active_mask() == 3U && buzzer && led && buzzer_switches == 1 && led_switches == 1);
+    check_event(1, 1, ALARM_EVENT_ENTER, 1, 310);
+
+    t[0] = 250;
+    sample(t, 2);
+    assert(alarm_get_active_mask() == 2U && buzzer && led && buzzer_switches == 1);
+    t[1] = 250;
+    sample(t, 2);
+    assert(alarm_get_active_mask() == 0 && !buzzer && !led && buzzer_switches == 2 && led_switches == 2);
+
+    // 任一传感器：记录第一个超限的传感器
+    reset();
+    set_rule(0, 0, 300, 0, 0, ALARM_SENSOR_ANY, ALARM_ACTION_BUZZER);
+    int16_t any[3] = { 250, 350, 360 };
+    sample(any, 3);
+    assert(alarm_get_active_mask() == 1U);
+    check_event(0, 0, ALARM_EVENT_ENTER, 1, 350);
+}
+
+// 读取失败的传感器不会触发报警
+static void test_failed_sensor_enter(void) {
+    reset();
+    set_rule(0, 0, 300, 0, 0, ALARM_SENSOR_ANY, ALARM_ACTION_BUZZER);
+    int16_t t[2] = { TEMP_INVALID, 250 };
+    for (uint8_t i = 0; i < 5; i++) {
+        sample(t, 2);
+    }
+    assert(alarm_get_active_mask() == 0 && event_count == 0 && !buzzer);
+}
+
+// 报警中的传感器读取失败（掉线）：保持报警和输出，重新读到解除范围内的温度后才解除
+static void test_failed_sensor_active(void) {
+    reset();
+    set_rule(0, 0, 300, 20, 0, 0, ALARM_ACTION_BUZZER);
+    sample_one(250);
+    sample_one(350);
+    assert(alarm_get_active_mask() == 1U && buzzer && event_count == 1);
+    for (uint8_t i = 0; i < 10; i++) {
+        sample_one(TEMP_INVALID);
+        assert(alarm_get_active_mask() == 1U && buzzer && event_count == 1);
+    }
+    sample(NULL, 0); // 总线上没有传感器
+    assert(alarm_get_active_mask() == 1U && buzzer);
+    sample_one(290); // 回差带内
+    assert(alarm_get_active_mask() == 1U);
+    sample_one(250);
+    assert(alarm_get_active_mask() == 0 && !buzzer && event_count == 2);
+    check_event(1, 0, ALARM_EVENT_LEAVE, 0, 250);
+
+    // 任一传感器：触发的传感器掉线时，其他传感器在范围内也不解除
+    reset();
+    set_rule(0, 0, 300, 20, 0, ALARM_SENSOR_ANY, ALARM_ACTION_BUZZER);
+    int16_t t[2] = { 250, 250 };
+    sample(t, 2);
+    t[1] = 350;
+    sample(t, 2);
+    assert(alarm_get_active_mask() == 1U);
+    check_event(0, 0, ALARM_EVENT_ENTER, 1, 350);
+    t[1] = TEMP_INVALID;
+    for (uint8_t i = 0; i < 5; i++) {
+        sample(t, 2);
+        assert(alarm_get_active_mask() == 1U && buzzer);
+    }
+    t[1] = 250;
+    sample(t, 2);
+    assert(alarm_get_active_mask() == 0 && !buzzer);
+    check_event(1, 0, ALARM_EVENT_LEAVE, 1, 250);
+}
+
+// 按0.1°C量化、每秒采样的匀速变化：第k次采样时start + rate × k / 60（rate为0.1°C/分钟）
+static int16_t ramp(int16_t start, int32_t rate, uint32_t k) {
+    int32_t delta = rate * (int32_t)k;
+    return (int16_t)(start + (delta + (delta < 0 ? -30 : 30)) / 60);
+}
+
+// 按ramp采样，返回进入报警前的采样次数（limit次内没有进入时返回limit）
+static uint32_t ramp_until_active(int16_t start, int32_t rate, uint32_t limit) {
+    uint32_t k = 0;
+    for (; k < limit && alarm_get_active_mask() == 0; k++) {
+        sample_one(ramp(start, rate, k));
+    }
+    return k;
+}
+
+// 保持温度不变，返回解除前的采样次数
+static uint32_t hold_until_cleared(int16_t temperature, uint32_t limit) {
+    uint32_t k = 0;
+    for (; k < limit && alarm_get_active_mask() != 0; k++) {
+        sample_one(temperature);
+    }
+    return k;
+}
+
+static void set_rate_rule(int16_t low, int16_t high, int16_t rate, uint16_t window_s, uint16_t horizon_s) {
+    AlarmConfig config = {
+        .id = 0, .low_temp = low, .high_temp = high, .rate = rate, .window_s = window_s,
+        .horizon_s = horizon_s, .sensor = 0, .actions = ALARM_ACTION_BUZZER, .enabled = 1,
+    };
+    assert(alarm_config_valid(&config));
+    alarm_set_config(&config);
+}
+
+// 速率（RT）和预测（PH）：斜率按WS平均，每次的修正远小于0.1°C/分钟时也要累积，
+// 回到平稳后斜率衰减到0，规则解除
+static void test_rate(void) {
+    // 5°C/分钟超过4°C/分钟：时间常数60秒，约100秒后进入
+    reset();
+    set_rate_rule(-400, 800, 40, 60, 0);
+    uint32_t k = ramp_until_active(250, 50, 600);
+    assert(k > 30 && k < 300);
+    check_event(0, 0, ALARM_EVENT_ENTER, 0, ramp(250, 50, k - 1));
+    assert(hold_until_cleared(ramp(250, 50, k - 1), 600) < 600);
+
+    // 下降时相同
+    reset();
+    set_rate_rule(-400, 800, 40, 60, 0);
+    k = ramp_until_active(250, -50, 600);
+    assert(k > 30 && k < 300);
+    assert(hold_until_cleared(ramp(250, -50, k - 1), 600) < 600);
+
+    // 长窗口：10°C/分钟超过8°C/分钟，时间常数300秒，约480秒后进入
+    reset();
+    set_rate_rule(-500, 3000, 80, 300, 0);
+    k = ramp_until_active(0, 100, 1500);
+    assert(k > 150 && k < 1500);
+    assert(hold_until_cleared(ramp(0, 100, k - 1), 3000) < 3000);
+
+    // 没有超过RT时不进入
+    reset();
+    set_rate_rule(-500, 3000, 80, 300, 0);
+    assert(ramp_until_active(0, 60, 2000) == 2000);
+
+    // 预测：以-5°C/分钟从35.0°C降到29.0°C，预测10分钟后低于27.0°C而进入；
+    // 停在29.0°C后斜率衰减到0，预测值回到下限以上后解除
+    reset();
+    set_rate_rule(270, 800, 0, 60, 600);
+    for (uint8_t i = 0; i < 120; i++) {
+        sample_one(350);
+    }
+    assert(alarm_get_active_mask() == 0);
+    for (k = 0; ramp(350, -50, k) >= 290; k++) {
+        sample_one(ramp(350, -50, k));
+    }
+    assert(alarm_get_active_mask() == 1U);
+    assert(hold_until_cleared(290, 1200) < 1200);
+    check_event(1, 0, ALARM_EVENT_LEAVE, 0, 290);
+}
+
+// 报警前后记录：进入报警后收集够之后的读数，分块写入
+static void test_burst(void) {
+    reset();
+    set_rule(0, 0, 300, 0, 0, 0, ALARM_ACTION_BUZZER);
+    for (uint8_t i = 0; i < ALARM_BURST_PRE_SAMPLES; i++) {
+        sample_one(250);
+    }
+    sample_one(310);
+    for (uint8_t i = 0; i < ALARM_BURST_POST_SAMPLES; i++) {
+        sample_one(310);
+    }
+    assert(burst_chunks == ALARM_BURST_CHUNKS);
+}
+
+int main(void) {
+    test_enter_delay();
+    test_hysteresis();
+    test_outputs();
+    test_failed_sensor_enter();
+    test_failed_sensor_active();
+    test_rate();
+    test_burst();
+    printf("alarm tests passed\n");
+    return 0;
+}
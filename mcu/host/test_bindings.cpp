@@ -0,0 +1,46 @@
+#include "protocol_schema.hpp"
+#include "command_list.h"
+#include "tlv_schema.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+// 生成的C++绑定与固件的命令表、字段表一致
+
+namespace ps = protocol_schema;
+
+// 编译期按名称查找
+static_assert(ps::schema_version == TLV_SCHEMA_VERSION);
+static_assert(ps::find_command(CMD_BENCH) != nullptr && ps::find_command(CMD_BENCH)->opcode == OP_BENCH);
+static_assert(ps::find_command(CMD_GET_LOG)->bulk);
+static_assert(ps::find_command("none") == nullptr);
+static_assert(ps::find_field(ps::find_command(CMD_PING)->request, TAG_LATENCY) == PING_REQ_LT);
+static_assert(sizeof(ps::commands) / sizeof(ps::commands[0]) == COMMAND_COUNT);
+
+static void check_schema(std::span<const ps::FieldDef> generated, const TlvSchema *schema) {
+    if (!schema) {
+        assert(generated.empty());
+        return;
+    }
+    assert(generated.size() == schema->count);
+    for (uint8_t i = 0; i < schema->count; i++) {
+        const TlvFieldDef &field = schema->fields[i];
+        assert(generated[i].tag.size() == 2 && std::memcmp(generated[i].tag.data(), field.tag, 2) == 0);
+        assert(static_cast<uint8_t>(generated[i].type) == field.type);
+        assert(generated[i].since == field.since);
+        if (field.type == TLV_TYPE_LIST) {
+            check_schema(generated[i].children, field.children);
+        } else {
+            assert(generated[i].children.empty());
+        }
+    }
+}
+
+int main() {
+    for (const ps::CommandDef &command : ps::commands) {
+        check_schema(command.request, tlv_schema_request(command.opcode));
+        check_schema(command.response, tlv_schema_response(command.opcode));
+    }
+    std::printf("绑定检查通过：%zu条命令\n", sizeof(ps::commands) / sizeof(ps::commands[0]));
+    return 0;
+}
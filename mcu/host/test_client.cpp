@@ -0,0 +1,158 @@
+#include "protocol_client.hpp"
+#include "command_handler.h"
+#include "frame_parser.h"
+#include "host_mock.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// 客户端库的测试：两个套接字对模拟两个串口，另一端由真实的命令处理代码应答（mock_device.c），
+// 应答按收到请求的相反顺序写回，验证按响应编号匹配、窗口排队、超时、推送和端口关闭
+
+namespace pc = protocol_client;
+
+struct Responder {
+    int fd;
+    FrameParser parser;
+    uint8_t frame[MAX_PACKET_SIZE];
+    bool silent = false; // 不应答（超时测试）
+};
+
+static CommandScratch scratch;
+
+// 读出已到达的全部请求，执行后按相反顺序写回应答
+static void respond(Responder &responder) {
+    std::vector<std::vector<uint8_t>> responses;
+    uint8_t chunk[512];
+    ssize_t n;
+    while ((n = read(responder.fd, chunk, sizeof(chunk))) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            if (frame_parser_feed(&responder.parser, chunk[i]) != FRAME_RESULT_OK || responder.silent) {
+                continue;
+            }
+            const PacketHeader *header = frame_parser_header(&responder.parser);
+            assert(header->type == PKT_TYPE_HOST_REQUEST && header->version == PROTOCOL_VERSION_COBS);
+            protocol_set_tx_version(header->version);
+            std::vector<uint8_t> tx(MAX_PACKET_SIZE * 2);
+            uint16_t length = 0;
+            int result = process_command_packet(frame_parser_payload(&responder.parser), header->data_length,
+                                                tx.data(), static_cast<uint16_t>(tx.size()), &length,
+                                                header->packet_id, &scratch);
+            assert(result >= 0);
+            tx.resize(length);
+            responses.push_back(std::move(tx));
+        }
+    }
+    for (auto it = responses.rbegin(); it != responses.rend(); ++it) {
+        assert(write(responder.fd, it->data(), it->size()) == static_cast<ssize_t>(it->size()));
+    }
+}
+
+static int attach_pair(pc::Client &client, Responder &responder) {
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+    responder.fd = fds[1];
+    frame_parser_init(&responder.parser, responder.frame, sizeof(responder.frame));
+    int port = client.attach(fds[0], true);
+    assert(port >= 0);
+    return port;
+}
+
+struct Completion {
+    int packet_id;
+    pc::Outcome outcome;
+    uint8_t status;
+    uint16_t response_id;
+    std::string instruction;
+};
+
+int main() {
+    host_reset();
+    command_handler_init();
+
+    pc::Client client;
+    Responder responders[2];
+    int ports[2] = {attach_pair(client, responders[0]), attach_pair(client, responders[1])};
+    client.set_window(ports[0], 4);
+
+    std::vector<Completion> done;
+    auto record = [&done](pc::Outcome outcome, const pc::Response &response) {
+        char instruction[5] = {0};
+        read_tlv_string(response.payload.data(), response.payload.size(), TAG_INSTRUCTION, instruction,
+                        sizeof(instruction));
+        done.push_back({-1, outcome, response.status, response.response_id, instruction});
+    };
+
+    // 端口0提交6个请求：4个在途，2个排队；端口1另提交2个
+    std::vector<int> ids;
+    for (int i = 0; i < 6; i++) {
+        ids.push_back(client.request(ports[0], i % 2 ? CMD_GET_TEMP : CMD_PING, {}, record));
+    }
+    ids.push_back(client.request(ports[1], CMD_PING, {}, record));
+    ids.push_back(client.request(ports[1], CMD_GET_TEMP, {}, record));
+    assert(client.in_flight(ports[0]) == 4 && client.queued(ports[0]) == 2);
+    assert(client.in_flight(ports[1]) == 2 && client.outstanding() == 8);
+
+    // 一个事件循环处理两个端口，应答乱序到达
+    for (int round = 0; round < 20 && client.outstanding() > 0; round++) {
+        respond(responders[0]);
+        respond(responders[1]);
+        assert(client.run_once(100) >= 0);
+    }
+    assert(client.outstanding() == 0 && done.size() == ids.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+        bool matched = false;
+        for (const Completion &completion : done) {
+            if (completion.response_id == ids[i]) {
+                assert(completion.outcome == pc::Outcome::response && completion.status == STATUS_OK);
+                matched = true;
+            }
+        }
+        assert(matched);
+    }
+    assert(done[0].response_id == ids[3]); // 端口0的第一批应答按相反顺序到达
+
+    // 超时：从机不应答，请求以timeout结束，排队的请求随之发出
+    done.clear();
+    responders[1].silent = true;
+    int lost = client.request(ports[1], CMD_PING, {}, record, 20);
+    while (client.outstanding() > 0) {
+        respond(responders[1]);
+        client.run_once(50);
+    }
+    assert(done.size() == 1 && done[0].outcome == pc::Outcome::timeout && done[0].response_id == lost);
+
+    // 推送：没有对应请求的帧交给推送处理函数
+    int pushes = 0;
+    client.on_push([&pushes, &ports](const pc::Response &response) {
+        assert(response.port == ports[1] && response.type == PKT_TYPE_SLAVE_REQUEST);
+        pushes++;
+    });
+    uint8_t push_data[16];
+    int push_length = write_tlv_string(push_data, sizeof(push_data), TAG_INSTRUCTION, CMD_GET_TEMP);
+    uint8_t push_frame[64];
+    protocol_set_tx_version(PROTOCOL_VERSION_COBS);
+    int push_frame_length = build_packet(PKT_TYPE_SLAVE_REQUEST, 0x8001, 0, push_data,
+                                         static_cast<uint16_t>(push_length), push_frame, sizeof(push_frame));
+    assert(write(responders[1].fd, push_frame, static_cast<size_t>(push_frame_length)) == push_frame_length);
+    client.run_once(100);
+    assert(pushes == 1);
+
+    // 对端关闭：在途请求以closed结束，端口失效
+    done.clear();
+    client.request(ports[1], CMD_PING, {}, record, 1000);
+    close(responders[1].fd);
+    while (client.outstanding() > 0) {
+        client.run_once(100);
+    }
+    assert(done.size() == 1 && done[0].outcome == pc::Outcome::closed);
+    assert(client.request(ports[1], CMD_PING, {}, record) == -1);
+
+    close(responders[0].fd);
+    std::printf("客户端库测试通过\n");
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "utils/escaping.hpp"
+#include <cassert>
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+// EscapingReader按字查找标记的测试：结果与逐字节查找相同；
+// 数据分段追加时，再次查找从上次停止的位置继续，结果与整体查找相同
+
+// 逐字节查找（按字扫描之前的实现），返回标记之后的位置，没有时返回-1
+static long reference_start(const std::vector<uint8_t> &data, size_t pos) {
+    for (; pos + 1 < data.size(); pos++) {
+        if (data[pos] == 0xAA && data[pos + 1] == 0x55) {
+            return static_cast<long>(pos + 2);
+        }
+    }
+    return -1;
+}
+
+static long reference_end(const std::vector<uint8_t> &data, size_t pos) {
+    while (pos + 1 < data.size()) {
+        if (data[pos] == 0x55 && data[pos + 1] == 0xAA) {
+            return static_cast<long>(pos + 2);
+        }
+        pos += (data[pos + 1] == 0x00 && (data[pos] == 0xAA || data[pos] == 0x55)) ? 2 : 1;
+    }
+    return -1;
+}
+
+// 线路噪声：标记字节和0x00比例偏高，其余随机
+static std::vector<uint8_t> make_noise(size_t length, uint32_t seed) {
+    std::vector<uint8_t> data(length);
+    for (size_t i = 0; i < length; i++) {
+        seed = seed * 1103515245U + 12345U;
+        uint8_t r = static_cast<uint8_t>(seed >> 16);
+        switch (r & 7) {
+        case 0: data[i] = 0xAA; break;
+        case 1: data[i] = 0x55; break;
+        case 2: data[i] = 0x00; break;
+        default: data[i] = static_cast<uint8_t>(r + (seed >> 24)); break;
+        }
+    }
+    return data;
+}
+
+int main() {
+    for (uint32_t seed = 1; seed <= 200; seed++) {
+        std::vector<uint8_t> data = make_noise(1 + seed % 97, seed);
+        const char *bytes = reinterpret_cast<const char *>(data.data());
+        for (size_t offset = 0; offset <= data.size(); offset++) {
+            EscapingReader reader(bytes, data.size());
+            assert(reader.seek(offset));
+            long expected = reference_start(data, offset);
+            assert(reader.find_start() == (expected >= 0));
+            if (expected >= 0) {
+                assert(reader.tell() == static_cast<size_t>(expected));
+            }
+
+            assert(reader.seek(offset));
+            expected = reference_end(data, offset);
+            assert(reader.find_end() == (expected >= 0));
+            assert(reader.tell() == (expected >= 0 ? static_cast<size_t>(expected) : offset));
+        }
+    }
+
+    // 长段无标记的数据：整段跳过，停在末尾
+    std::vector<uint8_t> quiet(1000, 0x11);
+    EscapingReader quiet_reader(reinterpret_cast<const char *>(quiet.data()), quiet.size());
+    assert(!quiet_reader.find_start() && quiet_reader.tell() == quiet.size());
+    quiet_reader.reset();
+    assert(!quiet_reader.find_end() && quiet_reader.tell() == 0 && quiet_reader.scan_offset() == quiet.size());
+
+    // 分段追加：每次查找从上次停止的位置继续，已检查的字节不再扫描
+    for (uint32_t seed = 1; seed <= 100; seed++) {
+        std::vector<uint8_t> data = make_noise(300, seed * 7919U);
+        const char *bytes = reinterpret_cast<const char *>(data.data());
+        for (size_t chunk = 1; chunk <= 17; chunk += 4) {
+            EscapingReader reader(bytes, static_cast<size_t>(0));
+            size_t length = 0;
+            bool found = false;
+            while (!found && length < data.size()) {
+                size_t step = data.size() - length < chunk ? data.size() - length : chunk;
+                reader.append(step);
+                length += step;
+                size_t before = reader.tell();
+                found = reader.find_start();
+                assert(reader.tell() >= before);
+                assert(found || reader.tell() + 1 >= length); // 没有找到时至多留下末尾的0xAA
+            }
+            long expected = reference_start(data, 0);
+            assert(found == (expected >= 0));
+            if (!found) {
+                continue;
+            }
+            assert(reader.tell() == static_cast<size_t>(expected));
+
+            size_t body = reader.tell();
+            size_t scanned = body;
+            found = false;
+            while (!found) {
+                found = reader.find_end();
+                if (found) {
+                    break;
+                }
+                assert(reader.tell() == body && reader.scan_offset() >= scanned);
+                assert(reader.scan_offset() + 1 >= length);
+                scanned = reader.scan_offset();
+                if (length == data.size()) {
+                    break;
+                }
+                size_t step = data.size() - length < chunk ? data.size() - length : chunk;
+                reader.append(step);
+                length += step;
+            }
+            expected = reference_end(data, body);
+            assert(found == (expected >= 0));
+            if (found) {
+                assert(reader.tell() == static_cast<size_t>(expected));
+            }
+        }
+    }
+
+    std::printf("escaping reader tests passed\n");
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "history_archive.hpp"
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 历史归档的测试：分批追加、重复下载去重、重新打开续写、写入中断后恢复，
+// 映射读取的范围查询和统计与逐条计算的结果一致
+
+namespace ha = history_archive;
+
+static constexpr uint8_t sensors = 3;
+
+// 第second秒各传感器的读数：缓变的三角波，原始值偶尔比滤波值高0.1°C
+static ha::Entry sample(uint32_t second, uint8_t sensor) {
+    uint32_t phase = (second + sensor * 97U) % 1200U;
+    int16_t temperature = static_cast<int16_t>(200 + sensor * 15 + (phase < 600 ? phase : 1200 - phase) / 20);
+    int16_t raw = static_cast<int16_t>(temperature + ((second * 7 + sensor) % 11 == 0 ? 1 : 0));
+    return {1700000000000ULL + second * 1000ULL, temperature, raw, sensor};
+}
+
+static std::vector<ha::Entry> samples(uint32_t from, uint32_t to) {
+    std::vector<ha::Entry> entries;
+    for (uint32_t second = from; second < to; second++) {
+        for (uint8_t sensor = 0; sensor < sensors; sensor++) {
+            entries.push_back(sample(second, sensor));
+        }
+    }
+    return entries;
+}
+
+static uint64_t file_size(const std::string &path) {
+    struct stat st;
+    assert(stat(path.c_str(), &st) == 0);
+    return static_cast<uint64_t>(st.st_size);
+}
+
+// 逐条检查[from, to]秒的查询结果
+static void check_query(const ha::Reader &reader, uint32_t from, uint32_t to, uint8_t sensor) {
+    std::vector<ha::Entry> expected;
+    for (const ha::Entry &entry : samples(from, to + 1)) {
+        if (sensor == ha::all_sensors || entry.sensor == sensor) {
+            expected.push_back(entry);
+        }
+    }
+    size_t i = 0;
+    long long visited = reader.query(sample(from, 0).time_ms, sample(to, 0).time_ms, [&](const ha::Entry &entry) {
+        assert(i < expected.size());
+        assert(entry.time_ms == expected[i].time_ms && entry.sensor == expected[i].sensor);
+        assert(entry.temperature == expected[i].temperature && entry.raw == expected[i].raw);
+        i++;
+        return true;
+    }, sensor);
+    assert(visited == static_cast<long long>(expected.size()) && i == expected.size());
+
+    if (sensor == ha::all_sensors) {
+        ha::Summary summary;
+        assert(reader.summarize(sample(from, 0).time_ms, sample(to, 0).time_ms, summary));
+        assert(summary.count == expected.size());
+        int16_t min = expected[0].temperature, max = expected[0].temperature;
+        for (const ha::Entry &entry : expected) {
+            min = std::min(min, entry.temperature);
+            max = std::max(max, entry.temperature);
+        }
+        assert(summary.min_temperature == min && summary.max_temperature == max);
+        assert(summary.first_ms == expected.front().time_ms && summary.last_ms == expected.back().time_ms);
+    }
+}
+
+int main() {
+    char dir[] = "/tmp/history_archiveXXXXXX";
+    assert(mkdtemp(dir) != nullptr);
+    std::string path = std::string(dir) + "/device-7.tla";
+    const uint32_t total = 20000; // 秒
+
+    // 分三批追加，第二批与第一批重叠（重复下载），重叠部分被跳过
+    {
+        ha::Writer writer;
+        assert(writer.open(path.c_str(), 7));
+        auto first = samples(0, 8000);
+        assert(writer.append(first) == static_cast<long>(first.size()));
+        auto overlap = samples(7000, 12000);
+        assert(writer.append(overlap) == static_cast<long>(4000 * sensors));
+        assert(writer.close());
+    }
+    // 设备编号不同时拒绝打开
+    {
+        ha::Writer other;
+        assert(!other.open(path.c_str(), 8));
+    }
+    // 重新打开续写：最后一条的时间从最后一块恢复
+    {
+        ha::Writer writer;
+        assert(writer.open(path.c_str(), 7) && writer.recovered_bytes() == 0);
+        uint64_t last;
+        assert(writer.last_time(last) && last == sample(11999, 0).time_ms);
+        auto rest = samples(12000, total);
+        assert(writer.append(rest) == static_cast<long>(rest.size()));
+        assert(writer.entry_count() == total * sensors);
+        assert(writer.close());
+    }
+
+    // 缓变读数每条约3字节
+    double bytes_per_entry = static_cast<double>(file_size(path)) / (total * sensors);
+    std::printf("%u条，%.2f字节/条\n", total * sensors, bytes_per_entry);
+    assert(bytes_per_entry < 3.5);
+
+    {
+        ha::Reader reader;
+        assert(reader.open(path.c_str()));
+        assert(reader.device_id() == 7 && reader.entry_count() == total * sensors);
+        assert(reader.blocks().size() >= total * sensors / ha::block_entries);
+        check_query(reader, 0, total - 1, ha::all_sensors);
+        check_query(reader, 5000, 5100, ha::all_sensors);   // 块内
+        check_query(reader, 1300, 15000, ha::all_sensors);  // 跨多块，中间的块只用块头统计
+        check_query(reader, 9000, 9500, 2);
+        // 范围之外
+        long long none = reader.query(0, sample(0, 0).time_ms - 1, [](const ha::Entry &) { return true; });
+        assert(none == 0);
+        // visit返回false时停止
+        long long one = reader.query(0, UINT64_MAX, [](const ha::Entry &) { return false; });
+        assert(one == 1);
+    }
+
+    // 写入中断：截去页尾和最后一块的一部分，重新打开时按块头恢复，之后照常续写
+    uint64_t size = file_size(path);
+    assert(truncate(path.c_str(), static_cast<off_t>(size - 1000)) == 0);
+    {
+        ha::Reader reader;
+        assert(!reader.open(path.c_str())); // 页尾无效
+        ha::Writer writer;
+        assert(writer.open(path.c_str(), 7) && writer.recovered_bytes() > 0);
+        uint64_t last;
+        assert(writer.last_time(last) && last < sample(total - 1, 0).time_ms);
+        uint32_t resume = static_cast<uint32_t>((last - sample(0, 0).time_ms) / 1000U);
+        auto rest = samples(resume, total);
+        assert(writer.append(rest) > 0);
+        assert(writer.entry_count() == total * sensors);
+        assert(writer.close());
+    }
+    {
+        ha::Reader reader;
+        assert(reader.open(path.c_str()) && reader.entry_count() == total * sensors);
+        check_query(reader, 0, total - 1, ha::all_sensors);
+    }
+
+    unlink(path.c_str());
+    rmdir(dir);
+    std::printf("历史归档测试通过\n");
+    return 0;
+}
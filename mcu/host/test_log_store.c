@@ -0,0 +1,608 @@
+#include "log_store.h"
+#include "protocol.h"
+#include "spi_nor.h"
+#include "storage_task.h"
+#include "warm_state.h"
+#include "cmsis_os.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+// 闪存日志（log_store.c）的测试：按LOG_STORE_SPI_NOR=1编译，外置闪存由本文件中的RAM代替，
+// 编程只能把1改为0（与NOR闪存相同），每个流只有几页，几千条记录即可多次回绕。
+// protocol_host中的mock_device.c按数组模拟日志查询，这里检查真正的页格式和查找
+
+#define NOR_SIZE (LOG_STORE_STREAM_PAGES * LOG_STORE_STREAM_PAGE_SIZE)
+#define TIME_BASE_MS 1750689000000ULL
+#define MAX_RECORDS 10000U
+#define SAMPLE_SLOTS 677U // 采样流每页的记录数：(4096 - 页头和摘要24 - 温度基准8) / 6
+#define EVENT_SLOTS 407U  // 事件流每页的记录数：(4096 - 24) / 10
+#define MAX_EVENTS 1000U
+
+static uint8_t nor[NOR_SIZE];
+
+bool spi_nor_init(void) {
+    return true;
+}
+
+bool spi_nor_ready(void) {
+    return true;
+}
+
+uint32_t spi_nor_capacity(void) {
+    return NOR_SIZE;
+}
+
+// 掉电：program_budget为掉电前还能编程的字节数（-1为不限），用完时正在进行的编程只完成一部分；
+// erase_cut_start/end不为-1时下一次擦除只擦除页内[start, end)就掉电。掉电后擦写均失败，直到重新上电
+static int32_t program_budget = -1;
+static int32_t erase_cut_start = -1;
+static int32_t erase_cut_end = -1;
+static bool powered = true;
+
+bool spi_nor_read(uint32_t address, void *data, uint32_t size) {
+    assert(address + size <= NOR_SIZE);
+    memcpy(data, &nor[address], size);
+    return true;
+}
+
+bool spi_nor_program(uint32_t address, const void *data, uint32_t size) {
+    assert(address + size <= NOR_SIZE);
+    const uint8_t *bytes = data;
+    for (uint32_t i = 0; i < size; i++) {
+        if (!powered || program_budget == 0) {
+            powered = false;
+            return false;
+        }
+        if (program_budget > 0) {
+            program_budget--;
+        }
+        nor[address + i] &= bytes[i];
+    }
+    return powered;
+}
+
+bool spi_nor_erase_sector(uint32_t address) {
+    assert(address % SPI_NOR_SECTOR_SIZE == 0 && address < NOR_SIZE);
+    if (!powered) {
+        return false;
+    }
+    if (erase_cut_start >= 0) {
+        memset(&nor[address + (uint32_t)erase_cut_start], 0xFF, (uint32_t)(erase_cut_end - erase_cut_start));
+        powered = false;
+        return false;
+    }
+    memset(&nor[address], 0xFF, SPI_NOR_SECTOR_SIZE);
+    return true;
+}
+
+bool spi_nor_erase_chip(void) {
+    memset(nor, 0xFF, sizeof(nor));
+    return true;
+}
+
+bool spi_nor_busy(void) {
+    return false;
+}
+
+void storage_task_wake(void) {
+}
+
+osStatus_t osDelay(uint32_t ticks) {
+    (void)ticks;
+    return osOK;
+}
+
+// 冷启动：待写队列不保留
+bool warm_state_restore(WarmState *state, uint32_t magic, uint32_t size) {
+    (void)state;
+    (void)magic;
+    (void)size;
+    return false;
+}
+
+void warm_state_seal(WarmState *state) {
+    (void)state;
+}
+
+typedef struct {
+    uint64_t timestamp_ms;
+    LogSamplePayload sample;
+} SampleRecord;
+
+static SampleRecord written[MAX_RECORDS]; // 按追加顺序
+static uint32_t written_count;
+static LogEventPayload events[MAX_EVENTS]; // 事件流（按行存放），时间戳为追加顺序的整秒
+static uint64_t event_times[MAX_EVENTS];
+static uint32_t event_count;
+static uint64_t latest_ms; // 最后追加的时间戳（包括掉电时丢失的记录），上电后时间接着往后走
+
+// 重新上电：闪存内容保留，RAM中的写入状态由log_store_init()从闪存恢复
+static void power_cycle(void) {
+    powered = true;
+    program_budget = -1;
+    erase_cut_start = -1;
+    erase_cut_end = -1;
+    log_store_warm_restore();
+    log_store_init();
+}
+
+static void format(void) {
+    memset(nor, 0xFF, sizeof(nor));
+    written_count = 0;
+    event_count = 0;
+    latest_ms = TIME_BASE_MS - 1000U;
+    power_cycle();
+}
+
+// 追加一条采样记录并立即写入闪存；idle为false时推迟提前擦除（链路忙）。
+// 滤波前后相差超过12.7°C时读出的滤波前温度按差值截断
+static void append_sample(uint64_t timestamp_ms, uint8_t sensor, int16_t temperature, int16_t raw, bool idle) {
+    LogSamplePayload sample = { temperature, raw, sensor };
+    assert(log_store_append(LOG_STREAM_SAMPLES, timestamp_ms, &sample));
+    log_store_service(idle);
+    int32_t raw_delta = raw - temperature;
+    raw_delta = raw_delta < INT8_MIN ? INT8_MIN : raw_delta > INT8_MAX ? INT8_MAX : raw_delta;
+    sample.raw = (int16_t)(temperature + raw_delta);
+    assert(written_count < MAX_RECORDS);
+    written[written_count++] = (SampleRecord){ timestamp_ms, sample };
+    latest_ms = timestamp_ms;
+}
+
+// 第i条：每秒一条、毫秒各不相同，传感器0~2轮流（传感器3留给掉电的测试），温度在基准附近变化
+static void append_series(uint32_t count, bool idle) {
+    for (uint32_t n = 0; n < count; n++) {
+        uint32_t i = written_count;
+        uint64_t second_ms = (latest_ms / 1000U + 1U) * 1000U;
+        uint8_t sensor = (uint8_t)(i % 3U);
+        int16_t temperature = (int16_t)(200 + sensor * 50 + (int16_t)((i / 3) % 40) - 20);
+        append_sample(second_ms + (i * 37U) % 1000U, sensor, temperature,
+                      (int16_t)(temperature + (int16_t)(i % 7) - 3), idle);
+    }
+}
+
+static bool same_sample(const LogSamplePayload *a, const LogSamplePayload *b) {
+    return a->temperature == b->temperature && a->raw == b->raw && a->sensor == b->sensor;
+}
+
+// 从最旧的记录起读出全部记录，返回written中第一条的下标：读出的必须是已写入记录的完整后缀
+static uint32_t check_retained(void) {
+    LogStoreIter iter;
+    log_store_iter_begin(&iter, LOG_STREAM_SAMPLES);
+    uint64_t timestamp_ms;
+    LogSamplePayload sample;
+    uint32_t first = written_count;
+    uint32_t n = 0;
+    uint32_t previous_position = 0;
+    while (log_store_iter_next(&iter, &timestamp_ms, &sample)) {
+        if (n == 0) {
+            for (first = 0; first < written_count && written[first].timestamp_ms != timestamp_ms; first++) {
+            }
+            assert(first < written_count);
+        }
+        assert(first + n < written_count);
+        assert(written[first + n].timestamp_ms == timestamp_ms && same_sample(&written[first + n].sample, &sample));
+        uint32_t position = log_store_iter_position(&iter);
+        assert(n == 0 || position > previous_position);
+        previous_position = position;
+        n++;
+    }
+    assert(first + n == written_count);
+    return first;
+}
+
+// 定位到第一条不早于timestamp_ms的记录（早于最旧的记录时为最旧的一条）
+static void check_seek(uint32_t first, uint64_t timestamp_ms) {
+    uint32_t expected = first;
+    while (expected < written_count && written[expected].timestamp_ms < timestamp_ms) {
+        expected++;
+    }
+    LogStoreIter iter;
+    log_store_seek(&iter, LOG_STREAM_SAMPLES, timestamp_ms);
+    uint64_t found_ms;
+    LogSamplePayload sample;
+    if (expected == written_count) {
+        assert(!log_store_iter_next(&iter, &found_ms, &sample));
+        return;
+    }
+    assert(log_store_iter_next(&iter, &found_ms, &sample));
+    assert(found_ms == written[expected].timestamp_ms && same_sample(&written[expected].sample, &sample));
+}
+
+static void check_seeks(uint32_t first) {
+    if (first == written_count) {
+        check_seek(first, 0);
+        return;
+    }
+    check_seek(first, 0);
+    check_seek(first, written[first].timestamp_ms);
+    check_seek(first, written[written_count - 1].timestamp_ms + 1U);
+    for (uint32_t i = first; i < written_count; i += 97) {
+        check_seek(first, written[i].timestamp_ms);
+        check_seek(first, written[i].timestamp_ms + 1U); // 落在两条之间
+    }
+    // 整秒（页的base_time为整秒，与页内第一条记录的时间不同）
+    for (uint32_t i = first; i < written_count; i += 13) {
+        check_seek(first, written[i].timestamp_ms / 1000U * 1000U);
+    }
+}
+
+// 从最新的记录往前读，可从读到的位置按时间顺序继续
+static void check_latest(void) {
+    LogStoreIter iter;
+    log_store_iter_end(&iter, LOG_STREAM_SAMPLES);
+    uint64_t timestamp_ms;
+    LogSamplePayload sample;
+    for (uint32_t n = 1; n <= 5 && n <= written_count; n++) {
+        assert(log_store_iter_prev(&iter, &timestamp_ms, &sample));
+        assert(timestamp_ms == written[written_count - n].timestamp_ms);
+    }
+    LogStoreIter resumed;
+    log_store_iter_resume(&resumed, LOG_STREAM_SAMPLES, log_store_iter_position(&iter));
+    for (uint32_t n = 5; n >= 1; n--) {
+        assert(log_store_iter_next(&resumed, &timestamp_ms, &sample));
+        assert(timestamp_ms == written[written_count - n].timestamp_ms);
+    }
+    assert(!log_store_iter_next(&resumed, &timestamp_ms, &sample));
+}
+
+// 整个页环的每个写入进度：查找活动页（重新上电后）和按时间定位在回绕前后都正确；
+// idle为false时下一页不提前擦除，活动页之后是上一轮的旧页
+static void test_wrap(bool idle) {
+    format();
+    uint32_t ring = LOG_STORE_SAMPLE_PAGES * SAMPLE_SLOTS;
+    uint32_t first = 0;
+    for (uint32_t step = 0; written_count + 331U <= MAX_RECORDS && written_count < ring * 2U; step++) {
+        append_series(331, idle); // 与每页的条数互质，写入位置落在页内各处
+        first = check_retained();
+        if (written_count > ring) {
+            // 回绕后至少保留除提前擦除的一页以外的各页
+            assert(written_count - first >= (LOG_STORE_SAMPLE_PAGES - 2U) * SAMPLE_SLOTS);
+        }
+        check_seeks(first);
+
+        power_cycle();
+        assert(check_retained() == first);
+        check_seeks(first);
+        check_latest();
+    }
+    assert(first > 0); // 已回绕
+}
+
+// 上电后活动页恰好是页环的最后一页、第一页，以及刚翻页时
+static void test_active_at_edges(void) {
+    format();
+    append_series(SAMPLE_SLOTS * LOG_STORE_SAMPLE_PAGES - 1U, true); // 最后一页差一条写满
+    uint32_t first = check_retained();
+    power_cycle();
+    assert(check_retained() == first);
+    append_series(1, true);
+    power_cycle();
+    check_retained();
+    append_series(1, true); // 回绕到第一页
+    power_cycle();
+    first = check_retained();
+    check_seeks(first);
+    append_series(SAMPLE_SLOTS, true);
+    power_cycle();
+    first = check_retained();
+    check_seeks(first);
+    check_latest();
+}
+
+// 最新一条记录的位置
+static uint32_t latest_position(void) {
+    LogStoreIter iter;
+    log_store_iter_end(&iter, LOG_STREAM_SAMPLES);
+    uint64_t timestamp_ms;
+    LogSamplePayload sample;
+    assert(log_store_iter_prev(&iter, &timestamp_ms, &sample));
+    return log_store_iter_position(&iter);
+}
+
+static uint32_t rand_state = 12345U;
+
+static uint32_t next_rand(void) {
+    rand_state = rand_state * 1103515245U + 12345U;
+    return rand_state >> 16;
+}
+
+// 按列存放的页：温度基准、秒偏移、温度差值、毫秒和传感器各列都原样读回；
+// 差值到±12.7°C为止留在本页，超出时和秒偏移超出16位时换页
+static void test_columns(void) {
+    format();
+    uint64_t page_ms = TIME_BASE_MS; // 第一页的base_time
+    // 各传感器的第一条记录定下该页的基准，-1（擦除值）的基准存为0
+    static const int16_t bases[LOG_STORE_MAX_SENSORS] = { 250, -1, -300, 1200 };
+    static const int16_t page_bases[LOG_STORE_MAX_SENSORS] = { 250, 0, -300, 1200 };
+    for (uint8_t sensor = 0; sensor < LOG_STORE_MAX_SENSORS; sensor++) {
+        int16_t raw = (int16_t)(bases[sensor] + (sensor % 2 ? -500 : 400)); // 按差值截断
+        append_sample(page_ms + 500U + sensor, sensor, bases[sensor], raw, true);
+    }
+    for (uint8_t sensor = 0; sensor < LOG_STORE_MAX_SENSORS; sensor++) {
+        append_sample(page_ms + 1000U + sensor, sensor, (int16_t)(page_bases[sensor] + INT8_MAX),
+                      (int16_t)(page_bases[sensor] + INT8_MAX - 1), true);
+        append_sample(page_ms + 2000U + sensor, sensor, (int16_t)(page_bases[sensor] + INT8_MIN),
+                      (int16_t)(page_bases[sensor] + INT8_MIN + 127), true);
+    }
+    append_sample(page_ms + 0xFFFEU * 1000ULL + 999U, 3, 1200, 1200, true); // 秒偏移的最大值
+    assert(latest_position() == SAMPLE_SLOTS + 12U);
+
+    // 超出基准12.8°C：换页，新页的基准为这一条的温度
+    uint64_t timestamp_ms = page_ms + 0xFFFFU * 1000ULL;
+    append_sample(timestamp_ms, 0, (int16_t)(page_bases[0] + INT8_MAX + 1), 250, true);
+    assert(latest_position() == 2U * SAMPLE_SLOTS);
+    append_sample(timestamp_ms + 1U, 1, -1, -1, true);
+    append_sample(timestamp_ms + 2U, 0, 250, 251, true); // 相对新基准378为-12.8°C
+    assert(latest_position() == 2U * SAMPLE_SLOTS + 2U);
+
+    // 秒偏移超出16位：换页
+    page_ms = timestamp_ms;
+    append_sample(page_ms + 0xFFFFU * 1000ULL, 2, -300, -300, true);
+    assert(latest_position() == 3U * SAMPLE_SLOTS);
+
+    // 跨页边界：传感器随机，温度随机游走，间隔0~3秒（同一秒内也有多条）
+    int16_t temperatures[LOG_STORE_MAX_SENSORS] = { 250, -1, -300, 1200 };
+    timestamp_ms = page_ms + 0xFFFFU * 1000ULL;
+    while (written_count < 20U + SAMPLE_SLOTS * 2U) {
+        uint8_t sensor = (uint8_t)(next_rand() % LOG_STORE_MAX_SENSORS);
+        temperatures[sensor] = (int16_t)(temperatures[sensor] + (int16_t)(next_rand() % 21U) - 10);
+        timestamp_ms += next_rand() % 3000U;
+        append_sample(timestamp_ms, sensor, temperatures[sensor],
+                      (int16_t)(temperatures[sensor] + (int16_t)(next_rand() % 401U) - 200), true);
+    }
+    assert(latest_position() / SAMPLE_SLOTS >= 5U);
+
+    assert(check_retained() == 0);
+    check_seeks(0);
+    check_latest();
+    power_cycle();
+    assert(check_retained() == 0);
+}
+
+static bool outside(const LogSamplePayload *sample, int16_t low, int16_t high) {
+    return (sample->temperature < low || sample->temperature > high) && (sample->raw < low || sample->raw > high);
+}
+
+// 按温度筛选时，温度或滤波前温度落在范围内的记录都要读出（只能跳过摘要表明没有这样记录的页）
+static void check_filter(uint32_t first, int16_t low, int16_t high) {
+    LogStoreIter iter;
+    log_store_iter_begin(&iter, LOG_STREAM_SAMPLES);
+    log_store_iter_filter(&iter, low, high);
+    uint64_t timestamp_ms;
+    LogSamplePayload sample;
+    uint32_t expected = first;
+    while (log_store_iter_next(&iter, &timestamp_ms, &sample)) {
+        while (expected < written_count && written[expected].timestamp_ms != timestamp_ms) {
+            assert(outside(&written[expected].sample, low, high));
+            expected++;
+        }
+        assert(expected < written_count && same_sample(&written[expected].sample, &sample));
+        expected++;
+    }
+    for (; expected < written_count; expected++) {
+        assert(outside(&written[expected].sample, low, high));
+    }
+}
+
+// 掉电时正在写入的一条（时间戳为timestamp_ms）：上电后完整读出，或者从未写入
+static void settle_torn_sample(uint64_t timestamp_ms) {
+    assert(written_count > 0 && written[written_count - 1].timestamp_ms == timestamp_ms);
+    LogStoreIter iter;
+    log_store_iter_end(&iter, LOG_STREAM_SAMPLES);
+    uint64_t found_ms;
+    LogSamplePayload sample;
+    if (!log_store_iter_prev(&iter, &found_ms, &sample) || found_ms != timestamp_ms) {
+        written_count--;
+    }
+}
+
+// 上电后的检查：已写入的记录原样读出（位置递增），按时间定位和按温度筛选不受中断的记录影响
+static void check_after_cut(void) {
+    uint32_t first = check_retained();
+    check_seeks(first);
+    for (uint32_t i = first; i < written_count; i += 61) {
+        check_filter(first, written[i].sample.temperature, written[i].sample.temperature);
+    }
+    check_filter(first, 890, 910);
+}
+
+typedef void (*SetupFn)(void);
+
+// 第budget个字节时掉电，逐个字节直到这一条写完：掉电前的记录不受影响，这一条完整读出或没有；
+// 上电后继续写入，新记录（包括新传感器的基准）和换页时写入的摘要照常读出和筛选
+static void cut_sample(SetupFn setup, uint8_t sensor, int16_t temperature, uint32_t gap_s, bool idle) {
+    for (int32_t budget = 0;; budget++) {
+        setup();
+        uint64_t timestamp_ms = latest_ms + gap_s * 1000ULL + 1U;
+        program_budget = budget;
+        append_sample(timestamp_ms, sensor, temperature, (int16_t)(temperature + 5), idle);
+        bool cut = !powered;
+        power_cycle();
+        settle_torn_sample(timestamp_ms);
+        check_after_cut();
+
+        append_series(5, idle);
+        uint64_t next_ms = latest_ms + 1000U;
+        append_sample(next_ms, 3, 900, 901, idle); // 传感器3在本页还没有基准
+        append_sample(next_ms + 1000U, 3, 905, 895, idle);
+        append_series(5, idle);
+        append_sample(latest_ms + 1000U, 0, -500, -500, idle); // 换页，写入摘要
+        check_after_cut();
+        power_cycle();
+        check_after_cut();
+        if (!cut) {
+            break;
+        }
+    }
+}
+
+static void setup_empty(void) {
+    format();
+}
+
+static void setup_mid_page(void) {
+    format();
+    append_series(100, true);
+}
+
+static void setup_full_page(void) {
+    format();
+    append_series(SAMPLE_SLOTS, true);
+}
+
+// 回绕后链路一直忙：下一页是推迟擦除的旧页
+static void setup_wrapped_busy(void) {
+    format();
+    append_series(LOG_STORE_SAMPLE_PAGES * SAMPLE_SLOTS + 100U, false);
+}
+
+// 采样记录写入中途掉电：页内、新传感器的基准、写满后换页（旧页摘要、新页页头）、
+// 温度超出基准换页（下一页已提前擦除，或链路忙时在换页时擦除）、秒偏移超出16位换页和第一页
+static void test_torn_samples(void) {
+    cut_sample(setup_mid_page, 1, 260, 1, true);
+    cut_sample(setup_mid_page, 3, 700, 1, true);
+    cut_sample(setup_full_page, 1, 260, 1, true);
+    cut_sample(setup_mid_page, 0, 700, 1, true);
+    cut_sample(setup_wrapped_busy, 0, 700, 1, false);
+    cut_sample(setup_mid_page, 1, 260, 0x10000U, true);
+    cut_sample(setup_empty, 0, 200, 0, true);
+}
+
+// 提前擦除下一页时掉电（只擦除了页内[start, end)，最旧的一页为第一页或之后的页）：上电后
+// 半擦除页中只读出残留的完整记录，该页在写入前重新擦除，之后回绕经过它的记录照常读出
+static void cut_erase(uint32_t pages, int32_t start, int32_t end) {
+    format();
+    append_series(pages * SAMPLE_SLOTS + 50U, false); // 下一页是上一轮的旧页，推迟擦除
+    uint32_t intact = written_count - (LOG_STORE_SAMPLE_PAGES - 2U) * SAMPLE_SLOTS - 50U; // 半擦除页之后的记录
+    erase_cut_start = start;
+    erase_cut_end = end;
+    log_store_service(true);
+    assert(!powered);
+    power_cycle();
+
+    // 最旧的一页只能读出未擦除的部分，其余各页完整
+    LogStoreIter iter;
+    log_store_iter_begin(&iter, LOG_STREAM_SAMPLES);
+    uint64_t timestamp_ms;
+    LogSamplePayload sample;
+    uint32_t expected = 0;
+    while (log_store_iter_next(&iter, &timestamp_ms, &sample)) {
+        while (expected < written_count && written[expected].timestamp_ms != timestamp_ms) {
+            assert(expected < intact);
+            expected++;
+        }
+        assert(expected < written_count && same_sample(&written[expected].sample, &sample));
+        expected++;
+    }
+    assert(expected == written_count);
+
+    append_series(SAMPLE_SLOTS * 2U, true);
+    uint32_t first = check_retained();
+    assert(first <= intact + SAMPLE_SLOTS * 2U);
+    check_seeks(first);
+    power_cycle();
+    assert(check_retained() == first);
+}
+
+static void append_event(uint8_t channel, int16_t temperature) {
+    LogEventPayload event = { channel, ALARM_EVENT_ENTER, (uint8_t)(channel % LOG_STORE_MAX_SENSORS), temperature };
+    latest_ms += 1000U;
+    assert(log_store_append(LOG_STREAM_EVENTS, latest_ms, &event));
+    log_store_service(true);
+    assert(event_count < MAX_EVENTS);
+    event_times[event_count] = latest_ms;
+    events[event_count++] = event;
+}
+
+// 事件流读出的是已写入事件的完整后缀，掉电时正在写入的一条（最后一条）可以没有
+static void check_events(bool torn) {
+    LogStoreIter iter;
+    log_store_iter_begin(&iter, LOG_STREAM_EVENTS);
+    uint64_t timestamp_ms;
+    LogEventPayload event;
+    uint32_t first = event_count;
+    uint32_t n = 0;
+    while (log_store_iter_next(&iter, &timestamp_ms, &event)) {
+        if (n == 0) {
+            for (first = 0; first < event_count && event_times[first] != timestamp_ms; first++) {
+            }
+        }
+        assert(first + n < event_count && event_times[first + n] == timestamp_ms);
+        assert(memcmp(&events[first + n], &event, sizeof(event)) == 0);
+        n++;
+    }
+    if (torn && first + n == event_count - 1U) {
+        event_count--;
+    }
+    assert(first + n == event_count);
+}
+
+// 按行存放的记录写入中途掉电：没有commit的记录不读出，之后的记录写在它后面
+static void cut_event(uint32_t fill) {
+    for (int32_t budget = 0;; budget++) {
+        format();
+        for (uint32_t i = 0; i < fill; i++) {
+            append_event((uint8_t)(i % 8U), (int16_t)(i - 100));
+        }
+        program_budget = budget;
+        append_event(7, 555);
+        bool cut = !powered;
+        power_cycle();
+        check_events(true);
+        append_event(1, -1);
+        append_event(2, 0);
+        check_events(false);
+        power_cycle();
+        check_events(false);
+        if (!cut) {
+            break;
+        }
+    }
+}
+
+static void test_torn_events(void) {
+    cut_event(0);
+    cut_event(10);
+    cut_event(EVENT_SLOTS); // 换页：旧页的摘要和新页的页头
+}
+
+static void test_torn_erase(void) {
+    static const int32_t cuts[][2] = {
+        { 0, 1 }, { 0, 4 }, { 0, 11 }, { 0, 12 }, { 0, 24 }, { 0, 2048 }, { 0, 4095 },
+        { 2048, 4096 }, { 4000, 4096 }, { 8, 12 }, { 12, 24 },
+    };
+    for (uint32_t i = 0; i < sizeof(cuts) / sizeof(cuts[0]); i++) {
+        cut_erase(LOG_STORE_SAMPLE_PAGES - 1U, cuts[i][0], cuts[i][1]); // 活动页为最后一页，半擦除第一页
+        cut_erase(LOG_STORE_SAMPLE_PAGES, cuts[i][0], cuts[i][1]);
+    }
+}
+
+// 位置为页序号 × 每页记录数 + 页内编号，第一页的页序号为1
+static void test_layout(void) {
+    format();
+    append_series(1, true);
+    LogStoreIter iter;
+    log_store_iter_begin(&iter, LOG_STREAM_SAMPLES);
+    uint64_t timestamp_ms;
+    LogSamplePayload sample;
+    assert(log_store_iter_next(&iter, &timestamp_ms, &sample));
+    assert(log_store_iter_position(&iter) == SAMPLE_SLOTS + 1U);
+    append_series(SAMPLE_SLOTS, true); // 第二页的第一条
+    log_store_iter_end(&iter, LOG_STREAM_SAMPLES);
+    assert(log_store_iter_prev(&iter, &timestamp_ms, &sample));
+    assert(log_store_iter_position(&iter) == 2U * SAMPLE_SLOTS);
+}
+
+int main(void) {
+    test_layout();
+    test_wrap(true);
+    test_wrap(false);
+    test_active_at_edges();
+    test_columns();
+    test_torn_samples();
+    test_torn_events();
+    test_torn_erase();
+    printf("log store tests passed\n");
+    return 0;
+}
@@ -0,0 +1,9 @@
+#include "host_mock.h"
+#include "test_protocol.h"
+
+// 主机构建的测试入口：assert失败时进程异常退出，ctest即判为失败
+int main(void) {
+    host_reset();
+    run_all_tests();
+    return 0;
+}
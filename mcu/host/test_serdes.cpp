@@ -0,0 +1,205 @@
+#include "serdes.hpp"
+#include "protocol.h"
+#include "tlv_schema.h"
+#include "command_list.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+// TLVSerializer的输出与C的write_tlv_*逐字节相同；TLVDeserializer按字段表还原全部成员，
+// 各字段表与固件的字段表（tlv_schema.c）一致
+
+static const RTCDate date = { 26, 10, 14, 3 };
+static const RTCTime time_of_day = { 13, 45, 7 };
+static const AlarmConfig alarm = {
+    .id = 2, .low_temp = -105, .high_temp = 382, .hysteresis = 15, .delay_s = 30,
+    .sensor = 1, .rate = 25, .window_s = 60, .horizon_s = 300,
+    .actions = ALARM_ACTION_BUZZER | ALARM_ACTION_LED, .enabled = 1,
+};
+
+static size_t c_date(uint8_t *out, size_t size) {
+    size_t len = 0;
+    len += write_tlv_uint8(out + len, size - len, TAG_YEAR, date.year);
+    len += write_tlv_uint8(out + len, size - len, TAG_MONTH, date.month);
+    len += write_tlv_uint8(out + len, size - len, TAG_DAY, date.day);
+    len += write_tlv_uint8(out + len, size - len, TAG_WEEKDAY, date.weekday);
+    return len;
+}
+
+static size_t c_time(uint8_t *out, size_t size) {
+    size_t len = 0;
+    len += write_tlv_uint8(out + len, size - len, TAG_HOUR, time_of_day.hour);
+    len += write_tlv_uint8(out + len, size - len, TAG_MINUTE, time_of_day.minute);
+    len += write_tlv_uint8(out + len, size - len, TAG_SECOND, time_of_day.second);
+    return len;
+}
+
+// galm的一个IT项（温度按int16）
+static size_t c_alarm_item(uint8_t *out, size_t size) {
+    size_t len = write_tlv_begin(out, size, TAG_ALARM_ITEM);
+    len += write_tlv_uint8(out + len, size - len, TAG_ALARM_ID, alarm.id);
+    len += write_tlv_temperature(out + len, size - len, TAG_ALARM_LOW, alarm.low_temp, TEMP_FORMAT_INT16);
+    len += write_tlv_temperature(out + len, size - len, TAG_ALARM_HIGH, alarm.high_temp, TEMP_FORMAT_INT16);
+    len += write_tlv_temperature(out + len, size - len, TAG_ALARM_HYSTERESIS, alarm.hysteresis, TEMP_FORMAT_INT16);
+    len += write_tlv_uint16(out + len, size - len, TAG_ALARM_DELAY, alarm.delay_s);
+    len += write_tlv_uint8(out + len, size - len, TAG_SENSOR, alarm.sensor);
+    len += write_tlv_temperature(out + len, size - len, TAG_ALARM_RATE, alarm.rate, TEMP_FORMAT_INT16);
+    len += write_tlv_uint8(out + len, size - len, TAG_ALARM_ACTIONS, alarm.actions);
+    len += write_tlv_uint8(out + len, size - len, TAG_ALARM_ENABLED, alarm.enabled);
+    len += write_tlv_uint16(out + len, size - len, TAG_ALARM_WINDOW, alarm.window_s);
+    len += write_tlv_uint16(out + len, size - len, TAG_ALARM_HORIZON, alarm.horizon_s);
+    write_tlv_end(out, len - 4);
+    return len;
+}
+
+static void serialize_alarm_item(TLVSerializer &serializer) {
+    auto item = serializer.begin<TAG_ALARM_ITEM>();
+    serializer.write<TAG_ALARM_ID>(alarm.id);
+    serializer.write<TAG_ALARM_LOW>(alarm.low_temp);
+    serializer.write<TAG_ALARM_HIGH>(alarm.high_temp);
+    serializer.write<TAG_ALARM_HYSTERESIS>(alarm.hysteresis);
+    serializer.write<TAG_ALARM_DELAY>(alarm.delay_s);
+    serializer.write<TAG_SENSOR>(alarm.sensor);
+    serializer.write<TAG_ALARM_RATE>(alarm.rate);
+    serializer.write<TAG_ALARM_ACTIONS>(alarm.actions);
+    serializer.write<TAG_ALARM_ENABLED>(alarm.enabled);
+    serializer.write<TAG_ALARM_WINDOW>(alarm.window_s);
+    serializer.write<TAG_ALARM_HORIZON>(alarm.horizon_s);
+    serializer.end(item);
+}
+
+// 字段表逐项与固件的字段表比对：标签相同，值长度与成员类型一致
+template <typename Schema>
+static void check_schema(const TlvSchema *schema, const size_t *sizes) {
+    assert(schema != nullptr && Schema::tags.size() == schema->count);
+    for (uint8_t i = 0; i < schema->count; i++) {
+        const TlvFieldDef &field = schema->fields[i];
+        char tag[3] = { field.tag[0], field.tag[1], 0 };
+        assert(Schema::tags[i] == TLV::make_tag(tag));
+        switch (field.type) {
+        case TLV_TYPE_UINT8: assert(sizes[i] == 1); break;
+        case TLV_TYPE_UINT16: assert(sizes[i] == 2); break;
+        case TLV_TYPE_TEMPERATURE: assert(sizes[i] == sizeof(int16_t)); break;
+        default: assert(false);
+        }
+    }
+}
+
+static void check_same(const char *encoded, size_t encoded_len, const uint8_t *expected, size_t expected_len) {
+    assert(encoded_len == expected_len);
+    assert(std::memcmp(encoded, expected, expected_len) == 0);
+}
+
+int main() {
+    uint8_t expected[256];
+    char buffer[256];
+
+    // 定长字段
+    {
+        BufferWriter writer(buffer, sizeof(buffer));
+        TLVSerializer serializer(writer);
+        serializer.write<TAG_YEAR>(date.year);
+        serializer.write<TAG_MONTH>(date.month);
+        serializer.write<TAG_DAY>(date.day);
+        serializer.write<TAG_WEEKDAY>(date.weekday);
+        assert(serializer.ok());
+        check_same(buffer, serializer.size(), expected, c_date(expected, sizeof(expected)));
+    }
+    {
+        BufferWriter writer(buffer, sizeof(buffer));
+        TLVSerializer serializer(writer);
+        serializer.write<TAG_HOUR>(time_of_day.hour);
+        serializer.write<TAG_MINUTE>(time_of_day.minute);
+        serializer.write<TAG_SECOND>(time_of_day.second);
+        assert(serializer.ok());
+        check_same(buffer, serializer.size(), expected, c_time(expected, sizeof(expected)));
+    }
+
+    // 嵌套：AL中两个IT项，长度回填与write_tlv_begin/end相同
+    {
+        BufferWriter writer(buffer, sizeof(buffer));
+        TLVSerializer serializer(writer);
+        auto list = serializer.begin<TAG_ALARM_LIST>();
+        serialize_alarm_item(serializer);
+        serialize_alarm_item(serializer);
+        serializer.end(list);
+        assert(serializer.ok());
+
+        size_t len = write_tlv_begin(expected, sizeof(expected), TAG_ALARM_LIST);
+        len += c_alarm_item(expected + len, sizeof(expected) - len);
+        len += c_alarm_item(expected + len, sizeof(expected) - len);
+        write_tlv_end(expected, len - 4);
+        check_same(buffer, serializer.size(), expected, len);
+    }
+
+    // 字符串和原始字节
+    {
+        BufferWriter writer(buffer, sizeof(buffer));
+        TLVSerializer serializer(writer);
+        static const uint8_t raw[] = { 0x00, 0xAA, 0x55 };
+        serializer.write_string<TAG_INSTRUCTION>(CMD_GET_ALARMS);
+        serializer.write_raw<TAG_DATA>(raw, sizeof(raw));
+        serializer.write_raw<TAG_DATA>(nullptr, 0);
+        assert(serializer.ok());
+
+        size_t len = write_tlv_string(expected, sizeof(expected), TAG_INSTRUCTION, CMD_GET_ALARMS);
+        len += write_tlv_raw(expected + len, sizeof(expected) - len, TAG_DATA, raw, sizeof(raw));
+        len += write_tlv_raw(expected + len, sizeof(expected) - len, TAG_DATA, nullptr, 0);
+        check_same(buffer, serializer.size(), expected, len);
+    }
+
+    // 空间不足：之后的写入全部忽略，只在最后检查一次
+    {
+        BufferWriter writer(buffer, 40);
+        TLVSerializer serializer(writer);
+        auto list = serializer.begin<TAG_ALARM_LIST>();
+        serialize_alarm_item(serializer);
+        assert(serializer.end(list) < 0 && !serializer.ok());
+        assert(serializer.write<TAG_YEAR>(date.year) < 0);
+    }
+
+    // 解码：C编码的数据还原为各结构体的全部成员
+    {
+        size_t len = c_date(expected, sizeof(expected));
+        BufferReader reader(reinterpret_cast<const char *>(expected), len);
+        RTCDate out{};
+        assert(TLVDeserializer(reader).read<RTCDateSchema>(out) == 1);
+        assert(out.year == date.year && out.month == date.month && out.day == date.day && out.weekday == date.weekday);
+    }
+    {
+        size_t len = c_time(expected, sizeof(expected));
+        BufferReader reader(reinterpret_cast<const char *>(expected), len);
+        RTCTime out{};
+        assert(TLVDeserializer(reader).read<RTCTimeSchema>(out) == 1);
+        assert(out.hour == time_of_day.hour && out.minute == time_of_day.minute && out.second == time_of_day.second);
+    }
+    {
+        size_t len = c_alarm_item(expected, sizeof(expected));
+        BufferReader reader(reinterpret_cast<const char *>(expected + 4), len - 4);
+        AlarmConfig out{};
+        assert(TLVDeserializer(reader).read<AlarmConfigSchema>(out) == 1);
+        assert(out.id == alarm.id && out.low_temp == alarm.low_temp && out.high_temp == alarm.high_temp);
+        assert(out.hysteresis == alarm.hysteresis && out.delay_s == alarm.delay_s && out.sensor == alarm.sensor);
+        assert(out.rate == alarm.rate && out.window_s == alarm.window_s && out.horizon_s == alarm.horizon_s);
+        assert(out.actions == alarm.actions && out.enabled == alarm.enabled);
+
+        // 任一字段缺失时失败，不会静默留下未填的成员
+        BufferReader partial(reinterpret_cast<const char *>(expected + 4), len - 4 - 6);
+        assert(TLVDeserializer(partial).read<AlarmConfigSchema>(out) < 0);
+    }
+
+    // 与固件字段表一致
+    static const size_t date_sizes[] = { 1, 1, 1, 1 };
+    static const size_t time_sizes[] = { 1, 1, 1 };
+    static const size_t alarm_sizes[] = {
+        sizeof(alarm.id), sizeof(alarm.low_temp), sizeof(alarm.high_temp), sizeof(alarm.hysteresis),
+        sizeof(alarm.delay_s), sizeof(alarm.sensor), sizeof(alarm.rate), sizeof(alarm.actions),
+        sizeof(alarm.enabled), sizeof(alarm.window_s), sizeof(alarm.horizon_s),
+    };
+    check_schema<RTCDateSchema>(tlv_schema_request(OP_SET_RTC_DATE), date_sizes);
+    check_schema<RTCTimeSchema>(tlv_schema_request(OP_SET_RTC_TIME), time_sizes);
+    check_schema<AlarmConfigSchema>(&tlv_schema_alarm_item, alarm_sizes);
+
+    std::printf("serdes tests passed\n");
+    return 0;
+}
@@ -1,14 +1,43 @@
 #include "test_protocol.h"
 #include "protocol.h"
+#include "log_codec.h"
 #include "command_handler.h"
+#include "command_list.h"
+#include "tlv_schema.h"
+#include "device_control.h"
+#include "log_compress.h"
+#include "sampling_settings.h"
+#include "temp_filter.h"
+#include "temp_calib.h"
+#include "temp_stats.h"
+#include "temp_driver.h"
+#include "analog_temp.h"
+#include "test_mode.h"
+#include "sample_schedule.h"
+#include "temp_sampler.h"
+#include "warm_state.h"
+#include "admission.h"
+#include "temp_logger.h"
+#include "log_archive.h"
+#include "communication.h"
+#include "frame_parser.h"
+#include "frame_writer.h"
+#include "gateway.h"
+#include "response_cache.h"
+#include "fw_update.h"
+#include "boot_slots.h"
+#include "ble_module.h"
+#include "crc32.h"
+#include "host_mock.h"
+#include "cmsis_os.h"
+#include "main.h"
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 
 // 测试用的模拟数据
+static CommandScratch test_scratch;
 static float test_temperature = 25.5f;
-static RTCDate test_date = {25, 6, 23, 1}; // 2025年6月23日，星期一
-static RTCTime test_time = {14, 30, 0};    // 14:30:00
 
 // 测试辅助函数
 static void print_hex(const uint8_t *data, size_t len) {
@@ -86,10 +115,54 @@ void test_command_processing(void) {
     req_len += write_tlv_string(ping_request + req_len, sizeof(ping_request) - req_len, TAG_INSTRUCTION, CMD_PING);
     req_len += write_tlv_raw(ping_request + req_len, sizeof(ping_request) - req_len, TAG_DATA, NULL, 0);
     
-    int result = process_command_packet(ping_request, req_len, ping_response, &response_len, 0x0001);
+    int result = process_command_packet(ping_request, req_len, ping_response, sizeof(ping_response), &response_len, 0x0001, &test_scratch);
     assert(result == 0);
     printf("Ping命令响应长度: %d\n", response_len);
     
+    // 带CB的ping返回能力列表
+    req_len = write_tlv_string(ping_request, sizeof(ping_request), TAG_INSTRUCTION, CMD_PING);
+    uint8_t *ping_da = ping_request + req_len;
+    req_len += write_tlv_begin(ping_da, sizeof(ping_request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint8(ping_request + req_len, sizeof(ping_request) - req_len, TAG_CAPABILITIES, 1);
+    write_tlv_end(ping_da, ping_request + req_len - ping_da - 4);
+    assert(process_command_packet(ping_request, req_len, ping_response, sizeof(ping_response), &response_len, 0x0001, &test_scratch) == 0);
+    {
+        PacketHeader header;
+        uint8_t data[256];
+        const uint8_t *da, *caps, *field;
+        uint16_t da_len, caps_len, field_len, max_packet;
+        uint8_t opcode_max, push;
+        int data_len = parse_packet(ping_response, response_len, &header, data, sizeof(data));
+        assert(data_len > 0 && read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+        assert(read_tlv_view(da, da_len, TAG_CAPABILITIES, &caps, &caps_len) > 0);
+        assert(read_tlv_view(caps, caps_len, TAG_PROTOCOL_VERSIONS, &field, &field_len) > 0);
+        assert(memchr(field, PROTOCOL_VERSION_COBS, field_len) != NULL);
+        assert(read_tlv_uint16(caps, caps_len, TAG_MAX_PACKET, &max_packet) > 0 && max_packet == MAX_PACKET_SIZE);
+        assert(read_tlv_uint8(caps, caps_len, TAG_OPCODE_MAX, &opcode_max) > 0 && opcode_max == COMMAND_COUNT);
+        assert(read_tlv_uint8(caps, caps_len, TAG_PUSH_MODES, &push) > 0 && (push & CAP_PUSH_PERIODIC));
+        assert(read_tlv_view(caps, caps_len, TAG_BAUD_RATE, &field, &field_len) > 0);
+        assert(field_len == 4 * COMM_BAUD_RATE_COUNT && field[0] == (115200 & 0xFF));
+        
+        // 编号形式的IN按同样形式回复，没有DA时只有IN和ST
+        static const uint8_t opcode_request[] = {'I', 'N', 1, 0, OP_RESET_LED};
+        assert(process_command_packet(opcode_request, sizeof(opcode_request), ping_response, sizeof(ping_response), &response_len, 0x0003, &test_scratch) == 0);
+        data_len = parse_packet(ping_response, response_len, &header, data, sizeof(data));
+        static const uint8_t expected[] = {'I', 'N', 1, 0, OP_RESET_LED, 'S', 'T', 1, 0, STATUS_OK};
+        assert(data_len == sizeof(expected) && memcmp(data, expected, sizeof(expected)) == 0);
+    }
+    
+    // 没有DA的命令：处理函数收到NULL/0，读取字段时不越界，回复失败
+    static const char *const no_data_commands[] = { CMD_SET_BAUD, CMD_SET_ALARMS };
+    for (size_t i = 0; i < sizeof(no_data_commands) / sizeof(no_data_commands[0]); i++) {
+        PacketHeader header;
+        uint8_t data[256];
+        uint8_t status;
+        req_len = write_tlv_string(ping_request, sizeof(ping_request), TAG_INSTRUCTION, no_data_commands[i]);
+        assert(process_command_packet(ping_request, req_len, ping_response, sizeof(ping_response), &response_len, (uint16_t)(0x0010 + i), &test_scratch) == 0);
+        int data_len = parse_packet(ping_response, response_len, &header, data, sizeof(data));
+        assert(data_len > 0 && read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0 && status != STATUS_OK);
+    }
+    
     // 测试获取温度命令
     uint8_t temp_request[64];
     uint8_t temp_response[256];
@@ -98,7 +171,7 @@ void test_command_processing(void) {
     req_len += write_tlv_string(temp_request + req_len, sizeof(temp_request) - req_len, TAG_INSTRUCTION, CMD_GET_TEMP);
     req_len += write_tlv_raw(temp_request + req_len, sizeof(temp_request) - req_len, TAG_DATA, NULL, 0);
     
-    result = process_command_packet(temp_request, req_len, temp_response, &response_len, 0x0002);
+    result = process_command_packet(temp_request, req_len, temp_response, sizeof(temp_response), &response_len, 0x0002, &test_scratch);
     assert(result == 0);
     printf("获取温度命令响应长度: %d\n", response_len);
     
@@ -128,17 +201,24 @@ void test_device_control(void) {
     
     // 测试报警系统
     alarm_init();
-    alarm_set_config(0, 20.0f, 30.0f); // 蜂鸣器报警：20-30°C
-    alarm_set_config(1, 15.0f, 35.0f); // LED报警：15-35°C
+    AlarmConfig buzzer_rule = {.id = 0, .low_temp = 200, .high_temp = 300, .sensor = ALARM_SENSOR_ANY,
+                               .actions = ALARM_ACTION_BUZZER, .enabled = 1}; // 蜂鸣器报警：20-30°C
+    AlarmConfig led_rule = {.id = 1, .low_temp = 150, .high_temp = 350, .sensor = ALARM_SENSOR_ANY,
+                            .actions = ALARM_ACTION_LED, .enabled = 1};       // LED报警：15-35°C
+    assert(alarm_config_valid(&buzzer_rule) && alarm_config_valid(&led_rule));
+    alarm_set_config(&buzzer_rule);
+    alarm_set_config(&led_rule);
     
     AlarmConfig config;
     alarm_get_config(0, &config);
+    assert(config.low_temp == 200 && config.high_temp == 300);
     printf("报警配置0: ID=%d, 下限=%.1f°C, 上限=%.1f°C\n", 
-           config.id, config.low_temp, config.high_temp);
+           config.id, config.low_temp / 10.0, config.high_temp / 10.0);
     
     // 测试报警触发
-    alarm_check_temperature(40.0f); // 应该触发两个报警
-    printf("温度40°C检查完成\n");
+    int16_t temperature = 400;
+    alarm_check_temperatures(&temperature, 1); // 40°C，应该触发两个报警
+    printf("温度40°C检查完成，报警状态: 0x%08lX\n", (unsigned long)alarm_get_active_mask());
     
     printf("✓ 设备控制功能测试通过\n\n");
 }
@@ -149,26 +229,2467 @@ void test_temperature_logging(void) {
     
     temp_log_init();
     
-    // 添加一些测试数据
+    // 添加一些测试数据，每秒一条
     for (int i = 0; i < 10; i++) {
-        float temp = 20.0f + i * 0.5f;
-        temp_log_add_entry(temp);
-        printf("添加温度记录: %.1f°C\n", temp);
+        int16_t temp = 200 + i * 5;
+        temp_log_add_entry(0, temp, temp);
+        printf("添加温度记录: %.1f°C\n", temp / 10.0);
+        osDelay(pdMS_TO_TICKS(1000));
     }
     
     // 查询日志
-    TempLogEntry entries[20];
-    uint32_t count = temp_log_get_entries(0, UINT64_MAX, entries, 20);
+    TempLogQuery query;
+    TempLogEntry entry;
+    uint32_t count = 0;
+    temp_log_query_begin(&query, 0, 0, UINT64_MAX);
+    while (temp_log_query_next(&query, &entry)) {
+        assert(entry.temperature == 200 + (int16_t)count * 5);
+        count++;
+        printf("  %lu: 时间戳=%lu, 温度=%.1f°C\n", 
+               (unsigned long)count, (unsigned long)entry.timestamp, entry.temperature / 10.0);
+    }
+    assert(count == 10);
+    printf("查询到 %lu 条日志记录\n", (unsigned long)count);
+    
+    // glog的L/H只返回温度在范围内的条目（每个IT为TS + MS + float32的T，30字节）
+    command_handler_init();
+    uint8_t request[64];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint8_t data[MAX_PACKET_SIZE];
+    uint16_t response_len;
+    PacketHeader header;
+    const uint8_t *da, *list;
+    uint16_t da_len, list_len;
+    int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_LOG);
+    uint8_t *fields = request + req_len;
+    req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint64(request + req_len, sizeof(request) - req_len, TAG_TIME_START, 1);
+    req_len += write_tlv_temperature(request + req_len, sizeof(request) - req_len, TAG_ALARM_LOW, 230, TEMP_FORMAT_INT16);
+    req_len += write_tlv_temperature(request + req_len, sizeof(request) - req_len, TAG_ALARM_HIGH, 240, TEMP_FORMAT_FLOAT32);
+    write_tlv_end(fields, request + req_len - fields - 4);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0030, &test_scratch) == 0);
+    int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 0 && read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+    assert(read_tlv_view(da, da_len, TAG_LOG_LIST, &list, &list_len) >= 0 && list_len == 3 * 30);
+    
+    // CP=2：同样的三条打包为一个LP，每条8字节
+    req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_LOG);
+    fields = request + req_len;
+    req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint64(request + req_len, sizeof(request) - req_len, TAG_TIME_START, 1);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_LOG_FORMAT, LOG_FORMAT_PACKED);
+    req_len += write_tlv_temperature(request + req_len, sizeof(request) - req_len, TAG_ALARM_LOW, 230, TEMP_FORMAT_INT16);
+    req_len += write_tlv_temperature(request + req_len, sizeof(request) - req_len, TAG_ALARM_HIGH, 240, TEMP_FORMAT_INT16);
+    write_tlv_end(fields, request + req_len - fields - 4);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0034, &test_scratch) == 0);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 0 && read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+    assert(read_tlv_view(da, da_len, TAG_LOG_PACKED, &list, &list_len) > 0 && list_len == 2 + 3 * LOG_PACKED_ENTRY_SIZE);
+    TempLogEntry packed[4];
+    assert(log_codec_decode_packed(list, list_len, packed, 4) == 3);
+    assert(packed[0].temperature == 230 && packed[2].temperature == 240);
+    assert(packed[1].timestamp == packed[0].timestamp + 1 && packed[2].timestamp == packed[1].timestamp + 1);
+    assert(log_codec_decode_packed(list, list_len - 1, packed, 4) == -1);
+    
+    // 下限高于上限
+    req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_LOG);
+    fields = request + req_len;
+    req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_temperature(request + req_len, sizeof(request) - req_len, TAG_ALARM_LOW, 240, TEMP_FORMAT_INT16);
+    req_len += write_tlv_temperature(request + req_len, sizeof(request) - req_len, TAG_ALARM_HIGH, 230, TEMP_FORMAT_INT16);
+    write_tlv_end(fields, request + req_len - fields - 4);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0031, &test_scratch) == 0);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    uint8_t status = STATUS_OK;
+    assert(data_len > 0 && read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0 && status == STATUS_INVALID_PARAM);
+    
+    // LA：最新的3条按时间顺序返回；MX更小时先返回其中较早的部分并带CU
+    for (uint16_t mx = 3; mx >= 2; mx--) {
+        req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_LOG);
+        fields = request + req_len;
+        req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+        req_len += write_tlv_uint16(request + req_len, sizeof(request) - req_len, TAG_LOG_LATEST, 3);
+        req_len += write_tlv_uint16(request + req_len, sizeof(request) - req_len, TAG_MAX_COUNT, mx);
+        req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_LOG_FORMAT, LOG_FORMAT_PACKED);
+        write_tlv_end(fields, request + req_len - fields - 4);
+        assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0035, &test_scratch) == 0);
+        data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+        assert(data_len > 0 && read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+        assert(read_tlv_view(da, da_len, TAG_LOG_PACKED, &list, &list_len) > 0);
+        assert(log_codec_decode_packed(list, list_len, packed, 4) == mx);
+        assert(packed[0].temperature == 235 && packed[1].temperature == 240);
+        uint32_t next_cursor;
+        assert((read_tlv_uint32(da, da_len, TAG_LOG_CURSOR, &next_cursor) > 0) == (mx == 2));
+    }
+    
+    // LA不能与温度筛选同时使用
+    req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_LOG);
+    fields = request + req_len;
+    req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint16(request + req_len, sizeof(request) - req_len, TAG_LOG_LATEST, 3);
+    req_len += write_tlv_temperature(request + req_len, sizeof(request) - req_len, TAG_ALARM_LOW, 230, TEMP_FORMAT_INT16);
+    write_tlv_end(fields, request + req_len - fields - 4);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0036, &test_scratch) == 0);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 0 && read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0 && status == STATUS_INVALID_PARAM);
     
-    printf("查询到 %d 条日志记录:\n", count);
-    for (uint32_t i = 0; i < count; i++) {
-        printf("  %d: 时间戳=%llu, 温度=%.1f°C\n", 
-               i + 1, (unsigned long long)entries[i].timestamp, entries[i].temperature);
+    // IR：不低于23.0°C的时段，25.0°C之后的20.0°C结束第一个时段，26.0°C开始仍在继续的第二个时段
+    static const int16_t tail[] = {250, 200, 260};
+    for (uint8_t i = 0; i < 3; i++) {
+        temp_log_add_entry(0, tail[i], tail[i]);
+        osDelay(pdMS_TO_TICKS(1000));
     }
+    req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_LOG);
+    fields = request + req_len;
+    req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint64(request + req_len, sizeof(request) - req_len, TAG_TIME_START, 1);
+    req_len += write_tlv_temperature(request + req_len, sizeof(request) - req_len, TAG_ALARM_LOW, 230, TEMP_FORMAT_INT16);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_LOG_INTERVALS, 1);
+    write_tlv_end(fields, request + req_len - fields - 4);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0032, &test_scratch) == 0);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    const uint8_t *item;
+    uint16_t item_len;
+    uint32_t n;
+    uint8_t ongoing;
+    float peak;
+    assert(data_len > 0 && read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+    assert(read_tlv_view(da, da_len, TAG_LOG_INTERVALS, &list, &list_len) > 0);
+    assert(read_tlv_view(list, list_len, TAG_ALARM_ITEM, &item, &item_len) > 0);
+    assert(read_tlv_uint32(item, item_len, TAG_BUCKET_COUNT, &n) > 0 && n == 5);
+    assert(read_tlv_float32(item, item_len, TAG_PEAK, &peak) > 0 && peak > 24.9f && peak < 25.1f);
+    assert(read_tlv_uint8(item, item_len, TAG_ONGOING, &ongoing) > 0 && ongoing == 0);
+    uint16_t first_len = (uint16_t)(item + item_len - list);
+    assert(read_tlv_view(list + first_len, list_len - first_len, TAG_ALARM_ITEM, &item, &item_len) > 0);
+    assert(read_tlv_uint32(item, item_len, TAG_BUCKET_COUNT, &n) > 0 && n == 1);
+    assert(read_tlv_uint8(item, item_len, TAG_ONGOING, &ongoing) > 0 && ongoing == 1);
+    assert(item + item_len == list + list_len);
+    
+    // AS：规则0从进入到解除报警的时段，峰值取自期间的记录
+    host_add_alarm_event(0, ALARM_EVENT_ENTER, 0, 850);
+    static const int16_t alarm_tail[] = {900, 950, 880};
+    for (uint8_t i = 0; i < 3; i++) {
+        osDelay(pdMS_TO_TICKS(1000));
+        temp_log_add_entry(0, alarm_tail[i], alarm_tail[i]);
+    }
+    osDelay(pdMS_TO_TICKS(1000));
+    host_add_alarm_event(0, ALARM_EVENT_LEAVE, 0, 790);
+    req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_LOG);
+    fields = request + req_len;
+    req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint64(request + req_len, sizeof(request) - req_len, TAG_TIME_START, 1);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_ALARM_STATE, 0);
+    write_tlv_end(fields, request + req_len - fields - 4);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0033, &test_scratch) == 0);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    uint64_t start, end;
+    assert(data_len > 0 && read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+    assert(read_tlv_view(da, da_len, TAG_LOG_INTERVALS, &list, &list_len) > 0);
+    assert(read_tlv_view(list, list_len, TAG_ALARM_ITEM, &item, &item_len) > 0);
+    assert(read_tlv_uint64(item, item_len, TAG_TIME_START, &start) > 0);
+    assert(read_tlv_uint64(item, item_len, TAG_TIME_END, &end) > 0 && end == start + 4);
+    assert(read_tlv_uint32(item, item_len, TAG_BUCKET_COUNT, &n) > 0 && n == 3);
+    assert(read_tlv_float32(item, item_len, TAG_PEAK, &peak) > 0 && peak > 94.9f && peak < 95.1f);
+    assert(read_tlv_uint8(item, item_len, TAG_ONGOING, &ongoing) > 0 && ongoing == 0);
+    
+    // gbst：每条记录约170字节，一帧放两条，其余带CU续传；BT为int16小端数组
+    AlarmBurst burst = { .timestamp = (uint32_t)start - 180U, .channel = 0, .type = ALARM_EVENT_ENTER, .sensor = 0 };
+    for (uint8_t b = 0; b < 3; b++) {
+        for (uint8_t i = 0; i < ALARM_BURST_SAMPLES; i++) {
+            burst.temperatures[i] = (int16_t)(b * 100 + i);
+        }
+        burst.temperatures[0] = TEMP_INVALID;
+        host_add_alarm_burst(&burst);
+        burst.timestamp += 60;
+    }
+    uint32_t burst_cursor = 0;
+    for (uint8_t page = 0; page < 2; page++) {
+        req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_BURSTS);
+        fields = request + req_len;
+        req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+        if (page > 0) {
+            req_len += write_tlv_uint32(request + req_len, sizeof(request) - req_len, TAG_LOG_CURSOR, burst_cursor);
+        }
+        write_tlv_end(fields, request + req_len - fields - 4);
+        assert(process_command_packet(request, req_len, response, sizeof(response), &response_len,
+                                      (uint16_t)(0x0034 + page), &test_scratch) == 0);
+        data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+        assert(data_len > 0 && read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+        assert(read_tlv_view(da, da_len, TAG_BURST_LIST, &list, &list_len) > 0);
+        uint16_t offset = 0;
+        uint8_t items = 0;
+        while (offset < list_len && read_tlv_view(list + offset, list_len - offset, TAG_ALARM_ITEM, &item, &item_len) > 0) {
+            const uint8_t *bt;
+            uint16_t bt_len;
+            uint8_t pre, type;
+            uint8_t b = (uint8_t)(page * 2 + items);
+            assert(read_tlv_uint64(item, item_len, TAG_TIMESTAMP, &end) > 0 && end == start - 180U + b * 60U);
+            assert(read_tlv_uint8(item, item_len, TAG_EVENT_TYPE, &type) > 0 && type == ALARM_EVENT_ENTER);
+            assert(read_tlv_uint8(item, item_len, TAG_BURST_PRE, &pre) > 0 && pre == ALARM_BURST_PRE_SAMPLES);
+            assert(read_tlv_view(item, item_len, TAG_BURST_SAMPLES, &bt, &bt_len) > 0 && bt_len == ALARM_BURST_SAMPLES * 2);
+            assert(bt[0] == 0x00 && bt[1] == 0x80); // TEMP_INVALID
+            assert((bt[126] | bt[127] << 8) == b * 100 + 63);
+            offset = (uint16_t)(item + item_len - list);
+            items++;
+        }
+        assert(items == (page == 0 ? 2 : 1));
+        assert((read_tlv_uint32(da, da_len, TAG_LOG_CURSOR, &burst_cursor) > 0) == (page == 0));
+    }
+    AlarmEvent drained;
+    while (alarm_notify_pop(&drained)) {
+    }
+    
+    // 差分编码往返：时间戳跳变和回拨（二阶差分为大的正负值，多字节varint）、
+    // 读取失败的TEMP_INVALID（温度差分接近int16范围）
+    static const struct { uint32_t timestamp; int16_t temperature; } codec_input[] = {
+        { 1750000000U, 250 }, { 1750000001U, 251 }, { 1750000002U, 249 }, { 1750000003U, TEMP_INVALID },
+        { 1750000004U, 250 }, { 1750086404U, 250 }, { 1750086405U, INT16_MAX }, { 1750000000U, -400 },
+        { 1750000001U, TEMP_INVALID }, { 1750000002U, TEMP_INVALID }, { 1750000003U, 0 }, { 4000000000U, -1 },
+    };
+    enum { CODEC_COUNT = sizeof(codec_input) / sizeof(codec_input[0]) };
+    TempLogEntry codec_entries[CODEC_COUNT];
+    memset(codec_entries, 0, sizeof(codec_entries));
+    for (uint32_t n = 0; n < CODEC_COUNT; n++) {
+        codec_entries[n].timestamp = codec_input[n].timestamp;
+        codec_entries[n].temperature = codec_input[n].temperature;
+    }
+    
+    // 逐条记录编码后的位置：平稳的一段每条2字节，跳变处更长
+    uint8_t encoded[256];
+    size_t ends[CODEC_COUNT + 1];
+    LogCodecEncoder encoder;
+    assert(log_codec_begin(&encoder, encoded, sizeof(encoded)));
+    ends[0] = encoder.pos;
+    for (uint32_t n = 0; n < CODEC_COUNT; n++) {
+        assert(log_codec_put(&encoder, &codec_entries[n]));
+        ends[n + 1] = encoder.pos;
+    }
+    int encoded_len = log_codec_finish(&encoder);
+    assert(encoded_len == (int)ends[CODEC_COUNT]);
+    assert(ends[2] - ends[1] == 2 && ends[3] - ends[2] == 2);
+    assert(ends[4] - ends[3] == 4);       // 249 → TEMP_INVALID
+    assert(ends[6] - ends[5] >= 4);       // 跳过一天
+    assert(ends[7] - ends[6] >= 4);       // 跳回后的二阶差分
+    assert(ends[8] - ends[7] >= 6);       // 回拨一天，温度从INT16_MAX到-40.0°C
+    
+    TempLogEntry decoded[CODEC_COUNT];
+    assert(log_codec_decode(encoded, encoded_len, decoded, CODEC_COUNT) == CODEC_COUNT);
+    for (uint32_t n = 0; n < CODEC_COUNT; n++) {
+        assert(decoded[n].timestamp == codec_input[n].timestamp);
+        assert(decoded[n].temperature == codec_input[n].temperature);
+    }
+    assert(log_codec_decode(encoded, encoded_len, decoded, CODEC_COUNT - 1) == -1);
+    assert(log_codec_decode(encoded, encoded_len - 1, decoded, CODEC_COUNT) == -1);
+    
+    // 缓冲区的每种大小：恰好放下k条时编码k条，多一个字节也不编码半条，解码结果为前k条
+    for (size_t size = 2; size <= ends[CODEC_COUNT]; size++) {
+        uint8_t block[256];
+        uint32_t count = 0;
+        uint32_t expected_count = 0;
+        while (expected_count < CODEC_COUNT && ends[expected_count + 1] <= size) {
+            expected_count++;
+        }
+        int block_len = log_codec_encode(codec_entries, CODEC_COUNT, block, size, &count);
+        assert(count == expected_count && block_len == (int)ends[count]);
+        assert(memcmp(block + 2, encoded + 2, block_len - 2) == 0);
+        assert(log_codec_decode(block, block_len, decoded, CODEC_COUNT) == (int)count);
+        for (uint32_t n = 0; n < count; n++) {
+            assert(decoded[n].timestamp == codec_input[n].timestamp && decoded[n].temperature == codec_input[n].temperature);
+        }
+    }
+    assert(log_codec_encode(codec_entries, CODEC_COUNT, encoded, 1, NULL) == -1);
     
     printf("✓ 温度日志功能测试通过\n\n");
 }
 
+// 旋转门重建：保存的相邻两点之间线性插值，中间各读数的误差不超过容差
+static void check_reconstruction(const LogCompressPoint *input, uint32_t input_count,
+                                 const LogCompressPoint *stored, uint32_t stored_count, int16_t tolerance) {
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < input_count; i++) {
+        while (k + 1 < stored_count && stored[k + 1].timestamp_ms < input[i].timestamp_ms) {
+            k++;
+        }
+        if (k + 1 >= stored_count) {
+            break; // 最后一个保存点之后的读数尚在门内
+        }
+        const LogCompressPoint *a = &stored[k], *b = &stored[k + 1];
+        double t = (double)(input[i].timestamp_ms - a->timestamp_ms) / (double)(b->timestamp_ms - a->timestamp_ms);
+        double value = a->temperature + t * (b->temperature - a->temperature);
+        assert(input[i].temperature - value <= tolerance + 1e-9 && value - input[i].temperature <= tolerance + 1e-9);
+    }
+}
+
+void test_log_compression(void) {
+    printf("=== 测试日志压缩 ===\n");
+    
+    static LogCompressPoint input[300];
+    static LogCompressPoint stored[300 + LOG_COMPRESS_MAX_POINTS];
+    uint32_t stored_count = 0;
+    LogCompressPoint points[LOG_COMPRESS_MAX_POINTS];
+    
+    // 缓慢上升、平稳、回落的曲线，叠加±1的抖动，每秒一个读数
+    for (uint32_t i = 0; i < 300; i++) {
+        int16_t base = i < 100 ? (int16_t)(200 + i / 2) : i < 200 ? 250 : (int16_t)(250 - (i - 200) / 4);
+        int16_t jitter = (int16_t)((i * 7) % 3) - 1;
+        input[i] = (LogCompressPoint){ 1000000ULL + i * 1000ULL, (int16_t)(base + jitter), (int16_t)i };
+    }
+    
+    // 不压缩（默认）：原样保存
+    log_compress_reset();
+    assert(log_compress_feed(1, &input[0], points) == 1 && points[0].raw == 0);
+    assert(log_compress_feed(1, &input[1], points) == 1 && points[0].raw == 1);
+    
+    // 死区：与上次保存的温度相差超过容差才保存，阶梯重建的误差不超过容差
+    LogCompressConfig config = { LOG_COMPRESS_DEADBAND, 3, 0 };
+    assert(log_compress_config_valid(&config));
+    log_compress_configure(1, &config);
+    int16_t level = 0;
+    for (uint32_t i = 0; i < 300; i++) {
+        uint8_t n = log_compress_feed(1, &input[i], points);
+        assert(n <= 1);
+        if (n == 1) {
+            assert(points[0].raw == input[i].raw);
+            level = points[0].temperature;
+            stored_count++;
+        }
+        int diff = input[i].temperature - level;
+        assert(diff <= 3 && diff >= -3);
+    }
+    assert(stored_count > 2 && stored_count < 60);
+    
+    // 旋转门：按时间顺序保存，插值误差不超过容差，点数远少于读数
+    config = (LogCompressConfig){ LOG_COMPRESS_SWINGING_DOOR, 2, 0 };
+    log_compress_configure(1, &config);
+    stored_count = 0;
+    for (uint32_t i = 0; i < 300; i++) {
+        uint8_t n = log_compress_feed(1, &input[i], points);
+        for (uint8_t j = 0; j < n; j++) {
+            assert(stored_count == 0 || points[j].timestamp_ms > stored[stored_count - 1].timestamp_ms);
+            stored[stored_count++] = points[j];
+        }
+    }
+    assert(stored[0].raw == 0 && stored_count > 2 && stored_count < 60);
+    check_reconstruction(input, 300, stored, stored_count, 2);
+    
+    // 心跳：恒定温度时每10秒保存一点，暂存的点一并保存
+    config = (LogCompressConfig){ LOG_COMPRESS_SWINGING_DOOR, 2, 10000 };
+    log_compress_configure(2, &config);
+    stored_count = 0;
+    for (uint32_t i = 0; i <= 30; i++) {
+        LogCompressPoint flat = { 1000000ULL + i * 1000ULL, 250, (int16_t)i };
+        stored_count += log_compress_feed(2, &flat, points);
+    }
+    assert(stored_count == 1 + 3 * 2);
+    
+    // 越界的容差和心跳
+    config = (LogCompressConfig){ LOG_COMPRESS_DEADBAND, LOG_COMPRESS_MAX_TOLERANCE + 1, 0 };
+    assert(!log_compress_config_valid(&config));
+    config = (LogCompressConfig){ LOG_COMPRESS_DEADBAND, 1, LOG_COMPRESS_MIN_HEARTBEAT_MS - 1 };
+    assert(!log_compress_config_valid(&config));
+    
+    // slog：设置传感器1为旋转门，0.5°C，HB缺省为默认心跳
+    log_compress_reset();
+    command_handler_init();
+    host_set_link(COMM_LINK_BLE);
+    uint8_t request[64];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint8_t data[MAX_PACKET_SIZE];
+    uint16_t response_len;
+    PacketHeader header;
+    const uint8_t *da;
+    uint16_t da_len;
+    int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_SET_LOG_INTERVAL);
+    uint8_t *fields = request + req_len;
+    req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_SENSOR, 1);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_LOG_COMPRESSION, LOG_COMPRESS_SWINGING_DOOR);
+    req_len += write_tlv_temperature(request + req_len, sizeof(request) - req_len, TAG_TOLERANCE, 5, TEMP_FORMAT_INT16);
+    write_tlv_end(fields, request + req_len - fields - 4);
+    uint32_t saves = host_config_save_count();
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0038, &test_scratch) == 0);
+    assert(host_config_save_count() == saves + 1);
+    int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    uint8_t mode, sensor;
+    uint32_t heartbeat;
+    float tolerance;
+    assert(data_len > 0 && read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+    assert(read_tlv_uint8(da, da_len, TAG_SENSOR, &sensor) > 0 && sensor == 1);
+    assert(read_tlv_uint8(da, da_len, TAG_LOG_COMPRESSION, &mode) > 0 && mode == LOG_COMPRESS_SWINGING_DOOR);
+    assert(read_tlv_float32(da, da_len, TAG_TOLERANCE, &tolerance) > 0 && tolerance > 0.49f && tolerance < 0.51f);
+    assert(read_tlv_uint32(da, da_len, TAG_HEARTBEAT, &heartbeat) > 0 && heartbeat == LOG_COMPRESS_DEFAULT_HEARTBEAT_MS);
+    log_compress_get_config(1, &config);
+    assert(config.mode == LOG_COMPRESS_SWINGING_DOOR && config.tolerance == 5);
+    log_compress_get_config(0, &config);
+    assert(config.mode == LOG_COMPRESS_NONE);
+    
+    // 保存的内容为各传感器的当前配置
+    LogCompressConfig saved;
+    sampling_settings_get_compress_item(1, &saved);
+    assert(saved.mode == LOG_COMPRESS_SWINGING_DOOR && saved.tolerance == 5 &&
+           saved.heartbeat_ms == LOG_COMPRESS_DEFAULT_HEARTBEAT_MS);
+    SamplingSettings settings;
+    sampling_settings_get_item(0, &settings);
+    assert(settings.log_interval_ms == temp_logger_get_interval() &&
+           settings.resolution == temperature_get_resolution() && settings.filter_mode == TEMP_FILTER_NONE);
+    
+    // 未知的压缩方式
+    req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_SET_LOG_INTERVAL);
+    fields = request + req_len;
+    req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_LOG_COMPRESSION, LOG_COMPRESS_SWINGING_DOOR + 1);
+    write_tlv_end(fields, request + req_len - fields - 4);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0039, &test_scratch) == 0);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    uint8_t status = STATUS_OK;
+    assert(data_len > 0 && read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0 && status == STATUS_INVALID_PARAM);
+    assert(host_config_save_count() == saves + 1);
+    
+    log_compress_reset();
+    printf("✓ 日志压缩测试通过\n\n");
+}
+
+// EMA滤波：从下方和上方都收敛到稳定的读数，没有残留的偏差
+void test_temp_filter(void) {
+    printf("测试温度滤波...\n");
+    host_reset();
+    
+    for (uint8_t shift = 1; shift <= TEMP_FILTER_MAX_SHIFT; shift++) {
+        TempFilterConfig config = { TEMP_FILTER_EMA, shift };
+        assert(temp_filter_config_valid(&config));
+        temp_filter_configure(&config);
+        
+        // 20.0°C起步后稳定在25.0°C；再降回20.0°C
+        static const int16_t steps[][2] = { { 200, 250 }, { 250, 200 }, { -100, -95 }, { -95, -100 } };
+        for (uint8_t s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+            temp_filter_configure(&config);
+            assert(temp_filter_apply(0, steps[s][0]) == steps[s][0]);
+            int16_t filtered = steps[s][0];
+            uint16_t n = 0;
+            for (; n < 1000 && filtered != steps[s][1]; n++) {
+                int16_t next = temp_filter_apply(0, steps[s][1]);
+                // 单调地靠近目标，不越过
+                assert(steps[s][1] > steps[s][0] ? next >= filtered && next <= steps[s][1]
+                                                 : next <= filtered && next >= steps[s][1]);
+                filtered = next;
+            }
+            assert(filtered == steps[s][1]);
+            for (uint8_t i = 0; i < 50; i++) {
+                assert(temp_filter_apply(0, steps[s][1]) == steps[s][1]);
+            }
+        }
+        
+        // 失败的读数不进入历史
+        assert(temp_filter_apply(0, TEMP_INVALID) == TEMP_INVALID);
+        assert(temp_filter_apply(0, -100) == -100);
+    }
+    
+    TempFilterConfig config = { TEMP_FILTER_EMA, TEMP_FILTER_MAX_SHIFT + 1 };
+    assert(!temp_filter_config_valid(&config));
+    config = (TempFilterConfig){ TEMP_FILTER_NONE, 0 };
+    temp_filter_configure(&config);
+    assert(temp_filter_apply(0, 123) == 123);
+    printf("✓ 温度滤波测试通过\n\n");
+}
+
+// 传感器校准：分段线性修正、外推、单点偏移和scal命令
+void test_sensor_calibration(void) {
+    printf("测试传感器校准...\n");
+    host_reset();
+    command_handler_init();
+    
+    // 两段：0°C读作0.3°C，50°C读作49.5°C，100°C读作101.0°C
+    TempCalibration calibration = { .count = 3, .measured = { 3, 495, 1010 }, .reference = { 0, 500, 1000 } };
+    assert(temp_calib_valid(&calibration));
+    temp_calib_configure(1, &calibration);
+    int16_t values[3] = { 3, 3, TEMP_INVALID };
+    temp_calib_apply(values, 3);
+    assert(values[0] == 3 && values[1] == 0 && values[2] == TEMP_INVALID); // 0号未校准
+    int16_t checks[][2] = { { 495, 500 }, { 249, 250 }, { 1010, 1000 }, { 752, 750 }, { -97, -102 }, { 1250, 1233 } };
+    for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+        int16_t pair[2] = { 0, checks[i][0] };
+        temp_calib_apply(pair, 2);
+        assert(pair[1] == checks[i][1]);
+    }
+    
+    // 单点：只修正偏移
+    calibration = (TempCalibration){ .count = 1, .measured = { 250 }, .reference = { 246 } };
+    temp_calib_configure(0, &calibration);
+    values[0] = -100;
+    temp_calib_apply(values, 1);
+    assert(values[0] == -104);
+    
+    // 不递增、斜率过大或越界的点
+    calibration = (TempCalibration){ .count = 2, .measured = { 500, 500 }, .reference = { 0, 100 } };
+    assert(!temp_calib_valid(&calibration));
+    calibration = (TempCalibration){ .count = 2, .measured = { 0, 10 }, .reference = { 0, 100 } };
+    assert(!temp_calib_valid(&calibration));
+    calibration = (TempCalibration){ .count = 1, .measured = { TEMP_CALIB_MAX + 1 }, .reference = { 0 } };
+    assert(!temp_calib_valid(&calibration));
+    
+    // scal：设置传感器2的两个点并保存，再查询
+    uint8_t request[64];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint8_t data[MAX_PACKET_SIZE];
+    uint16_t response_len;
+    PacketHeader header;
+    const uint8_t *da;
+    uint16_t da_len;
+    const uint8_t points[] = { 0x0A, 0x00, 0x00, 0x00, 0xE8, 0x03, 0xF6, 0x03 }; // 1.0→0.0，100.0→101.4
+    int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_SET_CALIBRATION);
+    uint8_t *fields = request + req_len;
+    req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_SENSOR, 2);
+    req_len += write_tlv_raw(request + req_len, sizeof(request) - req_len, TAG_CALIB_POINTS, points, sizeof(points));
+    write_tlv_end(fields, request + req_len - fields - 4);
+    uint32_t saves = host_config_save_count();
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0040, &test_scratch) == 0);
+    assert(host_config_save_count() == saves + 1);
+    int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    uint8_t status = STATUS_INTERNAL_ERROR, sensor = 0;
+    const uint8_t *echoed;
+    uint16_t echoed_len;
+    assert(data_len > 0 && read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0 && status == STATUS_OK);
+    assert(read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+    assert(read_tlv_uint8(da, da_len, TAG_SENSOR, &sensor) > 0 && sensor == 2);
+    assert(read_tlv_view(da, da_len, TAG_CALIB_POINTS, &echoed, &echoed_len) > 0);
+    assert(echoed_len == sizeof(points) && memcmp(echoed, points, sizeof(points)) == 0);
+    TempCalibration saved;
+    sampling_settings_get_calib_item(2, &saved);
+    assert(saved.count == 2 && saved.measured[1] == 1000 && saved.reference[1] == 1014);
+    int16_t readings[3] = { 0, 0, 505 };
+    temp_calib_apply(readings, 3);
+    assert(readings[2] == 507); // (505 - 10) × 1014/990 = 507.0
+    
+    // 点数不是整数个或不递增：INVALID_PARAM，不保存
+    const uint8_t bad[] = { 0xE8, 0x03, 0xE8, 0x03, 0x0A, 0x00, 0x0A, 0x00 };
+    const uint8_t *bad_cases[] = { bad, bad };
+    const uint16_t bad_lengths[] = { 3, sizeof(bad) };
+    for (uint8_t i = 0; i < 2; i++) {
+        req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_SET_CALIBRATION);
+        fields = request + req_len;
+        req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+        req_len += write_tlv_raw(request + req_len, sizeof(request) - req_len, TAG_CALIB_POINTS, bad_cases[i], bad_lengths[i]);
+        write_tlv_end(fields, request + req_len - fields - 4);
+        assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0041 + i, &test_scratch) == 0);
+        data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+        assert(data_len > 0 && read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0 && status == STATUS_INVALID_PARAM);
+    }
+    assert(host_config_save_count() == saves + 1);
+    
+    // 空KP清除校准
+    req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_SET_CALIBRATION);
+    fields = request + req_len;
+    req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_SENSOR, 2);
+    req_len += write_tlv_raw(request + req_len, sizeof(request) - req_len, TAG_CALIB_POINTS, points, 0);
+    write_tlv_end(fields, request + req_len - fields - 4);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0043, &test_scratch) == 0);
+    temp_calib_get(2, &saved);
+    assert(saved.count == 0);
+    
+    temp_calib_reset();
+    printf("✓ 传感器校准测试通过\n\n");
+}
+
+// 运行统计：与逐条计算的结果一致，时间窗滚动，超限时长和tsta命令
+void test_temp_stats(void) {
+    printf("测试运行统计...\n");
+    host_reset();
+    command_handler_init();
+    
+    // 2小时的逐秒读数：传感器0为锯齿波，传感器1在第30分钟后读取失败
+    temp_stats_set_threshold(0, 250);
+    uint32_t tick = 1000;
+    int64_t sum = 0, squares = 0, hour_sum = 0, hour_squares = 0;
+    uint32_t hour_count = 0, above = 0;
+    const uint32_t seconds = 7200;
+    const uint32_t end_tick = tick + seconds * 1000;
+    const uint32_t hour_start = (end_tick / TEMP_STATS_HOUR_BIN_MS - (TEMP_STATS_HOUR_BINS - 1)) * TEMP_STATS_HOUR_BIN_MS;
+    for (uint32_t second = 0; second < seconds; second++) {
+        int16_t values[2] = { (int16_t)(200 + (second % 97)), second < 1800 ? (int16_t)-55 : TEMP_INVALID };
+        temp_stats_update(values, 2, tick);
+        sum += values[0];
+        squares += (int64_t)values[0] * values[0];
+        // 最近一小时为当前5分钟的桶加上之前11个桶
+        if (tick >= hour_start) {
+            hour_sum += values[0];
+            hour_squares += (int64_t)values[0] * values[0];
+            hour_count++;
+        }
+        if (second > 0 && values[0] > 250) {
+            above += 1000;
+        }
+        tick += 1000;
+    }
+    TempStatsResult result;
+    assert(temp_stats_query(0, TEMP_STATS_SINCE_BOOT, tick, &result));
+    double mean = (double)sum / seconds;
+    double variance = ((double)squares - (double)sum * sum / seconds) / (seconds - 1);
+    assert(result.count == seconds && result.min == 200 && result.max == 296);
+    assert(result.mean == (int16_t)(mean + 0.5));
+    assert(result.variance == (uint32_t)(variance + 0.5));
+    assert(result.above_ms == above && result.threshold == 250);
+    
+    assert(temp_stats_query(0, TEMP_STATS_HOUR, tick, &result));
+    assert(result.count == hour_count && hour_count <= 3600 && hour_count > 3300);
+    double hour_mean = (double)hour_sum / hour_count;
+    double hour_variance = ((double)hour_squares - (double)hour_sum * hour_sum / hour_count) / (hour_count - 1);
+    assert(result.mean == (int16_t)(hour_mean + 0.5) && result.variance == (uint32_t)(hour_variance + 0.5));
+    assert(temp_stats_query(0, TEMP_STATS_DAY, tick, &result) && result.count == seconds);
+    
+    // 传感器1：恒定读数方差为0；一小时后滚出最近一小时的窗口
+    assert(temp_stats_query(1, TEMP_STATS_SINCE_BOOT, tick, &result));
+    assert(result.count == 1800 && result.min == -55 && result.max == -55 && result.mean == -55 && result.variance == 0);
+    assert(result.threshold == TEMP_INVALID && result.above_ms == 0);
+    assert(temp_stats_query(1, TEMP_STATS_HOUR, tick, &result) && result.count == 0);
+    
+    // 一天后最近一天的窗口也滚空，复位以来的统计不变
+    tick += TEMP_STATS_DAY_BIN_MS * TEMP_STATS_DAY_BINS;
+    assert(temp_stats_query(0, TEMP_STATS_DAY, tick, &result) && result.count == 0);
+    assert(temp_stats_query(0, TEMP_STATS_SINCE_BOOT, tick, &result) && result.count == seconds);
+    
+    // HAL_GetTick()回绕时时间窗照常
+    tick = 0xFFFFFFFFU - 5000;
+    temp_stats_clear(0);
+    for (uint32_t second = 0; second < 10; second++) {
+        int16_t value = 300;
+        temp_stats_update(&value, 1, tick);
+        tick += 1000;
+    }
+    assert(temp_stats_query(0, TEMP_STATS_HOUR, tick, &result) && result.count == 10 && result.above_ms == 9000);
+    
+    // tsta按模拟时钟查询：重新送入10秒的读数
+    temp_stats_reset();
+    temp_stats_set_threshold(0, 250);
+    for (uint32_t second = 0; second < 10; second++) {
+        int16_t value = 300;
+        host_set_temperatures(&value, 1);
+        host_advance_ms(1000);
+    }
+    
+    // tsta：传感器0最近一小时，阈值改为31.0°C，16位温度
+    uint8_t request[64];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint8_t data[MAX_PACKET_SIZE];
+    uint16_t response_len;
+    PacketHeader header;
+    const uint8_t *da;
+    uint16_t da_len;
+    int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_TEMP_STATS);
+    uint8_t *fields = request + req_len;
+    req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_WINDOW, TEMP_STATS_HOUR);
+    req_len += write_tlv_temperature(request + req_len, sizeof(request) - req_len, TAG_ABOVE_THRESHOLD, 310, TEMP_FORMAT_INT16);
+    write_tlv_end(fields, request + req_len - fields - 4);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0050, &test_scratch) == 0);
+    int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    uint8_t status = STATUS_INTERNAL_ERROR, window = 0;
+    uint32_t count = 0, reported_variance = 1, above_ms = 0;
+    float low, high, average, threshold;
+    assert(data_len > 0 && read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0 && status == STATUS_OK);
+    assert(read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0 && da_len < 80);
+    assert(read_tlv_uint8(da, da_len, TAG_WINDOW, &window) > 0 && window == TEMP_STATS_HOUR);
+    assert(read_tlv_uint32(da, da_len, TAG_BUCKET_COUNT, &count) > 0 && count == 10);
+    assert(read_tlv_float32(da, da_len, TAG_BUCKET_MIN, &low) > 0 && low > 29.9f && low < 30.1f);
+    assert(read_tlv_float32(da, da_len, TAG_BUCKET_MAX, &high) > 0 && high > 29.9f && high < 30.1f);
+    assert(read_tlv_float32(da, da_len, TAG_BUCKET_MEAN, &average) > 0 && average > 29.9f && average < 30.1f);
+    assert(read_tlv_uint32(da, da_len, TAG_STATS_VARIANCE, &reported_variance) > 0 && reported_variance == 0);
+    assert(read_tlv_uint32(da, da_len, TAG_ABOVE_TIME, &above_ms) > 0 && above_ms == 9000);
+    assert(read_tlv_float32(da, da_len, TAG_ABOVE_THRESHOLD, &threshold) > 0 && threshold > 30.9f && threshold < 31.1f);
+    
+    // 新阈值从下一次采样开始生效
+    int16_t value = 300;
+    host_set_temperatures(&value, 1);
+    req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_TEMP_STATS);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0053, &test_scratch) == 0);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 0 && read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+    assert(read_tlv_uint32(da, da_len, TAG_BUCKET_COUNT, &count) > 0 && count == 11);
+    assert(read_tlv_uint32(da, da_len, TAG_ABOVE_TIME, &above_ms) > 0 && above_ms == 9000);
+    
+    // CL=1清零；窗口编号越界
+    req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_TEMP_STATS);
+    fields = request + req_len;
+    req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_STATS_CLEAR, 1);
+    write_tlv_end(fields, request + req_len - fields - 4);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0051, &test_scratch) == 0);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 0 && read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+    assert(read_tlv_uint32(da, da_len, TAG_BUCKET_COUNT, &count) > 0 && count == 0);
+    assert(read_tlv_view(da, da_len, TAG_BUCKET_MEAN, &da, &da_len) < 0);
+    
+    req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_TEMP_STATS);
+    fields = request + req_len;
+    req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_WINDOW, TEMP_STATS_WINDOWS);
+    write_tlv_end(fields, request + req_len - fields - 4);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0052, &test_scratch) == 0);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 0 && read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0 && status == STATUS_INVALID_PARAM);
+    
+    temp_stats_reset();
+    printf("✓ 运行统计测试通过\n\n");
+}
+
+void test_bulk_temps(void) {
+    printf("测试所有传感器读数...\n");
+    host_reset();
+    command_handler_init();
+    
+    // 3个传感器，传感器1读取失败；1.5秒后查询
+    int16_t values[3] = { 253, TEMP_INVALID, -125 };
+    host_set_temperatures(values, 3);
+    host_advance_ms(1500);
+    
+    uint8_t request[32];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint8_t data[MAX_PACKET_SIZE];
+    uint16_t response_len;
+    PacketHeader header;
+    const uint8_t *da, *packed;
+    uint16_t da_len, packed_len;
+    int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_ALL_TEMPS);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0060, &test_scratch) == 0);
+    int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    uint8_t status = STATUS_INTERNAL_ERROR, count = 0;
+    uint32_t age = 0;
+    assert(data_len > 0 && read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0 && status == STATUS_OK);
+    assert(read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+    assert(read_tlv_uint32(da, da_len, TAG_SAMPLE_AGE, &age) > 0 && age == 1500);
+    assert(read_tlv_uint8(da, da_len, TAG_SENSOR_COUNT, &count) > 0 && count == 3);
+    assert(read_tlv_view(da, da_len, TAG_TEMP_PACKED, &packed, &packed_len) > 0 && packed_len == 3 * 8);
+    for (uint8_t i = 0; i < count; i++) {
+        const uint8_t *record = packed + i * 8;
+        int16_t temperature = (int16_t)(record[2] | (record[3] << 8));
+        int16_t raw = (int16_t)(record[4] | (record[5] << 8));
+        assert(record[0] == i && record[1] == (values[i] != TEMP_INVALID ? 1 : 0));
+        assert(temperature == values[i] && raw == values[i]);
+    }
+    printf("✓ 所有传感器读数测试通过\n\n");
+}
+
+// 发送带MA的temp，返回应答中的AG；deferred为是否挂起等待了新的转换
+static uint32_t request_temp_max_age(uint32_t max_age, bool *deferred) {
+    uint8_t request[32];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint8_t data[MAX_PACKET_SIZE];
+    uint16_t response_len;
+    PacketHeader header;
+    const uint8_t *da;
+    uint16_t da_len;
+    int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_TEMP);
+    uint8_t *fields = request + req_len;
+    req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint32(request + req_len, sizeof(request) - req_len, TAG_MAX_AGE, max_age);
+    write_tlv_end(fields, request + req_len - fields - 4);
+    
+    int result = process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0061, &test_scratch);
+    *deferred = result == COMMAND_DEFERRED;
+    if (*deferred) {
+        uint8_t link = COMM_LINK_WIRED;
+        assert(command_handler_poll(response, sizeof(response), &response_len, &link, &test_scratch) == 1);
+    } else {
+        assert(result == 0);
+    }
+    int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    uint8_t status = STATUS_INTERNAL_ERROR;
+    uint32_t age = UINT32_MAX;
+    assert(data_len > 0 && read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0 && status == STATUS_OK);
+    assert(read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+    assert(read_tlv_uint32(da, da_len, TAG_SAMPLE_AGE, &age) > 0);
+    return age;
+}
+
+void test_temp_max_age(void) {
+    printf("测试带最大时效的温度读取...\n");
+    host_reset();
+    command_handler_init();
+    host_advance_ms(400);
+    
+    // 缓存不超过MA：直接返回缓存，不开始新的转换
+    TempSample sample;
+    assert(temp_sampler_get(&sample));
+    uint32_t sequence = sample.sequence;
+    bool deferred = true;
+    assert(request_temp_max_age(400, &deferred) == 400 && !deferred);
+    assert(temp_sampler_get(&sample) && sample.sequence == sequence);
+    
+    // 缓存过旧：开始一次转换，发布后再应答
+    assert(request_temp_max_age(399, &deferred) == 0 && deferred);
+    assert(temp_sampler_get(&sample) && sample.sequence == sequence + 1);
+    
+    command_handler_init();
+    printf("✓ 带最大时效的温度读取测试通过\n\n");
+}
+
+// 模拟驱动：转换conversion_ms后完成，通道c的读数为base + c
+typedef struct {
+    uint8_t channels;
+    uint32_t conversion_ms;
+    int16_t base;
+    bool start_ok;
+    bool never_done;     // 转换一直不结束
+    uint8_t open_mask;   // 开路的通道
+    uint32_t started;
+    uint32_t done_tick;  // 读取第一个通道时的时间
+    uint32_t polls;
+} FakeSensorDriver;
+
+static uint8_t fake_driver_probe(void *context) {
+    return ((FakeSensorDriver *)context)->channels;
+}
+
+static bool fake_driver_start(void *context, uint32_t *remaining_ms) {
+    FakeSensorDriver *fake = context;
+    fake->started = HAL_GetTick();
+    *remaining_ms = fake->conversion_ms;
+    return fake->start_ok;
+}
+
+static bool fake_driver_poll(void *context) {
+    FakeSensorDriver *fake = context;
+    fake->polls++;
+    return !fake->never_done && HAL_GetTick() - fake->started >= fake->conversion_ms;
+}
+
+static int16_t fake_driver_read(void *context, uint8_t channel) {
+    FakeSensorDriver *fake = context;
+    if (channel == 0) {
+        fake->done_tick = HAL_GetTick();
+    }
+    return (int16_t)(fake->base + channel);
+}
+
+static bool fake_driver_healthy(void *context, uint8_t channel) {
+    return (((FakeSensorDriver *)context)->open_mask & (1U << channel)) == 0;
+}
+
+static const TempDriver fake_driver = {
+    .name = "fake",
+    .probe = fake_driver_probe,
+    .start = fake_driver_start,
+    .poll = fake_driver_poll,
+    .read = fake_driver_read,
+    .healthy = fake_driver_healthy,
+};
+
+void test_sensor_drivers(void) {
+    printf("测试传感器驱动调度...\n");
+    host_reset();
+    
+    // 1-Wire（750ms，2个）、ADC热敏电阻（不需要等待，开路1个）、SPI热电偶（220ms，2个只用1个）
+    FakeSensorDriver onewire = { .channels = 2, .conversion_ms = 750, .base = 200, .start_ok = true };
+    FakeSensorDriver adc = { .channels = 1, .conversion_ms = 0, .base = 300, .start_ok = true };
+    FakeSensorDriver spi = { .channels = 2, .conversion_ms = 220, .base = 400, .start_ok = true };
+    temp_driver_reset();
+    assert(temp_driver_register(&fake_driver, &onewire));
+    assert(temp_driver_register(&fake_driver, &adc));
+    assert(temp_driver_register(&fake_driver, &spi));
+    assert(temp_driver_probe() == TEMP_MAX_SENSORS && temp_driver_sensor_count() == TEMP_MAX_SENSORS);
+    
+    // 转换重叠：耗时为最慢的驱动，先完成的先读取，到期前不轮询
+    int16_t temperatures[TEMP_MAX_SENSORS];
+    uint32_t start = HAL_GetTick();
+    assert(temp_driver_sample(temperatures) == TEMP_MAX_SENSORS);
+    assert(HAL_GetTick() - start == 750);
+    assert(temperatures[0] == 200 && temperatures[1] == 201 && temperatures[2] == 300 && temperatures[3] == 400);
+    assert(adc.done_tick == start && spi.done_tick == start + 220 && onewire.done_tick == start + 750);
+    assert(onewire.polls == 1 && spi.polls == 1);
+    
+    // 开路的通道和启动失败的驱动记为失败，其余照常
+    adc.open_mask = 0x01;
+    onewire.start_ok = false;
+    assert(temp_driver_sample(temperatures) == TEMP_MAX_SENSORS);
+    assert(temperatures[0] == TEMP_INVALID && temperatures[1] == TEMP_INVALID);
+    assert(temperatures[2] == TEMP_INVALID && temperatures[3] == 400);
+    
+    // 转换不结束的驱动超时后放弃
+    onewire.start_ok = true;
+    onewire.never_done = true;
+    start = HAL_GetTick();
+    assert(temp_driver_sample(temperatures) == TEMP_MAX_SENSORS);
+    assert(temperatures[0] == TEMP_INVALID && temperatures[3] == 400);
+    assert(HAL_GetTick() - start >= 750 + TEMP_DRIVER_TIMEOUT_MS &&
+           HAL_GetTick() - start < 750 + TEMP_DRIVER_TIMEOUT_MS + 2 * TEMP_DRIVER_POLL_MS);
+    
+    // 驱动表已满
+    assert(temp_driver_register(&fake_driver, &adc));
+    assert(!temp_driver_register(&fake_driver, &adc));
+    temp_driver_reset();
+    assert(temp_driver_probe() == 0);
+    printf("✓ 传感器驱动调度测试通过\n\n");
+}
+
+void test_analog_temps(void) {
+    printf("测试模拟温度通道...\n");
+    
+    // NTC查表：表上的点精确，点之间插值（期望值按B公式计算）
+    assert(analog_temp_ntc_deci(32760) == 250);
+    assert(analog_temp_ntc_deci(50500) == 0);
+    struct { uint16_t average; int16_t expected; } ntc[] = {
+        { 24543, 370 }, { 56954, -123 }, { 4084, 1017 }, { 63752, -385 }, { 2325, 1240 },
+    };
+    for (size_t i = 0; i < sizeof(ntc) / sizeof(ntc[0]); i++) {
+        int16_t deci = analog_temp_ntc_deci(ntc[i].average);
+        assert(deci >= ntc[i].expected - 2 && deci <= ntc[i].expected + 2);
+    }
+    for (uint32_t average = ANALOG_NTC_SHORT; average < ANALOG_NTC_OPEN; average += 97) {
+        assert(analog_temp_ntc_deci((uint16_t)average) >= analog_temp_ntc_deci((uint16_t)(average + 97)));
+    }
+    assert(analog_temp_ntc_deci(64000) == -400 && analog_temp_ntc_deci(2000) == 1250);
+    assert(analog_temp_ntc_deci(ANALOG_NTC_OPEN + 1) == TEMP_INVALID);
+    assert(analog_temp_ntc_deci(ANALOG_NTC_SHORT - 1) == TEMP_INVALID);
+    
+    // 片内传感器：VDDA为3.3V时1.43V为25°C，4.3mV/°C
+    assert(analog_temp_internal_deci(28391, 23825) == 250);
+    assert(analog_temp_internal_deci(25403, 23825) == 600);
+    assert(analog_temp_internal_deci(32233, 23825) == -200);
+    assert(analog_temp_internal_deci(28391, 1000) == TEMP_INVALID);
+    
+    // DMA半缓冲的累加：NTC0为37°C，NTC1开路，片内两个读数交替（平均值含小数部分）
+    analog_temp_reset();
+    assert(!analog_temp_snapshot() && !analog_temp_channel_ok(0));
+    uint16_t frames[ANALOG_TEMP_FRAMES][ANALOG_INPUT_COUNT];
+    for (uint16_t f = 0; f < ANALOG_TEMP_FRAMES; f++) {
+        frames[f][ANALOG_INPUT_NTC0] = 1534;
+        frames[f][ANALOG_INPUT_NTC1] = 4095;
+        frames[f][ANALOG_INPUT_INTERNAL] = (f & 1) ? 1775 : 1774;
+        frames[f][ANALOG_INPUT_VREFINT] = 1489;
+    }
+    analog_temp_accumulate(&frames[0][0], ANALOG_TEMP_FRAMES);
+    analog_temp_accumulate(&frames[0][0], ANALOG_TEMP_FRAMES);
+    assert(analog_temp_snapshot());
+    assert(analog_temp_average(ANALOG_INPUT_NTC0) == 1534 * 16 && analog_temp_average(ANALOG_INPUT_INTERNAL) == 28392);
+    int16_t deci = analog_temp_read(0);
+    assert(deci >= 368 && deci <= 372);
+    assert(!analog_temp_channel_ok(1) && analog_temp_read(1) == TEMP_INVALID);
+    assert(analog_temp_channel_ok(2) && analog_temp_read(2) == 250);
+    assert(!analog_temp_channel_ok(ANALOG_TEMP_CHANNELS));
+    
+    // 锁存后从零开始；没有新的转换时读数都视为失败
+    assert(!analog_temp_snapshot() && analog_temp_read(0) == TEMP_INVALID);
+    
+    // 长时间没有锁存时从头累加，平均值只含最近的转换
+    for (uint16_t f = 0; f < ANALOG_TEMP_FRAMES; f++) {
+        frames[f][ANALOG_INPUT_NTC0] = 2048;
+    }
+    for (uint32_t n = 0; n < ANALOG_TEMP_MAX_FRAMES / ANALOG_TEMP_FRAMES; n++) {
+        analog_temp_accumulate(&frames[0][0], ANALOG_TEMP_FRAMES);
+    }
+    for (uint16_t f = 0; f < ANALOG_TEMP_FRAMES; f++) {
+        frames[f][ANALOG_INPUT_NTC0] = 1000;
+    }
+    analog_temp_accumulate(&frames[0][0], ANALOG_TEMP_FRAMES);
+    assert(analog_temp_snapshot() && analog_temp_average(ANALOG_INPUT_NTC0) == 1000 * 16);
+    analog_temp_reset();
+    printf("✓ 模拟温度通道测试通过\n\n");
+}
+
+void test_scripted_source(void) {
+    printf("测试脚本传感器和倍速时钟...\n");
+    host_reset();
+    
+    // 经驱动调度采样：转换立即完成，读数只由种子和采样序号决定
+    TestScript first, second;
+    test_script_init(&first, 7, TEMP_MAX_SENSORS);
+    temp_driver_reset();
+    assert(temp_driver_register(&test_script_driver, &first));
+    assert(temp_driver_probe() == TEMP_MAX_SENSORS);
+    static int16_t recorded[600][TEMP_MAX_SENSORS];
+    uint32_t start = HAL_GetTick();
+    for (uint32_t n = 0; n < 600; n++) {
+        assert(temp_driver_sample(recorded[n]) == TEMP_MAX_SENSORS);
+    }
+    assert(HAL_GetTick() == start);
+    
+    // 重新探测后从头开始，结果相同；种子不同时噪声不同
+    test_script_init(&second, 7, TEMP_MAX_SENSORS);
+    temp_driver_reset();
+    assert(temp_driver_register(&test_script_driver, &second));
+    assert(temp_driver_probe() == TEMP_MAX_SENSORS);
+    bool same_after_reseed = true;
+    TestScript other;
+    test_script_init(&other, 8, TEMP_MAX_SENSORS);
+    for (uint32_t n = 0; n < 600; n++) {
+        int16_t temperatures[TEMP_MAX_SENSORS];
+        temp_driver_sample(temperatures);
+        assert(memcmp(temperatures, recorded[n], sizeof(temperatures)) == 0);
+        same_after_reseed &= test_script_value(&other, 1, n) == recorded[n][1];
+    }
+    assert(!same_after_reseed);
+    temp_driver_reset();
+    
+    // 读数范围：基准±三角波和噪声；0号传感器在每个尖峰窗口末尾升高，最后一个传感器定期失败
+    for (uint32_t n = 0; n < 600; n++) {
+        for (uint8_t i = 0; i < TEMP_MAX_SENSORS; i++) {
+            int16_t value = recorded[n][i];
+            bool dropped = i == TEMP_MAX_SENSORS - 1 && n % TEST_SCRIPT_DROP_EVERY == TEST_SCRIPT_DROP_EVERY - 1;
+            assert((value == TEMP_INVALID) == dropped);
+            if (dropped) {
+                continue;
+            }
+            int32_t offset = value - (TEST_SCRIPT_BASE + i * TEST_SCRIPT_STEP);
+            if (i == 0 && n % TEST_SCRIPT_SPIKE_EVERY >= TEST_SCRIPT_SPIKE_EVERY - TEST_SCRIPT_SPIKE_LENGTH) {
+                offset -= TEST_SCRIPT_SPIKE;
+            }
+            assert(offset >= -(TEST_SCRIPT_AMPLITUDE + TEST_SCRIPT_NOISE) &&
+                   offset <= TEST_SCRIPT_AMPLITUDE + TEST_SCRIPT_NOISE);
+        }
+    }
+    assert(recorded[0][0] <= TEST_SCRIPT_BASE - TEST_SCRIPT_AMPLITUDE + TEST_SCRIPT_NOISE);
+    assert(recorded[300][0] >= TEST_SCRIPT_BASE + TEST_SCRIPT_AMPLITUDE - TEST_SCRIPT_NOISE);
+    assert(recorded[299][0] - recorded[294][0] > TEST_SCRIPT_SPIKE / 2);
+    
+    // 倍速换算：等待的节拍数向上取整，之后虚拟时钟不早于目标
+    assert(test_clock_elapsed_ms(100, 10) == 1000);
+    assert(test_clock_wait_ticks(1000, 10) == 100 && test_clock_wait_ticks(1001, 10) == 101);
+    assert(test_clock_wait_ticks(0, 10) == 0 && test_clock_wait_ticks(999, 1) == 999);
+    assert(test_clock_wait_ticks(UINT64_MAX / 2, 1) == UINT32_MAX);
+    for (uint64_t span = 1; span < 5000; span += 37) {
+        assert(test_clock_elapsed_ms(test_clock_wait_ticks(span, 50), 50) >= span);
+    }
+    printf("✓ 脚本传感器和倍速时钟测试通过\n\n");
+}
+
+void test_sample_schedule(void) {
+    printf("测试采样计划...\n");
+    host_reset();
+    command_handler_init();
+    
+    // 第一次提前一整个周期开始，之后按转换耗时（750ms）加余量提前
+    sample_schedule_reset(1000);
+    uint64_t now = 1700000000300ULL;
+    uint64_t start = sample_schedule_next_start(now);
+    assert(sample_schedule_due() == 1700000002000ULL && start == 1700000001000ULL);
+    sample_schedule_complete(sample_schedule_due(), 750);
+    for (uint32_t i = 0; i < 9; i++) {
+        start = sample_schedule_next_start(start + 750);
+        assert(sample_schedule_due() % 1000 == 0 && start == sample_schedule_due() - 770);
+        sample_schedule_complete(sample_schedule_due() + (i == 4 ? 3 : 0), 750); // 一次晚3ms
+    }
+    SampleScheduleStats stats;
+    sample_schedule_get_stats(&stats);
+    assert(stats.samples == 10 && stats.missed == 0 && stats.error_max_ms == 3 && stats.lead_ms == 770);
+    assert(stats.error_hist[0] == 9 && stats.error_hist[2] == 1);
+    
+    // 晚于容差记为错过；转换超过一个周期时跳过的周期也记为错过，下一个计划时刻仍为整秒
+    uint64_t due = sample_schedule_due();
+    sample_schedule_next_start(due - 770);
+    sample_schedule_complete(due + SAMPLE_SCHEDULE_TOLERANCE_MS + 1, 750);
+    sample_schedule_next_start(due + 300);
+    sample_schedule_complete(due + 2200, 1500);
+    assert(sample_schedule_due() == due + 3000);
+    sample_schedule_get_stats(&stats);
+    assert(stats.samples == 12 && stats.missed == 3 && stats.lead_ms == 1000);
+    assert(stats.error_max_ms == 1200 && stats.error_hist[6] == 1 && stats.error_hist[SAMPLE_SCHEDULE_BUCKETS - 1] == 1);
+    
+    // 时间回拨和大幅前进时重新对齐，不计为错过
+    sample_schedule_next_start(due - 3600000ULL);
+    assert(sample_schedule_due() == due - 3600000ULL + 2000);
+    sample_schedule_next_start(due + 7200000ULL);
+    assert(sample_schedule_due() == due + 7200000ULL + 2000);
+    
+    // stat返回采样计划的统计，CL=1同时清零
+    uint8_t request[32];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint8_t data[MAX_PACKET_SIZE];
+    uint16_t response_len;
+    PacketHeader header;
+    const uint8_t *da, *hist;
+    uint16_t da_len, hist_len;
+    int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_STATS);
+    uint8_t *fields = request + req_len;
+    req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_STATS_CLEAR, 1);
+    write_tlv_end(fields, request + req_len - fields - 4);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0070, &test_scratch) == 0);
+    int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    uint32_t samples = 0, missed = 0, error_max = 0, lead = 0;
+    assert(data_len > 0 && read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+    assert(read_tlv_uint32(da, da_len, TAG_SCHED_SAMPLES, &samples) > 0 && samples == 12);
+    assert(read_tlv_uint32(da, da_len, TAG_SCHED_MISSED, &missed) > 0 && missed == 3);
+    assert(read_tlv_uint32(da, da_len, TAG_SCHED_ERROR_MAX, &error_max) > 0 && error_max == 1200);
+    assert(read_tlv_view(da, da_len, TAG_SCHED_ERROR_HIST, &hist, &hist_len) > 0 && hist_len == SAMPLE_SCHEDULE_BUCKETS * 2);
+    assert(hist[0] == 9 && hist[4] == 1);
+    assert(read_tlv_uint32(da, da_len, TAG_SCHED_LEAD, &lead) > 0 && lead == 1000);
+    sample_schedule_get_stats(&stats);
+    assert(stats.samples == 0 && stats.missed == 0 && stats.lead_ms == 1000);
+    printf("✓ 采样计划测试通过\n\n");
+}
+
+// 内存中的块设备：超级块和16个数据块
+#define TEST_ARCHIVE_BLOCKS 17U
+static uint8_t archive_disk[TEST_ARCHIVE_BLOCKS][LOG_ARCHIVE_BLOCK_SIZE];
+static bool archive_disk_fail;
+static uint32_t archive_writes;
+static int archive_locked;
+
+static bool archive_disk_read(void *context, uint32_t block, uint32_t count, void *data) {
+    (void)context;
+    assert(archive_locked == 1 && block + count <= TEST_ARCHIVE_BLOCKS);
+    memcpy(data, archive_disk[block], count * LOG_ARCHIVE_BLOCK_SIZE);
+    return !archive_disk_fail;
+}
+
+static bool archive_disk_write(void *context, uint32_t block, uint32_t count, const void *data) {
+    (void)context;
+    assert(archive_locked == 1 && block + count <= TEST_ARCHIVE_BLOCKS && count <= LOG_ARCHIVE_STAGE_BLOCKS);
+    if (archive_disk_fail) {
+        return false;
+    }
+    memcpy(archive_disk[block], data, count * LOG_ARCHIVE_BLOCK_SIZE);
+    archive_writes++;
+    return true;
+}
+
+static void archive_disk_lock(void *context) {
+    (void)context;
+    assert(archive_locked++ == 0);
+}
+
+static void archive_disk_unlock(void *context) {
+    (void)context;
+    assert(--archive_locked == 0);
+}
+
+static const LogArchiveOps archive_disk_ops = {
+    archive_disk_read, archive_disk_write, archive_disk_lock, archive_disk_unlock,
+};
+
+// 读出全部归档记录，检查按时间递增，返回条数
+static uint32_t archive_read_all(uint64_t *first_ms, uint64_t *last_ms) {
+    LogStoreIter iter;
+    uint64_t timestamp_ms, previous = 0;
+    LogSamplePayload sample;
+    uint32_t count = 0;
+    log_archive_iter_begin(&iter);
+    while (log_archive_iter_next(&iter, &timestamp_ms, &sample)) {
+        assert(count == 0 || timestamp_ms > previous);
+        if (count == 0) {
+            *first_ms = timestamp_ms;
+        }
+        previous = timestamp_ms;
+        count++;
+    }
+    *last_ms = previous;
+    return count;
+}
+
+void test_log_archive(void) {
+    printf("=== 测试SD卡日志归档 ===\n");
+    
+    memset(archive_disk, 0, sizeof(archive_disk));
+    archive_disk_fail = false;
+    archive_writes = 0;
+    const LogArchiveDevice device = { &archive_disk_ops, NULL, TEST_ARCHIVE_BLOCKS };
+    const uint64_t base_ms = 1750000000000ULL;
+    uint32_t format_id = 1;
+    uint64_t first_ms, last_ms, timestamp_ms;
+    LogSamplePayload sample;
+    LogStoreIter iter;
+    
+    // 空白卡：写入超级块
+    assert(log_archive_mount(&device, format_id) && log_archive_ready() && archive_writes == 1);
+    assert(!log_archive_last_time(&last_ms));
+    
+    // 100条记录（两块），第5条滤波前后相差超过12.7°C
+    for (uint32_t i = 0; i < 100; i++) {
+        sample = (LogSamplePayload){ (int16_t)(200 + i), (int16_t)(i == 5 ? 900 : 201 + i), (uint8_t)(i % 2) };
+        assert(log_archive_stage(base_ms + i * 1000ULL, &sample));
+    }
+    // 未到期时只留在暂存块中，已可读取；到期后一次写入两块
+    assert(log_archive_service(0, false) == LOG_ARCHIVE_FLUSH_MS && archive_writes == 1);
+    assert(archive_read_all(&first_ms, &last_ms) == 100 && first_ms == base_ms);
+    assert(log_archive_service(LOG_ARCHIVE_FLUSH_MS, false) == UINT32_MAX && archive_writes == 2);
+    
+    // 重新挂载：找到最新的块，内容不变
+    assert(log_archive_mount(&device, format_id));
+    assert(log_archive_last_time(&last_ms) && last_ms == base_ms + 99000ULL);
+    assert(archive_read_all(&first_ms, &last_ms) == 100);
+    log_archive_iter_begin(&iter);
+    for (uint32_t i = 0; i <= 5; i++) {
+        assert(log_archive_iter_next(&iter, &timestamp_ms, &sample));
+    }
+    assert(timestamp_ms == base_ms + 5000ULL && sample.temperature == 205 && sample.raw == 205 + 127 && sample.sensor == 1);
+    
+    // 按时间定位，位置可用于续传
+    log_archive_seek(&iter, base_ms + 50500ULL);
+    uint32_t position = log_archive_iter_position(&iter);
+    assert(log_archive_iter_next(&iter, &timestamp_ms, &sample) && timestamp_ms == base_ms + 51000ULL);
+    log_archive_iter_resume(&iter, position);
+    assert(log_archive_iter_next(&iter, &timestamp_ms, &sample) && sample.temperature == 251);
+    
+    // 按温度筛选：第一块的范围之外整块跳过，正在填写的块照常返回
+    log_archive_iter_begin(&iter);
+    iter.low = 400; // 同log_store_iter_filter()
+    assert(log_archive_iter_next(&iter, &timestamp_ms, &sample) && iter.skipped == 1);
+    assert(timestamp_ms == base_ms + 61000ULL);
+    
+    // 写满后回绕覆盖最旧的块：暂存块满时先写入
+    uint32_t total = 100;
+    for (; total < 100 + 40 * 61; total++) {
+        sample = (LogSamplePayload){ (int16_t)(total % 300), (int16_t)(total % 300), 0 };
+        while (!log_archive_stage(base_ms + total * 1000ULL, &sample)) {
+            assert(log_archive_service(0, true) == UINT32_MAX);
+        }
+    }
+    assert(log_archive_service(0, true) == UINT32_MAX);
+    uint32_t count = archive_read_all(&first_ms, &last_ms);
+    assert(count > 15 * 61 && count <= 16 * 61 && last_ms == base_ms + (total - 1) * 1000ULL);
+    assert(first_ms == base_ms + (total - count) * 1000ULL);
+    // 被覆盖的位置从最旧的记录继续
+    log_archive_iter_resume(&iter, position);
+    assert(log_archive_iter_next(&iter, &timestamp_ms, &sample) && timestamp_ms == first_ms);
+    assert(log_archive_mount(&device, format_id) && archive_read_all(&timestamp_ms, &last_ms) == count);
+    
+    // 写入失败：记录留在暂存块中，稍后重试
+    archive_disk_fail = true;
+    sample = (LogSamplePayload){ 250, 250, 0 };
+    assert(log_archive_stage(base_ms + total * 1000ULL, &sample));
+    assert(log_archive_service(0, true) > 0);
+    archive_disk_fail = false;
+    assert(log_archive_service(5000, false) == UINT32_MAX);
+    assert(log_archive_mount(&device, format_id) && log_archive_last_time(&last_ms) && last_ms == base_ms + total * 1000ULL);
+    
+    // 清除：新的一代，位置继续递增
+    log_archive_iter_begin(&iter);
+    position = log_archive_iter_position(&iter);
+    log_archive_clear();
+    assert(archive_read_all(&first_ms, &last_ms) == 0);
+    assert(log_archive_service(0, false) == UINT32_MAX);
+    assert(log_archive_mount(&device, format_id) && archive_read_all(&first_ms, &last_ms) == 0);
+    for (uint32_t i = 0; i < 3; i++) {
+        assert(log_archive_stage(base_ms + (total + 10 + i) * 1000ULL, &sample));
+    }
+    assert(log_archive_service(0, true) == UINT32_MAX);
+    assert(log_archive_mount(&device, format_id) && archive_read_all(&first_ms, &last_ms) == 3);
+    log_archive_iter_begin(&iter);
+    assert(log_archive_iter_position(&iter) > position);
+    
+    // 超级块损坏：重新格式化，原有数据不再读取
+    archive_disk[0][0] ^= 0xFF;
+    format_id++;
+    assert(log_archive_mount(&device, format_id) && archive_read_all(&first_ms, &last_ms) == 0);
+    
+    // glog AR：没有归档时返回NOT_INITIALIZED，不能与BW同时使用
+    host_reset();
+    command_handler_init();
+    host_set_link(COMM_LINK_BLE);
+    uint8_t request[64];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint8_t data[MAX_PACKET_SIZE];
+    uint16_t response_len;
+    PacketHeader header;
+    uint8_t status;
+    const uint8_t bucket_flags[] = { 0, 0, 1 };
+    const uint8_t expected[] = { STATUS_NOT_INITIALIZED, STATUS_OK, STATUS_INVALID_PARAM };
+    for (uint8_t i = 0; i < 3; i++) {
+        host_set_archive(i > 0);
+        int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_LOG);
+        uint8_t *fields = request + req_len;
+        req_len += write_tlv_begin(fields, sizeof(request) - req_len, TAG_DATA);
+        req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_ARCHIVE, 1);
+        if (bucket_flags[i]) {
+            req_len += write_tlv_uint32(request + req_len, sizeof(request) - req_len, TAG_BUCKET_WIDTH, 3600);
+        }
+        write_tlv_end(fields, request + req_len - fields - 4);
+        assert(process_command_packet(request, req_len, response, sizeof(response), &response_len,
+                                      (uint16_t)(0x0040 + i), &test_scratch) == 0);
+        int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+        assert(data_len > 0 && read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0 && status == expected[i]);
+    }
+    host_set_archive(false);
+    
+    printf("✓ SD卡日志归档测试通过\n\n");
+}
+
+// 测试链路吞吐命令：生成的载荷分3帧连续发送，SQ依次编号
+void test_bench_command(void) {
+    printf("=== 测试bnch命令 ===\n");
+    
+    command_handler_init();
+    uint8_t request[64];
+    uint8_t response[MAX_PACKET_SIZE * 2];
+    uint16_t response_len;
+    
+    int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_BENCH);
+    uint8_t *da = request + req_len;
+    req_len += write_tlv_begin(da, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint16(request + req_len, sizeof(request) - req_len, TAG_BENCH_SIZE, 200);
+    req_len += write_tlv_uint16(request + req_len, sizeof(request) - req_len, TAG_BENCH_COUNT, 3);
+    write_tlv_end(da, request + req_len - da - 4);
+    
+    int result = process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0010, &test_scratch);
+    assert(result == 0);
+    for (uint16_t sequence = 0; sequence < 3; sequence++) {
+        if (sequence > 0) {
+            uint8_t link = COMM_LINK_WIRED;
+            assert(command_handler_poll(response, sizeof(response), &response_len, &link, &test_scratch) == 1);
+            assert(link == COMM_LINK_BLE);
+        }
+        PacketHeader header;
+        uint8_t data[MAX_PACKET_SIZE];
+        int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+        assert(data_len > 0 && header.response_id == 0x0010);
+        
+        uint8_t da_value[MAX_PACKET_SIZE];
+        uint16_t da_len = sizeof(da_value);
+        uint16_t frame_sequence;
+        uint8_t payload[256];
+        uint16_t payload_len = sizeof(payload);
+        assert(read_tlv_raw(data, data_len, TAG_DATA, da_value, &da_len) > 0);
+        assert(read_tlv_uint16(da_value, da_len, TAG_SEQUENCE, &frame_sequence) > 0 && frame_sequence == sequence);
+        assert(read_tlv_raw(da_value, da_len, TAG_BENCH_PAYLOAD, payload, &payload_len) == 200);
+        assert(payload[0] == (uint8_t)sequence && payload[199] == (uint8_t)(sequence + 199));
+    }
+    assert(command_handler_next_due_ms() == UINT32_MAX);
+    
+    printf("✓ bnch命令测试通过\n\n");
+}
+
+// 测试多链路会话：在有线链路上订阅，推送只发往有线链路，BLE链路的会话不受影响
+void test_link_sessions(void) {
+    printf("=== 测试多链路会话 ===\n");
+    
+    command_handler_init();
+    uint8_t request[64];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint16_t response_len;
+    
+    // 有线链路：每秒推送一次
+    int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_SUBSCRIBE);
+    uint8_t *da = request + req_len;
+    req_len += write_tlv_begin(da, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint32(request + req_len, sizeof(request) - req_len, TAG_INTERVAL, SUBSCRIBE_MIN_INTERVAL_MS);
+    write_tlv_end(da, request + req_len - da - 4);
+    host_set_link(COMM_LINK_WIRED);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0020, &test_scratch) == 0);
+    
+    // 订阅后立即推送一次，发往有线链路
+    uint8_t link = COMM_LINK_BLE;
+    assert(command_handler_next_due_ms() == 0);
+    assert(command_handler_poll(response, sizeof(response), &response_len, &link, &test_scratch) == 1);
+    assert(link == COMM_LINK_WIRED);
+    assert(command_handler_next_due_ms() > 0);
+    
+    // BLE链路上取消订阅不影响有线链路
+    req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_SUBSCRIBE);
+    da = request + req_len;
+    req_len += write_tlv_begin(da, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint32(request + req_len, sizeof(request) - req_len, TAG_INTERVAL, 0);
+    write_tlv_end(da, request + req_len - da - 4);
+    host_set_link(COMM_LINK_BLE);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0021, &test_scratch) == 0);
+    assert(command_handler_next_due_ms() <= SUBSCRIBE_MIN_INTERVAL_MS);
+    
+    host_advance_ms(SUBSCRIBE_MIN_INTERVAL_MS);
+    link = COMM_LINK_BLE;
+    assert(command_handler_poll(response, sizeof(response), &response_len, &link, &test_scratch) == 1);
+    assert(link == COMM_LINK_WIRED);
+    
+    // BLE链路开启紧凑响应：开启它的ping响应起，数据部分为ST + DA的值
+    host_set_link(COMM_LINK_BLE);
+    req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_PING);
+    da = request + req_len;
+    req_len += write_tlv_begin(da, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_COMPACT, 1);
+    write_tlv_end(da, request + req_len - da - 4);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0022, &test_scratch) == 0);
+    PacketHeader header;
+    uint8_t data[256];
+    uint8_t value;
+    int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 1 && header.type == PKT_TYPE_SLAVE_COMPACT && header.response_id == 0x0022);
+    assert(data[0] == STATUS_OK);
+    assert(read_tlv_uint8(data + 1, data_len - 1, TAG_COMPACT, &value) > 0 && value == 1);
+    assert(read_tlv_uint8(data + 1, data_len - 1, TAG_SCHEMA_VERSION, &value) > 0 && value == TLV_SCHEMA_VERSION);
+    
+    static const uint8_t rled_request[] = {'I', 'N', 1, 0, OP_RESET_LED};
+    assert(process_command_packet(rled_request, sizeof(rled_request), response, sizeof(response), &response_len, 0x0023, &test_scratch) == 0);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len == 1 && header.type == PKT_TYPE_SLAVE_COMPACT && data[0] == STATUS_OK);
+    
+    // 有线链路仍为完整响应
+    host_set_link(COMM_LINK_WIRED);
+    assert(process_command_packet(rled_request, sizeof(rled_request), response, sizeof(response), &response_len, 0x0024, &test_scratch) == 0);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len == 10 && header.type == PKT_TYPE_SLAVE_RESPONSE);
+    host_set_link(COMM_LINK_BLE);
+    
+    command_handler_init();
+    printf("✓ 多链路会话测试通过\n\n");
+}
+
+// 构建一帧主机请求，载荷含需转义的0xAA/0x55和COBS需编码的0x00
+static int build_addressed_frame(uint8_t version, uint8_t address, uint16_t packet_id, uint8_t *out, uint16_t size) {
+    static const uint8_t payload[] = {0xAA, 0x55, 0x00, 0x55, 0xAA, 0x01};
+    PacketHeader header = {
+        .version = version,
+        .address = address,
+        .type = PKT_TYPE_HOST_REQUEST,
+        .packet_id = packet_id,
+        .data_length = sizeof(payload),
+    };
+    FrameWriter writer;
+    frame_writer_begin(&writer, out, size, &header);
+    frame_writer_write(&writer, payload, sizeof(payload));
+    return frame_writer_finish(&writer);
+}
+
+// 逐字节输入，返回校验通过的帧数和最后一帧的包编号
+static int feed_frames(FrameParser *parser, const uint8_t *data, int length, uint16_t *last_id) {
+    int accepted = 0;
+    for (int i = 0; i < length; i++) {
+        FrameResult result = frame_parser_feed(parser, data[i]);
+        assert(result == FRAME_RESULT_NONE || result == FRAME_RESULT_OK);
+        if (result == FRAME_RESULT_OK) {
+            accepted++;
+            *last_id = frame_parser_header(parser)->packet_id;
+        }
+    }
+    return accepted;
+}
+
+// 测试多点总线的地址过滤：不带地址或地址不符的帧被跳过且不算错误，紧随其后的帧不受影响
+void test_address_filter(void) {
+    printf("=== 测试从机地址过滤 ===\n");
+    
+    static const uint8_t versions[] = {PROTOCOL_VERSION_ADDR, PROTOCOL_VERSION_COBS_ADDR};
+    uint8_t frame_buffer[MAX_PACKET_SIZE];
+    uint8_t stream[256];
+    uint16_t last_id = 0;
+    FrameParser parser;
+    
+    for (size_t v = 0; v < sizeof(versions); v++) {
+        uint8_t legacy = PROTOCOL_FRAMING(versions[v]);
+        int len = 0;
+        len += build_addressed_frame(legacy, 0, 1, stream + len, sizeof(stream) - len);
+        len += build_addressed_frame(versions[v], 7, 2, stream + len, sizeof(stream) - len);
+        len += build_addressed_frame(versions[v], 5, 3, stream + len, sizeof(stream) - len);
+        len += build_addressed_frame(versions[v], 0xAA, 4, stream + len, sizeof(stream) - len);
+        
+        // 地址5：只接受发给5的帧
+        frame_parser_init(&parser, frame_buffer, sizeof(frame_buffer));
+        frame_parser_set_address(&parser, 5);
+        assert(feed_frames(&parser, stream, len, &last_id) == 1 && last_id == 3);
+        assert(parser.skipped == 3 && parser.resyncs == 0);
+        
+        // 不过滤：全部接受，不带地址的帧地址字段为0
+        frame_parser_init(&parser, frame_buffer, sizeof(frame_buffer));
+        int first_len = build_addressed_frame(legacy, 9, 1, stream, sizeof(stream));
+        assert(feed_frames(&parser, stream, first_len, &last_id) == 1);
+        assert(frame_parser_header(&parser)->address == PROTOCOL_ADDRESS_NONE);
+        assert(frame_parser_payload(&parser)[0] == 0xAA && frame_parser_payload(&parser)[5] == 0x01);
+        len = build_addressed_frame(versions[v], 7, 2, stream, sizeof(stream));
+        assert(feed_frames(&parser, stream, len, &last_id) == 1 && last_id == 2);
+        assert(frame_parser_header(&parser)->address == 7 && frame_parser_payload(&parser)[2] == 0x00);
+        
+        // 地址未加载：全部跳过
+        frame_parser_init(&parser, frame_buffer, sizeof(frame_buffer));
+        frame_parser_set_address(&parser, FRAME_ADDRESS_BLOCKED);
+        len = build_addressed_frame(legacy, 0, 1, stream, sizeof(stream));
+        len += build_addressed_frame(versions[v], FRAME_ADDRESS_BLOCKED, 2, stream + len, sizeof(stream) - len);
+        assert(feed_frames(&parser, stream, len, &last_id) == 0 && parser.skipped == 2);
+    }
+    
+    // sadr设置本机地址，之后的响应以带地址的版本发出时包头带本机地址
+    command_handler_init();
+    uint8_t request[64];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint16_t response_len;
+    int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_SET_ADDRESS);
+    uint8_t *da = request + req_len;
+    req_len += write_tlv_begin(da, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_ADDRESS, 12);
+    write_tlv_end(da, request + req_len - da - 4);
+    uint32_t saves = host_config_save_count();
+    protocol_set_tx_version(PROTOCOL_VERSION_ADDR);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0030, &test_scratch) == 0);
+    assert(communication_get_address() == 12 && host_config_save_count() == saves + 1);
+    
+    PacketHeader header;
+    uint8_t data[MAX_PACKET_SIZE];
+    int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    uint8_t da_value[16];
+    uint16_t da_len = sizeof(da_value);
+    uint8_t address = 0;
+    assert(data_len > 0 && header.version == PROTOCOL_VERSION_ADDR && header.address == 12);
+    assert(read_tlv_raw(data, data_len, TAG_DATA, da_value, &da_len) > 0);
+    assert(read_tlv_uint8(da_value, da_len, TAG_ADDRESS, &address) > 0 && address == 12);
+    
+    // 超出范围的地址被拒绝，原地址不变
+    request[req_len - 1] = PROTOCOL_ADDRESS_MAX + 1;
+    process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0031, &test_scratch);
+    assert(communication_get_address() == 12);
+    
+    protocol_set_tx_version(PROTOCOL_VERSION);
+    communication_set_address(PROTOCOL_ADDRESS_NONE);
+    printf("✓ 从机地址过滤测试通过\n\n");
+}
+
+// 网关测试用的总线：接收缓冲区由测试写入，发出的帧保存下来
+static uint8_t *bus_rx_buffer;
+static uint16_t bus_rx_size;
+static uint16_t bus_rx_pos;
+static uint8_t bus_tx_frame[GATEWAY_FORWARD_MAX + 64];
+static uint16_t bus_tx_len;
+static uint32_t bus_tx_count;
+
+static void bus_start_rx(void *context, uint8_t *buffer, uint16_t size) {
+    (void)context;
+    bus_rx_buffer = buffer;
+    bus_rx_size = size;
+    bus_rx_pos = 0;
+}
+
+static void bus_stop_rx(void *context) {
+    (void)context;
+}
+
+static uint16_t bus_rx_position(void *context) {
+    (void)context;
+    return bus_rx_pos;
+}
+
+static bool bus_send(void *context, const uint8_t *data, uint16_t length) {
+    (void)context;
+    assert(length <= sizeof(bus_tx_frame));
+    memcpy(bus_tx_frame, data, length);
+    bus_tx_len = length;
+    bus_tx_count++;
+    return true;
+}
+
+static const CommTransportOps bus_ops = {bus_start_rx, bus_stop_rx, bus_rx_position, bus_send, NULL};
+static const CommTransport bus_transport = {&bus_ops, NULL};
+
+// 解析网关发出的请求帧，返回目标地址；*id为包编号，payload为请求的数据部分
+static uint8_t bus_take_request(uint16_t *id, uint8_t *payload, uint16_t *payload_len) {
+    uint8_t buffer[MAX_PACKET_SIZE];
+    FrameParser parser;
+    frame_parser_init(&parser, buffer, sizeof(buffer));
+    uint16_t last_id = 0;
+    assert(feed_frames(&parser, bus_tx_frame, bus_tx_len, &last_id) == 1);
+    const PacketHeader *header = frame_parser_header(&parser);
+    assert(header->version == PROTOCOL_VERSION_COBS_ADDR && header->type == PKT_TYPE_HOST_REQUEST);
+    *id = header->packet_id;
+    *payload_len = header->data_length;
+    memcpy(payload, frame_parser_payload(&parser), header->data_length);
+    return header->address;
+}
+
+// 模拟地址为address的下游设备处理网关发出的请求，应答写入总线的接收缓冲区
+static void bus_answer(uint8_t address) {
+    uint8_t payload[MAX_PACKET_SIZE];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint16_t id, payload_len, response_len;
+    assert(bus_take_request(&id, payload, &payload_len) == address);
+    
+    communication_set_address(address);
+    protocol_set_tx_version(PROTOCOL_VERSION_COBS_ADDR);
+    assert(process_command_packet(payload, payload_len, response, sizeof(response), &response_len, id, &test_scratch) == 0);
+    protocol_set_tx_version(PROTOCOL_VERSION);
+    communication_set_address(PROTOCOL_ADDRESS_NONE);
+    
+    for (uint16_t i = 0; i < response_len; i++) {
+        bus_rx_buffer[bus_rx_pos] = response[i];
+        bus_rx_pos = (uint16_t)((bus_rx_pos + 1) % bus_rx_size);
+    }
+    gateway_tx_complete();
+    gateway_rx_event(bus_rx_pos);
+    gateway_service();
+}
+
+// 测试网关：轮询下游设备并缓存读数（流水线：一个应答到达时立即发出下一个请求），
+// 未应答的设备计入CF；ggwy返回缓存，fwrd转发请求并挂起到下游应答
+void test_gateway(void) {
+    printf("=== 测试网关 ===\n");
+    
+    command_handler_init();
+    gateway_init(&bus_transport);
+    GatewayConfig config = {.interval_ms = GATEWAY_DEFAULT_INTERVAL_MS, .count = 2, .addresses = {5, 7}};
+    assert(gateway_configure(&config));
+    GatewayConfig invalid = {.interval_ms = GATEWAY_DEFAULT_INTERVAL_MS, .count = 2, .addresses = {5, 5}};
+    assert(!gateway_configure(&invalid));
+    
+    // 第一个请求发给5；5应答后立即发出给7的请求
+    bus_tx_count = 0;
+    gateway_service();
+    assert(bus_tx_count == 1);
+    bus_answer(5);
+    assert(bus_tx_count == 2);
+    uint8_t payload[MAX_PACKET_SIZE];
+    uint16_t id, payload_len;
+    assert(bus_take_request(&id, payload, &payload_len) == 7);
+    
+    GatewayDevice device;
+    assert(gateway_get_device(0, &device) && device.address == 5);
+    assert(device.answered && device.has_reading && device.status == STATUS_OK);
+    assert(device.consecutive_misses == 0 && device.responses == 1);
+    
+    // 7不应答：超时后计入，本轮结束，到下一轮之前不再发送
+    gateway_tx_complete();
+    host_advance_ms(GATEWAY_RESPONSE_TIMEOUT_MS);
+    gateway_service();
+    assert(gateway_get_device(1, &device) && device.address == 7);
+    assert(!device.answered && device.consecutive_misses == 1);
+    assert(bus_tx_count == 2 && gateway_idle());
+    assert(gateway_next_due_ms() > 0 && gateway_next_due_ms() <= GATEWAY_DEFAULT_INTERVAL_MS);
+    
+    // ggwy：5带读数，7只有AD和CF
+    uint8_t request[GATEWAY_FORWARD_MAX + 32];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint16_t response_len;
+    int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GATEWAY_READ);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0040, &test_scratch) == 0);
+    PacketHeader header;
+    uint8_t data[MAX_PACKET_SIZE];
+    int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 0);
+    const uint8_t *da, *list, *item;
+    uint16_t da_len, list_len, item_len;
+    uint8_t address, status;
+    const uint8_t *reading;
+    uint16_t reading_len;
+    uint32_t age;
+    uint16_t misses;
+    assert(read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+    assert(read_tlv_view(da, da_len, TAG_GATEWAY_LIST, &list, &list_len) > 0);
+    assert(read_tlv_view(list, list_len, TAG_ALARM_ITEM, &item, &item_len) > 0);
+    assert(read_tlv_uint8(item, item_len, TAG_ADDRESS, &address) > 0 && address == 5);
+    assert(read_tlv_uint8(item, item_len, TAG_STATUS, &status) > 0 && status == STATUS_OK);
+    assert(read_tlv_view(item, item_len, TAG_TEMPERATURE, &reading, &reading_len) > 0);
+    assert(read_tlv_uint32(item, item_len, TAG_SAMPLE_AGE, &age) > 0);
+    uint16_t first_len = (uint16_t)(item + item_len - list);
+    assert(read_tlv_view(list + first_len, list_len - first_len, TAG_ALARM_ITEM, &item, &item_len) > 0);
+    assert(read_tlv_uint8(item, item_len, TAG_ADDRESS, &address) > 0 && address == 7);
+    assert(read_tlv_uint8(item, item_len, TAG_STATUS, &status) < 0);
+    assert(read_tlv_uint16(item, item_len, TAG_CONSECUTIVE_FAULTS, &misses) > 0 && misses == 1);
+    
+    // fwrd：ping转发给5，挂起到5应答
+    req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_FORWARD);
+    uint8_t *fwd = request + req_len;
+    req_len += write_tlv_begin(fwd, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_ADDRESS, 5);
+    uint8_t *inner = request + req_len;
+    req_len += write_tlv_begin(inner, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_string(request + req_len, sizeof(request) - req_len, TAG_INSTRUCTION, CMD_PING);
+    write_tlv_end(inner, request + req_len - inner - 4);
+    write_tlv_end(fwd, request + req_len - fwd - 4);
+    host_set_link(COMM_LINK_BLE);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0041, &test_scratch) == COMMAND_DEFERRED);
+    
+    // 第二个fwrd在第一个完成之前被拒绝
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0042, &test_scratch) == 0);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 0 && read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0 && status == STATUS_BUSY);
+    
+    gateway_service();
+    assert(bus_tx_count == 3);
+    bus_answer(5);
+    uint8_t link = COMM_LINK_WIRED;
+    host_advance_ms(10);
+    assert(command_handler_poll(response, sizeof(response), &response_len, &link, &test_scratch) == 1);
+    assert(link == COMM_LINK_BLE);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 0 && header.response_id == 0x0041);
+    assert(read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0 && status == STATUS_OK);
+    const uint8_t *forwarded;
+    uint16_t forwarded_len;
+    assert(read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+    assert(read_tlv_uint8(da, da_len, TAG_ADDRESS, &address) > 0 && address == 5);
+    assert(read_tlv_view(da, da_len, TAG_DATA, &forwarded, &forwarded_len) > 0);
+    assert(read_tlv_uint8(forwarded, forwarded_len, TAG_STATUS, &status) > 0 && status == STATUS_OK);
+    
+    // sgwy：新地址表保存并立即开始新一轮
+    req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GATEWAY_CONFIG);
+    uint8_t *cfg = request + req_len;
+    req_len += write_tlv_begin(cfg, sizeof(request) - req_len, TAG_DATA);
+    static const uint8_t addresses[] = {9};
+    req_len += write_tlv_raw(request + req_len, sizeof(request) - req_len, TAG_ADDRESS, addresses, sizeof(addresses));
+    write_tlv_end(cfg, request + req_len - cfg - 4);
+    uint32_t saves = host_config_save_count();
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0043, &test_scratch) == 0);
+    assert(host_config_save_count() == saves + 1);
+    gateway_get_config(&config);
+    assert(config.count == 1 && config.addresses[0] == 9 && config.interval_ms == GATEWAY_DEFAULT_INTERVAL_MS);
+    gateway_service();
+    assert(bus_tx_count == 4 && bus_take_request(&id, payload, &payload_len) == 9);
+    
+    GatewayConfig empty = {.interval_ms = GATEWAY_DEFAULT_INTERVAL_MS, .count = 0};
+    gateway_tx_complete();
+    gateway_configure(&empty);
+    command_handler_init();
+    printf("✓ 网关测试通过\n\n");
+}
+
+// 测试重复请求：挂起期间重发的请求被丢弃，应答后重发的请求重放同一帧而不再执行
+void test_duplicate_requests(void) {
+    printf("=== 测试重复请求的应答缓存 ===\n");
+    
+    command_handler_init();
+    host_set_link(COMM_LINK_BLE);
+    uint8_t request[64];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint8_t replay[MAX_PACKET_SIZE];
+    uint16_t response_len, replay_len;
+    int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_GET_TEMP);
+    uint8_t *da = request + req_len;
+    req_len += write_tlv_begin(da, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_FRESH, 1);
+    write_tlv_end(da, request + req_len - da - 4);
+    
+    // 带FR的temp挂起；应答前重发的请求不再开始一次转换
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0050, &test_scratch) == COMMAND_DEFERRED);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0050, &test_scratch) == COMMAND_DEFERRED);
+    uint8_t link = COMM_LINK_WIRED;
+    assert(command_handler_poll(response, sizeof(response), &response_len, &link, &test_scratch) == 1);
+    assert(link == COMM_LINK_BLE);
+    assert(command_handler_poll(replay, sizeof(replay), &replay_len, &link, &test_scratch) == 0);
+    
+    // 应答后重发：重放同一帧
+    uint32_t replays = response_cache_replays();
+    assert(process_command_packet(request, req_len, replay, sizeof(replay), &replay_len, 0x0050, &test_scratch) == 0);
+    assert(replay_len == response_len && memcmp(replay, response, response_len) == 0);
+    assert(response_cache_replays() == replays + 1);
+    
+    // 新的包编号、其他链路或过期后重新执行
+    assert(process_command_packet(request, req_len, replay, sizeof(replay), &replay_len, 0x0051, &test_scratch) == COMMAND_DEFERRED);
+    host_set_link(COMM_LINK_WIRED);
+    assert(process_command_packet(request, req_len, replay, sizeof(replay), &replay_len, 0x0050, &test_scratch) == COMMAND_DEFERRED);
+    host_set_link(COMM_LINK_BLE);
+    host_advance_ms(RESPONSE_CACHE_TTL_MS);
+    while (command_handler_poll(replay, sizeof(replay), &replay_len, &link, &test_scratch) == 1) {
+    }
+    assert(process_command_packet(request, req_len, replay, sizeof(replay), &replay_len, 0x0050, &test_scratch) == COMMAND_DEFERRED);
+    assert(response_cache_replays() == replays + 1);
+    
+    command_handler_init();
+    printf("✓ 重复请求测试通过\n\n");
+}
+
+// 固件升级测试用的暂存区（RAM），install只记录映像长度
+#define FW_TEST_IMAGE_SIZE 5000U
+static uint8_t fw_staging[4 * FW_UPDATE_PAGE_SIZE];
+static uint32_t fw_installed_size;
+
+static bool fw_staging_erase(void *context, uint32_t offset) {
+    (void)context;
+    memset(fw_staging + offset, 0xFF, FW_UPDATE_PAGE_SIZE);
+    return true;
+}
+
+static bool fw_staging_program(void *context, uint32_t offset, const void *data, uint32_t size) {
+    (void)context;
+    assert(size % 2 == 0 && offset + size <= sizeof(fw_staging));
+    memcpy(fw_staging + offset, data, size);
+    return true;
+}
+
+static void fw_staging_install(void *context, uint32_t image_size) {
+    (void)context;
+    fw_installed_size = image_size;
+}
+
+static const FwUpdateDevice fw_test_device = {
+    .erase = fw_staging_erase,
+    .program = fw_staging_program,
+    .install = fw_staging_install,
+    .context = NULL,
+    .base = fw_staging,
+    .size = sizeof(fw_staging),
+    .link_base = FW_UPDATE_APP_BASE,
+};
+
+// 发送一条固件升级命令，fields为DA的内容（可为空）；返回状态，tag不为NULL时读出DA中的该字段
+static uint8_t fw_command(const char *instruction, const uint8_t *fields, uint16_t fields_len,
+                          uint16_t packet_id, const char *tag, uint32_t *value) {
+    static uint8_t request[MAX_PACKET_SIZE];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint16_t response_len;
+    int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, instruction);
+    if (fields_len > 0) {
+        uint8_t *da = request + req_len;
+        req_len += write_tlv_begin(da, sizeof(request) - req_len, TAG_DATA);
+        memcpy(request + req_len, fields, fields_len);
+        req_len += fields_len;
+        write_tlv_end(da, fields_len);
+    }
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, packet_id, &test_scratch) == 0);
+    
+    PacketHeader header;
+    uint8_t data[MAX_PACKET_SIZE];
+    uint8_t status;
+    int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 0 && read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0);
+    if (tag != NULL) {
+        const uint8_t *da;
+        uint16_t da_len;
+        assert(read_tlv_view(data, data_len, TAG_DATA, &da, &da_len) > 0);
+        assert(read_tlv_uint32(da, da_len, tag, value) > 0);
+    }
+    return status;
+}
+
+static uint8_t fw_send_chunk(const uint8_t *image, uint32_t offset, uint16_t length, uint32_t crc,
+                             uint16_t packet_id, uint32_t *next) {
+    uint8_t fields[FW_UPDATE_CHUNK_MAX + 32];
+    uint16_t len = write_tlv_uint32(fields, sizeof(fields), TAG_FW_OFFSET, offset);
+    len += write_tlv_raw(fields + len, sizeof(fields) - len, TAG_FW_DATA, image + offset, length);
+    len += write_tlv_uint32(fields + len, sizeof(fields) - len, TAG_FW_CRC, crc);
+    return fw_command(CMD_FW_CHUNK, fields, len, packet_id, TAG_FW_OFFSET, next);
+}
+
+// 测试固件升级：按块写入、缓冲满时BUSY、块CRC错误、断点续传、校验和安装
+// 分段CRC与拼接后整体计算一致，最后一段可以不是整字
+void test_crc_segments(void) {
+    printf("测试分段CRC32...\n");
+    uint8_t buffer[CRC32_DMA_MIN_LENGTH * 2 + 3];
+    for (size_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (uint8_t)(i * 37 + 11);
+    }
+    uint32_t whole = crc32_compute(buffer, sizeof(buffer));
+    assert(whole == crc32_compute_sw(buffer, sizeof(buffer)));
+    
+    const Crc32Segment segments[3] = {
+        { buffer, 20 },
+        { buffer + 20, CRC32_DMA_MIN_LENGTH * 2 - 20 },
+        { buffer + CRC32_DMA_MIN_LENGTH * 2, 3 },
+    };
+    assert(crc32_compute_segments(segments, 3) == whole);
+    assert(crc32_compute_segments(segments, 1) == crc32_compute(buffer, 20));
+    assert(crc32_compute_segments(segments, 0) == crc32_compute(buffer, 0));
+    printf("✓ 分段CRC32测试通过\n\n");
+}
+
+void test_admission(void) {
+    printf("测试请求准入...\n");
+    AdmissionBucket bucket;
+    uint32_t now = 1000;
+    admission_reset(&bucket, now);
+    
+    // 满桶：批量类用完令牌后被拒绝，交互类还能透支
+    for (uint8_t i = 0; i < ADMISSION_BURST / ADMISSION_BULK_COST; i++) {
+        assert(admission_request(&bucket, true, now) == 0);
+    }
+    uint32_t retry = admission_request(&bucket, true, now);
+    assert(retry == ADMISSION_BULK_COST * ADMISSION_REFILL_MS);
+    for (uint8_t i = 0; i < ADMISSION_RESERVE; i++) {
+        assert(admission_request(&bucket, false, now) == 0);
+    }
+    assert(admission_request(&bucket, false, now) == ADMISSION_REFILL_MS);
+    // 透支后批量类要等欠下的令牌补回
+    assert(admission_request(&bucket, true, now) == (ADMISSION_RESERVE + ADMISSION_BULK_COST) * ADMISSION_REFILL_MS);
+    
+    // 按等待时间重试即被接受；补充按整个周期计，零头留到下一次
+    now += ADMISSION_REFILL_MS - 10;
+    assert(admission_request(&bucket, false, now) == 10);
+    now += 10;
+    assert(admission_request(&bucket, false, now) == 0);
+    now += (ADMISSION_RESERVE + ADMISSION_BULK_COST) * ADMISSION_REFILL_MS + 25;
+    assert(admission_request(&bucket, true, now) == 0);
+    
+    // 长时间空闲后最多积攒一桶
+    now += 3600000;
+    for (uint8_t i = 0; i < ADMISSION_BURST; i++) {
+        assert(admission_request(&bucket, false, now) == 0);
+    }
+    assert(admission_request(&bucket, true, now) == ADMISSION_BULK_COST * ADMISSION_REFILL_MS);
+    
+    // 持续速率：每个补充周期一条交互类请求一直被接受
+    for (uint32_t i = 0; i < 1000; i++) {
+        now += ADMISSION_REFILL_MS;
+        assert(admission_request(&bucket, false, now) == 0);
+    }
+    printf("✓ 请求准入测试通过\n\n");
+}
+
+// 测试流帧：组帧和解析往返、CRC校验，subt的SF协商（只在COBS组帧时可用）和流推送
+void test_stream_frames(void) {
+    printf("测试流帧...\n");
+    assert(calculate_crc16(CRC16_INIT, (const uint8_t *)"123456789", 9) == 0x29B1);
+    assert(calculate_crc16(calculate_crc16(CRC16_INIT, (const uint8_t *)"1234", 4), (const uint8_t *)"56789", 5) == 0x29B1);
+    
+    // 29.1°C和-5.5°C：编码后没有0x00，篡改的字节不会是COBS编码字节
+    const uint8_t readings[] = {0x23, 0x01, 0xC9, 0xFF};
+    uint8_t frame[32];
+    int frame_len = frame_writer_stream(frame, sizeof(frame), 1, 7, readings, sizeof(readings));
+    assert(frame_len == 2 + 1 + STREAM_FRAME_HEADER_SIZE + sizeof(readings) + STREAM_FRAME_CRC_SIZE);
+    assert(frame[0] == COBS_DELIMITER && frame[frame_len - 1] == COBS_DELIMITER);
+    uint8_t small[8];
+    assert(frame_writer_stream(small, sizeof(small), 1, 7, readings, sizeof(readings)) < 0);
+    
+    uint8_t buffer[MAX_PACKET_SIZE];
+    FrameParser parser;
+    frame_parser_init(&parser, buffer, sizeof(buffer));
+    FrameResult result = FRAME_RESULT_NONE;
+    for (int i = 0; i < frame_len; i++) {
+        result = frame_parser_feed(&parser, frame[i]);
+        assert(result == FRAME_RESULT_NONE); // 默认不接受：当作噪声跳过
+    }
+    
+    frame_parser_accept_streams(&parser, true);
+    for (int i = 0; i < frame_len && result == FRAME_RESULT_NONE; i++) {
+        result = frame_parser_feed(&parser, frame[i]);
+    }
+    assert(result == FRAME_RESULT_STREAM);
+    uint8_t stream_id, sequence;
+    uint16_t payload_len;
+    const uint8_t *payload = frame_parser_stream(&parser, &stream_id, &sequence, &payload_len);
+    assert(stream_id == 1 && sequence == 7 && payload_len == sizeof(readings));
+    assert(memcmp(payload, readings, sizeof(readings)) == 0);
+    
+    frame[6] ^= 0x02;
+    result = FRAME_RESULT_NONE;
+    for (int i = 1; i < frame_len && result == FRAME_RESULT_NONE; i++) {
+        result = frame_parser_feed(&parser, frame[i]);
+    }
+    assert(result == FRAME_RESULT_CRC_ERROR);
+    
+    // 接受流帧的解析器照常解析普通的COBS帧
+    protocol_set_tx_version(PROTOCOL_VERSION_COBS);
+    uint8_t packet[64];
+    int packet_len = build_packet(PKT_TYPE_SLAVE_REQUEST, 0x8001, 0, readings, sizeof(readings), packet, sizeof(packet));
+    result = FRAME_RESULT_NONE;
+    for (int i = 0; i < packet_len && result == FRAME_RESULT_NONE; i++) {
+        result = frame_parser_feed(&parser, packet[i]);
+    }
+    assert(result == FRAME_RESULT_OK && frame_parser_header(&parser)->data_length == sizeof(readings));
+    
+    // subt的SF：转义组帧的会话中拒绝
+    host_reset();
+    command_handler_init();
+    host_set_link(COMM_LINK_WIRED);
+    const int16_t temperatures[] = {291, TEMP_INVALID};
+    host_set_temperatures(temperatures, 2);
+    uint8_t request[64];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint16_t response_len;
+    int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_SUBSCRIBE);
+    uint8_t *da = request + req_len;
+    req_len += write_tlv_begin(da, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint32(request + req_len, sizeof(request) - req_len, TAG_INTERVAL, SUBSCRIBE_MIN_INTERVAL_MS);
+    req_len += write_tlv_uint8(request + req_len, sizeof(request) - req_len, TAG_STREAM_ID, 9);
+    write_tlv_end(da, request + req_len - da - 4);
+    
+    PacketHeader header;
+    uint8_t data[256];
+    uint8_t status = STATUS_OK;
+    protocol_set_tx_version(PROTOCOL_VERSION);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0040, &test_scratch) == 0);
+    int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 0 && read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0 && status == STATUS_INVALID_PARAM);
+    
+    // COBS组帧：周期推送为全部传感器的流帧，序号逐帧加1
+    protocol_set_tx_version(PROTOCOL_VERSION_COBS);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0041, &test_scratch) == 0);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 0 && read_tlv_uint8(data, data_len, TAG_STATUS, &status) > 0 && status == STATUS_OK);
+    for (uint8_t expected = 0; expected < 3; expected++) {
+        uint8_t link = COMM_LINK_BLE;
+        assert(command_handler_poll(response, sizeof(response), &response_len, &link, &test_scratch) == 1);
+        assert(link == COMM_LINK_WIRED);
+        result = FRAME_RESULT_NONE;
+        for (uint16_t i = 0; i < response_len && result == FRAME_RESULT_NONE; i++) {
+            result = frame_parser_feed(&parser, response[i]);
+        }
+        assert(result == FRAME_RESULT_STREAM);
+        payload = frame_parser_stream(&parser, &stream_id, &sequence, &payload_len);
+        assert(stream_id == 9 && sequence == expected && payload_len == 4);
+        assert((int16_t)(payload[0] | (payload[1] << 8)) == 291);
+        assert((int16_t)(payload[2] | (payload[3] << 8)) == TEMP_INVALID);
+        host_advance_ms(SUBSCRIBE_MIN_INTERVAL_MS);
+    }
+    
+    // 主机换用转义组帧后改回完整的温度推送
+    protocol_set_tx_version(PROTOCOL_VERSION);
+    uint8_t link = COMM_LINK_BLE;
+    assert(command_handler_poll(response, sizeof(response), &response_len, &link, &test_scratch) == 1);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 0 && header.type == PKT_TYPE_SLAVE_REQUEST);
+    
+    command_handler_init();
+    host_set_link(COMM_LINK_BLE);
+    printf("✓ 流帧测试通过\n\n");
+}
+
+// 测试ping的时间戳：HT原样返回，RX为收完请求的时刻（当前时刻减去请求等待的时间），TT不早于RX
+void test_ping_timestamps(void) {
+    printf("测试ping的时间戳...\n");
+    host_reset();
+    command_handler_init();
+    host_advance_ms(5000);
+    host_set_request_age_us(1500);
+    
+    uint8_t request[64];
+    uint8_t response[MAX_PACKET_SIZE];
+    uint16_t response_len;
+    int req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_PING);
+    uint8_t *da = request + req_len;
+    req_len += write_tlv_begin(da, sizeof(request) - req_len, TAG_DATA);
+    req_len += write_tlv_uint64(request + req_len, sizeof(request) - req_len, TAG_HOST_TIME, 0x0123456789ABCDEFULL);
+    write_tlv_end(da, request + req_len - da - 4);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0050, &test_scratch) == 0);
+    
+    PacketHeader header;
+    uint8_t data[256];
+    uint8_t da_value[128];
+    uint16_t da_len = sizeof(da_value);
+    int data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    assert(data_len > 0 && read_tlv_raw(data, data_len, TAG_DATA, da_value, &da_len) > 0);
+    uint64_t host_time = 0;
+    uint32_t rx_us = 0, tx_us = 0;
+    assert(read_tlv_uint64(da_value, da_len, TAG_HOST_TIME, &host_time) > 0 && host_time == 0x0123456789ABCDEFULL);
+    assert(read_tlv_uint32(da_value, da_len, TAG_DEVICE_RX, &rx_us) > 0 && rx_us == 5000U * 1000U - 1500U);
+    assert(read_tlv_uint32(da_value, da_len, TAG_DEVICE_TX, &tx_us) > 0 && tx_us - rx_us >= 1500U);
+    
+    // 不带HT时没有时间戳
+    req_len = write_tlv_string(request, sizeof(request), TAG_INSTRUCTION, CMD_PING);
+    assert(process_command_packet(request, req_len, response, sizeof(response), &response_len, 0x0051, &test_scratch) == 0);
+    data_len = parse_packet(response, response_len, &header, data, sizeof(data));
+    da_len = sizeof(da_value);
+    assert(data_len > 0 && read_tlv_raw(data, data_len, TAG_DATA, da_value, &da_len) > 0);
+    assert(read_tlv_uint32(da_value, da_len, TAG_DEVICE_RX, &rx_us) <= 0);
+    
+    host_set_request_age_us(0);
+    printf("✓ ping时间戳测试通过\n\n");
+}
+
+void test_warm_state(void) {
+    printf("测试热复位保留的状态...\n");
+    static struct {
+        WarmState state;
+        uint32_t values[8];
+    } block;
+    
+    // 上电复位：不沿用，写入头部后封装
+    memset(&block, 0xA5, sizeof(block));
+    warm_state_init(false);
+    assert(!warm_state_restore(&block.state, 0x54455354UL, sizeof(block)));
+    memset(block.values, 0, sizeof(block.values));
+    block.values[3] = 42;
+    assert(warm_state_register(&block.state));
+    warm_state_seal_all();
+    
+    // 热复位：校验通过时内容沿用；magic或大小不符、内容改变而未封装时丢弃
+    warm_state_init(true);
+    assert(warm_state_is_warm());
+    assert(warm_state_restore(&block.state, 0x54455354UL, sizeof(block)) && block.values[3] == 42);
+    assert(!warm_state_restore(&block.state, 0x54455355UL, sizeof(block)));
+    assert(!warm_state_restore(&block.state, 0x54455354UL, sizeof(block)));
+    warm_state_seal(&block.state);
+    block.values[0] = 1;
+    assert(!warm_state_restore(&block.state, 0x54455354UL, sizeof(block)));
+    warm_state_seal(&block.state);
+    assert(!warm_state_restore(&block.state, 0x54455354UL, sizeof(block) - 4));
+    for (uint8_t i = 0; i < WARM_STATE_MAX_BLOCKS; i++) {
+        assert(warm_state_register(&block.state));
+    }
+    assert(!warm_state_register(&block.state));
+    
+    // 运行统计：热复位后沿用（含阈值），节拍从恢复时接着计；上电复位时清空
+    host_reset();
+    temp_stats_reset();
+    temp_stats_set_threshold(0, 250);
+    uint32_t tick = HAL_GetTick();
+    for (uint8_t second = 0; second < 5; second++) {
+        int16_t value = 300;
+        temp_stats_update(&value, 1, tick);
+        tick += 1000;
+    }
+    warm_state_init(false);
+    temp_stats_warm_restore();
+    TempStatsResult result;
+    assert(temp_stats_query(0, TEMP_STATS_SINCE_BOOT, HAL_GetTick(), &result) && result.count == 0);
+    assert(result.threshold == TEMP_INVALID);
+    temp_stats_set_threshold(0, 250);
+    for (uint8_t second = 0; second < 5; second++) {
+        int16_t value = 300;
+        temp_stats_update(&value, 1, tick);
+        tick += 1000;
+    }
+    warm_state_seal_all();
+    warm_state_init(true);
+    temp_stats_warm_restore();
+    assert(temp_stats_query(0, TEMP_STATS_SINCE_BOOT, HAL_GetTick(), &result));
+    assert(result.count == 5 && result.mean == 300 && result.threshold == 250);
+    assert(temp_stats_query(0, TEMP_STATS_HOUR, HAL_GetTick(), &result) && result.count == 5);
+    int16_t value = 300;
+    temp_stats_update(&value, 1, HAL_GetTick() + 1000);
+    assert(temp_stats_query(0, TEMP_STATS_SINCE_BOOT, HAL_GetTick(), &result));
+    assert(result.count == 6 && result.above_ms == 4000);
+    
+    warm_state_init(false);
+    temp_stats_reset();
+    printf("✓ 热复位状态测试通过\n\n");
+}
+
+void test_firmware_update(void) {
+    printf("=== 测试固件升级 ===\n");
+    
+    command_handler_init();
+    static uint8_t image[FW_TEST_IMAGE_SIZE];
+    for (uint32_t i = 0; i < sizeof(image); i++) {
+        image[i] = (uint8_t)(i * 7 + 3);
+    }
+    const uint32_t vectors[2] = { BOOT_RAM_BASE + BOOT_RAM_SIZE, FW_UPDATE_APP_BASE + 0x101 };
+    memcpy(image, vectors, sizeof(vectors));
+    uint32_t image_crc = crc32_compute(image, sizeof(image));
+    uint16_t id = 0x0060;
+    uint32_t value;
+    
+    // 暂存区未就绪
+    fw_update_init(NULL);
+    assert(fw_command(CMD_FW_VERIFY, NULL, 0, id++, NULL, NULL) == STATUS_NOT_INITIALIZED);
+    fw_update_init(&fw_test_device);
+    memset(fw_staging, 0, sizeof(fw_staging));
+    fw_installed_size = 0;
+    
+    // 未fwbg时写块
+    assert(fw_send_chunk(image, 0, 448, crc32_compute(image, 448), id++, &value) == STATUS_NOT_INITIALIZED && value == 0);
+    
+    uint8_t begin[32];
+    uint16_t begin_len = write_tlv_uint32(begin, sizeof(begin), TAG_FW_SIZE, sizeof(image));
+    begin_len += write_tlv_uint32(begin + begin_len, sizeof(begin) - begin_len, TAG_FW_CRC, image_crc);
+    assert(fw_command(CMD_FW_BEGIN, begin, begin_len, id++, TAG_FW_OFFSET, &value) == STATUS_OK && value == 0);
+    
+    // 连续发送：两页缓冲都满后跨页的块返回BUSY
+    uint32_t offset = 0;
+    uint8_t status;
+    while ((status = fw_send_chunk(image, offset, FW_UPDATE_CHUNK_MAX,
+                                   crc32_compute(image + offset, FW_UPDATE_CHUNK_MAX), id++, &value)) == STATUS_OK) {
+        assert(value == offset + FW_UPDATE_CHUNK_MAX);
+        offset = value;
+    }
+    assert(status == STATUS_BUSY && value == offset && offset == 9 * FW_UPDATE_CHUNK_MAX);
+    
+    // 块CRC错误、偏移不连续；已收到的块重发时确认
+    assert(fw_send_chunk(image, offset, 100, 0x12345678, id++, &value) == STATUS_INVALID_PARAM && value == offset);
+    assert(fw_send_chunk(image, offset + 2, 100, crc32_compute(image + offset + 2, 100), id++, &value) == STATUS_INVALID_PARAM);
+    assert(fw_send_chunk(image, 448, 448, crc32_compute(image + 448, 448), id++, &value) == STATUS_OK && value == offset);
+    
+    // 链路中断后重新fwbg同一映像，从已收到的位置继续
+    assert(fw_command(CMD_FW_BEGIN, begin, begin_len, id++, TAG_FW_OFFSET, &value) == STATUS_OK && value == offset);
+    
+    // 存储任务写入第一页后继续
+    assert(fw_update_service(0) == UINT32_MAX);
+    assert(memcmp(fw_staging, image, FW_UPDATE_PAGE_SIZE) == 0);
+    while (offset < sizeof(image)) {
+        uint16_t length = (uint16_t)(sizeof(image) - offset < FW_UPDATE_CHUNK_MAX ? sizeof(image) - offset : FW_UPDATE_CHUNK_MAX);
+        assert(fw_send_chunk(image, offset, length, crc32_compute(image + offset, length), id++, &value) == STATUS_OK);
+        assert(value == offset + length);
+        offset = value;
+    }
+    
+    // 还有页未写入时校验返回BUSY；写入后校验，CK为整个映像的CRC
+    assert(fw_command(CMD_FW_VERIFY, NULL, 0, id++, NULL, NULL) == STATUS_BUSY);
+    assert(fw_update_service(0) == UINT32_MAX);
+    assert(memcmp(fw_staging, image, sizeof(image)) == 0);
+    assert(fw_command(CMD_FW_VERIFY, NULL, 0, id++, TAG_FW_CRC, &value) == STATUS_OK && value == image_crc);
+    
+    // 安装在延时后进行
+    assert(fw_command(CMD_FW_COMMIT, NULL, 0, id++, NULL, NULL) == STATUS_OK);
+    assert(fw_update_service(1000) == FW_UPDATE_INSTALL_DELAY_MS && fw_installed_size == 0);
+    assert(fw_update_service(1000 + FW_UPDATE_INSTALL_DELAY_MS) == UINT32_MAX);
+    assert(fw_installed_size == sizeof(image));
+    assert(fw_command(CMD_FW_BEGIN, begin, begin_len, id++, NULL, NULL) == STATUS_BUSY);
+    
+    // 向量表不合理的映像（复位向量不是Thumb地址）校验失败
+    fw_update_init(&fw_test_device);
+    image[4] &= 0xFE;
+    image_crc = crc32_compute(image, 400);
+    begin_len = write_tlv_uint32(begin, sizeof(begin), TAG_FW_SIZE, 400);
+    begin_len += write_tlv_uint32(begin + begin_len, sizeof(begin) - begin_len, TAG_FW_CRC, image_crc);
+    assert(fw_command(CMD_FW_BEGIN, begin, begin_len, id++, TAG_FW_OFFSET, &value) == STATUS_OK && value == 0);
+    assert(fw_send_chunk(image, 0, 400, crc32_compute(image, 400), id++, &value) == STATUS_OK && value == 400);
+    fw_update_service(0);
+    assert(fw_command(CMD_FW_VERIFY, NULL, 0, id++, TAG_FW_CRC, &value) == STATUS_INVALID_PARAM && value == image_crc);
+    assert(fw_command(CMD_FW_COMMIT, NULL, 0, id++, NULL, NULL) == STATUS_NOT_INITIALIZED);
+    
+    fw_update_init(NULL);
+    printf("✓ 固件升级测试通过\n\n");
+}
+
+// 测试差分升级：补丁从当前固件（按槽B链接）复制并改写地址、插入新数据，生成按槽A链接的映像
+void test_firmware_delta(void) {
+    printf("=== 测试差分升级 ===\n");
+    
+    command_handler_init();
+    const uint32_t old_link = 0x08040000U, new_link = 0x08002000U;
+    static uint8_t old_image[8192];
+    static uint8_t expected[1024 + 3000 + 3000];
+    static uint8_t patch[64 + 3000];
+    for (uint32_t i = 0; i < sizeof(old_image); i++) {
+        old_image[i] = (uint8_t)(i * 7 + 3);
+    }
+    const uint32_t old_words[4] = { BOOT_RAM_BASE + BOOT_RAM_SIZE, old_link + 0x101, old_link + 0x1234, old_link + 0x1FFC };
+    memcpy(old_image, old_words, 8);
+    memcpy(old_image + 100, old_words + 2, 4);
+    memcpy(old_image + 200, old_words + 3, 4);
+    
+    // 新映像：前1024字节改写地址复制，3000字节新数据，再复制旧映像中的3000字节
+    memcpy(expected, old_image, 1024);
+    const uint32_t new_words[3] = { new_link + 0x101, new_link + 0x1234, new_link + 0x1FFC };
+    memcpy(expected + 4, new_words, 4);
+    memcpy(expected + 100, new_words + 1, 4);
+    memcpy(expected + 200, new_words + 2, 4);
+    for (uint32_t i = 0; i < 3000; i++) {
+        expected[1024 + i] = (uint8_t)(i * 13);
+    }
+    memcpy(expected + 4024, old_image + 2001, 3000);
+    
+    uint16_t patch_len = 0;
+    patch[patch_len++] = FW_PATCH_COPY_REBASE;
+    const uint32_t rebase_args[2] = { 0, 1024 };
+    memcpy(patch + patch_len, rebase_args, 8);
+    patch_len += 8;
+    patch[patch_len++] = FW_PATCH_DATA;
+    patch[patch_len++] = 3000 & 0xFF;
+    patch[patch_len++] = 3000 >> 8;
+    memcpy(patch + patch_len, expected + 1024, 3000);
+    patch_len += 3000;
+    patch[patch_len++] = FW_PATCH_COPY;
+    const uint32_t copy_args[2] = { 2001, 3000 };
+    memcpy(patch + patch_len, copy_args, 8);
+    patch_len += 8;
+    
+    FwUpdateDevice device = fw_test_device;
+    device.link_base = new_link;
+    device.old_base = old_image;
+    device.old_size = sizeof(old_image);
+    device.old_link = old_link;
+    fw_update_init(&device);
+    memset(fw_staging, 0, sizeof(fw_staging));
+    uint16_t id = 0x0090;
+    uint32_t value;
+    
+    // 旧映像的CRC与当前固件不符
+    uint8_t begin[64];
+    uint32_t base_crc = crc32_compute(old_image, 6000);
+    uint16_t begin_len = write_tlv_uint32(begin, sizeof(begin), TAG_FW_SIZE, sizeof(expected));
+    begin_len += write_tlv_uint32(begin + begin_len, sizeof(begin) - begin_len, TAG_FW_CRC, crc32_compute(expected, sizeof(expected)));
+    begin_len += write_tlv_uint32(begin + begin_len, sizeof(begin) - begin_len, TAG_FW_PATCH, patch_len);
+    begin_len += write_tlv_uint32(begin + begin_len, sizeof(begin) - begin_len, TAG_FW_BASE_SIZE, 6000);
+    uint8_t *crc_field = begin + begin_len;
+    begin_len += write_tlv_uint32(begin + begin_len, sizeof(begin) - begin_len, TAG_FW_BASE_CRC, base_crc + 1);
+    assert(fw_command(CMD_FW_BEGIN, begin, begin_len, id++, NULL, NULL) == STATUS_INVALID_PARAM);
+    write_tlv_uint32(crc_field, 12, TAG_FW_BASE_CRC, base_crc);
+    assert(fw_command(CMD_FW_BEGIN, begin, begin_len, id++, TAG_FW_OFFSET, &value) == STATUS_OK && value == 0);
+    
+    // 补丁缓冲满时BUSY，存储任务处理后继续；FO为补丁中的偏移
+    uint32_t offset = 0;
+    bool busy = false;
+    while (offset < patch_len) {
+        uint16_t length = (uint16_t)(patch_len - offset < FW_UPDATE_CHUNK_MAX ? patch_len - offset : FW_UPDATE_CHUNK_MAX);
+        uint8_t status = fw_send_chunk(patch, offset, length, crc32_compute(patch + offset, length), id++, &value);
+        if (status == STATUS_BUSY) {
+            busy = true;
+            assert(value == offset);
+            while (fw_update_service(0) == 0) {
+            }
+            continue;
+        }
+        assert(status == STATUS_OK && value == offset + length);
+        offset = value;
+    }
+    assert(busy);
+    assert(fw_command(CMD_FW_VERIFY, NULL, 0, id++, NULL, NULL) == STATUS_BUSY);
+    while (fw_update_service(0) == 0) {
+    }
+    assert(memcmp(fw_staging, expected, sizeof(expected)) == 0);
+    assert(fw_command(CMD_FW_VERIFY, NULL, 0, id++, TAG_FW_CRC, &value) == STATUS_OK &&
+           value == crc32_compute(expected, sizeof(expected)));
+    
+    // 复制超出当前固件所在区域的补丁：处理时失败，校验不通过
+    const uint32_t bad_args[2] = { sizeof(old_image) - 4, 8 };
+    patch[0] = FW_PATCH_COPY;
+    memcpy(patch + 1, bad_args, 8);
+    begin_len = write_tlv_uint32(begin, sizeof(begin), TAG_FW_SIZE, 8);
+    begin_len += write_tlv_uint32(begin + begin_len, sizeof(begin) - begin_len, TAG_FW_CRC, 0);
+    begin_len += write_tlv_uint32(begin + begin_len, sizeof(begin) - begin_len, TAG_FW_PATCH, 9);
+    begin_len += write_tlv_uint32(begin + begin_len, sizeof(begin) - begin_len, TAG_FW_BASE_SIZE, 6000);
+    begin_len += write_tlv_uint32(begin + begin_len, sizeof(begin) - begin_len, TAG_FW_BASE_CRC, base_crc);
+    assert(fw_command(CMD_FW_BEGIN, begin, begin_len, id++, TAG_FW_OFFSET, &value) == STATUS_OK && value == 0);
+    assert(fw_send_chunk(patch, 0, 9, crc32_compute(patch, 9), id++, &value) == STATUS_OK && value == 9);
+    assert(fw_update_service(0) == UINT32_MAX);
+    assert(fw_command(CMD_FW_VERIFY, NULL, 0, id++, NULL, NULL) == STATUS_INVALID_PARAM);
+    
+    fw_update_init(NULL);
+    printf("✓ 差分升级测试通过\n\n");
+}
+
+// 在引导记录页中追加一条记录（页首时先擦除），返回写入的记录
+static BootRecord boot_test_append(uint8_t *state, uint8_t confirmed, uint8_t trial) {
+    BootRecord record;
+    uint32_t append;
+    uint16_t sequence = boot_record_find(state, &record, &append) ? (uint16_t)(record.sequence + 1U) : 0xFFF0;
+    record = (BootRecord){ .magic = BOOT_RECORD_MAGIC, .sequence = sequence, .confirmed = confirmed, .trial = trial };
+    record.check = boot_record_check(&record);
+    if (append % BOOT_PAGE_SIZE == 0) {
+        memset(state + append, 0xFF, BOOT_PAGE_SIZE);
+    }
+    memcpy(state + append, &record, sizeof(record));
+    return record;
+}
+
+// 测试A/B程序槽的引导记录：追加和换页、序号回绕、写入中断的记录、试运行和回退
+void test_boot_slots(void) {
+    printf("=== 测试A/B程序槽的引导记录 ===\n");
+    
+    static uint8_t state[BOOT_STATE_SIZE];
+    memset(state, 0xFF, sizeof(state));
+    BootRecord record;
+    uint32_t append;
+    
+    // 没有记录时引导A
+    assert(!boot_record_find(state, &record, &append) && append == 0);
+    assert(boot_select(NULL, false) == BOOT_SLOT_A);
+    
+    // 试运行B：第一次引导B，已试运行过（确认前复位）时回到A；确认后引导B
+    boot_test_append(state, BOOT_SLOT_A, BOOT_SLOT_NONE);
+    boot_test_append(state, BOOT_SLOT_A, BOOT_SLOT_B);
+    assert(boot_record_find(state, &record, &append) && append == 2 * sizeof(BootRecord));
+    assert(boot_select(&record, false) == BOOT_SLOT_B);
+    assert(boot_select(&record, true) == BOOT_SLOT_A);
+    boot_test_append(state, BOOT_SLOT_B, BOOT_SLOT_NONE);
+    assert(boot_record_find(state, &record, &append));
+    assert(boot_select(&record, true) == BOOT_SLOT_B && boot_select(&record, false) == BOOT_SLOT_B);
+    
+    // 写满两页：换页时擦除另一页，序号回绕后仍取最新的记录
+    uint32_t per_page = BOOT_PAGE_SIZE / sizeof(BootRecord);
+    for (uint32_t i = 0; i < per_page * 2; i++) {
+        BootRecord written = boot_test_append(state, (uint8_t)(i & 1U), BOOT_SLOT_NONE);
+        assert(boot_record_find(state, &record, &append) && record.sequence == written.sequence);
+        assert(record.confirmed == (uint8_t)(i & 1U));
+    }
+    assert(append == 3 * sizeof(BootRecord)); // 首条记录从0xFFF0开始，回绕后仍在第一页
+    
+    // 写入中断（校验不符）的记录被跳过，下一条写在其后
+    uint32_t torn = append;
+    memset(state + torn, 0x00, 4);
+    assert(boot_record_find(state, &record, &append) && record.confirmed == 1 && append == torn + sizeof(BootRecord));
+    
+    // 向量表：栈指针在SRAM内，复位向量为槽内的Thumb地址
+    uint32_t vectors[2] = { BOOT_RAM_BASE + BOOT_RAM_SIZE, BOOT_SLOT_B_BASE + 0x201 };
+    assert(boot_image_valid((const uint8_t *)vectors, BOOT_SLOT_B_BASE, BOOT_SLOT_SIZE));
+    assert(!boot_image_valid((const uint8_t *)vectors, BOOT_SLOT_A_BASE, BOOT_SLOT_SIZE)); // 按另一个槽链接
+    vectors[1] &= ~1U;
+    assert(!boot_image_valid((const uint8_t *)vectors, BOOT_SLOT_B_BASE, BOOT_SLOT_SIZE));
+    vectors[1] |= 1U;
+    vectors[0] = 0xFFFFFFFFU; // 擦除的槽
+    assert(!boot_image_valid((const uint8_t *)vectors, BOOT_SLOT_B_BASE, BOOT_SLOT_SIZE));
+    
+    printf("✓ A/B程序槽测试通过\n\n");
+}
+
+// 模拟BLE模块：只在本机与模块的波特率一致时收到指令，AT+BAUD应答OK后立即切换
+typedef struct {
+    bool present;
+    bool interval_supported;
+    uint32_t max_baud;       // 接受的最高波特率
+    uint32_t module_baud;
+    uint32_t uart_baud;
+    uint32_t interval_min, interval_max;
+    uint32_t commands;
+    char reply[16];
+} BleTestModule;
+
+static bool ble_test_set_baud(void *context, uint32_t baud_rate) {
+    ((BleTestModule *)context)->uart_baud = baud_rate;
+    return true;
+}
+
+static void ble_test_send(void *context, const uint8_t *data, uint16_t length) {
+    BleTestModule *module = context;
+    char line[40];
+    assert(length >= 2 && length < sizeof(line) && data[length - 2] == '\r' && data[length - 1] == '\n');
+    memcpy(line, data, length - 2U);
+    line[length - 2] = '\0';
+    module->reply[0] = '\0';
+    if (!module->present || module->uart_baud != module->module_baud) {
+        return;
+    }
+    module->commands++;
+    unsigned long first, second;
+    if (strcmp(line, "AT") == 0) {
+        strcpy(module->reply, "OK\r\n");
+    } else if (sscanf(line, "AT+BAUD=%lu", &first) == 1) {
+        if (first <= module->max_baud) {
+            strcpy(module->reply, "OK\r\n");
+            module->module_baud = (uint32_t)first;
+        } else {
+            strcpy(module->reply, "ERROR\r\n");
+        }
+    } else if (sscanf(line, "AT+CINT=%lu,%lu", &first, &second) == 2 && module->interval_supported) {
+        module->interval_min = (uint32_t)first;
+        module->interval_max = (uint32_t)second;
+        strcpy(module->reply, "OK\r\n");
+    } else {
+        strcpy(module->reply, "ERROR\r\n");
+    }
+}
+
+static uint16_t ble_test_receive(void *context, uint8_t *buffer, uint16_t size, uint32_t first_ms, uint32_t gap_ms) {
+    BleTestModule *module = context;
+    (void)first_ms;
+    (void)gap_ms;
+    uint16_t length = (uint16_t)strlen(module->reply);
+    assert(length <= size);
+    memcpy(buffer, module->reply, length);
+    module->reply[0] = '\0';
+    return length;
+}
+
+static void ble_test_configure(BleTestModule *module, BleModuleResult *result) {
+    module->uart_baud = 0;
+    module->commands = 0;
+    BleModulePort port = {
+        .set_baud = ble_test_set_baud,
+        .send = ble_test_send,
+        .receive = ble_test_receive,
+        .context = module,
+    };
+    ble_module_configure(&port, result);
+    assert(module->uart_baud == result->baud_rate);
+}
+
+// 测试BLE模块的上电配置：探测波特率、设置连接间隔和提高波特率
+void test_ble_module(void) {
+    printf("=== 测试BLE模块的上电配置 ===\n");
+    
+    BleModuleResult result;
+    
+    // 出厂设置的模块：在默认波特率上找到，设置连接间隔后提高到BLE_MODULE_BAUD_MAX
+    BleTestModule module = { .present = true, .interval_supported = true, .max_baud = 921600,
+                             .module_baud = COMM_DEFAULT_BAUD_RATE };
+    ble_test_configure(&module, &result);
+    assert(result.found && result.found_baud == COMM_DEFAULT_BAUD_RATE && result.interval_set);
+    assert(result.baud_rate == BLE_MODULE_BAUD_MAX && module.module_baud == BLE_MODULE_BAUD_MAX);
+    assert(module.interval_min == BLE_MODULE_INTERVAL_MIN && module.interval_max == BLE_MODULE_INTERVAL_MAX);
+    
+    // 下次上电：模块保存了设置，直接在新波特率上找到，不再发送AT+BAUD
+    module.interval_min = module.interval_max = 0;
+    ble_test_configure(&module, &result);
+    assert(result.found && result.found_baud == BLE_MODULE_BAUD_MAX && result.baud_rate == BLE_MODULE_BAUD_MAX);
+    assert(module.commands == 2 && module.interval_min == BLE_MODULE_INTERVAL_MIN);
+    
+    // 模块不支持更高的波特率和连接间隔指令：保持找到时的波特率
+    module = (BleTestModule){ .present = true, .max_baud = COMM_DEFAULT_BAUD_RATE,
+                              .module_baud = COMM_DEFAULT_BAUD_RATE };
+    ble_test_configure(&module, &result);
+    assert(result.found && !result.interval_set && result.baud_rate == COMM_DEFAULT_BAUD_RATE);
+    assert(module.module_baud == COMM_DEFAULT_BAUD_RATE);
+    
+    // 没有模块（或已连接、处于透传状态）：回到默认波特率
+    module = (BleTestModule){ .present = false, .module_baud = COMM_DEFAULT_BAUD_RATE };
+    ble_test_configure(&module, &result);
+    assert(!result.found && result.baud_rate == COMM_DEFAULT_BAUD_RATE);
+    
+    printf("✓ BLE模块配置测试通过\n\n");
+}
+
 // 运行所有测试
 void run_all_tests(void) {
     printf("开始STM32温度测量系统测试...\n\n");
@@ -177,6 +2698,32 @@ void run_all_tests(void) {
     test_command_processing();
     test_device_control();
     test_temperature_logging();
+    test_log_compression();
+    test_temp_filter();
+    test_sensor_calibration();
+    test_temp_stats();
+    test_bulk_temps();
+    test_temp_max_age();
+    test_sensor_drivers();
+    test_analog_temps();
+    test_scripted_source();
+    test_sample_schedule();
+    test_log_archive();
+    test_host_communication();
+    test_bench_command();
+    test_link_sessions();
+    test_address_filter();
+    test_gateway();
+    test_duplicate_requests();
+    test_crc_segments();
+    test_warm_state();
+    test_admission();
+    test_stream_frames();
+    test_ping_timestamps();
+    test_firmware_update();
+    test_firmware_delta();
+    test_boot_slots();
+    test_ble_module();
     
     printf("🎉 所有测试通过！系统就绪。\n");
 }
@@ -210,7 +2757,7 @@ void test_host_communication(void) {
         printf("从机成功解析数据包\n");
         
         // 处理命令
-        int result = process_command_packet(received_data, received_len, slave_response, &response_len, header.packet_id);
+        int result = process_command_packet(received_data, received_len, slave_response, sizeof(slave_response), &response_len, header.packet_id, &test_scratch);
         
         if (result == 0) {
             printf("从机响应数据包 (%d字节):\n", response_len);
@@ -233,6 +2780,7 @@ void test_host_communication(void) {
                     printf("指令: %s, 状态: 0x%02X (%s)\n", 
                            instruction, status, 
                            status == STATUS_OK ? "成功" : "失败");
+                    assert(strcmp(instruction, CMD_PING) == 0 && status == STATUS_OK);
                 }
             }
         }
@@ -8,7 +8,32 @@ void test_basic_protocol(void);
 void test_command_processing(void);
 void test_device_control(void);
 void test_temperature_logging(void);
+void test_log_compression(void);
+void test_temp_filter(void);
+void test_sensor_calibration(void);
+void test_temp_stats(void);
+void test_bulk_temps(void);
+void test_temp_max_age(void);
+void test_sensor_drivers(void);
+void test_analog_temps(void);
+void test_scripted_source(void);
+void test_sample_schedule(void);
+void test_log_archive(void);
 void test_host_communication(void);
+void test_bench_command(void);
+void test_link_sessions(void);
+void test_address_filter(void);
+void test_gateway(void);
+void test_duplicate_requests(void);
+void test_crc_segments(void);
+void test_warm_state(void);
+void test_admission(void);
+void test_stream_frames(void);
+void test_ping_timestamps(void);
+void test_firmware_update(void);
+void test_firmware_delta(void);
+void test_boot_slots(void);
+void test_ble_module(void);
 void run_all_tests(void);
 
 #endif // TEST_PROTOCOL_H